@@ -0,0 +1,149 @@
+#include "batchprocessor.h"
+#include "resizer.h"
+#include <QRunnable>
+
+namespace
+{
+    // filters of the interpolation methods in the order of the combo box, nearest neighbour has none
+    const Resizer::ResizeFilter FILTERS[] = { Resizer::BILINEAR_FILTER, Resizer::BICUBIC_FILTER, Resizer::BILINEAR_FILTER, Resizer::LANCZOS3_FILTER, Resizer::AREA_FILTER };
+
+    // Resizes a image with the interpolation method and size choosen in the settings and saves it with the choosen
+    // compression effort. All methods except nearest neighbour resize the image while it is decoded.
+    bool resizeFile(const std::string &filename, const std::string &outFilename, const ResizeSettings &settings)
+    {
+        // the effort levels are in the same order in the combo box
+        const Resizer::EncodeOptions encodeOptions((Resizer::EncodeEffort)settings.effortIndex);
+        if(settings.interpolationIndex > 0 && settings.interpolationIndex <= 4)
+        {
+            if(settings.usePixels)
+                return Resizer::resizeImageFile(filename.c_str(), outFilename.c_str(), settings.width, settings.height, FILTERS[settings.interpolationIndex], encodeOptions);
+            return Resizer::resizeImageFile(filename.c_str(), outFilename.c_str(), settings.widthScale, settings.heightScale, FILTERS[settings.interpolationIndex], encodeOptions);
+        }
+
+        if(settings.interpolationIndex != 0)
+            return false;
+        std::unique_ptr<Resizer::Image> original = Resizer::readImageFromFile(filename.c_str());
+        if(original == nullptr)
+            return false;
+        std::unique_ptr<Resizer::Image> scaled;
+        if(settings.usePixels)
+            scaled = Resizer::nearestNeighbourInterpolation(original.get(), settings.width, settings.height);
+        else
+            scaled = Resizer::nearestNeighbourInterpolation(original.get(), settings.widthScale, settings.heightScale);
+        return scaled != nullptr && Resizer::saveImageToFile(outFilename.c_str(), scaled.get(), encodeOptions);
+    }
+
+    // Estimates the work and the memory of resizing the image of a job with the interpolation method and size choosen in the settings.
+    void estimateJob(Resizer::BatchJob &job, const ResizeSettings &settings)
+    {
+        int width = settings.usePixels ? settings.width : (int)(job.header.width * settings.widthScale);
+        int height = settings.usePixels ? settings.height : (int)(job.header.height * settings.heightScale);
+        if(settings.interpolationIndex > 0 && settings.interpolationIndex <= 4)
+            Resizer::estimateResize(job, width, height, FILTERS[settings.interpolationIndex]);
+        else
+            Resizer::estimateNearestResize(job, width, height);
+    }
+
+    // Plans the batch and runs workerCount workers on the shared threads of the resizer. Every worker decodes, resizes,
+    // encodes and writes images until the scheduler has none left. A image only takes memory from the budget once a
+    // worker starts it, so images waiting for a worker don't hold any, and workers without images help with the images
+    // that are left. The planning opens every file, so it runs here instead of on the GUI thread.
+    class BatchRunner : public QRunnable
+    {
+    public:
+        BatchRunner(BatchProcessor *processor, const QFileInfoList &files, const ResizeSettings &settings, size_t memoryLimit, const std::atomic<bool> &stopping, unsigned workerCount)
+            : processor(processor), files(files), settings(settings), memoryLimit(memoryLimit), stopping(stopping), workerCount(workerCount) {}
+
+        void run()
+        {
+            // the workers are the shared threads of the resizer, so the batch never uses more than workerCount threads,
+            // the estimates of the memory depend on the thread count so it is set before the batch is planned
+            Resizer::setThreadCount(workerCount);
+
+            // the headers tell how much work and memory every image takes and which images to start first
+            std::vector<std::string> filenames;
+            for(int i = 0; i < files.count(); ++i)
+                filenames.push_back(files.at(i).absoluteFilePath().toStdString());
+            const std::vector<Resizer::BatchJob> plan = Resizer::planBatch(filenames, workerCount, [this](Resizer::BatchJob &job) { estimateJob(job, settings); });
+            Resizer::BatchScheduler scheduler(plan, memoryLimit);
+
+            Resizer::parallelFor(workerCount, [this, &scheduler](unsigned begin, unsigned end)
+            {
+                for(unsigned worker = begin; worker < end; ++worker)
+                    resizeImages(scheduler);
+            });
+        }
+
+    private:
+        void resizeImages(Resizer::BatchScheduler &scheduler)
+        {
+            Resizer::BatchJob job;
+            while(!stopping && scheduler.next(job))
+            {
+                if(!stopping)
+                {
+                    const QFileInfo &file = files.at(job.index);
+                    QString newFilename = settings.prefix + file.fileName().section(".",0,0) + settings.suffix + ".png";
+                    QString outFilePath = settings.outputDirectory + "/" + newFilename;
+                    bool succeeded = resizeFile(file.absoluteFilePath().toStdString(), outFilePath.toStdString(), settings);
+                    QMetaObject::invokeMethod(processor, "handleJobFinished", Qt::QueuedConnection, Q_ARG(QString, newFilename), Q_ARG(bool, succeeded));
+                }
+                // workers waiting for memory are woken up, also when this one stops
+                scheduler.finish(job);
+            }
+        }
+
+        BatchProcessor *processor;
+        QFileInfoList files;
+        ResizeSettings settings;
+        size_t memoryLimit;
+        const std::atomic<bool> &stopping;
+        unsigned workerCount;
+    };
+}
+
+BatchProcessor::BatchProcessor(QObject *parent) : QObject(parent), finishedCount(0), stopping(false)
+{
+}
+
+BatchProcessor::~BatchProcessor()
+{
+    // the workers report back to this object, so they have to be done before it goes away
+    stopping = true;
+    files.clear();
+    pool.waitForDone();
+}
+
+// Starts resizing a list of images using workerCount threads and at most about memoryLimit bytes, returns right away.
+void BatchProcessor::start(const QFileInfoList &fileList, const ResizeSettings &resizeSettings, int workerCount, size_t memoryLimit)
+{
+    if(isRunning()) return;
+    // the workers of the last batch may still be on their way out after reporting the last image
+    pool.waitForDone();
+    files = fileList;
+    settings = resizeSettings;
+    finishedCount = 0;
+    workerCount = (workerCount > 0) ? workerCount : 1;
+    if(files.isEmpty())
+    {
+        emit finished();
+        return;
+    }
+
+    // reading the headers can take a while on large or network directories, so even the planning is left to the pool
+    pool.start(new BatchRunner(this, files, settings, memoryLimit, stopping, workerCount));
+}
+
+bool BatchProcessor::isRunning() const
+{
+    return finishedCount < files.count();
+}
+
+// Called on the thread of the processor when a worker is done with a image.
+void BatchProcessor::handleJobFinished(QString filename, bool succeeded)
+{
+    ++finishedCount;
+    emit imageFinished(filename, succeeded, finishedCount, files.count());
+    if(finishedCount == files.count())
+        emit finished();
+}
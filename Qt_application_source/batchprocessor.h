@@ -0,0 +1,59 @@
+#ifndef BATCHPROCESSOR_H
+#define BATCHPROCESSOR_H
+
+#include <QObject>
+#include <QFileInfoList>
+#include <QThreadPool>
+#include <atomic>
+#include "resizer.h"
+#include "thread_pool.h"
+
+// settings shared by every image in a batch
+struct ResizeSettings
+{
+    bool usePixels;
+    int width;
+    int height;
+    float widthScale;
+    float heightScale;
+    int interpolationIndex;
+    int effortIndex;
+    QString outputDirectory;
+    QString prefix;
+    QString suffix;
+};
+
+// Resizes a list of images on the shared worker threads of the resizer. Every worker decodes, resizes, encodes
+// and writes one image at a time, workers that have no image left help with the images that are still running.
+// The headers of the images are read first on the worker threads, the images with the most work are started first
+// and a worker only takes the next image once the memory budget has room for it.
+// Progress is reported through queued signals so the GUI thread is never blocked.
+class BatchProcessor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit BatchProcessor(QObject *parent = 0);
+    ~BatchProcessor();
+    void start(const QFileInfoList &fileList, const ResizeSettings &resizeSettings, int workerCount, size_t memoryLimit = Resizer::DEFAULT_BATCH_MEMORY);
+    bool isRunning() const;
+
+signals:
+    void imageFinished(QString filename, bool succeeded, int finishedCount, int totalCount);
+    void finished();
+
+private slots:
+    void handleJobFinished(QString filename, bool succeeded);
+
+private:
+    // runs the batch off the GUI thread, the workers are the shared threads of the resizer
+    QThreadPool pool;
+    QFileInfoList files;
+    ResizeSettings settings;
+    int finishedCount;
+
+    // tells the workers to stop taking images when the processor goes away
+    std::atomic<bool> stopping;
+};
+
+#endif // BATCHPROCESSOR_H
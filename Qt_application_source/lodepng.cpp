@@ -39,6 +39,13 @@ Rename this file to lodepng.cpp to use it for C++, or to lodepng.c to use it for
 #pragma warning( disable : 4996 ) /*VS does not like fopen, but fopen_s is not standard C so unusable here*/
 #endif /*_MSC_VER */
 
+#if defined(LODEPNG_COMPILE_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+/*The vectorized code is compiled for its instruction set with function attributes instead of compiler flags, and
+only runs after checking at runtime that the processor supports it. Other compilers and processors use plain C.*/
+#define LODEPNG_X86_SIMD
+#include <immintrin.h>
+#endif
+
 const char* LODEPNG_VERSION_STRING = "20160418";
 
 /*
@@ -62,17 +69,17 @@ from here.*/
 #ifdef LODEPNG_COMPILE_ALLOCATORS
 static void* lodepng_malloc(size_t size)
 {
-	return malloc(size);
+    return malloc(size);
 }
 
 static void* lodepng_realloc(void* ptr, size_t new_size)
 {
-	return realloc(ptr, new_size);
+    return realloc(ptr, new_size);
 }
 
 static void lodepng_free(void* ptr)
 {
-	free(ptr);
+    free(ptr);
 }
 #else /*LODEPNG_COMPILE_ALLOCATORS*/
 void* lodepng_malloc(size_t size);
@@ -136,65 +143,65 @@ About uivector, ucvector and string:
 /*dynamic vector of unsigned ints*/
 typedef struct uivector
 {
-	unsigned* data;
-	size_t size; /*size in number of unsigned longs*/
-	size_t allocsize; /*allocated size in bytes*/
+    unsigned* data;
+    size_t size; /*size in number of unsigned longs*/
+    size_t allocsize; /*allocated size in bytes*/
 } uivector;
 
 static void uivector_cleanup(void* p)
 {
-	((uivector*)p)->size = ((uivector*)p)->allocsize = 0;
-	lodepng_free(((uivector*)p)->data);
-	((uivector*)p)->data = NULL;
+    ((uivector*)p)->size = ((uivector*)p)->allocsize = 0;
+    lodepng_free(((uivector*)p)->data);
+    ((uivector*)p)->data = NULL;
 }
 
 /*returns 1 if success, 0 if failure ==> nothing done*/
 static unsigned uivector_reserve(uivector* p, size_t allocsize)
 {
-	if (allocsize > p->allocsize)
-	{
-		size_t newsize = (allocsize > p->allocsize * 2) ? allocsize : (allocsize * 3 / 2);
-		void* data = lodepng_realloc(p->data, newsize);
-		if (data)
-		{
-			p->allocsize = newsize;
-			p->data = (unsigned*)data;
-		}
-		else return 0; /*error: not enough memory*/
-	}
-	return 1;
+    if (allocsize > p->allocsize)
+    {
+        size_t newsize = (allocsize > p->allocsize * 2) ? allocsize : (allocsize * 3 / 2);
+        void* data = lodepng_realloc(p->data, newsize);
+        if (data)
+        {
+            p->allocsize = newsize;
+            p->data = (unsigned*)data;
+        }
+        else return 0; /*error: not enough memory*/
+    }
+    return 1;
 }
 
 /*returns 1 if success, 0 if failure ==> nothing done*/
 static unsigned uivector_resize(uivector* p, size_t size)
 {
-	if (!uivector_reserve(p, size * sizeof(unsigned))) return 0;
-	p->size = size;
-	return 1; /*success*/
+    if (!uivector_reserve(p, size * sizeof(unsigned))) return 0;
+    p->size = size;
+    return 1; /*success*/
 }
 
 /*resize and give all new elements the value*/
 static unsigned uivector_resizev(uivector* p, size_t size, unsigned value)
 {
-	size_t oldsize = p->size, i;
-	if (!uivector_resize(p, size)) return 0;
-	for (i = oldsize; i < size; ++i) p->data[i] = value;
-	return 1;
+    size_t oldsize = p->size, i;
+    if (!uivector_resize(p, size)) return 0;
+    for (i = oldsize; i < size; ++i) p->data[i] = value;
+    return 1;
 }
 
 static void uivector_init(uivector* p)
 {
-	p->data = NULL;
-	p->size = p->allocsize = 0;
+    p->data = NULL;
+    p->size = p->allocsize = 0;
 }
 
 #ifdef LODEPNG_COMPILE_ENCODER
 /*returns 1 if success, 0 if failure ==> nothing done*/
 static unsigned uivector_push_back(uivector* p, unsigned c)
 {
-	if (!uivector_resize(p, p->size + 1)) return 0;
-	p->data[p->size - 1] = c;
-	return 1;
+    if (!uivector_resize(p, p->size + 1)) return 0;
+    p->data[p->size - 1] = c;
+    return 1;
 }
 #endif /*LODEPNG_COMPILE_ENCODER*/
 #endif /*LODEPNG_COMPILE_ZLIB*/
@@ -204,49 +211,49 @@ static unsigned uivector_push_back(uivector* p, unsigned c)
 /*dynamic vector of unsigned chars*/
 typedef struct ucvector
 {
-	unsigned char* data;
-	size_t size; /*used size*/
-	size_t allocsize; /*allocated size*/
+    unsigned char* data;
+    size_t size; /*used size*/
+    size_t allocsize; /*allocated size*/
 } ucvector;
 
 /*returns 1 if success, 0 if failure ==> nothing done*/
 static unsigned ucvector_reserve(ucvector* p, size_t allocsize)
 {
-	if (allocsize > p->allocsize)
-	{
-		size_t newsize = (allocsize > p->allocsize * 2) ? allocsize : (allocsize * 3 / 2);
-		void* data = lodepng_realloc(p->data, newsize);
-		if (data)
-		{
-			p->allocsize = newsize;
-			p->data = (unsigned char*)data;
-		}
-		else return 0; /*error: not enough memory*/
-	}
-	return 1;
+    if (allocsize > p->allocsize)
+    {
+        size_t newsize = (allocsize > p->allocsize * 2) ? allocsize : (allocsize * 3 / 2);
+        void* data = lodepng_realloc(p->data, newsize);
+        if (data)
+        {
+            p->allocsize = newsize;
+            p->data = (unsigned char*)data;
+        }
+        else return 0; /*error: not enough memory*/
+    }
+    return 1;
 }
 
 /*returns 1 if success, 0 if failure ==> nothing done*/
 static unsigned ucvector_resize(ucvector* p, size_t size)
 {
-	if (!ucvector_reserve(p, size * sizeof(unsigned char))) return 0;
-	p->size = size;
-	return 1; /*success*/
+    if (!ucvector_reserve(p, size * sizeof(unsigned char))) return 0;
+    p->size = size;
+    return 1; /*success*/
 }
 
 #ifdef LODEPNG_COMPILE_PNG
 
 static void ucvector_cleanup(void* p)
 {
-	((ucvector*)p)->size = ((ucvector*)p)->allocsize = 0;
-	lodepng_free(((ucvector*)p)->data);
-	((ucvector*)p)->data = NULL;
+    ((ucvector*)p)->size = ((ucvector*)p)->allocsize = 0;
+    lodepng_free(((ucvector*)p)->data);
+    ((ucvector*)p)->data = NULL;
 }
 
 static void ucvector_init(ucvector* p)
 {
-	p->data = NULL;
-	p->size = p->allocsize = 0;
+    p->data = NULL;
+    p->size = p->allocsize = 0;
 }
 #endif /*LODEPNG_COMPILE_PNG*/
 
@@ -255,8 +262,8 @@ static void ucvector_init(ucvector* p)
 init_buffer to take over a buffer and size, it is not needed to use cleanup*/
 static void ucvector_init_buffer(ucvector* p, unsigned char* buffer, size_t size)
 {
-	p->data = buffer;
-	p->allocsize = p->size = size;
+    p->data = buffer;
+    p->allocsize = p->size = size;
 }
 #endif /*LODEPNG_COMPILE_ZLIB*/
 
@@ -264,9 +271,9 @@ static void ucvector_init_buffer(ucvector* p, unsigned char* buffer, size_t size
 /*returns 1 if success, 0 if failure ==> nothing done*/
 static unsigned ucvector_push_back(ucvector* p, unsigned char c)
 {
-	if (!ucvector_resize(p, p->size + 1)) return 0;
-	p->data[p->size - 1] = c;
-	return 1;
+    if (!ucvector_resize(p, p->size + 1)) return 0;
+    p->data[p->size - 1] = c;
+    return 1;
 }
 #endif /*defined(LODEPNG_COMPILE_PNG) || defined(LODEPNG_COMPILE_ENCODER)*/
 
@@ -278,39 +285,39 @@ static unsigned ucvector_push_back(ucvector* p, unsigned char c)
 /*returns 1 if success, 0 if failure ==> nothing done*/
 static unsigned string_resize(char** out, size_t size)
 {
-	char* data = (char*)lodepng_realloc(*out, size + 1);
-	if (data)
-	{
-		data[size] = 0; /*null termination char*/
-		*out = data;
-	}
-	return data != 0;
+    char* data = (char*)lodepng_realloc(*out, size + 1);
+    if (data)
+    {
+        data[size] = 0; /*null termination char*/
+        *out = data;
+    }
+    return data != 0;
 }
 
 /*init a {char*, size_t} pair for use as string*/
 static void string_init(char** out)
 {
-	*out = NULL;
-	string_resize(out, 0);
+    *out = NULL;
+    string_resize(out, 0);
 }
 
 /*free the above pair again*/
 static void string_cleanup(char** out)
 {
-	lodepng_free(*out);
-	*out = NULL;
+    lodepng_free(*out);
+    *out = NULL;
 }
 
 static void string_set(char** out, const char* in)
 {
-	size_t insize = strlen(in), i;
-	if (string_resize(out, insize))
-	{
-		for (i = 0; i != insize; ++i)
-		{
-			(*out)[i] = in[i];
-		}
-	}
+    size_t insize = strlen(in), i;
+    if (string_resize(out, insize))
+    {
+        for (i = 0; i != insize; ++i)
+        {
+            (*out)[i] = in[i];
+        }
+    }
 }
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 #endif /*LODEPNG_COMPILE_PNG*/
@@ -319,25 +326,25 @@ static void string_set(char** out, const char* in)
 
 unsigned lodepng_read32bitInt(const unsigned char* buffer)
 {
-	return (unsigned)((buffer[0] << 24) | (buffer[1] << 16) | (buffer[2] << 8) | buffer[3]);
+    return (unsigned)((buffer[0] << 24) | (buffer[1] << 16) | (buffer[2] << 8) | buffer[3]);
 }
 
 #if defined(LODEPNG_COMPILE_PNG) || defined(LODEPNG_COMPILE_ENCODER)
 /*buffer must have at least 4 allocated bytes available*/
 static void lodepng_set32bitInt(unsigned char* buffer, unsigned value)
 {
-	buffer[0] = (unsigned char)((value >> 24) & 0xff);
-	buffer[1] = (unsigned char)((value >> 16) & 0xff);
-	buffer[2] = (unsigned char)((value >> 8) & 0xff);
-	buffer[3] = (unsigned char)((value)& 0xff);
+    buffer[0] = (unsigned char)((value >> 24) & 0xff);
+    buffer[1] = (unsigned char)((value >> 16) & 0xff);
+    buffer[2] = (unsigned char)((value >> 8) & 0xff);
+    buffer[3] = (unsigned char)((value)& 0xff);
 }
 #endif /*defined(LODEPNG_COMPILE_PNG) || defined(LODEPNG_COMPILE_ENCODER)*/
 
 #ifdef LODEPNG_COMPILE_ENCODER
 static void lodepng_add32bitInt(ucvector* buffer, unsigned value)
 {
-	ucvector_resize(buffer, buffer->size + 4); /*todo: give error if resize failed*/
-	lodepng_set32bitInt(&buffer->data[buffer->size - 4], value);
+    ucvector_resize(buffer, buffer->size + 4); /*todo: give error if resize failed*/
+    lodepng_set32bitInt(&buffer->data[buffer->size - 4], value);
 }
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
@@ -347,64 +354,61 @@ static void lodepng_add32bitInt(ucvector* buffer, unsigned value)
 
 #ifdef LODEPNG_COMPILE_DISK
 
-/* returns negative value on error. This should be pure C compatible, so no fstat. */
-static long lodepng_filesize(const char* filename)
+/* returns negative value on error, the file is at its start again afterwards. This should be pure C
+compatible, so no fstat. */
+static long lodepng_filesize(FILE* file)
 {
-	FILE* file;
-	long size;
-	file = fopen(filename, "rb");
-	if (!file) return -1;
-
-	if (fseek(file, 0, SEEK_END) != 0)
-	{
-		fclose(file);
-		return -1;
-	}
+    long size;
+    if (fseek(file, 0, SEEK_END) != 0) return -1;
 
-	size = ftell(file);
-	/* It may give LONG_MAX as directory size, this is invalid for us. */
-	if (size == LONG_MAX) size = -1;
+    size = ftell(file);
+    /* It may give LONG_MAX as directory size, this is invalid for us. */
+    if (size == LONG_MAX) size = -1;
 
-	fclose(file);
-	return size;
+    if (fseek(file, 0, SEEK_SET) != 0) return -1;
+    return size;
 }
 
 /* load file into buffer that already has the correct allocated size. Returns error code.*/
-static unsigned lodepng_buffer_file(unsigned char* out, size_t size, const char* filename)
+static unsigned lodepng_buffer_file(unsigned char* out, size_t size, FILE* file)
 {
-	FILE* file;
-	size_t readsize;
-	file = fopen(filename, "rb");
-	if (!file) return 78;
-
-	readsize = fread(out, 1, size, file);
-	fclose(file);
-
-	if (readsize != size) return 78;
-	return 0;
+    size_t readsize = fread(out, 1, size, file);
+    if (readsize != size) return 78;
+    return 0;
 }
 
 unsigned lodepng_load_file(unsigned char** out, size_t* outsize, const char* filename)
 {
-	long size = lodepng_filesize(filename);
-	if (size < 0) return 78;
-	*outsize = (size_t)size;
-
-	*out = (unsigned char*)lodepng_malloc((size_t)size);
-	if (!(*out) && size > 0) return 83; /*the above malloc failed*/
-
-	return lodepng_buffer_file(*out, (size_t)size, filename);
+    unsigned error;
+    long size;
+    /*the file is opened once for both its size and its contents*/
+    FILE* file = fopen(filename, "rb");
+    *out = 0;
+    *outsize = 0;
+    if (!file) return 78;
+
+    size = lodepng_filesize(file);
+    if (size < 0) error = 78;
+    else
+    {
+        *outsize = (size_t)size;
+        *out = (unsigned char*)lodepng_malloc((size_t)size);
+        if (!(*out) && size > 0) error = 83; /*the above malloc failed*/
+        else error = lodepng_buffer_file(*out, (size_t)size, file);
+    }
+    fclose(file);
+    return error;
 }
 
 /*write given buffer to the file, overwriting the file, it doesn't append to it.*/
 unsigned lodepng_save_file(const unsigned char* buffer, size_t buffersize, const char* filename)
 {
-	FILE* file;
-	file = fopen(filename, "wb");
-	if (!file) return 79;
-	fwrite((char*)buffer, 1, buffersize, file);
-	fclose(file);
-	return 0;
+    FILE* file;
+    file = fopen(filename, "wb");
+    if (!file) return 79;
+    fwrite((char*)buffer, 1, buffersize, file);
+    fclose(file);
+    return 0;
 }
 
 #endif /*LODEPNG_COMPILE_DISK*/
@@ -429,40 +433,17 @@ unsigned lodepng_save_file(const unsigned char* buffer, size_t buffersize, const
 
 static void addBitsToStream(size_t* bitpointer, ucvector* bitstream, unsigned value, size_t nbits)
 {
-	size_t i;
-	for (i = 0; i != nbits; ++i) addBitToStream(bitpointer, bitstream, (unsigned char)((value >> i) & 1));
+    size_t i;
+    for (i = 0; i != nbits; ++i) addBitToStream(bitpointer, bitstream, (unsigned char)((value >> i) & 1));
 }
 
 static void addBitsToStreamReversed(size_t* bitpointer, ucvector* bitstream, unsigned value, size_t nbits)
 {
-	size_t i;
-	for (i = 0; i != nbits; ++i) addBitToStream(bitpointer, bitstream, (unsigned char)((value >> (nbits - 1 - i)) & 1));
+    size_t i;
+    for (i = 0; i != nbits; ++i) addBitToStream(bitpointer, bitstream, (unsigned char)((value >> (nbits - 1 - i)) & 1));
 }
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
-#ifdef LODEPNG_COMPILE_DECODER
-
-#define READBIT(bitpointer, bitstream) ((bitstream[bitpointer >> 3] >> (bitpointer & 0x7)) & (unsigned char)1)
-
-static unsigned char readBitFromStream(size_t* bitpointer, const unsigned char* bitstream)
-{
-	unsigned char result = (unsigned char)(READBIT(*bitpointer, bitstream));
-	++(*bitpointer);
-	return result;
-}
-
-static unsigned readBitsFromStream(size_t* bitpointer, const unsigned char* bitstream, size_t nbits)
-{
-	unsigned result = 0, i;
-	for (i = 0; i != nbits; ++i)
-	{
-		result += ((unsigned)READBIT(*bitpointer, bitstream)) << i;
-		++(*bitpointer);
-	}
-	return result;
-}
-#endif /*LODEPNG_COMPILE_DECODER*/
-
 /* ////////////////////////////////////////////////////////////////////////// */
 /* / Deflate - Huffman                                                      / */
 /* ////////////////////////////////////////////////////////////////////////// */
@@ -508,11 +489,13 @@ Huffman tree struct, containing multiple representations of the tree
 */
 typedef struct HuffmanTree
 {
-	unsigned* tree2d;
-	unsigned* tree1d;
-	unsigned* lengths; /*the lengths of the codes of the 1d-tree*/
-	unsigned maxbitlen; /*maximum number of bits a single code can get*/
-	unsigned numcodes; /*number of symbols in the alphabet = number of codes*/
+    unsigned* tree2d;
+    unsigned* tree1d;
+    unsigned* lengths; /*the lengths of the codes of the 1d-tree*/
+    unsigned maxbitlen; /*maximum number of bits a single code can get*/
+    unsigned numcodes; /*number of symbols in the alphabet = number of codes*/
+    unsigned char* table_len; /*decoding tables, the code length of every entry*/
+    unsigned short* table_value; /*decoding tables, the symbol of every entry or the start of a second level table*/
 } HuffmanTree;
 
 /*function used for debug purposes to draw the tree in ascii art with C++*/
@@ -530,77 +513,81 @@ std::cout << std::endl;
 
 static void HuffmanTree_init(HuffmanTree* tree)
 {
-	tree->tree2d = 0;
-	tree->tree1d = 0;
-	tree->lengths = 0;
+    tree->tree2d = 0;
+    tree->tree1d = 0;
+    tree->lengths = 0;
+    tree->table_len = 0;
+    tree->table_value = 0;
 }
 
 static void HuffmanTree_cleanup(HuffmanTree* tree)
 {
-	lodepng_free(tree->tree2d);
-	lodepng_free(tree->tree1d);
-	lodepng_free(tree->lengths);
+    lodepng_free(tree->tree2d);
+    lodepng_free(tree->tree1d);
+    lodepng_free(tree->lengths);
+    lodepng_free(tree->table_len);
+    lodepng_free(tree->table_value);
 }
 
-/*the tree representation used by the decoder. return value is error*/
+/*the tree representation used by the decoder to read codes bit by bit. return value is error*/
 static unsigned HuffmanTree_make2DTree(HuffmanTree* tree)
 {
-	unsigned nodefilled = 0; /*up to which node it is filled*/
-	unsigned treepos = 0; /*position in the tree (1 of the numcodes columns)*/
-	unsigned n, i;
-
-	tree->tree2d = (unsigned*)lodepng_malloc(tree->numcodes * 2 * sizeof(unsigned));
-	if (!tree->tree2d) return 83; /*alloc fail*/
-
-	/*
-	convert tree1d[] to tree2d[][]. In the 2D array, a value of 32767 means
-	uninited, a value >= numcodes is an address to another bit, a value < numcodes
-	is a code. The 2 rows are the 2 possible bit values (0 or 1), there are as
-	many columns as codes - 1.
-	A good huffman tree has N * 2 - 1 nodes, of which N - 1 are internal nodes.
-	Here, the internal nodes are stored (what their 0 and 1 option point to).
-	There is only memory for such good tree currently, if there are more nodes
-	(due to too long length codes), error 55 will happen
-	*/
-	for (n = 0; n < tree->numcodes * 2; ++n)
-	{
-		tree->tree2d[n] = 32767; /*32767 here means the tree2d isn't filled there yet*/
-	}
-
-	for (n = 0; n < tree->numcodes; ++n) /*the codes*/
-	{
-		for (i = 0; i != tree->lengths[n]; ++i) /*the bits for this code*/
-		{
-			unsigned char bit = (unsigned char)((tree->tree1d[n] >> (tree->lengths[n] - i - 1)) & 1);
-			/*oversubscribed, see comment in lodepng_error_text*/
-			if (treepos > 2147483647 || treepos + 2 > tree->numcodes) return 55;
-			if (tree->tree2d[2 * treepos + bit] == 32767) /*not yet filled in*/
-			{
-				if (i + 1 == tree->lengths[n]) /*last bit*/
-				{
-					tree->tree2d[2 * treepos + bit] = n; /*put the current code in it*/
-					treepos = 0;
-				}
-				else
-				{
-					/*put address of the next step in here, first that address has to be found of course
-					(it's just nodefilled + 1)...*/
-					++nodefilled;
-					/*addresses encoded with numcodes added to it*/
-					tree->tree2d[2 * treepos + bit] = nodefilled + tree->numcodes;
-					treepos = nodefilled;
-				}
-			}
-			else treepos = tree->tree2d[2 * treepos + bit] - tree->numcodes;
-		}
-	}
-
-	for (n = 0; n < tree->numcodes * 2; ++n)
-	{
-		if (tree->tree2d[n] == 32767) tree->tree2d[n] = 0; /*remove possible remaining 32767's*/
-	}
-
-	return 0;
+    unsigned nodefilled = 0; /*up to which node it is filled*/
+    unsigned treepos = 0; /*position in the tree (1 of the numcodes columns)*/
+    unsigned n, i;
+
+    tree->tree2d = (unsigned*)lodepng_malloc(tree->numcodes * 2 * sizeof(unsigned));
+    if (!tree->tree2d) return 83; /*alloc fail*/
+
+    /*
+    convert tree1d[] to tree2d[][]. In the 2D array, a value of 32767 means
+    uninited, a value >= numcodes is an address to another bit, a value < numcodes
+    is a code. The 2 rows are the 2 possible bit values (0 or 1), there are as
+    many columns as codes - 1.
+    A good huffman tree has N * 2 - 1 nodes, of which N - 1 are internal nodes.
+    Here, the internal nodes are stored (what their 0 and 1 option point to).
+    There is only memory for such good tree currently, if there are more nodes
+    (due to too long length codes), error 55 will happen
+    */
+    for (n = 0; n < tree->numcodes * 2; ++n)
+    {
+        tree->tree2d[n] = 32767; /*32767 here means the tree2d isn't filled there yet*/
+    }
+
+    for (n = 0; n < tree->numcodes; ++n) /*the codes*/
+    {
+        for (i = 0; i != tree->lengths[n]; ++i) /*the bits for this code*/
+        {
+            unsigned char bit = (unsigned char)((tree->tree1d[n] >> (tree->lengths[n] - i - 1)) & 1);
+            /*oversubscribed, see comment in lodepng_error_text*/
+            if (treepos > 2147483647 || treepos + 2 > tree->numcodes) return 55;
+            if (tree->tree2d[2 * treepos + bit] == 32767) /*not yet filled in*/
+            {
+                if (i + 1 == tree->lengths[n]) /*last bit*/
+                {
+                    tree->tree2d[2 * treepos + bit] = n; /*put the current code in it*/
+                    treepos = 0;
+                }
+                else
+                {
+                    /*put address of the next step in here, first that address has to be found of course
+                    (it's just nodefilled + 1)...*/
+                    ++nodefilled;
+                    /*addresses encoded with numcodes added to it*/
+                    tree->tree2d[2 * treepos + bit] = nodefilled + tree->numcodes;
+                    treepos = nodefilled;
+                }
+            }
+            else treepos = tree->tree2d[2 * treepos + bit] - tree->numcodes;
+        }
+    }
+
+    for (n = 0; n < tree->numcodes * 2; ++n)
+    {
+        if (tree->tree2d[n] == 32767) tree->tree2d[n] = 0; /*remove possible remaining 32767's*/
+    }
+
+    return 0;
 }
 
 /*
@@ -610,42 +597,41 @@ value is error.
 */
 static unsigned HuffmanTree_makeFromLengths2(HuffmanTree* tree)
 {
-	uivector blcount;
-	uivector nextcode;
-	unsigned error = 0;
-	unsigned bits, n;
+    uivector blcount;
+    uivector nextcode;
+    unsigned error = 0;
+    unsigned bits, n;
 
-	uivector_init(&blcount);
-	uivector_init(&nextcode);
+    uivector_init(&blcount);
+    uivector_init(&nextcode);
 
-	tree->tree1d = (unsigned*)lodepng_malloc(tree->numcodes * sizeof(unsigned));
-	if (!tree->tree1d) error = 83; /*alloc fail*/
+    tree->tree1d = (unsigned*)lodepng_malloc(tree->numcodes * sizeof(unsigned));
+    if (!tree->tree1d) error = 83; /*alloc fail*/
 
-	if (!uivector_resizev(&blcount, tree->maxbitlen + 1, 0)
-		|| !uivector_resizev(&nextcode, tree->maxbitlen + 1, 0))
-		error = 83; /*alloc fail*/
+    if (!uivector_resizev(&blcount, tree->maxbitlen + 1, 0)
+        || !uivector_resizev(&nextcode, tree->maxbitlen + 1, 0))
+        error = 83; /*alloc fail*/
 
-	if (!error)
-	{
-		/*step 1: count number of instances of each code length*/
-		for (bits = 0; bits != tree->numcodes; ++bits) ++blcount.data[tree->lengths[bits]];
-		/*step 2: generate the nextcode values*/
-		for (bits = 1; bits <= tree->maxbitlen; ++bits)
-		{
-			nextcode.data[bits] = (nextcode.data[bits - 1] + blcount.data[bits - 1]) << 1;
-		}
-		/*step 3: generate all the codes*/
-		for (n = 0; n != tree->numcodes; ++n)
-		{
-			if (tree->lengths[n] != 0) tree->tree1d[n] = nextcode.data[tree->lengths[n]]++;
-		}
-	}
+    if (!error)
+    {
+        /*step 1: count number of instances of each code length*/
+        for (bits = 0; bits != tree->numcodes; ++bits) ++blcount.data[tree->lengths[bits]];
+        /*step 2: generate the nextcode values*/
+        for (bits = 1; bits <= tree->maxbitlen; ++bits)
+        {
+            nextcode.data[bits] = (nextcode.data[bits - 1] + blcount.data[bits - 1]) << 1;
+        }
+        /*step 3: generate all the codes*/
+        for (n = 0; n != tree->numcodes; ++n)
+        {
+            if (tree->lengths[n] != 0) tree->tree1d[n] = nextcode.data[tree->lengths[n]]++;
+        }
+    }
 
-	uivector_cleanup(&blcount);
-	uivector_cleanup(&nextcode);
+    uivector_cleanup(&blcount);
+    uivector_cleanup(&nextcode);
 
-	if (!error) return HuffmanTree_make2DTree(tree);
-	else return error;
+    return error;
 }
 
 /*
@@ -654,15 +640,15 @@ by Deflate. maxbitlen is the maximum bits that a code in the tree can have.
 return value is error.
 */
 static unsigned HuffmanTree_makeFromLengths(HuffmanTree* tree, const unsigned* bitlen,
-	size_t numcodes, unsigned maxbitlen)
+    size_t numcodes, unsigned maxbitlen)
 {
-	unsigned i;
-	tree->lengths = (unsigned*)lodepng_malloc(numcodes * sizeof(unsigned));
-	if (!tree->lengths) return 83; /*alloc fail*/
-	for (i = 0; i != numcodes; ++i) tree->lengths[i] = bitlen[i];
-	tree->numcodes = (unsigned)numcodes; /*number of symbols*/
-	tree->maxbitlen = maxbitlen;
-	return HuffmanTree_makeFromLengths2(tree);
+    unsigned i;
+    tree->lengths = (unsigned*)lodepng_malloc(numcodes * sizeof(unsigned));
+    if (!tree->lengths) return 83; /*alloc fail*/
+    for (i = 0; i != numcodes; ++i) tree->lengths[i] = bitlen[i];
+    tree->numcodes = (unsigned)numcodes; /*number of symbols*/
+    tree->maxbitlen = maxbitlen;
+    return HuffmanTree_makeFromLengths2(tree);
 }
 
 #ifdef LODEPNG_COMPILE_ENCODER
@@ -673,295 +659,561 @@ Jyrki Katajainen, Alistair Moffat, Andrew Turpin, 1995.*/
 /*chain node for boundary package merge*/
 typedef struct BPMNode
 {
-	int weight; /*the sum of all weights in this chain*/
-	unsigned index; /*index of this leaf node (called "count" in the paper)*/
-	struct BPMNode* tail; /*the next nodes in this chain (null if last)*/
-	int in_use;
+    int weight; /*the sum of all weights in this chain*/
+    unsigned index; /*index of this leaf node (called "count" in the paper)*/
+    struct BPMNode* tail; /*the next nodes in this chain (null if last)*/
+    int in_use;
 } BPMNode;
 
 /*lists of chains*/
 typedef struct BPMLists
 {
-	/*memory pool*/
-	unsigned memsize;
-	BPMNode* memory;
-	unsigned numfree;
-	unsigned nextfree;
-	BPMNode** freelist;
-	/*two heads of lookahead chains per list*/
-	unsigned listsize;
-	BPMNode** chains0;
-	BPMNode** chains1;
+    /*memory pool*/
+    unsigned memsize;
+    BPMNode* memory;
+    unsigned numfree;
+    unsigned nextfree;
+    BPMNode** freelist;
+    /*two heads of lookahead chains per list*/
+    unsigned listsize;
+    BPMNode** chains0;
+    BPMNode** chains1;
 } BPMLists;
 
 /*creates a new chain node with the given parameters, from the memory in the lists */
 static BPMNode* bpmnode_create(BPMLists* lists, int weight, unsigned index, BPMNode* tail)
 {
-	unsigned i;
-	BPMNode* result;
-
-	/*memory full, so garbage collect*/
-	if (lists->nextfree >= lists->numfree)
-	{
-		/*mark only those that are in use*/
-		for (i = 0; i != lists->memsize; ++i) lists->memory[i].in_use = 0;
-		for (i = 0; i != lists->listsize; ++i)
-		{
-			BPMNode* node;
-			for (node = lists->chains0[i]; node != 0; node = node->tail) node->in_use = 1;
-			for (node = lists->chains1[i]; node != 0; node = node->tail) node->in_use = 1;
-		}
-		/*collect those that are free*/
-		lists->numfree = 0;
-		for (i = 0; i != lists->memsize; ++i)
-		{
-			if (!lists->memory[i].in_use) lists->freelist[lists->numfree++] = &lists->memory[i];
-		}
-		lists->nextfree = 0;
-	}
-
-	result = lists->freelist[lists->nextfree++];
-	result->weight = weight;
-	result->index = index;
-	result->tail = tail;
-	return result;
+    unsigned i;
+    BPMNode* result;
+
+    /*memory full, so garbage collect*/
+    if (lists->nextfree >= lists->numfree)
+    {
+        /*mark only those that are in use*/
+        for (i = 0; i != lists->memsize; ++i) lists->memory[i].in_use = 0;
+        for (i = 0; i != lists->listsize; ++i)
+        {
+            BPMNode* node;
+            for (node = lists->chains0[i]; node != 0; node = node->tail) node->in_use = 1;
+            for (node = lists->chains1[i]; node != 0; node = node->tail) node->in_use = 1;
+        }
+        /*collect those that are free*/
+        lists->numfree = 0;
+        for (i = 0; i != lists->memsize; ++i)
+        {
+            if (!lists->memory[i].in_use) lists->freelist[lists->numfree++] = &lists->memory[i];
+        }
+        lists->nextfree = 0;
+    }
+
+    result = lists->freelist[lists->nextfree++];
+    result->weight = weight;
+    result->index = index;
+    result->tail = tail;
+    return result;
 }
 
 /*sort the leaves with stable mergesort*/
 static void bpmnode_sort(BPMNode* leaves, size_t num)
 {
-	BPMNode* mem = (BPMNode*)lodepng_malloc(sizeof(*leaves) * num);
-	size_t width, counter = 0;
-	for (width = 1; width < num; width *= 2)
-	{
-		BPMNode* a = (counter & 1) ? mem : leaves;
-		BPMNode* b = (counter & 1) ? leaves : mem;
-		size_t p;
-		for (p = 0; p < num; p += 2 * width)
-		{
-			size_t q = (p + width > num) ? num : (p + width);
-			size_t r = (p + 2 * width > num) ? num : (p + 2 * width);
-			size_t i = p, j = q, k;
-			for (k = p; k < r; k++)
-			{
-				if (i < q && (j >= r || a[i].weight <= a[j].weight)) b[k] = a[i++];
-				else b[k] = a[j++];
-			}
-		}
-		counter++;
-	}
-	if (counter & 1) memcpy(leaves, mem, sizeof(*leaves) * num);
-	lodepng_free(mem);
+    BPMNode* mem = (BPMNode*)lodepng_malloc(sizeof(*leaves) * num);
+    size_t width, counter = 0;
+    for (width = 1; width < num; width *= 2)
+    {
+        BPMNode* a = (counter & 1) ? mem : leaves;
+        BPMNode* b = (counter & 1) ? leaves : mem;
+        size_t p;
+        for (p = 0; p < num; p += 2 * width)
+        {
+            size_t q = (p + width > num) ? num : (p + width);
+            size_t r = (p + 2 * width > num) ? num : (p + 2 * width);
+            size_t i = p, j = q, k;
+            for (k = p; k < r; k++)
+            {
+                if (i < q && (j >= r || a[i].weight <= a[j].weight)) b[k] = a[i++];
+                else b[k] = a[j++];
+            }
+        }
+        counter++;
+    }
+    if (counter & 1) memcpy(leaves, mem, sizeof(*leaves) * num);
+    lodepng_free(mem);
 }
 
 /*Boundary Package Merge step, numpresent is the amount of leaves, and c is the current chain.*/
 static void boundaryPM(BPMLists* lists, BPMNode* leaves, size_t numpresent, int c, int num)
 {
-	unsigned lastindex = lists->chains1[c]->index;
-
-	if (c == 0)
-	{
-		if (lastindex >= numpresent) return;
-		lists->chains0[c] = lists->chains1[c];
-		lists->chains1[c] = bpmnode_create(lists, leaves[lastindex].weight, lastindex + 1, 0);
-	}
-	else
-	{
-		/*sum of the weights of the head nodes of the previous lookahead chains.*/
-		int sum = lists->chains0[c - 1]->weight + lists->chains1[c - 1]->weight;
-		lists->chains0[c] = lists->chains1[c];
-		if (lastindex < numpresent && sum > leaves[lastindex].weight)
-		{
-			lists->chains1[c] = bpmnode_create(lists, leaves[lastindex].weight, lastindex + 1, lists->chains1[c]->tail);
-			return;
-		}
-		lists->chains1[c] = bpmnode_create(lists, sum, lastindex, lists->chains1[c - 1]);
-		/*in the end we are only interested in the chain of the last list, so no
-		need to recurse if we're at the last one (this gives measurable speedup)*/
-		if (num + 1 < (int)(2 * numpresent - 2))
-		{
-			boundaryPM(lists, leaves, numpresent, c - 1, num);
-			boundaryPM(lists, leaves, numpresent, c - 1, num);
-		}
-	}
+    unsigned lastindex = lists->chains1[c]->index;
+
+    if (c == 0)
+    {
+        if (lastindex >= numpresent) return;
+        lists->chains0[c] = lists->chains1[c];
+        lists->chains1[c] = bpmnode_create(lists, leaves[lastindex].weight, lastindex + 1, 0);
+    }
+    else
+    {
+        /*sum of the weights of the head nodes of the previous lookahead chains.*/
+        int sum = lists->chains0[c - 1]->weight + lists->chains1[c - 1]->weight;
+        lists->chains0[c] = lists->chains1[c];
+        if (lastindex < numpresent && sum > leaves[lastindex].weight)
+        {
+            lists->chains1[c] = bpmnode_create(lists, leaves[lastindex].weight, lastindex + 1, lists->chains1[c]->tail);
+            return;
+        }
+        lists->chains1[c] = bpmnode_create(lists, sum, lastindex, lists->chains1[c - 1]);
+        /*in the end we are only interested in the chain of the last list, so no
+        need to recurse if we're at the last one (this gives measurable speedup)*/
+        if (num + 1 < (int)(2 * numpresent - 2))
+        {
+            boundaryPM(lists, leaves, numpresent, c - 1, num);
+            boundaryPM(lists, leaves, numpresent, c - 1, num);
+        }
+    }
 }
 
 unsigned lodepng_huffman_code_lengths(unsigned* lengths, const unsigned* frequencies,
-	size_t numcodes, unsigned maxbitlen)
-{
-	unsigned error = 0;
-	unsigned i;
-	size_t numpresent = 0; /*number of symbols with non-zero frequency*/
-	BPMNode* leaves; /*the symbols, only those with > 0 frequency*/
-
-	if (numcodes == 0) return 80; /*error: a tree of 0 symbols is not supposed to be made*/
-	if ((1u << maxbitlen) < numcodes) return 80; /*error: represent all symbols*/
-
-	leaves = (BPMNode*)lodepng_malloc(numcodes * sizeof(*leaves));
-	if (!leaves) return 83; /*alloc fail*/
-
-	for (i = 0; i != numcodes; ++i)
-	{
-		if (frequencies[i] > 0)
-		{
-			leaves[numpresent].weight = (int)frequencies[i];
-			leaves[numpresent].index = i;
-			++numpresent;
-		}
-	}
-
-	for (i = 0; i != numcodes; ++i) lengths[i] = 0;
-
-	/*ensure at least two present symbols. There should be at least one symbol
-	according to RFC 1951 section 3.2.7. Some decoders incorrectly require two. To
-	make these work as well ensure there are at least two symbols. The
-	Package-Merge code below also doesn't work correctly if there's only one
-	symbol, it'd give it the theoritical 0 bits but in practice zlib wants 1 bit*/
-	if (numpresent == 0)
-	{
-		lengths[0] = lengths[1] = 1; /*note that for RFC 1951 section 3.2.7, only lengths[0] = 1 is needed*/
-	}
-	else if (numpresent == 1)
-	{
-		lengths[leaves[0].index] = 1;
-		lengths[leaves[0].index == 0 ? 1 : 0] = 1;
-	}
-	else
-	{
-		BPMLists lists;
-		BPMNode* node;
-
-		bpmnode_sort(leaves, numpresent);
-
-		lists.listsize = maxbitlen;
-		lists.memsize = 2 * maxbitlen * (maxbitlen + 1);
-		lists.nextfree = 0;
-		lists.numfree = lists.memsize;
-		lists.memory = (BPMNode*)lodepng_malloc(lists.memsize * sizeof(*lists.memory));
-		lists.freelist = (BPMNode**)lodepng_malloc(lists.memsize * sizeof(BPMNode*));
-		lists.chains0 = (BPMNode**)lodepng_malloc(lists.listsize * sizeof(BPMNode*));
-		lists.chains1 = (BPMNode**)lodepng_malloc(lists.listsize * sizeof(BPMNode*));
-		if (!lists.memory || !lists.freelist || !lists.chains0 || !lists.chains1) error = 83; /*alloc fail*/
-
-		if (!error)
-		{
-			for (i = 0; i != lists.memsize; ++i) lists.freelist[i] = &lists.memory[i];
-
-			bpmnode_create(&lists, leaves[0].weight, 1, 0);
-			bpmnode_create(&lists, leaves[1].weight, 2, 0);
-
-			for (i = 0; i != lists.listsize; ++i)
-			{
-				lists.chains0[i] = &lists.memory[0];
-				lists.chains1[i] = &lists.memory[1];
-			}
-
-			/*each boundaryPM call adds one chain to the last list, and we need 2 * numpresent - 2 chains.*/
-			for (i = 2; i != 2 * numpresent - 2; ++i) boundaryPM(&lists, leaves, numpresent, (int)maxbitlen - 1, (int)i);
-
-			for (node = lists.chains1[maxbitlen - 1]; node; node = node->tail)
-			{
-				for (i = 0; i != node->index; ++i) ++lengths[leaves[i].index];
-			}
-		}
-
-		lodepng_free(lists.memory);
-		lodepng_free(lists.freelist);
-		lodepng_free(lists.chains0);
-		lodepng_free(lists.chains1);
-	}
-
-	lodepng_free(leaves);
-	return error;
+    size_t numcodes, unsigned maxbitlen)
+{
+    unsigned error = 0;
+    unsigned i;
+    size_t numpresent = 0; /*number of symbols with non-zero frequency*/
+    BPMNode* leaves; /*the symbols, only those with > 0 frequency*/
+
+    if (numcodes == 0) return 80; /*error: a tree of 0 symbols is not supposed to be made*/
+    if ((1u << maxbitlen) < numcodes) return 80; /*error: represent all symbols*/
+
+    leaves = (BPMNode*)lodepng_malloc(numcodes * sizeof(*leaves));
+    if (!leaves) return 83; /*alloc fail*/
+
+    for (i = 0; i != numcodes; ++i)
+    {
+        if (frequencies[i] > 0)
+        {
+            leaves[numpresent].weight = (int)frequencies[i];
+            leaves[numpresent].index = i;
+            ++numpresent;
+        }
+    }
+
+    for (i = 0; i != numcodes; ++i) lengths[i] = 0;
+
+    /*ensure at least two present symbols. There should be at least one symbol
+    according to RFC 1951 section 3.2.7. Some decoders incorrectly require two. To
+    make these work as well ensure there are at least two symbols. The
+    Package-Merge code below also doesn't work correctly if there's only one
+    symbol, it'd give it the theoritical 0 bits but in practice zlib wants 1 bit*/
+    if (numpresent == 0)
+    {
+        lengths[0] = lengths[1] = 1; /*note that for RFC 1951 section 3.2.7, only lengths[0] = 1 is needed*/
+    }
+    else if (numpresent == 1)
+    {
+        lengths[leaves[0].index] = 1;
+        lengths[leaves[0].index == 0 ? 1 : 0] = 1;
+    }
+    else
+    {
+        BPMLists lists;
+        BPMNode* node;
+
+        bpmnode_sort(leaves, numpresent);
+
+        lists.listsize = maxbitlen;
+        lists.memsize = 2 * maxbitlen * (maxbitlen + 1);
+        lists.nextfree = 0;
+        lists.numfree = lists.memsize;
+        lists.memory = (BPMNode*)lodepng_malloc(lists.memsize * sizeof(*lists.memory));
+        lists.freelist = (BPMNode**)lodepng_malloc(lists.memsize * sizeof(BPMNode*));
+        lists.chains0 = (BPMNode**)lodepng_malloc(lists.listsize * sizeof(BPMNode*));
+        lists.chains1 = (BPMNode**)lodepng_malloc(lists.listsize * sizeof(BPMNode*));
+        if (!lists.memory || !lists.freelist || !lists.chains0 || !lists.chains1) error = 83; /*alloc fail*/
+
+        if (!error)
+        {
+            for (i = 0; i != lists.memsize; ++i) lists.freelist[i] = &lists.memory[i];
+
+            bpmnode_create(&lists, leaves[0].weight, 1, 0);
+            bpmnode_create(&lists, leaves[1].weight, 2, 0);
+
+            for (i = 0; i != lists.listsize; ++i)
+            {
+                lists.chains0[i] = &lists.memory[0];
+                lists.chains1[i] = &lists.memory[1];
+            }
+
+            /*each boundaryPM call adds one chain to the last list, and we need 2 * numpresent - 2 chains.*/
+            for (i = 2; i != 2 * numpresent - 2; ++i) boundaryPM(&lists, leaves, numpresent, (int)maxbitlen - 1, (int)i);
+
+            for (node = lists.chains1[maxbitlen - 1]; node; node = node->tail)
+            {
+                for (i = 0; i != node->index; ++i) ++lengths[leaves[i].index];
+            }
+        }
+
+        lodepng_free(lists.memory);
+        lodepng_free(lists.freelist);
+        lodepng_free(lists.chains0);
+        lodepng_free(lists.chains1);
+    }
+
+    lodepng_free(leaves);
+    return error;
 }
 
 /*Create the Huffman tree given the symbol frequencies*/
 static unsigned HuffmanTree_makeFromFrequencies(HuffmanTree* tree, const unsigned* frequencies,
-	size_t mincodes, size_t numcodes, unsigned maxbitlen)
+    size_t mincodes, size_t numcodes, unsigned maxbitlen)
 {
-	unsigned error = 0;
-	while (!frequencies[numcodes - 1] && numcodes > mincodes) --numcodes; /*trim zeroes*/
-	tree->maxbitlen = maxbitlen;
-	tree->numcodes = (unsigned)numcodes; /*number of symbols*/
-	tree->lengths = (unsigned*)lodepng_realloc(tree->lengths, numcodes * sizeof(unsigned));
-	if (!tree->lengths) return 83; /*alloc fail*/
-	/*initialize all lengths to 0*/
-	memset(tree->lengths, 0, numcodes * sizeof(unsigned));
+    unsigned error = 0;
+    while (!frequencies[numcodes - 1] && numcodes > mincodes) --numcodes; /*trim zeroes*/
+    tree->maxbitlen = maxbitlen;
+    tree->numcodes = (unsigned)numcodes; /*number of symbols*/
+    tree->lengths = (unsigned*)lodepng_realloc(tree->lengths, numcodes * sizeof(unsigned));
+    if (!tree->lengths) return 83; /*alloc fail*/
+    /*initialize all lengths to 0*/
+    memset(tree->lengths, 0, numcodes * sizeof(unsigned));
 
-	error = lodepng_huffman_code_lengths(tree->lengths, frequencies, numcodes, maxbitlen);
-	if (!error) error = HuffmanTree_makeFromLengths2(tree);
-	return error;
+    error = lodepng_huffman_code_lengths(tree->lengths, frequencies, numcodes, maxbitlen);
+    if (!error) error = HuffmanTree_makeFromLengths2(tree);
+    return error;
 }
 
 static unsigned HuffmanTree_getCode(const HuffmanTree* tree, unsigned index)
 {
-	return tree->tree1d[index];
+    return tree->tree1d[index];
 }
 
 static unsigned HuffmanTree_getLength(const HuffmanTree* tree, unsigned index)
 {
-	return tree->lengths[index];
+    return tree->lengths[index];
 }
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
 /*get the literal and length code tree of a deflated block with fixed tree, as per the deflate specification*/
 static unsigned generateFixedLitLenTree(HuffmanTree* tree)
 {
-	unsigned i, error = 0;
-	unsigned* bitlen = (unsigned*)lodepng_malloc(NUM_DEFLATE_CODE_SYMBOLS * sizeof(unsigned));
-	if (!bitlen) return 83; /*alloc fail*/
+    unsigned i, error = 0;
+    unsigned* bitlen = (unsigned*)lodepng_malloc(NUM_DEFLATE_CODE_SYMBOLS * sizeof(unsigned));
+    if (!bitlen) return 83; /*alloc fail*/
 
-	/*288 possible codes: 0-255=literals, 256=endcode, 257-285=lengthcodes, 286-287=unused*/
-	for (i = 0; i <= 143; ++i) bitlen[i] = 8;
-	for (i = 144; i <= 255; ++i) bitlen[i] = 9;
-	for (i = 256; i <= 279; ++i) bitlen[i] = 7;
-	for (i = 280; i <= 287; ++i) bitlen[i] = 8;
+    /*288 possible codes: 0-255=literals, 256=endcode, 257-285=lengthcodes, 286-287=unused*/
+    for (i = 0; i <= 143; ++i) bitlen[i] = 8;
+    for (i = 144; i <= 255; ++i) bitlen[i] = 9;
+    for (i = 256; i <= 279; ++i) bitlen[i] = 7;
+    for (i = 280; i <= 287; ++i) bitlen[i] = 8;
 
-	error = HuffmanTree_makeFromLengths(tree, bitlen, NUM_DEFLATE_CODE_SYMBOLS, 15);
+    error = HuffmanTree_makeFromLengths(tree, bitlen, NUM_DEFLATE_CODE_SYMBOLS, 15);
 
-	lodepng_free(bitlen);
-	return error;
+    lodepng_free(bitlen);
+    return error;
 }
 
 /*get the distance code tree of a deflated block with fixed tree, as specified in the deflate specification*/
 static unsigned generateFixedDistanceTree(HuffmanTree* tree)
 {
-	unsigned i, error = 0;
-	unsigned* bitlen = (unsigned*)lodepng_malloc(NUM_DISTANCE_SYMBOLS * sizeof(unsigned));
-	if (!bitlen) return 83; /*alloc fail*/
+    unsigned i, error = 0;
+    unsigned* bitlen = (unsigned*)lodepng_malloc(NUM_DISTANCE_SYMBOLS * sizeof(unsigned));
+    if (!bitlen) return 83; /*alloc fail*/
 
-	/*there are 32 distance codes, but 30-31 are unused*/
-	for (i = 0; i != NUM_DISTANCE_SYMBOLS; ++i) bitlen[i] = 5;
-	error = HuffmanTree_makeFromLengths(tree, bitlen, NUM_DISTANCE_SYMBOLS, 15);
+    /*there are 32 distance codes, but 30-31 are unused*/
+    for (i = 0; i != NUM_DISTANCE_SYMBOLS; ++i) bitlen[i] = 5;
+    error = HuffmanTree_makeFromLengths(tree, bitlen, NUM_DISTANCE_SYMBOLS, 15);
 
-	lodepng_free(bitlen);
-	return error;
+    lodepng_free(bitlen);
+    return error;
 }
 
 #ifdef LODEPNG_COMPILE_DECODER
 
+/*
+Lookup tables decode a Huffman code with one or two reads instead of walking the tree bit by bit. The
+first HUFFMAN_TABLE_BITS bits of the input index the first table. Its entries either hold a symbol and the
+length of its code, or, for longer codes, the index of a second table and HUFFMAN_TABLE_BITS plus the number
+of bits that index it. Deflate stores codes starting with their first bit in the least significant bit,
+so the tables are indexed with the bit reversed codes.
+*/
+#define HUFFMAN_TABLE_BITS 9
+#define HUFFMAN_TABLE_SIZE (1u << HUFFMAN_TABLE_BITS)
+#define HUFFMAN_TABLE_MASK (HUFFMAN_TABLE_SIZE - 1u)
+#define INVALID_SYMBOL 65535u /*table value of codes that are not in the tree*/
+
+static unsigned reverseBits(unsigned bits, unsigned num)
+{
+    unsigned i, result = 0;
+    for (i = 0; i != num; ++i) result |= ((bits >> i) & 1u) << (num - i - 1);
+    return result;
+}
+
+/*makes the lookup tables from the codes in tree1d. return value is error*/
+static unsigned HuffmanTree_makeTable(HuffmanTree* tree)
+{
+    unsigned char maxlens[HUFFMAN_TABLE_SIZE]; /*longest code length starting with each first table index*/
+    unsigned long kraft = 0;
+    size_t size, pointer;
+    unsigned i, n;
+
+    /*codes that use more than all bit combinations would overlap in the tables, see comment in lodepng_error_text*/
+    for (n = 0; n != tree->numcodes; ++n)
+    {
+        if (tree->lengths[n] > 15) return 55;
+        if (tree->lengths[n]) kraft += 1ul << (15 - tree->lengths[n]);
+    }
+    if (kraft > 32768ul) return 55;
+
+    memset(maxlens, 0, sizeof(maxlens));
+    for (n = 0; n != tree->numcodes; ++n)
+    {
+        unsigned l = tree->lengths[n];
+        if (l <= HUFFMAN_TABLE_BITS) continue;
+        i = reverseBits(tree->tree1d[n] >> (l - HUFFMAN_TABLE_BITS), HUFFMAN_TABLE_BITS);
+        if (l > maxlens[i]) maxlens[i] = (unsigned char)l;
+    }
+    size = HUFFMAN_TABLE_SIZE;
+    for (i = 0; i != HUFFMAN_TABLE_SIZE; ++i)
+    {
+        if (maxlens[i] > HUFFMAN_TABLE_BITS) size += (size_t)1u << (maxlens[i] - HUFFMAN_TABLE_BITS);
+    }
+
+    tree->table_len = (unsigned char*)lodepng_malloc(size * sizeof(*tree->table_len));
+    tree->table_value = (unsigned short*)lodepng_malloc(size * sizeof(*tree->table_value));
+    if (!tree->table_len || !tree->table_value) return 83; /*alloc fail*/
+    /*entries of codes that are not in the tree, an incomplete tree has some*/
+    for (i = 0; i != size; ++i)
+    {
+        tree->table_len[i] = 1;
+        tree->table_value[i] = INVALID_SYMBOL;
+    }
+
+    /*point the first table to the second tables, whose entries are marked as invalid by their length too*/
+    pointer = HUFFMAN_TABLE_SIZE;
+    for (i = 0; i != HUFFMAN_TABLE_SIZE; ++i)
+    {
+        size_t j, subsize;
+        if (maxlens[i] <= HUFFMAN_TABLE_BITS) continue;
+        subsize = (size_t)1u << (maxlens[i] - HUFFMAN_TABLE_BITS);
+        tree->table_len[i] = maxlens[i];
+        tree->table_value[i] = (unsigned short)pointer;
+        for (j = 0; j != subsize; ++j) tree->table_len[pointer + j] = maxlens[i];
+        pointer += subsize;
+    }
+
+    /*fill in the codes, a code shorter than a table's index bits fills every entry that starts with it*/
+    for (n = 0; n != tree->numcodes; ++n)
+    {
+        unsigned l = tree->lengths[n];
+        unsigned reverse;
+        if (l == 0) continue;
+        reverse = reverseBits(tree->tree1d[n], l);
+        if (l <= HUFFMAN_TABLE_BITS)
+        {
+            for (i = reverse; i < HUFFMAN_TABLE_SIZE; i += 1u << l)
+            {
+                tree->table_len[i] = (unsigned char)l;
+                tree->table_value[i] = (unsigned short)n;
+            }
+        }
+        else
+        {
+            unsigned first = reverse & HUFFMAN_TABLE_MASK;
+            unsigned subbits = tree->table_len[first] - HUFFMAN_TABLE_BITS;
+            size_t start = tree->table_value[first];
+            for (i = reverse >> HUFFMAN_TABLE_BITS; i < (1u << subbits); i += 1u << (l - HUFFMAN_TABLE_BITS))
+            {
+                tree->table_len[start + i] = (unsigned char)l;
+                tree->table_value[start + i] = (unsigned short)n;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*makes the representation the inflator reads codes with, the 2D tree or the lookup tables*/
+static unsigned HuffmanTree_makeDecoder(HuffmanTree* tree, unsigned bitwise)
+{
+    return bitwise ? HuffmanTree_make2DTree(tree) : HuffmanTree_makeTable(tree);
+}
+
+/*
+Reads the input bits from a 64-bit buffer that is refilled with several bytes at once. After a refill at least 56
+bits are available, enough for a length code, a distance code and their extra bits. Past the end of the input the
+buffer is filled with zeros, the position then goes past the input size, which the inflator checks for.
+The input can be split in segments, like the data of the IDAT chunks of a PNG, that are read as if they were one
+buffer. next_segment returns the segment that follows the given one and its size, or 0 after the last one.
+*/
+typedef const unsigned char* (*NextSegment)(const unsigned char* segment, size_t* size, const void* context);
+
+typedef struct BitReader
+{
+    const unsigned char* data; /*the current segment*/
+    size_t size; /*size of the current segment*/
+    size_t offset; /*position in the input of the first byte of the current segment*/
+    size_t next; /*the next byte of the current segment to load into the buffer*/
+    unsigned long long buffer; /*the next bits of the input, starting at the least significant bit*/
+    unsigned count; /*number of valid bits in the buffer*/
+    NextSegment next_segment; /*0 if there are no more segments*/
+    const void* context; /*given to next_segment*/
+} BitReader;
+
+/*moves on to the next segment that is not empty, returns 0 if there is none*/
+static unsigned BitReader_nextSegment(BitReader* reader)
+{
+    while (reader->next_segment)
+    {
+        size_t size = 0;
+        const unsigned char* data = reader->next_segment(reader->data, &size, reader->context);
+        if (!data)
+        {
+            reader->next_segment = 0;
+            break;
+        }
+        reader->offset += reader->size;
+        reader->next -= reader->size;
+        reader->data = data;
+        reader->size = size;
+        if (reader->next < size) return 1;
+    }
+    return 0;
+}
+
+static void BitReader_refill(BitReader* reader)
+{
+    if (reader->next + 8 <= reader->size)
+    {
+        /*load 8 bytes, the bytes that don't fit completely are loaded again by the next refill*/
+        const unsigned char* p = &reader->data[reader->next];
+        unsigned long long word = (unsigned long long)p[0] | ((unsigned long long)p[1] << 8)
+            | ((unsigned long long)p[2] << 16) | ((unsigned long long)p[3] << 24)
+            | ((unsigned long long)p[4] << 32) | ((unsigned long long)p[5] << 40)
+            | ((unsigned long long)p[6] << 48) | ((unsigned long long)p[7] << 56);
+        reader->buffer |= word << reader->count;
+        reader->next += (63 - reader->count) >> 3;
+        reader->count |= 56;
+    }
+    else
+    {
+        /*near the end of a segment, the bytes are loaded one by one*/
+        while (reader->count <= 56)
+        {
+            unsigned long long byte;
+            if (reader->next >= reader->size) BitReader_nextSegment(reader);
+            byte = reader->next < reader->size ? reader->data[reader->next] : 0;
+            reader->buffer |= byte << reader->count;
+            ++reader->next;
+            reader->count += 8;
+        }
+    }
+}
+
+/*starts reading at the first segment, next_segment can be 0 if the input is a single buffer*/
+static void BitReader_init(BitReader* reader, const unsigned char* data, size_t size,
+    NextSegment next_segment, const void* context)
+{
+    reader->data = data;
+    reader->size = size;
+    reader->offset = 0;
+    reader->next = 0;
+    reader->buffer = 0;
+    reader->count = 0;
+    reader->next_segment = next_segment;
+    reader->context = context;
+    BitReader_refill(reader);
+}
+
+/*the bit pointer in the input of the next bit to read*/
+static size_t BitReader_position(const BitReader* reader)
+{
+    return (reader->offset + reader->next) * 8 - reader->count;
+}
+
+/*reads nbits bits, at most the number of bits in the buffer*/
+static unsigned BitReader_read(BitReader* reader, unsigned nbits)
+{
+    unsigned result = (unsigned)(reader->buffer & ((1ull << nbits) - 1u));
+    reader->buffer >>= nbits;
+    reader->count -= nbits;
+    return result;
+}
+
+/*reads nbits bits, refilling the buffer first if it holds less than that*/
+static unsigned BitReader_readBits(BitReader* reader, unsigned nbits)
+{
+    if (reader->count < nbits) BitReader_refill(reader);
+    return BitReader_read(reader, nbits);
+}
+
+/*copies size bytes to out, or skips them if out is 0. The reader must be at a byte boundary*/
+static void BitReader_copy(BitReader* reader, unsigned char* out, size_t size)
+{
+    /*first the bytes that are already in the buffer*/
+    for (; size != 0 && reader->count >= 8; --size)
+    {
+        if (out) *out++ = (unsigned char)reader->buffer;
+        reader->buffer >>= 8;
+        reader->count -= 8;
+    }
+    if (size == 0) return;
+
+    /*then the rest straight from the segments, the buffer is empty and has to be refilled from the new position*/
+    reader->buffer = 0;
+    while (size != 0)
+    {
+        size_t n = 0;
+        if (reader->next < reader->size || BitReader_nextSegment(reader)) n = reader->size - reader->next;
+        if (n == 0)
+        {
+            /*past the end of the input*/
+            if (out) memset(out, 0, size);
+            reader->next += size;
+            break;
+        }
+        if (n > size) n = size;
+        if (out)
+        {
+            memcpy(out, reader->data + reader->next, n);
+            out += n;
+        }
+        reader->next += n;
+        size -= n;
+    }
+}
+
+/*returns the symbol, or INVALID_SYMBOL if the code is not in the tree. The buffer must hold at least 15 bits*/
+static unsigned huffmanDecodeTable(BitReader* reader, const HuffmanTree* codetree)
+{
+    unsigned index = (unsigned)(reader->buffer & HUFFMAN_TABLE_MASK);
+    unsigned l = codetree->table_len[index];
+    unsigned value = codetree->table_value[index];
+    if (l > HUFFMAN_TABLE_BITS)
+    {
+        /*the code continues in a second table*/
+        index = value + (unsigned)((reader->buffer >> HUFFMAN_TABLE_BITS) & ((1u << (l - HUFFMAN_TABLE_BITS)) - 1u));
+        l = codetree->table_len[index];
+        value = codetree->table_value[index];
+    }
+    reader->buffer >>= l;
+    reader->count -= l;
+    return value;
+}
+
 /*
 returns the code, or (unsigned)(-1) if error happened
 inbitlength is the length of the complete buffer, in bits (so its byte length times 8)
 */
-static unsigned huffmanDecodeSymbol(const unsigned char* in, size_t* bp,
-	const HuffmanTree* codetree, size_t inbitlength)
-{
-	unsigned treepos = 0, ct;
-	for (;;)
-	{
-		if (*bp >= inbitlength) return (unsigned)(-1); /*error: end of input memory reached without endcode*/
-		/*
-		decode the symbol from the tree. The "readBitFromStream" code is inlined in
-		the expression below because this is the biggest bottleneck while decoding
-		*/
-		ct = codetree->tree2d[(treepos << 1) + READBIT(*bp, in)];
-		++(*bp);
-		if (ct < codetree->numcodes) return ct; /*the symbol is decoded, return it*/
-		else treepos = ct - codetree->numcodes; /*symbol not yet decoded, instead move tree position*/
-
-		if (treepos >= codetree->numcodes) return (unsigned)(-1); /*error: it appeared outside the codetree*/
-	}
+static unsigned huffmanDecodeSymbol(BitReader* reader, const HuffmanTree* codetree, size_t inbitlength)
+{
+    unsigned treepos = 0, ct;
+    for (;;)
+    {
+        if (BitReader_position(reader) >= inbitlength) return (unsigned)(-1); /*error: end of input memory reached without endcode*/
+        /*decode the symbol from the tree*/
+        ct = codetree->tree2d[(treepos << 1) + BitReader_readBits(reader, 1)];
+        if (ct < codetree->numcodes) return ct; /*the symbol is decoded, return it*/
+        else treepos = ct - codetree->numcodes; /*symbol not yet decoded, instead move tree position*/
+
+        if (treepos >= codetree->numcodes) return (unsigned)(-1); /*error: it appeared outside the codetree*/
+    }
 }
 #endif /*LODEPNG_COMPILE_DECODER*/
 
@@ -971,341 +1223,471 @@ static unsigned huffmanDecodeSymbol(const unsigned char* in, size_t* bp,
 /* / Inflator (Decompressor)                                                / */
 /* ////////////////////////////////////////////////////////////////////////// */
 
+/*
+Optional streaming output of inflate. Without it the out vector grows to the full decompressed size. With it,
+every time more than INFLATE_STREAM_FLUSH new bytes were produced they are handed to the callback, and only the
+last INFLATE_WINDOW bytes, the longest distance a deflate length code can reach back, are kept in the out vector.
+*/
+#define INFLATE_WINDOW 32768
+#define INFLATE_STREAM_FLUSH 65536
+/*a callback can return this to stop inflating early without an error, the checksum is then not checked*/
+#define INFLATE_STREAM_STOP ((unsigned)(-1))
+
+typedef struct InflateStream
+{
+    unsigned (*callback)(void* user, const unsigned char* data, size_t size); /*returns nonzero error code to stop*/
+    void* user;
+    size_t delivered; /*bytes at the start of the out vector that were already given to the callback*/
+    unsigned adler; /*running adler32 of all bytes given to the callback*/
+} InflateStream;
+
+static unsigned update_adler32(unsigned adler, const unsigned char* data, unsigned len);
+
+/*gives the new bytes to the stream callback and, unless this is the final flush, drops all but the window*/
+static unsigned inflateStreamFlush(ucvector* out, size_t* pos, InflateStream* stream, unsigned final)
+{
+    if (*pos > stream->delivered)
+    {
+        unsigned error = stream->callback(stream->user, out->data + stream->delivered, *pos - stream->delivered);
+        if (error) return error;
+        stream->adler = update_adler32(stream->adler, out->data + stream->delivered, (unsigned)(*pos - stream->delivered));
+    }
+    if (!final && *pos > INFLATE_WINDOW)
+    {
+        memmove(out->data, out->data + *pos - INFLATE_WINDOW, INFLATE_WINDOW);
+        *pos = INFLATE_WINDOW;
+        out->size = INFLATE_WINDOW;
+    }
+    stream->delivered = *pos;
+    return 0;
+}
+
 /*get the tree of a deflated block with fixed tree, as specified in the deflate specification*/
-static void getTreeInflateFixed(HuffmanTree* tree_ll, HuffmanTree* tree_d)
+static unsigned getTreeInflateFixed(HuffmanTree* tree_ll, HuffmanTree* tree_d, unsigned bitwise)
 {
-	/*TODO: check for out of memory errors*/
-	generateFixedLitLenTree(tree_ll);
-	generateFixedDistanceTree(tree_d);
+    unsigned error = generateFixedLitLenTree(tree_ll);
+    if (!error) error = generateFixedDistanceTree(tree_d);
+    if (!error) error = HuffmanTree_makeDecoder(tree_ll, bitwise);
+    if (!error) error = HuffmanTree_makeDecoder(tree_d, bitwise);
+    return error;
 }
 
 /*get the tree of a deflated block with dynamic tree, the tree itself is also Huffman compressed with a known tree*/
 static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
-	const unsigned char* in, size_t* bp, size_t inlength)
-{
-	/*make sure that length values that aren't filled in will be 0, or a wrong tree will be generated*/
-	unsigned error = 0;
-	unsigned n, HLIT, HDIST, HCLEN, i;
-	size_t inbitlength = inlength * 8;
-
-	/*see comments in deflateDynamic for explanation of the context and these variables, it is analogous*/
-	unsigned* bitlen_ll = 0; /*lit,len code lengths*/
-	unsigned* bitlen_d = 0; /*dist code lengths*/
-	/*code length code lengths ("clcl"), the bit lengths of the huffman tree used to compress bitlen_ll and bitlen_d*/
-	unsigned* bitlen_cl = 0;
-	HuffmanTree tree_cl; /*the code tree for code length codes (the huffman tree for compressed huffman trees)*/
-
-	if ((*bp) + 14 > (inlength << 3)) return 49; /*error: the bit pointer is or will go past the memory*/
-
-	/*number of literal/length codes + 257. Unlike the spec, the value 257 is added to it here already*/
-	HLIT = readBitsFromStream(bp, in, 5) + 257;
-	/*number of distance codes. Unlike the spec, the value 1 is added to it here already*/
-	HDIST = readBitsFromStream(bp, in, 5) + 1;
-	/*number of code length codes. Unlike the spec, the value 4 is added to it here already*/
-	HCLEN = readBitsFromStream(bp, in, 4) + 4;
-
-	if ((*bp) + HCLEN * 3 > (inlength << 3)) return 50; /*error: the bit pointer is or will go past the memory*/
-
-	HuffmanTree_init(&tree_cl);
-
-	while (!error)
-	{
-		/*read the code length codes out of 3 * (amount of code length codes) bits*/
-
-		bitlen_cl = (unsigned*)lodepng_malloc(NUM_CODE_LENGTH_CODES * sizeof(unsigned));
-		if (!bitlen_cl) ERROR_BREAK(83 /*alloc fail*/);
-
-		for (i = 0; i != NUM_CODE_LENGTH_CODES; ++i)
-		{
-			if (i < HCLEN) bitlen_cl[CLCL_ORDER[i]] = readBitsFromStream(bp, in, 3);
-			else bitlen_cl[CLCL_ORDER[i]] = 0; /*if not, it must stay 0*/
-		}
-
-		error = HuffmanTree_makeFromLengths(&tree_cl, bitlen_cl, NUM_CODE_LENGTH_CODES, 7);
-		if (error) break;
-
-		/*now we can use this tree to read the lengths for the tree that this function will return*/
-		bitlen_ll = (unsigned*)lodepng_malloc(NUM_DEFLATE_CODE_SYMBOLS * sizeof(unsigned));
-		bitlen_d = (unsigned*)lodepng_malloc(NUM_DISTANCE_SYMBOLS * sizeof(unsigned));
-		if (!bitlen_ll || !bitlen_d) ERROR_BREAK(83 /*alloc fail*/);
-		for (i = 0; i != NUM_DEFLATE_CODE_SYMBOLS; ++i) bitlen_ll[i] = 0;
-		for (i = 0; i != NUM_DISTANCE_SYMBOLS; ++i) bitlen_d[i] = 0;
-
-		/*i is the current symbol we're reading in the part that contains the code lengths of lit/len and dist codes*/
-		i = 0;
-		while (i < HLIT + HDIST)
-		{
-			unsigned code = huffmanDecodeSymbol(in, bp, &tree_cl, inbitlength);
-			if (code <= 15) /*a length code*/
-			{
-				if (i < HLIT) bitlen_ll[i] = code;
-				else bitlen_d[i - HLIT] = code;
-				++i;
-			}
-			else if (code == 16) /*repeat previous*/
-			{
-				unsigned replength = 3; /*read in the 2 bits that indicate repeat length (3-6)*/
-				unsigned value; /*set value to the previous code*/
-
-				if (i == 0) ERROR_BREAK(54); /*can't repeat previous if i is 0*/
-
-				if ((*bp + 2) > inbitlength) ERROR_BREAK(50); /*error, bit pointer jumps past memory*/
-				replength += readBitsFromStream(bp, in, 2);
-
-				if (i < HLIT + 1) value = bitlen_ll[i - 1];
-				else value = bitlen_d[i - HLIT - 1];
-				/*repeat this value in the next lengths*/
-				for (n = 0; n < replength; ++n)
-				{
-					if (i >= HLIT + HDIST) ERROR_BREAK(13); /*error: i is larger than the amount of codes*/
-					if (i < HLIT) bitlen_ll[i] = value;
-					else bitlen_d[i - HLIT] = value;
-					++i;
-				}
-			}
-			else if (code == 17) /*repeat "0" 3-10 times*/
-			{
-				unsigned replength = 3; /*read in the bits that indicate repeat length*/
-				if ((*bp + 3) > inbitlength) ERROR_BREAK(50); /*error, bit pointer jumps past memory*/
-				replength += readBitsFromStream(bp, in, 3);
-
-				/*repeat this value in the next lengths*/
-				for (n = 0; n < replength; ++n)
-				{
-					if (i >= HLIT + HDIST) ERROR_BREAK(14); /*error: i is larger than the amount of codes*/
-
-					if (i < HLIT) bitlen_ll[i] = 0;
-					else bitlen_d[i - HLIT] = 0;
-					++i;
-				}
-			}
-			else if (code == 18) /*repeat "0" 11-138 times*/
-			{
-				unsigned replength = 11; /*read in the bits that indicate repeat length*/
-				if ((*bp + 7) > inbitlength) ERROR_BREAK(50); /*error, bit pointer jumps past memory*/
-				replength += readBitsFromStream(bp, in, 7);
-
-				/*repeat this value in the next lengths*/
-				for (n = 0; n < replength; ++n)
-				{
-					if (i >= HLIT + HDIST) ERROR_BREAK(15); /*error: i is larger than the amount of codes*/
-
-					if (i < HLIT) bitlen_ll[i] = 0;
-					else bitlen_d[i - HLIT] = 0;
-					++i;
-				}
-			}
-			else /*if(code == (unsigned)(-1))*/ /*huffmanDecodeSymbol returns (unsigned)(-1) in case of error*/
-			{
-				if (code == (unsigned)(-1))
-				{
-					/*return error code 10 or 11 depending on the situation that happened in huffmanDecodeSymbol
-					(10=no endcode, 11=wrong jump outside of tree)*/
-					error = (*bp) > inbitlength ? 10 : 11;
-				}
-				else error = 16; /*unexisting code, this can never happen*/
-				break;
-			}
-		}
-		if (error) break;
-
-		if (bitlen_ll[256] == 0) ERROR_BREAK(64); /*the length of the end code 256 must be larger than 0*/
-
-		/*now we've finally got HLIT and HDIST, so generate the code trees, and the function is done*/
-		error = HuffmanTree_makeFromLengths(tree_ll, bitlen_ll, NUM_DEFLATE_CODE_SYMBOLS, 15);
-		if (error) break;
-		error = HuffmanTree_makeFromLengths(tree_d, bitlen_d, NUM_DISTANCE_SYMBOLS, 15);
-
-		break; /*end of error-while*/
-	}
-
-	lodepng_free(bitlen_cl);
-	lodepng_free(bitlen_ll);
-	lodepng_free(bitlen_d);
-	HuffmanTree_cleanup(&tree_cl);
-
-	return error;
-}
-
-/*inflate a block with dynamic of fixed Huffman tree*/
-static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size_t* bp,
-	size_t* pos, size_t inlength, unsigned btype)
-{
-	unsigned error = 0;
-	HuffmanTree tree_ll; /*the huffman tree for literal and length codes*/
-	HuffmanTree tree_d; /*the huffman tree for distance codes*/
-	size_t inbitlength = inlength * 8;
-
-	HuffmanTree_init(&tree_ll);
-	HuffmanTree_init(&tree_d);
-
-	if (btype == 1) getTreeInflateFixed(&tree_ll, &tree_d);
-	else if (btype == 2) error = getTreeInflateDynamic(&tree_ll, &tree_d, in, bp, inlength);
-
-	while (!error) /*decode all symbols until end reached, breaks at end code*/
-	{
-		/*code_ll is literal, length or end code*/
-		unsigned code_ll = huffmanDecodeSymbol(in, bp, &tree_ll, inbitlength);
-		if (code_ll <= 255) /*literal symbol*/
-		{
-			/*ucvector_push_back would do the same, but for some reason the two lines below run 10% faster*/
-			if (!ucvector_resize(out, (*pos) + 1)) ERROR_BREAK(83 /*alloc fail*/);
-			out->data[*pos] = (unsigned char)code_ll;
-			++(*pos);
-		}
-		else if (code_ll >= FIRST_LENGTH_CODE_INDEX && code_ll <= LAST_LENGTH_CODE_INDEX) /*length code*/
-		{
-			unsigned code_d, distance;
-			unsigned numextrabits_l, numextrabits_d; /*extra bits for length and distance*/
-			size_t start, forward, backward, length;
-
-			/*part 1: get length base*/
-			length = LENGTHBASE[code_ll - FIRST_LENGTH_CODE_INDEX];
-
-			/*part 2: get extra bits and add the value of that to length*/
-			numextrabits_l = LENGTHEXTRA[code_ll - FIRST_LENGTH_CODE_INDEX];
-			if ((*bp + numextrabits_l) > inbitlength) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
-			length += readBitsFromStream(bp, in, numextrabits_l);
-
-			/*part 3: get distance code*/
-			code_d = huffmanDecodeSymbol(in, bp, &tree_d, inbitlength);
-			if (code_d > 29)
-			{
-				if (code_ll == (unsigned)(-1)) /*huffmanDecodeSymbol returns (unsigned)(-1) in case of error*/
-				{
-					/*return error code 10 or 11 depending on the situation that happened in huffmanDecodeSymbol
-					(10=no endcode, 11=wrong jump outside of tree)*/
-					error = (*bp) > inlength * 8 ? 10 : 11;
-				}
-				else error = 18; /*error: invalid distance code (30-31 are never used)*/
-				break;
-			}
-			distance = DISTANCEBASE[code_d];
-
-			/*part 4: get extra bits from distance*/
-			numextrabits_d = DISTANCEEXTRA[code_d];
-			if ((*bp + numextrabits_d) > inbitlength) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
-			distance += readBitsFromStream(bp, in, numextrabits_d);
-
-			/*part 5: fill in all the out[n] values based on the length and dist*/
-			start = (*pos);
-			if (distance > start) ERROR_BREAK(52); /*too long backward distance*/
-			backward = start - distance;
-
-			if (!ucvector_resize(out, (*pos) + length)) ERROR_BREAK(83 /*alloc fail*/);
-			if (distance < length) {
-				for (forward = 0; forward < length; ++forward)
-				{
-					out->data[(*pos)++] = out->data[backward++];
-				}
-			}
-			else {
-				memcpy(out->data + *pos, out->data + backward, length);
-				*pos += length;
-			}
-		}
-		else if (code_ll == 256)
-		{
-			break; /*end code, break the loop*/
-		}
-		else /*if(code == (unsigned)(-1))*/ /*huffmanDecodeSymbol returns (unsigned)(-1) in case of error*/
-		{
-			/*return error code 10 or 11 depending on the situation that happened in huffmanDecodeSymbol
-			(10=no endcode, 11=wrong jump outside of tree)*/
-			error = ((*bp) > inlength * 8) ? 10 : 11;
-			break;
-		}
-	}
-
-	HuffmanTree_cleanup(&tree_ll);
-	HuffmanTree_cleanup(&tree_d);
-
-	return error;
-}
-
-static unsigned inflateNoCompression(ucvector* out, const unsigned char* in, size_t* bp, size_t* pos, size_t inlength)
-{
-	size_t p;
-	unsigned LEN, NLEN, n, error = 0;
-
-	/*go to first boundary of byte*/
-	while (((*bp) & 0x7) != 0) ++(*bp);
-	p = (*bp) / 8; /*byte position*/
-
-	/*read LEN (2 bytes) and NLEN (2 bytes)*/
-	if (p + 4 >= inlength) return 52; /*error, bit pointer will jump past memory*/
-	LEN = in[p] + 256u * in[p + 1]; p += 2;
-	NLEN = in[p] + 256u * in[p + 1]; p += 2;
-
-	/*check if 16-bit NLEN is really the one's complement of LEN*/
-	if (LEN + NLEN != 65535) return 21; /*error: NLEN is not one's complement of LEN*/
-
-	if (!ucvector_resize(out, (*pos) + LEN)) return 83; /*alloc fail*/
-
-	/*read the literal data: LEN bytes are now stored in the out buffer*/
-	if (p + LEN > inlength) return 23; /*error: reading outside of in buffer*/
-	for (n = 0; n < LEN; ++n) out->data[(*pos)++] = in[p++];
-
-	(*bp) = p * 8;
-
-	return error;
-}
-
-static unsigned lodepng_inflatev(ucvector* out,
-	const unsigned char* in, size_t insize,
-	const LodePNGDecompressSettings* settings)
-{
-	/*bit pointer in the "in" data, current byte is bp >> 3, current bit is bp & 0x7 (from lsb to msb of the byte)*/
-	size_t bp = 0;
-	unsigned BFINAL = 0;
-	size_t pos = 0; /*byte position in the out buffer*/
-	unsigned error = 0;
-
-	(void)settings;
-
-	while (!BFINAL)
-	{
-		unsigned BTYPE;
-		if (bp + 2 >= insize * 8) return 52; /*error, bit pointer will jump past memory*/
-		BFINAL = readBitFromStream(&bp, in);
-		BTYPE = 1u * readBitFromStream(&bp, in);
-		BTYPE += 2u * readBitFromStream(&bp, in);
-
-		if (BTYPE == 3) return 20; /*error: invalid BTYPE*/
-		else if (BTYPE == 0) error = inflateNoCompression(out, in, &bp, &pos, insize); /*no compression*/
-		else error = inflateHuffmanBlock(out, in, &bp, &pos, insize, BTYPE); /*compression, BTYPE 01 or 10*/
-
-		if (error) return error;
-	}
-
-	return error;
+    BitReader* reader, size_t inlength, unsigned bitwise)
+{
+    /*make sure that length values that aren't filled in will be 0, or a wrong tree will be generated*/
+    unsigned error = 0;
+    unsigned n, HLIT, HDIST, HCLEN, i;
+    size_t inbitlength = inlength * 8;
+
+    /*see comments in deflateDynamic for explanation of the context and these variables, it is analogous*/
+    unsigned* bitlen_ll = 0; /*lit,len code lengths*/
+    unsigned* bitlen_d = 0; /*dist code lengths*/
+    /*code length code lengths ("clcl"), the bit lengths of the huffman tree used to compress bitlen_ll and bitlen_d*/
+    unsigned* bitlen_cl = 0;
+    HuffmanTree tree_cl; /*the code tree for code length codes (the huffman tree for compressed huffman trees)*/
+
+    if (BitReader_position(reader) + 14 > (inlength << 3)) return 49; /*error: the bit pointer is or will go past the memory*/
+
+    /*number of literal/length codes + 257. Unlike the spec, the value 257 is added to it here already*/
+    HLIT = BitReader_readBits(reader, 5) + 257;
+    /*number of distance codes. Unlike the spec, the value 1 is added to it here already*/
+    HDIST = BitReader_readBits(reader, 5) + 1;
+    /*number of code length codes. Unlike the spec, the value 4 is added to it here already*/
+    HCLEN = BitReader_readBits(reader, 4) + 4;
+
+    if (BitReader_position(reader) + HCLEN * 3 > (inlength << 3)) return 50; /*error: the bit pointer is or will go past the memory*/
+
+    HuffmanTree_init(&tree_cl);
+
+    while (!error)
+    {
+        /*read the code length codes out of 3 * (amount of code length codes) bits*/
+
+        bitlen_cl = (unsigned*)lodepng_malloc(NUM_CODE_LENGTH_CODES * sizeof(unsigned));
+        if (!bitlen_cl) ERROR_BREAK(83 /*alloc fail*/);
+
+        for (i = 0; i != NUM_CODE_LENGTH_CODES; ++i)
+        {
+            if (i < HCLEN) bitlen_cl[CLCL_ORDER[i]] = BitReader_readBits(reader, 3);
+            else bitlen_cl[CLCL_ORDER[i]] = 0; /*if not, it must stay 0*/
+        }
+
+        error = HuffmanTree_makeFromLengths(&tree_cl, bitlen_cl, NUM_CODE_LENGTH_CODES, 7);
+        if (!error) error = HuffmanTree_make2DTree(&tree_cl); /*few codes are read with it, so bit by bit is fine*/
+        if (error) break;
+
+        /*now we can use this tree to read the lengths for the tree that this function will return*/
+        bitlen_ll = (unsigned*)lodepng_malloc(NUM_DEFLATE_CODE_SYMBOLS * sizeof(unsigned));
+        bitlen_d = (unsigned*)lodepng_malloc(NUM_DISTANCE_SYMBOLS * sizeof(unsigned));
+        if (!bitlen_ll || !bitlen_d) ERROR_BREAK(83 /*alloc fail*/);
+        for (i = 0; i != NUM_DEFLATE_CODE_SYMBOLS; ++i) bitlen_ll[i] = 0;
+        for (i = 0; i != NUM_DISTANCE_SYMBOLS; ++i) bitlen_d[i] = 0;
+
+        /*i is the current symbol we're reading in the part that contains the code lengths of lit/len and dist codes*/
+        i = 0;
+        while (i < HLIT + HDIST)
+        {
+            unsigned code = huffmanDecodeSymbol(reader, &tree_cl, inbitlength);
+            if (code <= 15) /*a length code*/
+            {
+                if (i < HLIT) bitlen_ll[i] = code;
+                else bitlen_d[i - HLIT] = code;
+                ++i;
+            }
+            else if (code == 16) /*repeat previous*/
+            {
+                unsigned replength = 3; /*read in the 2 bits that indicate repeat length (3-6)*/
+                unsigned value; /*set value to the previous code*/
+
+                if (i == 0) ERROR_BREAK(54); /*can't repeat previous if i is 0*/
+
+                if ((BitReader_position(reader) + 2) > inbitlength) ERROR_BREAK(50); /*error, bit pointer jumps past memory*/
+                replength += BitReader_readBits(reader, 2);
+
+                if (i < HLIT + 1) value = bitlen_ll[i - 1];
+                else value = bitlen_d[i - HLIT - 1];
+                /*repeat this value in the next lengths*/
+                for (n = 0; n < replength; ++n)
+                {
+                    if (i >= HLIT + HDIST) ERROR_BREAK(13); /*error: i is larger than the amount of codes*/
+                    if (i < HLIT) bitlen_ll[i] = value;
+                    else bitlen_d[i - HLIT] = value;
+                    ++i;
+                }
+            }
+            else if (code == 17) /*repeat "0" 3-10 times*/
+            {
+                unsigned replength = 3; /*read in the bits that indicate repeat length*/
+                if ((BitReader_position(reader) + 3) > inbitlength) ERROR_BREAK(50); /*error, bit pointer jumps past memory*/
+                replength += BitReader_readBits(reader, 3);
+
+                /*repeat this value in the next lengths*/
+                for (n = 0; n < replength; ++n)
+                {
+                    if (i >= HLIT + HDIST) ERROR_BREAK(14); /*error: i is larger than the amount of codes*/
+
+                    if (i < HLIT) bitlen_ll[i] = 0;
+                    else bitlen_d[i - HLIT] = 0;
+                    ++i;
+                }
+            }
+            else if (code == 18) /*repeat "0" 11-138 times*/
+            {
+                unsigned replength = 11; /*read in the bits that indicate repeat length*/
+                if ((BitReader_position(reader) + 7) > inbitlength) ERROR_BREAK(50); /*error, bit pointer jumps past memory*/
+                replength += BitReader_readBits(reader, 7);
+
+                /*repeat this value in the next lengths*/
+                for (n = 0; n < replength; ++n)
+                {
+                    if (i >= HLIT + HDIST) ERROR_BREAK(15); /*error: i is larger than the amount of codes*/
+
+                    if (i < HLIT) bitlen_ll[i] = 0;
+                    else bitlen_d[i - HLIT] = 0;
+                    ++i;
+                }
+            }
+            else /*if(code == (unsigned)(-1))*/ /*huffmanDecodeSymbol returns (unsigned)(-1) in case of error*/
+            {
+                if (code == (unsigned)(-1))
+                {
+                    /*return error code 10 or 11 depending on the situation that happened in huffmanDecodeSymbol
+                    (10=no endcode, 11=wrong jump outside of tree)*/
+                    error = BitReader_position(reader) > inbitlength ? 10 : 11;
+                }
+                else error = 16; /*unexisting code, this can never happen*/
+                break;
+            }
+        }
+        if (error) break;
+
+        if (bitlen_ll[256] == 0) ERROR_BREAK(64); /*the length of the end code 256 must be larger than 0*/
+
+        /*now we've finally got HLIT and HDIST, so generate the code trees, and the function is done*/
+        error = HuffmanTree_makeFromLengths(tree_ll, bitlen_ll, NUM_DEFLATE_CODE_SYMBOLS, 15);
+        if (!error) error = HuffmanTree_makeFromLengths(tree_d, bitlen_d, NUM_DISTANCE_SYMBOLS, 15);
+        if (!error) error = HuffmanTree_makeDecoder(tree_ll, bitwise);
+        if (!error) error = HuffmanTree_makeDecoder(tree_d, bitwise);
+
+        break; /*end of error-while*/
+    }
+
+    lodepng_free(bitlen_cl);
+    lodepng_free(bitlen_ll);
+    lodepng_free(bitlen_d);
+    HuffmanTree_cleanup(&tree_cl);
+
+    return error;
+}
+
+/*inflate a block with dynamic of fixed Huffman tree, reading the codes bit by bit by walking the trees*/
+static unsigned inflateHuffmanBlock(ucvector* out, BitReader* reader,
+    size_t* pos, size_t inlength, unsigned btype, InflateStream* stream)
+{
+    unsigned error = 0;
+    HuffmanTree tree_ll; /*the huffman tree for literal and length codes*/
+    HuffmanTree tree_d; /*the huffman tree for distance codes*/
+    size_t inbitlength = inlength * 8;
+
+    HuffmanTree_init(&tree_ll);
+    HuffmanTree_init(&tree_d);
+
+    if (btype == 1) error = getTreeInflateFixed(&tree_ll, &tree_d, 1);
+    else if (btype == 2) error = getTreeInflateDynamic(&tree_ll, &tree_d, reader, inlength, 1);
+
+    while (!error) /*decode all symbols until end reached, breaks at end code*/
+    {
+        /*code_ll is literal, length or end code*/
+        unsigned code_ll;
+        if (stream && *pos >= INFLATE_WINDOW + INFLATE_STREAM_FLUSH)
+        {
+            error = inflateStreamFlush(out, pos, stream, 0);
+            if (error) break;
+        }
+        code_ll = huffmanDecodeSymbol(reader, &tree_ll, inbitlength);
+        if (code_ll <= 255) /*literal symbol*/
+        {
+            /*ucvector_push_back would do the same, but for some reason the two lines below run 10% faster*/
+            if (!ucvector_resize(out, (*pos) + 1)) ERROR_BREAK(83 /*alloc fail*/);
+            out->data[*pos] = (unsigned char)code_ll;
+            ++(*pos);
+        }
+        else if (code_ll >= FIRST_LENGTH_CODE_INDEX && code_ll <= LAST_LENGTH_CODE_INDEX) /*length code*/
+        {
+            unsigned code_d, distance;
+            unsigned numextrabits_l, numextrabits_d; /*extra bits for length and distance*/
+            size_t start, forward, backward, length;
+
+            /*part 1: get length base*/
+            length = LENGTHBASE[code_ll - FIRST_LENGTH_CODE_INDEX];
+
+            /*part 2: get extra bits and add the value of that to length*/
+            numextrabits_l = LENGTHEXTRA[code_ll - FIRST_LENGTH_CODE_INDEX];
+            if ((BitReader_position(reader) + numextrabits_l) > inbitlength) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
+            length += BitReader_readBits(reader, numextrabits_l);
+
+            /*part 3: get distance code*/
+            code_d = huffmanDecodeSymbol(reader, &tree_d, inbitlength);
+            if (code_d > 29)
+            {
+                if (code_ll == (unsigned)(-1)) /*huffmanDecodeSymbol returns (unsigned)(-1) in case of error*/
+                {
+                    /*return error code 10 or 11 depending on the situation that happened in huffmanDecodeSymbol
+                    (10=no endcode, 11=wrong jump outside of tree)*/
+                    error = BitReader_position(reader) > inlength * 8 ? 10 : 11;
+                }
+                else error = 18; /*error: invalid distance code (30-31 are never used)*/
+                break;
+            }
+            distance = DISTANCEBASE[code_d];
+
+            /*part 4: get extra bits from distance*/
+            numextrabits_d = DISTANCEEXTRA[code_d];
+            if ((BitReader_position(reader) + numextrabits_d) > inbitlength) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
+            distance += BitReader_readBits(reader, numextrabits_d);
+
+            /*part 5: fill in all the out[n] values based on the length and dist*/
+            start = (*pos);
+            if (distance > start) ERROR_BREAK(52); /*too long backward distance*/
+            backward = start - distance;
+
+            if (!ucvector_resize(out, (*pos) + length)) ERROR_BREAK(83 /*alloc fail*/);
+            if (distance < length) {
+                for (forward = 0; forward < length; ++forward)
+                {
+                    out->data[(*pos)++] = out->data[backward++];
+                }
+            }
+            else {
+                memcpy(out->data + *pos, out->data + backward, length);
+                *pos += length;
+            }
+        }
+        else if (code_ll == 256)
+        {
+            break; /*end code, break the loop*/
+        }
+        else /*if(code == (unsigned)(-1))*/ /*huffmanDecodeSymbol returns (unsigned)(-1) in case of error*/
+        {
+            /*return error code 10 or 11 depending on the situation that happened in huffmanDecodeSymbol
+            (10=no endcode, 11=wrong jump outside of tree)*/
+            error = (BitReader_position(reader) > inlength * 8) ? 10 : 11;
+            break;
+        }
+    }
+
+    HuffmanTree_cleanup(&tree_ll);
+    HuffmanTree_cleanup(&tree_d);
+
+    return error;
+}
+
+/*inflate a block with dynamic of fixed Huffman tree, reading the codes with lookup tables*/
+static unsigned inflateHuffmanBlockTable(ucvector* out, BitReader* reader,
+    size_t* pos, size_t inlength, unsigned btype, InflateStream* stream)
+{
+    unsigned error = 0;
+    HuffmanTree tree_ll; /*the huffman tree for literal and length codes*/
+    HuffmanTree tree_d; /*the huffman tree for distance codes*/
+    size_t inbitlength = inlength * 8;
+
+    HuffmanTree_init(&tree_ll);
+    HuffmanTree_init(&tree_d);
+
+    if (btype == 1) error = getTreeInflateFixed(&tree_ll, &tree_d, 0);
+    else if (btype == 2) error = getTreeInflateDynamic(&tree_ll, &tree_d, reader, inlength, 0);
+
+    while (!error) /*decode all symbols until end reached, breaks at end code*/
+    {
+        /*code_ll is literal, length or end code*/
+        unsigned code_ll;
+        if (stream && *pos >= INFLATE_WINDOW + INFLATE_STREAM_FLUSH)
+        {
+            error = inflateStreamFlush(out, pos, stream, 0);
+            if (error) break;
+        }
+        BitReader_refill(reader); /*enough bits for all the codes of one symbol*/
+        code_ll = huffmanDecodeTable(reader, &tree_ll);
+        if (BitReader_position(reader) > inbitlength) ERROR_BREAK(10); /*error: end of input memory reached without endcode*/
+        if (code_ll <= 255) /*literal symbol*/
+        {
+            if (!ucvector_resize(out, (*pos) + 1)) ERROR_BREAK(83 /*alloc fail*/);
+            out->data[*pos] = (unsigned char)code_ll;
+            ++(*pos);
+        }
+        else if (code_ll >= FIRST_LENGTH_CODE_INDEX && code_ll <= LAST_LENGTH_CODE_INDEX) /*length code*/
+        {
+            unsigned code_d, distance;
+            size_t start, forward, backward, length;
+
+            /*get length base and the extra bits added to it*/
+            length = LENGTHBASE[code_ll - FIRST_LENGTH_CODE_INDEX];
+            length += BitReader_read(reader, LENGTHEXTRA[code_ll - FIRST_LENGTH_CODE_INDEX]);
+            if (BitReader_position(reader) > inbitlength) ERROR_BREAK(51); /*error, bit pointer jumped past memory*/
+
+            /*get distance code, its base and the extra bits added to it*/
+            code_d = huffmanDecodeTable(reader, &tree_d);
+            if (BitReader_position(reader) > inbitlength) ERROR_BREAK(10); /*error: end of input memory reached*/
+            if (code_d > 29) ERROR_BREAK(18); /*error: invalid distance code (30-31 are never used)*/
+            distance = DISTANCEBASE[code_d];
+            distance += BitReader_read(reader, DISTANCEEXTRA[code_d]);
+            if (BitReader_position(reader) > inbitlength) ERROR_BREAK(51); /*error, bit pointer jumped past memory*/
+
+            /*fill in all the out[n] values based on the length and dist*/
+            start = (*pos);
+            if (distance > start) ERROR_BREAK(52); /*too long backward distance*/
+            backward = start - distance;
+
+            if (!ucvector_resize(out, (*pos) + length)) ERROR_BREAK(83 /*alloc fail*/);
+            if (distance < length) {
+                for (forward = 0; forward < length; ++forward)
+                {
+                    out->data[(*pos)++] = out->data[backward++];
+                }
+            }
+            else {
+                memcpy(out->data + *pos, out->data + backward, length);
+                *pos += length;
+            }
+        }
+        else if (code_ll == 256)
+        {
+            break; /*end code, break the loop*/
+        }
+        else ERROR_BREAK(11); /*error: a code that is not in the tree*/
+    }
+    HuffmanTree_cleanup(&tree_ll);
+    HuffmanTree_cleanup(&tree_d);
+
+    return error;
+}
+
+static unsigned inflateNoCompression(ucvector* out, BitReader* reader, size_t* pos, size_t inlength)
+{
+    size_t p;
+    unsigned LEN, NLEN;
+
+    /*go to first boundary of byte*/
+    BitReader_read(reader, reader->count & 7);
+    p = BitReader_position(reader) / 8; /*byte position*/
+
+    /*read LEN (2 bytes) and NLEN (2 bytes)*/
+    if (p + 4 >= inlength) return 52; /*error, bit pointer will jump past memory*/
+    LEN = BitReader_readBits(reader, 16);
+    NLEN = BitReader_readBits(reader, 16);
+    p += 4;
+
+    /*check if 16-bit NLEN is really the one's complement of LEN*/
+    if (LEN + NLEN != 65535) return 21; /*error: NLEN is not one's complement of LEN*/
+
+    if (!ucvector_resize(out, (*pos) + LEN)) return 83; /*alloc fail*/
+
+    /*read the literal data: LEN bytes are now stored in the out buffer*/
+    if (p + LEN > inlength) return 23; /*error: reading outside of in buffer*/
+    BitReader_copy(reader, out->data + *pos, LEN);
+    *pos += LEN;
+
+    return 0;
+}
+
+/*inflates the deflate data that the reader is at, inlength is the size of its whole input*/
+static unsigned lodepng_inflatev(ucvector* out, BitReader* reader, size_t inlength,
+    const LodePNGDecompressSettings* settings, InflateStream* stream)
+{
+    unsigned BFINAL = 0;
+    size_t pos = 0; /*byte position in the out buffer*/
+    unsigned error = 0;
+
+    while (!BFINAL)
+    {
+        unsigned BTYPE;
+        if (BitReader_position(reader) + 2 >= inlength * 8) return 52; /*error, bit pointer will jump past memory*/
+        BFINAL = BitReader_readBits(reader, 1);
+        BTYPE = BitReader_readBits(reader, 2);
+
+        if (BTYPE == 3) return 20; /*error: invalid BTYPE*/
+        else if (BTYPE == 0) error = inflateNoCompression(out, reader, &pos, inlength); /*no compression*/
+        else if (settings->bitwise_huffman) error = inflateHuffmanBlock(out, reader, &pos, inlength, BTYPE, stream);
+        else error = inflateHuffmanBlockTable(out, reader, &pos, inlength, BTYPE, stream); /*compression, BTYPE 01 or 10*/
+
+        /*stored blocks can add up to 64K at once, so the stream is also flushed between blocks*/
+        if (!error && stream && pos >= INFLATE_WINDOW + INFLATE_STREAM_FLUSH) error = inflateStreamFlush(out, &pos, stream, 0);
+        if (error) return error;
+    }
+
+    if (stream) error = inflateStreamFlush(out, &pos, stream, 1);
+    return error;
 }
 
 unsigned lodepng_inflate(unsigned char** out, size_t* outsize,
-	const unsigned char* in, size_t insize,
-	const LodePNGDecompressSettings* settings)
+    const unsigned char* in, size_t insize,
+    const LodePNGDecompressSettings* settings)
 {
-	unsigned error;
-	ucvector v;
-	ucvector_init_buffer(&v, *out, *outsize);
-	error = lodepng_inflatev(&v, in, insize, settings);
-	*out = v.data;
-	*outsize = v.size;
-	return error;
+    unsigned error;
+    ucvector v;
+    BitReader reader;
+    ucvector_init_buffer(&v, *out, *outsize);
+    BitReader_init(&reader, in, insize, 0, 0);
+    error = lodepng_inflatev(&v, &reader, insize, settings, 0);
+    *out = v.data;
+    *outsize = v.size;
+    return error;
 }
 
 static unsigned inflate(unsigned char** out, size_t* outsize,
-	const unsigned char* in, size_t insize,
-	const LodePNGDecompressSettings* settings)
+    const unsigned char* in, size_t insize,
+    const LodePNGDecompressSettings* settings)
 {
-	if (settings->custom_inflate)
-	{
-		return settings->custom_inflate(out, outsize, in, insize, settings);
-	}
-	else
-	{
-		return lodepng_inflate(out, outsize, in, insize, settings);
-	}
+    if (settings->custom_inflate)
+    {
+        return settings->custom_inflate(out, outsize, in, insize, settings);
+    }
+    else
+    {
+        return lodepng_inflate(out, outsize, in, insize, settings);
+    }
 }
 
 #endif /*LODEPNG_COMPILE_DECODER*/
@@ -1321,43 +1703,43 @@ static const size_t MAX_SUPPORTED_DEFLATE_LENGTH = 258;
 /*bitlen is the size in bits of the code*/
 static void addHuffmanSymbol(size_t* bp, ucvector* compressed, unsigned code, unsigned bitlen)
 {
-	addBitsToStreamReversed(bp, compressed, code, bitlen);
+    addBitsToStreamReversed(bp, compressed, code, bitlen);
 }
 
 /*search the index in the array, that has the largest value smaller than or equal to the given value,
 given array must be sorted (if no value is smaller, it returns the size of the given array)*/
 static size_t searchCodeIndex(const unsigned* array, size_t array_size, size_t value)
 {
-	/*binary search (only small gain over linear). TODO: use CPU log2 instruction for getting symbols instead*/
-	size_t left = 1;
-	size_t right = array_size - 1;
+    /*binary search (only small gain over linear). TODO: use CPU log2 instruction for getting symbols instead*/
+    size_t left = 1;
+    size_t right = array_size - 1;
 
-	while (left <= right) {
-		size_t mid = (left + right) >> 1;
-		if (array[mid] >= value) right = mid - 1;
-		else left = mid + 1;
-	}
-	if (left >= array_size || array[left] > value) left--;
-	return left;
+    while (left <= right) {
+        size_t mid = (left + right) >> 1;
+        if (array[mid] >= value) right = mid - 1;
+        else left = mid + 1;
+    }
+    if (left >= array_size || array[left] > value) left--;
+    return left;
 }
 
 static void addLengthDistance(uivector* values, size_t length, size_t distance)
 {
-	/*values in encoded vector are those used by deflate:
-	0-255: literal bytes
-	256: end
-	257-285: length/distance pair (length code, followed by extra length bits, distance code, extra distance bits)
-	286-287: invalid*/
+    /*values in encoded vector are those used by deflate:
+    0-255: literal bytes
+    256: end
+    257-285: length/distance pair (length code, followed by extra length bits, distance code, extra distance bits)
+    286-287: invalid*/
 
-	unsigned length_code = (unsigned)searchCodeIndex(LENGTHBASE, 29, length);
-	unsigned extra_length = (unsigned)(length - LENGTHBASE[length_code]);
-	unsigned dist_code = (unsigned)searchCodeIndex(DISTANCEBASE, 30, distance);
-	unsigned extra_distance = (unsigned)(distance - DISTANCEBASE[dist_code]);
+    unsigned length_code = (unsigned)searchCodeIndex(LENGTHBASE, 29, length);
+    unsigned extra_length = (unsigned)(length - LENGTHBASE[length_code]);
+    unsigned dist_code = (unsigned)searchCodeIndex(DISTANCEBASE, 30, distance);
+    unsigned extra_distance = (unsigned)(distance - DISTANCEBASE[dist_code]);
 
-	uivector_push_back(values, length_code + FIRST_LENGTH_CODE_INDEX);
-	uivector_push_back(values, extra_length);
-	uivector_push_back(values, dist_code);
-	uivector_push_back(values, extra_distance);
+    uivector_push_back(values, length_code + FIRST_LENGTH_CODE_INDEX);
+    uivector_push_back(values, extra_length);
+    uivector_push_back(values, dist_code);
+    uivector_push_back(values, extra_distance);
 }
 
 /*3 bytes of data get encoded into two bytes. The hash cannot use more than 3
@@ -1367,101 +1749,101 @@ static const unsigned HASH_BIT_MASK = 65535; /*HASH_NUM_VALUES - 1, but C90 does
 
 typedef struct Hash
 {
-	int* head; /*hash value to head circular pos - can be outdated if went around window*/
-	/*circular pos to prev circular pos*/
-	unsigned short* chain;
-	int* val; /*circular pos to hash value*/
+    int* head; /*hash value to head circular pos - can be outdated if went around window*/
+    /*circular pos to prev circular pos*/
+    unsigned short* chain;
+    int* val; /*circular pos to hash value*/
 
-	/*TODO: do this not only for zeros but for any repeated byte. However for PNG
-	it's always going to be the zeros that dominate, so not important for PNG*/
-	int* headz; /*similar to head, but for chainz*/
-	unsigned short* chainz; /*those with same amount of zeros*/
-	unsigned short* zeros; /*length of zeros streak, used as a second hash chain*/
+    /*TODO: do this not only for zeros but for any repeated byte. However for PNG
+    it's always going to be the zeros that dominate, so not important for PNG*/
+    int* headz; /*similar to head, but for chainz*/
+    unsigned short* chainz; /*those with same amount of zeros*/
+    unsigned short* zeros; /*length of zeros streak, used as a second hash chain*/
 } Hash;
 
 static unsigned hash_init(Hash* hash, unsigned windowsize)
 {
-	unsigned i;
-	hash->head = (int*)lodepng_malloc(sizeof(int) * HASH_NUM_VALUES);
-	hash->val = (int*)lodepng_malloc(sizeof(int) * windowsize);
-	hash->chain = (unsigned short*)lodepng_malloc(sizeof(unsigned short) * windowsize);
+    unsigned i;
+    hash->head = (int*)lodepng_malloc(sizeof(int) * HASH_NUM_VALUES);
+    hash->val = (int*)lodepng_malloc(sizeof(int) * windowsize);
+    hash->chain = (unsigned short*)lodepng_malloc(sizeof(unsigned short) * windowsize);
 
-	hash->zeros = (unsigned short*)lodepng_malloc(sizeof(unsigned short) * windowsize);
-	hash->headz = (int*)lodepng_malloc(sizeof(int) * (MAX_SUPPORTED_DEFLATE_LENGTH + 1));
-	hash->chainz = (unsigned short*)lodepng_malloc(sizeof(unsigned short) * windowsize);
+    hash->zeros = (unsigned short*)lodepng_malloc(sizeof(unsigned short) * windowsize);
+    hash->headz = (int*)lodepng_malloc(sizeof(int) * (MAX_SUPPORTED_DEFLATE_LENGTH + 1));
+    hash->chainz = (unsigned short*)lodepng_malloc(sizeof(unsigned short) * windowsize);
 
-	if (!hash->head || !hash->chain || !hash->val || !hash->headz || !hash->chainz || !hash->zeros)
-	{
-		return 83; /*alloc fail*/
-	}
+    if (!hash->head || !hash->chain || !hash->val || !hash->headz || !hash->chainz || !hash->zeros)
+    {
+        return 83; /*alloc fail*/
+    }
 
-	/*initialize hash table*/
-	for (i = 0; i != HASH_NUM_VALUES; ++i) hash->head[i] = -1;
-	for (i = 0; i != windowsize; ++i) hash->val[i] = -1;
-	for (i = 0; i != windowsize; ++i) hash->chain[i] = i; /*same value as index indicates uninitialized*/
+    /*initialize hash table*/
+    for (i = 0; i != HASH_NUM_VALUES; ++i) hash->head[i] = -1;
+    for (i = 0; i != windowsize; ++i) hash->val[i] = -1;
+    for (i = 0; i != windowsize; ++i) hash->chain[i] = i; /*same value as index indicates uninitialized*/
 
-	for (i = 0; i <= MAX_SUPPORTED_DEFLATE_LENGTH; ++i) hash->headz[i] = -1;
-	for (i = 0; i != windowsize; ++i) hash->chainz[i] = i; /*same value as index indicates uninitialized*/
+    for (i = 0; i <= MAX_SUPPORTED_DEFLATE_LENGTH; ++i) hash->headz[i] = -1;
+    for (i = 0; i != windowsize; ++i) hash->chainz[i] = i; /*same value as index indicates uninitialized*/
 
-	return 0;
+    return 0;
 }
 
 static void hash_cleanup(Hash* hash)
 {
-	lodepng_free(hash->head);
-	lodepng_free(hash->val);
-	lodepng_free(hash->chain);
+    lodepng_free(hash->head);
+    lodepng_free(hash->val);
+    lodepng_free(hash->chain);
 
-	lodepng_free(hash->zeros);
-	lodepng_free(hash->headz);
-	lodepng_free(hash->chainz);
+    lodepng_free(hash->zeros);
+    lodepng_free(hash->headz);
+    lodepng_free(hash->chainz);
 }
 
 
 
 static unsigned getHash(const unsigned char* data, size_t size, size_t pos)
 {
-	unsigned result = 0;
-	if (pos + 2 < size)
-	{
-		/*A simple shift and xor hash is used. Since the data of PNGs is dominated
-		by zeroes due to the filters, a better hash does not have a significant
-		effect on speed in traversing the chain, and causes more time spend on
-		calculating the hash.*/
-		result ^= (unsigned)(data[pos + 0] << 0u);
-		result ^= (unsigned)(data[pos + 1] << 4u);
-		result ^= (unsigned)(data[pos + 2] << 8u);
-	}
-	else {
-		size_t amount, i;
-		if (pos >= size) return 0;
-		amount = size - pos;
-		for (i = 0; i != amount; ++i) result ^= (unsigned)(data[pos + i] << (i * 8u));
-	}
-	return result & HASH_BIT_MASK;
+    unsigned result = 0;
+    if (pos + 2 < size)
+    {
+        /*A simple shift and xor hash is used. Since the data of PNGs is dominated
+        by zeroes due to the filters, a better hash does not have a significant
+        effect on speed in traversing the chain, and causes more time spend on
+        calculating the hash.*/
+        result ^= (unsigned)(data[pos + 0] << 0u);
+        result ^= (unsigned)(data[pos + 1] << 4u);
+        result ^= (unsigned)(data[pos + 2] << 8u);
+    }
+    else {
+        size_t amount, i;
+        if (pos >= size) return 0;
+        amount = size - pos;
+        for (i = 0; i != amount; ++i) result ^= (unsigned)(data[pos + i] << (i * 8u));
+    }
+    return result & HASH_BIT_MASK;
 }
 
 static unsigned countZeros(const unsigned char* data, size_t size, size_t pos)
 {
-	const unsigned char* start = data + pos;
-	const unsigned char* end = start + MAX_SUPPORTED_DEFLATE_LENGTH;
-	if (end > data + size) end = data + size;
-	data = start;
-	while (data != end && *data == 0) ++data;
-	/*subtracting two addresses returned as 32-bit number (max value is MAX_SUPPORTED_DEFLATE_LENGTH)*/
-	return (unsigned)(data - start);
+    const unsigned char* start = data + pos;
+    const unsigned char* end = start + MAX_SUPPORTED_DEFLATE_LENGTH;
+    if (end > data + size) end = data + size;
+    data = start;
+    while (data != end && *data == 0) ++data;
+    /*subtracting two addresses returned as 32-bit number (max value is MAX_SUPPORTED_DEFLATE_LENGTH)*/
+    return (unsigned)(data - start);
 }
 
 /*wpos = pos & (windowsize - 1)*/
 static void updateHashChain(Hash* hash, size_t wpos, unsigned hashval, unsigned short numzeros)
 {
-	hash->val[wpos] = (int)hashval;
-	if (hash->head[hashval] != -1) hash->chain[wpos] = hash->head[hashval];
-	hash->head[hashval] = wpos;
+    hash->val[wpos] = (int)hashval;
+    if (hash->head[hashval] != -1) hash->chain[wpos] = hash->head[hashval];
+    hash->head[hashval] = wpos;
 
-	hash->zeros[wpos] = numzeros;
-	if (hash->headz[numzeros] != -1) hash->chainz[wpos] = hash->headz[numzeros];
-	hash->headz[numzeros] = wpos;
+    hash->zeros[wpos] = numzeros;
+    if (hash->headz[numzeros] != -1) hash->chainz[wpos] = hash->headz[numzeros];
+    hash->headz[numzeros] = wpos;
 }
 
 /*
@@ -1474,219 +1856,355 @@ the "dictionary". A brute force search through all possible distances would be s
 this hash technique is one out of several ways to speed this up.
 */
 static unsigned encodeLZ77(uivector* out, Hash* hash,
-	const unsigned char* in, size_t inpos, size_t insize, unsigned windowsize,
-	unsigned minmatch, unsigned nicematch, unsigned lazymatching)
-{
-	size_t pos;
-	unsigned i, error = 0;
-	/*for large window lengths, assume the user wants no compression loss. Otherwise, max hash chain length speedup.*/
-	unsigned maxchainlength = windowsize >= 8192 ? windowsize : windowsize / 8;
-	unsigned maxlazymatch = windowsize >= 8192 ? MAX_SUPPORTED_DEFLATE_LENGTH : 64;
-
-	unsigned usezeros = 1; /*not sure if setting it to false for windowsize < 8192 is better or worse*/
-	unsigned numzeros = 0;
-
-	unsigned offset; /*the offset represents the distance in LZ77 terminology*/
-	unsigned length;
-	unsigned lazy = 0;
-	unsigned lazylength = 0, lazyoffset = 0;
-	unsigned hashval;
-	unsigned current_offset, current_length;
-	unsigned prev_offset;
-	const unsigned char *lastptr, *foreptr, *backptr;
-	unsigned hashpos;
-
-	if (windowsize == 0 || windowsize > 32768) return 60; /*error: windowsize smaller/larger than allowed*/
-	if ((windowsize & (windowsize - 1)) != 0) return 90; /*error: must be power of two*/
-
-	if (nicematch > MAX_SUPPORTED_DEFLATE_LENGTH) nicematch = MAX_SUPPORTED_DEFLATE_LENGTH;
-
-	for (pos = inpos; pos < insize; ++pos)
-	{
-		size_t wpos = pos & (windowsize - 1); /*position for in 'circular' hash buffers*/
-		unsigned chainlength = 0;
-
-		hashval = getHash(in, insize, pos);
-
-		if (usezeros && hashval == 0)
-		{
-			if (numzeros == 0) numzeros = countZeros(in, insize, pos);
-			else if (pos + numzeros > insize || in[pos + numzeros - 1] != 0) --numzeros;
-		}
-		else
-		{
-			numzeros = 0;
-		}
-
-		updateHashChain(hash, wpos, hashval, numzeros);
-
-		/*the length and offset found for the current position*/
-		length = 0;
-		offset = 0;
-
-		hashpos = hash->chain[wpos];
-
-		lastptr = &in[insize < pos + MAX_SUPPORTED_DEFLATE_LENGTH ? insize : pos + MAX_SUPPORTED_DEFLATE_LENGTH];
-
-		/*search for the longest string*/
-		prev_offset = 0;
-		for (;;)
-		{
-			if (chainlength++ >= maxchainlength) break;
-			current_offset = hashpos <= wpos ? wpos - hashpos : wpos - hashpos + windowsize;
-
-			if (current_offset < prev_offset) break; /*stop when went completely around the circular buffer*/
-			prev_offset = current_offset;
-			if (current_offset > 0)
-			{
-				/*test the next characters*/
-				foreptr = &in[pos];
-				backptr = &in[pos - current_offset];
-
-				/*common case in PNGs is lots of zeros. Quickly skip over them as a speedup*/
-				if (numzeros >= 3)
-				{
-					unsigned skip = hash->zeros[hashpos];
-					if (skip > numzeros) skip = numzeros;
-					backptr += skip;
-					foreptr += skip;
-				}
-
-				while (foreptr != lastptr && *backptr == *foreptr) /*maximum supported length by deflate is max length*/
-				{
-					++backptr;
-					++foreptr;
-				}
-				current_length = (unsigned)(foreptr - &in[pos]);
-
-				if (current_length > length)
-				{
-					length = current_length; /*the longest length*/
-					offset = current_offset; /*the offset that is related to this longest length*/
-					/*jump out once a length of max length is found (speed gain). This also jumps
-					out if length is MAX_SUPPORTED_DEFLATE_LENGTH*/
-					if (current_length >= nicematch) break;
-				}
-			}
-
-			if (hashpos == hash->chain[hashpos]) break;
-
-			if (numzeros >= 3 && length > numzeros)
-			{
-				hashpos = hash->chainz[hashpos];
-				if (hash->zeros[hashpos] != numzeros) break;
-			}
-			else
-			{
-				hashpos = hash->chain[hashpos];
-				/*outdated hash value, happens if particular value was not encountered in whole last window*/
-				if (hash->val[hashpos] != (int)hashval) break;
-			}
-		}
-
-		if (lazymatching)
-		{
-			if (!lazy && length >= 3 && length <= maxlazymatch && length < MAX_SUPPORTED_DEFLATE_LENGTH)
-			{
-				lazy = 1;
-				lazylength = length;
-				lazyoffset = offset;
-				continue; /*try the next byte*/
-			}
-			if (lazy)
-			{
-				lazy = 0;
-				if (pos == 0) ERROR_BREAK(81);
-				if (length > lazylength + 1)
-				{
-					/*push the previous character as literal*/
-					if (!uivector_push_back(out, in[pos - 1])) ERROR_BREAK(83 /*alloc fail*/);
-				}
-				else
-				{
-					length = lazylength;
-					offset = lazyoffset;
-					hash->head[hashval] = -1; /*the same hashchain update will be done, this ensures no wrong alteration*/
-					hash->headz[numzeros] = -1; /*idem*/
-					--pos;
-				}
-			}
-		}
-		if (length >= 3 && offset > windowsize) ERROR_BREAK(86 /*too big (or overflown negative) offset*/);
-
-		/*encode it as length/distance pair or literal value*/
-		if (length < 3) /*only lengths of 3 or higher are supported as length/distance pair*/
-		{
-			if (!uivector_push_back(out, in[pos])) ERROR_BREAK(83 /*alloc fail*/);
-		}
-		else if (length < minmatch || (length == 3 && offset > 4096))
-		{
-			/*compensate for the fact that longer offsets have more extra bits, a
-			length of only 3 may be not worth it then*/
-			if (!uivector_push_back(out, in[pos])) ERROR_BREAK(83 /*alloc fail*/);
-		}
-		else
-		{
-			addLengthDistance(out, length, offset);
-			for (i = 1; i < length; ++i)
-			{
-				++pos;
-				wpos = pos & (windowsize - 1);
-				hashval = getHash(in, insize, pos);
-				if (usezeros && hashval == 0)
-				{
-					if (numzeros == 0) numzeros = countZeros(in, insize, pos);
-					else if (pos + numzeros > insize || in[pos + numzeros - 1] != 0) --numzeros;
-				}
-				else
-				{
-					numzeros = 0;
-				}
-				updateHashChain(hash, wpos, hashval, numzeros);
-			}
-		}
-	} /*end of the loop through each character of input*/
-
-	return error;
+    const unsigned char* in, size_t inpos, size_t insize, unsigned windowsize,
+    unsigned minmatch, unsigned nicematch, unsigned lazymatching)
+{
+    size_t pos;
+    unsigned i, error = 0;
+    /*for large window lengths, assume the user wants no compression loss. Otherwise, max hash chain length speedup.*/
+    unsigned maxchainlength = windowsize >= 8192 ? windowsize : windowsize / 8;
+    unsigned maxlazymatch = windowsize >= 8192 ? MAX_SUPPORTED_DEFLATE_LENGTH : 64;
+
+    unsigned usezeros = 1; /*not sure if setting it to false for windowsize < 8192 is better or worse*/
+    unsigned numzeros = 0;
+
+    unsigned offset; /*the offset represents the distance in LZ77 terminology*/
+    unsigned length;
+    unsigned lazy = 0;
+    unsigned lazylength = 0, lazyoffset = 0;
+    unsigned hashval;
+    unsigned current_offset, current_length;
+    unsigned prev_offset;
+    const unsigned char *lastptr, *foreptr, *backptr;
+    unsigned hashpos;
+
+    if (windowsize == 0 || windowsize > 32768) return 60; /*error: windowsize smaller/larger than allowed*/
+    if ((windowsize & (windowsize - 1)) != 0) return 90; /*error: must be power of two*/
+
+    if (nicematch > MAX_SUPPORTED_DEFLATE_LENGTH) nicematch = MAX_SUPPORTED_DEFLATE_LENGTH;
+
+    for (pos = inpos; pos < insize; ++pos)
+    {
+        size_t wpos = pos & (windowsize - 1); /*position for in 'circular' hash buffers*/
+        unsigned chainlength = 0;
+
+        hashval = getHash(in, insize, pos);
+
+        if (usezeros && hashval == 0)
+        {
+            if (numzeros == 0) numzeros = countZeros(in, insize, pos);
+            else if (pos + numzeros > insize || in[pos + numzeros - 1] != 0) --numzeros;
+        }
+        else
+        {
+            numzeros = 0;
+        }
+
+        updateHashChain(hash, wpos, hashval, numzeros);
+
+        /*the length and offset found for the current position*/
+        length = 0;
+        offset = 0;
+
+        hashpos = hash->chain[wpos];
+
+        lastptr = &in[insize < pos + MAX_SUPPORTED_DEFLATE_LENGTH ? insize : pos + MAX_SUPPORTED_DEFLATE_LENGTH];
+
+        /*search for the longest string*/
+        prev_offset = 0;
+        for (;;)
+        {
+            if (chainlength++ >= maxchainlength) break;
+            current_offset = hashpos <= wpos ? wpos - hashpos : wpos - hashpos + windowsize;
+
+            if (current_offset < prev_offset) break; /*stop when went completely around the circular buffer*/
+            prev_offset = current_offset;
+            if (current_offset > 0)
+            {
+                /*test the next characters*/
+                foreptr = &in[pos];
+                backptr = &in[pos - current_offset];
+
+                /*common case in PNGs is lots of zeros. Quickly skip over them as a speedup*/
+                if (numzeros >= 3)
+                {
+                    unsigned skip = hash->zeros[hashpos];
+                    if (skip > numzeros) skip = numzeros;
+                    backptr += skip;
+                    foreptr += skip;
+                }
+
+                while (foreptr != lastptr && *backptr == *foreptr) /*maximum supported length by deflate is max length*/
+                {
+                    ++backptr;
+                    ++foreptr;
+                }
+                current_length = (unsigned)(foreptr - &in[pos]);
+
+                if (current_length > length)
+                {
+                    length = current_length; /*the longest length*/
+                    offset = current_offset; /*the offset that is related to this longest length*/
+                    /*jump out once a length of max length is found (speed gain). This also jumps
+                    out if length is MAX_SUPPORTED_DEFLATE_LENGTH*/
+                    if (current_length >= nicematch) break;
+                }
+            }
+
+            if (hashpos == hash->chain[hashpos]) break;
+
+            if (numzeros >= 3 && length > numzeros)
+            {
+                hashpos = hash->chainz[hashpos];
+                if (hash->zeros[hashpos] != numzeros) break;
+            }
+            else
+            {
+                hashpos = hash->chain[hashpos];
+                /*outdated hash value, happens if particular value was not encountered in whole last window*/
+                if (hash->val[hashpos] != (int)hashval) break;
+            }
+        }
+
+        if (lazymatching)
+        {
+            if (!lazy && length >= 3 && length <= maxlazymatch && length < MAX_SUPPORTED_DEFLATE_LENGTH)
+            {
+                lazy = 1;
+                lazylength = length;
+                lazyoffset = offset;
+                continue; /*try the next byte*/
+            }
+            if (lazy)
+            {
+                lazy = 0;
+                if (pos == 0) ERROR_BREAK(81);
+                if (length > lazylength + 1)
+                {
+                    /*push the previous character as literal*/
+                    if (!uivector_push_back(out, in[pos - 1])) ERROR_BREAK(83 /*alloc fail*/);
+                }
+                else
+                {
+                    length = lazylength;
+                    offset = lazyoffset;
+                    hash->head[hashval] = -1; /*the same hashchain update will be done, this ensures no wrong alteration*/
+                    hash->headz[numzeros] = -1; /*idem*/
+                    --pos;
+                }
+            }
+        }
+        if (length >= 3 && offset > windowsize) ERROR_BREAK(86 /*too big (or overflown negative) offset*/);
+
+        /*encode it as length/distance pair or literal value*/
+        if (length < 3) /*only lengths of 3 or higher are supported as length/distance pair*/
+        {
+            if (!uivector_push_back(out, in[pos])) ERROR_BREAK(83 /*alloc fail*/);
+        }
+        else if (length < minmatch || (length == 3 && offset > 4096))
+        {
+            /*compensate for the fact that longer offsets have more extra bits, a
+            length of only 3 may be not worth it then*/
+            if (!uivector_push_back(out, in[pos])) ERROR_BREAK(83 /*alloc fail*/);
+        }
+        else
+        {
+            addLengthDistance(out, length, offset);
+            for (i = 1; i < length; ++i)
+            {
+                ++pos;
+                wpos = pos & (windowsize - 1);
+                hashval = getHash(in, insize, pos);
+                if (usezeros && hashval == 0)
+                {
+                    if (numzeros == 0) numzeros = countZeros(in, insize, pos);
+                    else if (pos + numzeros > insize || in[pos + numzeros - 1] != 0) --numzeros;
+                }
+                else
+                {
+                    numzeros = 0;
+                }
+                updateHashChain(hash, wpos, hashval, numzeros);
+            }
+        }
+    } /*end of the loop through each character of input*/
+
+    return error;
+}
+
+/*
+The fast match finder hashes 4 bytes instead of 3, so only the positions that can give a match of at least 4 bytes
+share a chain, and it follows only a few links of that chain. It uses head, chain and val of the same Hash, but not
+the chains of zeros, long runs of zeros are found through the chain of their own hash value.
+*/
+static unsigned getHash4(const unsigned char* data, size_t pos)
+{
+    unsigned word = data[pos] | ((unsigned)data[pos + 1] << 8u) | ((unsigned)data[pos + 2] << 16u) | ((unsigned)data[pos + 3] << 24u);
+    return (word * 2654435761u) >> (32u - 16u); /*Fibonacci hashing to HASH_NUM_VALUES*/
+}
+
+/*
+Adds pos to the hash chains and returns the length of the longest match found for it within maxchainlength links,
+or 0. Positions that can't start a match of 4 bytes are not added.
+*/
+static unsigned findMatchFast(Hash* hash, const unsigned char* in, size_t pos, size_t insize,
+    unsigned windowsize, unsigned maxchainlength, unsigned nicematch, unsigned* offset)
+{
+    size_t wpos = pos & (windowsize - 1); /*position for in 'circular' hash buffers*/
+    size_t maxlength = insize - pos < MAX_SUPPORTED_DEFLATE_LENGTH ? insize - pos : MAX_SUPPORTED_DEFLATE_LENGTH;
+    unsigned length = 0, prev_offset = 0, chainlength;
+    unsigned hashval;
+    int hashpos;
+
+    if (pos + 4 > insize) return 0;
+    hashval = getHash4(in, pos);
+    hashpos = hash->head[hashval];
+
+    for (chainlength = 0; chainlength != maxchainlength && hashpos != -1; ++chainlength)
+    {
+        unsigned current_offset = (unsigned)(wpos - hashpos) & (windowsize - 1);
+        const unsigned char* foreptr = &in[pos];
+        const unsigned char* backptr;
+        unsigned current_length;
+
+        /*outdated hash value, or went completely around the circular buffer*/
+        if (hash->val[hashpos] != (int)hashval || current_offset <= prev_offset) break;
+        prev_offset = current_offset;
+        backptr = foreptr - current_offset;
+
+        /*only a match that is longer than the one found so far can matter, so its last byte is checked first*/
+        if (backptr[length] == foreptr[length])
+        {
+            current_length = 0;
+            while (current_length != maxlength && backptr[current_length] == foreptr[current_length]) ++current_length;
+            if (current_length > length)
+            {
+                length = current_length;
+                *offset = current_offset;
+                if (length >= nicematch || length == maxlength) break;
+            }
+        }
+
+        if (hash->chain[hashpos] == hashpos) break; /*end of the chain*/
+        hashpos = hash->chain[hashpos];
+    }
+
+    hash->val[wpos] = (int)hashval;
+    hash->chain[wpos] = hash->head[hashval] != -1 ? (unsigned short)hash->head[hashval] : (unsigned short)wpos;
+    hash->head[hashval] = (int)wpos;
+    return length;
+}
+
+/*
+LZ77-encode the data with the fast match finder, same output format as encodeLZ77. Chains are followed for at most
+windowsize / 256 links, between 2 and 128. With lazymatching, a match is replaced by a longer one that starts at the
+next byte.
+*/
+static unsigned encodeLZ77Fast(uivector* out, Hash* hash,
+    const unsigned char* in, size_t inpos, size_t insize, unsigned windowsize,
+    unsigned minmatch, unsigned nicematch, unsigned lazymatching)
+{
+    size_t pos, i;
+    unsigned maxchainlength = windowsize / 256;
+    unsigned length, offset = 0;
+
+    if (windowsize == 0 || windowsize > 32768) return 60; /*error: windowsize smaller/larger than allowed*/
+    if ((windowsize & (windowsize - 1)) != 0) return 90; /*error: must be power of two*/
+
+    if (maxchainlength < 2) maxchainlength = 2;
+    if (maxchainlength > 128) maxchainlength = 128;
+    if (nicematch > MAX_SUPPORTED_DEFLATE_LENGTH) nicematch = MAX_SUPPORTED_DEFLATE_LENGTH;
+    if (minmatch < 4) minmatch = 4; /*the hash of 4 bytes only finds matches of 4 bytes or more*/
+
+    for (pos = inpos; pos < insize; ++pos)
+    {
+        size_t next = pos + 1; /*the first position that is not in the hash chains yet*/
+        length = findMatchFast(hash, in, pos, insize, windowsize, maxchainlength, nicematch, &offset);
+        if (lazymatching)
+        {
+            while (length >= minmatch && length < nicematch && pos + 1 < insize)
+            {
+                unsigned nextoffset = 0;
+                unsigned nextlength = findMatchFast(hash, in, pos + 1, insize, windowsize, maxchainlength, nicematch, &nextoffset);
+                next = pos + 2;
+                if (nextlength <= length) break;
+                /*push the current character as literal and take the longer match*/
+                if (!uivector_push_back(out, in[pos])) return 83; /*alloc fail*/
+                ++pos;
+                length = nextlength;
+                offset = nextoffset;
+            }
+        }
+
+        if (length < minmatch)
+        {
+            if (!uivector_push_back(out, in[pos])) return 83; /*alloc fail*/
+            continue;
+        }
+        if (offset > windowsize) return 86; /*too big (or overflown negative) offset*/
+        addLengthDistance(out, length, offset);
+        /*the positions inside the match can be matched later too*/
+        for (i = next; i < pos + length; ++i)
+        {
+            unsigned dummy;
+            findMatchFast(hash, in, i, insize, windowsize, 0, nicematch, &dummy);
+        }
+        pos += length - 1;
+    }
+
+    return 0;
+}
+
+/*LZ77-encode a block with the match finder chosen in the settings*/
+static unsigned encodeLZ77Settings(uivector* out, Hash* hash,
+    const unsigned char* in, size_t inpos, size_t insize, const LodePNGCompressSettings* settings)
+{
+    if (settings->matchfinder == LMF_FAST)
+    {
+        return encodeLZ77Fast(out, hash, in, inpos, insize, settings->windowsize,
+            settings->minmatch, settings->nicematch, settings->lazymatching);
+    }
+    return encodeLZ77(out, hash, in, inpos, insize, settings->windowsize,
+        settings->minmatch, settings->nicematch, settings->lazymatching);
 }
 
 /* /////////////////////////////////////////////////////////////////////////// */
 
-static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, size_t datasize)
+static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, size_t datasize, unsigned final)
 {
-	/*non compressed deflate block data: 1 bit BFINAL,2 bits BTYPE,(5 bits): it jumps to start of next byte,
-	2 bytes LEN, 2 bytes NLEN, LEN bytes literal DATA*/
+    /*non compressed deflate block data: 1 bit BFINAL,2 bits BTYPE,(5 bits): it jumps to start of next byte,
+    2 bytes LEN, 2 bytes NLEN, LEN bytes literal DATA*/
 
-	size_t i, j, numdeflateblocks = (datasize + 65534) / 65535;
-	unsigned datapos = 0;
-	for (i = 0; i != numdeflateblocks; ++i)
-	{
-		unsigned BFINAL, BTYPE, LEN, NLEN;
-		unsigned char firstbyte;
+    size_t i, j, numdeflateblocks = (datasize + 65534) / 65535;
+    unsigned datapos = 0;
+    for (i = 0; i != numdeflateblocks; ++i)
+    {
+        unsigned BFINAL, BTYPE, LEN, NLEN;
+        unsigned char firstbyte;
 
-		BFINAL = (i == numdeflateblocks - 1);
-		BTYPE = 0;
+        BFINAL = final && (i == numdeflateblocks - 1);
+        BTYPE = 0;
 
-		firstbyte = (unsigned char)(BFINAL + ((BTYPE & 1) << 1) + ((BTYPE & 2) << 1));
-		ucvector_push_back(out, firstbyte);
+        firstbyte = (unsigned char)(BFINAL + ((BTYPE & 1) << 1) + ((BTYPE & 2) << 1));
+        ucvector_push_back(out, firstbyte);
 
-		LEN = 65535;
-		if (datasize - datapos < 65535) LEN = (unsigned)datasize - datapos;
-		NLEN = 65535 - LEN;
+        LEN = 65535;
+        if (datasize - datapos < 65535) LEN = (unsigned)datasize - datapos;
+        NLEN = 65535 - LEN;
 
-		ucvector_push_back(out, (unsigned char)(LEN & 255));
-		ucvector_push_back(out, (unsigned char)(LEN >> 8));
-		ucvector_push_back(out, (unsigned char)(NLEN & 255));
-		ucvector_push_back(out, (unsigned char)(NLEN >> 8));
+        ucvector_push_back(out, (unsigned char)(LEN & 255));
+        ucvector_push_back(out, (unsigned char)(LEN >> 8));
+        ucvector_push_back(out, (unsigned char)(NLEN & 255));
+        ucvector_push_back(out, (unsigned char)(NLEN >> 8));
 
-		/*Decompressed data*/
-		for (j = 0; j < 65535 && datapos < datasize; ++j)
-		{
-			ucvector_push_back(out, data[datapos++]);
-		}
-	}
+        /*Decompressed data*/
+        for (j = 0; j < 65535 && datapos < datasize; ++j)
+        {
+            ucvector_push_back(out, data[datapos++]);
+        }
+    }
 
-	return 0;
+    return 0;
 }
 
 /*
@@ -1695,393 +2213,525 @@ tree_ll: the tree for lit and len codes.
 tree_d: the tree for distance codes.
 */
 static void writeLZ77data(size_t* bp, ucvector* out, const uivector* lz77_encoded,
-	const HuffmanTree* tree_ll, const HuffmanTree* tree_d)
+    const HuffmanTree* tree_ll, const HuffmanTree* tree_d)
 {
-	size_t i = 0;
-	for (i = 0; i != lz77_encoded->size; ++i)
-	{
-		unsigned val = lz77_encoded->data[i];
-		addHuffmanSymbol(bp, out, HuffmanTree_getCode(tree_ll, val), HuffmanTree_getLength(tree_ll, val));
-		if (val > 256) /*for a length code, 3 more things have to be added*/
-		{
-			unsigned length_index = val - FIRST_LENGTH_CODE_INDEX;
-			unsigned n_length_extra_bits = LENGTHEXTRA[length_index];
-			unsigned length_extra_bits = lz77_encoded->data[++i];
+    size_t i = 0;
+    for (i = 0; i != lz77_encoded->size; ++i)
+    {
+        unsigned val = lz77_encoded->data[i];
+        addHuffmanSymbol(bp, out, HuffmanTree_getCode(tree_ll, val), HuffmanTree_getLength(tree_ll, val));
+        if (val > 256) /*for a length code, 3 more things have to be added*/
+        {
+            unsigned length_index = val - FIRST_LENGTH_CODE_INDEX;
+            unsigned n_length_extra_bits = LENGTHEXTRA[length_index];
+            unsigned length_extra_bits = lz77_encoded->data[++i];
 
-			unsigned distance_code = lz77_encoded->data[++i];
+            unsigned distance_code = lz77_encoded->data[++i];
 
-			unsigned distance_index = distance_code;
-			unsigned n_distance_extra_bits = DISTANCEEXTRA[distance_index];
-			unsigned distance_extra_bits = lz77_encoded->data[++i];
+            unsigned distance_index = distance_code;
+            unsigned n_distance_extra_bits = DISTANCEEXTRA[distance_index];
+            unsigned distance_extra_bits = lz77_encoded->data[++i];
 
-			addBitsToStream(bp, out, length_extra_bits, n_length_extra_bits);
-			addHuffmanSymbol(bp, out, HuffmanTree_getCode(tree_d, distance_code),
-				HuffmanTree_getLength(tree_d, distance_code));
-			addBitsToStream(bp, out, distance_extra_bits, n_distance_extra_bits);
-		}
-	}
+            addBitsToStream(bp, out, length_extra_bits, n_length_extra_bits);
+            addHuffmanSymbol(bp, out, HuffmanTree_getCode(tree_d, distance_code),
+                HuffmanTree_getLength(tree_d, distance_code));
+            addBitsToStream(bp, out, distance_extra_bits, n_distance_extra_bits);
+        }
+    }
 }
 
 /*Deflate for a block of type "dynamic", that is, with freely, optimally, created huffman trees*/
 static unsigned deflateDynamic(ucvector* out, size_t* bp, Hash* hash,
-	const unsigned char* data, size_t datapos, size_t dataend,
-	const LodePNGCompressSettings* settings, unsigned final)
-{
-	unsigned error = 0;
-
-	/*
-	A block is compressed as follows: The PNG data is lz77 encoded, resulting in
-	literal bytes and length/distance pairs. This is then huffman compressed with
-	two huffman trees. One huffman tree is used for the lit and len values ("ll"),
-	another huffman tree is used for the dist values ("d"). These two trees are
-	stored using their code lengths, and to compress even more these code lengths
-	are also run-length encoded and huffman compressed. This gives a huffman tree
-	of code lengths "cl". The code lenghts used to describe this third tree are
-	the code length code lengths ("clcl").
-	*/
-
-	/*The lz77 encoded data, represented with integers since there will also be length and distance codes in it*/
-	uivector lz77_encoded;
-	HuffmanTree tree_ll; /*tree for lit,len values*/
-	HuffmanTree tree_d; /*tree for distance codes*/
-	HuffmanTree tree_cl; /*tree for encoding the code lengths representing tree_ll and tree_d*/
-	uivector frequencies_ll; /*frequency of lit,len codes*/
-	uivector frequencies_d; /*frequency of dist codes*/
-	uivector frequencies_cl; /*frequency of code length codes*/
-	uivector bitlen_lld; /*lit,len,dist code lenghts (int bits), literally (without repeat codes).*/
-	uivector bitlen_lld_e; /*bitlen_lld encoded with repeat codes (this is a rudemtary run length compression)*/
-	/*bitlen_cl is the code length code lengths ("clcl"). The bit lengths of codes to represent tree_cl
-	(these are written as is in the file, it would be crazy to compress these using yet another huffman
-	tree that needs to be represented by yet another set of code lengths)*/
-	uivector bitlen_cl;
-	size_t datasize = dataend - datapos;
-
-	/*
-	Due to the huffman compression of huffman tree representations ("two levels"), there are some anologies:
-	bitlen_lld is to tree_cl what data is to tree_ll and tree_d.
-	bitlen_lld_e is to bitlen_lld what lz77_encoded is to data.
-	bitlen_cl is to bitlen_lld_e what bitlen_lld is to lz77_encoded.
-	*/
-
-	unsigned BFINAL = final;
-	size_t numcodes_ll, numcodes_d, i;
-	unsigned HLIT, HDIST, HCLEN;
-
-	uivector_init(&lz77_encoded);
-	HuffmanTree_init(&tree_ll);
-	HuffmanTree_init(&tree_d);
-	HuffmanTree_init(&tree_cl);
-	uivector_init(&frequencies_ll);
-	uivector_init(&frequencies_d);
-	uivector_init(&frequencies_cl);
-	uivector_init(&bitlen_lld);
-	uivector_init(&bitlen_lld_e);
-	uivector_init(&bitlen_cl);
-
-	/*This while loop never loops due to a break at the end, it is here to
-	allow breaking out of it to the cleanup phase on error conditions.*/
-	while (!error)
-	{
-		if (settings->use_lz77)
-		{
-			error = encodeLZ77(&lz77_encoded, hash, data, datapos, dataend, settings->windowsize,
-				settings->minmatch, settings->nicematch, settings->lazymatching);
-			if (error) break;
-		}
-		else
-		{
-			if (!uivector_resize(&lz77_encoded, datasize)) ERROR_BREAK(83 /*alloc fail*/);
-			for (i = datapos; i < dataend; ++i) lz77_encoded.data[i - datapos] = data[i]; /*no LZ77, but still will be Huffman compressed*/
-		}
-
-		if (!uivector_resizev(&frequencies_ll, 286, 0)) ERROR_BREAK(83 /*alloc fail*/);
-		if (!uivector_resizev(&frequencies_d, 30, 0)) ERROR_BREAK(83 /*alloc fail*/);
-
-		/*Count the frequencies of lit, len and dist codes*/
-		for (i = 0; i != lz77_encoded.size; ++i)
-		{
-			unsigned symbol = lz77_encoded.data[i];
-			++frequencies_ll.data[symbol];
-			if (symbol > 256)
-			{
-				unsigned dist = lz77_encoded.data[i + 2];
-				++frequencies_d.data[dist];
-				i += 3;
-			}
-		}
-		frequencies_ll.data[256] = 1; /*there will be exactly 1 end code, at the end of the block*/
-
-		/*Make both huffman trees, one for the lit and len codes, one for the dist codes*/
-		error = HuffmanTree_makeFromFrequencies(&tree_ll, frequencies_ll.data, 257, frequencies_ll.size, 15);
-		if (error) break;
-		/*2, not 1, is chosen for mincodes: some buggy PNG decoders require at least 2 symbols in the dist tree*/
-		error = HuffmanTree_makeFromFrequencies(&tree_d, frequencies_d.data, 2, frequencies_d.size, 15);
-		if (error) break;
-
-		numcodes_ll = tree_ll.numcodes; if (numcodes_ll > 286) numcodes_ll = 286;
-		numcodes_d = tree_d.numcodes; if (numcodes_d > 30) numcodes_d = 30;
-		/*store the code lengths of both generated trees in bitlen_lld*/
-		for (i = 0; i != numcodes_ll; ++i) uivector_push_back(&bitlen_lld, HuffmanTree_getLength(&tree_ll, (unsigned)i));
-		for (i = 0; i != numcodes_d; ++i) uivector_push_back(&bitlen_lld, HuffmanTree_getLength(&tree_d, (unsigned)i));
-
-		/*run-length compress bitlen_ldd into bitlen_lld_e by using repeat codes 16 (copy length 3-6 times),
-		17 (3-10 zeroes), 18 (11-138 zeroes)*/
-		for (i = 0; i != (unsigned)bitlen_lld.size; ++i)
-		{
-			unsigned j = 0; /*amount of repititions*/
-			while (i + j + 1 < (unsigned)bitlen_lld.size && bitlen_lld.data[i + j + 1] == bitlen_lld.data[i]) ++j;
-
-			if (bitlen_lld.data[i] == 0 && j >= 2) /*repeat code for zeroes*/
-			{
-				++j; /*include the first zero*/
-				if (j <= 10) /*repeat code 17 supports max 10 zeroes*/
-				{
-					uivector_push_back(&bitlen_lld_e, 17);
-					uivector_push_back(&bitlen_lld_e, j - 3);
-				}
-				else /*repeat code 18 supports max 138 zeroes*/
-				{
-					if (j > 138) j = 138;
-					uivector_push_back(&bitlen_lld_e, 18);
-					uivector_push_back(&bitlen_lld_e, j - 11);
-				}
-				i += (j - 1);
-			}
-			else if (j >= 3) /*repeat code for value other than zero*/
-			{
-				size_t k;
-				unsigned num = j / 6, rest = j % 6;
-				uivector_push_back(&bitlen_lld_e, bitlen_lld.data[i]);
-				for (k = 0; k < num; ++k)
-				{
-					uivector_push_back(&bitlen_lld_e, 16);
-					uivector_push_back(&bitlen_lld_e, 6 - 3);
-				}
-				if (rest >= 3)
-				{
-					uivector_push_back(&bitlen_lld_e, 16);
-					uivector_push_back(&bitlen_lld_e, rest - 3);
-				}
-				else j -= rest;
-				i += j;
-			}
-			else /*too short to benefit from repeat code*/
-			{
-				uivector_push_back(&bitlen_lld_e, bitlen_lld.data[i]);
-			}
-		}
-
-		/*generate tree_cl, the huffmantree of huffmantrees*/
-
-		if (!uivector_resizev(&frequencies_cl, NUM_CODE_LENGTH_CODES, 0)) ERROR_BREAK(83 /*alloc fail*/);
-		for (i = 0; i != bitlen_lld_e.size; ++i)
-		{
-			++frequencies_cl.data[bitlen_lld_e.data[i]];
-			/*after a repeat code come the bits that specify the number of repetitions,
-			those don't need to be in the frequencies_cl calculation*/
-			if (bitlen_lld_e.data[i] >= 16) ++i;
-		}
-
-		error = HuffmanTree_makeFromFrequencies(&tree_cl, frequencies_cl.data,
-			frequencies_cl.size, frequencies_cl.size, 7);
-		if (error) break;
-
-		if (!uivector_resize(&bitlen_cl, tree_cl.numcodes)) ERROR_BREAK(83 /*alloc fail*/);
-		for (i = 0; i != tree_cl.numcodes; ++i)
-		{
-			/*lenghts of code length tree is in the order as specified by deflate*/
-			bitlen_cl.data[i] = HuffmanTree_getLength(&tree_cl, CLCL_ORDER[i]);
-		}
-		while (bitlen_cl.data[bitlen_cl.size - 1] == 0 && bitlen_cl.size > 4)
-		{
-			/*remove zeros at the end, but minimum size must be 4*/
-			if (!uivector_resize(&bitlen_cl, bitlen_cl.size - 1)) ERROR_BREAK(83 /*alloc fail*/);
-		}
-		if (error) break;
-
-		/*
-		Write everything into the output
-
-		After the BFINAL and BTYPE, the dynamic block consists out of the following:
-		- 5 bits HLIT, 5 bits HDIST, 4 bits HCLEN
-		- (HCLEN+4)*3 bits code lengths of code length alphabet
-		- HLIT + 257 code lenghts of lit/length alphabet (encoded using the code length
-		alphabet, + possible repetition codes 16, 17, 18)
-		- HDIST + 1 code lengths of distance alphabet (encoded using the code length
-		alphabet, + possible repetition codes 16, 17, 18)
-		- compressed data
-		- 256 (end code)
-		*/
-
-		/*Write block type*/
-		addBitToStream(bp, out, BFINAL);
-		addBitToStream(bp, out, 0); /*first bit of BTYPE "dynamic"*/
-		addBitToStream(bp, out, 1); /*second bit of BTYPE "dynamic"*/
-
-		/*write the HLIT, HDIST and HCLEN values*/
-		HLIT = (unsigned)(numcodes_ll - 257);
-		HDIST = (unsigned)(numcodes_d - 1);
-		HCLEN = (unsigned)bitlen_cl.size - 4;
-		/*trim zeroes for HCLEN. HLIT and HDIST were already trimmed at tree creation*/
-		while (!bitlen_cl.data[HCLEN + 4 - 1] && HCLEN > 0) --HCLEN;
-		addBitsToStream(bp, out, HLIT, 5);
-		addBitsToStream(bp, out, HDIST, 5);
-		addBitsToStream(bp, out, HCLEN, 4);
-
-		/*write the code lenghts of the code length alphabet*/
-		for (i = 0; i != HCLEN + 4; ++i) addBitsToStream(bp, out, bitlen_cl.data[i], 3);
-
-		/*write the lenghts of the lit/len AND the dist alphabet*/
-		for (i = 0; i != bitlen_lld_e.size; ++i)
-		{
-			addHuffmanSymbol(bp, out, HuffmanTree_getCode(&tree_cl, bitlen_lld_e.data[i]),
-				HuffmanTree_getLength(&tree_cl, bitlen_lld_e.data[i]));
-			/*extra bits of repeat codes*/
-			if (bitlen_lld_e.data[i] == 16) addBitsToStream(bp, out, bitlen_lld_e.data[++i], 2);
-			else if (bitlen_lld_e.data[i] == 17) addBitsToStream(bp, out, bitlen_lld_e.data[++i], 3);
-			else if (bitlen_lld_e.data[i] == 18) addBitsToStream(bp, out, bitlen_lld_e.data[++i], 7);
-		}
-
-		/*write the compressed data symbols*/
-		writeLZ77data(bp, out, &lz77_encoded, &tree_ll, &tree_d);
-		/*error: the length of the end code 256 must be larger than 0*/
-		if (HuffmanTree_getLength(&tree_ll, 256) == 0) ERROR_BREAK(64);
-
-		/*write the end code*/
-		addHuffmanSymbol(bp, out, HuffmanTree_getCode(&tree_ll, 256), HuffmanTree_getLength(&tree_ll, 256));
-
-		break; /*end of error-while*/
-	}
-
-	/*cleanup*/
-	uivector_cleanup(&lz77_encoded);
-	HuffmanTree_cleanup(&tree_ll);
-	HuffmanTree_cleanup(&tree_d);
-	HuffmanTree_cleanup(&tree_cl);
-	uivector_cleanup(&frequencies_ll);
-	uivector_cleanup(&frequencies_d);
-	uivector_cleanup(&frequencies_cl);
-	uivector_cleanup(&bitlen_lld_e);
-	uivector_cleanup(&bitlen_lld);
-	uivector_cleanup(&bitlen_cl);
-
-	return error;
+    const unsigned char* data, size_t datapos, size_t dataend,
+    const LodePNGCompressSettings* settings, unsigned final)
+{
+    unsigned error = 0;
+
+    /*
+    A block is compressed as follows: The PNG data is lz77 encoded, resulting in
+    literal bytes and length/distance pairs. This is then huffman compressed with
+    two huffman trees. One huffman tree is used for the lit and len values ("ll"),
+    another huffman tree is used for the dist values ("d"). These two trees are
+    stored using their code lengths, and to compress even more these code lengths
+    are also run-length encoded and huffman compressed. This gives a huffman tree
+    of code lengths "cl". The code lenghts used to describe this third tree are
+    the code length code lengths ("clcl").
+    */
+
+    /*The lz77 encoded data, represented with integers since there will also be length and distance codes in it*/
+    uivector lz77_encoded;
+    HuffmanTree tree_ll; /*tree for lit,len values*/
+    HuffmanTree tree_d; /*tree for distance codes*/
+    HuffmanTree tree_cl; /*tree for encoding the code lengths representing tree_ll and tree_d*/
+    uivector frequencies_ll; /*frequency of lit,len codes*/
+    uivector frequencies_d; /*frequency of dist codes*/
+    uivector frequencies_cl; /*frequency of code length codes*/
+    uivector bitlen_lld; /*lit,len,dist code lenghts (int bits), literally (without repeat codes).*/
+    uivector bitlen_lld_e; /*bitlen_lld encoded with repeat codes (this is a rudemtary run length compression)*/
+    /*bitlen_cl is the code length code lengths ("clcl"). The bit lengths of codes to represent tree_cl
+    (these are written as is in the file, it would be crazy to compress these using yet another huffman
+    tree that needs to be represented by yet another set of code lengths)*/
+    uivector bitlen_cl;
+    size_t datasize = dataend - datapos;
+
+    /*
+    Due to the huffman compression of huffman tree representations ("two levels"), there are some anologies:
+    bitlen_lld is to tree_cl what data is to tree_ll and tree_d.
+    bitlen_lld_e is to bitlen_lld what lz77_encoded is to data.
+    bitlen_cl is to bitlen_lld_e what bitlen_lld is to lz77_encoded.
+    */
+
+    unsigned BFINAL = final;
+    size_t numcodes_ll, numcodes_d, i;
+    unsigned HLIT, HDIST, HCLEN;
+
+    uivector_init(&lz77_encoded);
+    HuffmanTree_init(&tree_ll);
+    HuffmanTree_init(&tree_d);
+    HuffmanTree_init(&tree_cl);
+    uivector_init(&frequencies_ll);
+    uivector_init(&frequencies_d);
+    uivector_init(&frequencies_cl);
+    uivector_init(&bitlen_lld);
+    uivector_init(&bitlen_lld_e);
+    uivector_init(&bitlen_cl);
+
+    /*This while loop never loops due to a break at the end, it is here to
+    allow breaking out of it to the cleanup phase on error conditions.*/
+    while (!error)
+    {
+        if (settings->use_lz77)
+        {
+            error = encodeLZ77Settings(&lz77_encoded, hash, data, datapos, dataend, settings);
+            if (error) break;
+        }
+        else
+        {
+            if (!uivector_resize(&lz77_encoded, datasize)) ERROR_BREAK(83 /*alloc fail*/);
+            for (i = datapos; i < dataend; ++i) lz77_encoded.data[i - datapos] = data[i]; /*no LZ77, but still will be Huffman compressed*/
+        }
+
+        if (!uivector_resizev(&frequencies_ll, 286, 0)) ERROR_BREAK(83 /*alloc fail*/);
+        if (!uivector_resizev(&frequencies_d, 30, 0)) ERROR_BREAK(83 /*alloc fail*/);
+
+        /*Count the frequencies of lit, len and dist codes*/
+        for (i = 0; i != lz77_encoded.size; ++i)
+        {
+            unsigned symbol = lz77_encoded.data[i];
+            ++frequencies_ll.data[symbol];
+            if (symbol > 256)
+            {
+                unsigned dist = lz77_encoded.data[i + 2];
+                ++frequencies_d.data[dist];
+                i += 3;
+            }
+        }
+        frequencies_ll.data[256] = 1; /*there will be exactly 1 end code, at the end of the block*/
+
+        /*Make both huffman trees, one for the lit and len codes, one for the dist codes*/
+        error = HuffmanTree_makeFromFrequencies(&tree_ll, frequencies_ll.data, 257, frequencies_ll.size, 15);
+        if (error) break;
+        /*2, not 1, is chosen for mincodes: some buggy PNG decoders require at least 2 symbols in the dist tree*/
+        error = HuffmanTree_makeFromFrequencies(&tree_d, frequencies_d.data, 2, frequencies_d.size, 15);
+        if (error) break;
+
+        numcodes_ll = tree_ll.numcodes; if (numcodes_ll > 286) numcodes_ll = 286;
+        numcodes_d = tree_d.numcodes; if (numcodes_d > 30) numcodes_d = 30;
+        /*store the code lengths of both generated trees in bitlen_lld*/
+        for (i = 0; i != numcodes_ll; ++i) uivector_push_back(&bitlen_lld, HuffmanTree_getLength(&tree_ll, (unsigned)i));
+        for (i = 0; i != numcodes_d; ++i) uivector_push_back(&bitlen_lld, HuffmanTree_getLength(&tree_d, (unsigned)i));
+
+        /*run-length compress bitlen_ldd into bitlen_lld_e by using repeat codes 16 (copy length 3-6 times),
+        17 (3-10 zeroes), 18 (11-138 zeroes)*/
+        for (i = 0; i != (unsigned)bitlen_lld.size; ++i)
+        {
+            unsigned j = 0; /*amount of repititions*/
+            while (i + j + 1 < (unsigned)bitlen_lld.size && bitlen_lld.data[i + j + 1] == bitlen_lld.data[i]) ++j;
+
+            if (bitlen_lld.data[i] == 0 && j >= 2) /*repeat code for zeroes*/
+            {
+                ++j; /*include the first zero*/
+                if (j <= 10) /*repeat code 17 supports max 10 zeroes*/
+                {
+                    uivector_push_back(&bitlen_lld_e, 17);
+                    uivector_push_back(&bitlen_lld_e, j - 3);
+                }
+                else /*repeat code 18 supports max 138 zeroes*/
+                {
+                    if (j > 138) j = 138;
+                    uivector_push_back(&bitlen_lld_e, 18);
+                    uivector_push_back(&bitlen_lld_e, j - 11);
+                }
+                i += (j - 1);
+            }
+            else if (j >= 3) /*repeat code for value other than zero*/
+            {
+                size_t k;
+                unsigned num = j / 6, rest = j % 6;
+                uivector_push_back(&bitlen_lld_e, bitlen_lld.data[i]);
+                for (k = 0; k < num; ++k)
+                {
+                    uivector_push_back(&bitlen_lld_e, 16);
+                    uivector_push_back(&bitlen_lld_e, 6 - 3);
+                }
+                if (rest >= 3)
+                {
+                    uivector_push_back(&bitlen_lld_e, 16);
+                    uivector_push_back(&bitlen_lld_e, rest - 3);
+                }
+                else j -= rest;
+                i += j;
+            }
+            else /*too short to benefit from repeat code*/
+            {
+                uivector_push_back(&bitlen_lld_e, bitlen_lld.data[i]);
+            }
+        }
+
+        /*generate tree_cl, the huffmantree of huffmantrees*/
+
+        if (!uivector_resizev(&frequencies_cl, NUM_CODE_LENGTH_CODES, 0)) ERROR_BREAK(83 /*alloc fail*/);
+        for (i = 0; i != bitlen_lld_e.size; ++i)
+        {
+            ++frequencies_cl.data[bitlen_lld_e.data[i]];
+            /*after a repeat code come the bits that specify the number of repetitions,
+            those don't need to be in the frequencies_cl calculation*/
+            if (bitlen_lld_e.data[i] >= 16) ++i;
+        }
+
+        error = HuffmanTree_makeFromFrequencies(&tree_cl, frequencies_cl.data,
+            frequencies_cl.size, frequencies_cl.size, 7);
+        if (error) break;
+
+        if (!uivector_resize(&bitlen_cl, tree_cl.numcodes)) ERROR_BREAK(83 /*alloc fail*/);
+        for (i = 0; i != tree_cl.numcodes; ++i)
+        {
+            /*lenghts of code length tree is in the order as specified by deflate*/
+            bitlen_cl.data[i] = HuffmanTree_getLength(&tree_cl, CLCL_ORDER[i]);
+        }
+        while (bitlen_cl.data[bitlen_cl.size - 1] == 0 && bitlen_cl.size > 4)
+        {
+            /*remove zeros at the end, but minimum size must be 4*/
+            if (!uivector_resize(&bitlen_cl, bitlen_cl.size - 1)) ERROR_BREAK(83 /*alloc fail*/);
+        }
+        if (error) break;
+
+        /*
+        Write everything into the output
+
+        After the BFINAL and BTYPE, the dynamic block consists out of the following:
+        - 5 bits HLIT, 5 bits HDIST, 4 bits HCLEN
+        - (HCLEN+4)*3 bits code lengths of code length alphabet
+        - HLIT + 257 code lenghts of lit/length alphabet (encoded using the code length
+        alphabet, + possible repetition codes 16, 17, 18)
+        - HDIST + 1 code lengths of distance alphabet (encoded using the code length
+        alphabet, + possible repetition codes 16, 17, 18)
+        - compressed data
+        - 256 (end code)
+        */
+
+        /*Write block type*/
+        addBitToStream(bp, out, BFINAL);
+        addBitToStream(bp, out, 0); /*first bit of BTYPE "dynamic"*/
+        addBitToStream(bp, out, 1); /*second bit of BTYPE "dynamic"*/
+
+        /*write the HLIT, HDIST and HCLEN values*/
+        HLIT = (unsigned)(numcodes_ll - 257);
+        HDIST = (unsigned)(numcodes_d - 1);
+        HCLEN = (unsigned)bitlen_cl.size - 4;
+        /*trim zeroes for HCLEN. HLIT and HDIST were already trimmed at tree creation*/
+        while (!bitlen_cl.data[HCLEN + 4 - 1] && HCLEN > 0) --HCLEN;
+        addBitsToStream(bp, out, HLIT, 5);
+        addBitsToStream(bp, out, HDIST, 5);
+        addBitsToStream(bp, out, HCLEN, 4);
+
+        /*write the code lenghts of the code length alphabet*/
+        for (i = 0; i != HCLEN + 4; ++i) addBitsToStream(bp, out, bitlen_cl.data[i], 3);
+
+        /*write the lenghts of the lit/len AND the dist alphabet*/
+        for (i = 0; i != bitlen_lld_e.size; ++i)
+        {
+            addHuffmanSymbol(bp, out, HuffmanTree_getCode(&tree_cl, bitlen_lld_e.data[i]),
+                HuffmanTree_getLength(&tree_cl, bitlen_lld_e.data[i]));
+            /*extra bits of repeat codes*/
+            if (bitlen_lld_e.data[i] == 16) addBitsToStream(bp, out, bitlen_lld_e.data[++i], 2);
+            else if (bitlen_lld_e.data[i] == 17) addBitsToStream(bp, out, bitlen_lld_e.data[++i], 3);
+            else if (bitlen_lld_e.data[i] == 18) addBitsToStream(bp, out, bitlen_lld_e.data[++i], 7);
+        }
+
+        /*write the compressed data symbols*/
+        writeLZ77data(bp, out, &lz77_encoded, &tree_ll, &tree_d);
+        /*error: the length of the end code 256 must be larger than 0*/
+        if (HuffmanTree_getLength(&tree_ll, 256) == 0) ERROR_BREAK(64);
+
+        /*write the end code*/
+        addHuffmanSymbol(bp, out, HuffmanTree_getCode(&tree_ll, 256), HuffmanTree_getLength(&tree_ll, 256));
+
+        break; /*end of error-while*/
+    }
+
+    /*cleanup*/
+    uivector_cleanup(&lz77_encoded);
+    HuffmanTree_cleanup(&tree_ll);
+    HuffmanTree_cleanup(&tree_d);
+    HuffmanTree_cleanup(&tree_cl);
+    uivector_cleanup(&frequencies_ll);
+    uivector_cleanup(&frequencies_d);
+    uivector_cleanup(&frequencies_cl);
+    uivector_cleanup(&bitlen_lld_e);
+    uivector_cleanup(&bitlen_lld);
+    uivector_cleanup(&bitlen_cl);
+
+    return error;
 }
 
 static unsigned deflateFixed(ucvector* out, size_t* bp, Hash* hash,
-	const unsigned char* data,
-	size_t datapos, size_t dataend,
-	const LodePNGCompressSettings* settings, unsigned final)
-{
-	HuffmanTree tree_ll; /*tree for literal values and length codes*/
-	HuffmanTree tree_d; /*tree for distance codes*/
-
-	unsigned BFINAL = final;
-	unsigned error = 0;
-	size_t i;
-
-	HuffmanTree_init(&tree_ll);
-	HuffmanTree_init(&tree_d);
-
-	generateFixedLitLenTree(&tree_ll);
-	generateFixedDistanceTree(&tree_d);
-
-	addBitToStream(bp, out, BFINAL);
-	addBitToStream(bp, out, 1); /*first bit of BTYPE*/
-	addBitToStream(bp, out, 0); /*second bit of BTYPE*/
-
-	if (settings->use_lz77) /*LZ77 encoded*/
-	{
-		uivector lz77_encoded;
-		uivector_init(&lz77_encoded);
-		error = encodeLZ77(&lz77_encoded, hash, data, datapos, dataend, settings->windowsize,
-			settings->minmatch, settings->nicematch, settings->lazymatching);
-		if (!error) writeLZ77data(bp, out, &lz77_encoded, &tree_ll, &tree_d);
-		uivector_cleanup(&lz77_encoded);
-	}
-	else /*no LZ77, but still will be Huffman compressed*/
-	{
-		for (i = datapos; i < dataend; ++i)
-		{
-			addHuffmanSymbol(bp, out, HuffmanTree_getCode(&tree_ll, data[i]), HuffmanTree_getLength(&tree_ll, data[i]));
-		}
-	}
-	/*add END code*/
-	if (!error) addHuffmanSymbol(bp, out, HuffmanTree_getCode(&tree_ll, 256), HuffmanTree_getLength(&tree_ll, 256));
-
-	/*cleanup*/
-	HuffmanTree_cleanup(&tree_ll);
-	HuffmanTree_cleanup(&tree_d);
-
-	return error;
+    const unsigned char* data,
+    size_t datapos, size_t dataend,
+    const LodePNGCompressSettings* settings, unsigned final)
+{
+    HuffmanTree tree_ll; /*tree for literal values and length codes*/
+    HuffmanTree tree_d; /*tree for distance codes*/
+
+    unsigned BFINAL = final;
+    unsigned error = 0;
+    size_t i;
+
+    HuffmanTree_init(&tree_ll);
+    HuffmanTree_init(&tree_d);
+
+    generateFixedLitLenTree(&tree_ll);
+    generateFixedDistanceTree(&tree_d);
+
+    addBitToStream(bp, out, BFINAL);
+    addBitToStream(bp, out, 1); /*first bit of BTYPE*/
+    addBitToStream(bp, out, 0); /*second bit of BTYPE*/
+
+    if (settings->use_lz77) /*LZ77 encoded*/
+    {
+        uivector lz77_encoded;
+        uivector_init(&lz77_encoded);
+        error = encodeLZ77Settings(&lz77_encoded, hash, data, datapos, dataend, settings);
+        if (!error) writeLZ77data(bp, out, &lz77_encoded, &tree_ll, &tree_d);
+        uivector_cleanup(&lz77_encoded);
+    }
+    else /*no LZ77, but still will be Huffman compressed*/
+    {
+        for (i = datapos; i < dataend; ++i)
+        {
+            addHuffmanSymbol(bp, out, HuffmanTree_getCode(&tree_ll, data[i]), HuffmanTree_getLength(&tree_ll, data[i]));
+        }
+    }
+    /*add END code*/
+    if (!error) addHuffmanSymbol(bp, out, HuffmanTree_getCode(&tree_ll, 256), HuffmanTree_getLength(&tree_ll, 256));
+
+    /*cleanup*/
+    HuffmanTree_cleanup(&tree_ll);
+    HuffmanTree_cleanup(&tree_d);
+
+    return error;
+}
+
+static unsigned adler32(const unsigned char* data, unsigned len);
+static unsigned adler32_combine(unsigned adler1, unsigned adler2, size_t len2);
+
+/*
+Adds the positions start .. end - 1 to the hash chains without encoding them, so that the block after them
+can refer back to them. Used to give a block that is compressed on its own the window before it.
+*/
+static void hash_prime(Hash* hash, const unsigned char* in, size_t start, size_t end, size_t insize,
+    const LodePNGCompressSettings* settings)
+{
+    size_t pos;
+    unsigned numzeros = 0, dummy;
+    for (pos = start; pos < end; ++pos)
+    {
+        unsigned hashval;
+        if (settings->matchfinder == LMF_FAST)
+        {
+            findMatchFast(hash, in, pos, insize, settings->windowsize, 0, settings->nicematch, &dummy);
+            continue;
+        }
+        /*the same updates as encodeLZ77 does for every position*/
+        hashval = getHash(in, insize, pos);
+        if (hashval == 0)
+        {
+            if (numzeros == 0) numzeros = countZeros(in, insize, pos);
+            else if (pos + numzeros > insize || in[pos + numzeros - 1] != 0) --numzeros;
+        }
+        else
+        {
+            numzeros = 0;
+        }
+        updateHashChain(hash, pos & (settings->windowsize - 1), hashval, numzeros);
+    }
+}
+
+/*the result of one block that was compressed on its own*/
+typedef struct DeflateBlock
+{
+    ucvector out;
+    unsigned adler;
+    unsigned error;
+} DeflateBlock;
+
+/*the blocks of a parallel_for call, block i covers in[start + i * blocksize ..] up to end at most*/
+typedef struct DeflateBlocks
+{
+    const LodePNGCompressSettings* settings;
+    const unsigned char* in;
+    size_t first; /*index of the first byte in the input that can be used as dictionary*/
+    size_t start, end, blocksize;
+    unsigned final; /*whether the last block ends the deflate stream*/
+    DeflateBlock* blocks;
+} DeflateBlocks;
+
+/*
+Compresses one block with a hash of its own, which is filled with the window before the block first. A block
+that is not the last one of the stream is followed by an empty stored block, like a zlib sync flush, so that it
+ends on a byte boundary and the blocks can be concatenated.
+*/
+static void deflateBlockTask(void* context, size_t i)
+{
+    const DeflateBlocks* task = (const DeflateBlocks*)context;
+    const LodePNGCompressSettings* settings = task->settings;
+    DeflateBlock* block = &task->blocks[i];
+    size_t start = task->start + i * task->blocksize;
+    size_t end = task->end - start > task->blocksize ? start + task->blocksize : task->end;
+    size_t dictionary = start - task->first > settings->windowsize ? start - settings->windowsize : task->first;
+    unsigned final = task->final && end == task->end;
+    size_t bp = 0;
+    Hash hash;
+
+    block->adler = adler32(&task->in[start], (unsigned)(end - start));
+    block->error = hash_init(&hash, settings->windowsize);
+    if (!block->error)
+    {
+        if (settings->use_lz77) hash_prime(&hash, task->in, dictionary, start, end, settings);
+        if (settings->btype == 1) block->error = deflateFixed(&block->out, &bp, &hash, task->in, start, end, settings, final);
+        else block->error = deflateDynamic(&block->out, &bp, &hash, task->in, start, end, settings, final);
+    }
+    hash_cleanup(&hash);
+
+    if (!block->error && !final)
+    {
+        addBitsToStream(&bp, &block->out, 0, 3); /*BFINAL 0, BTYPE 00, then the rest of the byte is skipped*/
+        if (!ucvector_push_back(&block->out, 0) || !ucvector_push_back(&block->out, 0)
+            || !ucvector_push_back(&block->out, 255) || !ucvector_push_back(&block->out, 255))
+        {
+            block->error = 83; /*alloc fail*/
+        }
+    }
 }
 
+/*
+Compresses in[start .. end - 1] in blocks of blocksize with settings->parallel_for and appends them to out, which
+must end on a byte boundary. in[first .. start - 1] is the data before it. If adler isn't null the adler32 of the
+compressed bytes is added to it.
+*/
+static unsigned deflateParallel(ucvector* out, const unsigned char* in, size_t first, size_t start, size_t end,
+    size_t blocksize, unsigned final, unsigned* adler, const LodePNGCompressSettings* settings)
+{
+    DeflateBlocks task;
+    size_t i, count = (end - start + blocksize - 1) / blocksize;
+    unsigned error = 0;
+
+    if (count == 0) count = 1;
+    task.settings = settings;
+    task.in = in;
+    task.first = first;
+    task.start = start;
+    task.end = end;
+    task.blocksize = blocksize;
+    task.final = final;
+    task.blocks = (DeflateBlock*)lodepng_malloc(sizeof(DeflateBlock) * count);
+    if (!task.blocks) return 83; /*alloc fail*/
+    for (i = 0; i != count; ++i) ucvector_init(&task.blocks[i].out);
+
+    settings->parallel_for(deflateBlockTask, &task, count, settings);
+
+    for (i = 0; i != count; ++i)
+    {
+        DeflateBlock* block = &task.blocks[i];
+        size_t size = end - start - i * blocksize > blocksize ? blocksize : end - start - i * blocksize;
+        if (!error) error = block->error;
+        if (!error)
+        {
+            size_t oldsize = out->size;
+            if (!ucvector_resize(out, oldsize + block->out.size)) error = 83; /*alloc fail*/
+            else if (block->out.size) memcpy(out->data + oldsize, block->out.data, block->out.size);
+            if (adler) *adler = adler32_combine(*adler, block->adler, size);
+        }
+        ucvector_cleanup(&block->out);
+    }
+    lodepng_free(task.blocks);
+    return error;
+}
+
+/*deflate blocks of 65-262k seem to give the most dense encoding on PNGs*/
+static size_t deflateBlockSize(size_t insize)
+{
+    size_t blocksize = insize / 8 + 8;
+    if (blocksize < 65536) blocksize = 65536;
+    if (blocksize > 262144) blocksize = 262144;
+    return blocksize;
+}
+
+/*if adler isn't null, it is set to the adler32 of the input*/
 static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t insize,
-	const LodePNGCompressSettings* settings)
+    const LodePNGCompressSettings* settings, unsigned* adler)
 {
-	unsigned error = 0;
-	size_t i, blocksize, numdeflateblocks;
-	size_t bp = 0; /*the bit pointer*/
-	Hash hash;
+    unsigned error = 0;
+    size_t i, blocksize, numdeflateblocks;
+    size_t bp = 0; /*the bit pointer*/
+    Hash hash;
 
-	if (settings->btype > 2) return 61;
-	else if (settings->btype == 0) return deflateNoCompression(out, in, insize);
-	else if (settings->btype == 1) blocksize = insize;
-	else /*if(settings->btype == 2)*/
-	{
-		/*on PNGs, deflate blocks of 65-262k seem to give most dense encoding*/
-		blocksize = insize / 8 + 8;
-		if (blocksize < 65536) blocksize = 65536;
-		if (blocksize > 262144) blocksize = 262144;
-	}
+    if (settings->btype > 2) return 61;
+    else if (settings->btype != 0 && settings->parallel_for && insize > deflateBlockSize(insize))
+    {
+        /*with blocks that are compressed on their own, fixed blocks are split the same way*/
+        if (adler) *adler = 1;
+        return deflateParallel(out, in, 0, 0, insize, deflateBlockSize(insize), 1, adler, settings);
+    }
 
-	numdeflateblocks = (insize + blocksize - 1) / blocksize;
-	if (numdeflateblocks == 0) numdeflateblocks = 1;
+    if (adler) *adler = adler32(in, (unsigned)insize);
+    if (settings->btype == 0) return deflateNoCompression(out, in, insize, 1);
+    else if (settings->btype == 1) blocksize = insize;
+    else /*if(settings->btype == 2)*/ blocksize = deflateBlockSize(insize);
 
-	error = hash_init(&hash, settings->windowsize);
-	if (error) return error;
+    numdeflateblocks = (insize + blocksize - 1) / blocksize;
+    if (numdeflateblocks == 0) numdeflateblocks = 1;
 
-	for (i = 0; i != numdeflateblocks && !error; ++i)
-	{
-		unsigned final = (i == numdeflateblocks - 1);
-		size_t start = i * blocksize;
-		size_t end = start + blocksize;
-		if (end > insize) end = insize;
+    error = hash_init(&hash, settings->windowsize);
+    if (error) return error;
 
-		if (settings->btype == 1) error = deflateFixed(out, &bp, &hash, in, start, end, settings, final);
-		else if (settings->btype == 2) error = deflateDynamic(out, &bp, &hash, in, start, end, settings, final);
-	}
+    for (i = 0; i != numdeflateblocks && !error; ++i)
+    {
+        unsigned final = (i == numdeflateblocks - 1);
+        size_t start = i * blocksize;
+        size_t end = start + blocksize;
+        if (end > insize) end = insize;
 
-	hash_cleanup(&hash);
+        if (settings->btype == 1) error = deflateFixed(out, &bp, &hash, in, start, end, settings, final);
+        else if (settings->btype == 2) error = deflateDynamic(out, &bp, &hash, in, start, end, settings, final);
+    }
 
-	return error;
-}
+    hash_cleanup(&hash);
 
-unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
-	const unsigned char* in, size_t insize,
-	const LodePNGCompressSettings* settings)
-{
-	unsigned error;
-	ucvector v;
-	ucvector_init_buffer(&v, *out, *outsize);
-	error = lodepng_deflatev(&v, in, insize, settings);
-	*out = v.data;
-	*outsize = v.size;
-	return error;
+    return error;
 }
 
-static unsigned deflate(unsigned char** out, size_t* outsize,
-	const unsigned char* in, size_t insize,
-	const LodePNGCompressSettings* settings)
+unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
+    const unsigned char* in, size_t insize,
+    const LodePNGCompressSettings* settings)
 {
-	if (settings->custom_deflate)
-	{
-		return settings->custom_deflate(out, outsize, in, insize, settings);
-	}
-	else
-	{
-		return lodepng_deflate(out, outsize, in, insize, settings);
-	}
+    unsigned error;
+    ucvector v;
+    ucvector_init_buffer(&v, *out, *outsize);
+    error = lodepng_deflatev(&v, in, insize, settings, 0);
+    *out = v.data;
+    *outsize = v.size;
+    return error;
 }
 
 #endif /*LODEPNG_COMPILE_DECODER*/
@@ -2090,176 +2740,471 @@ static unsigned deflate(unsigned char** out, size_t* outsize,
 /* / Adler32                                                                  */
 /* ////////////////////////////////////////////////////////////////////////// */
 
+#ifdef LODEPNG_X86_SIMD
+/*
+Adds 32 bytes per step: s1 gets the sum of the bytes, s2 gets 32 times the previous s1 plus the bytes weighted
+32 down to 1, the multiply-adds of SSSE3 compute the weighted sums. Returns the sums of the whole 32 byte blocks,
+the remaining bytes are left to the scalar code.
+*/
+__attribute__((target("ssse3")))
+static unsigned update_adler32_ssse3(unsigned adler, const unsigned char** data, unsigned* len)
+{
+    const __m128i weights1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+    const __m128i weights2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    unsigned s1 = adler & 0xffff;
+    unsigned s2 = (adler >> 16) & 0xffff;
+    unsigned blocks = *len / 32;
+    const unsigned char* p = *data;
+
+    *len -= blocks * 32;
+    while (blocks > 0)
+    {
+        /*5536 bytes, like the scalar loop the sums don't overflow before the modulo*/
+        unsigned amount = blocks > 173 ? 173 : blocks;
+        __m128i previous = _mm_setr_epi32(0, 0, 0, (int)(s1 * amount)); /*sum of s1 before every block*/
+        __m128i sum1 = zero;
+        __m128i sum2 = _mm_setr_epi32(0, 0, 0, (int)s2);
+        blocks -= amount;
+        while (amount > 0)
+        {
+            const __m128i bytes1 = _mm_loadu_si128((const __m128i*)p);
+            const __m128i bytes2 = _mm_loadu_si128((const __m128i*)(p + 16));
+            previous = _mm_add_epi32(previous, sum1);
+            sum1 = _mm_add_epi32(sum1, _mm_add_epi32(_mm_sad_epu8(bytes1, zero), _mm_sad_epu8(bytes2, zero)));
+            sum2 = _mm_add_epi32(sum2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, weights1), ones));
+            sum2 = _mm_add_epi32(sum2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, weights2), ones));
+            p += 32;
+            --amount;
+        }
+        sum2 = _mm_add_epi32(sum2, _mm_slli_epi32(previous, 5));
+
+        /*add the four lanes*/
+        sum1 = _mm_add_epi32(sum1, _mm_shuffle_epi32(sum1, _MM_SHUFFLE(2, 3, 0, 1)));
+        sum1 = _mm_add_epi32(sum1, _mm_shuffle_epi32(sum1, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum2 = _mm_add_epi32(sum2, _mm_shuffle_epi32(sum2, _MM_SHUFFLE(2, 3, 0, 1)));
+        sum2 = _mm_add_epi32(sum2, _mm_shuffle_epi32(sum2, _MM_SHUFFLE(1, 0, 3, 2)));
+        s1 = (s1 + (unsigned)_mm_cvtsi128_si32(sum1)) % 65521;
+        s2 = (unsigned)_mm_cvtsi128_si32(sum2) % 65521;
+    }
+
+    *data = p;
+    return (s2 << 16) | s1;
+}
+#endif /*LODEPNG_X86_SIMD*/
+
 static unsigned update_adler32(unsigned adler, const unsigned char* data, unsigned len)
 {
-	unsigned s1 = adler & 0xffff;
-	unsigned s2 = (adler >> 16) & 0xffff;
+    unsigned s1, s2;
 
-	while (len > 0)
-	{
-		/*at least 5550 sums can be done before the sums overflow, saving a lot of module divisions*/
-		unsigned amount = len > 5550 ? 5550 : len;
-		len -= amount;
-		while (amount > 0)
-		{
-			s1 += (*data++);
-			s2 += s1;
-			--amount;
-		}
-		s1 %= 65521;
-		s2 %= 65521;
-	}
+#ifdef LODEPNG_X86_SIMD
+    if (len >= 64 && __builtin_cpu_supports("ssse3")) adler = update_adler32_ssse3(adler, &data, &len);
+#endif /*LODEPNG_X86_SIMD*/
+    s1 = adler & 0xffff;
+    s2 = (adler >> 16) & 0xffff;
 
-	return (s2 << 16) | s1;
+    while (len > 0)
+    {
+        /*at least 5550 sums can be done before the sums overflow, saving a lot of module divisions*/
+        unsigned amount = len > 5550 ? 5550 : len;
+        len -= amount;
+        while (amount > 0)
+        {
+            s1 += (*data++);
+            s2 += s1;
+            --amount;
+        }
+        s1 %= 65521;
+        s2 %= 65521;
+    }
+
+    return (s2 << 16) | s1;
 }
 
 /*Return the adler32 of the bytes data[0..len-1]*/
 static unsigned adler32(const unsigned char* data, unsigned len)
 {
-	return update_adler32(1L, data, len);
+    return update_adler32(1L, data, len);
 }
 
+#ifdef LODEPNG_COMPILE_ENCODER
+/*
+Return the adler32 of two pieces of data from the adler32 of each and the length of the second. Appending len2
+bytes adds len2 times s1 of the first piece to s2, and both sums of the second piece without their start value.
+*/
+static unsigned adler32_combine(unsigned adler1, unsigned adler2, size_t len2)
+{
+    unsigned rem = (unsigned)(len2 % 65521);
+    unsigned s1 = adler1 & 0xffff;
+    unsigned s2 = (unsigned)(((unsigned long)rem * s1) % 65521);
+    s1 += (adler2 & 0xffff) + 65521 - 1;
+    s2 += ((adler1 >> 16) & 0xffff) + ((adler2 >> 16) & 0xffff) + 65521 - rem;
+    if (s1 >= 65521) s1 -= 65521;
+    if (s1 >= 65521) s1 -= 65521;
+    if (s2 >= 65521 * 2) s2 -= 65521 * 2;
+    if (s2 >= 65521) s2 -= 65521;
+    return (s2 << 16) | s1;
+}
+#endif /*LODEPNG_COMPILE_ENCODER*/
+
 /* ////////////////////////////////////////////////////////////////////////// */
 /* / Zlib                                                                   / */
 /* ////////////////////////////////////////////////////////////////////////// */
 
 #ifdef LODEPNG_COMPILE_DECODER
 
+/*checks the 2 byte zlib header in front of the deflate data, return value is error*/
+static unsigned zlib_check_header(const unsigned char* in, size_t insize)
+{
+    unsigned CM, CINFO, FDICT;
+
+    if (insize < 2) return 53; /*error, size of zlib data too small*/
+    /*read information from zlib header*/
+    if ((in[0] * 256 + in[1]) % 31 != 0)
+    {
+        /*error: 256 * in[0] + in[1] must be a multiple of 31, the FCHECK value is supposed to be made that way*/
+        return 24;
+    }
+
+    CM = in[0] & 15;
+    CINFO = (in[0] >> 4) & 15;
+    /*FCHECK = in[1] & 31;*/ /*FCHECK is already tested above*/
+    FDICT = (in[1] >> 5) & 1;
+    /*FLEVEL = (in[1] >> 6) & 3;*/ /*FLEVEL is not used here*/
+
+    if (CM != 8 || CINFO > 7)
+    {
+        /*error: only compression method 8: inflate with sliding window of 32k is supported by the PNG spec*/
+        return 25;
+    }
+    if (FDICT != 0)
+    {
+        /*error: the specification of PNG says about the zlib stream:
+        "The additional flags shall not specify a preset dictionary."*/
+        return 26;
+    }
+    return 0;
+}
+
 unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in,
-	size_t insize, const LodePNGDecompressSettings* settings)
-{
-	unsigned error = 0;
-	unsigned CM, CINFO, FDICT;
-
-	if (insize < 2) return 53; /*error, size of zlib data too small*/
-	/*read information from zlib header*/
-	if ((in[0] * 256 + in[1]) % 31 != 0)
-	{
-		/*error: 256 * in[0] + in[1] must be a multiple of 31, the FCHECK value is supposed to be made that way*/
-		return 24;
-	}
-
-	CM = in[0] & 15;
-	CINFO = (in[0] >> 4) & 15;
-	/*FCHECK = in[1] & 31;*/ /*FCHECK is already tested above*/
-	FDICT = (in[1] >> 5) & 1;
-	/*FLEVEL = (in[1] >> 6) & 3;*/ /*FLEVEL is not used here*/
-
-	if (CM != 8 || CINFO > 7)
-	{
-		/*error: only compression method 8: inflate with sliding window of 32k is supported by the PNG spec*/
-		return 25;
-	}
-	if (FDICT != 0)
-	{
-		/*error: the specification of PNG says about the zlib stream:
-		"The additional flags shall not specify a preset dictionary."*/
-		return 26;
-	}
-
-	error = inflate(out, outsize, in + 2, insize - 2, settings);
-	if (error) return error;
-
-	if (!settings->ignore_adler32)
-	{
-		unsigned ADLER32 = lodepng_read32bitInt(&in[insize - 4]);
-		unsigned checksum = adler32(*out, (unsigned)(*outsize));
-		if (checksum != ADLER32) return 58; /*error, adler checksum not correct, data must be corrupted*/
-	}
-
-	return 0; /*no error*/
+    size_t insize, const LodePNGDecompressSettings* settings)
+{
+    unsigned error = zlib_check_header(in, insize);
+    if (error) return error;
+
+    error = inflate(out, outsize, in + 2, insize - 2, settings);
+    if (error) return error;
+
+    if (!settings->ignore_adler32)
+    {
+        unsigned ADLER32 = lodepng_read32bitInt(&in[insize - 4]);
+        unsigned checksum = adler32(*out, (unsigned)(*outsize));
+        if (checksum != ADLER32) return 58; /*error, adler checksum not correct, data must be corrupted*/
+    }
+
+    return 0; /*no error*/
 }
 
 static unsigned zlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in,
-	size_t insize, const LodePNGDecompressSettings* settings)
+    size_t insize, const LodePNGDecompressSettings* settings)
 {
-	if (settings->custom_zlib)
-	{
-		return settings->custom_zlib(out, outsize, in, insize, settings);
-	}
-	else
-	{
-		return lodepng_zlib_decompress(out, outsize, in, insize, settings);
-	}
+    if (settings->custom_zlib)
+    {
+        return settings->custom_zlib(out, outsize, in, insize, settings);
+    }
+    else
+    {
+        return lodepng_zlib_decompress(out, outsize, in, insize, settings);
+    }
 }
 
+#ifdef LODEPNG_COMPILE_PNG
+/*
+Decompresses zlib data that is split in segments with the built in inflate, the segments are read in place.
+custom_zlib and custom_inflate are not used since they need the data in one buffer. insize is the total size
+of the segments. Without a stream all output goes to out, with a stream it is handed to the stream callback
+in pieces and out only holds the window.
+*/
+static unsigned zlib_decompress_segments(ucvector* out, const unsigned char* in, size_t size, NextSegment next_segment,
+    const void* context, size_t insize, const LodePNGDecompressSettings* settings, InflateStream* stream)
+{
+    BitReader reader, tail;
+    unsigned char header[2] = { 0, 0 };
+    unsigned error;
+
+    BitReader_init(&reader, in, size, next_segment, context);
+    tail = reader;
+    if (insize >= 2)
+    {
+        header[0] = (unsigned char)BitReader_read(&reader, 8);
+        header[1] = (unsigned char)BitReader_read(&reader, 8);
+    }
+    error = zlib_check_header(header, insize);
+    if (error) return error;
+
+    error = lodepng_inflatev(out, &reader, insize, settings, stream);
+    if (error == INFLATE_STREAM_STOP) return 0;
+    if (error) return error;
+
+    if (!settings->ignore_adler32)
+    {
+        /*the checksum is in the last 4 bytes, which can be in another segment than where the deflate data ended*/
+        unsigned char checksum[4];
+        unsigned ADLER32;
+        BitReader_copy(&tail, 0, insize - 4);
+        BitReader_copy(&tail, checksum, 4);
+        ADLER32 = lodepng_read32bitInt(checksum);
+        if (stream ? stream->adler != ADLER32 : adler32(out->data, (unsigned)out->size) != ADLER32)
+        {
+            return 58; /*error, adler checksum not correct, data must be corrupted*/
+        }
+    }
+    return 0;
+}
+
+/*like zlib_decompress_segments, handing the output to the callback in pieces instead of returning it in one buffer*/
+static unsigned zlib_decompress_stream(const unsigned char* in, size_t size, NextSegment next_segment,
+    const void* context, size_t insize, const LodePNGDecompressSettings* settings,
+    unsigned (*callback)(void* user, const unsigned char* data, size_t size), void* user)
+{
+    ucvector window;
+    InflateStream stream;
+    unsigned error;
+
+    stream.callback = callback;
+    stream.user = user;
+    stream.delivered = 0;
+    stream.adler = 1;
+    ucvector_init(&window);
+    error = zlib_decompress_segments(&window, in, size, next_segment, context, insize, settings, &stream);
+    ucvector_cleanup(&window);
+    return error;
+}
+#endif /*LODEPNG_COMPILE_PNG*/
+
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 #ifdef LODEPNG_COMPILE_ENCODER
 
 unsigned lodepng_zlib_compress(unsigned char** out, size_t* outsize, const unsigned char* in,
-	size_t insize, const LodePNGCompressSettings* settings)
-{
-	/*initially, *out must be NULL and outsize 0, if you just give some random *out
-	that's pointing to a non allocated buffer, this'll crash*/
-	ucvector outv;
-	size_t i;
-	unsigned error;
-	unsigned char* deflatedata = 0;
-	size_t deflatesize = 0;
-
-	/*zlib data: 1 byte CMF (CM+CINFO), 1 byte FLG, deflate data, 4 byte ADLER32 checksum of the Decompressed data*/
-	unsigned CMF = 120; /*0b01111000: CM 8, CINFO 7. With CINFO 7, any window size up to 32768 can be used.*/
-	unsigned FLEVEL = 0;
-	unsigned FDICT = 0;
-	unsigned CMFFLG = 256 * CMF + FDICT * 32 + FLEVEL * 64;
-	unsigned FCHECK = 31 - CMFFLG % 31;
-	CMFFLG += FCHECK;
-
-	/*ucvector-controlled version of the output buffer, for dynamic array*/
-	ucvector_init_buffer(&outv, *out, *outsize);
-
-	ucvector_push_back(&outv, (unsigned char)(CMFFLG >> 8));
-	ucvector_push_back(&outv, (unsigned char)(CMFFLG & 255));
-
-	error = deflate(&deflatedata, &deflatesize, in, insize, settings);
-
-	if (!error)
-	{
-		unsigned ADLER32 = adler32(in, (unsigned)insize);
-		for (i = 0; i != deflatesize; ++i) ucvector_push_back(&outv, deflatedata[i]);
-		lodepng_free(deflatedata);
-		lodepng_add32bitInt(&outv, ADLER32);
-	}
-
-	*out = outv.data;
-	*outsize = outv.size;
-
-	return error;
+    size_t insize, const LodePNGCompressSettings* settings)
+{
+    /*initially, *out must be NULL and outsize 0, if you just give some random *out
+    that's pointing to a non allocated buffer, this'll crash*/
+    ucvector outv;
+    size_t i;
+    unsigned error;
+    unsigned char* deflatedata = 0;
+    size_t deflatesize = 0;
+    unsigned ADLER32 = 1;
+
+    /*zlib data: 1 byte CMF (CM+CINFO), 1 byte FLG, deflate data, 4 byte ADLER32 checksum of the Decompressed data*/
+    unsigned CMF = 120; /*0b01111000: CM 8, CINFO 7. With CINFO 7, any window size up to 32768 can be used.*/
+    unsigned FLEVEL = 0;
+    unsigned FDICT = 0;
+    unsigned CMFFLG = 256 * CMF + FDICT * 32 + FLEVEL * 64;
+    unsigned FCHECK = 31 - CMFFLG % 31;
+    CMFFLG += FCHECK;
+
+    /*ucvector-controlled version of the output buffer, for dynamic array*/
+    ucvector_init_buffer(&outv, *out, *outsize);
+
+    ucvector_push_back(&outv, (unsigned char)(CMFFLG >> 8));
+    ucvector_push_back(&outv, (unsigned char)(CMFFLG & 255));
+
+    if (settings->custom_deflate)
+    {
+        error = settings->custom_deflate(&deflatedata, &deflatesize, in, insize, settings);
+        if (!error)
+        {
+            ADLER32 = adler32(in, (unsigned)insize);
+            for (i = 0; i != deflatesize; ++i) ucvector_push_back(&outv, deflatedata[i]);
+            lodepng_free(deflatedata);
+        }
+    }
+    else
+    {
+        /*the built in deflate computes the checksum itself, with parallel_for each block does its part*/
+        error = lodepng_deflatev(&outv, in, insize, settings, &ADLER32);
+    }
+
+    if (!error) lodepng_add32bitInt(&outv, ADLER32);
+
+    *out = outv.data;
+    *outsize = outv.size;
+
+    return error;
 }
 
 /* compress using the default or custom zlib function */
 static unsigned zlib_compress(unsigned char** out, size_t* outsize, const unsigned char* in,
-	size_t insize, const LodePNGCompressSettings* settings)
+    size_t insize, const LodePNGCompressSettings* settings)
 {
-	if (settings->custom_zlib)
-	{
-		return settings->custom_zlib(out, outsize, in, insize, settings);
-	}
-	else
-	{
-		return lodepng_zlib_compress(out, outsize, in, insize, settings);
-	}
+    if (settings->custom_zlib)
+    {
+        return settings->custom_zlib(out, outsize, in, insize, settings);
+    }
+    else
+    {
+        return lodepng_zlib_compress(out, outsize, in, insize, settings);
+    }
 }
 
+#ifdef LODEPNG_COMPILE_PNG
+/*
+Zlib compression of data that arrives in pieces, the total size must be known in advance. Every deflate
+block is compressed as soon as all of its input has arrived, so only the block and the window before it are
+buffered. Dynamic blocks have the same sizes as in lodepng_deflatev, which gives the same output as
+lodepng_zlib_compress. Fixed blocks use those sizes too instead of a single block. custom_zlib and
+custom_deflate are not used since they need all input at once. With parallel_for, the input is buffered until
+ZLIB_STREAM_PARALLEL_BLOCKS blocks are complete, these are compressed together like in lodepng_deflatev.
+*/
+#define ZLIB_STREAM_PARALLEL_BLOCKS 16
+
+typedef struct ZlibStream
+{
+    const LodePNGCompressSettings* settings;
+    Hash hash;
+    ucvector in; /*the window before the next block, followed by the input that is not compressed yet*/
+    size_t inpos; /*position in the in vector of the first byte that is not compressed yet*/
+    size_t remaining; /*number of input bytes that are not compressed yet, including those still to come*/
+    size_t blocksize;
+    unsigned parallel; /*whether the blocks are compressed with parallel_for, then the hash is not used*/
+    unsigned adler;
+    ucvector out; /*compressed data that was not taken yet, the last byte may be partially filled*/
+    size_t bp; /*bit pointer, only its lowest 3 bits are used*/
+} ZlibStream;
+
+static unsigned zlib_stream_init(ZlibStream* stream, size_t insize, const LodePNGCompressSettings* settings)
+{
+    /*same header as lodepng_zlib_compress*/
+    unsigned CMFFLG = 256 * 120;
+    CMFFLG += 31 - CMFFLG % 31;
+
+    stream->settings = settings;
+    stream->inpos = 0;
+    stream->remaining = insize;
+    stream->adler = 1;
+    stream->bp = 0;
+    ucvector_init(&stream->in);
+    ucvector_init(&stream->out);
+
+    if (settings->btype > 2) return 61;
+    else if (settings->btype == 0) stream->blocksize = 65535; /*the largest stored block*/
+    else stream->blocksize = deflateBlockSize(insize);
+    /*like lodepng_deflatev, a single block is compressed as usual*/
+    stream->parallel = settings->btype != 0 && settings->parallel_for && insize > stream->blocksize;
+
+    if (settings->btype != 0 && !stream->parallel)
+    {
+        unsigned error = hash_init(&stream->hash, settings->windowsize);
+        if (error) return error;
+    }
+    if (!ucvector_push_back(&stream->out, (unsigned char)(CMFFLG >> 8))) return 83; /*alloc fail*/
+    if (!ucvector_push_back(&stream->out, (unsigned char)(CMFFLG & 255))) return 83; /*alloc fail*/
+    return 0;
+}
+
+static void zlib_stream_cleanup(ZlibStream* stream)
+{
+    if ((stream->settings->btype == 1 || stream->settings->btype == 2) && !stream->parallel) hash_cleanup(&stream->hash);
+    ucvector_cleanup(&stream->in);
+    ucvector_cleanup(&stream->out);
+}
+
+/*appends input and compresses every block that is complete, after the last block the adler checksum follows*/
+static unsigned zlib_stream_add(ZlibStream* stream, const unsigned char* in, size_t insize)
+{
+    const LodePNGCompressSettings* settings = stream->settings;
+    size_t oldsize = stream->in.size;
+    unsigned error = 0;
+
+    if (!ucvector_resize(&stream->in, oldsize + insize)) return 83; /*alloc fail*/
+    memcpy(stream->in.data + oldsize, in, insize);
+
+    while (!error)
+    {
+        size_t start = stream->inpos;
+        size_t size = stream->remaining < stream->blocksize ? stream->remaining : stream->blocksize;
+        size_t end = start + size, shift;
+        unsigned final = (size == stream->remaining);
+        if (stream->parallel && !final)
+        {
+            /*a batch of whole blocks, or everything that is left*/
+            size = stream->remaining < stream->blocksize * ZLIB_STREAM_PARALLEL_BLOCKS ? stream->remaining : stream->blocksize * ZLIB_STREAM_PARALLEL_BLOCKS;
+            end = start + size;
+            final = (size == stream->remaining);
+        }
+        if (size == 0 || end > stream->in.size) break;
+
+        if (stream->parallel)
+        {
+            error = deflateParallel(&stream->out, stream->in.data, 0, start, end, stream->blocksize, final, &stream->adler, settings);
+        }
+        else
+        {
+            if (settings->btype == 0) error = deflateNoCompression(&stream->out, &stream->in.data[start], size, final);
+            else if (settings->btype == 1) error = deflateFixed(&stream->out, &stream->bp, &stream->hash, stream->in.data, start, end, settings, final);
+            else error = deflateDynamic(&stream->out, &stream->bp, &stream->hash, stream->in.data, start, end, settings, final);
+            if (!error) stream->adler = update_adler32(stream->adler, &stream->in.data[start], (unsigned)size);
+        }
+        if (error) break;
+
+        stream->inpos = end;
+        stream->remaining -= size;
+        if (final)
+        {
+            lodepng_add32bitInt(&stream->out, stream->adler);
+            stream->bp = 0; /*the last byte is complete now*/
+        }
+
+        /*keep one window, dropping a multiple of the window size so the circular positions in the hash stay valid*/
+        if (settings->btype == 0) shift = end;
+        else shift = end > settings->windowsize ? (end - settings->windowsize) & ~(size_t)(settings->windowsize - 1) : 0;
+        if (shift)
+        {
+            memmove(stream->in.data, stream->in.data + shift, stream->in.size - shift);
+            stream->in.size -= shift;
+            stream->inpos -= shift;
+        }
+    }
+    return error;
+}
+
+/*number of bytes at the start of the compressed output that are complete*/
+static size_t zlib_stream_available(const ZlibStream* stream)
+{
+    return (stream->bp & 7) ? stream->out.size - 1 : stream->out.size;
+}
+
+/*removes the complete bytes from the compressed output once they are written*/
+static void zlib_stream_consume(ZlibStream* stream)
+{
+    size_t available = zlib_stream_available(stream);
+    if (available != stream->out.size) stream->out.data[0] = stream->out.data[available];
+    stream->out.size -= available;
+}
+#endif /*LODEPNG_COMPILE_PNG*/
+
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
 #else /*no LODEPNG_COMPILE_ZLIB*/
 
 #ifdef LODEPNG_COMPILE_DECODER
 static unsigned zlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in,
-	size_t insize, const LodePNGDecompressSettings* settings)
+    size_t insize, const LodePNGDecompressSettings* settings)
 {
-	if (!settings->custom_zlib) return 87; /*no custom zlib function provided */
-	return settings->custom_zlib(out, outsize, in, insize, settings);
+    if (!settings->custom_zlib) return 87; /*no custom zlib function provided */
+    return settings->custom_zlib(out, outsize, in, insize, settings);
 }
 #endif /*LODEPNG_COMPILE_DECODER*/
 #ifdef LODEPNG_COMPILE_ENCODER
 static unsigned zlib_compress(unsigned char** out, size_t* outsize, const unsigned char* in,
-	size_t insize, const LodePNGCompressSettings* settings)
+    size_t insize, const LodePNGCompressSettings* settings)
 {
-	if (!settings->custom_zlib) return 87; /*no custom zlib function provided */
-	return settings->custom_zlib(out, outsize, in, insize, settings);
+    if (!settings->custom_zlib) return 87; /*no custom zlib function provided */
+    return settings->custom_zlib(out, outsize, in, insize, settings);
 }
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
@@ -2274,20 +3219,22 @@ static unsigned zlib_compress(unsigned char** out, size_t* outsize, const unsign
 
 void lodepng_compress_settings_init(LodePNGCompressSettings* settings)
 {
-	/*compress with dynamic huffman tree (not in the mathematical sense, just not the predefined one)*/
-	settings->btype = 2;
-	settings->use_lz77 = 1;
-	settings->windowsize = DEFAULT_WINDOWSIZE;
-	settings->minmatch = 3;
-	settings->nicematch = 128;
-	settings->lazymatching = 1;
+    /*compress with dynamic huffman tree (not in the mathematical sense, just not the predefined one)*/
+    settings->btype = 2;
+    settings->use_lz77 = 1;
+    settings->windowsize = DEFAULT_WINDOWSIZE;
+    settings->minmatch = 3;
+    settings->nicematch = 128;
+    settings->lazymatching = 1;
+    settings->matchfinder = LMF_HASH_CHAIN;
 
-	settings->custom_zlib = 0;
-	settings->custom_deflate = 0;
-	settings->custom_context = 0;
+    settings->custom_zlib = 0;
+    settings->custom_deflate = 0;
+    settings->parallel_for = 0;
+    settings->custom_context = 0;
 }
 
-const LodePNGCompressSettings lodepng_default_compress_settings = { 2, 1, DEFAULT_WINDOWSIZE, 3, 128, 1, 0, 0, 0 };
+const LodePNGCompressSettings lodepng_default_compress_settings = { 2, 1, DEFAULT_WINDOWSIZE, 3, 128, 1, LMF_HASH_CHAIN, 0, 0, 0, 0 };
 
 
 #endif /*LODEPNG_COMPILE_ENCODER*/
@@ -2296,14 +3243,15 @@ const LodePNGCompressSettings lodepng_default_compress_settings = { 2, 1, DEFAUL
 
 void lodepng_decompress_settings_init(LodePNGDecompressSettings* settings)
 {
-	settings->ignore_adler32 = 0;
+    settings->ignore_adler32 = 0;
+    settings->bitwise_huffman = 0;
 
-	settings->custom_zlib = 0;
-	settings->custom_inflate = 0;
-	settings->custom_context = 0;
+    settings->custom_zlib = 0;
+    settings->custom_inflate = 0;
+    settings->custom_context = 0;
 }
 
-const LodePNGDecompressSettings lodepng_default_decompress_settings = { 0, 0, 0, 0 };
+const LodePNGDecompressSettings lodepng_default_decompress_settings = { 0, 0, 0, 0, 0 };
 
 #endif /*LODEPNG_COMPILE_DECODER*/
 
@@ -2321,52 +3269,383 @@ const LodePNGDecompressSettings lodepng_default_decompress_settings = { 0, 0, 0,
 
 
 #ifndef LODEPNG_NO_COMPILE_CRC
-/* CRC polynomial: 0xedb88320 */
-static unsigned lodepng_crc32_table[256] = {
-	0u, 1996959894u, 3993919788u, 2567524794u, 124634137u, 1886057615u, 3915621685u, 2657392035u,
-	249268274u, 2044508324u, 3772115230u, 2547177864u, 162941995u, 2125561021u, 3887607047u, 2428444049u,
-	498536548u, 1789927666u, 4089016648u, 2227061214u, 450548861u, 1843258603u, 4107580753u, 2211677639u,
-	325883990u, 1684777152u, 4251122042u, 2321926636u, 335633487u, 1661365465u, 4195302755u, 2366115317u,
-	997073096u, 1281953886u, 3579855332u, 2724688242u, 1006888145u, 1258607687u, 3524101629u, 2768942443u,
-	901097722u, 1119000684u, 3686517206u, 2898065728u, 853044451u, 1172266101u, 3705015759u, 2882616665u,
-	651767980u, 1373503546u, 3369554304u, 3218104598u, 565507253u, 1454621731u, 3485111705u, 3099436303u,
-	671266974u, 1594198024u, 3322730930u, 2970347812u, 795835527u, 1483230225u, 3244367275u, 3060149565u,
-	1994146192u, 31158534u, 2563907772u, 4023717930u, 1907459465u, 112637215u, 2680153253u, 3904427059u,
-	2013776290u, 251722036u, 2517215374u, 3775830040u, 2137656763u, 141376813u, 2439277719u, 3865271297u,
-	1802195444u, 476864866u, 2238001368u, 4066508878u, 1812370925u, 453092731u, 2181625025u, 4111451223u,
-	1706088902u, 314042704u, 2344532202u, 4240017532u, 1658658271u, 366619977u, 2362670323u, 4224994405u,
-	1303535960u, 984961486u, 2747007092u, 3569037538u, 1256170817u, 1037604311u, 2765210733u, 3554079995u,
-	1131014506u, 879679996u, 2909243462u, 3663771856u, 1141124467u, 855842277u, 2852801631u, 3708648649u,
-	1342533948u, 654459306u, 3188396048u, 3373015174u, 1466479909u, 544179635u, 3110523913u, 3462522015u,
-	1591671054u, 702138776u, 2966460450u, 3352799412u, 1504918807u, 783551873u, 3082640443u, 3233442989u,
-	3988292384u, 2596254646u, 62317068u, 1957810842u, 3939845945u, 2647816111u, 81470997u, 1943803523u,
-	3814918930u, 2489596804u, 225274430u, 2053790376u, 3826175755u, 2466906013u, 167816743u, 2097651377u,
-	4027552580u, 2265490386u, 503444072u, 1762050814u, 4150417245u, 2154129355u, 426522225u, 1852507879u,
-	4275313526u, 2312317920u, 282753626u, 1742555852u, 4189708143u, 2394877945u, 397917763u, 1622183637u,
-	3604390888u, 2714866558u, 953729732u, 1340076626u, 3518719985u, 2797360999u, 1068828381u, 1219638859u,
-	3624741850u, 2936675148u, 906185462u, 1090812512u, 3747672003u, 2825379669u, 829329135u, 1181335161u,
-	3412177804u, 3160834842u, 628085408u, 1382605366u, 3423369109u, 3138078467u, 570562233u, 1426400815u,
-	3317316542u, 2998733608u, 733239954u, 1555261956u, 3268935591u, 3050360625u, 752459403u, 1541320221u,
-	2607071920u, 3965973030u, 1969922972u, 40735498u, 2617837225u, 3943577151u, 1913087877u, 83908371u,
-	2512341634u, 3803740692u, 2075208622u, 213261112u, 2463272603u, 3855990285u, 2094854071u, 198958881u,
-	2262029012u, 4057260610u, 1759359992u, 534414190u, 2176718541u, 4139329115u, 1873836001u, 414664567u,
-	2282248934u, 4279200368u, 1711684554u, 285281116u, 2405801727u, 4167216745u, 1634467795u, 376229701u,
-	2685067896u, 3608007406u, 1308918612u, 956543938u, 2808555105u, 3495958263u, 1231636301u, 1047427035u,
-	2932959818u, 3654703836u, 1088359270u, 936918000u, 2847714899u, 3736837829u, 1202900863u, 817233897u,
-	3183342108u, 3401237130u, 1404277552u, 615818150u, 3134207493u, 3453421203u, 1423857449u, 601450431u,
-	3009837614u, 3294710456u, 1567103746u, 711928724u, 3020668471u, 3272380065u, 1510334235u, 755167117u
+/*
+CRC polynomial: 0xedb88320. lodepng_crc32_table[0] is the table for a single byte, lodepng_crc32_table[k] gives
+the CRC of a byte followed by k zero bytes, which lets the CRC of 8 bytes be computed with 8 independent lookups.
+*/
+static const unsigned lodepng_crc32_table[8][256] = {
+    {
+        0u, 1996959894u, 3993919788u, 2567524794u, 124634137u, 1886057615u, 3915621685u, 2657392035u,
+        249268274u, 2044508324u, 3772115230u, 2547177864u, 162941995u, 2125561021u, 3887607047u, 2428444049u,
+        498536548u, 1789927666u, 4089016648u, 2227061214u, 450548861u, 1843258603u, 4107580753u, 2211677639u,
+        325883990u, 1684777152u, 4251122042u, 2321926636u, 335633487u, 1661365465u, 4195302755u, 2366115317u,
+        997073096u, 1281953886u, 3579855332u, 2724688242u, 1006888145u, 1258607687u, 3524101629u, 2768942443u,
+        901097722u, 1119000684u, 3686517206u, 2898065728u, 853044451u, 1172266101u, 3705015759u, 2882616665u,
+        651767980u, 1373503546u, 3369554304u, 3218104598u, 565507253u, 1454621731u, 3485111705u, 3099436303u,
+        671266974u, 1594198024u, 3322730930u, 2970347812u, 795835527u, 1483230225u, 3244367275u, 3060149565u,
+        1994146192u, 31158534u, 2563907772u, 4023717930u, 1907459465u, 112637215u, 2680153253u, 3904427059u,
+        2013776290u, 251722036u, 2517215374u, 3775830040u, 2137656763u, 141376813u, 2439277719u, 3865271297u,
+        1802195444u, 476864866u, 2238001368u, 4066508878u, 1812370925u, 453092731u, 2181625025u, 4111451223u,
+        1706088902u, 314042704u, 2344532202u, 4240017532u, 1658658271u, 366619977u, 2362670323u, 4224994405u,
+        1303535960u, 984961486u, 2747007092u, 3569037538u, 1256170817u, 1037604311u, 2765210733u, 3554079995u,
+        1131014506u, 879679996u, 2909243462u, 3663771856u, 1141124467u, 855842277u, 2852801631u, 3708648649u,
+        1342533948u, 654459306u, 3188396048u, 3373015174u, 1466479909u, 544179635u, 3110523913u, 3462522015u,
+        1591671054u, 702138776u, 2966460450u, 3352799412u, 1504918807u, 783551873u, 3082640443u, 3233442989u,
+        3988292384u, 2596254646u, 62317068u, 1957810842u, 3939845945u, 2647816111u, 81470997u, 1943803523u,
+        3814918930u, 2489596804u, 225274430u, 2053790376u, 3826175755u, 2466906013u, 167816743u, 2097651377u,
+        4027552580u, 2265490386u, 503444072u, 1762050814u, 4150417245u, 2154129355u, 426522225u, 1852507879u,
+        4275313526u, 2312317920u, 282753626u, 1742555852u, 4189708143u, 2394877945u, 397917763u, 1622183637u,
+        3604390888u, 2714866558u, 953729732u, 1340076626u, 3518719985u, 2797360999u, 1068828381u, 1219638859u,
+        3624741850u, 2936675148u, 906185462u, 1090812512u, 3747672003u, 2825379669u, 829329135u, 1181335161u,
+        3412177804u, 3160834842u, 628085408u, 1382605366u, 3423369109u, 3138078467u, 570562233u, 1426400815u,
+        3317316542u, 2998733608u, 733239954u, 1555261956u, 3268935591u, 3050360625u, 752459403u, 1541320221u,
+        2607071920u, 3965973030u, 1969922972u, 40735498u, 2617837225u, 3943577151u, 1913087877u, 83908371u,
+        2512341634u, 3803740692u, 2075208622u, 213261112u, 2463272603u, 3855990285u, 2094854071u, 198958881u,
+        2262029012u, 4057260610u, 1759359992u, 534414190u, 2176718541u, 4139329115u, 1873836001u, 414664567u,
+        2282248934u, 4279200368u, 1711684554u, 285281116u, 2405801727u, 4167216745u, 1634467795u, 376229701u,
+        2685067896u, 3608007406u, 1308918612u, 956543938u, 2808555105u, 3495958263u, 1231636301u, 1047427035u,
+        2932959818u, 3654703836u, 1088359270u, 936918000u, 2847714899u, 3736837829u, 1202900863u, 817233897u,
+        3183342108u, 3401237130u, 1404277552u, 615818150u, 3134207493u, 3453421203u, 1423857449u, 601450431u,
+        3009837614u, 3294710456u, 1567103746u, 711928724u, 3020668471u, 3272380065u, 1510334235u, 755167117u
+    },
+    {
+        0u, 421212481u, 842424962u, 724390851u, 1684849924u, 2105013317u, 1448781702u, 1329698503u,
+        3369699848u, 3519200073u, 4210026634u, 3824474571u, 2897563404u, 3048111693u, 2659397006u, 2274893007u,
+        1254232657u, 1406739216u, 2029285587u, 1643069842u, 783210325u, 934667796u, 479770071u, 92505238u,
+        2182846553u, 2600511768u, 2955803355u, 2838940570u, 3866582365u, 4285295644u, 3561045983u, 3445231262u,
+        2508465314u, 2359236067u, 2813478432u, 3198777185u, 4058571174u, 3908292839u, 3286139684u, 3670389349u,
+        1566420650u, 1145479147u, 1869335592u, 1987116393u, 959540142u, 539646703u, 185010476u, 303839341u,
+        3745920755u, 3327985586u, 3983561841u, 4100678960u, 3140154359u, 2721170102u, 2300350837u, 2416418868u,
+        396344571u, 243568058u, 631889529u, 1018359608u, 1945336319u, 1793607870u, 1103436669u, 1490954812u,
+        4034481925u, 3915546180u, 3259968903u, 3679722694u, 2484439553u, 2366552896u, 2787371139u, 3208174018u,
+        950060301u, 565965900u, 177645455u, 328046286u, 1556873225u, 1171730760u, 1861902987u, 2011255754u,
+        3132841300u, 2745199637u, 2290958294u, 2442530455u, 3738671184u, 3352078609u, 3974232786u, 4126854035u,
+        1919080284u, 1803150877u, 1079293406u, 1498383519u, 370020952u, 253043481u, 607678682u, 1025720731u,
+        1711106983u, 2095471334u, 1472923941u, 1322268772u, 26324643u, 411738082u, 866634785u, 717028704u,
+        2904875439u, 3024081134u, 2668790573u, 2248782444u, 3376948395u, 3495106026u, 4219356713u, 3798300520u,
+        792689142u, 908347575u, 487136116u, 68299317u, 1263779058u, 1380486579u, 2036719216u, 1618931505u,
+        3890672638u, 4278043327u, 3587215740u, 3435896893u, 2206873338u, 2593195963u, 2981909624u, 2829542713u,
+        998479947u, 580430090u, 162921161u, 279890824u, 1609522511u, 1190423566u, 1842954189u, 1958874764u,
+        4082766403u, 3930137346u, 3245109441u, 3631694208u, 2536953671u, 2385372678u, 2768287173u, 3155920004u,
+        1900120602u, 1750776667u, 1131931800u, 1517083097u, 355290910u, 204897887u, 656092572u, 1040194781u,
+        3113746450u, 2692952403u, 2343461520u, 2461357009u, 3723805974u, 3304059991u, 4022511508u, 4141455061u,
+        2919742697u, 3072101800u, 2620513899u, 2234183466u, 3396041197u, 3547351212u, 4166851439u, 3779471918u,
+        1725839073u, 2143618976u, 1424512099u, 1307796770u, 45282277u, 464110244u, 813994343u, 698327078u,
+        3838160568u, 4259225593u, 3606301754u, 3488152955u, 2158586812u, 2578602749u, 2996767038u, 2877569151u,
+        740041904u, 889656817u, 506086962u, 120682355u, 1215357364u, 1366020341u, 2051441462u, 1667084919u,
+        3422213966u, 3538019855u, 4190942668u, 3772220557u, 2945847882u, 3062702859u, 2644537544u, 2226864521u,
+        52649286u, 439905287u, 823476164u, 672009861u, 1733269570u, 2119477507u, 1434057408u, 1281543041u,
+        2167981343u, 2552493150u, 3004082077u, 2853541596u, 3847487515u, 4233048410u, 3613549209u, 3464057816u,
+        1239502615u, 1358593622u, 2077699477u, 1657543892u, 764250643u, 882293586u, 532408465u, 111204816u,
+        1585378284u, 1197851309u, 1816695150u, 1968414767u, 974272232u, 587794345u, 136598634u, 289367339u,
+        2527558116u, 2411481253u, 2760973158u, 3179948583u, 4073438432u, 3956313505u, 3237863010u, 3655790371u,
+        347922877u, 229101820u, 646611775u, 1066513022u, 1892689081u, 1774917112u, 1122387515u, 1543337850u,
+        3697634229u, 3313392372u, 3998419255u, 4148705398u, 3087642289u, 2702352368u, 2319436851u, 2468674930u
+    },
+    {
+        0u, 29518391u, 59036782u, 38190681u, 118073564u, 114017003u, 76381362u, 89069189u,
+        236147128u, 265370511u, 228034006u, 206958561u, 152762724u, 148411219u, 178138378u, 190596925u,
+        472294256u, 501532999u, 530741022u, 509615401u, 456068012u, 451764635u, 413917122u, 426358261u,
+        305525448u, 334993663u, 296822438u, 275991697u, 356276756u, 352202787u, 381193850u, 393929805u,
+        944588512u, 965684439u, 1003065998u, 973863097u, 1061482044u, 1049003019u, 1019230802u, 1023561829u,
+        912136024u, 933002607u, 903529270u, 874031361u, 827834244u, 815125939u, 852716522u, 856752605u,
+        611050896u, 631869351u, 669987326u, 640506825u, 593644876u, 580921211u, 551983394u, 556069653u,
+        712553512u, 733666847u, 704405574u, 675154545u, 762387700u, 749958851u, 787859610u, 792175277u,
+        1889177024u, 1901651959u, 1931368878u, 1927033753u, 2006131996u, 1985040171u, 1947726194u, 1976933189u,
+        2122964088u, 2135668303u, 2098006038u, 2093965857u, 2038461604u, 2017599123u, 2047123658u, 2076625661u,
+        1824272048u, 1836991623u, 1866005214u, 1861914857u, 1807058540u, 1786244187u, 1748062722u, 1777547317u,
+        1655668488u, 1668093247u, 1630251878u, 1625932113u, 1705433044u, 1684323811u, 1713505210u, 1742760333u,
+        1222101792u, 1226154263u, 1263738702u, 1251046777u, 1339974652u, 1310460363u, 1281013650u, 1301863845u,
+        1187289752u, 1191637167u, 1161842422u, 1149379777u, 1103966788u, 1074747507u, 1112139306u, 1133218845u,
+        1425107024u, 1429406311u, 1467333694u, 1454888457u, 1408811148u, 1379576507u, 1350309090u, 1371438805u,
+        1524775400u, 1528845279u, 1499917702u, 1487177649u, 1575719220u, 1546255107u, 1584350554u, 1605185389u,
+        3778354048u, 3774312887u, 3803303918u, 3816007129u, 3862737756u, 3892238699u, 3854067506u, 3833203973u,
+        4012263992u, 4007927823u, 3970080342u, 3982554209u, 3895452388u, 3924658387u, 3953866378u, 3932773565u,
+        4245928176u, 4241609415u, 4271336606u, 4283762345u, 4196012076u, 4225268251u, 4187931714u, 4166823541u,
+        4076923208u, 4072833919u, 4035198246u, 4047918865u, 4094247316u, 4123732899u, 4153251322u, 4132437965u,
+        3648544096u, 3636082519u, 3673983246u, 3678331705u, 3732010428u, 3753090955u, 3723829714u, 3694611429u,
+        3614117080u, 3601426159u, 3572488374u, 3576541825u, 3496125444u, 3516976691u, 3555094634u, 3525581405u,
+        3311336976u, 3298595879u, 3336186494u, 3340255305u, 3260503756u, 3281337595u, 3251864226u, 3222399125u,
+        3410866088u, 3398419871u, 3368647622u, 3372945905u, 3427010420u, 3448139075u, 3485520666u, 3456284973u,
+        2444203584u, 2423127159u, 2452308526u, 2481530905u, 2527477404u, 2539934891u, 2502093554u, 2497740997u,
+        2679949304u, 2659102159u, 2620920726u, 2650438049u, 2562027300u, 2574714131u, 2603727690u, 2599670141u,
+        2374579504u, 2353749767u, 2383274334u, 2412743529u, 2323684844u, 2336421851u, 2298759554u, 2294686645u,
+        2207933576u, 2186809023u, 2149495014u, 2178734801u, 2224278612u, 2236720739u, 2266437690u, 2262135309u,
+        2850214048u, 2820717207u, 2858812622u, 2879680249u, 2934667388u, 2938704459u, 2909776914u, 2897069605u,
+        2817622296u, 2788420399u, 2759153014u, 2780249921u, 2700618180u, 2704950259u, 2742877610u, 2730399645u,
+        3049550800u, 3020298727u, 3057690558u, 3078802825u, 2999835404u, 3004150075u, 2974355298u, 2961925461u,
+        3151438440u, 3121956959u, 3092510214u, 3113327665u, 3168701108u, 3172786307u, 3210370778u, 3197646061u
+    },
+    {
+        0u, 3099354981u, 2852767883u, 313896942u, 2405603159u, 937357362u, 627793884u, 2648127673u,
+        3316918511u, 2097696650u, 1874714724u, 3607201537u, 1255587768u, 4067088605u, 3772741427u, 1482887254u,
+        1343838111u, 3903140090u, 4195393300u, 1118632049u, 3749429448u, 1741137837u, 1970407491u, 3452858150u,
+        2511175536u, 756094997u, 1067759611u, 2266550430u, 449832999u, 2725482306u, 2965774508u, 142231497u,
+        2687676222u, 412010587u, 171665333u, 2995192016u, 793786473u, 2548850444u, 2237264098u, 1038456711u,
+        1703315409u, 3711623348u, 3482275674u, 1999841343u, 3940814982u, 1381529571u, 1089329165u, 4166106984u,
+        4029413537u, 1217896388u, 1512189994u, 3802027855u, 2135519222u, 3354724499u, 3577784189u, 1845280792u,
+        899665998u, 2367928107u, 2677414085u, 657096608u, 3137160985u, 37822588u, 284462994u, 2823350519u,
+        2601801789u, 598228824u, 824021174u, 2309093331u, 343330666u, 2898962447u, 3195996129u, 113467524u,
+        1587572946u, 3860600759u, 4104763481u, 1276501820u, 3519211397u, 1769898208u, 2076913422u, 3279374443u,
+        3406630818u, 1941006535u, 1627703081u, 3652755532u, 1148164341u, 4241751952u, 3999682686u, 1457141531u,
+        247015245u, 3053797416u, 2763059142u, 470583459u, 2178658330u, 963106687u, 735213713u, 2473467892u,
+        992409347u, 2207944806u, 2435792776u, 697522413u, 3024379988u, 217581361u, 508405983u, 2800865210u,
+        4271038444u, 1177467017u, 1419450215u, 3962007554u, 1911572667u, 3377213406u, 3690561584u, 1665525589u,
+        1799331996u, 3548628985u, 3241568279u, 2039091058u, 3831314379u, 1558270126u, 1314193216u, 4142438437u,
+        2928380019u, 372764438u, 75645176u, 3158189981u, 568925988u, 2572515393u, 2346768303u, 861712586u,
+        3982079547u, 1441124702u, 1196457648u, 4293663189u, 1648042348u, 3666298377u, 3358779879u, 1888390786u,
+        686661332u, 2421291441u, 2196002399u, 978858298u, 2811169155u, 523464422u, 226935048u, 3040519789u,
+        3175145892u, 100435649u, 390670639u, 2952089162u, 841119475u, 2325614998u, 2553003640u, 546822429u,
+        2029308235u, 3225988654u, 3539796416u, 1782671013u, 4153826844u, 1328167289u, 1570739863u, 3844338162u,
+        1298864389u, 4124540512u, 3882013070u, 1608431339u, 3255406162u, 2058742071u, 1744848601u, 3501990332u,
+        2296328682u, 811816591u, 584513889u, 2590678532u, 129869501u, 3204563416u, 2914283062u, 352848211u,
+        494030490u, 2781751807u, 3078325777u, 264757620u, 2450577869u, 715964072u, 941166918u, 2158327331u,
+        3636881013u, 1618608400u, 1926213374u, 3396585883u, 1470427426u, 4011365959u, 4255988137u, 1158766284u,
+        1984818694u, 3471935843u, 3695453837u, 1693991400u, 4180638033u, 1100160564u, 1395044826u, 3952793279u,
+        3019491049u, 189112716u, 435162722u, 2706139399u, 1016811966u, 2217162459u, 2526189877u, 774831696u,
+        643086745u, 2666061564u, 2354934034u, 887166583u, 2838900430u, 294275499u, 54519365u, 3145957664u,
+        3823145334u, 1532818963u, 1240029693u, 4048895640u, 1820460577u, 3560857924u, 3331051178u, 2117577167u,
+        3598663992u, 1858283101u, 2088143283u, 3301633750u, 1495127663u, 3785470218u, 4078182116u, 1269332353u,
+        332098007u, 2876706482u, 3116540252u, 25085497u, 2628386432u, 605395429u, 916469259u, 2384220526u,
+        2254837415u, 1054503362u, 745528876u, 2496903497u, 151290352u, 2981684885u, 2735556987u, 464596510u,
+        1137851976u, 4218313005u, 3923506883u, 1365741990u, 3434129695u, 1946996346u, 1723425172u, 3724871409u
+    },
+    {
+        0u, 1029712304u, 2059424608u, 1201699536u, 4118849216u, 3370159984u, 2403399072u, 2988497936u,
+        812665793u, 219177585u, 1253054625u, 2010132753u, 3320900865u, 4170237105u, 3207642721u, 2186319825u,
+        1625331586u, 1568718386u, 438355170u, 658566482u, 2506109250u, 2818578674u, 4020265506u, 3535817618u,
+        1351670851u, 1844508147u, 709922595u, 389064339u, 2769320579u, 2557498163u, 3754961379u, 3803185235u,
+        3250663172u, 4238411444u, 3137436772u, 2254525908u, 876710340u, 153198708u, 1317132964u, 1944187668u,
+        4054934725u, 3436268917u, 2339452837u, 3054575125u, 70369797u, 961670069u, 2129760613u, 1133623509u,
+        2703341702u, 2621542710u, 3689016294u, 3867263574u, 1419845190u, 1774270454u, 778128678u, 318858390u,
+        2438067015u, 2888948471u, 3952189479u, 3606153623u, 1691440519u, 1504803895u, 504432359u, 594620247u,
+        1492342857u, 1704161785u, 573770537u, 525542041u, 2910060169u, 2417219385u, 3618876905u, 3939730521u,
+        1753420680u, 1440954936u, 306397416u, 790849880u, 2634265928u, 2690882808u, 3888375336u, 3668168600u,
+        940822475u, 91481723u, 1121164459u, 2142483739u, 3448989963u, 4042473659u, 3075684971u, 2318603227u,
+        140739594u, 889433530u, 1923340138u, 1338244826u, 4259521226u, 3229813626u, 2267247018u, 3124975642u,
+        2570221389u, 2756861693u, 3824297005u, 3734113693u, 1823658381u, 1372780605u, 376603373u, 722643805u,
+        2839690380u, 2485261628u, 3548540908u, 4007806556u, 1556257356u, 1638052860u, 637716780u, 459464860u,
+        4191346895u, 3300051327u, 2199040943u, 3195181599u, 206718479u, 825388991u, 1989285231u, 1274166495u,
+        3382881038u, 4106388158u, 3009607790u, 2382549470u, 1008864718u, 21111934u, 1189240494u, 2072147742u,
+        2984685714u, 2357631266u, 3408323570u, 4131834434u, 1147541074u, 2030452706u, 1051084082u, 63335554u,
+        2174155603u, 3170292451u, 4216760371u, 3325460867u, 1947622803u, 1232499747u, 248909555u, 867575619u,
+        3506841360u, 3966111392u, 2881909872u, 2527485376u, 612794832u, 434546784u, 1581699760u, 1663499008u,
+        3782634705u, 3692447073u, 2612412337u, 2799048193u, 351717905u, 697754529u, 1849071985u, 1398190273u,
+        1881644950u, 1296545318u, 182963446u, 931652934u, 2242328918u, 3100053734u, 4284967478u, 3255255942u,
+        1079497815u, 2100821479u, 983009079u, 133672583u, 3050795671u, 2293717799u, 3474399735u, 4067887175u,
+        281479188u, 765927844u, 1778867060u, 1466397380u, 3846680276u, 3626469220u, 2676489652u, 2733102084u,
+        548881365u, 500656741u, 1517752501u, 1729575173u, 3577210133u, 3898068133u, 2952246901u, 2459410373u,
+        3910527195u, 3564487019u, 2480257979u, 2931134987u, 479546907u, 569730987u, 1716854139u, 1530213579u,
+        3647316762u, 3825568426u, 2745561210u, 2663766474u, 753206746u, 293940330u, 1445287610u, 1799716618u,
+        2314567513u, 3029685993u, 4080348217u, 3461678473u, 2088098201u, 1091956777u, 112560889u, 1003856713u,
+        3112514712u, 2229607720u, 3276105720u, 4263857736u, 1275433560u, 1902492648u, 918929720u, 195422344u,
+        685033439u, 364179055u, 1377080511u, 1869921551u, 3713294623u, 3761522863u, 2811507327u, 2599689167u,
+        413436958u, 633644462u, 1650777982u, 1594160846u, 3978570462u, 3494118254u, 2548332990u, 2860797966u,
+        1211387997u, 1968470509u, 854852413u, 261368461u, 3182753437u, 2161434413u, 3346310653u, 4195650637u,
+        2017729436u, 1160000044u, 42223868u, 1071931724u, 2378480988u, 2963576044u, 4144295484u, 3395602316u
+    },
+    {
+        0u, 3411858341u, 1304994059u, 2257875630u, 2609988118u, 1355649459u, 3596215069u, 486879416u,
+        3964895853u, 655315400u, 2711298918u, 1791488195u, 2009251963u, 3164476382u, 973758832u, 4048990933u,
+        64357019u, 3364540734u, 1310630800u, 2235723829u, 2554806413u, 1394316072u, 3582976390u, 517157411u,
+        4018503926u, 618222419u, 2722963965u, 1762783832u, 1947517664u, 3209171269u, 970744811u, 4068520014u,
+        128714038u, 3438335635u, 1248109629u, 2167961496u, 2621261600u, 1466012805u, 3522553387u, 447296910u,
+        3959392091u, 547575038u, 2788632144u, 1835791861u, 1886307661u, 3140622056u, 1034314822u, 4143626211u,
+        75106221u, 3475428360u, 1236444838u, 2196665603u, 2682996155u, 1421317662u, 3525567664u, 427767573u,
+        3895035328u, 594892389u, 2782995659u, 1857943406u, 1941489622u, 3101955187u, 1047553757u, 4113347960u,
+        257428076u, 3288652233u, 1116777319u, 2311878850u, 2496219258u, 1603640287u, 3640781169u, 308099796u,
+        3809183745u, 676813732u, 2932025610u, 1704983215u, 2023410199u, 3016104370u, 894593820u, 4262377657u,
+        210634999u, 3352484690u, 1095150076u, 2316991065u, 2535410401u, 1547934020u, 3671583722u, 294336591u,
+        3772615322u, 729897279u, 2903845777u, 1716123700u, 2068629644u, 2953845545u, 914647431u, 4258839074u,
+        150212442u, 3282623743u, 1161604689u, 2388688372u, 2472889676u, 1480171241u, 3735940167u, 368132066u,
+        3836185911u, 805002898u, 2842635324u, 1647574937u, 2134298401u, 3026852996u, 855535146u, 4188192143u,
+        186781121u, 3229539940u, 1189784778u, 2377547631u, 2427670487u, 1542429810u, 3715886812u, 371670393u,
+        3882979244u, 741170185u, 2864262823u, 1642462466u, 2095107514u, 3082559007u, 824732849u, 4201955092u,
+        514856152u, 3589064573u, 1400419795u, 2552522358u, 2233554638u, 1316849003u, 3370776517u, 62202976u,
+        4075001525u, 968836368u, 3207280574u, 1954014235u, 1769133219u, 2720925446u, 616199592u, 4024870413u,
+        493229635u, 3594175974u, 1353627464u, 2616354029u, 2264355925u, 1303087088u, 3409966430u, 6498043u,
+        4046820398u, 979978123u, 3170710821u, 2007099008u, 1789187640u, 2717386141u, 661419827u, 3962610838u,
+        421269998u, 3527459403u, 1423225061u, 2676515648u, 2190300152u, 1238466653u, 3477467891u, 68755798u,
+        4115633027u, 1041448998u, 3095868040u, 1943789869u, 1860096405u, 2776760880u, 588673182u, 3897205563u,
+        449450869u, 3516317904u, 1459794558u, 2623431131u, 2170245475u, 1242006214u, 3432247400u, 131015629u,
+        4137259288u, 1036337853u, 3142660115u, 1879958454u, 1829294862u, 2790523051u, 549483013u, 3952910752u,
+        300424884u, 3669282065u, 1545650111u, 2541513754u, 2323209378u, 1092980487u, 3350330793u, 216870412u,
+        4256931033u, 921128828u, 2960342482u, 2066738807u, 1714085583u, 2910195050u, 736264132u, 3770592353u,
+        306060335u, 3647131530u, 1610005796u, 2494197377u, 2309971513u, 1123257756u, 3295149874u, 255536279u,
+        4268596802u, 892423655u, 3013951305u, 2029645036u, 1711070292u, 2929725425u, 674528607u, 3815288570u,
+        373562242u, 3709388839u, 1535949449u, 2429577516u, 2379569556u, 1183418929u, 3223189663u, 188820282u,
+        4195850735u, 827017802u, 3084859620u, 2089020225u, 1636228089u, 2866415708u, 743340786u, 3876759895u,
+        361896217u, 3738094268u, 1482340370u, 2466671543u, 2382584591u, 1163888810u, 3284924932u, 144124321u,
+        4190215028u, 849168593u, 3020503679u, 2136336858u, 1649465698u, 2836138695u, 798521449u, 3838094284u
+    },
+    {
+        0u, 2792819636u, 2543784233u, 837294749u, 4098827283u, 1379413927u, 1674589498u, 3316072078u,
+        871321191u, 2509784531u, 2758827854u, 34034938u, 3349178996u, 1641505216u, 1346337629u, 4131942633u,
+        1742642382u, 3249117050u, 4030828007u, 1446413907u, 2475800797u, 904311657u, 68069876u, 2725880384u,
+        1412551337u, 4064729373u, 3283010432u, 1708771380u, 2692675258u, 101317902u, 937551763u, 2442587175u,
+        3485284764u, 1774858792u, 1478633653u, 4266992385u, 1005723023u, 2642744891u, 2892827814u, 169477906u,
+        4233263099u, 1512406095u, 1808623314u, 3451546982u, 136139752u, 2926205020u, 2676114113u, 972376437u,
+        2825102674u, 236236518u, 1073525883u, 2576072655u, 1546420545u, 4200303349u, 3417542760u, 1841601500u,
+        2609703733u, 1039917185u, 202635804u, 2858742184u, 1875103526u, 3384067218u, 4166835727u, 1579931067u,
+        1141601657u, 3799809741u, 3549717584u, 1977839588u, 2957267306u, 372464350u, 668680259u, 2175552503u,
+        2011446046u, 3516084394u, 3766168119u, 1175200131u, 2209029901u, 635180217u, 338955812u, 2990736784u,
+        601221559u, 2242044419u, 3024812190u, 306049834u, 3617246628u, 1911408144u, 1074125965u, 3866285881u,
+        272279504u, 3058543716u, 2275784441u, 567459149u, 3832906691u, 1107462263u, 1944752874u, 3583875422u,
+        2343980261u, 767641425u, 472473036u, 3126744696u, 2147051766u, 3649987394u, 3899029983u, 1309766251u,
+        3092841090u, 506333494u, 801510315u, 2310084639u, 1276520081u, 3932237093u, 3683203000u, 2113813516u,
+        3966292011u, 1243601823u, 2079834370u, 3716205238u, 405271608u, 3192979340u, 2411259153u, 701492901u,
+        3750207052u, 2045810168u, 1209569125u, 4000285905u, 734575199u, 2378150379u, 3159862134u, 438345922u,
+        2283203314u, 778166598u, 529136603u, 3120492655u, 2086260449u, 3660498261u, 3955679176u, 1303499900u,
+        3153699989u, 495890209u, 744928700u, 2316418568u, 1337360518u, 3921775410u, 3626602927u, 2120129051u,
+        4022892092u, 1237286280u, 2018993941u, 3726666913u, 461853231u, 3186645403u, 2350400262u, 711936178u,
+        3693557851u, 2052076527u, 1270360434u, 3989775046u, 677911624u, 2384402428u, 3220639073u, 427820757u,
+        1202443118u, 3789347034u, 3493118535u, 1984154099u, 3018127229u, 362020041u, 612099668u, 2181885408u,
+        1950653705u, 3526596285u, 3822816288u, 1168934804u, 2148251930u, 645706414u, 395618355u, 2984485767u,
+        544559008u, 2248295444u, 3085590153u, 295523645u, 3560598451u, 1917673479u, 1134918298u, 3855773998u,
+        328860103u, 3052210803u, 2214924526u, 577903450u, 3889505748u, 1101147744u, 1883911421u, 3594338121u,
+        3424493451u, 1785369663u, 1535282850u, 4260726038u, 944946072u, 2653270060u, 2949491377u, 163225861u,
+        4294103532u, 1501944408u, 1752023237u, 3457862513u, 196998655u, 2915761739u, 2619532502u, 978710370u,
+        2881684293u, 229902577u, 1012666988u, 2586515928u, 1603020630u, 4193987810u, 3356702335u, 1852063179u,
+        2553040162u, 1046169238u, 263412747u, 2848217023u, 1818454321u, 3390333573u, 4227627032u, 1569420204u,
+        60859927u, 2782375331u, 2487203646u, 843627658u, 4159668740u, 1368951216u, 1617990445u, 3322386585u,
+        810543216u, 2520310724u, 2815490393u, 27783917u, 3288386659u, 1652017111u, 1402985802u, 4125677310u,
+        1685994201u, 3255382381u, 4091620336u, 1435902020u, 2419138250u, 910562686u, 128847843u, 2715354199u,
+        1469150398u, 4058414858u, 3222168983u, 1719234083u, 2749255853u, 94984985u, 876691844u, 2453031472u
+    },
+    {
+        0u, 3433693342u, 1109723005u, 2391738339u, 2219446010u, 1222643300u, 3329165703u, 180685081u,
+        3555007413u, 525277995u, 2445286600u, 1567235158u, 1471092047u, 2600801745u, 361370162u, 3642757804u,
+        2092642603u, 2953916853u, 1050555990u, 4063508168u, 4176560081u, 878395215u, 3134470316u, 1987983410u,
+        2942184094u, 1676945920u, 3984272867u, 567356797u, 722740324u, 3887998202u, 1764827929u, 2778407815u,
+        4185285206u, 903635656u, 3142804779u, 2012833205u, 2101111980u, 2979425330u, 1058630609u, 4088621903u,
+        714308067u, 3862526333u, 1756790430u, 2753330688u, 2933487385u, 1651734407u, 3975966820u, 542535930u,
+        2244825981u, 1231508451u, 3353891840u, 188896414u, 25648519u, 3442302233u, 1134713594u, 2399689316u,
+        1445480648u, 2592229462u, 336416693u, 3634843435u, 3529655858u, 516441772u, 2420588879u, 1559052753u,
+        698204909u, 3845636723u, 1807271312u, 2803025166u, 2916600855u, 1635634313u, 4025666410u, 593021940u,
+        4202223960u, 919787974u, 3093159461u, 1962401467u, 2117261218u, 2996361020u, 1008193759u, 4038971457u,
+        1428616134u, 2576151384u, 386135227u, 3685348389u, 3513580860u, 499580322u, 2471098945u, 1608776415u,
+        2260985971u, 1248454893u, 3303468814u, 139259792u, 42591881u, 3458459159u, 1085071860u, 2349261162u,
+        3505103035u, 474062885u, 2463016902u, 1583654744u, 1419882049u, 2550902495u, 377792828u, 3660491170u,
+        51297038u, 3483679632u, 1093385331u, 2374089965u, 2269427188u, 1273935210u, 3311514249u, 164344343u,
+        2890961296u, 1627033870u, 4000683757u, 585078387u, 672833386u, 3836780532u, 1782552599u, 2794821769u,
+        2142603813u, 3005188795u, 1032883544u, 4047146438u, 4227826911u, 928351297u, 3118105506u, 1970307900u,
+        1396409818u, 2677114180u, 287212199u, 3719594553u, 3614542624u, 467372990u, 2505346141u, 1509854403u,
+        2162073199u, 1282711281u, 3271268626u, 240228748u, 76845205u, 3359543307u, 1186043880u, 2317064054u,
+        796964081u, 3811226735u, 1839575948u, 2702160658u, 2882189835u, 1734392469u, 3924802934u, 625327592u,
+        4234522436u, 818917338u, 3191908409u, 1927981223u, 2016387518u, 3028656416u, 973776579u, 4137723485u,
+        2857232268u, 1726474002u, 3899187441u, 616751215u, 772270454u, 3803048424u, 1814228491u, 2693328533u,
+        2041117753u, 3036871847u, 999160644u, 4146592730u, 4259508931u, 826864221u, 3217552830u, 1936586016u,
+        3606501031u, 442291769u, 2496909786u, 1484378436u, 1388107869u, 2652297411u, 278519584u, 3694387134u,
+        85183762u, 3384397196u, 1194773103u, 2342308593u, 2170143720u, 1307820918u, 3279733909u, 265733131u,
+        2057717559u, 3054258089u, 948125770u, 4096344276u, 4276898253u, 843467091u, 3167309488u, 1885556270u,
+        2839764098u, 1709792284u, 3949353983u, 667704161u, 755585656u, 3785577190u, 1865176325u, 2743489947u,
+        102594076u, 3401021058u, 1144549729u, 2291298815u, 2186770662u, 1325234296u, 3228729243u, 215514885u,
+        3589828009u, 424832311u, 2547870420u, 1534552650u, 1370645331u, 2635621325u, 328688686u, 3745342640u,
+        2211456353u, 1333405183u, 3254067740u, 224338562u, 127544219u, 3408931589u, 1170156774u, 2299866232u,
+        1345666772u, 2627681866u, 303053225u, 3736746295u, 3565105198u, 416624816u, 2522494803u, 1525692365u,
+        4285207626u, 868291796u, 3176010551u, 1910772649u, 2065767088u, 3079346734u, 956571085u, 4121828691u,
+        747507711u, 3760459617u, 1856702594u, 2717976604u, 2831417605u, 1684930971u, 3940615800u, 642451174u
+    }
 };
 
+#ifdef LODEPNG_X86_SIMD
+/*
+Folds 64 bytes at a time into four 128-bit remainders with carry-less multiplication, then reduces them to the
+32-bit CRC, see "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction" by Intel. The constants
+are powers of x modulo the polynomial, bit reflected like the CRC. r is the CRC register before and after, length
+must be at least 64 and a multiple of 16.
+*/
+__attribute__((target("pclmul,sse4.1")))
+static unsigned crc32_pclmul(unsigned r, const unsigned char* data, size_t length)
+{
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596ll, 0x0154442bd4ll);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009ell, 0x01751997d0ll);
+    const __m128i k5 = _mm_set_epi64x(0, 0x0163cd6124ll);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641ll, 0x01db710641ll);
+    const __m128i low32 = _mm_setr_epi32(~0, 0, ~0, 0);
+    __m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+    x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)data), _mm_cvtsi32_si128((int)r));
+    x2 = _mm_loadu_si128((const __m128i*)(data + 16));
+    x3 = _mm_loadu_si128((const __m128i*)(data + 32));
+    x4 = _mm_loadu_si128((const __m128i*)(data + 48));
+    data += 64;
+    length -= 64;
+
+    /*fold the four remainders over the next 64 bytes*/
+    for (; length >= 64; data += 64, length -= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)data));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(data + 16)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(data + 32)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(data + 48)));
+    }
+
+    /*fold the four remainders into one, then the remaining 16 byte blocks into that*/
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x4), x5);
+    for (; length >= 16; data += 16, length -= 16)
+    {
+        x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i*)data)), x5);
+    }
+
+    /*fold 128 bits to 64 bits*/
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, low32);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, k5, 0x00), x2);
+
+    /*Barrett reduction to 32 bits*/
+    x2 = _mm_and_si128(x1, low32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+    x2 = _mm_and_si128(x2, low32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return (unsigned)_mm_extract_epi32(x1, 1);
+}
+#endif /*LODEPNG_X86_SIMD*/
+
 /*Return the CRC of the bytes buf[0..len-1].*/
 unsigned lodepng_crc32(const unsigned char* data, size_t length)
 {
-	unsigned r = 0xffffffffu;
-	size_t i;
-	for (i = 0; i < length; ++i)
-	{
-		r = lodepng_crc32_table[(r ^ data[i]) & 0xff] ^ (r >> 8);
-	}
-	return r ^ 0xffffffffu;
+    unsigned r = 0xffffffffu;
+#ifdef LODEPNG_X86_SIMD
+    if (length >= 64 && __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+    {
+        r = crc32_pclmul(r, data, length & ~(size_t)15);
+        data += length & ~(size_t)15;
+        length &= 15;
+    }
+#endif /*LODEPNG_X86_SIMD*/
+    /*slicing by 8: the CRC register is combined with 8 bytes at once*/
+    for (; length >= 8; data += 8, length -= 8)
+    {
+        r ^= data[0] | ((unsigned)data[1] << 8) | ((unsigned)data[2] << 16) | ((unsigned)data[3] << 24);
+        r = lodepng_crc32_table[7][r & 0xff] ^ lodepng_crc32_table[6][(r >> 8) & 0xff]
+            ^ lodepng_crc32_table[5][(r >> 16) & 0xff] ^ lodepng_crc32_table[4][r >> 24]
+            ^ lodepng_crc32_table[3][data[4]] ^ lodepng_crc32_table[2][data[5]]
+            ^ lodepng_crc32_table[1][data[6]] ^ lodepng_crc32_table[0][data[7]];
+    }
+    for (; length > 0; ++data, --length)
+    {
+        r = lodepng_crc32_table[0][(r ^ *data) & 0xff] ^ (r >> 8);
+    }
+    return r ^ 0xffffffffu;
 }
 #else /* !LODEPNG_NO_COMPILE_CRC */
 unsigned lodepng_crc32(const unsigned char* data, size_t length);
@@ -2378,41 +3657,41 @@ unsigned lodepng_crc32(const unsigned char* data, size_t length);
 
 static unsigned char readBitFromReversedStream(size_t* bitpointer, const unsigned char* bitstream)
 {
-	unsigned char result = (unsigned char)((bitstream[(*bitpointer) >> 3] >> (7 - ((*bitpointer) & 0x7))) & 1);
-	++(*bitpointer);
-	return result;
+    unsigned char result = (unsigned char)((bitstream[(*bitpointer) >> 3] >> (7 - ((*bitpointer) & 0x7))) & 1);
+    ++(*bitpointer);
+    return result;
 }
 
 static unsigned readBitsFromReversedStream(size_t* bitpointer, const unsigned char* bitstream, size_t nbits)
 {
-	unsigned result = 0;
-	size_t i;
-	for (i = nbits - 1; i < nbits; --i)
-	{
-		result += (unsigned)readBitFromReversedStream(bitpointer, bitstream) << i;
-	}
-	return result;
+    unsigned result = 0;
+    size_t i;
+    for (i = nbits - 1; i < nbits; --i)
+    {
+        result += (unsigned)readBitFromReversedStream(bitpointer, bitstream) << i;
+    }
+    return result;
 }
 
 #ifdef LODEPNG_COMPILE_DECODER
 static void setBitOfReversedStream0(size_t* bitpointer, unsigned char* bitstream, unsigned char bit)
 {
-	/*the current bit in bitstream must be 0 for this to work*/
-	if (bit)
-	{
-		/*earlier bit of huffman code is in a lesser significant bit of an earlier byte*/
-		bitstream[(*bitpointer) >> 3] |= (bit << (7 - ((*bitpointer) & 0x7)));
-	}
-	++(*bitpointer);
+    /*the current bit in bitstream must be 0 for this to work*/
+    if (bit)
+    {
+        /*earlier bit of huffman code is in a lesser significant bit of an earlier byte*/
+        bitstream[(*bitpointer) >> 3] |= (bit << (7 - ((*bitpointer) & 0x7)));
+    }
+    ++(*bitpointer);
 }
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 static void setBitOfReversedStream(size_t* bitpointer, unsigned char* bitstream, unsigned char bit)
 {
-	/*the current bit in bitstream may be 0 or 1 for this to work*/
-	if (bit == 0) bitstream[(*bitpointer) >> 3] &= (unsigned char)(~(1 << (7 - ((*bitpointer) & 0x7))));
-	else         bitstream[(*bitpointer) >> 3] |= (1 << (7 - ((*bitpointer) & 0x7)));
-	++(*bitpointer);
+    /*the current bit in bitstream may be 0 or 1 for this to work*/
+    if (bit == 0) bitstream[(*bitpointer) >> 3] &= (unsigned char)(~(1 << (7 - ((*bitpointer) & 0x7))));
+    else         bitstream[(*bitpointer) >> 3] |= (1 << (7 - ((*bitpointer) & 0x7)));
+    ++(*bitpointer);
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
@@ -2421,124 +3700,124 @@ static void setBitOfReversedStream(size_t* bitpointer, unsigned char* bitstream,
 
 unsigned lodepng_chunk_length(const unsigned char* chunk)
 {
-	return lodepng_read32bitInt(&chunk[0]);
+    return lodepng_read32bitInt(&chunk[0]);
 }
 
 void lodepng_chunk_type(char type[5], const unsigned char* chunk)
 {
-	unsigned i;
-	for (i = 0; i != 4; ++i) type[i] = (char)chunk[4 + i];
-	type[4] = 0; /*null termination char*/
+    unsigned i;
+    for (i = 0; i != 4; ++i) type[i] = (char)chunk[4 + i];
+    type[4] = 0; /*null termination char*/
 }
 
 unsigned char lodepng_chunk_type_equals(const unsigned char* chunk, const char* type)
 {
-	if (strlen(type) != 4) return 0;
-	return (chunk[4] == type[0] && chunk[5] == type[1] && chunk[6] == type[2] && chunk[7] == type[3]);
+    if (strlen(type) != 4) return 0;
+    return (chunk[4] == type[0] && chunk[5] == type[1] && chunk[6] == type[2] && chunk[7] == type[3]);
 }
 
 unsigned char lodepng_chunk_ancillary(const unsigned char* chunk)
 {
-	return((chunk[4] & 32) != 0);
+    return((chunk[4] & 32) != 0);
 }
 
 unsigned char lodepng_chunk_private(const unsigned char* chunk)
 {
-	return((chunk[6] & 32) != 0);
+    return((chunk[6] & 32) != 0);
 }
 
 unsigned char lodepng_chunk_safetocopy(const unsigned char* chunk)
 {
-	return((chunk[7] & 32) != 0);
+    return((chunk[7] & 32) != 0);
 }
 
 unsigned char* lodepng_chunk_data(unsigned char* chunk)
 {
-	return &chunk[8];
+    return &chunk[8];
 }
 
 const unsigned char* lodepng_chunk_data_const(const unsigned char* chunk)
 {
-	return &chunk[8];
+    return &chunk[8];
 }
 
 unsigned lodepng_chunk_check_crc(const unsigned char* chunk)
 {
-	unsigned length = lodepng_chunk_length(chunk);
-	unsigned CRC = lodepng_read32bitInt(&chunk[length + 8]);
-	/*the CRC is taken of the data and the 4 chunk type letters, not the length*/
-	unsigned checksum = lodepng_crc32(&chunk[4], length + 4);
-	if (CRC != checksum) return 1;
-	else return 0;
+    unsigned length = lodepng_chunk_length(chunk);
+    unsigned CRC = lodepng_read32bitInt(&chunk[length + 8]);
+    /*the CRC is taken of the data and the 4 chunk type letters, not the length*/
+    unsigned checksum = lodepng_crc32(&chunk[4], length + 4);
+    if (CRC != checksum) return 1;
+    else return 0;
 }
 
 void lodepng_chunk_generate_crc(unsigned char* chunk)
 {
-	unsigned length = lodepng_chunk_length(chunk);
-	unsigned CRC = lodepng_crc32(&chunk[4], length + 4);
-	lodepng_set32bitInt(chunk + 8 + length, CRC);
+    unsigned length = lodepng_chunk_length(chunk);
+    unsigned CRC = lodepng_crc32(&chunk[4], length + 4);
+    lodepng_set32bitInt(chunk + 8 + length, CRC);
 }
 
 unsigned char* lodepng_chunk_next(unsigned char* chunk)
 {
-	unsigned total_chunk_length = lodepng_chunk_length(chunk) + 12;
-	return &chunk[total_chunk_length];
+    unsigned total_chunk_length = lodepng_chunk_length(chunk) + 12;
+    return &chunk[total_chunk_length];
 }
 
 const unsigned char* lodepng_chunk_next_const(const unsigned char* chunk)
 {
-	unsigned total_chunk_length = lodepng_chunk_length(chunk) + 12;
-	return &chunk[total_chunk_length];
+    unsigned total_chunk_length = lodepng_chunk_length(chunk) + 12;
+    return &chunk[total_chunk_length];
 }
 
 unsigned lodepng_chunk_append(unsigned char** out, size_t* outlength, const unsigned char* chunk)
 {
-	unsigned i;
-	unsigned total_chunk_length = lodepng_chunk_length(chunk) + 12;
-	unsigned char *chunk_start, *new_buffer;
-	size_t new_length = (*outlength) + total_chunk_length;
-	if (new_length < total_chunk_length || new_length < (*outlength)) return 77; /*integer overflow happened*/
+    unsigned i;
+    unsigned total_chunk_length = lodepng_chunk_length(chunk) + 12;
+    unsigned char *chunk_start, *new_buffer;
+    size_t new_length = (*outlength) + total_chunk_length;
+    if (new_length < total_chunk_length || new_length < (*outlength)) return 77; /*integer overflow happened*/
 
-	new_buffer = (unsigned char*)lodepng_realloc(*out, new_length);
-	if (!new_buffer) return 83; /*alloc fail*/
-	(*out) = new_buffer;
-	(*outlength) = new_length;
-	chunk_start = &(*out)[new_length - total_chunk_length];
+    new_buffer = (unsigned char*)lodepng_realloc(*out, new_length);
+    if (!new_buffer) return 83; /*alloc fail*/
+    (*out) = new_buffer;
+    (*outlength) = new_length;
+    chunk_start = &(*out)[new_length - total_chunk_length];
 
-	for (i = 0; i != total_chunk_length; ++i) chunk_start[i] = chunk[i];
+    for (i = 0; i != total_chunk_length; ++i) chunk_start[i] = chunk[i];
 
-	return 0;
+    return 0;
 }
 
 unsigned lodepng_chunk_create(unsigned char** out, size_t* outlength, unsigned length,
-	const char* type, const unsigned char* data)
+    const char* type, const unsigned char* data)
 {
-	unsigned i;
-	unsigned char *chunk, *new_buffer;
-	size_t new_length = (*outlength) + length + 12;
-	if (new_length < length + 12 || new_length < (*outlength)) return 77; /*integer overflow happened*/
-	new_buffer = (unsigned char*)lodepng_realloc(*out, new_length);
-	if (!new_buffer) return 83; /*alloc fail*/
-	(*out) = new_buffer;
-	(*outlength) = new_length;
-	chunk = &(*out)[(*outlength) - length - 12];
+    unsigned i;
+    unsigned char *chunk, *new_buffer;
+    size_t new_length = (*outlength) + length + 12;
+    if (new_length < length + 12 || new_length < (*outlength)) return 77; /*integer overflow happened*/
+    new_buffer = (unsigned char*)lodepng_realloc(*out, new_length);
+    if (!new_buffer) return 83; /*alloc fail*/
+    (*out) = new_buffer;
+    (*outlength) = new_length;
+    chunk = &(*out)[(*outlength) - length - 12];
 
-	/*1: length*/
-	lodepng_set32bitInt(chunk, (unsigned)length);
+    /*1: length*/
+    lodepng_set32bitInt(chunk, (unsigned)length);
 
-	/*2: chunk name (4 letters)*/
-	chunk[4] = (unsigned char)type[0];
-	chunk[5] = (unsigned char)type[1];
-	chunk[6] = (unsigned char)type[2];
-	chunk[7] = (unsigned char)type[3];
+    /*2: chunk name (4 letters)*/
+    chunk[4] = (unsigned char)type[0];
+    chunk[5] = (unsigned char)type[1];
+    chunk[6] = (unsigned char)type[2];
+    chunk[7] = (unsigned char)type[3];
 
-	/*3: the data*/
-	for (i = 0; i != length; ++i) chunk[8 + i] = data[i];
+    /*3: the data*/
+    for (i = 0; i != length; ++i) chunk[8 + i] = data[i];
 
-	/*4: CRC (of the chunkname characters and the data)*/
-	lodepng_chunk_generate_crc(chunk);
+    /*4: CRC (of the chunkname characters and the data)*/
+    lodepng_chunk_generate_crc(chunk);
 
-	return 0;
+    return 0;
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
@@ -2548,178 +3827,178 @@ unsigned lodepng_chunk_create(unsigned char** out, size_t* outlength, unsigned l
 /*return type is a LodePNG error code*/
 static unsigned checkColorValidity(LodePNGColorType colortype, unsigned bd) /*bd = bitdepth*/
 {
-	switch (colortype)
-	{
-	case 0: if (!(bd == 1 || bd == 2 || bd == 4 || bd == 8 || bd == 16)) return 37; break; /*grey*/
-	case 2: if (!(bd == 8 || bd == 16)) return 37; break; /*RGB*/
-	case 3: if (!(bd == 1 || bd == 2 || bd == 4 || bd == 8)) return 37; break; /*palette*/
-	case 4: if (!(bd == 8 || bd == 16)) return 37; break; /*grey + alpha*/
-	case 6: if (!(bd == 8 || bd == 16)) return 37; break; /*RGBA*/
-	default: return 31;
-	}
-	return 0; /*allowed color type / bits combination*/
+    switch (colortype)
+    {
+    case 0: if (!(bd == 1 || bd == 2 || bd == 4 || bd == 8 || bd == 16)) return 37; break; /*grey*/
+    case 2: if (!(bd == 8 || bd == 16)) return 37; break; /*RGB*/
+    case 3: if (!(bd == 1 || bd == 2 || bd == 4 || bd == 8)) return 37; break; /*palette*/
+    case 4: if (!(bd == 8 || bd == 16)) return 37; break; /*grey + alpha*/
+    case 6: if (!(bd == 8 || bd == 16)) return 37; break; /*RGBA*/
+    default: return 31;
+    }
+    return 0; /*allowed color type / bits combination*/
 }
 
 static unsigned getNumColorChannels(LodePNGColorType colortype)
 {
-	switch (colortype)
-	{
-	case 0: return 1; /*grey*/
-	case 2: return 3; /*RGB*/
-	case 3: return 1; /*palette*/
-	case 4: return 2; /*grey + alpha*/
-	case 6: return 4; /*RGBA*/
-	}
-	return 0; /*unexisting color type*/
+    switch (colortype)
+    {
+    case 0: return 1; /*grey*/
+    case 2: return 3; /*RGB*/
+    case 3: return 1; /*palette*/
+    case 4: return 2; /*grey + alpha*/
+    case 6: return 4; /*RGBA*/
+    }
+    return 0; /*unexisting color type*/
 }
 
 static unsigned lodepng_get_bpp_lct(LodePNGColorType colortype, unsigned bitdepth)
 {
-	/*bits per pixel is amount of channels * bits per channel*/
-	return getNumColorChannels(colortype) * bitdepth;
+    /*bits per pixel is amount of channels * bits per channel*/
+    return getNumColorChannels(colortype) * bitdepth;
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
 
 void lodepng_color_mode_init(LodePNGColorMode* info)
 {
-	info->key_defined = 0;
-	info->key_r = info->key_g = info->key_b = 0;
-	info->colortype = LCT_RGBA;
-	info->bitdepth = 8;
-	info->palette = 0;
-	info->palettesize = 0;
+    info->key_defined = 0;
+    info->key_r = info->key_g = info->key_b = 0;
+    info->colortype = LCT_RGBA;
+    info->bitdepth = 8;
+    info->palette = 0;
+    info->palettesize = 0;
 }
 
 void lodepng_color_mode_cleanup(LodePNGColorMode* info)
 {
-	lodepng_palette_clear(info);
+    lodepng_palette_clear(info);
 }
 
 unsigned lodepng_color_mode_copy(LodePNGColorMode* dest, const LodePNGColorMode* source)
 {
-	size_t i;
-	lodepng_color_mode_cleanup(dest);
-	*dest = *source;
-	if (source->palette)
-	{
-		dest->palette = (unsigned char*)lodepng_malloc(1024);
-		if (!dest->palette && source->palettesize) return 83; /*alloc fail*/
-		for (i = 0; i != source->palettesize * 4; ++i) dest->palette[i] = source->palette[i];
-	}
-	return 0;
+    size_t i;
+    lodepng_color_mode_cleanup(dest);
+    *dest = *source;
+    if (source->palette)
+    {
+        dest->palette = (unsigned char*)lodepng_malloc(1024);
+        if (!dest->palette && source->palettesize) return 83; /*alloc fail*/
+        for (i = 0; i != source->palettesize * 4; ++i) dest->palette[i] = source->palette[i];
+    }
+    return 0;
 }
 
 static int lodepng_color_mode_equal(const LodePNGColorMode* a, const LodePNGColorMode* b)
 {
-	size_t i;
-	if (a->colortype != b->colortype) return 0;
-	if (a->bitdepth != b->bitdepth) return 0;
-	if (a->key_defined != b->key_defined) return 0;
-	if (a->key_defined)
-	{
-		if (a->key_r != b->key_r) return 0;
-		if (a->key_g != b->key_g) return 0;
-		if (a->key_b != b->key_b) return 0;
-	}
-	/*if one of the palette sizes is 0, then we consider it to be the same as the
-	other: it means that e.g. the palette was not given by the user and should be
-	considered the same as the palette inside the PNG.*/
-	if (1/*a->palettesize != 0 && b->palettesize != 0*/) {
-		if (a->palettesize != b->palettesize) return 0;
-		for (i = 0; i != a->palettesize * 4; ++i)
-		{
-			if (a->palette[i] != b->palette[i]) return 0;
-		}
-	}
-	return 1;
+    size_t i;
+    if (a->colortype != b->colortype) return 0;
+    if (a->bitdepth != b->bitdepth) return 0;
+    if (a->key_defined != b->key_defined) return 0;
+    if (a->key_defined)
+    {
+        if (a->key_r != b->key_r) return 0;
+        if (a->key_g != b->key_g) return 0;
+        if (a->key_b != b->key_b) return 0;
+    }
+    /*if one of the palette sizes is 0, then we consider it to be the same as the
+    other: it means that e.g. the palette was not given by the user and should be
+    considered the same as the palette inside the PNG.*/
+    if (1/*a->palettesize != 0 && b->palettesize != 0*/) {
+        if (a->palettesize != b->palettesize) return 0;
+        for (i = 0; i != a->palettesize * 4; ++i)
+        {
+            if (a->palette[i] != b->palette[i]) return 0;
+        }
+    }
+    return 1;
 }
 
 void lodepng_palette_clear(LodePNGColorMode* info)
 {
-	if (info->palette) lodepng_free(info->palette);
-	info->palette = 0;
-	info->palettesize = 0;
+    if (info->palette) lodepng_free(info->palette);
+    info->palette = 0;
+    info->palettesize = 0;
 }
 
 unsigned lodepng_palette_add(LodePNGColorMode* info,
-	unsigned char r, unsigned char g, unsigned char b, unsigned char a)
-{
-	unsigned char* data;
-	/*the same resize technique as C++ std::vectors is used, and here it's made so that for a palette with
-	the max of 256 colors, it'll have the exact alloc size*/
-	if (!info->palette) /*allocate palette if empty*/
-	{
-		/*room for 256 colors with 4 bytes each*/
-		data = (unsigned char*)lodepng_realloc(info->palette, 1024);
-		if (!data) return 83; /*alloc fail*/
-		else info->palette = data;
-	}
-	info->palette[4 * info->palettesize + 0] = r;
-	info->palette[4 * info->palettesize + 1] = g;
-	info->palette[4 * info->palettesize + 2] = b;
-	info->palette[4 * info->palettesize + 3] = a;
-	++info->palettesize;
-	return 0;
+    unsigned char r, unsigned char g, unsigned char b, unsigned char a)
+{
+    unsigned char* data;
+    /*the same resize technique as C++ std::vectors is used, and here it's made so that for a palette with
+    the max of 256 colors, it'll have the exact alloc size*/
+    if (!info->palette) /*allocate palette if empty*/
+    {
+        /*room for 256 colors with 4 bytes each*/
+        data = (unsigned char*)lodepng_realloc(info->palette, 1024);
+        if (!data) return 83; /*alloc fail*/
+        else info->palette = data;
+    }
+    info->palette[4 * info->palettesize + 0] = r;
+    info->palette[4 * info->palettesize + 1] = g;
+    info->palette[4 * info->palettesize + 2] = b;
+    info->palette[4 * info->palettesize + 3] = a;
+    ++info->palettesize;
+    return 0;
 }
 
 unsigned lodepng_get_bpp(const LodePNGColorMode* info)
 {
-	/*calculate bits per pixel out of colortype and bitdepth*/
-	return lodepng_get_bpp_lct(info->colortype, info->bitdepth);
+    /*calculate bits per pixel out of colortype and bitdepth*/
+    return lodepng_get_bpp_lct(info->colortype, info->bitdepth);
 }
 
 unsigned lodepng_get_channels(const LodePNGColorMode* info)
 {
-	return getNumColorChannels(info->colortype);
+    return getNumColorChannels(info->colortype);
 }
 
 unsigned lodepng_is_greyscale_type(const LodePNGColorMode* info)
 {
-	return info->colortype == LCT_GREY || info->colortype == LCT_GREY_ALPHA;
+    return info->colortype == LCT_GREY || info->colortype == LCT_GREY_ALPHA;
 }
 
 unsigned lodepng_is_alpha_type(const LodePNGColorMode* info)
 {
-	return (info->colortype & 4) != 0; /*4 or 6*/
+    return (info->colortype & 4) != 0; /*4 or 6*/
 }
 
 unsigned lodepng_is_palette_type(const LodePNGColorMode* info)
 {
-	return info->colortype == LCT_PALETTE;
+    return info->colortype == LCT_PALETTE;
 }
 
 unsigned lodepng_has_palette_alpha(const LodePNGColorMode* info)
 {
-	size_t i;
-	for (i = 0; i != info->palettesize; ++i)
-	{
-		if (info->palette[i * 4 + 3] < 255) return 1;
-	}
-	return 0;
+    size_t i;
+    for (i = 0; i != info->palettesize; ++i)
+    {
+        if (info->palette[i * 4 + 3] < 255) return 1;
+    }
+    return 0;
 }
 
 unsigned lodepng_can_have_alpha(const LodePNGColorMode* info)
 {
-	return info->key_defined
-		|| lodepng_is_alpha_type(info)
-		|| lodepng_has_palette_alpha(info);
+    return info->key_defined
+        || lodepng_is_alpha_type(info)
+        || lodepng_has_palette_alpha(info);
 }
 
 size_t lodepng_get_raw_size(unsigned w, unsigned h, const LodePNGColorMode* color)
 {
-	/*will not overflow for any color type if roughly w * h < 268435455*/
-	size_t bpp = lodepng_get_bpp(color);
-	size_t n = w * h;
-	return ((n / 8) * bpp) + ((n & 7) * bpp + 7) / 8;
+    /*will not overflow for any color type if roughly w * h < 268435455*/
+    size_t bpp = lodepng_get_bpp(color);
+    size_t n = w * h;
+    return ((n / 8) * bpp) + ((n & 7) * bpp + 7) / 8;
 }
 
 size_t lodepng_get_raw_size_lct(unsigned w, unsigned h, LodePNGColorType colortype, unsigned bitdepth)
 {
-	/*will not overflow for any color type if roughly w * h < 268435455*/
-	size_t bpp = lodepng_get_bpp_lct(colortype, bitdepth);
-	size_t n = w * h;
-	return ((n / 8) * bpp) + ((n & 7) * bpp + 7) / 8;
+    /*will not overflow for any color type if roughly w * h < 268435455*/
+    size_t bpp = lodepng_get_bpp_lct(colortype, bitdepth);
+    size_t n = w * h;
+    return ((n / 8) * bpp) + ((n & 7) * bpp + 7) / 8;
 }
 
 
@@ -2728,10 +4007,10 @@ size_t lodepng_get_raw_size_lct(unsigned w, unsigned h, LodePNGColorType colorty
 /*in an idat chunk, each scanline is a multiple of 8 bits, unlike the lodepng output buffer*/
 static size_t lodepng_get_raw_size_idat(unsigned w, unsigned h, const LodePNGColorMode* color)
 {
-	/*will not overflow for any color type if roughly w * h < 268435455*/
-	size_t bpp = lodepng_get_bpp(color);
-	size_t line = ((w / 8) * bpp) + ((w & 7) * bpp + 7) / 8;
-	return h * line;
+    /*will not overflow for any color type if roughly w * h < 268435455*/
+    size_t bpp = lodepng_get_bpp(color);
+    size_t line = ((w / 8) * bpp) + ((w & 7) * bpp + 7) / 8;
+    return h * line;
 }
 #endif /*LODEPNG_COMPILE_DECODER*/
 #endif /*LODEPNG_COMPILE_PNG*/
@@ -2740,240 +4019,240 @@ static size_t lodepng_get_raw_size_idat(unsigned w, unsigned h, const LodePNGCol
 
 static void LodePNGUnknownChunks_init(LodePNGInfo* info)
 {
-	unsigned i;
-	for (i = 0; i != 3; ++i) info->unknown_chunks_data[i] = 0;
-	for (i = 0; i != 3; ++i) info->unknown_chunks_size[i] = 0;
+    unsigned i;
+    for (i = 0; i != 3; ++i) info->unknown_chunks_data[i] = 0;
+    for (i = 0; i != 3; ++i) info->unknown_chunks_size[i] = 0;
 }
 
 static void LodePNGUnknownChunks_cleanup(LodePNGInfo* info)
 {
-	unsigned i;
-	for (i = 0; i != 3; ++i) lodepng_free(info->unknown_chunks_data[i]);
+    unsigned i;
+    for (i = 0; i != 3; ++i) lodepng_free(info->unknown_chunks_data[i]);
 }
 
 static unsigned LodePNGUnknownChunks_copy(LodePNGInfo* dest, const LodePNGInfo* src)
 {
-	unsigned i;
+    unsigned i;
 
-	LodePNGUnknownChunks_cleanup(dest);
+    LodePNGUnknownChunks_cleanup(dest);
 
-	for (i = 0; i != 3; ++i)
-	{
-		size_t j;
-		dest->unknown_chunks_size[i] = src->unknown_chunks_size[i];
-		dest->unknown_chunks_data[i] = (unsigned char*)lodepng_malloc(src->unknown_chunks_size[i]);
-		if (!dest->unknown_chunks_data[i] && dest->unknown_chunks_size[i]) return 83; /*alloc fail*/
-		for (j = 0; j < src->unknown_chunks_size[i]; ++j)
-		{
-			dest->unknown_chunks_data[i][j] = src->unknown_chunks_data[i][j];
-		}
-	}
+    for (i = 0; i != 3; ++i)
+    {
+        size_t j;
+        dest->unknown_chunks_size[i] = src->unknown_chunks_size[i];
+        dest->unknown_chunks_data[i] = (unsigned char*)lodepng_malloc(src->unknown_chunks_size[i]);
+        if (!dest->unknown_chunks_data[i] && dest->unknown_chunks_size[i]) return 83; /*alloc fail*/
+        for (j = 0; j < src->unknown_chunks_size[i]; ++j)
+        {
+            dest->unknown_chunks_data[i][j] = src->unknown_chunks_data[i][j];
+        }
+    }
 
-	return 0;
+    return 0;
 }
 
 /******************************************************************************/
 
 static void LodePNGText_init(LodePNGInfo* info)
 {
-	info->text_num = 0;
-	info->text_keys = NULL;
-	info->text_strings = NULL;
+    info->text_num = 0;
+    info->text_keys = NULL;
+    info->text_strings = NULL;
 }
 
 static void LodePNGText_cleanup(LodePNGInfo* info)
 {
-	size_t i;
-	for (i = 0; i != info->text_num; ++i)
-	{
-		string_cleanup(&info->text_keys[i]);
-		string_cleanup(&info->text_strings[i]);
-	}
-	lodepng_free(info->text_keys);
-	lodepng_free(info->text_strings);
+    size_t i;
+    for (i = 0; i != info->text_num; ++i)
+    {
+        string_cleanup(&info->text_keys[i]);
+        string_cleanup(&info->text_strings[i]);
+    }
+    lodepng_free(info->text_keys);
+    lodepng_free(info->text_strings);
 }
 
 static unsigned LodePNGText_copy(LodePNGInfo* dest, const LodePNGInfo* source)
 {
-	size_t i = 0;
-	dest->text_keys = 0;
-	dest->text_strings = 0;
-	dest->text_num = 0;
-	for (i = 0; i != source->text_num; ++i)
-	{
-		CERROR_TRY_RETURN(lodepng_add_text(dest, source->text_keys[i], source->text_strings[i]));
-	}
-	return 0;
+    size_t i = 0;
+    dest->text_keys = 0;
+    dest->text_strings = 0;
+    dest->text_num = 0;
+    for (i = 0; i != source->text_num; ++i)
+    {
+        CERROR_TRY_RETURN(lodepng_add_text(dest, source->text_keys[i], source->text_strings[i]));
+    }
+    return 0;
 }
 
 void lodepng_clear_text(LodePNGInfo* info)
 {
-	LodePNGText_cleanup(info);
+    LodePNGText_cleanup(info);
 }
 
 unsigned lodepng_add_text(LodePNGInfo* info, const char* key, const char* str)
 {
-	char** new_keys = (char**)(lodepng_realloc(info->text_keys, sizeof(char*) * (info->text_num + 1)));
-	char** new_strings = (char**)(lodepng_realloc(info->text_strings, sizeof(char*) * (info->text_num + 1)));
-	if (!new_keys || !new_strings)
-	{
-		lodepng_free(new_keys);
-		lodepng_free(new_strings);
-		return 83; /*alloc fail*/
-	}
+    char** new_keys = (char**)(lodepng_realloc(info->text_keys, sizeof(char*) * (info->text_num + 1)));
+    char** new_strings = (char**)(lodepng_realloc(info->text_strings, sizeof(char*) * (info->text_num + 1)));
+    if (!new_keys || !new_strings)
+    {
+        lodepng_free(new_keys);
+        lodepng_free(new_strings);
+        return 83; /*alloc fail*/
+    }
 
-	++info->text_num;
-	info->text_keys = new_keys;
-	info->text_strings = new_strings;
+    ++info->text_num;
+    info->text_keys = new_keys;
+    info->text_strings = new_strings;
 
-	string_init(&info->text_keys[info->text_num - 1]);
-	string_set(&info->text_keys[info->text_num - 1], key);
+    string_init(&info->text_keys[info->text_num - 1]);
+    string_set(&info->text_keys[info->text_num - 1], key);
 
-	string_init(&info->text_strings[info->text_num - 1]);
-	string_set(&info->text_strings[info->text_num - 1], str);
+    string_init(&info->text_strings[info->text_num - 1]);
+    string_set(&info->text_strings[info->text_num - 1], str);
 
-	return 0;
+    return 0;
 }
 
 /******************************************************************************/
 
 static void LodePNGIText_init(LodePNGInfo* info)
 {
-	info->itext_num = 0;
-	info->itext_keys = NULL;
-	info->itext_langtags = NULL;
-	info->itext_transkeys = NULL;
-	info->itext_strings = NULL;
+    info->itext_num = 0;
+    info->itext_keys = NULL;
+    info->itext_langtags = NULL;
+    info->itext_transkeys = NULL;
+    info->itext_strings = NULL;
 }
 
 static void LodePNGIText_cleanup(LodePNGInfo* info)
 {
-	size_t i;
-	for (i = 0; i != info->itext_num; ++i)
-	{
-		string_cleanup(&info->itext_keys[i]);
-		string_cleanup(&info->itext_langtags[i]);
-		string_cleanup(&info->itext_transkeys[i]);
-		string_cleanup(&info->itext_strings[i]);
-	}
-	lodepng_free(info->itext_keys);
-	lodepng_free(info->itext_langtags);
-	lodepng_free(info->itext_transkeys);
-	lodepng_free(info->itext_strings);
+    size_t i;
+    for (i = 0; i != info->itext_num; ++i)
+    {
+        string_cleanup(&info->itext_keys[i]);
+        string_cleanup(&info->itext_langtags[i]);
+        string_cleanup(&info->itext_transkeys[i]);
+        string_cleanup(&info->itext_strings[i]);
+    }
+    lodepng_free(info->itext_keys);
+    lodepng_free(info->itext_langtags);
+    lodepng_free(info->itext_transkeys);
+    lodepng_free(info->itext_strings);
 }
 
 static unsigned LodePNGIText_copy(LodePNGInfo* dest, const LodePNGInfo* source)
 {
-	size_t i = 0;
-	dest->itext_keys = 0;
-	dest->itext_langtags = 0;
-	dest->itext_transkeys = 0;
-	dest->itext_strings = 0;
-	dest->itext_num = 0;
-	for (i = 0; i != source->itext_num; ++i)
-	{
-		CERROR_TRY_RETURN(lodepng_add_itext(dest, source->itext_keys[i], source->itext_langtags[i],
-			source->itext_transkeys[i], source->itext_strings[i]));
-	}
-	return 0;
+    size_t i = 0;
+    dest->itext_keys = 0;
+    dest->itext_langtags = 0;
+    dest->itext_transkeys = 0;
+    dest->itext_strings = 0;
+    dest->itext_num = 0;
+    for (i = 0; i != source->itext_num; ++i)
+    {
+        CERROR_TRY_RETURN(lodepng_add_itext(dest, source->itext_keys[i], source->itext_langtags[i],
+            source->itext_transkeys[i], source->itext_strings[i]));
+    }
+    return 0;
 }
 
 void lodepng_clear_itext(LodePNGInfo* info)
 {
-	LodePNGIText_cleanup(info);
+    LodePNGIText_cleanup(info);
 }
 
 unsigned lodepng_add_itext(LodePNGInfo* info, const char* key, const char* langtag,
-	const char* transkey, const char* str)
+    const char* transkey, const char* str)
 {
-	char** new_keys = (char**)(lodepng_realloc(info->itext_keys, sizeof(char*) * (info->itext_num + 1)));
-	char** new_langtags = (char**)(lodepng_realloc(info->itext_langtags, sizeof(char*) * (info->itext_num + 1)));
-	char** new_transkeys = (char**)(lodepng_realloc(info->itext_transkeys, sizeof(char*) * (info->itext_num + 1)));
-	char** new_strings = (char**)(lodepng_realloc(info->itext_strings, sizeof(char*) * (info->itext_num + 1)));
-	if (!new_keys || !new_langtags || !new_transkeys || !new_strings)
-	{
-		lodepng_free(new_keys);
-		lodepng_free(new_langtags);
-		lodepng_free(new_transkeys);
-		lodepng_free(new_strings);
-		return 83; /*alloc fail*/
-	}
+    char** new_keys = (char**)(lodepng_realloc(info->itext_keys, sizeof(char*) * (info->itext_num + 1)));
+    char** new_langtags = (char**)(lodepng_realloc(info->itext_langtags, sizeof(char*) * (info->itext_num + 1)));
+    char** new_transkeys = (char**)(lodepng_realloc(info->itext_transkeys, sizeof(char*) * (info->itext_num + 1)));
+    char** new_strings = (char**)(lodepng_realloc(info->itext_strings, sizeof(char*) * (info->itext_num + 1)));
+    if (!new_keys || !new_langtags || !new_transkeys || !new_strings)
+    {
+        lodepng_free(new_keys);
+        lodepng_free(new_langtags);
+        lodepng_free(new_transkeys);
+        lodepng_free(new_strings);
+        return 83; /*alloc fail*/
+    }
 
-	++info->itext_num;
-	info->itext_keys = new_keys;
-	info->itext_langtags = new_langtags;
-	info->itext_transkeys = new_transkeys;
-	info->itext_strings = new_strings;
+    ++info->itext_num;
+    info->itext_keys = new_keys;
+    info->itext_langtags = new_langtags;
+    info->itext_transkeys = new_transkeys;
+    info->itext_strings = new_strings;
 
-	string_init(&info->itext_keys[info->itext_num - 1]);
-	string_set(&info->itext_keys[info->itext_num - 1], key);
+    string_init(&info->itext_keys[info->itext_num - 1]);
+    string_set(&info->itext_keys[info->itext_num - 1], key);
 
-	string_init(&info->itext_langtags[info->itext_num - 1]);
-	string_set(&info->itext_langtags[info->itext_num - 1], langtag);
+    string_init(&info->itext_langtags[info->itext_num - 1]);
+    string_set(&info->itext_langtags[info->itext_num - 1], langtag);
 
-	string_init(&info->itext_transkeys[info->itext_num - 1]);
-	string_set(&info->itext_transkeys[info->itext_num - 1], transkey);
+    string_init(&info->itext_transkeys[info->itext_num - 1]);
+    string_set(&info->itext_transkeys[info->itext_num - 1], transkey);
 
-	string_init(&info->itext_strings[info->itext_num - 1]);
-	string_set(&info->itext_strings[info->itext_num - 1], str);
+    string_init(&info->itext_strings[info->itext_num - 1]);
+    string_set(&info->itext_strings[info->itext_num - 1], str);
 
-	return 0;
+    return 0;
 }
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
 void lodepng_info_init(LodePNGInfo* info)
 {
-	lodepng_color_mode_init(&info->color);
-	info->interlace_method = 0;
-	info->compression_method = 0;
-	info->filter_method = 0;
+    lodepng_color_mode_init(&info->color);
+    info->interlace_method = 0;
+    info->compression_method = 0;
+    info->filter_method = 0;
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-	info->background_defined = 0;
-	info->background_r = info->background_g = info->background_b = 0;
+    info->background_defined = 0;
+    info->background_r = info->background_g = info->background_b = 0;
 
-	LodePNGText_init(info);
-	LodePNGIText_init(info);
+    LodePNGText_init(info);
+    LodePNGIText_init(info);
 
-	info->time_defined = 0;
-	info->phys_defined = 0;
+    info->time_defined = 0;
+    info->phys_defined = 0;
 
-	LodePNGUnknownChunks_init(info);
+    LodePNGUnknownChunks_init(info);
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 }
 
 void lodepng_info_cleanup(LodePNGInfo* info)
 {
-	lodepng_color_mode_cleanup(&info->color);
+    lodepng_color_mode_cleanup(&info->color);
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-	LodePNGText_cleanup(info);
-	LodePNGIText_cleanup(info);
+    LodePNGText_cleanup(info);
+    LodePNGIText_cleanup(info);
 
-	LodePNGUnknownChunks_cleanup(info);
+    LodePNGUnknownChunks_cleanup(info);
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 }
 
 unsigned lodepng_info_copy(LodePNGInfo* dest, const LodePNGInfo* source)
 {
-	lodepng_info_cleanup(dest);
-	*dest = *source;
-	lodepng_color_mode_init(&dest->color);
-	CERROR_TRY_RETURN(lodepng_color_mode_copy(&dest->color, &source->color));
+    lodepng_info_cleanup(dest);
+    *dest = *source;
+    lodepng_color_mode_init(&dest->color);
+    CERROR_TRY_RETURN(lodepng_color_mode_copy(&dest->color, &source->color));
 
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-	CERROR_TRY_RETURN(LodePNGText_copy(dest, source));
-	CERROR_TRY_RETURN(LodePNGIText_copy(dest, source));
+    CERROR_TRY_RETURN(LodePNGText_copy(dest, source));
+    CERROR_TRY_RETURN(LodePNGIText_copy(dest, source));
 
-	LodePNGUnknownChunks_init(dest);
-	CERROR_TRY_RETURN(LodePNGUnknownChunks_copy(dest, source));
+    LodePNGUnknownChunks_init(dest);
+    CERROR_TRY_RETURN(LodePNGUnknownChunks_copy(dest, source));
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-	return 0;
+    return 0;
 }
 
 void lodepng_info_swap(LodePNGInfo* a, LodePNGInfo* b)
 {
-	LodePNGInfo temp = *a;
-	*a = *b;
-	*b = temp;
+    LodePNGInfo temp = *a;
+    *a = *b;
+    *b = temp;
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
@@ -2981,13 +4260,13 @@ void lodepng_info_swap(LodePNGInfo* a, LodePNGInfo* b)
 /*index: bitgroup index, bits: bitgroup size(1, 2 or 4), in: bitgroup value, out: octet array to add bits to*/
 static void addColorBits(unsigned char* out, size_t index, unsigned bits, unsigned in)
 {
-	unsigned m = bits == 1 ? 7 : bits == 2 ? 3 : 1; /*8 / bits - 1*/
-	/*p = the partial index in the byte, e.g. with 4 palettebits it is 0 for first half or 1 for second half*/
-	unsigned p = index & m;
-	in &= (1u << bits) - 1u; /*filter out any other bits of the input value*/
-	in = in << (bits * (m - p));
-	if (p == 0) out[index * bits / 8] = in;
-	else out[index * bits / 8] |= in;
+    unsigned m = bits == 1 ? 7 : bits == 2 ? 3 : 1; /*8 / bits - 1*/
+    /*p = the partial index in the byte, e.g. with 4 palettebits it is 0 for first half or 1 for second half*/
+    unsigned p = index & m;
+    in &= (1u << bits) - 1u; /*filter out any other bits of the input value*/
+    in = in << (bits * (m - p));
+    if (p == 0) out[index * bits / 8] = in;
+    else out[index * bits / 8] |= in;
 }
 
 typedef struct ColorTree ColorTree;
@@ -3000,288 +4279,288 @@ node has 16 instead of 8 children.
 */
 struct ColorTree
 {
-	ColorTree* children[16]; /*up to 16 pointers to ColorTree of next level*/
-	int index; /*the payload. Only has a meaningful value if this is in the last level*/
+    ColorTree* children[16]; /*up to 16 pointers to ColorTree of next level*/
+    int index; /*the payload. Only has a meaningful value if this is in the last level*/
 };
 
 static void color_tree_init(ColorTree* tree)
 {
-	int i;
-	for (i = 0; i != 16; ++i) tree->children[i] = 0;
-	tree->index = -1;
+    int i;
+    for (i = 0; i != 16; ++i) tree->children[i] = 0;
+    tree->index = -1;
 }
 
 static void color_tree_cleanup(ColorTree* tree)
 {
-	int i;
-	for (i = 0; i != 16; ++i)
-	{
-		if (tree->children[i])
-		{
-			color_tree_cleanup(tree->children[i]);
-			lodepng_free(tree->children[i]);
-		}
-	}
+    int i;
+    for (i = 0; i != 16; ++i)
+    {
+        if (tree->children[i])
+        {
+            color_tree_cleanup(tree->children[i]);
+            lodepng_free(tree->children[i]);
+        }
+    }
 }
 
 /*returns -1 if color not present, its index otherwise*/
 static int color_tree_get(ColorTree* tree, unsigned char r, unsigned char g, unsigned char b, unsigned char a)
 {
-	int bit = 0;
-	for (bit = 0; bit < 8; ++bit)
-	{
-		int i = 8 * ((r >> bit) & 1) + 4 * ((g >> bit) & 1) + 2 * ((b >> bit) & 1) + 1 * ((a >> bit) & 1);
-		if (!tree->children[i]) return -1;
-		else tree = tree->children[i];
-	}
-	return tree ? tree->index : -1;
+    int bit = 0;
+    for (bit = 0; bit < 8; ++bit)
+    {
+        int i = 8 * ((r >> bit) & 1) + 4 * ((g >> bit) & 1) + 2 * ((b >> bit) & 1) + 1 * ((a >> bit) & 1);
+        if (!tree->children[i]) return -1;
+        else tree = tree->children[i];
+    }
+    return tree ? tree->index : -1;
 }
 
 #ifdef LODEPNG_COMPILE_ENCODER
 static int color_tree_has(ColorTree* tree, unsigned char r, unsigned char g, unsigned char b, unsigned char a)
 {
-	return color_tree_get(tree, r, g, b, a) >= 0;
+    return color_tree_get(tree, r, g, b, a) >= 0;
 }
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
 /*color is not allowed to already exist.
 Index should be >= 0 (it's signed to be compatible with using -1 for "doesn't exist")*/
 static void color_tree_add(ColorTree* tree,
-	unsigned char r, unsigned char g, unsigned char b, unsigned char a, unsigned index)
-{
-	int bit;
-	for (bit = 0; bit < 8; ++bit)
-	{
-		int i = 8 * ((r >> bit) & 1) + 4 * ((g >> bit) & 1) + 2 * ((b >> bit) & 1) + 1 * ((a >> bit) & 1);
-		if (!tree->children[i])
-		{
-			tree->children[i] = (ColorTree*)lodepng_malloc(sizeof(ColorTree));
-			color_tree_init(tree->children[i]);
-		}
-		tree = tree->children[i];
-	}
-	tree->index = (int)index;
+    unsigned char r, unsigned char g, unsigned char b, unsigned char a, unsigned index)
+{
+    int bit;
+    for (bit = 0; bit < 8; ++bit)
+    {
+        int i = 8 * ((r >> bit) & 1) + 4 * ((g >> bit) & 1) + 2 * ((b >> bit) & 1) + 1 * ((a >> bit) & 1);
+        if (!tree->children[i])
+        {
+            tree->children[i] = (ColorTree*)lodepng_malloc(sizeof(ColorTree));
+            color_tree_init(tree->children[i]);
+        }
+        tree = tree->children[i];
+    }
+    tree->index = (int)index;
 }
 
 /*put a pixel, given its RGBA color, into image of any color type*/
 static unsigned rgba8ToPixel(unsigned char* out, size_t i,
-	const LodePNGColorMode* mode, ColorTree* tree /*for palette*/,
-	unsigned char r, unsigned char g, unsigned char b, unsigned char a)
-{
-	if (mode->colortype == LCT_GREY)
-	{
-		unsigned char grey = r; /*((unsigned short)r + g + b) / 3*/;
-		if (mode->bitdepth == 8) out[i] = grey;
-		else if (mode->bitdepth == 16) out[i * 2 + 0] = out[i * 2 + 1] = grey;
-		else
-		{
-			/*take the most significant bits of grey*/
-			grey = (grey >> (8 - mode->bitdepth)) & ((1 << mode->bitdepth) - 1);
-			addColorBits(out, i, mode->bitdepth, grey);
-		}
-	}
-	else if (mode->colortype == LCT_RGB)
-	{
-		if (mode->bitdepth == 8)
-		{
-			out[i * 3 + 0] = r;
-			out[i * 3 + 1] = g;
-			out[i * 3 + 2] = b;
-		}
-		else
-		{
-			out[i * 6 + 0] = out[i * 6 + 1] = r;
-			out[i * 6 + 2] = out[i * 6 + 3] = g;
-			out[i * 6 + 4] = out[i * 6 + 5] = b;
-		}
-	}
-	else if (mode->colortype == LCT_PALETTE)
-	{
-		int index = color_tree_get(tree, r, g, b, a);
-		if (index < 0) return 82; /*color not in palette*/
-		if (mode->bitdepth == 8) out[i] = index;
-		else addColorBits(out, i, mode->bitdepth, (unsigned)index);
-	}
-	else if (mode->colortype == LCT_GREY_ALPHA)
-	{
-		unsigned char grey = r; /*((unsigned short)r + g + b) / 3*/;
-		if (mode->bitdepth == 8)
-		{
-			out[i * 2 + 0] = grey;
-			out[i * 2 + 1] = a;
-		}
-		else if (mode->bitdepth == 16)
-		{
-			out[i * 4 + 0] = out[i * 4 + 1] = grey;
-			out[i * 4 + 2] = out[i * 4 + 3] = a;
-		}
-	}
-	else if (mode->colortype == LCT_RGBA)
-	{
-		if (mode->bitdepth == 8)
-		{
-			out[i * 4 + 0] = r;
-			out[i * 4 + 1] = g;
-			out[i * 4 + 2] = b;
-			out[i * 4 + 3] = a;
-		}
-		else
-		{
-			out[i * 8 + 0] = out[i * 8 + 1] = r;
-			out[i * 8 + 2] = out[i * 8 + 3] = g;
-			out[i * 8 + 4] = out[i * 8 + 5] = b;
-			out[i * 8 + 6] = out[i * 8 + 7] = a;
-		}
-	}
-
-	return 0; /*no error*/
+    const LodePNGColorMode* mode, ColorTree* tree /*for palette*/,
+    unsigned char r, unsigned char g, unsigned char b, unsigned char a)
+{
+    if (mode->colortype == LCT_GREY)
+    {
+        unsigned char grey = r; /*((unsigned short)r + g + b) / 3*/;
+        if (mode->bitdepth == 8) out[i] = grey;
+        else if (mode->bitdepth == 16) out[i * 2 + 0] = out[i * 2 + 1] = grey;
+        else
+        {
+            /*take the most significant bits of grey*/
+            grey = (grey >> (8 - mode->bitdepth)) & ((1 << mode->bitdepth) - 1);
+            addColorBits(out, i, mode->bitdepth, grey);
+        }
+    }
+    else if (mode->colortype == LCT_RGB)
+    {
+        if (mode->bitdepth == 8)
+        {
+            out[i * 3 + 0] = r;
+            out[i * 3 + 1] = g;
+            out[i * 3 + 2] = b;
+        }
+        else
+        {
+            out[i * 6 + 0] = out[i * 6 + 1] = r;
+            out[i * 6 + 2] = out[i * 6 + 3] = g;
+            out[i * 6 + 4] = out[i * 6 + 5] = b;
+        }
+    }
+    else if (mode->colortype == LCT_PALETTE)
+    {
+        int index = color_tree_get(tree, r, g, b, a);
+        if (index < 0) return 82; /*color not in palette*/
+        if (mode->bitdepth == 8) out[i] = index;
+        else addColorBits(out, i, mode->bitdepth, (unsigned)index);
+    }
+    else if (mode->colortype == LCT_GREY_ALPHA)
+    {
+        unsigned char grey = r; /*((unsigned short)r + g + b) / 3*/;
+        if (mode->bitdepth == 8)
+        {
+            out[i * 2 + 0] = grey;
+            out[i * 2 + 1] = a;
+        }
+        else if (mode->bitdepth == 16)
+        {
+            out[i * 4 + 0] = out[i * 4 + 1] = grey;
+            out[i * 4 + 2] = out[i * 4 + 3] = a;
+        }
+    }
+    else if (mode->colortype == LCT_RGBA)
+    {
+        if (mode->bitdepth == 8)
+        {
+            out[i * 4 + 0] = r;
+            out[i * 4 + 1] = g;
+            out[i * 4 + 2] = b;
+            out[i * 4 + 3] = a;
+        }
+        else
+        {
+            out[i * 8 + 0] = out[i * 8 + 1] = r;
+            out[i * 8 + 2] = out[i * 8 + 3] = g;
+            out[i * 8 + 4] = out[i * 8 + 5] = b;
+            out[i * 8 + 6] = out[i * 8 + 7] = a;
+        }
+    }
+
+    return 0; /*no error*/
 }
 
 /*put a pixel, given its RGBA16 color, into image of any color 16-bitdepth type*/
 static void rgba16ToPixel(unsigned char* out, size_t i,
-	const LodePNGColorMode* mode,
-	unsigned short r, unsigned short g, unsigned short b, unsigned short a)
-{
-	if (mode->colortype == LCT_GREY)
-	{
-		unsigned short grey = r; /*((unsigned)r + g + b) / 3*/;
-		out[i * 2 + 0] = (grey >> 8) & 255;
-		out[i * 2 + 1] = grey & 255;
-	}
-	else if (mode->colortype == LCT_RGB)
-	{
-		out[i * 6 + 0] = (r >> 8) & 255;
-		out[i * 6 + 1] = r & 255;
-		out[i * 6 + 2] = (g >> 8) & 255;
-		out[i * 6 + 3] = g & 255;
-		out[i * 6 + 4] = (b >> 8) & 255;
-		out[i * 6 + 5] = b & 255;
-	}
-	else if (mode->colortype == LCT_GREY_ALPHA)
-	{
-		unsigned short grey = r; /*((unsigned)r + g + b) / 3*/;
-		out[i * 4 + 0] = (grey >> 8) & 255;
-		out[i * 4 + 1] = grey & 255;
-		out[i * 4 + 2] = (a >> 8) & 255;
-		out[i * 4 + 3] = a & 255;
-	}
-	else if (mode->colortype == LCT_RGBA)
-	{
-		out[i * 8 + 0] = (r >> 8) & 255;
-		out[i * 8 + 1] = r & 255;
-		out[i * 8 + 2] = (g >> 8) & 255;
-		out[i * 8 + 3] = g & 255;
-		out[i * 8 + 4] = (b >> 8) & 255;
-		out[i * 8 + 5] = b & 255;
-		out[i * 8 + 6] = (a >> 8) & 255;
-		out[i * 8 + 7] = a & 255;
-	}
+    const LodePNGColorMode* mode,
+    unsigned short r, unsigned short g, unsigned short b, unsigned short a)
+{
+    if (mode->colortype == LCT_GREY)
+    {
+        unsigned short grey = r; /*((unsigned)r + g + b) / 3*/;
+        out[i * 2 + 0] = (grey >> 8) & 255;
+        out[i * 2 + 1] = grey & 255;
+    }
+    else if (mode->colortype == LCT_RGB)
+    {
+        out[i * 6 + 0] = (r >> 8) & 255;
+        out[i * 6 + 1] = r & 255;
+        out[i * 6 + 2] = (g >> 8) & 255;
+        out[i * 6 + 3] = g & 255;
+        out[i * 6 + 4] = (b >> 8) & 255;
+        out[i * 6 + 5] = b & 255;
+    }
+    else if (mode->colortype == LCT_GREY_ALPHA)
+    {
+        unsigned short grey = r; /*((unsigned)r + g + b) / 3*/;
+        out[i * 4 + 0] = (grey >> 8) & 255;
+        out[i * 4 + 1] = grey & 255;
+        out[i * 4 + 2] = (a >> 8) & 255;
+        out[i * 4 + 3] = a & 255;
+    }
+    else if (mode->colortype == LCT_RGBA)
+    {
+        out[i * 8 + 0] = (r >> 8) & 255;
+        out[i * 8 + 1] = r & 255;
+        out[i * 8 + 2] = (g >> 8) & 255;
+        out[i * 8 + 3] = g & 255;
+        out[i * 8 + 4] = (b >> 8) & 255;
+        out[i * 8 + 5] = b & 255;
+        out[i * 8 + 6] = (a >> 8) & 255;
+        out[i * 8 + 7] = a & 255;
+    }
 }
 
 /*Get RGBA8 color of pixel with index i (y * width + x) from the raw image with given color type.*/
 static void getPixelColorRGBA8(unsigned char* r, unsigned char* g,
-	unsigned char* b, unsigned char* a,
-	const unsigned char* in, size_t i,
-	const LodePNGColorMode* mode)
-{
-	if (mode->colortype == LCT_GREY)
-	{
-		if (mode->bitdepth == 8)
-		{
-			*r = *g = *b = in[i];
-			if (mode->key_defined && *r == mode->key_r) *a = 0;
-			else *a = 255;
-		}
-		else if (mode->bitdepth == 16)
-		{
-			*r = *g = *b = in[i * 2 + 0];
-			if (mode->key_defined && 256U * in[i * 2 + 0] + in[i * 2 + 1] == mode->key_r) *a = 0;
-			else *a = 255;
-		}
-		else
-		{
-			unsigned highest = ((1U << mode->bitdepth) - 1U); /*highest possible value for this bit depth*/
-			size_t j = i * mode->bitdepth;
-			unsigned value = readBitsFromReversedStream(&j, in, mode->bitdepth);
-			*r = *g = *b = (value * 255) / highest;
-			if (mode->key_defined && value == mode->key_r) *a = 0;
-			else *a = 255;
-		}
-	}
-	else if (mode->colortype == LCT_RGB)
-	{
-		if (mode->bitdepth == 8)
-		{
-			*r = in[i * 3 + 0]; *g = in[i * 3 + 1]; *b = in[i * 3 + 2];
-			if (mode->key_defined && *r == mode->key_r && *g == mode->key_g && *b == mode->key_b) *a = 0;
-			else *a = 255;
-		}
-		else
-		{
-			*r = in[i * 6 + 0];
-			*g = in[i * 6 + 2];
-			*b = in[i * 6 + 4];
-			if (mode->key_defined && 256U * in[i * 6 + 0] + in[i * 6 + 1] == mode->key_r
-				&& 256U * in[i * 6 + 2] + in[i * 6 + 3] == mode->key_g
-				&& 256U * in[i * 6 + 4] + in[i * 6 + 5] == mode->key_b) *a = 0;
-			else *a = 255;
-		}
-	}
-	else if (mode->colortype == LCT_PALETTE)
-	{
-		unsigned index;
-		if (mode->bitdepth == 8) index = in[i];
-		else
-		{
-			size_t j = i * mode->bitdepth;
-			index = readBitsFromReversedStream(&j, in, mode->bitdepth);
-		}
-
-		if (index >= mode->palettesize)
-		{
-			/*This is an error according to the PNG spec, but common PNG decoders make it black instead.
-			Done here too, slightly faster due to no error handling needed.*/
-			*r = *g = *b = 0;
-			*a = 255;
-		}
-		else
-		{
-			*r = mode->palette[index * 4 + 0];
-			*g = mode->palette[index * 4 + 1];
-			*b = mode->palette[index * 4 + 2];
-			*a = mode->palette[index * 4 + 3];
-		}
-	}
-	else if (mode->colortype == LCT_GREY_ALPHA)
-	{
-		if (mode->bitdepth == 8)
-		{
-			*r = *g = *b = in[i * 2 + 0];
-			*a = in[i * 2 + 1];
-		}
-		else
-		{
-			*r = *g = *b = in[i * 4 + 0];
-			*a = in[i * 4 + 2];
-		}
-	}
-	else if (mode->colortype == LCT_RGBA)
-	{
-		if (mode->bitdepth == 8)
-		{
-			*r = in[i * 4 + 0];
-			*g = in[i * 4 + 1];
-			*b = in[i * 4 + 2];
-			*a = in[i * 4 + 3];
-		}
-		else
-		{
-			*r = in[i * 8 + 0];
-			*g = in[i * 8 + 2];
-			*b = in[i * 8 + 4];
-			*a = in[i * 8 + 6];
-		}
-	}
+    unsigned char* b, unsigned char* a,
+    const unsigned char* in, size_t i,
+    const LodePNGColorMode* mode)
+{
+    if (mode->colortype == LCT_GREY)
+    {
+        if (mode->bitdepth == 8)
+        {
+            *r = *g = *b = in[i];
+            if (mode->key_defined && *r == mode->key_r) *a = 0;
+            else *a = 255;
+        }
+        else if (mode->bitdepth == 16)
+        {
+            *r = *g = *b = in[i * 2 + 0];
+            if (mode->key_defined && 256U * in[i * 2 + 0] + in[i * 2 + 1] == mode->key_r) *a = 0;
+            else *a = 255;
+        }
+        else
+        {
+            unsigned highest = ((1U << mode->bitdepth) - 1U); /*highest possible value for this bit depth*/
+            size_t j = i * mode->bitdepth;
+            unsigned value = readBitsFromReversedStream(&j, in, mode->bitdepth);
+            *r = *g = *b = (value * 255) / highest;
+            if (mode->key_defined && value == mode->key_r) *a = 0;
+            else *a = 255;
+        }
+    }
+    else if (mode->colortype == LCT_RGB)
+    {
+        if (mode->bitdepth == 8)
+        {
+            *r = in[i * 3 + 0]; *g = in[i * 3 + 1]; *b = in[i * 3 + 2];
+            if (mode->key_defined && *r == mode->key_r && *g == mode->key_g && *b == mode->key_b) *a = 0;
+            else *a = 255;
+        }
+        else
+        {
+            *r = in[i * 6 + 0];
+            *g = in[i * 6 + 2];
+            *b = in[i * 6 + 4];
+            if (mode->key_defined && 256U * in[i * 6 + 0] + in[i * 6 + 1] == mode->key_r
+                && 256U * in[i * 6 + 2] + in[i * 6 + 3] == mode->key_g
+                && 256U * in[i * 6 + 4] + in[i * 6 + 5] == mode->key_b) *a = 0;
+            else *a = 255;
+        }
+    }
+    else if (mode->colortype == LCT_PALETTE)
+    {
+        unsigned index;
+        if (mode->bitdepth == 8) index = in[i];
+        else
+        {
+            size_t j = i * mode->bitdepth;
+            index = readBitsFromReversedStream(&j, in, mode->bitdepth);
+        }
+
+        if (index >= mode->palettesize)
+        {
+            /*This is an error according to the PNG spec, but common PNG decoders make it black instead.
+            Done here too, slightly faster due to no error handling needed.*/
+            *r = *g = *b = 0;
+            *a = 255;
+        }
+        else
+        {
+            *r = mode->palette[index * 4 + 0];
+            *g = mode->palette[index * 4 + 1];
+            *b = mode->palette[index * 4 + 2];
+            *a = mode->palette[index * 4 + 3];
+        }
+    }
+    else if (mode->colortype == LCT_GREY_ALPHA)
+    {
+        if (mode->bitdepth == 8)
+        {
+            *r = *g = *b = in[i * 2 + 0];
+            *a = in[i * 2 + 1];
+        }
+        else
+        {
+            *r = *g = *b = in[i * 4 + 0];
+            *a = in[i * 4 + 2];
+        }
+    }
+    else if (mode->colortype == LCT_RGBA)
+    {
+        if (mode->bitdepth == 8)
+        {
+            *r = in[i * 4 + 0];
+            *g = in[i * 4 + 1];
+            *b = in[i * 4 + 2];
+            *a = in[i * 4 + 3];
+        }
+        else
+        {
+            *r = in[i * 8 + 0];
+            *g = in[i * 8 + 2];
+            *b = in[i * 8 + 4];
+            *a = in[i * 8 + 6];
+        }
+    }
 }
 
 /*Similar to getPixelColorRGBA8, but with all the for loops inside of the color
@@ -3290,255 +4569,255 @@ to RGBA or RGB with 8 bit per cannel. buffer must be RGBA or RGB output with
 enough memory, if has_alpha is true the output is RGBA. mode has the color mode
 of the input buffer.*/
 static void getPixelColorsRGBA8(unsigned char* buffer, size_t numpixels,
-	unsigned has_alpha, const unsigned char* in,
-	const LodePNGColorMode* mode)
-{
-	unsigned num_channels = has_alpha ? 4 : 3;
-	size_t i;
-	if (mode->colortype == LCT_GREY)
-	{
-		if (mode->bitdepth == 8)
-		{
-			for (i = 0; i != numpixels; ++i, buffer += num_channels)
-			{
-				buffer[0] = buffer[1] = buffer[2] = in[i];
-				if (has_alpha) buffer[3] = mode->key_defined && in[i] == mode->key_r ? 0 : 255;
-			}
-		}
-		else if (mode->bitdepth == 16)
-		{
-			for (i = 0; i != numpixels; ++i, buffer += num_channels)
-			{
-				buffer[0] = buffer[1] = buffer[2] = in[i * 2];
-				if (has_alpha) buffer[3] = mode->key_defined && 256U * in[i * 2 + 0] + in[i * 2 + 1] == mode->key_r ? 0 : 255;
-			}
-		}
-		else
-		{
-			unsigned highest = ((1U << mode->bitdepth) - 1U); /*highest possible value for this bit depth*/
-			size_t j = 0;
-			for (i = 0; i != numpixels; ++i, buffer += num_channels)
-			{
-				unsigned value = readBitsFromReversedStream(&j, in, mode->bitdepth);
-				buffer[0] = buffer[1] = buffer[2] = (value * 255) / highest;
-				if (has_alpha) buffer[3] = mode->key_defined && value == mode->key_r ? 0 : 255;
-			}
-		}
-	}
-	else if (mode->colortype == LCT_RGB)
-	{
-		if (mode->bitdepth == 8)
-		{
-			for (i = 0; i != numpixels; ++i, buffer += num_channels)
-			{
-				buffer[0] = in[i * 3 + 0];
-				buffer[1] = in[i * 3 + 1];
-				buffer[2] = in[i * 3 + 2];
-				if (has_alpha) buffer[3] = mode->key_defined && buffer[0] == mode->key_r
-					&& buffer[1] == mode->key_g && buffer[2] == mode->key_b ? 0 : 255;
-			}
-		}
-		else
-		{
-			for (i = 0; i != numpixels; ++i, buffer += num_channels)
-			{
-				buffer[0] = in[i * 6 + 0];
-				buffer[1] = in[i * 6 + 2];
-				buffer[2] = in[i * 6 + 4];
-				if (has_alpha) buffer[3] = mode->key_defined
-					&& 256U * in[i * 6 + 0] + in[i * 6 + 1] == mode->key_r
-					&& 256U * in[i * 6 + 2] + in[i * 6 + 3] == mode->key_g
-					&& 256U * in[i * 6 + 4] + in[i * 6 + 5] == mode->key_b ? 0 : 255;
-			}
-		}
-	}
-	else if (mode->colortype == LCT_PALETTE)
-	{
-		unsigned index;
-		size_t j = 0;
-		for (i = 0; i != numpixels; ++i, buffer += num_channels)
-		{
-			if (mode->bitdepth == 8) index = in[i];
-			else index = readBitsFromReversedStream(&j, in, mode->bitdepth);
-
-			if (index >= mode->palettesize)
-			{
-				/*This is an error according to the PNG spec, but most PNG decoders make it black instead.
-				Done here too, slightly faster due to no error handling needed.*/
-				buffer[0] = buffer[1] = buffer[2] = 0;
-				if (has_alpha) buffer[3] = 255;
-			}
-			else
-			{
-				buffer[0] = mode->palette[index * 4 + 0];
-				buffer[1] = mode->palette[index * 4 + 1];
-				buffer[2] = mode->palette[index * 4 + 2];
-				if (has_alpha) buffer[3] = mode->palette[index * 4 + 3];
-			}
-		}
-	}
-	else if (mode->colortype == LCT_GREY_ALPHA)
-	{
-		if (mode->bitdepth == 8)
-		{
-			for (i = 0; i != numpixels; ++i, buffer += num_channels)
-			{
-				buffer[0] = buffer[1] = buffer[2] = in[i * 2 + 0];
-				if (has_alpha) buffer[3] = in[i * 2 + 1];
-			}
-		}
-		else
-		{
-			for (i = 0; i != numpixels; ++i, buffer += num_channels)
-			{
-				buffer[0] = buffer[1] = buffer[2] = in[i * 4 + 0];
-				if (has_alpha) buffer[3] = in[i * 4 + 2];
-			}
-		}
-	}
-	else if (mode->colortype == LCT_RGBA)
-	{
-		if (mode->bitdepth == 8)
-		{
-			for (i = 0; i != numpixels; ++i, buffer += num_channels)
-			{
-				buffer[0] = in[i * 4 + 0];
-				buffer[1] = in[i * 4 + 1];
-				buffer[2] = in[i * 4 + 2];
-				if (has_alpha) buffer[3] = in[i * 4 + 3];
-			}
-		}
-		else
-		{
-			for (i = 0; i != numpixels; ++i, buffer += num_channels)
-			{
-				buffer[0] = in[i * 8 + 0];
-				buffer[1] = in[i * 8 + 2];
-				buffer[2] = in[i * 8 + 4];
-				if (has_alpha) buffer[3] = in[i * 8 + 6];
-			}
-		}
-	}
+    unsigned has_alpha, const unsigned char* in,
+    const LodePNGColorMode* mode)
+{
+    unsigned num_channels = has_alpha ? 4 : 3;
+    size_t i;
+    if (mode->colortype == LCT_GREY)
+    {
+        if (mode->bitdepth == 8)
+        {
+            for (i = 0; i != numpixels; ++i, buffer += num_channels)
+            {
+                buffer[0] = buffer[1] = buffer[2] = in[i];
+                if (has_alpha) buffer[3] = mode->key_defined && in[i] == mode->key_r ? 0 : 255;
+            }
+        }
+        else if (mode->bitdepth == 16)
+        {
+            for (i = 0; i != numpixels; ++i, buffer += num_channels)
+            {
+                buffer[0] = buffer[1] = buffer[2] = in[i * 2];
+                if (has_alpha) buffer[3] = mode->key_defined && 256U * in[i * 2 + 0] + in[i * 2 + 1] == mode->key_r ? 0 : 255;
+            }
+        }
+        else
+        {
+            unsigned highest = ((1U << mode->bitdepth) - 1U); /*highest possible value for this bit depth*/
+            size_t j = 0;
+            for (i = 0; i != numpixels; ++i, buffer += num_channels)
+            {
+                unsigned value = readBitsFromReversedStream(&j, in, mode->bitdepth);
+                buffer[0] = buffer[1] = buffer[2] = (value * 255) / highest;
+                if (has_alpha) buffer[3] = mode->key_defined && value == mode->key_r ? 0 : 255;
+            }
+        }
+    }
+    else if (mode->colortype == LCT_RGB)
+    {
+        if (mode->bitdepth == 8)
+        {
+            for (i = 0; i != numpixels; ++i, buffer += num_channels)
+            {
+                buffer[0] = in[i * 3 + 0];
+                buffer[1] = in[i * 3 + 1];
+                buffer[2] = in[i * 3 + 2];
+                if (has_alpha) buffer[3] = mode->key_defined && buffer[0] == mode->key_r
+                    && buffer[1] == mode->key_g && buffer[2] == mode->key_b ? 0 : 255;
+            }
+        }
+        else
+        {
+            for (i = 0; i != numpixels; ++i, buffer += num_channels)
+            {
+                buffer[0] = in[i * 6 + 0];
+                buffer[1] = in[i * 6 + 2];
+                buffer[2] = in[i * 6 + 4];
+                if (has_alpha) buffer[3] = mode->key_defined
+                    && 256U * in[i * 6 + 0] + in[i * 6 + 1] == mode->key_r
+                    && 256U * in[i * 6 + 2] + in[i * 6 + 3] == mode->key_g
+                    && 256U * in[i * 6 + 4] + in[i * 6 + 5] == mode->key_b ? 0 : 255;
+            }
+        }
+    }
+    else if (mode->colortype == LCT_PALETTE)
+    {
+        unsigned index;
+        size_t j = 0;
+        for (i = 0; i != numpixels; ++i, buffer += num_channels)
+        {
+            if (mode->bitdepth == 8) index = in[i];
+            else index = readBitsFromReversedStream(&j, in, mode->bitdepth);
+
+            if (index >= mode->palettesize)
+            {
+                /*This is an error according to the PNG spec, but most PNG decoders make it black instead.
+                Done here too, slightly faster due to no error handling needed.*/
+                buffer[0] = buffer[1] = buffer[2] = 0;
+                if (has_alpha) buffer[3] = 255;
+            }
+            else
+            {
+                buffer[0] = mode->palette[index * 4 + 0];
+                buffer[1] = mode->palette[index * 4 + 1];
+                buffer[2] = mode->palette[index * 4 + 2];
+                if (has_alpha) buffer[3] = mode->palette[index * 4 + 3];
+            }
+        }
+    }
+    else if (mode->colortype == LCT_GREY_ALPHA)
+    {
+        if (mode->bitdepth == 8)
+        {
+            for (i = 0; i != numpixels; ++i, buffer += num_channels)
+            {
+                buffer[0] = buffer[1] = buffer[2] = in[i * 2 + 0];
+                if (has_alpha) buffer[3] = in[i * 2 + 1];
+            }
+        }
+        else
+        {
+            for (i = 0; i != numpixels; ++i, buffer += num_channels)
+            {
+                buffer[0] = buffer[1] = buffer[2] = in[i * 4 + 0];
+                if (has_alpha) buffer[3] = in[i * 4 + 2];
+            }
+        }
+    }
+    else if (mode->colortype == LCT_RGBA)
+    {
+        if (mode->bitdepth == 8)
+        {
+            for (i = 0; i != numpixels; ++i, buffer += num_channels)
+            {
+                buffer[0] = in[i * 4 + 0];
+                buffer[1] = in[i * 4 + 1];
+                buffer[2] = in[i * 4 + 2];
+                if (has_alpha) buffer[3] = in[i * 4 + 3];
+            }
+        }
+        else
+        {
+            for (i = 0; i != numpixels; ++i, buffer += num_channels)
+            {
+                buffer[0] = in[i * 8 + 0];
+                buffer[1] = in[i * 8 + 2];
+                buffer[2] = in[i * 8 + 4];
+                if (has_alpha) buffer[3] = in[i * 8 + 6];
+            }
+        }
+    }
 }
 
 /*Get RGBA16 color of pixel with index i (y * width + x) from the raw image with
 given color type, but the given color type must be 16-bit itself.*/
 static void getPixelColorRGBA16(unsigned short* r, unsigned short* g, unsigned short* b, unsigned short* a,
-	const unsigned char* in, size_t i, const LodePNGColorMode* mode)
-{
-	if (mode->colortype == LCT_GREY)
-	{
-		*r = *g = *b = 256 * in[i * 2 + 0] + in[i * 2 + 1];
-		if (mode->key_defined && 256U * in[i * 2 + 0] + in[i * 2 + 1] == mode->key_r) *a = 0;
-		else *a = 65535;
-	}
-	else if (mode->colortype == LCT_RGB)
-	{
-		*r = 256u * in[i * 6 + 0] + in[i * 6 + 1];
-		*g = 256u * in[i * 6 + 2] + in[i * 6 + 3];
-		*b = 256u * in[i * 6 + 4] + in[i * 6 + 5];
-		if (mode->key_defined
-			&& 256u * in[i * 6 + 0] + in[i * 6 + 1] == mode->key_r
-			&& 256u * in[i * 6 + 2] + in[i * 6 + 3] == mode->key_g
-			&& 256u * in[i * 6 + 4] + in[i * 6 + 5] == mode->key_b) *a = 0;
-		else *a = 65535;
-	}
-	else if (mode->colortype == LCT_GREY_ALPHA)
-	{
-		*r = *g = *b = 256u * in[i * 4 + 0] + in[i * 4 + 1];
-		*a = 256u * in[i * 4 + 2] + in[i * 4 + 3];
-	}
-	else if (mode->colortype == LCT_RGBA)
-	{
-		*r = 256u * in[i * 8 + 0] + in[i * 8 + 1];
-		*g = 256u * in[i * 8 + 2] + in[i * 8 + 3];
-		*b = 256u * in[i * 8 + 4] + in[i * 8 + 5];
-		*a = 256u * in[i * 8 + 6] + in[i * 8 + 7];
-	}
+    const unsigned char* in, size_t i, const LodePNGColorMode* mode)
+{
+    if (mode->colortype == LCT_GREY)
+    {
+        *r = *g = *b = 256 * in[i * 2 + 0] + in[i * 2 + 1];
+        if (mode->key_defined && 256U * in[i * 2 + 0] + in[i * 2 + 1] == mode->key_r) *a = 0;
+        else *a = 65535;
+    }
+    else if (mode->colortype == LCT_RGB)
+    {
+        *r = 256u * in[i * 6 + 0] + in[i * 6 + 1];
+        *g = 256u * in[i * 6 + 2] + in[i * 6 + 3];
+        *b = 256u * in[i * 6 + 4] + in[i * 6 + 5];
+        if (mode->key_defined
+            && 256u * in[i * 6 + 0] + in[i * 6 + 1] == mode->key_r
+            && 256u * in[i * 6 + 2] + in[i * 6 + 3] == mode->key_g
+            && 256u * in[i * 6 + 4] + in[i * 6 + 5] == mode->key_b) *a = 0;
+        else *a = 65535;
+    }
+    else if (mode->colortype == LCT_GREY_ALPHA)
+    {
+        *r = *g = *b = 256u * in[i * 4 + 0] + in[i * 4 + 1];
+        *a = 256u * in[i * 4 + 2] + in[i * 4 + 3];
+    }
+    else if (mode->colortype == LCT_RGBA)
+    {
+        *r = 256u * in[i * 8 + 0] + in[i * 8 + 1];
+        *g = 256u * in[i * 8 + 2] + in[i * 8 + 3];
+        *b = 256u * in[i * 8 + 4] + in[i * 8 + 5];
+        *a = 256u * in[i * 8 + 6] + in[i * 8 + 7];
+    }
 }
 
 unsigned lodepng_convert(unsigned char* out, const unsigned char* in,
-	const LodePNGColorMode* mode_out, const LodePNGColorMode* mode_in,
-	unsigned w, unsigned h)
-{
-	size_t i;
-	ColorTree tree;
-	size_t numpixels = w * h;
-
-	if (lodepng_color_mode_equal(mode_out, mode_in))
-	{
-		size_t numbytes = lodepng_get_raw_size(w, h, mode_in);
-		for (i = 0; i != numbytes; ++i) out[i] = in[i];
-		return 0;
-	}
-
-	if (mode_out->colortype == LCT_PALETTE)
-	{
-		size_t palettesize = mode_out->palettesize;
-		const unsigned char* palette = mode_out->palette;
-		size_t palsize = 1u << mode_out->bitdepth;
-		/*if the user specified output palette but did not give the values, assume
-		they want the values of the input color type (assuming that one is palette).
-		Note that we never create a new palette ourselves.*/
-		if (palettesize == 0)
-		{
-			palettesize = mode_in->palettesize;
-			palette = mode_in->palette;
-		}
-		if (palettesize < palsize) palsize = palettesize;
-		color_tree_init(&tree);
-		for (i = 0; i != palsize; ++i)
-		{
-			const unsigned char* p = &palette[i * 4];
-			color_tree_add(&tree, p[0], p[1], p[2], p[3], i);
-		}
-	}
-
-	if (mode_in->bitdepth == 16 && mode_out->bitdepth == 16)
-	{
-		for (i = 0; i != numpixels; ++i)
-		{
-			unsigned short r = 0, g = 0, b = 0, a = 0;
-			getPixelColorRGBA16(&r, &g, &b, &a, in, i, mode_in);
-			rgba16ToPixel(out, i, mode_out, r, g, b, a);
-		}
-	}
-	else if (mode_out->bitdepth == 8 && mode_out->colortype == LCT_RGBA)
-	{
-		getPixelColorsRGBA8(out, numpixels, 1, in, mode_in);
-	}
-	else if (mode_out->bitdepth == 8 && mode_out->colortype == LCT_RGB)
-	{
-		getPixelColorsRGBA8(out, numpixels, 0, in, mode_in);
-	}
-	else
-	{
-		unsigned char r = 0, g = 0, b = 0, a = 0;
-		for (i = 0; i != numpixels; ++i)
-		{
-			getPixelColorRGBA8(&r, &g, &b, &a, in, i, mode_in);
-			CERROR_TRY_RETURN(rgba8ToPixel(out, i, mode_out, &tree, r, g, b, a));
-		}
-	}
-
-	if (mode_out->colortype == LCT_PALETTE)
-	{
-		color_tree_cleanup(&tree);
-	}
-
-	return 0; /*no error*/
+    const LodePNGColorMode* mode_out, const LodePNGColorMode* mode_in,
+    unsigned w, unsigned h)
+{
+    size_t i;
+    ColorTree tree;
+    size_t numpixels = w * h;
+
+    if (lodepng_color_mode_equal(mode_out, mode_in))
+    {
+        size_t numbytes = lodepng_get_raw_size(w, h, mode_in);
+        for (i = 0; i != numbytes; ++i) out[i] = in[i];
+        return 0;
+    }
+
+    if (mode_out->colortype == LCT_PALETTE)
+    {
+        size_t palettesize = mode_out->palettesize;
+        const unsigned char* palette = mode_out->palette;
+        size_t palsize = 1u << mode_out->bitdepth;
+        /*if the user specified output palette but did not give the values, assume
+        they want the values of the input color type (assuming that one is palette).
+        Note that we never create a new palette ourselves.*/
+        if (palettesize == 0)
+        {
+            palettesize = mode_in->palettesize;
+            palette = mode_in->palette;
+        }
+        if (palettesize < palsize) palsize = palettesize;
+        color_tree_init(&tree);
+        for (i = 0; i != palsize; ++i)
+        {
+            const unsigned char* p = &palette[i * 4];
+            color_tree_add(&tree, p[0], p[1], p[2], p[3], i);
+        }
+    }
+
+    if (mode_in->bitdepth == 16 && mode_out->bitdepth == 16)
+    {
+        for (i = 0; i != numpixels; ++i)
+        {
+            unsigned short r = 0, g = 0, b = 0, a = 0;
+            getPixelColorRGBA16(&r, &g, &b, &a, in, i, mode_in);
+            rgba16ToPixel(out, i, mode_out, r, g, b, a);
+        }
+    }
+    else if (mode_out->bitdepth == 8 && mode_out->colortype == LCT_RGBA)
+    {
+        getPixelColorsRGBA8(out, numpixels, 1, in, mode_in);
+    }
+    else if (mode_out->bitdepth == 8 && mode_out->colortype == LCT_RGB)
+    {
+        getPixelColorsRGBA8(out, numpixels, 0, in, mode_in);
+    }
+    else
+    {
+        unsigned char r = 0, g = 0, b = 0, a = 0;
+        for (i = 0; i != numpixels; ++i)
+        {
+            getPixelColorRGBA8(&r, &g, &b, &a, in, i, mode_in);
+            CERROR_TRY_RETURN(rgba8ToPixel(out, i, mode_out, &tree, r, g, b, a));
+        }
+    }
+
+    if (mode_out->colortype == LCT_PALETTE)
+    {
+        color_tree_cleanup(&tree);
+    }
+
+    return 0; /*no error*/
 }
 
 #ifdef LODEPNG_COMPILE_ENCODER
 
 void lodepng_color_profile_init(LodePNGColorProfile* profile)
 {
-	profile->colored = 0;
-	profile->key = 0;
-	profile->alpha = 0;
-	profile->key_r = profile->key_g = profile->key_b = 0;
-	profile->numcolors = 0;
-	profile->bits = 1;
+    profile->colored = 0;
+    profile->key = 0;
+    profile->alpha = 0;
+    profile->key_r = profile->key_g = profile->key_b = 0;
+    profile->numcolors = 0;
+    profile->bits = 1;
 }
 
 /*function used for debug purposes with C++*/
@@ -3557,197 +4836,326 @@ std::cout << "bits: " << (int)p->bits << std::endl;
 /*Returns how many bits needed to represent given value (max 8 bit)*/
 static unsigned getValueRequiredBits(unsigned char value)
 {
-	if (value == 0 || value == 255) return 1;
-	/*The scaling of 2-bit and 4-bit values uses multiples of 85 and 17*/
-	if (value % 17 == 0) return value % 85 == 0 ? 2 : 4;
-	return 8;
+    if (value == 0 || value == 255) return 1;
+    /*The scaling of 2-bit and 4-bit values uses multiples of 85 and 17*/
+    if (value % 17 == 0) return value % 85 == 0 ? 2 : 4;
+    return 8;
+}
+
+/*Gets the profile of h rows of w pixels that start stride bytes apart, the pixels of a row are read by their
+index from the start of the row. profile must already have been inited with mode.
+It's ok to set some parameters of profile to done already.*/
+static unsigned getColorProfile(LodePNGColorProfile* profile,
+    const unsigned char* in, size_t w, size_t h, size_t stride,
+    const LodePNGColorMode* mode)
+{
+    unsigned error = 0;
+    size_t x, y;
+    ColorTree tree;
+    const unsigned char* row;
+
+    unsigned colored_done = lodepng_is_greyscale_type(mode) ? 1 : 0;
+    unsigned alpha_done = lodepng_can_have_alpha(mode) ? 0 : 1;
+    unsigned numcolors_done = 0;
+    unsigned bpp = lodepng_get_bpp(mode);
+    unsigned bits_done = bpp == 1 ? 1 : 0;
+    unsigned maxnumcolors = 257;
+    unsigned sixteen = 0;
+    unsigned done = 0;
+    if (bpp <= 8) maxnumcolors = bpp == 1 ? 2 : (bpp == 2 ? 4 : (bpp == 4 ? 16 : 256));
+
+    color_tree_init(&tree);
+
+    /*Check if the 16-bit input is truly 16-bit*/
+    if (mode->bitdepth == 16)
+    {
+        unsigned short r, g, b, a;
+        for (y = 0; y != h && !sixteen; ++y)
+        {
+            row = in + y * stride;
+            for (x = 0; x != w; ++x)
+            {
+                getPixelColorRGBA16(&r, &g, &b, &a, row, x, mode);
+                if ((r & 255) != ((r >> 8) & 255) || (g & 255) != ((g >> 8) & 255) ||
+                    (b & 255) != ((b >> 8) & 255) || (a & 255) != ((a >> 8) & 255)) /*first and second byte differ*/
+                {
+                    sixteen = 1;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (sixteen)
+    {
+        unsigned short r = 0, g = 0, b = 0, a = 0;
+        profile->bits = 16;
+        bits_done = numcolors_done = 1; /*counting colors no longer useful, palette doesn't support 16-bit*/
+
+        for (y = 0; y != h && !done; ++y)
+        {
+            row = in + y * stride;
+            for (x = 0; x != w; ++x)
+            {
+                getPixelColorRGBA16(&r, &g, &b, &a, row, x, mode);
+
+                if (!colored_done && (r != g || r != b))
+                {
+                    profile->colored = 1;
+                    colored_done = 1;
+                }
+
+                if (!alpha_done)
+                {
+                    unsigned matchkey = (r == profile->key_r && g == profile->key_g && b == profile->key_b);
+                    if (a != 65535 && (a != 0 || (profile->key && !matchkey)))
+                    {
+                        profile->alpha = 1;
+                        alpha_done = 1;
+                        if (profile->bits < 8) profile->bits = 8; /*PNG has no alphachannel modes with less than 8-bit per channel*/
+                    }
+                    else if (a == 0 && !profile->alpha && !profile->key)
+                    {
+                        profile->key = 1;
+                        profile->key_r = r;
+                        profile->key_g = g;
+                        profile->key_b = b;
+                    }
+                    else if (a == 65535 && profile->key && matchkey)
+                    {
+                        /* Color key cannot be used if an opaque pixel also has that RGB color. */
+                        profile->alpha = 1;
+                        alpha_done = 1;
+                    }
+                }
+                if (alpha_done && numcolors_done && colored_done && bits_done)
+                {
+                    done = 1;
+                    break;
+                }
+            }
+        }
+
+        if (profile->key && !profile->alpha)
+        {
+            for (y = 0; y != h; ++y)
+            {
+                row = in + y * stride;
+                for (x = 0; x != w; ++x)
+                {
+                    getPixelColorRGBA16(&r, &g, &b, &a, row, x, mode);
+                    if (a != 0 && r == profile->key_r && g == profile->key_g && b == profile->key_b)
+                    {
+                        /* Color key cannot be used if an opaque pixel also has that RGB color. */
+                        profile->alpha = 1;
+                        alpha_done = 1;
+                    }
+                }
+            }
+        }
+    }
+    else /* < 16-bit */
+    {
+        unsigned char r = 0, g = 0, b = 0, a = 0;
+        unsigned char last_r = 0, last_g = 0, last_b = 0, last_a = 0;
+        /*the most common input is read directly instead of through the conversion of every color type*/
+        unsigned rgba8 = mode->colortype == LCT_RGBA && mode->bitdepth == 8;
+        for (y = 0; y != h && !done; ++y)
+        {
+            row = in + y * stride;
+            for (x = 0; x != w; ++x)
+            {
+                if (rgba8)
+                {
+                    r = row[x * 4 + 0];
+                    g = row[x * 4 + 1];
+                    b = row[x * 4 + 2];
+                    a = row[x * 4 + 3];
+                }
+                else getPixelColorRGBA8(&r, &g, &b, &a, row, x, mode);
+
+                if (!bits_done && profile->bits < 8)
+                {
+                    /*only r is checked, < 8 bits is only relevant for greyscale*/
+                    unsigned bits = getValueRequiredBits(r);
+                    if (bits > profile->bits) profile->bits = bits;
+                }
+                bits_done = (profile->bits >= bpp || profile->bits >= 8); /*no more than 8 bits are needed here*/
+
+                if (!colored_done && (r != g || r != b))
+                {
+                    profile->colored = 1;
+                    colored_done = 1;
+                    if (profile->bits < 8) profile->bits = 8; /*PNG has no colored modes with less than 8-bit per channel*/
+                }
+
+                if (!alpha_done)
+                {
+                    unsigned matchkey = (r == profile->key_r && g == profile->key_g && b == profile->key_b);
+                    if (a != 255 && (a != 0 || (profile->key && !matchkey)))
+                    {
+                        profile->alpha = 1;
+                        alpha_done = 1;
+                        if (profile->bits < 8) profile->bits = 8; /*PNG has no alphachannel modes with less than 8-bit per channel*/
+                    }
+                    else if (a == 0 && !profile->alpha && !profile->key)
+                    {
+                        profile->key = 1;
+                        profile->key_r = r;
+                        profile->key_g = g;
+                        profile->key_b = b;
+                    }
+                    else if (a == 255 && profile->key && matchkey)
+                    {
+                        /* Color key cannot be used if an opaque pixel also has that RGB color. */
+                        profile->alpha = 1;
+                        alpha_done = 1;
+                        if (profile->bits < 8) profile->bits = 8; /*PNG has no alphachannel modes with less than 8-bit per channel*/
+                    }
+                }
+
+                /*runs of the same color are common, only the first pixel of a run is looked up*/
+                if (!numcolors_done && ((x == 0 && y == 0) || r != last_r || g != last_g || b != last_b || a != last_a))
+                {
+                    last_r = r;
+                    last_g = g;
+                    last_b = b;
+                    last_a = a;
+                    if (!color_tree_has(&tree, r, g, b, a))
+                    {
+                        color_tree_add(&tree, r, g, b, a, profile->numcolors);
+                        if (profile->numcolors < 256)
+                        {
+                            unsigned char* p = profile->palette;
+                            unsigned n = profile->numcolors;
+                            p[n * 4 + 0] = r;
+                            p[n * 4 + 1] = g;
+                            p[n * 4 + 2] = b;
+                            p[n * 4 + 3] = a;
+                        }
+                        ++profile->numcolors;
+                        numcolors_done = profile->numcolors >= maxnumcolors;
+                    }
+                }
+
+                if (alpha_done && numcolors_done && colored_done && bits_done)
+                {
+                    done = 1;
+                    break;
+                }
+                if (rgba8 && numcolors_done && colored_done && bits_done && !profile->key)
+                {
+                    /*only a pixel that isn't opaque can still change the profile, opaque images end up here*/
+                    while (x + 1 != w && row[(x + 1) * 4 + 3] == 255) ++x;
+                }
+            }
+        }
+
+        if (profile->key && !profile->alpha)
+        {
+            for (y = 0; y != h; ++y)
+            {
+                row = in + y * stride;
+                for (x = 0; x != w; ++x)
+                {
+                    getPixelColorRGBA8(&r, &g, &b, &a, row, x, mode);
+                    if (a != 0 && r == profile->key_r && g == profile->key_g && b == profile->key_b)
+                    {
+                        /* Color key cannot be used if an opaque pixel also has that RGB color. */
+                        profile->alpha = 1;
+                        alpha_done = 1;
+                    }
+                }
+            }
+        }
+
+        /*make the profile's key always 16-bit for consistency - repeat each byte twice*/
+        profile->key_r += (profile->key_r << 8);
+        profile->key_g += (profile->key_g << 8);
+        profile->key_b += (profile->key_b << 8);
+    }
+
+    color_tree_cleanup(&tree);
+    return error;
 }
 
 /*profile must already have been inited with mode.
 It's ok to set some parameters of profile to done already.*/
 unsigned lodepng_get_color_profile(LodePNGColorProfile* profile,
-	const unsigned char* in, unsigned w, unsigned h,
-	const LodePNGColorMode* mode)
-{
-	unsigned error = 0;
-	size_t i;
-	ColorTree tree;
-	size_t numpixels = w * h;
-
-	unsigned colored_done = lodepng_is_greyscale_type(mode) ? 1 : 0;
-	unsigned alpha_done = lodepng_can_have_alpha(mode) ? 0 : 1;
-	unsigned numcolors_done = 0;
-	unsigned bpp = lodepng_get_bpp(mode);
-	unsigned bits_done = bpp == 1 ? 1 : 0;
-	unsigned maxnumcolors = 257;
-	unsigned sixteen = 0;
-	if (bpp <= 8) maxnumcolors = bpp == 1 ? 2 : (bpp == 2 ? 4 : (bpp == 4 ? 16 : 256));
-
-	color_tree_init(&tree);
-
-	/*Check if the 16-bit input is truly 16-bit*/
-	if (mode->bitdepth == 16)
-	{
-		unsigned short r, g, b, a;
-		for (i = 0; i != numpixels; ++i)
-		{
-			getPixelColorRGBA16(&r, &g, &b, &a, in, i, mode);
-			if ((r & 255) != ((r >> 8) & 255) || (g & 255) != ((g >> 8) & 255) ||
-				(b & 255) != ((b >> 8) & 255) || (a & 255) != ((a >> 8) & 255)) /*first and second byte differ*/
-			{
-				sixteen = 1;
-				break;
-			}
-		}
-	}
-
-	if (sixteen)
-	{
-		unsigned short r = 0, g = 0, b = 0, a = 0;
-		profile->bits = 16;
-		bits_done = numcolors_done = 1; /*counting colors no longer useful, palette doesn't support 16-bit*/
-
-		for (i = 0; i != numpixels; ++i)
-		{
-			getPixelColorRGBA16(&r, &g, &b, &a, in, i, mode);
-
-			if (!colored_done && (r != g || r != b))
-			{
-				profile->colored = 1;
-				colored_done = 1;
-			}
-
-			if (!alpha_done)
-			{
-				unsigned matchkey = (r == profile->key_r && g == profile->key_g && b == profile->key_b);
-				if (a != 65535 && (a != 0 || (profile->key && !matchkey)))
-				{
-					profile->alpha = 1;
-					alpha_done = 1;
-					if (profile->bits < 8) profile->bits = 8; /*PNG has no alphachannel modes with less than 8-bit per channel*/
-				}
-				else if (a == 0 && !profile->alpha && !profile->key)
-				{
-					profile->key = 1;
-					profile->key_r = r;
-					profile->key_g = g;
-					profile->key_b = b;
-				}
-				else if (a == 65535 && profile->key && matchkey)
-				{
-					/* Color key cannot be used if an opaque pixel also has that RGB color. */
-					profile->alpha = 1;
-					alpha_done = 1;
-				}
-			}
-			if (alpha_done && numcolors_done && colored_done && bits_done) break;
-		}
-
-		if (profile->key && !profile->alpha)
-		{
-			for (i = 0; i != numpixels; ++i)
-			{
-				getPixelColorRGBA16(&r, &g, &b, &a, in, i, mode);
-				if (a != 0 && r == profile->key_r && g == profile->key_g && b == profile->key_b)
-				{
-					/* Color key cannot be used if an opaque pixel also has that RGB color. */
-					profile->alpha = 1;
-					alpha_done = 1;
-				}
-			}
-		}
-	}
-	else /* < 16-bit */
-	{
-		unsigned char r = 0, g = 0, b = 0, a = 0;
-		for (i = 0; i != numpixels; ++i)
-		{
-			getPixelColorRGBA8(&r, &g, &b, &a, in, i, mode);
-
-			if (!bits_done && profile->bits < 8)
-			{
-				/*only r is checked, < 8 bits is only relevant for greyscale*/
-				unsigned bits = getValueRequiredBits(r);
-				if (bits > profile->bits) profile->bits = bits;
-			}
-			bits_done = (profile->bits >= bpp);
-
-			if (!colored_done && (r != g || r != b))
-			{
-				profile->colored = 1;
-				colored_done = 1;
-				if (profile->bits < 8) profile->bits = 8; /*PNG has no colored modes with less than 8-bit per channel*/
-			}
-
-			if (!alpha_done)
-			{
-				unsigned matchkey = (r == profile->key_r && g == profile->key_g && b == profile->key_b);
-				if (a != 255 && (a != 0 || (profile->key && !matchkey)))
-				{
-					profile->alpha = 1;
-					alpha_done = 1;
-					if (profile->bits < 8) profile->bits = 8; /*PNG has no alphachannel modes with less than 8-bit per channel*/
-				}
-				else if (a == 0 && !profile->alpha && !profile->key)
-				{
-					profile->key = 1;
-					profile->key_r = r;
-					profile->key_g = g;
-					profile->key_b = b;
-				}
-				else if (a == 255 && profile->key && matchkey)
-				{
-					/* Color key cannot be used if an opaque pixel also has that RGB color. */
-					profile->alpha = 1;
-					alpha_done = 1;
-					if (profile->bits < 8) profile->bits = 8; /*PNG has no alphachannel modes with less than 8-bit per channel*/
-				}
-			}
-
-			if (!numcolors_done)
-			{
-				if (!color_tree_has(&tree, r, g, b, a))
-				{
-					color_tree_add(&tree, r, g, b, a, profile->numcolors);
-					if (profile->numcolors < 256)
-					{
-						unsigned char* p = profile->palette;
-						unsigned n = profile->numcolors;
-						p[n * 4 + 0] = r;
-						p[n * 4 + 1] = g;
-						p[n * 4 + 2] = b;
-						p[n * 4 + 3] = a;
-					}
-					++profile->numcolors;
-					numcolors_done = profile->numcolors >= maxnumcolors;
-				}
-			}
-
-			if (alpha_done && numcolors_done && colored_done && bits_done) break;
-		}
-
-		if (profile->key && !profile->alpha)
-		{
-			for (i = 0; i != numpixels; ++i)
-			{
-				getPixelColorRGBA8(&r, &g, &b, &a, in, i, mode);
-				if (a != 0 && r == profile->key_r && g == profile->key_g && b == profile->key_b)
-				{
-					/* Color key cannot be used if an opaque pixel also has that RGB color. */
-					profile->alpha = 1;
-					alpha_done = 1;
-				}
-			}
-		}
-
-		/*make the profile's key always 16-bit for consistency - repeat each byte twice*/
-		profile->key_r += (profile->key_r << 8);
-		profile->key_g += (profile->key_g << 8);
-		profile->key_b += (profile->key_b << 8);
-	}
-
-	color_tree_cleanup(&tree);
-	return error;
+    const unsigned char* in, unsigned w, unsigned h,
+    const LodePNGColorMode* mode)
+{
+    /*raw images have no padding between rows, pixels smaller than a byte continue in the byte the last row ended in,
+    so the image is read as one long row*/
+    return getColorProfile(profile, in, (size_t)w * h, 1, 0, mode);
+}
+
+unsigned lodepng_get_color_profile_rows(LodePNGColorProfile* profile,
+    const unsigned char* in, unsigned w, unsigned h, size_t stride,
+    const LodePNGColorMode* mode)
+{
+    return getColorProfile(profile, in, w, h, stride, mode);
+}
+
+/*Chooses the color mode from the profile of the image, the profile may be changed.*/
+static unsigned chooseColor(LodePNGColorMode* mode_out, LodePNGColorProfile* prof, unsigned w, unsigned h,
+    const LodePNGColorMode* mode_in)
+{
+    unsigned error = 0;
+    unsigned i, n, palettebits, grey_ok, palette_ok;
+
+    mode_out->key_defined = 0;
+
+    if (prof->key && w * h <= 16)
+    {
+        prof->alpha = 1; /*too few pixels to justify tRNS chunk overhead*/
+        if (prof->bits < 8) prof->bits = 8; /*PNG has no alphachannel modes with less than 8-bit per channel*/
+    }
+    grey_ok = !prof->colored && !prof->alpha; /*grey without alpha, with potentially low bits*/
+    n = prof->numcolors;
+    palettebits = n <= 2 ? 1 : (n <= 4 ? 2 : (n <= 16 ? 4 : 8));
+    palette_ok = n <= 256 && (n * 2 < w * h) && prof->bits <= 8;
+    if (w * h < n * 2) palette_ok = 0; /*don't add palette overhead if image has only a few pixels*/
+    if (grey_ok && prof->bits <= palettebits) palette_ok = 0; /*grey is less overhead*/
+
+    if (palette_ok)
+    {
+        unsigned char* p = prof->palette;
+        lodepng_palette_clear(mode_out); /*remove potential earlier palette*/
+        for (i = 0; i != prof->numcolors; ++i)
+        {
+            error = lodepng_palette_add(mode_out, p[i * 4 + 0], p[i * 4 + 1], p[i * 4 + 2], p[i * 4 + 3]);
+            if (error) break;
+        }
+
+        mode_out->colortype = LCT_PALETTE;
+        mode_out->bitdepth = palettebits;
+
+        if (mode_in->colortype == LCT_PALETTE && mode_in->palettesize >= mode_out->palettesize
+            && mode_in->bitdepth == mode_out->bitdepth)
+        {
+            /*If input should have same palette colors, keep original to preserve its order and prevent conversion*/
+            lodepng_color_mode_cleanup(mode_out);
+            lodepng_color_mode_copy(mode_out, mode_in);
+        }
+    }
+    else /*8-bit or 16-bit per channel*/
+    {
+        mode_out->bitdepth = prof->bits;
+        mode_out->colortype = prof->alpha ? (prof->colored ? LCT_RGBA : LCT_GREY_ALPHA)
+            : (prof->colored ? LCT_RGB : LCT_GREY);
+
+        if (prof->key && !prof->alpha)
+        {
+            unsigned mask = (1u << mode_out->bitdepth) - 1u; /*profile always uses 16-bit, mask converts it*/
+            mode_out->key_r = prof->key_r & mask;
+            mode_out->key_g = prof->key_g & mask;
+            mode_out->key_b = prof->key_b & mask;
+            mode_out->key_defined = 1;
+        }
+    }
+
+    return error;
 }
 
 /*Automatically chooses color type that gives smallest amount of bits in the
@@ -3756,68 +5164,27 @@ are less than 256 colors, ...
 Updates values of mode with a potentially smaller color model. mode_out should
 contain the user chosen color model, but will be overwritten with the new chosen one.*/
 unsigned lodepng_auto_choose_color(LodePNGColorMode* mode_out,
-	const unsigned char* image, unsigned w, unsigned h,
-	const LodePNGColorMode* mode_in)
-{
-	LodePNGColorProfile prof;
-	unsigned error = 0;
-	unsigned i, n, palettebits, grey_ok, palette_ok;
-
-	lodepng_color_profile_init(&prof);
-	error = lodepng_get_color_profile(&prof, image, w, h, mode_in);
-	if (error) return error;
-	mode_out->key_defined = 0;
-
-	if (prof.key && w * h <= 16)
-	{
-		prof.alpha = 1; /*too few pixels to justify tRNS chunk overhead*/
-		if (prof.bits < 8) prof.bits = 8; /*PNG has no alphachannel modes with less than 8-bit per channel*/
-	}
-	grey_ok = !prof.colored && !prof.alpha; /*grey without alpha, with potentially low bits*/
-	n = prof.numcolors;
-	palettebits = n <= 2 ? 1 : (n <= 4 ? 2 : (n <= 16 ? 4 : 8));
-	palette_ok = n <= 256 && (n * 2 < w * h) && prof.bits <= 8;
-	if (w * h < n * 2) palette_ok = 0; /*don't add palette overhead if image has only a few pixels*/
-	if (grey_ok && prof.bits <= palettebits) palette_ok = 0; /*grey is less overhead*/
-
-	if (palette_ok)
-	{
-		unsigned char* p = prof.palette;
-		lodepng_palette_clear(mode_out); /*remove potential earlier palette*/
-		for (i = 0; i != prof.numcolors; ++i)
-		{
-			error = lodepng_palette_add(mode_out, p[i * 4 + 0], p[i * 4 + 1], p[i * 4 + 2], p[i * 4 + 3]);
-			if (error) break;
-		}
-
-		mode_out->colortype = LCT_PALETTE;
-		mode_out->bitdepth = palettebits;
-
-		if (mode_in->colortype == LCT_PALETTE && mode_in->palettesize >= mode_out->palettesize
-			&& mode_in->bitdepth == mode_out->bitdepth)
-		{
-			/*If input should have same palette colors, keep original to preserve its order and prevent conversion*/
-			lodepng_color_mode_cleanup(mode_out);
-			lodepng_color_mode_copy(mode_out, mode_in);
-		}
-	}
-	else /*8-bit or 16-bit per channel*/
-	{
-		mode_out->bitdepth = prof.bits;
-		mode_out->colortype = prof.alpha ? (prof.colored ? LCT_RGBA : LCT_GREY_ALPHA)
-			: (prof.colored ? LCT_RGB : LCT_GREY);
-
-		if (prof.key && !prof.alpha)
-		{
-			unsigned mask = (1u << mode_out->bitdepth) - 1u; /*profile always uses 16-bit, mask converts it*/
-			mode_out->key_r = prof.key_r & mask;
-			mode_out->key_g = prof.key_g & mask;
-			mode_out->key_b = prof.key_b & mask;
-			mode_out->key_defined = 1;
-		}
-	}
-
-	return error;
+    const unsigned char* image, unsigned w, unsigned h,
+    const LodePNGColorMode* mode_in)
+{
+    LodePNGColorProfile prof;
+    unsigned error;
+    lodepng_color_profile_init(&prof);
+    error = lodepng_get_color_profile(&prof, image, w, h, mode_in);
+    if (error) return error;
+    return chooseColor(mode_out, &prof, w, h, mode_in);
+}
+
+unsigned lodepng_auto_choose_color_rows(LodePNGColorMode* mode_out,
+    const unsigned char* image, unsigned w, unsigned h, size_t stride,
+    const LodePNGColorMode* mode_in)
+{
+    LodePNGColorProfile prof;
+    unsigned error;
+    lodepng_color_profile_init(&prof);
+    error = lodepng_get_color_profile_rows(&prof, image, w, h, stride, mode_in);
+    if (error) return error;
+    return chooseColor(mode_out, &prof, w, h, mode_in);
 }
 
 #endif /* #ifdef LODEPNG_COMPILE_ENCODER */
@@ -3829,15 +5196,35 @@ are only needed to make the paeth calculation correct.
 */
 static unsigned char paethPredictor(short a, short b, short c)
 {
-	short pa = abs(b - c);
-	short pb = abs(a - c);
-	short pc = abs(a + b - c - c);
+    short pa = abs(b - c);
+    short pb = abs(a - c);
+    short pc = abs(a + b - c - c);
 
-	if (pc < pa && pc < pb) return (unsigned char)c;
-	else if (pb < pa) return (unsigned char)b;
-	else return (unsigned char)a;
+    if (pc < pa && pc < pb) return (unsigned char)c;
+    else if (pb < pa) return (unsigned char)b;
+    else return (unsigned char)a;
 }
 
+#ifdef LODEPNG_X86_SIMD
+/*paethPredictor of 8 values of 16 bits at once*/
+__attribute__((target("sse2")))
+static __m128i paethPredictorSSE2(__m128i a, __m128i b, __m128i c)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i pa = _mm_sub_epi16(b, c);
+    __m128i pb = _mm_sub_epi16(a, c);
+    __m128i pc = _mm_add_epi16(pa, pb); /*a + b - c - c*/
+    __m128i useb, usec;
+    pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+    pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+    pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+    useb = _mm_cmplt_epi16(pb, pa);
+    usec = _mm_and_si128(_mm_cmplt_epi16(pc, pa), _mm_cmplt_epi16(pc, pb));
+    a = _mm_or_si128(_mm_and_si128(useb, b), _mm_andnot_si128(useb, a));
+    return _mm_or_si128(_mm_and_si128(usec, c), _mm_andnot_si128(usec, a));
+}
+#endif /*LODEPNG_X86_SIMD*/
+
 /*shared values used by multiple Adam7 related functions*/
 
 static const unsigned ADAM7_IX[7] = { 0, 4, 0, 2, 0, 1, 0 }; /*x start values*/
@@ -3861,31 +5248,31 @@ bpp: bits per pixel
 end at a full byte
 */
 static void Adam7_getpassvalues(unsigned passw[7], unsigned passh[7], size_t filter_passstart[8],
-	size_t padded_passstart[8], size_t passstart[8], unsigned w, unsigned h, unsigned bpp)
-{
-	/*the passstart values have 8 values: the 8th one indicates the byte after the end of the 7th (= last) pass*/
-	unsigned i;
-
-	/*calculate width and height in pixels of each pass*/
-	for (i = 0; i != 7; ++i)
-	{
-		passw[i] = (w + ADAM7_DX[i] - ADAM7_IX[i] - 1) / ADAM7_DX[i];
-		passh[i] = (h + ADAM7_DY[i] - ADAM7_IY[i] - 1) / ADAM7_DY[i];
-		if (passw[i] == 0) passh[i] = 0;
-		if (passh[i] == 0) passw[i] = 0;
-	}
-
-	filter_passstart[0] = padded_passstart[0] = passstart[0] = 0;
-	for (i = 0; i != 7; ++i)
-	{
-		/*if passw[i] is 0, it's 0 bytes, not 1 (no filtertype-byte)*/
-		filter_passstart[i + 1] = filter_passstart[i]
-			+ ((passw[i] && passh[i]) ? passh[i] * (1 + (passw[i] * bpp + 7) / 8) : 0);
-		/*bits padded if needed to fill full byte at end of each scanline*/
-		padded_passstart[i + 1] = padded_passstart[i] + passh[i] * ((passw[i] * bpp + 7) / 8);
-		/*only padded at end of reduced image*/
-		passstart[i + 1] = passstart[i] + (passh[i] * passw[i] * bpp + 7) / 8;
-	}
+    size_t padded_passstart[8], size_t passstart[8], unsigned w, unsigned h, unsigned bpp)
+{
+    /*the passstart values have 8 values: the 8th one indicates the byte after the end of the 7th (= last) pass*/
+    unsigned i;
+
+    /*calculate width and height in pixels of each pass*/
+    for (i = 0; i != 7; ++i)
+    {
+        passw[i] = (w + ADAM7_DX[i] - ADAM7_IX[i] - 1) / ADAM7_DX[i];
+        passh[i] = (h + ADAM7_DY[i] - ADAM7_IY[i] - 1) / ADAM7_DY[i];
+        if (passw[i] == 0) passh[i] = 0;
+        if (passh[i] == 0) passw[i] = 0;
+    }
+
+    filter_passstart[0] = padded_passstart[0] = passstart[0] = 0;
+    for (i = 0; i != 7; ++i)
+    {
+        /*if passw[i] is 0, it's 0 bytes, not 1 (no filtertype-byte)*/
+        filter_passstart[i + 1] = filter_passstart[i]
+            + ((passw[i] && passh[i]) ? passh[i] * (1 + (passw[i] * bpp + 7) / 8) : 0);
+        /*bits padded if needed to fill full byte at end of each scanline*/
+        padded_passstart[i + 1] = padded_passstart[i] + passh[i] * ((passw[i] * bpp + 7) / 8);
+        /*only padded at end of reduced image*/
+        passstart[i + 1] = passstart[i] + (passh[i] * passw[i] * bpp + 7) / 8;
+    }
 }
 
 #ifdef LODEPNG_COMPILE_DECODER
@@ -3896,174 +5283,266 @@ static void Adam7_getpassvalues(unsigned passw[7], unsigned passh[7], size_t fil
 
 /*read the information from the header and store it in the LodePNGInfo. return value is error*/
 unsigned lodepng_inspect(unsigned* w, unsigned* h, LodePNGState* state,
-	const unsigned char* in, size_t insize)
-{
-	LodePNGInfo* info = &state->info_png;
-	if (insize == 0 || in == 0)
-	{
-		CERROR_RETURN_ERROR(state->error, 48); /*error: the given data is empty*/
-	}
-	if (insize < 33)
-	{
-		CERROR_RETURN_ERROR(state->error, 27); /*error: the data length is smaller than the length of a PNG header*/
-	}
-
-	/*when decoding a new PNG image, make sure all parameters created after previous decoding are reset*/
-	lodepng_info_cleanup(info);
-	lodepng_info_init(info);
-
-	if (in[0] != 137 || in[1] != 80 || in[2] != 78 || in[3] != 71
-		|| in[4] != 13 || in[5] != 10 || in[6] != 26 || in[7] != 10)
-	{
-		CERROR_RETURN_ERROR(state->error, 28); /*error: the first 8 bytes are not the correct PNG signature*/
-	}
-	if (lodepng_chunk_length(in + 8) != 13)
-	{
-		CERROR_RETURN_ERROR(state->error, 94); /*error: header size must be 13 bytes*/
-	}
-	if (!lodepng_chunk_type_equals(in + 8, "IHDR"))
-	{
-		CERROR_RETURN_ERROR(state->error, 29); /*error: it doesn't start with a IHDR chunk!*/
-	}
-
-	/*read the values given in the header*/
-	*w = lodepng_read32bitInt(&in[16]);
-	*h = lodepng_read32bitInt(&in[20]);
-	info->color.bitdepth = in[24];
-	info->color.colortype = (LodePNGColorType)in[25];
-	info->compression_method = in[26];
-	info->filter_method = in[27];
-	info->interlace_method = in[28];
-
-	if (*w == 0 || *h == 0)
-	{
-		CERROR_RETURN_ERROR(state->error, 93);
-	}
-
-	if (!state->decoder.ignore_crc)
-	{
-		unsigned CRC = lodepng_read32bitInt(&in[29]);
-		unsigned checksum = lodepng_crc32(&in[12], 17);
-		if (CRC != checksum)
-		{
-			CERROR_RETURN_ERROR(state->error, 57); /*invalid CRC*/
-		}
-	}
-
-	/*error: only compression method 0 is allowed in the specification*/
-	if (info->compression_method != 0) CERROR_RETURN_ERROR(state->error, 32);
-	/*error: only filter method 0 is allowed in the specification*/
-	if (info->filter_method != 0) CERROR_RETURN_ERROR(state->error, 33);
-	/*error: only interlace methods 0 and 1 exist in the specification*/
-	if (info->interlace_method > 1) CERROR_RETURN_ERROR(state->error, 34);
-
-	state->error = checkColorValidity(info->color.colortype, info->color.bitdepth);
-	return state->error;
+    const unsigned char* in, size_t insize)
+{
+    LodePNGInfo* info = &state->info_png;
+    if (insize == 0 || in == 0)
+    {
+        CERROR_RETURN_ERROR(state->error, 48); /*error: the given data is empty*/
+    }
+    if (insize < 33)
+    {
+        CERROR_RETURN_ERROR(state->error, 27); /*error: the data length is smaller than the length of a PNG header*/
+    }
+
+    /*when decoding a new PNG image, make sure all parameters created after previous decoding are reset*/
+    lodepng_info_cleanup(info);
+    lodepng_info_init(info);
+
+    if (in[0] != 137 || in[1] != 80 || in[2] != 78 || in[3] != 71
+        || in[4] != 13 || in[5] != 10 || in[6] != 26 || in[7] != 10)
+    {
+        CERROR_RETURN_ERROR(state->error, 28); /*error: the first 8 bytes are not the correct PNG signature*/
+    }
+    if (lodepng_chunk_length(in + 8) != 13)
+    {
+        CERROR_RETURN_ERROR(state->error, 94); /*error: header size must be 13 bytes*/
+    }
+    if (!lodepng_chunk_type_equals(in + 8, "IHDR"))
+    {
+        CERROR_RETURN_ERROR(state->error, 29); /*error: it doesn't start with a IHDR chunk!*/
+    }
+
+    /*read the values given in the header*/
+    *w = lodepng_read32bitInt(&in[16]);
+    *h = lodepng_read32bitInt(&in[20]);
+    info->color.bitdepth = in[24];
+    info->color.colortype = (LodePNGColorType)in[25];
+    info->compression_method = in[26];
+    info->filter_method = in[27];
+    info->interlace_method = in[28];
+
+    if (*w == 0 || *h == 0)
+    {
+        CERROR_RETURN_ERROR(state->error, 93);
+    }
+
+    if (!state->decoder.ignore_crc)
+    {
+        unsigned CRC = lodepng_read32bitInt(&in[29]);
+        unsigned checksum = lodepng_crc32(&in[12], 17);
+        if (CRC != checksum)
+        {
+            CERROR_RETURN_ERROR(state->error, 57); /*invalid CRC*/
+        }
+    }
+
+    /*error: only compression method 0 is allowed in the specification*/
+    if (info->compression_method != 0) CERROR_RETURN_ERROR(state->error, 32);
+    /*error: only filter method 0 is allowed in the specification*/
+    if (info->filter_method != 0) CERROR_RETURN_ERROR(state->error, 33);
+    /*error: only interlace methods 0 and 1 exist in the specification*/
+    if (info->interlace_method > 1) CERROR_RETURN_ERROR(state->error, 34);
+
+    state->error = checkColorValidity(info->color.colortype, info->color.bitdepth);
+    return state->error;
+}
+
+#ifdef LODEPNG_X86_SIMD
+/*loads the bytes of one pixel of 3, 4, 6 or 8 bytes into the low bytes of a vector*/
+__attribute__((target("sse2")))
+static __m128i loadPixelSSE2(const unsigned char* pixel, size_t bytewidth)
+{
+    unsigned low, high = 0;
+    if (bytewidth == 3) low = pixel[0] | ((unsigned)pixel[1] << 8u) | ((unsigned)pixel[2] << 16u);
+    else
+    {
+        memcpy(&low, pixel, 4);
+        if (bytewidth == 6) high = pixel[4] | ((unsigned)pixel[5] << 8u);
+        else if (bytewidth == 8) memcpy(&high, pixel + 4, 4);
+    }
+    return _mm_unpacklo_epi32(_mm_cvtsi32_si128((int)low), _mm_cvtsi32_si128((int)high));
+}
+
+/*stores the low bytewidth bytes of a vector as one pixel of 3, 4, 6 or 8 bytes*/
+__attribute__((target("sse2")))
+static void storePixelSSE2(unsigned char* pixel, __m128i value, size_t bytewidth)
+{
+    unsigned low = (unsigned)_mm_cvtsi128_si32(value);
+    unsigned high = (unsigned)_mm_cvtsi128_si32(_mm_srli_si128(value, 4));
+    if (bytewidth == 3)
+    {
+        pixel[0] = (unsigned char)low;
+        pixel[1] = (unsigned char)(low >> 8u);
+        pixel[2] = (unsigned char)(low >> 16u);
+    }
+    else
+    {
+        memcpy(pixel, &low, 4);
+        if (bytewidth == 6)
+        {
+            pixel[4] = (unsigned char)high;
+            pixel[5] = (unsigned char)(high >> 8u);
+        }
+        else if (bytewidth == 8) memcpy(pixel + 4, &high, 4);
+    }
 }
 
+/*
+Unfilters an Average or Paeth scanline with 3, 4, 6 or 8 bytes per pixel. Every byte depends on the byte
+one pixel to the left, so a whole pixel is reconstructed at once instead of one byte at a time.
+*/
+__attribute__((target("sse2")))
+static void unfilterScanlineSSE2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+    size_t bytewidth, unsigned char filterType, size_t length)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i left = zero, upleft = zero; /*the pixel to the left is 0 for the first pixel, like the one above it*/
+    size_t i;
+    for (i = 0; i + bytewidth <= length; i += bytewidth)
+    {
+        __m128i current = loadPixelSSE2(&scanline[i], bytewidth);
+        __m128i up = precon ? loadPixelSSE2(&precon[i], bytewidth) : zero;
+        if (filterType == 3)
+        {
+            /*_mm_avg_epu8 rounds up, the filter rounds down*/
+            current = _mm_add_epi8(current, _mm_sub_epi8(_mm_avg_epu8(left, up), _mm_and_si128(_mm_xor_si128(left, up), one)));
+        }
+        else
+        {
+            __m128i paeth = paethPredictorSSE2(_mm_unpacklo_epi8(left, zero), _mm_unpacklo_epi8(up, zero), _mm_unpacklo_epi8(upleft, zero));
+            current = _mm_add_epi8(current, _mm_packus_epi16(paeth, zero));
+        }
+        storePixelSSE2(&recon[i], current, bytewidth);
+        left = current;
+        upleft = up;
+    }
+}
+#endif /*LODEPNG_X86_SIMD*/
+
 static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
-	size_t bytewidth, unsigned char filterType, size_t length)
-{
-	/*
-	For PNG filter method 0
-	unfilter a PNG image scanline by scanline. when the pixels are smaller than 1 byte,
-	the filter works byte per byte (bytewidth = 1)
-	precon is the previous unfiltered scanline, recon the result, scanline the current one
-	the incoming scanlines do NOT include the filtertype byte, that one is given in the parameter filterType instead
-	recon and scanline MAY be the same memory address! precon must be disjoint.
-	*/
-
-	size_t i;
-	switch (filterType)
-	{
-	case 0:
-		for (i = 0; i != length; ++i) recon[i] = scanline[i];
-		break;
-	case 1:
-		for (i = 0; i != bytewidth; ++i) recon[i] = scanline[i];
-		for (i = bytewidth; i < length; ++i) recon[i] = scanline[i] + recon[i - bytewidth];
-		break;
-	case 2:
-		if (precon)
-		{
-			for (i = 0; i != length; ++i) recon[i] = scanline[i] + precon[i];
-		}
-		else
-		{
-			for (i = 0; i != length; ++i) recon[i] = scanline[i];
-		}
-		break;
-	case 3:
-		if (precon)
-		{
-			for (i = 0; i != bytewidth; ++i) recon[i] = scanline[i] + (precon[i] >> 1);
-			for (i = bytewidth; i < length; ++i) recon[i] = scanline[i] + ((recon[i - bytewidth] + precon[i]) >> 1);
-		}
-		else
-		{
-			for (i = 0; i != bytewidth; ++i) recon[i] = scanline[i];
-			for (i = bytewidth; i < length; ++i) recon[i] = scanline[i] + (recon[i - bytewidth] >> 1);
-		}
-		break;
-	case 4:
-		if (precon)
-		{
-			for (i = 0; i != bytewidth; ++i)
-			{
-				recon[i] = (scanline[i] + precon[i]); /*paethPredictor(0, precon[i], 0) is always precon[i]*/
-			}
-			for (i = bytewidth; i < length; ++i)
-			{
-				recon[i] = (scanline[i] + paethPredictor(recon[i - bytewidth], precon[i], precon[i - bytewidth]));
-			}
-		}
-		else
-		{
-			for (i = 0; i != bytewidth; ++i)
-			{
-				recon[i] = scanline[i];
-			}
-			for (i = bytewidth; i < length; ++i)
-			{
-				/*paethPredictor(recon[i - bytewidth], 0, 0) is always recon[i - bytewidth]*/
-				recon[i] = (scanline[i] + recon[i - bytewidth]);
-			}
-		}
-		break;
-	default: return 36; /*error: unexisting filter type given*/
-	}
-	return 0;
+    size_t bytewidth, unsigned char filterType, size_t length)
+{
+    /*
+    For PNG filter method 0
+    unfilter a PNG image scanline by scanline. when the pixels are smaller than 1 byte,
+    the filter works byte per byte (bytewidth = 1)
+    precon is the previous unfiltered scanline, recon the result, scanline the current one
+    the incoming scanlines do NOT include the filtertype byte, that one is given in the parameter filterType instead
+    recon and scanline MAY be the same memory address! precon must be disjoint.
+    */
+
+    size_t i;
+#ifdef LODEPNG_X86_SIMD
+    if ((filterType == 3 || filterType == 4) && (bytewidth == 3 || bytewidth == 4 || bytewidth == 6 || bytewidth == 8)
+        && __builtin_cpu_supports("sse2"))
+    {
+        unfilterScanlineSSE2(recon, scanline, precon, bytewidth, filterType, length);
+        return 0;
+    }
+#endif /*LODEPNG_X86_SIMD*/
+    switch (filterType)
+    {
+    case 0:
+        for (i = 0; i != length; ++i) recon[i] = scanline[i];
+        break;
+    case 1:
+        for (i = 0; i != bytewidth; ++i) recon[i] = scanline[i];
+        for (i = bytewidth; i < length; ++i) recon[i] = scanline[i] + recon[i - bytewidth];
+        break;
+    case 2:
+        if (precon)
+        {
+            for (i = 0; i != length; ++i) recon[i] = scanline[i] + precon[i];
+        }
+        else
+        {
+            for (i = 0; i != length; ++i) recon[i] = scanline[i];
+        }
+        break;
+    case 3:
+        if (precon)
+        {
+            for (i = 0; i != bytewidth; ++i) recon[i] = scanline[i] + (precon[i] >> 1);
+            for (i = bytewidth; i < length; ++i) recon[i] = scanline[i] + ((recon[i - bytewidth] + precon[i]) >> 1);
+        }
+        else
+        {
+            for (i = 0; i != bytewidth; ++i) recon[i] = scanline[i];
+            for (i = bytewidth; i < length; ++i) recon[i] = scanline[i] + (recon[i - bytewidth] >> 1);
+        }
+        break;
+    case 4:
+        if (precon)
+        {
+            for (i = 0; i != bytewidth; ++i)
+            {
+                recon[i] = (scanline[i] + precon[i]); /*paethPredictor(0, precon[i], 0) is always precon[i]*/
+            }
+            for (i = bytewidth; i < length; ++i)
+            {
+                recon[i] = (scanline[i] + paethPredictor(recon[i - bytewidth], precon[i], precon[i - bytewidth]));
+            }
+        }
+        else
+        {
+            for (i = 0; i != bytewidth; ++i)
+            {
+                recon[i] = scanline[i];
+            }
+            for (i = bytewidth; i < length; ++i)
+            {
+                /*paethPredictor(recon[i - bytewidth], 0, 0) is always recon[i - bytewidth]*/
+                recon[i] = (scanline[i] + recon[i - bytewidth]);
+            }
+        }
+        break;
+    default: return 36; /*error: unexisting filter type given*/
+    }
+    return 0;
 }
 
 static unsigned unfilter(unsigned char* out, const unsigned char* in, unsigned w, unsigned h, unsigned bpp)
 {
-	/*
-	For PNG filter method 0
-	this function unfilters a single image (e.g. without interlacing this is called once, with Adam7 seven times)
-	out must have enough bytes allocated already, in must have the scanlines + 1 filtertype byte per scanline
-	w and h are image dimensions or dimensions of reduced image, bpp is bits per pixel
-	in and out are allowed to be the same memory address (but aren't the same size since in has the extra filter bytes)
-	*/
+    /*
+    For PNG filter method 0
+    this function unfilters a single image (e.g. without interlacing this is called once, with Adam7 seven times)
+    out must have enough bytes allocated already, in must have the scanlines + 1 filtertype byte per scanline
+    w and h are image dimensions or dimensions of reduced image, bpp is bits per pixel
+    in and out are allowed to be the same memory address (but aren't the same size since in has the extra filter bytes)
+    */
 
-	unsigned y;
-	unsigned char* prevline = 0;
+    unsigned y;
+    unsigned char* prevline = 0;
 
-	/*bytewidth is used for filtering, is 1 when bpp < 8, number of bytes per pixel otherwise*/
-	size_t bytewidth = (bpp + 7) / 8;
-	size_t linebytes = (w * bpp + 7) / 8;
+    /*bytewidth is used for filtering, is 1 when bpp < 8, number of bytes per pixel otherwise*/
+    size_t bytewidth = (bpp + 7) / 8;
+    size_t linebytes = (w * bpp + 7) / 8;
 
-	for (y = 0; y < h; ++y)
-	{
-		size_t outindex = linebytes * y;
-		size_t inindex = (1 + linebytes) * y; /*the extra filterbyte added to each row*/
-		unsigned char filterType = in[inindex];
+    for (y = 0; y < h; ++y)
+    {
+        size_t outindex = linebytes * y;
+        size_t inindex = (1 + linebytes) * y; /*the extra filterbyte added to each row*/
+        unsigned char filterType = in[inindex];
 
-		CERROR_TRY_RETURN(unfilterScanline(&out[outindex], &in[inindex + 1], prevline, bytewidth, filterType, linebytes));
+        CERROR_TRY_RETURN(unfilterScanline(&out[outindex], &in[inindex + 1], prevline, bytewidth, filterType, linebytes));
 
-		prevline = &out[outindex];
-	}
+        prevline = &out[outindex];
+    }
 
-	return 0;
+    return 0;
+}
+
+/*x and y distance between the pixels that the first 1 to 7 passes together have*/
+static const unsigned ADAM7_REDUCED_DX[7] = { 8, 4, 4, 2, 2, 1, 1 };
+static const unsigned ADAM7_REDUCED_DY[7] = { 8, 8, 4, 4, 2, 2, 1 };
+
+void lodepng_adam7_reduced_size(unsigned* rw, unsigned* rh, unsigned w, unsigned h, unsigned passes)
+{
+    if (passes < 1 || passes > 7) passes = 7;
+    *rw = (w + ADAM7_REDUCED_DX[passes - 1] - 1) / ADAM7_REDUCED_DX[passes - 1];
+    *rh = (h + ADAM7_REDUCED_DY[passes - 1] - 1) / ADAM7_REDUCED_DY[passes - 1];
 }
 
 /*
@@ -4071,197 +5550,205 @@ in: Adam7 interlaced image, with no padding bits between scanlines, but between
 reduced images so that each reduced image starts at a byte.
 out: the same pixels, but re-ordered so that they're now a non-interlaced image with size w*h
 bpp: bits per pixel
-out has the following size in bits: w * h * bpp.
+passes: only the first passes are used, out then is the smaller image of lodepng_adam7_reduced_size
+out has the following size in bits: w * h * bpp, or the reduced size times bpp.
 in is possibly bigger due to padding bits between reduced images.
 out must be big enough AND must be 0 everywhere if bpp < 8 in the current implementation
 (because that's likely a little bit faster)
 NOTE: comments about padding bits are only relevant if bpp < 8
 */
-static void Adam7_deinterlace(unsigned char* out, const unsigned char* in, unsigned w, unsigned h, unsigned bpp)
-{
-	unsigned passw[7], passh[7];
-	size_t filter_passstart[8], padded_passstart[8], passstart[8];
-	unsigned i;
-
-	Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
-
-	if (bpp >= 8)
-	{
-		for (i = 0; i != 7; ++i)
-		{
-			unsigned x, y, b;
-			size_t bytewidth = bpp / 8;
-			for (y = 0; y < passh[i]; ++y)
-				for (x = 0; x < passw[i]; ++x)
-				{
-				size_t pixelinstart = passstart[i] + (y * passw[i] + x) * bytewidth;
-				size_t pixeloutstart = ((ADAM7_IY[i] + y * ADAM7_DY[i]) * w + ADAM7_IX[i] + x * ADAM7_DX[i]) * bytewidth;
-				for (b = 0; b < bytewidth; ++b)
-				{
-					out[pixeloutstart + b] = in[pixelinstart + b];
-				}
-				}
-		}
-	}
-	else /*bpp < 8: Adam7 with pixels < 8 bit is a bit trickier: with bit pointers*/
-	{
-		for (i = 0; i != 7; ++i)
-		{
-			unsigned x, y, b;
-			unsigned ilinebits = bpp * passw[i];
-			unsigned olinebits = bpp * w;
-			size_t obp, ibp; /*bit pointers (for out and in buffer)*/
-			for (y = 0; y < passh[i]; ++y)
-				for (x = 0; x < passw[i]; ++x)
-				{
-				ibp = (8 * passstart[i]) + (y * ilinebits + x * bpp);
-				obp = (ADAM7_IY[i] + y * ADAM7_DY[i]) * olinebits + (ADAM7_IX[i] + x * ADAM7_DX[i]) * bpp;
-				for (b = 0; b < bpp; ++b)
-				{
-					unsigned char bit = readBitFromReversedStream(&ibp, in);
-					/*note that this function assumes the out buffer is completely 0, use setBitOfReversedStream otherwise*/
-					setBitOfReversedStream0(&obp, out, bit);
-				}
-				}
-		}
-	}
+static void Adam7_deinterlace(unsigned char* out, const unsigned char* in, unsigned w, unsigned h, unsigned bpp,
+    unsigned passes)
+{
+    unsigned passw[7], passh[7];
+    size_t filter_passstart[8], padded_passstart[8], passstart[8];
+    unsigned i;
+    /*the pixels of the first passes are every rdx-th pixel of every rdy-th row, out only has those*/
+    unsigned rdx = ADAM7_REDUCED_DX[passes - 1], rdy = ADAM7_REDUCED_DY[passes - 1];
+    unsigned ow = (w + rdx - 1) / rdx;
+
+    Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
+
+    if (bpp >= 8)
+    {
+        for (i = 0; i != passes; ++i)
+        {
+            unsigned x, y, b;
+            size_t bytewidth = bpp / 8;
+            unsigned ix = ADAM7_IX[i] / rdx, iy = ADAM7_IY[i] / rdy, dx = ADAM7_DX[i] / rdx, dy = ADAM7_DY[i] / rdy;
+            for (y = 0; y < passh[i]; ++y)
+                for (x = 0; x < passw[i]; ++x)
+                {
+                size_t pixelinstart = passstart[i] + (y * passw[i] + x) * bytewidth;
+                size_t pixeloutstart = ((iy + y * dy) * ow + ix + x * dx) * bytewidth;
+                for (b = 0; b < bytewidth; ++b)
+                {
+                    out[pixeloutstart + b] = in[pixelinstart + b];
+                }
+                }
+        }
+    }
+    else /*bpp < 8: Adam7 with pixels < 8 bit is a bit trickier: with bit pointers*/
+    {
+        for (i = 0; i != passes; ++i)
+        {
+            unsigned x, y, b;
+            unsigned ilinebits = bpp * passw[i];
+            unsigned olinebits = bpp * ow;
+            unsigned ix = ADAM7_IX[i] / rdx, iy = ADAM7_IY[i] / rdy, dx = ADAM7_DX[i] / rdx, dy = ADAM7_DY[i] / rdy;
+            size_t obp, ibp; /*bit pointers (for out and in buffer)*/
+            for (y = 0; y < passh[i]; ++y)
+                for (x = 0; x < passw[i]; ++x)
+                {
+                ibp = (8 * passstart[i]) + (y * ilinebits + x * bpp);
+                obp = (iy + y * dy) * olinebits + (ix + x * dx) * bpp;
+                for (b = 0; b < bpp; ++b)
+                {
+                    unsigned char bit = readBitFromReversedStream(&ibp, in);
+                    /*note that this function assumes the out buffer is completely 0, use setBitOfReversedStream otherwise*/
+                    setBitOfReversedStream0(&obp, out, bit);
+                }
+                }
+        }
+    }
 }
 
 static void removePaddingBits(unsigned char* out, const unsigned char* in,
-	size_t olinebits, size_t ilinebits, unsigned h)
-{
-	/*
-	After filtering there are still padding bits if scanlines have non multiple of 8 bit amounts. They need
-	to be removed (except at last scanline of (Adam7-reduced) image) before working with pure image buffers
-	for the Adam7 code, the color convert code and the output to the user.
-	in and out are allowed to be the same buffer, in may also be higher but still overlapping; in must
-	have >= ilinebits*h bits, out must have >= olinebits*h bits, olinebits must be <= ilinebits
-	also used to move bits after earlier such operations happened, e.g. in a sequence of reduced images from Adam7
-	only useful if (ilinebits - olinebits) is a value in the range 1..7
-	*/
-	unsigned y;
-	size_t diff = ilinebits - olinebits;
-	size_t ibp = 0, obp = 0; /*input and output bit pointers*/
-	for (y = 0; y < h; ++y)
-	{
-		size_t x;
-		for (x = 0; x < olinebits; ++x)
-		{
-			unsigned char bit = readBitFromReversedStream(&ibp, in);
-			setBitOfReversedStream(&obp, out, bit);
-		}
-		ibp += diff;
-	}
+    size_t olinebits, size_t ilinebits, unsigned h)
+{
+    /*
+    After filtering there are still padding bits if scanlines have non multiple of 8 bit amounts. They need
+    to be removed (except at last scanline of (Adam7-reduced) image) before working with pure image buffers
+    for the Adam7 code, the color convert code and the output to the user.
+    in and out are allowed to be the same buffer, in may also be higher but still overlapping; in must
+    have >= ilinebits*h bits, out must have >= olinebits*h bits, olinebits must be <= ilinebits
+    also used to move bits after earlier such operations happened, e.g. in a sequence of reduced images from Adam7
+    only useful if (ilinebits - olinebits) is a value in the range 1..7
+    */
+    unsigned y;
+    size_t diff = ilinebits - olinebits;
+    size_t ibp = 0, obp = 0; /*input and output bit pointers*/
+    for (y = 0; y < h; ++y)
+    {
+        size_t x;
+        for (x = 0; x < olinebits; ++x)
+        {
+            unsigned char bit = readBitFromReversedStream(&ibp, in);
+            setBitOfReversedStream(&obp, out, bit);
+        }
+        ibp += diff;
+    }
 }
 
 /*out must be buffer big enough to contain full image, and in must contain the full decompressed data from
-the IDAT chunks (with filter index bytes and possible padding bits)
+the IDAT chunks (with filter index bytes and possible padding bits). For Adam7 interlaced images only the
+first passes are used, in then only needs their data and out only gets the reduced image
 return value is error*/
 static unsigned postProcessScanlines(unsigned char* out, unsigned char* in,
-	unsigned w, unsigned h, const LodePNGInfo* info_png)
-{
-	/*
-	This function converts the filtered-padded-interlaced data into pure 2D image buffer with the PNG's colortype.
-	Steps:
-	*) if no Adam7: 1) unfilter 2) remove padding bits (= posible extra bits per scanline if bpp < 8)
-	*) if adam7: 1) 7x unfilter 2) 7x remove padding bits 3) Adam7_deinterlace
-	NOTE: the in buffer will be overwritten with intermediate data!
-	*/
-	unsigned bpp = lodepng_get_bpp(&info_png->color);
-	if (bpp == 0) return 31; /*error: invalid colortype*/
-
-	if (info_png->interlace_method == 0)
-	{
-		if (bpp < 8 && w * bpp != ((w * bpp + 7) / 8) * 8)
-		{
-			CERROR_TRY_RETURN(unfilter(in, in, w, h, bpp));
-			removePaddingBits(out, in, w * bpp, ((w * bpp + 7) / 8) * 8, h);
-		}
-		/*we can immediately filter into the out buffer, no other steps needed*/
-		else CERROR_TRY_RETURN(unfilter(out, in, w, h, bpp));
-	}
-	else /*interlace_method is 1 (Adam7)*/
-	{
-		unsigned passw[7], passh[7]; size_t filter_passstart[8], padded_passstart[8], passstart[8];
-		unsigned i;
-
-		Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
-
-		for (i = 0; i != 7; ++i)
-		{
-			CERROR_TRY_RETURN(unfilter(&in[padded_passstart[i]], &in[filter_passstart[i]], passw[i], passh[i], bpp));
-			/*TODO: possible efficiency improvement: if in this reduced image the bits fit nicely in 1 scanline,
-			move bytes instead of bits or move not at all*/
-			if (bpp < 8)
-			{
-				/*remove padding bits in scanlines; after this there still may be padding
-				bits between the different reduced images: each reduced image still starts nicely at a byte*/
-				removePaddingBits(&in[passstart[i]], &in[padded_passstart[i]], passw[i] * bpp,
-					((passw[i] * bpp + 7) / 8) * 8, passh[i]);
-			}
-		}
-
-		Adam7_deinterlace(out, in, w, h, bpp);
-	}
-
-	return 0;
+    unsigned w, unsigned h, const LodePNGInfo* info_png, unsigned passes)
+{
+    /*
+    This function converts the filtered-padded-interlaced data into pure 2D image buffer with the PNG's colortype.
+    Steps:
+    *) if no Adam7: 1) unfilter 2) remove padding bits (= posible extra bits per scanline if bpp < 8)
+    *) if adam7: 1) 7x unfilter 2) 7x remove padding bits 3) Adam7_deinterlace
+    NOTE: the in buffer will be overwritten with intermediate data!
+    */
+    unsigned bpp = lodepng_get_bpp(&info_png->color);
+    if (bpp == 0) return 31; /*error: invalid colortype*/
+
+    if (info_png->interlace_method == 0)
+    {
+        if (bpp < 8 && w * bpp != ((w * bpp + 7) / 8) * 8)
+        {
+            CERROR_TRY_RETURN(unfilter(in, in, w, h, bpp));
+            removePaddingBits(out, in, w * bpp, ((w * bpp + 7) / 8) * 8, h);
+        }
+        /*we can immediately filter into the out buffer, no other steps needed*/
+        else CERROR_TRY_RETURN(unfilter(out, in, w, h, bpp));
+    }
+    else /*interlace_method is 1 (Adam7)*/
+    {
+        unsigned passw[7], passh[7]; size_t filter_passstart[8], padded_passstart[8], passstart[8];
+        unsigned i;
+
+        Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
+
+        for (i = 0; i != passes; ++i)
+        {
+            CERROR_TRY_RETURN(unfilter(&in[padded_passstart[i]], &in[filter_passstart[i]], passw[i], passh[i], bpp));
+            /*TODO: possible efficiency improvement: if in this reduced image the bits fit nicely in 1 scanline,
+            move bytes instead of bits or move not at all*/
+            if (bpp < 8)
+            {
+                /*remove padding bits in scanlines; after this there still may be padding
+                bits between the different reduced images: each reduced image still starts nicely at a byte*/
+                removePaddingBits(&in[passstart[i]], &in[padded_passstart[i]], passw[i] * bpp,
+                    ((passw[i] * bpp + 7) / 8) * 8, passh[i]);
+            }
+        }
+
+        Adam7_deinterlace(out, in, w, h, bpp, passes);
+    }
+
+    return 0;
 }
 
 static unsigned readChunk_PLTE(LodePNGColorMode* color, const unsigned char* data, size_t chunkLength)
 {
-	unsigned pos = 0, i;
-	if (color->palette) lodepng_free(color->palette);
-	color->palettesize = chunkLength / 3;
-	color->palette = (unsigned char*)lodepng_malloc(4 * color->palettesize);
-	if (!color->palette && color->palettesize)
-	{
-		color->palettesize = 0;
-		return 83; /*alloc fail*/
-	}
-	if (color->palettesize > 256) return 38; /*error: palette too big*/
+    unsigned pos = 0, i;
+    if (color->palette) lodepng_free(color->palette);
+    color->palettesize = chunkLength / 3;
+    color->palette = (unsigned char*)lodepng_malloc(4 * color->palettesize);
+    if (!color->palette && color->palettesize)
+    {
+        color->palettesize = 0;
+        return 83; /*alloc fail*/
+    }
+    if (color->palettesize > 256) return 38; /*error: palette too big*/
 
-	for (i = 0; i != color->palettesize; ++i)
-	{
-		color->palette[4 * i + 0] = data[pos++]; /*R*/
-		color->palette[4 * i + 1] = data[pos++]; /*G*/
-		color->palette[4 * i + 2] = data[pos++]; /*B*/
-		color->palette[4 * i + 3] = 255; /*alpha*/
-	}
+    for (i = 0; i != color->palettesize; ++i)
+    {
+        color->palette[4 * i + 0] = data[pos++]; /*R*/
+        color->palette[4 * i + 1] = data[pos++]; /*G*/
+        color->palette[4 * i + 2] = data[pos++]; /*B*/
+        color->palette[4 * i + 3] = 255; /*alpha*/
+    }
 
-	return 0; /* OK */
+    return 0; /* OK */
 }
 
 static unsigned readChunk_tRNS(LodePNGColorMode* color, const unsigned char* data, size_t chunkLength)
 {
-	unsigned i;
-	if (color->colortype == LCT_PALETTE)
-	{
-		/*error: more alpha values given than there are palette entries*/
-		if (chunkLength > color->palettesize) return 38;
+    unsigned i;
+    if (color->colortype == LCT_PALETTE)
+    {
+        /*error: more alpha values given than there are palette entries*/
+        if (chunkLength > color->palettesize) return 38;
 
-		for (i = 0; i != chunkLength; ++i) color->palette[4 * i + 3] = data[i];
-	}
-	else if (color->colortype == LCT_GREY)
-	{
-		/*error: this chunk must be 2 bytes for greyscale image*/
-		if (chunkLength != 2) return 30;
+        for (i = 0; i != chunkLength; ++i) color->palette[4 * i + 3] = data[i];
+    }
+    else if (color->colortype == LCT_GREY)
+    {
+        /*error: this chunk must be 2 bytes for greyscale image*/
+        if (chunkLength != 2) return 30;
 
-		color->key_defined = 1;
-		color->key_r = color->key_g = color->key_b = 256u * data[0] + data[1];
-	}
-	else if (color->colortype == LCT_RGB)
-	{
-		/*error: this chunk must be 6 bytes for RGB image*/
-		if (chunkLength != 6) return 41;
+        color->key_defined = 1;
+        color->key_r = color->key_g = color->key_b = 256u * data[0] + data[1];
+    }
+    else if (color->colortype == LCT_RGB)
+    {
+        /*error: this chunk must be 6 bytes for RGB image*/
+        if (chunkLength != 6) return 41;
 
-		color->key_defined = 1;
-		color->key_r = 256u * data[0] + data[1];
-		color->key_g = 256u * data[2] + data[3];
-		color->key_b = 256u * data[4] + data[5];
-	}
-	else return 42; /*error: tRNS chunk not allowed for other color models*/
+        color->key_defined = 1;
+        color->key_r = 256u * data[0] + data[1];
+        color->key_g = 256u * data[2] + data[3];
+        color->key_b = 256u * data[4] + data[5];
+    }
+    else return 42; /*error: tRNS chunk not allowed for other color models*/
 
-	return 0; /* OK */
+    return 0; /* OK */
 }
 
 
@@ -4269,553 +5756,810 @@ static unsigned readChunk_tRNS(LodePNGColorMode* color, const unsigned char* dat
 /*background color chunk (bKGD)*/
 static unsigned readChunk_bKGD(LodePNGInfo* info, const unsigned char* data, size_t chunkLength)
 {
-	if (info->color.colortype == LCT_PALETTE)
-	{
-		/*error: this chunk must be 1 byte for indexed color image*/
-		if (chunkLength != 1) return 43;
+    if (info->color.colortype == LCT_PALETTE)
+    {
+        /*error: this chunk must be 1 byte for indexed color image*/
+        if (chunkLength != 1) return 43;
 
-		info->background_defined = 1;
-		info->background_r = info->background_g = info->background_b = data[0];
-	}
-	else if (info->color.colortype == LCT_GREY || info->color.colortype == LCT_GREY_ALPHA)
-	{
-		/*error: this chunk must be 2 bytes for greyscale image*/
-		if (chunkLength != 2) return 44;
+        info->background_defined = 1;
+        info->background_r = info->background_g = info->background_b = data[0];
+    }
+    else if (info->color.colortype == LCT_GREY || info->color.colortype == LCT_GREY_ALPHA)
+    {
+        /*error: this chunk must be 2 bytes for greyscale image*/
+        if (chunkLength != 2) return 44;
 
-		info->background_defined = 1;
-		info->background_r = info->background_g = info->background_b = 256u * data[0] + data[1];
-	}
-	else if (info->color.colortype == LCT_RGB || info->color.colortype == LCT_RGBA)
-	{
-		/*error: this chunk must be 6 bytes for greyscale image*/
-		if (chunkLength != 6) return 45;
+        info->background_defined = 1;
+        info->background_r = info->background_g = info->background_b = 256u * data[0] + data[1];
+    }
+    else if (info->color.colortype == LCT_RGB || info->color.colortype == LCT_RGBA)
+    {
+        /*error: this chunk must be 6 bytes for greyscale image*/
+        if (chunkLength != 6) return 45;
 
-		info->background_defined = 1;
-		info->background_r = 256u * data[0] + data[1];
-		info->background_g = 256u * data[2] + data[3];
-		info->background_b = 256u * data[4] + data[5];
-	}
+        info->background_defined = 1;
+        info->background_r = 256u * data[0] + data[1];
+        info->background_g = 256u * data[2] + data[3];
+        info->background_b = 256u * data[4] + data[5];
+    }
 
-	return 0; /* OK */
+    return 0; /* OK */
 }
 
 /*text chunk (tEXt)*/
 static unsigned readChunk_tEXt(LodePNGInfo* info, const unsigned char* data, size_t chunkLength)
 {
-	unsigned error = 0;
-	char *key = 0, *str = 0;
-	unsigned i;
+    unsigned error = 0;
+    char *key = 0, *str = 0;
+    unsigned i;
 
-	while (!error) /*not really a while loop, only used to break on error*/
-	{
-		unsigned length, string2_begin;
+    while (!error) /*not really a while loop, only used to break on error*/
+    {
+        unsigned length, string2_begin;
 
-		length = 0;
-		while (length < chunkLength && data[length] != 0) ++length;
-		/*even though it's not allowed by the standard, no error is thrown if
-		there's no null termination char, if the text is empty*/
-		if (length < 1 || length > 79) CERROR_BREAK(error, 89); /*keyword too short or long*/
+        length = 0;
+        while (length < chunkLength && data[length] != 0) ++length;
+        /*even though it's not allowed by the standard, no error is thrown if
+        there's no null termination char, if the text is empty*/
+        if (length < 1 || length > 79) CERROR_BREAK(error, 89); /*keyword too short or long*/
 
-		key = (char*)lodepng_malloc(length + 1);
-		if (!key) CERROR_BREAK(error, 83); /*alloc fail*/
+        key = (char*)lodepng_malloc(length + 1);
+        if (!key) CERROR_BREAK(error, 83); /*alloc fail*/
 
-		key[length] = 0;
-		for (i = 0; i != length; ++i) key[i] = (char)data[i];
+        key[length] = 0;
+        for (i = 0; i != length; ++i) key[i] = (char)data[i];
 
-		string2_begin = length + 1; /*skip keyword null terminator*/
+        string2_begin = length + 1; /*skip keyword null terminator*/
 
-		length = chunkLength < string2_begin ? 0 : chunkLength - string2_begin;
-		str = (char*)lodepng_malloc(length + 1);
-		if (!str) CERROR_BREAK(error, 83); /*alloc fail*/
+        length = chunkLength < string2_begin ? 0 : chunkLength - string2_begin;
+        str = (char*)lodepng_malloc(length + 1);
+        if (!str) CERROR_BREAK(error, 83); /*alloc fail*/
 
-		str[length] = 0;
-		for (i = 0; i != length; ++i) str[i] = (char)data[string2_begin + i];
+        str[length] = 0;
+        for (i = 0; i != length; ++i) str[i] = (char)data[string2_begin + i];
 
-		error = lodepng_add_text(info, key, str);
+        error = lodepng_add_text(info, key, str);
 
-		break;
-	}
+        break;
+    }
 
-	lodepng_free(key);
-	lodepng_free(str);
+    lodepng_free(key);
+    lodepng_free(str);
 
-	return error;
+    return error;
 }
 
 /*compressed text chunk (zTXt)*/
 static unsigned readChunk_zTXt(LodePNGInfo* info, const LodePNGDecompressSettings* zlibsettings,
-	const unsigned char* data, size_t chunkLength)
+    const unsigned char* data, size_t chunkLength)
 {
-	unsigned error = 0;
-	unsigned i;
+    unsigned error = 0;
+    unsigned i;
 
-	unsigned length, string2_begin;
-	char *key = 0;
-	ucvector decoded;
+    unsigned length, string2_begin;
+    char *key = 0;
+    ucvector decoded;
 
-	ucvector_init(&decoded);
+    ucvector_init(&decoded);
 
-	while (!error) /*not really a while loop, only used to break on error*/
-	{
-		for (length = 0; length < chunkLength && data[length] != 0; ++length);
-		if (length + 2 >= chunkLength) CERROR_BREAK(error, 75); /*no null termination, corrupt?*/
-		if (length < 1 || length > 79) CERROR_BREAK(error, 89); /*keyword too short or long*/
+    while (!error) /*not really a while loop, only used to break on error*/
+    {
+        for (length = 0; length < chunkLength && data[length] != 0; ++length);
+        if (length + 2 >= chunkLength) CERROR_BREAK(error, 75); /*no null termination, corrupt?*/
+        if (length < 1 || length > 79) CERROR_BREAK(error, 89); /*keyword too short or long*/
 
-		key = (char*)lodepng_malloc(length + 1);
-		if (!key) CERROR_BREAK(error, 83); /*alloc fail*/
+        key = (char*)lodepng_malloc(length + 1);
+        if (!key) CERROR_BREAK(error, 83); /*alloc fail*/
 
-		key[length] = 0;
-		for (i = 0; i != length; ++i) key[i] = (char)data[i];
+        key[length] = 0;
+        for (i = 0; i != length; ++i) key[i] = (char)data[i];
 
-		if (data[length + 1] != 0) CERROR_BREAK(error, 72); /*the 0 byte indicating compression must be 0*/
+        if (data[length + 1] != 0) CERROR_BREAK(error, 72); /*the 0 byte indicating compression must be 0*/
 
-		string2_begin = length + 2;
-		if (string2_begin > chunkLength) CERROR_BREAK(error, 75); /*no null termination, corrupt?*/
+        string2_begin = length + 2;
+        if (string2_begin > chunkLength) CERROR_BREAK(error, 75); /*no null termination, corrupt?*/
 
-		length = chunkLength - string2_begin;
-		/*will fail if zlib error, e.g. if length is too small*/
-		error = zlib_decompress(&decoded.data, &decoded.size,
-			(unsigned char*)(&data[string2_begin]),
-			length, zlibsettings);
-		if (error) break;
-		ucvector_push_back(&decoded, 0);
+        length = chunkLength - string2_begin;
+        /*will fail if zlib error, e.g. if length is too small*/
+        error = zlib_decompress(&decoded.data, &decoded.size,
+            (unsigned char*)(&data[string2_begin]),
+            length, zlibsettings);
+        if (error) break;
+        ucvector_push_back(&decoded, 0);
 
-		error = lodepng_add_text(info, key, (char*)decoded.data);
+        error = lodepng_add_text(info, key, (char*)decoded.data);
 
-		break;
-	}
+        break;
+    }
 
-	lodepng_free(key);
-	ucvector_cleanup(&decoded);
+    lodepng_free(key);
+    ucvector_cleanup(&decoded);
 
-	return error;
+    return error;
 }
 
 /*international text chunk (iTXt)*/
 static unsigned readChunk_iTXt(LodePNGInfo* info, const LodePNGDecompressSettings* zlibsettings,
-	const unsigned char* data, size_t chunkLength)
+    const unsigned char* data, size_t chunkLength)
 {
-	unsigned error = 0;
-	unsigned i;
+    unsigned error = 0;
+    unsigned i;
 
-	unsigned length, begin, compressed;
-	char *key = 0, *langtag = 0, *transkey = 0;
-	ucvector decoded;
-	ucvector_init(&decoded);
+    unsigned length, begin, compressed;
+    char *key = 0, *langtag = 0, *transkey = 0;
+    ucvector decoded;
+    ucvector_init(&decoded);
 
-	while (!error) /*not really a while loop, only used to break on error*/
-	{
-		/*Quick check if the chunk length isn't too small. Even without check
-		it'd still fail with other error checks below if it's too short. This just gives a different error code.*/
-		if (chunkLength < 5) CERROR_BREAK(error, 30); /*iTXt chunk too short*/
+    while (!error) /*not really a while loop, only used to break on error*/
+    {
+        /*Quick check if the chunk length isn't too small. Even without check
+        it'd still fail with other error checks below if it's too short. This just gives a different error code.*/
+        if (chunkLength < 5) CERROR_BREAK(error, 30); /*iTXt chunk too short*/
 
-		/*read the key*/
-		for (length = 0; length < chunkLength && data[length] != 0; ++length);
-		if (length + 3 >= chunkLength) CERROR_BREAK(error, 75); /*no null termination char, corrupt?*/
-		if (length < 1 || length > 79) CERROR_BREAK(error, 89); /*keyword too short or long*/
+        /*read the key*/
+        for (length = 0; length < chunkLength && data[length] != 0; ++length);
+        if (length + 3 >= chunkLength) CERROR_BREAK(error, 75); /*no null termination char, corrupt?*/
+        if (length < 1 || length > 79) CERROR_BREAK(error, 89); /*keyword too short or long*/
 
-		key = (char*)lodepng_malloc(length + 1);
-		if (!key) CERROR_BREAK(error, 83); /*alloc fail*/
+        key = (char*)lodepng_malloc(length + 1);
+        if (!key) CERROR_BREAK(error, 83); /*alloc fail*/
 
-		key[length] = 0;
-		for (i = 0; i != length; ++i) key[i] = (char)data[i];
+        key[length] = 0;
+        for (i = 0; i != length; ++i) key[i] = (char)data[i];
 
-		/*read the compression method*/
-		compressed = data[length + 1];
-		if (data[length + 2] != 0) CERROR_BREAK(error, 72); /*the 0 byte indicating compression must be 0*/
+        /*read the compression method*/
+        compressed = data[length + 1];
+        if (data[length + 2] != 0) CERROR_BREAK(error, 72); /*the 0 byte indicating compression must be 0*/
 
-		/*even though it's not allowed by the standard, no error is thrown if
-		there's no null termination char, if the text is empty for the next 3 texts*/
+        /*even though it's not allowed by the standard, no error is thrown if
+        there's no null termination char, if the text is empty for the next 3 texts*/
 
-		/*read the langtag*/
-		begin = length + 3;
-		length = 0;
-		for (i = begin; i < chunkLength && data[i] != 0; ++i) ++length;
+        /*read the langtag*/
+        begin = length + 3;
+        length = 0;
+        for (i = begin; i < chunkLength && data[i] != 0; ++i) ++length;
 
-		langtag = (char*)lodepng_malloc(length + 1);
-		if (!langtag) CERROR_BREAK(error, 83); /*alloc fail*/
+        langtag = (char*)lodepng_malloc(length + 1);
+        if (!langtag) CERROR_BREAK(error, 83); /*alloc fail*/
 
-		langtag[length] = 0;
-		for (i = 0; i != length; ++i) langtag[i] = (char)data[begin + i];
+        langtag[length] = 0;
+        for (i = 0; i != length; ++i) langtag[i] = (char)data[begin + i];
 
-		/*read the transkey*/
-		begin += length + 1;
-		length = 0;
-		for (i = begin; i < chunkLength && data[i] != 0; ++i) ++length;
+        /*read the transkey*/
+        begin += length + 1;
+        length = 0;
+        for (i = begin; i < chunkLength && data[i] != 0; ++i) ++length;
 
-		transkey = (char*)lodepng_malloc(length + 1);
-		if (!transkey) CERROR_BREAK(error, 83); /*alloc fail*/
+        transkey = (char*)lodepng_malloc(length + 1);
+        if (!transkey) CERROR_BREAK(error, 83); /*alloc fail*/
 
-		transkey[length] = 0;
-		for (i = 0; i != length; ++i) transkey[i] = (char)data[begin + i];
+        transkey[length] = 0;
+        for (i = 0; i != length; ++i) transkey[i] = (char)data[begin + i];
 
-		/*read the actual text*/
-		begin += length + 1;
+        /*read the actual text*/
+        begin += length + 1;
 
-		length = chunkLength < begin ? 0 : chunkLength - begin;
+        length = chunkLength < begin ? 0 : chunkLength - begin;
 
-		if (compressed)
-		{
-			/*will fail if zlib error, e.g. if length is too small*/
-			error = zlib_decompress(&decoded.data, &decoded.size,
-				(unsigned char*)(&data[begin]),
-				length, zlibsettings);
-			if (error) break;
-			if (decoded.allocsize < decoded.size) decoded.allocsize = decoded.size;
-			ucvector_push_back(&decoded, 0);
-		}
-		else
-		{
-			if (!ucvector_resize(&decoded, length + 1)) CERROR_BREAK(error, 83 /*alloc fail*/);
+        if (compressed)
+        {
+            /*will fail if zlib error, e.g. if length is too small*/
+            error = zlib_decompress(&decoded.data, &decoded.size,
+                (unsigned char*)(&data[begin]),
+                length, zlibsettings);
+            if (error) break;
+            if (decoded.allocsize < decoded.size) decoded.allocsize = decoded.size;
+            ucvector_push_back(&decoded, 0);
+        }
+        else
+        {
+            if (!ucvector_resize(&decoded, length + 1)) CERROR_BREAK(error, 83 /*alloc fail*/);
 
-			decoded.data[length] = 0;
-			for (i = 0; i != length; ++i) decoded.data[i] = data[begin + i];
-		}
+            decoded.data[length] = 0;
+            for (i = 0; i != length; ++i) decoded.data[i] = data[begin + i];
+        }
 
-		error = lodepng_add_itext(info, key, langtag, transkey, (char*)decoded.data);
+        error = lodepng_add_itext(info, key, langtag, transkey, (char*)decoded.data);
 
-		break;
-	}
+        break;
+    }
 
-	lodepng_free(key);
-	lodepng_free(langtag);
-	lodepng_free(transkey);
-	ucvector_cleanup(&decoded);
+    lodepng_free(key);
+    lodepng_free(langtag);
+    lodepng_free(transkey);
+    ucvector_cleanup(&decoded);
 
-	return error;
+    return error;
 }
 
 static unsigned readChunk_tIME(LodePNGInfo* info, const unsigned char* data, size_t chunkLength)
 {
-	if (chunkLength != 7) return 73; /*invalid tIME chunk size*/
+    if (chunkLength != 7) return 73; /*invalid tIME chunk size*/
 
-	info->time_defined = 1;
-	info->time.year = 256u * data[0] + data[1];
-	info->time.month = data[2];
-	info->time.day = data[3];
-	info->time.hour = data[4];
-	info->time.minute = data[5];
-	info->time.second = data[6];
+    info->time_defined = 1;
+    info->time.year = 256u * data[0] + data[1];
+    info->time.month = data[2];
+    info->time.day = data[3];
+    info->time.hour = data[4];
+    info->time.minute = data[5];
+    info->time.second = data[6];
 
-	return 0; /* OK */
+    return 0; /* OK */
 }
 
 static unsigned readChunk_pHYs(LodePNGInfo* info, const unsigned char* data, size_t chunkLength)
 {
-	if (chunkLength != 9) return 74; /*invalid pHYs chunk size*/
+    if (chunkLength != 9) return 74; /*invalid pHYs chunk size*/
 
-	info->phys_defined = 1;
-	info->phys_x = 16777216u * data[0] + 65536u * data[1] + 256u * data[2] + data[3];
-	info->phys_y = 16777216u * data[4] + 65536u * data[5] + 256u * data[6] + data[7];
-	info->phys_unit = data[8];
+    info->phys_defined = 1;
+    info->phys_x = 16777216u * data[0] + 65536u * data[1] + 256u * data[2] + data[3];
+    info->phys_y = 16777216u * data[4] + 65536u * data[5] + 256u * data[6] + data[7];
+    info->phys_unit = data[8];
 
-	return 0; /* OK */
+    return 0; /* OK */
 }
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
 /*read a PNG, the result will be in the same color type as the PNG (hence "generic")*/
-static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
-	LodePNGState* state,
-	const unsigned char* in, size_t insize)
-{
-	unsigned char IEND = 0;
-	const unsigned char* chunk;
-	size_t i;
-	ucvector idat; /*the data from idat chunks*/
-	ucvector scanlines;
-	size_t predict;
-	size_t numpixels;
-	size_t outsize;
-
-	/*for unknown chunk order*/
-	unsigned unknown = 0;
+/*gives the data of the next IDAT chunk after the IDAT chunk with the given data, context is the end of the PNG.
+The chunks up to IEND were checked by readChunks, the IDAT chunks don't have to follow each other directly*/
+static const unsigned char* nextIdatSegment(const unsigned char* segment, size_t* size, const void* context)
+{
+    const unsigned char* end = (const unsigned char*)context;
+    const unsigned char* chunk = segment - 8;
+    for (;;)
+    {
+        chunk = lodepng_chunk_next_const(chunk);
+        if (end - chunk < 12 || lodepng_chunk_type_equals(chunk, "IEND")) return 0;
+        if (lodepng_chunk_type_equals(chunk, "IDAT")) break;
+    }
+    *size = lodepng_chunk_length(chunk);
+    return lodepng_chunk_data_const(chunk);
+}
+
+/*reads the header and all chunks into the state. idatdata gets the data of the first IDAT chunk and idatsize
+the total size of the data of all IDAT chunks, which nextIdatSegment goes through without copying it.
+return value is error*/
+static unsigned readChunks(unsigned* w, unsigned* h, const unsigned char** idatdata, size_t* idatsize,
+    LodePNGState* state, const unsigned char* in, size_t insize)
+{
+    unsigned char IEND = 0;
+    const unsigned char* chunk;
+    size_t numpixels;
+
+    /*for unknown chunk order*/
+    unsigned unknown = 0;
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-	unsigned critical_pos = 1; /*1 = after IHDR, 2 = after PLTE, 3 = after IDAT*/
+    unsigned critical_pos = 1; /*1 = after IHDR, 2 = after PLTE, 3 = after IDAT*/
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
-	/*provide some proper output values if error will happen*/
-	*out = 0;
+    *idatdata = 0;
+    *idatsize = 0;
+    state->error = lodepng_inspect(w, h, state, in, insize); /*reads header and resets other parameters in state->info_png*/
+    if (state->error) return state->error;
 
-	state->error = lodepng_inspect(w, h, state, in, insize); /*reads header and resets other parameters in state->info_png*/
-	if (state->error) return;
+    numpixels = *w * *h;
 
-	numpixels = *w * *h;
+    /*multiplication overflow*/
+    if (*h != 0 && numpixels / *h != *w) CERROR_RETURN_ERROR(state->error, 92);
+    /*multiplication overflow possible further below. Allows up to 2^31-1 pixel
+    bytes with 16-bit RGBA, the rest is room for filter bytes.*/
+    if (numpixels > 268435455) CERROR_RETURN_ERROR(state->error, 92);
 
-	/*multiplication overflow*/
-	if (*h != 0 && numpixels / *h != *w) CERROR_RETURN(state->error, 92);
-	/*multiplication overflow possible further below. Allows up to 2^31-1 pixel
-	bytes with 16-bit RGBA, the rest is room for filter bytes.*/
-	if (numpixels > 268435455) CERROR_RETURN(state->error, 92);
+    chunk = &in[33]; /*first byte of the first chunk after the header*/
 
-	ucvector_init(&idat);
-	chunk = &in[33]; /*first byte of the first chunk after the header*/
+    /*loop through the chunks, ignoring unknown chunks and stopping at IEND chunk.
+    IDAT data is put at the start of the in buffer*/
+    while (!IEND && !state->error)
+    {
+        unsigned chunkLength;
+        const unsigned char* data; /*the data in the chunk*/
 
-	/*loop through the chunks, ignoring unknown chunks and stopping at IEND chunk.
-	IDAT data is put at the start of the in buffer*/
-	while (!IEND && !state->error)
-	{
-		unsigned chunkLength;
-		const unsigned char* data; /*the data in the chunk*/
+        /*error: size of the in buffer too small to contain next chunk*/
+        if ((size_t)((chunk - in) + 12) > insize || chunk < in) CERROR_BREAK(state->error, 30);
 
-		/*error: size of the in buffer too small to contain next chunk*/
-		if ((size_t)((chunk - in) + 12) > insize || chunk < in) CERROR_BREAK(state->error, 30);
+        /*length of the data of the chunk, excluding the length bytes, chunk type and CRC bytes*/
+        chunkLength = lodepng_chunk_length(chunk);
+        /*error: chunk length larger than the max PNG chunk size*/
+        if (chunkLength > 2147483647) CERROR_BREAK(state->error, 63);
 
-		/*length of the data of the chunk, excluding the length bytes, chunk type and CRC bytes*/
-		chunkLength = lodepng_chunk_length(chunk);
-		/*error: chunk length larger than the max PNG chunk size*/
-		if (chunkLength > 2147483647) CERROR_BREAK(state->error, 63);
+        if ((size_t)((chunk - in) + chunkLength + 12) > insize || (chunk + chunkLength + 12) < in)
+        {
+            CERROR_BREAK(state->error, 64); /*error: size of the in buffer too small to contain next chunk*/
+        }
 
-		if ((size_t)((chunk - in) + chunkLength + 12) > insize || (chunk + chunkLength + 12) < in)
-		{
-			CERROR_BREAK(state->error, 64); /*error: size of the in buffer too small to contain next chunk*/
-		}
+        data = lodepng_chunk_data_const(chunk);
 
-		data = lodepng_chunk_data_const(chunk);
-
-		/*IDAT chunk, containing compressed image data*/
-		if (lodepng_chunk_type_equals(chunk, "IDAT"))
-		{
-			size_t oldsize = idat.size;
-			if (!ucvector_resize(&idat, oldsize + chunkLength)) CERROR_BREAK(state->error, 83 /*alloc fail*/);
-			for (i = 0; i != chunkLength; ++i) idat.data[oldsize + i] = data[i];
+        /*IDAT chunk, containing compressed image data*/
+        if (lodepng_chunk_type_equals(chunk, "IDAT"))
+        {
+            if (!*idatdata) *idatdata = data;
+            *idatsize += chunkLength;
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-			critical_pos = 3;
+            critical_pos = 3;
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-		}
-		/*IEND chunk*/
-		else if (lodepng_chunk_type_equals(chunk, "IEND"))
-		{
-			IEND = 1;
-		}
-		/*palette chunk (PLTE)*/
-		else if (lodepng_chunk_type_equals(chunk, "PLTE"))
-		{
-			state->error = readChunk_PLTE(&state->info_png.color, data, chunkLength);
-			if (state->error) break;
+        }
+        /*IEND chunk*/
+        else if (lodepng_chunk_type_equals(chunk, "IEND"))
+        {
+            IEND = 1;
+        }
+        /*palette chunk (PLTE)*/
+        else if (lodepng_chunk_type_equals(chunk, "PLTE"))
+        {
+            state->error = readChunk_PLTE(&state->info_png.color, data, chunkLength);
+            if (state->error) break;
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-			critical_pos = 2;
+            critical_pos = 2;
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-		}
-		/*palette transparency chunk (tRNS)*/
-		else if (lodepng_chunk_type_equals(chunk, "tRNS"))
-		{
-			state->error = readChunk_tRNS(&state->info_png.color, data, chunkLength);
-			if (state->error) break;
-		}
+        }
+        /*palette transparency chunk (tRNS)*/
+        else if (lodepng_chunk_type_equals(chunk, "tRNS"))
+        {
+            state->error = readChunk_tRNS(&state->info_png.color, data, chunkLength);
+            if (state->error) break;
+        }
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-		/*background color chunk (bKGD)*/
-		else if (lodepng_chunk_type_equals(chunk, "bKGD"))
-		{
-			state->error = readChunk_bKGD(&state->info_png, data, chunkLength);
-			if (state->error) break;
-		}
-		/*text chunk (tEXt)*/
-		else if (lodepng_chunk_type_equals(chunk, "tEXt"))
-		{
-			if (state->decoder.read_text_chunks)
-			{
-				state->error = readChunk_tEXt(&state->info_png, data, chunkLength);
-				if (state->error) break;
-			}
-		}
-		/*compressed text chunk (zTXt)*/
-		else if (lodepng_chunk_type_equals(chunk, "zTXt"))
-		{
-			if (state->decoder.read_text_chunks)
-			{
-				state->error = readChunk_zTXt(&state->info_png, &state->decoder.zlibsettings, data, chunkLength);
-				if (state->error) break;
-			}
-		}
-		/*international text chunk (iTXt)*/
-		else if (lodepng_chunk_type_equals(chunk, "iTXt"))
-		{
-			if (state->decoder.read_text_chunks)
-			{
-				state->error = readChunk_iTXt(&state->info_png, &state->decoder.zlibsettings, data, chunkLength);
-				if (state->error) break;
-			}
-		}
-		else if (lodepng_chunk_type_equals(chunk, "tIME"))
-		{
-			state->error = readChunk_tIME(&state->info_png, data, chunkLength);
-			if (state->error) break;
-		}
-		else if (lodepng_chunk_type_equals(chunk, "pHYs"))
-		{
-			state->error = readChunk_pHYs(&state->info_png, data, chunkLength);
-			if (state->error) break;
-		}
+        /*background color chunk (bKGD)*/
+        else if (lodepng_chunk_type_equals(chunk, "bKGD"))
+        {
+            state->error = readChunk_bKGD(&state->info_png, data, chunkLength);
+            if (state->error) break;
+        }
+        /*text chunk (tEXt)*/
+        else if (lodepng_chunk_type_equals(chunk, "tEXt"))
+        {
+            if (state->decoder.read_text_chunks)
+            {
+                state->error = readChunk_tEXt(&state->info_png, data, chunkLength);
+                if (state->error) break;
+            }
+        }
+        /*compressed text chunk (zTXt)*/
+        else if (lodepng_chunk_type_equals(chunk, "zTXt"))
+        {
+            if (state->decoder.read_text_chunks)
+            {
+                state->error = readChunk_zTXt(&state->info_png, &state->decoder.zlibsettings, data, chunkLength);
+                if (state->error) break;
+            }
+        }
+        /*international text chunk (iTXt)*/
+        else if (lodepng_chunk_type_equals(chunk, "iTXt"))
+        {
+            if (state->decoder.read_text_chunks)
+            {
+                state->error = readChunk_iTXt(&state->info_png, &state->decoder.zlibsettings, data, chunkLength);
+                if (state->error) break;
+            }
+        }
+        else if (lodepng_chunk_type_equals(chunk, "tIME"))
+        {
+            state->error = readChunk_tIME(&state->info_png, data, chunkLength);
+            if (state->error) break;
+        }
+        else if (lodepng_chunk_type_equals(chunk, "pHYs"))
+        {
+            state->error = readChunk_pHYs(&state->info_png, data, chunkLength);
+            if (state->error) break;
+        }
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-		else /*it's not an implemented chunk type, so ignore it: skip over the data*/
-		{
-			/*error: unknown critical chunk (5th bit of first byte of chunk type is 0)*/
-			if (!lodepng_chunk_ancillary(chunk)) CERROR_BREAK(state->error, 69);
+        else /*it's not an implemented chunk type, so ignore it: skip over the data*/
+        {
+            /*error: unknown critical chunk (5th bit of first byte of chunk type is 0)*/
+            if (!lodepng_chunk_ancillary(chunk)) CERROR_BREAK(state->error, 69);
 
-			unknown = 1;
+            unknown = 1;
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-			if (state->decoder.remember_unknown_chunks)
-			{
-				state->error = lodepng_chunk_append(&state->info_png.unknown_chunks_data[critical_pos - 1],
-					&state->info_png.unknown_chunks_size[critical_pos - 1], chunk);
-				if (state->error) break;
-			}
+            if (state->decoder.remember_unknown_chunks)
+            {
+                state->error = lodepng_chunk_append(&state->info_png.unknown_chunks_data[critical_pos - 1],
+                    &state->info_png.unknown_chunks_size[critical_pos - 1], chunk);
+                if (state->error) break;
+            }
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-		}
-
-		if (!state->decoder.ignore_crc && !unknown) /*check CRC if wanted, only on known chunk types*/
-		{
-			if (lodepng_chunk_check_crc(chunk)) CERROR_BREAK(state->error, 57); /*invalid CRC*/
-		}
-
-		if (!IEND) chunk = lodepng_chunk_next_const(chunk);
-	}
-
-	ucvector_init(&scanlines);
-	/*predict output size, to allocate exact size for output buffer to avoid more dynamic allocation.
-	If the decompressed size does not match the prediction, the image must be corrupt.*/
-	if (state->info_png.interlace_method == 0)
-	{
-		/*The extra *h is added because this are the filter bytes every scanline starts with*/
-		predict = lodepng_get_raw_size_idat(*w, *h, &state->info_png.color) + *h;
-	}
-	else
-	{
-		/*Adam-7 interlaced: predicted size is the sum of the 7 sub-images sizes*/
-		const LodePNGColorMode* color = &state->info_png.color;
-		predict = 0;
-		predict += lodepng_get_raw_size_idat((*w + 7) >> 3, (*h + 7) >> 3, color) + ((*h + 7) >> 3);
-		if (*w > 4) predict += lodepng_get_raw_size_idat((*w + 3) >> 3, (*h + 7) >> 3, color) + ((*h + 7) >> 3);
-		predict += lodepng_get_raw_size_idat((*w + 3) >> 2, (*h + 3) >> 3, color) + ((*h + 3) >> 3);
-		if (*w > 2) predict += lodepng_get_raw_size_idat((*w + 1) >> 2, (*h + 3) >> 2, color) + ((*h + 3) >> 2);
-		predict += lodepng_get_raw_size_idat((*w + 1) >> 1, (*h + 1) >> 2, color) + ((*h + 1) >> 2);
-		if (*w > 1) predict += lodepng_get_raw_size_idat((*w + 0) >> 1, (*h + 1) >> 1, color) + ((*h + 1) >> 1);
-		predict += lodepng_get_raw_size_idat((*w + 0), (*h + 0) >> 1, color) + ((*h + 0) >> 1);
-	}
-	if (!state->error && !ucvector_reserve(&scanlines, predict)) state->error = 83; /*alloc fail*/
-	if (!state->error)
-	{
-		state->error = zlib_decompress(&scanlines.data, &scanlines.size, idat.data,
-			idat.size, &state->decoder.zlibsettings);
-		if (!state->error && scanlines.size != predict) state->error = 91; /*decompressed size doesn't match prediction*/
-	}
-	ucvector_cleanup(&idat);
-
-	if (!state->error)
-	{
-		outsize = lodepng_get_raw_size(*w, *h, &state->info_png.color);
-		*out = (unsigned char*)lodepng_malloc(outsize);
-		if (!*out) state->error = 83; /*alloc fail*/
-	}
-	if (!state->error)
-	{
-		for (i = 0; i < outsize; i++) (*out)[i] = 0;
-		state->error = postProcessScanlines(*out, scanlines.data, *w, *h, &state->info_png);
-	}
-	ucvector_cleanup(&scanlines);
+        }
+
+        if (!state->decoder.ignore_crc && !unknown) /*check CRC if wanted, only on known chunk types*/
+        {
+            if (lodepng_chunk_check_crc(chunk)) CERROR_BREAK(state->error, 57); /*invalid CRC*/
+        }
+
+        if (!IEND) chunk = lodepng_chunk_next_const(chunk);
+    }
+    return state->error;
+}
+
+/*the output of inflate until it has the size that is needed, then inflate is stopped*/
+typedef struct PrefixStream
+{
+    ucvector* out;
+    size_t size;
+} PrefixStream;
+
+static unsigned prefixStreamAdd(void* user, const unsigned char* data, size_t size)
+{
+    PrefixStream* stream = (PrefixStream*)user;
+    size_t oldsize = stream->out->size;
+    if (size > stream->size - oldsize) size = stream->size - oldsize;
+    if (!ucvector_resize(stream->out, oldsize + size)) return 83; /*alloc fail*/
+    if (size) memcpy(stream->out->data + oldsize, data, size);
+    return stream->out->size == stream->size ? INFLATE_STREAM_STOP : 0;
+}
+
+/*decompresses the zlib data of the IDAT chunks into out, where the IDAT data is read in place unless custom_zlib or
+custom_inflate are set, those get the data of all IDAT chunks copied together. If prefix is not 0 only the first
+prefix bytes are needed and the built in inflate stops when it has them*/
+static unsigned decompressIdat(ucvector* out, size_t prefix, const unsigned char* idatdata, size_t idatsize,
+    const unsigned char* end, const LodePNGDecompressSettings* settings)
+{
+    size_t size = idatdata ? lodepng_chunk_length(idatdata - 8) : 0;
+    if (settings->custom_zlib || settings->custom_inflate)
+    {
+        unsigned error;
+        ucvector idat;
+        const unsigned char* data;
+        size_t pos = 0;
+        /*the data of a single IDAT chunk already is in one buffer*/
+        if (size == idatsize) error = zlib_decompress(&out->data, &out->size, idatdata, idatsize, settings);
+        else
+        {
+            ucvector_init(&idat);
+            if (!ucvector_resize(&idat, idatsize)) return 83; /*alloc fail*/
+            for (data = idatdata; data; data = nextIdatSegment(data, &size, end))
+            {
+                if (size) memcpy(idat.data + pos, data, size);
+                pos += size;
+            }
+            error = zlib_decompress(&out->data, &out->size, idat.data, idat.size, settings);
+            ucvector_cleanup(&idat);
+        }
+        if (!error && prefix && out->size > prefix) out->size = prefix;
+        return error;
+    }
+    if (prefix)
+    {
+        PrefixStream stream;
+        stream.out = out;
+        stream.size = prefix;
+        return zlib_decompress_stream(idatdata, size, nextIdatSegment, end, idatsize, settings, prefixStreamAdd, &stream);
+    }
+    return zlib_decompress_segments(out, idatdata, size, nextIdatSegment, end, idatsize, settings, 0);
+}
+
+static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
+    LodePNGState* state,
+    const unsigned char* in, size_t insize)
+{
+    size_t i;
+    const unsigned char* idatdata;
+    size_t idatsize;
+    ucvector scanlines;
+    size_t predict;
+    size_t outsize;
+    unsigned passes = 7; /*the number of Adam7 passes that are decoded*/
+    unsigned rw, rh; /*size of the decoded image, smaller than w * h if not all passes are decoded*/
+
+    /*provide some proper output values if error will happen*/
+    *out = 0;
+
+    if (readChunks(w, h, &idatdata, &idatsize, state, in, insize)) return;
+    if (state->info_png.interlace_method == 1 && state->decoder.adam7_passes >= 1 && state->decoder.adam7_passes < 7)
+    {
+        passes = state->decoder.adam7_passes;
+    }
+    lodepng_adam7_reduced_size(&rw, &rh, *w, *h, passes);
+
+    ucvector_init(&scanlines);
+    /*predict output size, to allocate exact size for output buffer to avoid more dynamic allocation.
+    If the decompressed size does not match the prediction, the image must be corrupt.*/
+    if (state->info_png.interlace_method == 0)
+    {
+        /*The extra *h is added because this are the filter bytes every scanline starts with*/
+        predict = lodepng_get_raw_size_idat(*w, *h, &state->info_png.color) + *h;
+    }
+    else if (passes < 7)
+    {
+        /*the passes are stored one after the other, so inflate can stop after the bytes of the first passes*/
+        unsigned passw[7], passh[7];
+        size_t filter_passstart[8], padded_passstart[8], passstart[8];
+        Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart,
+            *w, *h, lodepng_get_bpp(&state->info_png.color));
+        predict = filter_passstart[passes];
+    }
+    else
+    {
+        /*Adam-7 interlaced: predicted size is the sum of the 7 sub-images sizes*/
+        const LodePNGColorMode* color = &state->info_png.color;
+        predict = 0;
+        predict += lodepng_get_raw_size_idat((*w + 7) >> 3, (*h + 7) >> 3, color) + ((*h + 7) >> 3);
+        if (*w > 4) predict += lodepng_get_raw_size_idat((*w + 3) >> 3, (*h + 7) >> 3, color) + ((*h + 7) >> 3);
+        predict += lodepng_get_raw_size_idat((*w + 3) >> 2, (*h + 3) >> 3, color) + ((*h + 3) >> 3);
+        if (*w > 2) predict += lodepng_get_raw_size_idat((*w + 1) >> 2, (*h + 3) >> 2, color) + ((*h + 3) >> 2);
+        predict += lodepng_get_raw_size_idat((*w + 1) >> 1, (*h + 1) >> 2, color) + ((*h + 1) >> 2);
+        if (*w > 1) predict += lodepng_get_raw_size_idat((*w + 0) >> 1, (*h + 1) >> 1, color) + ((*h + 1) >> 1);
+        predict += lodepng_get_raw_size_idat((*w + 0), (*h + 0) >> 1, color) + ((*h + 0) >> 1);
+    }
+    if (!state->error && !ucvector_reserve(&scanlines, predict)) state->error = 83; /*alloc fail*/
+    if (!state->error)
+    {
+        state->error = decompressIdat(&scanlines, passes < 7 ? predict : 0, idatdata, idatsize, in + insize,
+            &state->decoder.zlibsettings);
+        if (!state->error && scanlines.size != predict) state->error = 91; /*decompressed size doesn't match prediction*/
+    }
+
+    if (!state->error)
+    {
+        outsize = lodepng_get_raw_size(rw, rh, &state->info_png.color);
+        *out = (unsigned char*)lodepng_malloc(outsize);
+        if (!*out) state->error = 83; /*alloc fail*/
+    }
+    if (!state->error)
+    {
+        for (i = 0; i < outsize; i++) (*out)[i] = 0;
+        state->error = postProcessScanlines(*out, scanlines.data, *w, *h, &state->info_png, passes);
+    }
+    if (!state->error)
+    {
+        *w = rw;
+        *h = rh;
+    }
+    ucvector_cleanup(&scanlines);
 }
 
 unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
-	LodePNGState* state,
-	const unsigned char* in, size_t insize)
-{
-	*out = 0;
-	decodeGeneric(out, w, h, state, in, insize);
-	if (state->error) return state->error;
-	if (!state->decoder.color_convert || lodepng_color_mode_equal(&state->info_raw, &state->info_png.color))
-	{
-		/*same color type, no copying or converting of data needed*/
-		/*store the info_png color settings on the info_raw so that the info_raw still reflects what colortype
-		the raw image has to the end user*/
-		if (!state->decoder.color_convert)
-		{
-			state->error = lodepng_color_mode_copy(&state->info_raw, &state->info_png.color);
-			if (state->error) return state->error;
-		}
-	}
-	else
-	{
-		/*color conversion needed; sort of copy of the data*/
-		unsigned char* data = *out;
-		size_t outsize;
-
-		/*TODO: check if this works according to the statement in the documentation: "The converter can convert
-		from greyscale input color type, to 8-bit greyscale or greyscale with alpha"*/
-		if (!(state->info_raw.colortype == LCT_RGB || state->info_raw.colortype == LCT_RGBA)
-			&& !(state->info_raw.bitdepth == 8))
-		{
-			return 56; /*unsupported color mode conversion*/
-		}
-
-		outsize = lodepng_get_raw_size(*w, *h, &state->info_raw);
-		*out = (unsigned char*)lodepng_malloc(outsize);
-		if (!(*out))
-		{
-			state->error = 83; /*alloc fail*/
-		}
-		else state->error = lodepng_convert(*out, data, &state->info_raw,
-			&state->info_png.color, *w, *h);
-		lodepng_free(data);
-	}
-	return state->error;
+    LodePNGState* state,
+    const unsigned char* in, size_t insize)
+{
+    *out = 0;
+    decodeGeneric(out, w, h, state, in, insize);
+    if (state->error) return state->error;
+    if (!state->decoder.color_convert || lodepng_color_mode_equal(&state->info_raw, &state->info_png.color))
+    {
+        /*same color type, no copying or converting of data needed*/
+        /*store the info_png color settings on the info_raw so that the info_raw still reflects what colortype
+        the raw image has to the end user*/
+        if (!state->decoder.color_convert)
+        {
+            state->error = lodepng_color_mode_copy(&state->info_raw, &state->info_png.color);
+            if (state->error) return state->error;
+        }
+    }
+    else
+    {
+        /*color conversion needed; sort of copy of the data*/
+        unsigned char* data = *out;
+        size_t outsize;
+
+        /*TODO: check if this works according to the statement in the documentation: "The converter can convert
+        from greyscale input color type, to 8-bit greyscale or greyscale with alpha"*/
+        if (!(state->info_raw.colortype == LCT_RGB || state->info_raw.colortype == LCT_RGBA)
+            && !(state->info_raw.bitdepth == 8))
+        {
+            return 56; /*unsupported color mode conversion*/
+        }
+
+        outsize = lodepng_get_raw_size(*w, *h, &state->info_raw);
+        *out = (unsigned char*)lodepng_malloc(outsize);
+        if (!(*out))
+        {
+            state->error = 83; /*alloc fail*/
+        }
+        else state->error = lodepng_convert(*out, data, &state->info_raw,
+            &state->info_png.color, *w, *h);
+        lodepng_free(data);
+    }
+    return state->error;
+}
+
+/*collects the inflated scanlines of a non-interlaced image and hands them to the user one by one*/
+typedef struct RowStream
+{
+    LodePNGState* state;
+    unsigned w, h;
+    unsigned y; /*next row to complete*/
+    size_t linebytes; /*bytes per scanline without the filter type byte*/
+    size_t filled; /*bytes of the current scanline received so far, including the filter type byte*/
+    unsigned char* current; /*filter type byte followed by the scanline being received*/
+    unsigned char* previous; /*previous unfiltered scanline, behind a filter type byte so it can be swapped*/
+    unsigned char* converted; /*the row in the color mode of info_raw, unused if no conversion is needed*/
+    LodePNGRowCallback callback;
+    void* user;
+} RowStream;
+
+static unsigned rowStreamAdd(void* user, const unsigned char* data, size_t size)
+{
+    RowStream* stream = (RowStream*)user;
+    while (size > 0)
+    {
+        size_t amount = 1 + stream->linebytes - stream->filled;
+        if (amount > size) amount = size;
+        if (stream->y >= stream->h) return 91; /*decompressed size doesn't match prediction*/
+        memcpy(stream->current + stream->filled, data, amount);
+        stream->filled += amount;
+        data += amount;
+        size -= amount;
+
+        if (stream->filled == 1 + stream->linebytes)
+        {
+            unsigned char* swap;
+            const unsigned char* row = stream->current + 1;
+            unsigned bpp = lodepng_get_bpp(&stream->state->info_png.color);
+            CERROR_TRY_RETURN(unfilterScanline(stream->current + 1, stream->current + 1,
+                stream->y == 0 ? 0 : stream->previous + 1, (bpp + 7) / 8, stream->current[0], stream->linebytes));
+            /*the padding bits at the end of a single scanline are harmless for the conversion*/
+            if (stream->converted)
+            {
+                CERROR_TRY_RETURN(lodepng_convert(stream->converted, row, &stream->state->info_raw,
+                    &stream->state->info_png.color, stream->w, 1));
+                row = stream->converted;
+            }
+            CERROR_TRY_RETURN(stream->callback(stream->user, stream->y, row));
+
+            swap = stream->previous;
+            stream->previous = stream->current;
+            stream->current = swap;
+            stream->filled = 0;
+            ++stream->y;
+        }
+    }
+    return 0;
+}
+
+/*decodes the whole image and then hands out its rows, used for Adam7 interlaced images*/
+static unsigned decodeRowsFromImage(unsigned* w, unsigned* h, LodePNGState* state,
+    const unsigned char* in, size_t insize, LodePNGRowCallback callback, void* user)
+{
+    unsigned char* image = 0;
+    unsigned char* line = 0;
+    unsigned y;
+    size_t linebits, linebytes;
+    unsigned error = lodepng_decode(&image, w, h, state, in, insize);
+
+    /*rows of the decoded image are not byte aligned when they have a fractional number of bytes*/
+    linebits = (size_t)(*w) * lodepng_get_bpp(&state->info_raw);
+    linebytes = (linebits + 7) / 8;
+    if (!error && (linebits & 7) != 0)
+    {
+        line = (unsigned char*)lodepng_malloc(linebytes);
+        if (!line) error = 83; /*alloc fail*/
+    }
+    for (y = 0; !error && y < *h; ++y)
+    {
+        if (line)
+        {
+            size_t ibp = y * linebits, obp = 0, x;
+            for (x = 0; x < linebits; ++x) setBitOfReversedStream(&obp, line, readBitFromReversedStream(&ibp, image));
+            error = callback(user, y, line);
+        }
+        else error = callback(user, y, image + y * linebytes);
+    }
+    lodepng_free(line);
+    lodepng_free(image);
+    return error;
+}
+
+unsigned lodepng_decode_rows(unsigned* w, unsigned* h, LodePNGState* state,
+    const unsigned char* in, size_t insize, LodePNGRowCallback callback, void* user)
+{
+    const unsigned char* idatdata;
+    size_t idatsize;
+    RowStream stream;
+    size_t i;
+
+    if (readChunks(w, h, &idatdata, &idatsize, state, in, insize)) return state->error;
+    if (state->info_png.interlace_method != 0)
+    {
+        state->error = decodeRowsFromImage(w, h, state, in, insize, callback, user);
+        return state->error;
+    }
+
+    stream.state = state;
+    stream.w = *w;
+    stream.h = *h;
+    stream.y = 0;
+    stream.linebytes = lodepng_get_raw_size_idat(*w, 1, &state->info_png.color);
+    stream.filled = 0;
+    stream.current = (unsigned char*)lodepng_malloc(1 + stream.linebytes);
+    stream.previous = (unsigned char*)lodepng_malloc(1 + stream.linebytes);
+    stream.converted = 0;
+    stream.callback = callback;
+    stream.user = user;
+    if (!stream.current || !stream.previous) state->error = 83; /*alloc fail*/
+
+    /*same color mode handling as lodepng_decode, but for a single row*/
+    if (!state->error && !state->decoder.color_convert)
+    {
+        state->error = lodepng_color_mode_copy(&state->info_raw, &state->info_png.color);
+    }
+    else if (!state->error && !lodepng_color_mode_equal(&state->info_raw, &state->info_png.color))
+    {
+        if (!(state->info_raw.colortype == LCT_RGB || state->info_raw.colortype == LCT_RGBA)
+            && !(state->info_raw.bitdepth == 8))
+        {
+            state->error = 56; /*unsupported color mode conversion*/
+        }
+        else
+        {
+            size_t size = lodepng_get_raw_size(*w, 1, &state->info_raw);
+            stream.converted = (unsigned char*)lodepng_malloc(size);
+            if (!stream.converted) state->error = 83; /*alloc fail*/
+            /*lodepng_convert only sets the bits of sub-byte pixels, so the row has to start out zeroed*/
+            else for (i = 0; i < size; ++i) stream.converted[i] = 0;
+        }
+    }
+
+    if (!state->error)
+    {
+        size_t size = idatdata ? lodepng_chunk_length(idatdata - 8) : 0;
+        state->error = zlib_decompress_stream(idatdata, size, nextIdatSegment, in + insize, idatsize,
+            &state->decoder.zlibsettings, rowStreamAdd, &stream);
+        if (!state->error && (stream.y != stream.h || stream.filled != 0)) state->error = 91; /*size doesn't match prediction*/
+    }
+
+    lodepng_free(stream.current);
+    lodepng_free(stream.previous);
+    lodepng_free(stream.converted);
+    return state->error;
 }
 
 unsigned lodepng_decode_memory(unsigned char** out, unsigned* w, unsigned* h, const unsigned char* in,
-	size_t insize, LodePNGColorType colortype, unsigned bitdepth)
+    size_t insize, LodePNGColorType colortype, unsigned bitdepth)
 {
-	unsigned error;
-	LodePNGState state;
-	lodepng_state_init(&state);
-	state.info_raw.colortype = colortype;
-	state.info_raw.bitdepth = bitdepth;
-	error = lodepng_decode(out, w, h, &state, in, insize);
-	lodepng_state_cleanup(&state);
-	return error;
+    unsigned error;
+    LodePNGState state;
+    lodepng_state_init(&state);
+    state.info_raw.colortype = colortype;
+    state.info_raw.bitdepth = bitdepth;
+    error = lodepng_decode(out, w, h, &state, in, insize);
+    lodepng_state_cleanup(&state);
+    return error;
 }
 
 unsigned lodepng_decode32(unsigned char** out, unsigned* w, unsigned* h, const unsigned char* in, size_t insize)
 {
-	return lodepng_decode_memory(out, w, h, in, insize, LCT_RGBA, 8);
+    return lodepng_decode_memory(out, w, h, in, insize, LCT_RGBA, 8);
 }
 
 unsigned lodepng_decode24(unsigned char** out, unsigned* w, unsigned* h, const unsigned char* in, size_t insize)
 {
-	return lodepng_decode_memory(out, w, h, in, insize, LCT_RGB, 8);
+    return lodepng_decode_memory(out, w, h, in, insize, LCT_RGB, 8);
 }
 
 #ifdef LODEPNG_COMPILE_DISK
 unsigned lodepng_decode_file(unsigned char** out, unsigned* w, unsigned* h, const char* filename,
-	LodePNGColorType colortype, unsigned bitdepth)
+    LodePNGColorType colortype, unsigned bitdepth)
 {
-	unsigned char* buffer = 0;
-	size_t buffersize;
-	unsigned error;
-	error = lodepng_load_file(&buffer, &buffersize, filename);
-	if (!error) error = lodepng_decode_memory(out, w, h, buffer, buffersize, colortype, bitdepth);
-	lodepng_free(buffer);
-	return error;
+    unsigned char* buffer = 0;
+    size_t buffersize;
+    unsigned error;
+    error = lodepng_load_file(&buffer, &buffersize, filename);
+    if (!error) error = lodepng_decode_memory(out, w, h, buffer, buffersize, colortype, bitdepth);
+    lodepng_free(buffer);
+    return error;
 }
 
 unsigned lodepng_decode32_file(unsigned char** out, unsigned* w, unsigned* h, const char* filename)
 {
-	return lodepng_decode_file(out, w, h, filename, LCT_RGBA, 8);
+    return lodepng_decode_file(out, w, h, filename, LCT_RGBA, 8);
 }
 
 unsigned lodepng_decode24_file(unsigned char** out, unsigned* w, unsigned* h, const char* filename)
 {
-	return lodepng_decode_file(out, w, h, filename, LCT_RGB, 8);
+    return lodepng_decode_file(out, w, h, filename, LCT_RGB, 8);
 }
 #endif /*LODEPNG_COMPILE_DISK*/
 
 void lodepng_decoder_settings_init(LodePNGDecoderSettings* settings)
 {
-	settings->color_convert = 1;
+    settings->color_convert = 1;
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-	settings->read_text_chunks = 1;
-	settings->remember_unknown_chunks = 0;
+    settings->read_text_chunks = 1;
+    settings->remember_unknown_chunks = 0;
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-	settings->ignore_crc = 0;
-	lodepng_decompress_settings_init(&settings->zlibsettings);
+    settings->ignore_crc = 0;
+    settings->adam7_passes = 0;
+    lodepng_decompress_settings_init(&settings->zlibsettings);
 }
 
 #endif /*LODEPNG_COMPILE_DECODER*/
@@ -4825,30 +6569,30 @@ void lodepng_decoder_settings_init(LodePNGDecoderSettings* settings)
 void lodepng_state_init(LodePNGState* state)
 {
 #ifdef LODEPNG_COMPILE_DECODER
-	lodepng_decoder_settings_init(&state->decoder);
+    lodepng_decoder_settings_init(&state->decoder);
 #endif /*LODEPNG_COMPILE_DECODER*/
 #ifdef LODEPNG_COMPILE_ENCODER
-	lodepng_encoder_settings_init(&state->encoder);
+    lodepng_encoder_settings_init(&state->encoder);
 #endif /*LODEPNG_COMPILE_ENCODER*/
-	lodepng_color_mode_init(&state->info_raw);
-	lodepng_info_init(&state->info_png);
-	state->error = 1;
+    lodepng_color_mode_init(&state->info_raw);
+    lodepng_info_init(&state->info_png);
+    state->error = 1;
 }
 
 void lodepng_state_cleanup(LodePNGState* state)
 {
-	lodepng_color_mode_cleanup(&state->info_raw);
-	lodepng_info_cleanup(&state->info_png);
+    lodepng_color_mode_cleanup(&state->info_raw);
+    lodepng_info_cleanup(&state->info_png);
 }
 
 void lodepng_state_copy(LodePNGState* dest, const LodePNGState* source)
 {
-	lodepng_state_cleanup(dest);
-	*dest = *source;
-	lodepng_color_mode_init(&dest->info_raw);
-	lodepng_info_init(&dest->info_png);
-	dest->error = lodepng_color_mode_copy(&dest->info_raw, &source->info_raw); if (dest->error) return;
-	dest->error = lodepng_info_copy(&dest->info_png, &source->info_png); if (dest->error) return;
+    lodepng_state_cleanup(dest);
+    *dest = *source;
+    lodepng_color_mode_init(&dest->info_raw);
+    lodepng_info_init(&dest->info_png);
+    dest->error = lodepng_color_mode_copy(&dest->info_raw, &source->info_raw); if (dest->error) return;
+    dest->error = lodepng_info_copy(&dest->info_png, &source->info_png); if (dest->error) return;
 }
 
 #endif /* defined(LODEPNG_COMPILE_DECODER) || defined(LODEPNG_COMPILE_ENCODER) */
@@ -4862,585 +6606,666 @@ void lodepng_state_copy(LodePNGState* dest, const LodePNGState* source)
 /*chunkName must be string of 4 characters*/
 static unsigned addChunk(ucvector* out, const char* chunkName, const unsigned char* data, size_t length)
 {
-	CERROR_TRY_RETURN(lodepng_chunk_create(&out->data, &out->size, (unsigned)length, chunkName, data));
-	out->allocsize = out->size; /*fix the allocsize again*/
-	return 0;
+    CERROR_TRY_RETURN(lodepng_chunk_create(&out->data, &out->size, (unsigned)length, chunkName, data));
+    out->allocsize = out->size; /*fix the allocsize again*/
+    return 0;
 }
 
 static void writeSignature(ucvector* out)
 {
-	/*8 bytes PNG signature, aka the magic bytes*/
-	ucvector_push_back(out, 137);
-	ucvector_push_back(out, 80);
-	ucvector_push_back(out, 78);
-	ucvector_push_back(out, 71);
-	ucvector_push_back(out, 13);
-	ucvector_push_back(out, 10);
-	ucvector_push_back(out, 26);
-	ucvector_push_back(out, 10);
+    /*8 bytes PNG signature, aka the magic bytes*/
+    ucvector_push_back(out, 137);
+    ucvector_push_back(out, 80);
+    ucvector_push_back(out, 78);
+    ucvector_push_back(out, 71);
+    ucvector_push_back(out, 13);
+    ucvector_push_back(out, 10);
+    ucvector_push_back(out, 26);
+    ucvector_push_back(out, 10);
 }
 
 static unsigned addChunk_IHDR(ucvector* out, unsigned w, unsigned h,
-	LodePNGColorType colortype, unsigned bitdepth, unsigned interlace_method)
+    LodePNGColorType colortype, unsigned bitdepth, unsigned interlace_method)
 {
-	unsigned error = 0;
-	ucvector header;
-	ucvector_init(&header);
+    unsigned error = 0;
+    ucvector header;
+    ucvector_init(&header);
 
-	lodepng_add32bitInt(&header, w); /*width*/
-	lodepng_add32bitInt(&header, h); /*height*/
-	ucvector_push_back(&header, (unsigned char)bitdepth); /*bit depth*/
-	ucvector_push_back(&header, (unsigned char)colortype); /*color type*/
-	ucvector_push_back(&header, 0); /*compression method*/
-	ucvector_push_back(&header, 0); /*filter method*/
-	ucvector_push_back(&header, interlace_method); /*interlace method*/
+    lodepng_add32bitInt(&header, w); /*width*/
+    lodepng_add32bitInt(&header, h); /*height*/
+    ucvector_push_back(&header, (unsigned char)bitdepth); /*bit depth*/
+    ucvector_push_back(&header, (unsigned char)colortype); /*color type*/
+    ucvector_push_back(&header, 0); /*compression method*/
+    ucvector_push_back(&header, 0); /*filter method*/
+    ucvector_push_back(&header, interlace_method); /*interlace method*/
 
-	error = addChunk(out, "IHDR", header.data, header.size);
-	ucvector_cleanup(&header);
+    error = addChunk(out, "IHDR", header.data, header.size);
+    ucvector_cleanup(&header);
 
-	return error;
+    return error;
 }
 
 static unsigned addChunk_PLTE(ucvector* out, const LodePNGColorMode* info)
 {
-	unsigned error = 0;
-	size_t i;
-	ucvector PLTE;
-	ucvector_init(&PLTE);
-	for (i = 0; i != info->palettesize * 4; ++i)
-	{
-		/*add all channels except alpha channel*/
-		if (i % 4 != 3) ucvector_push_back(&PLTE, info->palette[i]);
-	}
-	error = addChunk(out, "PLTE", PLTE.data, PLTE.size);
-	ucvector_cleanup(&PLTE);
+    unsigned error = 0;
+    size_t i;
+    ucvector PLTE;
+    ucvector_init(&PLTE);
+    for (i = 0; i != info->palettesize * 4; ++i)
+    {
+        /*add all channels except alpha channel*/
+        if (i % 4 != 3) ucvector_push_back(&PLTE, info->palette[i]);
+    }
+    error = addChunk(out, "PLTE", PLTE.data, PLTE.size);
+    ucvector_cleanup(&PLTE);
 
-	return error;
+    return error;
 }
 
 static unsigned addChunk_tRNS(ucvector* out, const LodePNGColorMode* info)
 {
-	unsigned error = 0;
-	size_t i;
-	ucvector tRNS;
-	ucvector_init(&tRNS);
-	if (info->colortype == LCT_PALETTE)
-	{
-		size_t amount = info->palettesize;
-		/*the tail of palette values that all have 255 as alpha, does not have to be encoded*/
-		for (i = info->palettesize; i != 0; --i)
-		{
-			if (info->palette[4 * (i - 1) + 3] == 255) --amount;
-			else break;
-		}
-		/*add only alpha channel*/
-		for (i = 0; i != amount; ++i) ucvector_push_back(&tRNS, info->palette[4 * i + 3]);
-	}
-	else if (info->colortype == LCT_GREY)
-	{
-		if (info->key_defined)
-		{
-			ucvector_push_back(&tRNS, (unsigned char)(info->key_r >> 8));
-			ucvector_push_back(&tRNS, (unsigned char)(info->key_r & 255));
-		}
-	}
-	else if (info->colortype == LCT_RGB)
-	{
-		if (info->key_defined)
-		{
-			ucvector_push_back(&tRNS, (unsigned char)(info->key_r >> 8));
-			ucvector_push_back(&tRNS, (unsigned char)(info->key_r & 255));
-			ucvector_push_back(&tRNS, (unsigned char)(info->key_g >> 8));
-			ucvector_push_back(&tRNS, (unsigned char)(info->key_g & 255));
-			ucvector_push_back(&tRNS, (unsigned char)(info->key_b >> 8));
-			ucvector_push_back(&tRNS, (unsigned char)(info->key_b & 255));
-		}
-	}
-
-	error = addChunk(out, "tRNS", tRNS.data, tRNS.size);
-	ucvector_cleanup(&tRNS);
-
-	return error;
+    unsigned error = 0;
+    size_t i;
+    ucvector tRNS;
+    ucvector_init(&tRNS);
+    if (info->colortype == LCT_PALETTE)
+    {
+        size_t amount = info->palettesize;
+        /*the tail of palette values that all have 255 as alpha, does not have to be encoded*/
+        for (i = info->palettesize; i != 0; --i)
+        {
+            if (info->palette[4 * (i - 1) + 3] == 255) --amount;
+            else break;
+        }
+        /*add only alpha channel*/
+        for (i = 0; i != amount; ++i) ucvector_push_back(&tRNS, info->palette[4 * i + 3]);
+    }
+    else if (info->colortype == LCT_GREY)
+    {
+        if (info->key_defined)
+        {
+            ucvector_push_back(&tRNS, (unsigned char)(info->key_r >> 8));
+            ucvector_push_back(&tRNS, (unsigned char)(info->key_r & 255));
+        }
+    }
+    else if (info->colortype == LCT_RGB)
+    {
+        if (info->key_defined)
+        {
+            ucvector_push_back(&tRNS, (unsigned char)(info->key_r >> 8));
+            ucvector_push_back(&tRNS, (unsigned char)(info->key_r & 255));
+            ucvector_push_back(&tRNS, (unsigned char)(info->key_g >> 8));
+            ucvector_push_back(&tRNS, (unsigned char)(info->key_g & 255));
+            ucvector_push_back(&tRNS, (unsigned char)(info->key_b >> 8));
+            ucvector_push_back(&tRNS, (unsigned char)(info->key_b & 255));
+        }
+    }
+
+    error = addChunk(out, "tRNS", tRNS.data, tRNS.size);
+    ucvector_cleanup(&tRNS);
+
+    return error;
 }
 
 static unsigned addChunk_IDAT(ucvector* out, const unsigned char* data, size_t datasize,
-	LodePNGCompressSettings* zlibsettings)
+    LodePNGCompressSettings* zlibsettings)
 {
-	ucvector zlibdata;
-	unsigned error = 0;
+    ucvector zlibdata;
+    unsigned error = 0;
 
-	/*compress with the Zlib compressor*/
-	ucvector_init(&zlibdata);
-	error = zlib_compress(&zlibdata.data, &zlibdata.size, data, datasize, zlibsettings);
-	if (!error) error = addChunk(out, "IDAT", zlibdata.data, zlibdata.size);
-	ucvector_cleanup(&zlibdata);
+    /*compress with the Zlib compressor*/
+    ucvector_init(&zlibdata);
+    error = zlib_compress(&zlibdata.data, &zlibdata.size, data, datasize, zlibsettings);
+    if (!error) error = addChunk(out, "IDAT", zlibdata.data, zlibdata.size);
+    ucvector_cleanup(&zlibdata);
 
-	return error;
+    return error;
 }
 
 static unsigned addChunk_IEND(ucvector* out)
 {
-	unsigned error = 0;
-	error = addChunk(out, "IEND", 0, 0);
-	return error;
+    unsigned error = 0;
+    error = addChunk(out, "IEND", 0, 0);
+    return error;
 }
 
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
 
 static unsigned addChunk_tEXt(ucvector* out, const char* keyword, const char* textstring)
 {
-	unsigned error = 0;
-	size_t i;
-	ucvector text;
-	ucvector_init(&text);
-	for (i = 0; keyword[i] != 0; ++i) ucvector_push_back(&text, (unsigned char)keyword[i]);
-	if (i < 1 || i > 79) return 89; /*error: invalid keyword size*/
-	ucvector_push_back(&text, 0); /*0 termination char*/
-	for (i = 0; textstring[i] != 0; ++i) ucvector_push_back(&text, (unsigned char)textstring[i]);
-	error = addChunk(out, "tEXt", text.data, text.size);
-	ucvector_cleanup(&text);
+    unsigned error = 0;
+    size_t i;
+    ucvector text;
+    ucvector_init(&text);
+    for (i = 0; keyword[i] != 0; ++i) ucvector_push_back(&text, (unsigned char)keyword[i]);
+    if (i < 1 || i > 79) return 89; /*error: invalid keyword size*/
+    ucvector_push_back(&text, 0); /*0 termination char*/
+    for (i = 0; textstring[i] != 0; ++i) ucvector_push_back(&text, (unsigned char)textstring[i]);
+    error = addChunk(out, "tEXt", text.data, text.size);
+    ucvector_cleanup(&text);
 
-	return error;
+    return error;
 }
 
 static unsigned addChunk_zTXt(ucvector* out, const char* keyword, const char* textstring,
-	LodePNGCompressSettings* zlibsettings)
+    LodePNGCompressSettings* zlibsettings)
 {
-	unsigned error = 0;
-	ucvector data, compressed;
-	size_t i, textsize = strlen(textstring);
+    unsigned error = 0;
+    ucvector data, compressed;
+    size_t i, textsize = strlen(textstring);
 
-	ucvector_init(&data);
-	ucvector_init(&compressed);
-	for (i = 0; keyword[i] != 0; ++i) ucvector_push_back(&data, (unsigned char)keyword[i]);
-	if (i < 1 || i > 79) return 89; /*error: invalid keyword size*/
-	ucvector_push_back(&data, 0); /*0 termination char*/
-	ucvector_push_back(&data, 0); /*compression method: 0*/
+    ucvector_init(&data);
+    ucvector_init(&compressed);
+    for (i = 0; keyword[i] != 0; ++i) ucvector_push_back(&data, (unsigned char)keyword[i]);
+    if (i < 1 || i > 79) return 89; /*error: invalid keyword size*/
+    ucvector_push_back(&data, 0); /*0 termination char*/
+    ucvector_push_back(&data, 0); /*compression method: 0*/
 
-	error = zlib_compress(&compressed.data, &compressed.size,
-		(unsigned char*)textstring, textsize, zlibsettings);
-	if (!error)
-	{
-		for (i = 0; i != compressed.size; ++i) ucvector_push_back(&data, compressed.data[i]);
-		error = addChunk(out, "zTXt", data.data, data.size);
-	}
+    error = zlib_compress(&compressed.data, &compressed.size,
+        (unsigned char*)textstring, textsize, zlibsettings);
+    if (!error)
+    {
+        for (i = 0; i != compressed.size; ++i) ucvector_push_back(&data, compressed.data[i]);
+        error = addChunk(out, "zTXt", data.data, data.size);
+    }
 
-	ucvector_cleanup(&compressed);
-	ucvector_cleanup(&data);
-	return error;
+    ucvector_cleanup(&compressed);
+    ucvector_cleanup(&data);
+    return error;
 }
 
 static unsigned addChunk_iTXt(ucvector* out, unsigned compressed, const char* keyword, const char* langtag,
-	const char* transkey, const char* textstring, LodePNGCompressSettings* zlibsettings)
-{
-	unsigned error = 0;
-	ucvector data;
-	size_t i, textsize = strlen(textstring);
-
-	ucvector_init(&data);
-
-	for (i = 0; keyword[i] != 0; ++i) ucvector_push_back(&data, (unsigned char)keyword[i]);
-	if (i < 1 || i > 79) return 89; /*error: invalid keyword size*/
-	ucvector_push_back(&data, 0); /*null termination char*/
-	ucvector_push_back(&data, compressed ? 1 : 0); /*compression flag*/
-	ucvector_push_back(&data, 0); /*compression method*/
-	for (i = 0; langtag[i] != 0; ++i) ucvector_push_back(&data, (unsigned char)langtag[i]);
-	ucvector_push_back(&data, 0); /*null termination char*/
-	for (i = 0; transkey[i] != 0; ++i) ucvector_push_back(&data, (unsigned char)transkey[i]);
-	ucvector_push_back(&data, 0); /*null termination char*/
-
-	if (compressed)
-	{
-		ucvector compressed_data;
-		ucvector_init(&compressed_data);
-		error = zlib_compress(&compressed_data.data, &compressed_data.size,
-			(unsigned char*)textstring, textsize, zlibsettings);
-		if (!error)
-		{
-			for (i = 0; i != compressed_data.size; ++i) ucvector_push_back(&data, compressed_data.data[i]);
-		}
-		ucvector_cleanup(&compressed_data);
-	}
-	else /*not compressed*/
-	{
-		for (i = 0; textstring[i] != 0; ++i) ucvector_push_back(&data, (unsigned char)textstring[i]);
-	}
-
-	if (!error) error = addChunk(out, "iTXt", data.data, data.size);
-	ucvector_cleanup(&data);
-	return error;
+    const char* transkey, const char* textstring, LodePNGCompressSettings* zlibsettings)
+{
+    unsigned error = 0;
+    ucvector data;
+    size_t i, textsize = strlen(textstring);
+
+    ucvector_init(&data);
+
+    for (i = 0; keyword[i] != 0; ++i) ucvector_push_back(&data, (unsigned char)keyword[i]);
+    if (i < 1 || i > 79) return 89; /*error: invalid keyword size*/
+    ucvector_push_back(&data, 0); /*null termination char*/
+    ucvector_push_back(&data, compressed ? 1 : 0); /*compression flag*/
+    ucvector_push_back(&data, 0); /*compression method*/
+    for (i = 0; langtag[i] != 0; ++i) ucvector_push_back(&data, (unsigned char)langtag[i]);
+    ucvector_push_back(&data, 0); /*null termination char*/
+    for (i = 0; transkey[i] != 0; ++i) ucvector_push_back(&data, (unsigned char)transkey[i]);
+    ucvector_push_back(&data, 0); /*null termination char*/
+
+    if (compressed)
+    {
+        ucvector compressed_data;
+        ucvector_init(&compressed_data);
+        error = zlib_compress(&compressed_data.data, &compressed_data.size,
+            (unsigned char*)textstring, textsize, zlibsettings);
+        if (!error)
+        {
+            for (i = 0; i != compressed_data.size; ++i) ucvector_push_back(&data, compressed_data.data[i]);
+        }
+        ucvector_cleanup(&compressed_data);
+    }
+    else /*not compressed*/
+    {
+        for (i = 0; textstring[i] != 0; ++i) ucvector_push_back(&data, (unsigned char)textstring[i]);
+    }
+
+    if (!error) error = addChunk(out, "iTXt", data.data, data.size);
+    ucvector_cleanup(&data);
+    return error;
 }
 
 static unsigned addChunk_bKGD(ucvector* out, const LodePNGInfo* info)
 {
-	unsigned error = 0;
-	ucvector bKGD;
-	ucvector_init(&bKGD);
-	if (info->color.colortype == LCT_GREY || info->color.colortype == LCT_GREY_ALPHA)
-	{
-		ucvector_push_back(&bKGD, (unsigned char)(info->background_r >> 8));
-		ucvector_push_back(&bKGD, (unsigned char)(info->background_r & 255));
-	}
-	else if (info->color.colortype == LCT_RGB || info->color.colortype == LCT_RGBA)
-	{
-		ucvector_push_back(&bKGD, (unsigned char)(info->background_r >> 8));
-		ucvector_push_back(&bKGD, (unsigned char)(info->background_r & 255));
-		ucvector_push_back(&bKGD, (unsigned char)(info->background_g >> 8));
-		ucvector_push_back(&bKGD, (unsigned char)(info->background_g & 255));
-		ucvector_push_back(&bKGD, (unsigned char)(info->background_b >> 8));
-		ucvector_push_back(&bKGD, (unsigned char)(info->background_b & 255));
-	}
-	else if (info->color.colortype == LCT_PALETTE)
-	{
-		ucvector_push_back(&bKGD, (unsigned char)(info->background_r & 255)); /*palette index*/
-	}
-
-	error = addChunk(out, "bKGD", bKGD.data, bKGD.size);
-	ucvector_cleanup(&bKGD);
-
-	return error;
+    unsigned error = 0;
+    ucvector bKGD;
+    ucvector_init(&bKGD);
+    if (info->color.colortype == LCT_GREY || info->color.colortype == LCT_GREY_ALPHA)
+    {
+        ucvector_push_back(&bKGD, (unsigned char)(info->background_r >> 8));
+        ucvector_push_back(&bKGD, (unsigned char)(info->background_r & 255));
+    }
+    else if (info->color.colortype == LCT_RGB || info->color.colortype == LCT_RGBA)
+    {
+        ucvector_push_back(&bKGD, (unsigned char)(info->background_r >> 8));
+        ucvector_push_back(&bKGD, (unsigned char)(info->background_r & 255));
+        ucvector_push_back(&bKGD, (unsigned char)(info->background_g >> 8));
+        ucvector_push_back(&bKGD, (unsigned char)(info->background_g & 255));
+        ucvector_push_back(&bKGD, (unsigned char)(info->background_b >> 8));
+        ucvector_push_back(&bKGD, (unsigned char)(info->background_b & 255));
+    }
+    else if (info->color.colortype == LCT_PALETTE)
+    {
+        ucvector_push_back(&bKGD, (unsigned char)(info->background_r & 255)); /*palette index*/
+    }
+
+    error = addChunk(out, "bKGD", bKGD.data, bKGD.size);
+    ucvector_cleanup(&bKGD);
+
+    return error;
 }
 
 static unsigned addChunk_tIME(ucvector* out, const LodePNGTime* time)
 {
-	unsigned error = 0;
-	unsigned char* data = (unsigned char*)lodepng_malloc(7);
-	if (!data) return 83; /*alloc fail*/
-	data[0] = (unsigned char)(time->year >> 8);
-	data[1] = (unsigned char)(time->year & 255);
-	data[2] = (unsigned char)time->month;
-	data[3] = (unsigned char)time->day;
-	data[4] = (unsigned char)time->hour;
-	data[5] = (unsigned char)time->minute;
-	data[6] = (unsigned char)time->second;
-	error = addChunk(out, "tIME", data, 7);
-	lodepng_free(data);
-	return error;
+    unsigned error = 0;
+    unsigned char* data = (unsigned char*)lodepng_malloc(7);
+    if (!data) return 83; /*alloc fail*/
+    data[0] = (unsigned char)(time->year >> 8);
+    data[1] = (unsigned char)(time->year & 255);
+    data[2] = (unsigned char)time->month;
+    data[3] = (unsigned char)time->day;
+    data[4] = (unsigned char)time->hour;
+    data[5] = (unsigned char)time->minute;
+    data[6] = (unsigned char)time->second;
+    error = addChunk(out, "tIME", data, 7);
+    lodepng_free(data);
+    return error;
 }
 
 static unsigned addChunk_pHYs(ucvector* out, const LodePNGInfo* info)
 {
-	unsigned error = 0;
-	ucvector data;
-	ucvector_init(&data);
+    unsigned error = 0;
+    ucvector data;
+    ucvector_init(&data);
 
-	lodepng_add32bitInt(&data, info->phys_x);
-	lodepng_add32bitInt(&data, info->phys_y);
-	ucvector_push_back(&data, info->phys_unit);
+    lodepng_add32bitInt(&data, info->phys_x);
+    lodepng_add32bitInt(&data, info->phys_y);
+    ucvector_push_back(&data, info->phys_unit);
 
-	error = addChunk(out, "pHYs", data.data, data.size);
-	ucvector_cleanup(&data);
+    error = addChunk(out, "pHYs", data.data, data.size);
+    ucvector_cleanup(&data);
 
-	return error;
+    return error;
 }
 
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
 static void filterScanline(unsigned char* out, const unsigned char* scanline, const unsigned char* prevline,
-	size_t length, size_t bytewidth, unsigned char filterType)
-{
-	size_t i;
-	switch (filterType)
-	{
-	case 0: /*None*/
-		for (i = 0; i != length; ++i) out[i] = scanline[i];
-		break;
-	case 1: /*Sub*/
-		for (i = 0; i != bytewidth; ++i) out[i] = scanline[i];
-		for (i = bytewidth; i < length; ++i) out[i] = scanline[i] - scanline[i - bytewidth];
-		break;
-	case 2: /*Up*/
-		if (prevline)
-		{
-			for (i = 0; i != length; ++i) out[i] = scanline[i] - prevline[i];
-		}
-		else
-		{
-			for (i = 0; i != length; ++i) out[i] = scanline[i];
-		}
-		break;
-	case 3: /*Average*/
-		if (prevline)
-		{
-			for (i = 0; i != bytewidth; ++i) out[i] = scanline[i] - (prevline[i] >> 1);
-			for (i = bytewidth; i < length; ++i) out[i] = scanline[i] - ((scanline[i - bytewidth] + prevline[i]) >> 1);
-		}
-		else
-		{
-			for (i = 0; i != bytewidth; ++i) out[i] = scanline[i];
-			for (i = bytewidth; i < length; ++i) out[i] = scanline[i] - (scanline[i - bytewidth] >> 1);
-		}
-		break;
-	case 4: /*Paeth*/
-		if (prevline)
-		{
-			/*paethPredictor(0, prevline[i], 0) is always prevline[i]*/
-			for (i = 0; i != bytewidth; ++i) out[i] = (scanline[i] - prevline[i]);
-			for (i = bytewidth; i < length; ++i)
-			{
-				out[i] = (scanline[i] - paethPredictor(scanline[i - bytewidth], prevline[i], prevline[i - bytewidth]));
-			}
-		}
-		else
-		{
-			for (i = 0; i != bytewidth; ++i) out[i] = scanline[i];
-			/*paethPredictor(scanline[i - bytewidth], 0, 0) is always scanline[i - bytewidth]*/
-			for (i = bytewidth; i < length; ++i) out[i] = (scanline[i] - scanline[i - bytewidth]);
-		}
-		break;
-	default: return; /*unexisting filter type given*/
-	}
+    size_t length, size_t bytewidth, unsigned char filterType)
+{
+    size_t i;
+    switch (filterType)
+    {
+    case 0: /*None*/
+        for (i = 0; i != length; ++i) out[i] = scanline[i];
+        break;
+    case 1: /*Sub*/
+        for (i = 0; i != bytewidth; ++i) out[i] = scanline[i];
+        for (i = bytewidth; i < length; ++i) out[i] = scanline[i] - scanline[i - bytewidth];
+        break;
+    case 2: /*Up*/
+        if (prevline)
+        {
+            for (i = 0; i != length; ++i) out[i] = scanline[i] - prevline[i];
+        }
+        else
+        {
+            for (i = 0; i != length; ++i) out[i] = scanline[i];
+        }
+        break;
+    case 3: /*Average*/
+        if (prevline)
+        {
+            for (i = 0; i != bytewidth; ++i) out[i] = scanline[i] - (prevline[i] >> 1);
+            for (i = bytewidth; i < length; ++i) out[i] = scanline[i] - ((scanline[i - bytewidth] + prevline[i]) >> 1);
+        }
+        else
+        {
+            for (i = 0; i != bytewidth; ++i) out[i] = scanline[i];
+            for (i = bytewidth; i < length; ++i) out[i] = scanline[i] - (scanline[i - bytewidth] >> 1);
+        }
+        break;
+    case 4: /*Paeth*/
+        if (prevline)
+        {
+            /*paethPredictor(0, prevline[i], 0) is always prevline[i]*/
+            for (i = 0; i != bytewidth; ++i) out[i] = (scanline[i] - prevline[i]);
+            for (i = bytewidth; i < length; ++i)
+            {
+                out[i] = (scanline[i] - paethPredictor(scanline[i - bytewidth], prevline[i], prevline[i - bytewidth]));
+            }
+        }
+        else
+        {
+            for (i = 0; i != bytewidth; ++i) out[i] = scanline[i];
+            /*paethPredictor(scanline[i - bytewidth], 0, 0) is always scanline[i - bytewidth]*/
+            for (i = bytewidth; i < length; ++i) out[i] = (scanline[i] - scanline[i - bytewidth]);
+        }
+        break;
+    default: return; /*unexisting filter type given*/
+    }
+}
+
+/*the score of LFS_MINSUM for the filtered bytes start .. end - 1*/
+static size_t filterSum(const unsigned char* filtered, size_t start, size_t end, unsigned type)
+{
+    size_t x, sum = 0;
+    if (type == 0)
+    {
+        for (x = start; x < end; ++x) sum += filtered[x];
+    }
+    else
+    {
+        for (x = start; x < end; ++x)
+        {
+            /*For differences, each byte should be treated as signed, values above 127 are negative
+            (converted to signed char). Filtertype 0 isn't a difference though, so use unsigned there.
+            This means filtertype 0 is almost never chosen, but that is justified.*/
+            unsigned char s = filtered[x];
+            sum += s < 128 ? s : (255U - s);
+        }
+    }
+    return sum;
+}
+
+#ifdef LODEPNG_X86_SIMD
+/*byte i of scanline filtered with a filter type, for the bytes that filterAttempts does one at a time*/
+static unsigned char filterByte(const unsigned char* scanline, const unsigned char* prevline,
+    size_t i, size_t bytewidth, unsigned type)
+{
+    unsigned char left = i >= bytewidth ? scanline[i - bytewidth] : 0;
+    unsigned char up = prevline ? prevline[i] : 0;
+    unsigned char upleft = (prevline && i >= bytewidth) ? prevline[i - bytewidth] : 0;
+    switch (type)
+    {
+    case 1: return (unsigned char)(scanline[i] - left);
+    case 2: return (unsigned char)(scanline[i] - up);
+    case 3: return (unsigned char)(scanline[i] - ((left + up) >> 1));
+    case 4: return (unsigned char)(scanline[i] - paethPredictor(left, up, upleft));
+    default: return scanline[i];
+    }
+}
+
+/*adds the two 64-bit lanes of sums of _mm_sad_epu8*/
+__attribute__((target("sse2")))
+static size_t sumLanesSSE2(__m128i sums)
+{
+    sums = _mm_add_epi64(sums, _mm_unpackhi_epi64(sums, sums));
+    return (size_t)(unsigned)_mm_cvtsi128_si32(sums)
+        + (((size_t)(unsigned)_mm_cvtsi128_si32(_mm_srli_si128(sums, 4)) << 16) << 16);
+}
+
+/*
+Filters a scanline with all five filter types in one pass and gives the sums of LFS_MINSUM, 16 bytes at a
+time. The encoder knows the unfiltered bytes to the left, so unlike unfiltering there is no dependency
+between the bytes. The first pixel and the bytes at the end that don't fill 16 bytes are done one at a time.
+*/
+__attribute__((target("sse2")))
+static void filterAttemptsSSE2(unsigned char** attempt, size_t* sum, const unsigned char* scanline,
+    const unsigned char* prevline, size_t length, size_t bytewidth)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i sums[5];
+    size_t i, head = bytewidth < length ? bytewidth : length, tail;
+    unsigned type;
+
+    for (type = 0; type != 5; ++type) sums[type] = zero;
+    for (i = 0; i != head; ++i)
+    {
+        for (type = 0; type != 5; ++type) attempt[type][i] = filterByte(scanline, prevline, i, bytewidth, type);
+    }
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i current = _mm_loadu_si128((const __m128i*)&scanline[i]);
+        __m128i left = _mm_loadu_si128((const __m128i*)&scanline[i - bytewidth]);
+        __m128i up = prevline ? _mm_loadu_si128((const __m128i*)&prevline[i]) : zero;
+        __m128i upleft = prevline ? _mm_loadu_si128((const __m128i*)&prevline[i - bytewidth]) : zero;
+        /*_mm_avg_epu8 rounds up, the filter rounds down*/
+        __m128i average = _mm_sub_epi8(_mm_avg_epu8(left, up), _mm_and_si128(_mm_xor_si128(left, up), one));
+        __m128i paeth = _mm_packus_epi16(
+            paethPredictorSSE2(_mm_unpacklo_epi8(left, zero), _mm_unpacklo_epi8(up, zero), _mm_unpacklo_epi8(upleft, zero)),
+            paethPredictorSSE2(_mm_unpackhi_epi8(left, zero), _mm_unpackhi_epi8(up, zero), _mm_unpackhi_epi8(upleft, zero)));
+        __m128i filtered[5];
+        filtered[0] = current;
+        filtered[1] = _mm_sub_epi8(current, left);
+        filtered[2] = _mm_sub_epi8(current, up);
+        filtered[3] = _mm_sub_epi8(current, average);
+        filtered[4] = _mm_sub_epi8(current, paeth);
+
+        _mm_storeu_si128((__m128i*)&attempt[0][i], current);
+        sums[0] = _mm_add_epi64(sums[0], _mm_sad_epu8(current, zero));
+        for (type = 1; type != 5; ++type)
+        {
+            /*the differences count as signed bytes: s < 128 ? s : 255 - s, which is s with its bits flipped*/
+            __m128i magnitude = _mm_xor_si128(filtered[type], _mm_cmpgt_epi8(zero, filtered[type]));
+            _mm_storeu_si128((__m128i*)&attempt[type][i], filtered[type]);
+            sums[type] = _mm_add_epi64(sums[type], _mm_sad_epu8(magnitude, zero));
+        }
+    }
+    for (tail = i; i < length; ++i)
+    {
+        for (type = 0; type != 5; ++type) attempt[type][i] = filterByte(scanline, prevline, i, bytewidth, type);
+    }
+
+    for (type = 0; type != 5; ++type)
+    {
+        sum[type] = sumLanesSSE2(sums[type]) + filterSum(attempt[type], 0, head, type)
+            + filterSum(attempt[type], tail, length, type);
+    }
+}
+#endif /*LODEPNG_X86_SIMD*/
+
+/*filters a scanline into attempt[0] to attempt[4] with each filter type, sum gets the LFS_MINSUM scores*/
+static void filterAttempts(unsigned char** attempt, size_t* sum, const unsigned char* scanline,
+    const unsigned char* prevline, size_t length, size_t bytewidth)
+{
+    unsigned type;
+#ifdef LODEPNG_X86_SIMD
+    if (__builtin_cpu_supports("sse2"))
+    {
+        filterAttemptsSSE2(attempt, sum, scanline, prevline, length, bytewidth);
+        return;
+    }
+#endif /*LODEPNG_X86_SIMD*/
+    for (type = 0; type != 5; ++type)
+    {
+        filterScanline(attempt[type], scanline, prevline, length, bytewidth, (unsigned char)type);
+        sum[type] = filterSum(attempt[type], 0, length, type);
+    }
 }
 
 /* log2 approximation. A slight bit faster than std::log. */
 static float flog2(float f)
 {
-	float result = 0;
-	while (f > 32) { result += 4; f /= 16; }
-	while (f > 2) { ++result; f /= 2; }
-	return result + 1.442695f * (f * f * f / 3 - 3 * f * f / 2 + 3 * f - 1.83333f);
+    float result = 0;
+    while (f > 32) { result += 4; f /= 16; }
+    while (f > 2) { ++result; f /= 2; }
+    return result + 1.442695f * (f * f * f / 3 - 3 * f * f / 2 + 3 * f - 1.83333f);
+}
+
+/*the filter strategy used for images with the given color mode*/
+static LodePNGFilterStrategy getFilterStrategy(const LodePNGColorMode* info, const LodePNGEncoderSettings* settings)
+{
+    /*
+    There is a heuristic called the minimum sum of absolute differences heuristic, suggested by the PNG standard:
+    *  If the image type is Palette, or the bit depth is smaller than 8, then do not filter the image (i.e.
+    use fixed filtering, with the filter None).
+    * (The other case) If the image type is Grayscale or RGB (with or without Alpha), and the bit depth is
+    not smaller than 8, then use adaptive filtering heuristic as follows: independently for each row, apply
+    all five filters and select the filter that produces the smallest sum of absolute values per row.
+    This heuristic is used if filter strategy is LFS_MINSUM and filter_palette_zero is true.
+
+    If filter_palette_zero is true and filter_strategy is not LFS_MINSUM, the above heuristic is followed,
+    but for "the other case", whatever strategy filter_strategy is set to instead of the minimum sum
+    heuristic is used.
+    */
+    if (settings->filter_palette_zero &&
+        (info->colortype == LCT_PALETTE || info->bitdepth < 8)) return LFS_ZERO;
+    return settings->filter_strategy;
+}
+
+/*
+Filters scanline y into out, which gets the filter type byte followed by the linebytes filtered bytes.
+prevline is the previous unfiltered scanline, or 0 for the first one. For the strategies that try every
+filter type, attempt must point to five buffers of linebytes bytes.
+*/
+static unsigned filterRow(unsigned char* out, const unsigned char* scanline, const unsigned char* prevline,
+    size_t linebytes, size_t bytewidth, unsigned y, LodePNGFilterStrategy strategy,
+    const LodePNGEncoderSettings* settings, unsigned char** attempt)
+{
+    size_t x;
+    unsigned type, bestType = 0;
+
+    if (strategy == LFS_ZERO || strategy == LFS_PREDEFINED)
+    {
+        out[0] = strategy == LFS_ZERO ? 0 : settings->predefined_filters[y]; /*filter type byte*/
+        filterScanline(&out[1], scanline, prevline, linebytes, bytewidth, out[0]);
+        return 0;
+    }
+    else if (strategy == LFS_MINSUM)
+    {
+        /*adaptive filtering*/
+        size_t sum[5];
+        size_t smallest = 0;
+
+        /*try the 5 filter types*/
+        filterAttempts(attempt, sum, scanline, prevline, linebytes, bytewidth);
+        for (type = 0; type != 5; ++type)
+        {
+            /*check if this is smallest sum (or if type == 0 it's the first case so always store the values)*/
+            if (type == 0 || sum[type] < smallest)
+            {
+                bestType = type;
+                smallest = sum[type];
+            }
+        }
+    }
+    else if (strategy == LFS_ENTROPY)
+    {
+        float sum[5];
+        float smallest = 0;
+        unsigned count[256];
+        size_t sum_unused[5];
+
+        /*try the 5 filter types*/
+        filterAttempts(attempt, sum_unused, scanline, prevline, linebytes, bytewidth);
+        for (type = 0; type != 5; ++type)
+        {
+            for (x = 0; x != 256; ++x) count[x] = 0;
+            for (x = 0; x != linebytes; ++x) ++count[attempt[type][x]];
+            ++count[type]; /*the filter type itself is part of the scanline*/
+            sum[type] = 0;
+            for (x = 0; x != 256; ++x)
+            {
+                float p = count[x] / (float)(linebytes + 1);
+                sum[type] += count[x] == 0 ? 0 : flog2(1 / p) * p;
+            }
+            /*check if this is smallest sum (or if type == 0 it's the first case so always store the values)*/
+            if (type == 0 || sum[type] < smallest)
+            {
+                bestType = type;
+                smallest = sum[type];
+            }
+        }
+    }
+    else if (strategy == LFS_BRUTE_FORCE)
+    {
+        /*brute force filter chooser.
+        deflate the scanline after every filter attempt to see which one deflates best.
+        This is very slow and gives only slightly smaller, sometimes even larger, result*/
+        size_t size[5];
+        size_t smallest = 0;
+        unsigned char* dummy;
+        LodePNGCompressSettings zlibsettings = settings->zlibsettings;
+        /*use fixed tree on the attempts so that the tree is not adapted to the filtertype on purpose,
+        to simulate the true case where the tree is the same for the whole image. Sometimes it gives
+        better result with dynamic tree anyway. Using the fixed tree sometimes gives worse, but in rare
+        cases better compression. It does make this a bit less slow, so it's worth doing this.*/
+        zlibsettings.btype = 1;
+        /*a custom encoder likely doesn't read the btype setting and is optimized for complete PNG
+        images only, so disable it*/
+        zlibsettings.custom_zlib = 0;
+        zlibsettings.custom_deflate = 0;
+        for (type = 0; type != 5; ++type) /*try the 5 filter types*/
+        {
+            size_t testsize = linebytes;
+            /*if(testsize > 8) testsize /= 8;*/ /*it already works good enough by testing a part of the row*/
+
+            filterScanline(attempt[type], scanline, prevline, linebytes, bytewidth, (unsigned char)type);
+            size[type] = 0;
+            dummy = 0;
+            zlib_compress(&dummy, &size[type], attempt[type], testsize, &zlibsettings);
+            lodepng_free(dummy);
+            /*check if this is smallest size (or if type == 0 it's the first case so always store the values)*/
+            if (type == 0 || size[type] < smallest)
+            {
+                bestType = type;
+                smallest = size[type];
+            }
+        }
+    }
+    else return 88; /* unknown filter strategy */
+
+    /*now fill the out values*/
+    out[0] = (unsigned char)bestType; /*the first byte of a scanline will be the filter type*/
+    for (x = 0; x != linebytes; ++x) out[1 + x] = attempt[bestType][x];
+    return 0;
 }
 
 static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w, unsigned h,
-	const LodePNGColorMode* info, const LodePNGEncoderSettings* settings)
-{
-	/*
-	For PNG filter method 0
-	out must be a buffer with as size: h + (w * h * bpp + 7) / 8, because there are
-	the scanlines with 1 extra byte per scanline
-	*/
-
-	unsigned bpp = lodepng_get_bpp(info);
-	/*the width of a scanline in bytes, not including the filter type*/
-	size_t linebytes = (w * bpp + 7) / 8;
-	/*bytewidth is used for filtering, is 1 when bpp < 8, number of bytes per pixel otherwise*/
-	size_t bytewidth = (bpp + 7) / 8;
-	const unsigned char* prevline = 0;
-	unsigned x, y;
-	unsigned error = 0;
-	LodePNGFilterStrategy strategy = settings->filter_strategy;
-
-	/*
-	There is a heuristic called the minimum sum of absolute differences heuristic, suggested by the PNG standard:
-	*  If the image type is Palette, or the bit depth is smaller than 8, then do not filter the image (i.e.
-	use fixed filtering, with the filter None).
-	* (The other case) If the image type is Grayscale or RGB (with or without Alpha), and the bit depth is
-	not smaller than 8, then use adaptive filtering heuristic as follows: independently for each row, apply
-	all five filters and select the filter that produces the smallest sum of absolute values per row.
-	This heuristic is used if filter strategy is LFS_MINSUM and filter_palette_zero is true.
-
-	If filter_palette_zero is true and filter_strategy is not LFS_MINSUM, the above heuristic is followed,
-	but for "the other case", whatever strategy filter_strategy is set to instead of the minimum sum
-	heuristic is used.
-	*/
-	if (settings->filter_palette_zero &&
-		(info->colortype == LCT_PALETTE || info->bitdepth < 8)) strategy = LFS_ZERO;
-
-	if (bpp == 0) return 31; /*error: invalid color type*/
-
-	if (strategy == LFS_ZERO)
-	{
-		for (y = 0; y != h; ++y)
-		{
-			size_t outindex = (1 + linebytes) * y; /*the extra filterbyte added to each row*/
-			size_t inindex = linebytes * y;
-			out[outindex] = 0; /*filter type byte*/
-			filterScanline(&out[outindex + 1], &in[inindex], prevline, linebytes, bytewidth, 0);
-			prevline = &in[inindex];
-		}
-	}
-	else if (strategy == LFS_MINSUM)
-	{
-		/*adaptive filtering*/
-		size_t sum[5];
-		unsigned char* attempt[5]; /*five filtering attempts, one for each filter type*/
-		size_t smallest = 0;
-		unsigned char type, bestType = 0;
-
-		for (type = 0; type != 5; ++type)
-		{
-			attempt[type] = (unsigned char*)lodepng_malloc(linebytes);
-			if (!attempt[type]) return 83; /*alloc fail*/
-		}
-
-		if (!error)
-		{
-			for (y = 0; y != h; ++y)
-			{
-				/*try the 5 filter types*/
-				for (type = 0; type != 5; ++type)
-				{
-					filterScanline(attempt[type], &in[y * linebytes], prevline, linebytes, bytewidth, type);
-
-					/*calculate the sum of the result*/
-					sum[type] = 0;
-					if (type == 0)
-					{
-						for (x = 0; x != linebytes; ++x) sum[type] += (unsigned char)(attempt[type][x]);
-					}
-					else
-					{
-						for (x = 0; x != linebytes; ++x)
-						{
-							/*For differences, each byte should be treated as signed, values above 127 are negative
-							(converted to signed char). Filtertype 0 isn't a difference though, so use unsigned there.
-							This means filtertype 0 is almost never chosen, but that is justified.*/
-							unsigned char s = attempt[type][x];
-							sum[type] += s < 128 ? s : (255U - s);
-						}
-					}
-
-					/*check if this is smallest sum (or if type == 0 it's the first case so always store the values)*/
-					if (type == 0 || sum[type] < smallest)
-					{
-						bestType = type;
-						smallest = sum[type];
-					}
-				}
-
-				prevline = &in[y * linebytes];
-
-				/*now fill the out values*/
-				out[y * (linebytes + 1)] = bestType; /*the first byte of a scanline will be the filter type*/
-				for (x = 0; x != linebytes; ++x) out[y * (linebytes + 1) + 1 + x] = attempt[bestType][x];
-			}
-		}
-
-		for (type = 0; type != 5; ++type) lodepng_free(attempt[type]);
-	}
-	else if (strategy == LFS_ENTROPY)
-	{
-		float sum[5];
-		unsigned char* attempt[5]; /*five filtering attempts, one for each filter type*/
-		float smallest = 0;
-		unsigned type, bestType = 0;
-		unsigned count[256];
-
-		for (type = 0; type != 5; ++type)
-		{
-			attempt[type] = (unsigned char*)lodepng_malloc(linebytes);
-			if (!attempt[type]) return 83; /*alloc fail*/
-		}
-
-		for (y = 0; y != h; ++y)
-		{
-			/*try the 5 filter types*/
-			for (type = 0; type != 5; ++type)
-			{
-				filterScanline(attempt[type], &in[y * linebytes], prevline, linebytes, bytewidth, type);
-				for (x = 0; x != 256; ++x) count[x] = 0;
-				for (x = 0; x != linebytes; ++x) ++count[attempt[type][x]];
-				++count[type]; /*the filter type itself is part of the scanline*/
-				sum[type] = 0;
-				for (x = 0; x != 256; ++x)
-				{
-					float p = count[x] / (float)(linebytes + 1);
-					sum[type] += count[x] == 0 ? 0 : flog2(1 / p) * p;
-				}
-				/*check if this is smallest sum (or if type == 0 it's the first case so always store the values)*/
-				if (type == 0 || sum[type] < smallest)
-				{
-					bestType = type;
-					smallest = sum[type];
-				}
-			}
-
-			prevline = &in[y * linebytes];
-
-			/*now fill the out values*/
-			out[y * (linebytes + 1)] = bestType; /*the first byte of a scanline will be the filter type*/
-			for (x = 0; x != linebytes; ++x) out[y * (linebytes + 1) + 1 + x] = attempt[bestType][x];
-		}
-
-		for (type = 0; type != 5; ++type) lodepng_free(attempt[type]);
-	}
-	else if (strategy == LFS_PREDEFINED)
-	{
-		for (y = 0; y != h; ++y)
-		{
-			size_t outindex = (1 + linebytes) * y; /*the extra filterbyte added to each row*/
-			size_t inindex = linebytes * y;
-			unsigned char type = settings->predefined_filters[y];
-			out[outindex] = type; /*filter type byte*/
-			filterScanline(&out[outindex + 1], &in[inindex], prevline, linebytes, bytewidth, type);
-			prevline = &in[inindex];
-		}
-	}
-	else if (strategy == LFS_BRUTE_FORCE)
-	{
-		/*brute force filter chooser.
-		deflate the scanline after every filter attempt to see which one deflates best.
-		This is very slow and gives only slightly smaller, sometimes even larger, result*/
-		size_t size[5];
-		unsigned char* attempt[5]; /*five filtering attempts, one for each filter type*/
-		size_t smallest = 0;
-		unsigned type = 0, bestType = 0;
-		unsigned char* dummy;
-		LodePNGCompressSettings zlibsettings = settings->zlibsettings;
-		/*use fixed tree on the attempts so that the tree is not adapted to the filtertype on purpose,
-		to simulate the true case where the tree is the same for the whole image. Sometimes it gives
-		better result with dynamic tree anyway. Using the fixed tree sometimes gives worse, but in rare
-		cases better compression. It does make this a bit less slow, so it's worth doing this.*/
-		zlibsettings.btype = 1;
-		/*a custom encoder likely doesn't read the btype setting and is optimized for complete PNG
-		images only, so disable it*/
-		zlibsettings.custom_zlib = 0;
-		zlibsettings.custom_deflate = 0;
-		for (type = 0; type != 5; ++type)
-		{
-			attempt[type] = (unsigned char*)lodepng_malloc(linebytes);
-			if (!attempt[type]) return 83; /*alloc fail*/
-		}
-		for (y = 0; y != h; ++y) /*try the 5 filter types*/
-		{
-			for (type = 0; type != 5; ++type)
-			{
-				unsigned testsize = linebytes;
-				/*if(testsize > 8) testsize /= 8;*/ /*it already works good enough by testing a part of the row*/
-
-				filterScanline(attempt[type], &in[y * linebytes], prevline, linebytes, bytewidth, type);
-				size[type] = 0;
-				dummy = 0;
-				zlib_compress(&dummy, &size[type], attempt[type], testsize, &zlibsettings);
-				lodepng_free(dummy);
-				/*check if this is smallest size (or if type == 0 it's the first case so always store the values)*/
-				if (type == 0 || size[type] < smallest)
-				{
-					bestType = type;
-					smallest = size[type];
-				}
-			}
-			prevline = &in[y * linebytes];
-			out[y * (linebytes + 1)] = bestType; /*the first byte of a scanline will be the filter type*/
-			for (x = 0; x != linebytes; ++x) out[y * (linebytes + 1) + 1 + x] = attempt[bestType][x];
-		}
-		for (type = 0; type != 5; ++type) lodepng_free(attempt[type]);
-	}
-	else return 88; /* unknown filter strategy */
-
-	return error;
+    const LodePNGColorMode* info, const LodePNGEncoderSettings* settings)
+{
+    /*
+    For PNG filter method 0
+    out must be a buffer with as size: h + (w * h * bpp + 7) / 8, because there are
+    the scanlines with 1 extra byte per scanline
+    */
+
+    unsigned bpp = lodepng_get_bpp(info);
+    /*the width of a scanline in bytes, not including the filter type*/
+    size_t linebytes = (w * bpp + 7) / 8;
+    /*bytewidth is used for filtering, is 1 when bpp < 8, number of bytes per pixel otherwise*/
+    size_t bytewidth = (bpp + 7) / 8;
+    const unsigned char* prevline = 0;
+    unsigned char* attempt[5] = {0, 0, 0, 0, 0}; /*five filtering attempts, one for each filter type*/
+    unsigned type, y;
+    unsigned error = 0;
+    LodePNGFilterStrategy strategy = getFilterStrategy(info, settings);
+
+    if (bpp == 0) return 31; /*error: invalid color type*/
+
+    if (strategy != LFS_ZERO && strategy != LFS_PREDEFINED)
+    {
+        for (type = 0; type != 5 && !error; ++type)
+        {
+            attempt[type] = (unsigned char*)lodepng_malloc(linebytes);
+            if (!attempt[type]) error = 83; /*alloc fail*/
+        }
+    }
+
+    for (y = 0; y != h && !error; ++y)
+    {
+        size_t outindex = (1 + linebytes) * y; /*the extra filterbyte added to each row*/
+        size_t inindex = linebytes * y;
+        error = filterRow(&out[outindex], &in[inindex], prevline, linebytes, bytewidth, y, strategy, settings, attempt);
+        prevline = &in[inindex];
+    }
+
+    for (type = 0; type != 5; ++type) lodepng_free(attempt[type]);
+    return error;
 }
 
 static void addPaddingBits(unsigned char* out, const unsigned char* in,
-	size_t olinebits, size_t ilinebits, unsigned h)
-{
-	/*The opposite of the removePaddingBits function
-	olinebits must be >= ilinebits*/
-	unsigned y;
-	size_t diff = olinebits - ilinebits;
-	size_t obp = 0, ibp = 0; /*bit pointers*/
-	for (y = 0; y != h; ++y)
-	{
-		size_t x;
-		for (x = 0; x < ilinebits; ++x)
-		{
-			unsigned char bit = readBitFromReversedStream(&ibp, in);
-			setBitOfReversedStream(&obp, out, bit);
-		}
-		/*obp += diff; --> no, fill in some value in the padding bits too, to avoid
-		"Use of uninitialised value of size ###" warning from valgrind*/
-		for (x = 0; x != diff; ++x) setBitOfReversedStream(&obp, out, 0);
-	}
+    size_t olinebits, size_t ilinebits, unsigned h)
+{
+    /*The opposite of the removePaddingBits function
+    olinebits must be >= ilinebits*/
+    unsigned y;
+    size_t diff = olinebits - ilinebits;
+    size_t obp = 0, ibp = 0; /*bit pointers*/
+    for (y = 0; y != h; ++y)
+    {
+        size_t x;
+        for (x = 0; x < ilinebits; ++x)
+        {
+            unsigned char bit = readBitFromReversedStream(&ibp, in);
+            setBitOfReversedStream(&obp, out, bit);
+        }
+        /*obp += diff; --> no, fill in some value in the padding bits too, to avoid
+        "Use of uninitialised value of size ###" warning from valgrind*/
+        for (x = 0; x != diff; ++x) setBitOfReversedStream(&obp, out, 0);
+    }
 }
 
 /*
@@ -5456,140 +7281,140 @@ NOTE: comments about padding bits are only relevant if bpp < 8
 */
 static void Adam7_interlace(unsigned char* out, const unsigned char* in, unsigned w, unsigned h, unsigned bpp)
 {
-	unsigned passw[7], passh[7];
-	size_t filter_passstart[8], padded_passstart[8], passstart[8];
-	unsigned i;
-
-	Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
-
-	if (bpp >= 8)
-	{
-		for (i = 0; i != 7; ++i)
-		{
-			unsigned x, y, b;
-			size_t bytewidth = bpp / 8;
-			for (y = 0; y < passh[i]; ++y)
-				for (x = 0; x < passw[i]; ++x)
-				{
-				size_t pixelinstart = ((ADAM7_IY[i] + y * ADAM7_DY[i]) * w + ADAM7_IX[i] + x * ADAM7_DX[i]) * bytewidth;
-				size_t pixeloutstart = passstart[i] + (y * passw[i] + x) * bytewidth;
-				for (b = 0; b < bytewidth; ++b)
-				{
-					out[pixeloutstart + b] = in[pixelinstart + b];
-				}
-				}
-		}
-	}
-	else /*bpp < 8: Adam7 with pixels < 8 bit is a bit trickier: with bit pointers*/
-	{
-		for (i = 0; i != 7; ++i)
-		{
-			unsigned x, y, b;
-			unsigned ilinebits = bpp * passw[i];
-			unsigned olinebits = bpp * w;
-			size_t obp, ibp; /*bit pointers (for out and in buffer)*/
-			for (y = 0; y < passh[i]; ++y)
-				for (x = 0; x < passw[i]; ++x)
-				{
-				ibp = (ADAM7_IY[i] + y * ADAM7_DY[i]) * olinebits + (ADAM7_IX[i] + x * ADAM7_DX[i]) * bpp;
-				obp = (8 * passstart[i]) + (y * ilinebits + x * bpp);
-				for (b = 0; b < bpp; ++b)
-				{
-					unsigned char bit = readBitFromReversedStream(&ibp, in);
-					setBitOfReversedStream(&obp, out, bit);
-				}
-				}
-		}
-	}
+    unsigned passw[7], passh[7];
+    size_t filter_passstart[8], padded_passstart[8], passstart[8];
+    unsigned i;
+
+    Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
+
+    if (bpp >= 8)
+    {
+        for (i = 0; i != 7; ++i)
+        {
+            unsigned x, y, b;
+            size_t bytewidth = bpp / 8;
+            for (y = 0; y < passh[i]; ++y)
+                for (x = 0; x < passw[i]; ++x)
+                {
+                size_t pixelinstart = ((ADAM7_IY[i] + y * ADAM7_DY[i]) * w + ADAM7_IX[i] + x * ADAM7_DX[i]) * bytewidth;
+                size_t pixeloutstart = passstart[i] + (y * passw[i] + x) * bytewidth;
+                for (b = 0; b < bytewidth; ++b)
+                {
+                    out[pixeloutstart + b] = in[pixelinstart + b];
+                }
+                }
+        }
+    }
+    else /*bpp < 8: Adam7 with pixels < 8 bit is a bit trickier: with bit pointers*/
+    {
+        for (i = 0; i != 7; ++i)
+        {
+            unsigned x, y, b;
+            unsigned ilinebits = bpp * passw[i];
+            unsigned olinebits = bpp * w;
+            size_t obp, ibp; /*bit pointers (for out and in buffer)*/
+            for (y = 0; y < passh[i]; ++y)
+                for (x = 0; x < passw[i]; ++x)
+                {
+                ibp = (ADAM7_IY[i] + y * ADAM7_DY[i]) * olinebits + (ADAM7_IX[i] + x * ADAM7_DX[i]) * bpp;
+                obp = (8 * passstart[i]) + (y * ilinebits + x * bpp);
+                for (b = 0; b < bpp; ++b)
+                {
+                    unsigned char bit = readBitFromReversedStream(&ibp, in);
+                    setBitOfReversedStream(&obp, out, bit);
+                }
+                }
+        }
+    }
 }
 
 /*out must be buffer big enough to contain uncompressed IDAT chunk data, and in must contain the full image.
 return value is error**/
 static unsigned preProcessScanlines(unsigned char** out, size_t* outsize, const unsigned char* in,
-	unsigned w, unsigned h,
-	const LodePNGInfo* info_png, const LodePNGEncoderSettings* settings)
-{
-	/*
-	This function converts the pure 2D image with the PNG's colortype, into filtered-padded-interlaced data. Steps:
-	*) if no Adam7: 1) add padding bits (= posible extra bits per scanline if bpp < 8) 2) filter
-	*) if adam7: 1) Adam7_interlace 2) 7x add padding bits 3) 7x filter
-	*/
-	unsigned bpp = lodepng_get_bpp(&info_png->color);
-	unsigned error = 0;
-
-	if (info_png->interlace_method == 0)
-	{
-		*outsize = h + (h * ((w * bpp + 7) / 8)); /*image size plus an extra byte per scanline + possible padding bits*/
-		*out = (unsigned char*)lodepng_malloc(*outsize);
-		if (!(*out) && (*outsize)) error = 83; /*alloc fail*/
-
-		if (!error)
-		{
-			/*non multiple of 8 bits per scanline, padding bits needed per scanline*/
-			if (bpp < 8 && w * bpp != ((w * bpp + 7) / 8) * 8)
-			{
-				unsigned char* padded = (unsigned char*)lodepng_malloc(h * ((w * bpp + 7) / 8));
-				if (!padded) error = 83; /*alloc fail*/
-				if (!error)
-				{
-					addPaddingBits(padded, in, ((w * bpp + 7) / 8) * 8, w * bpp, h);
-					error = filter(*out, padded, w, h, &info_png->color, settings);
-				}
-				lodepng_free(padded);
-			}
-			else
-			{
-				/*we can immediately filter into the out buffer, no other steps needed*/
-				error = filter(*out, in, w, h, &info_png->color, settings);
-			}
-		}
-	}
-	else /*interlace_method is 1 (Adam7)*/
-	{
-		unsigned passw[7], passh[7];
-		size_t filter_passstart[8], padded_passstart[8], passstart[8];
-		unsigned char* adam7;
-
-		Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
-
-		*outsize = filter_passstart[7]; /*image size plus an extra byte per scanline + possible padding bits*/
-		*out = (unsigned char*)lodepng_malloc(*outsize);
-		if (!(*out)) error = 83; /*alloc fail*/
-
-		adam7 = (unsigned char*)lodepng_malloc(passstart[7]);
-		if (!adam7 && passstart[7]) error = 83; /*alloc fail*/
-
-		if (!error)
-		{
-			unsigned i;
-
-			Adam7_interlace(adam7, in, w, h, bpp);
-			for (i = 0; i != 7; ++i)
-			{
-				if (bpp < 8)
-				{
-					unsigned char* padded = (unsigned char*)lodepng_malloc(padded_passstart[i + 1] - padded_passstart[i]);
-					if (!padded) ERROR_BREAK(83); /*alloc fail*/
-					addPaddingBits(padded, &adam7[passstart[i]],
-						((passw[i] * bpp + 7) / 8) * 8, passw[i] * bpp, passh[i]);
-					error = filter(&(*out)[filter_passstart[i]], padded,
-						passw[i], passh[i], &info_png->color, settings);
-					lodepng_free(padded);
-				}
-				else
-				{
-					error = filter(&(*out)[filter_passstart[i]], &adam7[padded_passstart[i]],
-						passw[i], passh[i], &info_png->color, settings);
-				}
-
-				if (error) break;
-			}
-		}
-
-		lodepng_free(adam7);
-	}
-
-	return error;
+    unsigned w, unsigned h,
+    const LodePNGInfo* info_png, const LodePNGEncoderSettings* settings)
+{
+    /*
+    This function converts the pure 2D image with the PNG's colortype, into filtered-padded-interlaced data. Steps:
+    *) if no Adam7: 1) add padding bits (= posible extra bits per scanline if bpp < 8) 2) filter
+    *) if adam7: 1) Adam7_interlace 2) 7x add padding bits 3) 7x filter
+    */
+    unsigned bpp = lodepng_get_bpp(&info_png->color);
+    unsigned error = 0;
+
+    if (info_png->interlace_method == 0)
+    {
+        *outsize = h + (h * ((w * bpp + 7) / 8)); /*image size plus an extra byte per scanline + possible padding bits*/
+        *out = (unsigned char*)lodepng_malloc(*outsize);
+        if (!(*out) && (*outsize)) error = 83; /*alloc fail*/
+
+        if (!error)
+        {
+            /*non multiple of 8 bits per scanline, padding bits needed per scanline*/
+            if (bpp < 8 && w * bpp != ((w * bpp + 7) / 8) * 8)
+            {
+                unsigned char* padded = (unsigned char*)lodepng_malloc(h * ((w * bpp + 7) / 8));
+                if (!padded) error = 83; /*alloc fail*/
+                if (!error)
+                {
+                    addPaddingBits(padded, in, ((w * bpp + 7) / 8) * 8, w * bpp, h);
+                    error = filter(*out, padded, w, h, &info_png->color, settings);
+                }
+                lodepng_free(padded);
+            }
+            else
+            {
+                /*we can immediately filter into the out buffer, no other steps needed*/
+                error = filter(*out, in, w, h, &info_png->color, settings);
+            }
+        }
+    }
+    else /*interlace_method is 1 (Adam7)*/
+    {
+        unsigned passw[7], passh[7];
+        size_t filter_passstart[8], padded_passstart[8], passstart[8];
+        unsigned char* adam7;
+
+        Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
+
+        *outsize = filter_passstart[7]; /*image size plus an extra byte per scanline + possible padding bits*/
+        *out = (unsigned char*)lodepng_malloc(*outsize);
+        if (!(*out)) error = 83; /*alloc fail*/
+
+        adam7 = (unsigned char*)lodepng_malloc(passstart[7]);
+        if (!adam7 && passstart[7]) error = 83; /*alloc fail*/
+
+        if (!error)
+        {
+            unsigned i;
+
+            Adam7_interlace(adam7, in, w, h, bpp);
+            for (i = 0; i != 7; ++i)
+            {
+                if (bpp < 8)
+                {
+                    unsigned char* padded = (unsigned char*)lodepng_malloc(padded_passstart[i + 1] - padded_passstart[i]);
+                    if (!padded) ERROR_BREAK(83); /*alloc fail*/
+                    addPaddingBits(padded, &adam7[passstart[i]],
+                        ((passw[i] * bpp + 7) / 8) * 8, passw[i] * bpp, passh[i]);
+                    error = filter(&(*out)[filter_passstart[i]], padded,
+                        passw[i], passh[i], &info_png->color, settings);
+                    lodepng_free(padded);
+                }
+                else
+                {
+                    error = filter(&(*out)[filter_passstart[i]], &adam7[padded_passstart[i]],
+                        passw[i], passh[i], &info_png->color, settings);
+                }
+
+                if (error) break;
+            }
+        }
+
+        lodepng_free(adam7);
+    }
+
+    return error;
 }
 
 /*
@@ -5600,291 +7425,464 @@ returns 2 if the palette is semi-translucent.
 */
 static unsigned getPaletteTranslucency(const unsigned char* palette, size_t palettesize)
 {
-	size_t i;
-	unsigned key = 0;
-	unsigned r = 0, g = 0, b = 0; /*the value of the color with alpha 0, so long as color keying is possible*/
-	for (i = 0; i != palettesize; ++i)
-	{
-		if (!key && palette[4 * i + 3] == 0)
-		{
-			r = palette[4 * i + 0]; g = palette[4 * i + 1]; b = palette[4 * i + 2];
-			key = 1;
-			i = (size_t)(-1); /*restart from beginning, to detect earlier opaque colors with key's value*/
-		}
-		else if (palette[4 * i + 3] != 255) return 2;
-		/*when key, no opaque RGB may have key's RGB*/
-		else if (key && r == palette[i * 4 + 0] && g == palette[i * 4 + 1] && b == palette[i * 4 + 2]) return 2;
-	}
-	return key;
+    size_t i;
+    unsigned key = 0;
+    unsigned r = 0, g = 0, b = 0; /*the value of the color with alpha 0, so long as color keying is possible*/
+    for (i = 0; i != palettesize; ++i)
+    {
+        if (!key && palette[4 * i + 3] == 0)
+        {
+            r = palette[4 * i + 0]; g = palette[4 * i + 1]; b = palette[4 * i + 2];
+            key = 1;
+            i = (size_t)(-1); /*restart from beginning, to detect earlier opaque colors with key's value*/
+        }
+        else if (palette[4 * i + 3] != 255) return 2;
+        /*when key, no opaque RGB may have key's RGB*/
+        else if (key && r == palette[i * 4 + 0] && g == palette[i * 4 + 1] && b == palette[i * 4 + 2]) return 2;
+    }
+    return key;
 }
 
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
 static unsigned addUnknownChunks(ucvector* out, unsigned char* data, size_t datasize)
 {
-	unsigned char* inchunk = data;
-	while ((size_t)(inchunk - data) < datasize)
-	{
-		CERROR_TRY_RETURN(lodepng_chunk_append(&out->data, &out->size, inchunk));
-		out->allocsize = out->size; /*fix the allocsize again*/
-		inchunk = lodepng_chunk_next(inchunk);
-	}
-	return 0;
+    unsigned char* inchunk = data;
+    while ((size_t)(inchunk - data) < datasize)
+    {
+        CERROR_TRY_RETURN(lodepng_chunk_append(&out->data, &out->size, inchunk));
+        out->allocsize = out->size; /*fix the allocsize again*/
+        inchunk = lodepng_chunk_next(inchunk);
+    }
+    return 0;
 }
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
 unsigned lodepng_encode(unsigned char** out, size_t* outsize,
-	const unsigned char* image, unsigned w, unsigned h,
-	LodePNGState* state)
-{
-	LodePNGInfo info;
-	ucvector outv;
-	unsigned char* data = 0; /*uncompressed version of the IDAT chunk data*/
-	size_t datasize = 0;
-
-	/*provide some proper output values if error will happen*/
-	*out = 0;
-	*outsize = 0;
-	state->error = 0;
-
-	lodepng_info_init(&info);
-	lodepng_info_copy(&info, &state->info_png);
-
-	if ((info.color.colortype == LCT_PALETTE || state->encoder.force_palette)
-		&& (info.color.palettesize == 0 || info.color.palettesize > 256))
-	{
-		state->error = 68; /*invalid palette size, it is only allowed to be 1-256*/
-		return state->error;
-	}
-
-	if (state->encoder.auto_convert)
-	{
-		state->error = lodepng_auto_choose_color(&info.color, image, w, h, &state->info_raw);
-	}
-	if (state->error) return state->error;
-
-	if (state->encoder.zlibsettings.btype > 2)
-	{
-		CERROR_RETURN_ERROR(state->error, 61); /*error: unexisting btype*/
-	}
-	if (state->info_png.interlace_method > 1)
-	{
-		CERROR_RETURN_ERROR(state->error, 71); /*error: unexisting interlace mode*/
-	}
-
-	state->error = checkColorValidity(info.color.colortype, info.color.bitdepth);
-	if (state->error) return state->error; /*error: unexisting color type given*/
-	state->error = checkColorValidity(state->info_raw.colortype, state->info_raw.bitdepth);
-	if (state->error) return state->error; /*error: unexisting color type given*/
-
-	if (!lodepng_color_mode_equal(&state->info_raw, &info.color))
-	{
-		unsigned char* converted;
-		size_t size = (w * h * lodepng_get_bpp(&info.color) + 7) / 8;
-
-		converted = (unsigned char*)lodepng_malloc(size);
-		if (!converted && size) state->error = 83; /*alloc fail*/
-		if (!state->error)
-		{
-			state->error = lodepng_convert(converted, image, &info.color, &state->info_raw, w, h);
-		}
-		if (!state->error) preProcessScanlines(&data, &datasize, converted, w, h, &info, &state->encoder);
-		lodepng_free(converted);
-	}
-	else preProcessScanlines(&data, &datasize, image, w, h, &info, &state->encoder);
-
-	ucvector_init(&outv);
-	while (!state->error) /*while only executed once, to break on error*/
-	{
+    const unsigned char* image, unsigned w, unsigned h,
+    LodePNGState* state)
+{
+    LodePNGInfo info;
+    ucvector outv;
+    unsigned char* data = 0; /*uncompressed version of the IDAT chunk data*/
+    size_t datasize = 0;
+
+    /*provide some proper output values if error will happen*/
+    *out = 0;
+    *outsize = 0;
+    state->error = 0;
+
+    lodepng_info_init(&info);
+    lodepng_info_copy(&info, &state->info_png);
+
+    if ((info.color.colortype == LCT_PALETTE || state->encoder.force_palette)
+        && (info.color.palettesize == 0 || info.color.palettesize > 256))
+    {
+        state->error = 68; /*invalid palette size, it is only allowed to be 1-256*/
+        return state->error;
+    }
+
+    if (state->encoder.auto_convert)
+    {
+        state->error = lodepng_auto_choose_color(&info.color, image, w, h, &state->info_raw);
+    }
+    if (state->error) return state->error;
+
+    if (state->encoder.zlibsettings.btype > 2)
+    {
+        CERROR_RETURN_ERROR(state->error, 61); /*error: unexisting btype*/
+    }
+    if (state->info_png.interlace_method > 1)
+    {
+        CERROR_RETURN_ERROR(state->error, 71); /*error: unexisting interlace mode*/
+    }
+
+    state->error = checkColorValidity(info.color.colortype, info.color.bitdepth);
+    if (state->error) return state->error; /*error: unexisting color type given*/
+    state->error = checkColorValidity(state->info_raw.colortype, state->info_raw.bitdepth);
+    if (state->error) return state->error; /*error: unexisting color type given*/
+
+    if (!lodepng_color_mode_equal(&state->info_raw, &info.color))
+    {
+        unsigned char* converted;
+        size_t size = (w * h * lodepng_get_bpp(&info.color) + 7) / 8;
+
+        converted = (unsigned char*)lodepng_malloc(size);
+        if (!converted && size) state->error = 83; /*alloc fail*/
+        if (!state->error)
+        {
+            state->error = lodepng_convert(converted, image, &info.color, &state->info_raw, w, h);
+        }
+        if (!state->error) preProcessScanlines(&data, &datasize, converted, w, h, &info, &state->encoder);
+        lodepng_free(converted);
+    }
+    else preProcessScanlines(&data, &datasize, image, w, h, &info, &state->encoder);
+
+    ucvector_init(&outv);
+    while (!state->error) /*while only executed once, to break on error*/
+    {
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-		size_t i;
+        size_t i;
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-		/*write signature and chunks*/
-		writeSignature(&outv);
-		/*IHDR*/
-		addChunk_IHDR(&outv, w, h, info.color.colortype, info.color.bitdepth, info.interlace_method);
+        /*write signature and chunks*/
+        writeSignature(&outv);
+        /*IHDR*/
+        addChunk_IHDR(&outv, w, h, info.color.colortype, info.color.bitdepth, info.interlace_method);
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-		/*unknown chunks between IHDR and PLTE*/
-		if (info.unknown_chunks_data[0])
-		{
-			state->error = addUnknownChunks(&outv, info.unknown_chunks_data[0], info.unknown_chunks_size[0]);
-			if (state->error) break;
-		}
+        /*unknown chunks between IHDR and PLTE*/
+        if (info.unknown_chunks_data[0])
+        {
+            state->error = addUnknownChunks(&outv, info.unknown_chunks_data[0], info.unknown_chunks_size[0]);
+            if (state->error) break;
+        }
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-		/*PLTE*/
-		if (info.color.colortype == LCT_PALETTE)
-		{
-			addChunk_PLTE(&outv, &info.color);
-		}
-		if (state->encoder.force_palette && (info.color.colortype == LCT_RGB || info.color.colortype == LCT_RGBA))
-		{
-			addChunk_PLTE(&outv, &info.color);
-		}
-		/*tRNS*/
-		if (info.color.colortype == LCT_PALETTE && getPaletteTranslucency(info.color.palette, info.color.palettesize) != 0)
-		{
-			addChunk_tRNS(&outv, &info.color);
-		}
-		if ((info.color.colortype == LCT_GREY || info.color.colortype == LCT_RGB) && info.color.key_defined)
-		{
-			addChunk_tRNS(&outv, &info.color);
-		}
+        /*PLTE*/
+        if (info.color.colortype == LCT_PALETTE)
+        {
+            addChunk_PLTE(&outv, &info.color);
+        }
+        if (state->encoder.force_palette && (info.color.colortype == LCT_RGB || info.color.colortype == LCT_RGBA))
+        {
+            addChunk_PLTE(&outv, &info.color);
+        }
+        /*tRNS*/
+        if (info.color.colortype == LCT_PALETTE && getPaletteTranslucency(info.color.palette, info.color.palettesize) != 0)
+        {
+            addChunk_tRNS(&outv, &info.color);
+        }
+        if ((info.color.colortype == LCT_GREY || info.color.colortype == LCT_RGB) && info.color.key_defined)
+        {
+            addChunk_tRNS(&outv, &info.color);
+        }
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-		/*bKGD (must come between PLTE and the IDAt chunks*/
-		if (info.background_defined) addChunk_bKGD(&outv, &info);
-		/*pHYs (must come before the IDAT chunks)*/
-		if (info.phys_defined) addChunk_pHYs(&outv, &info);
-
-		/*unknown chunks between PLTE and IDAT*/
-		if (info.unknown_chunks_data[1])
-		{
-			state->error = addUnknownChunks(&outv, info.unknown_chunks_data[1], info.unknown_chunks_size[1]);
-			if (state->error) break;
-		}
+        /*bKGD (must come between PLTE and the IDAt chunks*/
+        if (info.background_defined) addChunk_bKGD(&outv, &info);
+        /*pHYs (must come before the IDAT chunks)*/
+        if (info.phys_defined) addChunk_pHYs(&outv, &info);
+
+        /*unknown chunks between PLTE and IDAT*/
+        if (info.unknown_chunks_data[1])
+        {
+            state->error = addUnknownChunks(&outv, info.unknown_chunks_data[1], info.unknown_chunks_size[1]);
+            if (state->error) break;
+        }
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-		/*IDAT (multiple IDAT chunks must be consecutive)*/
-		state->error = addChunk_IDAT(&outv, data, datasize, &state->encoder.zlibsettings);
-		if (state->error) break;
+        /*IDAT (multiple IDAT chunks must be consecutive)*/
+        state->error = addChunk_IDAT(&outv, data, datasize, &state->encoder.zlibsettings);
+        if (state->error) break;
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-		/*tIME*/
-		if (info.time_defined) addChunk_tIME(&outv, &info.time);
-		/*tEXt and/or zTXt*/
-		for (i = 0; i != info.text_num; ++i)
-		{
-			if (strlen(info.text_keys[i]) > 79)
-			{
-				state->error = 66; /*text chunk too large*/
-				break;
-			}
-			if (strlen(info.text_keys[i]) < 1)
-			{
-				state->error = 67; /*text chunk too small*/
-				break;
-			}
-			if (state->encoder.text_compression)
-			{
-				addChunk_zTXt(&outv, info.text_keys[i], info.text_strings[i], &state->encoder.zlibsettings);
-			}
-			else
-			{
-				addChunk_tEXt(&outv, info.text_keys[i], info.text_strings[i]);
-			}
-		}
-		/*LodePNG version id in text chunk*/
-		if (state->encoder.add_id)
-		{
-			unsigned alread_added_id_text = 0;
-			for (i = 0; i != info.text_num; ++i)
-			{
-				if (!strcmp(info.text_keys[i], "LodePNG"))
-				{
-					alread_added_id_text = 1;
-					break;
-				}
-			}
-			if (alread_added_id_text == 0)
-			{
-				addChunk_tEXt(&outv, "LodePNG", LODEPNG_VERSION_STRING); /*it's shorter as tEXt than as zTXt chunk*/
-			}
-		}
-		/*iTXt*/
-		for (i = 0; i != info.itext_num; ++i)
-		{
-			if (strlen(info.itext_keys[i]) > 79)
-			{
-				state->error = 66; /*text chunk too large*/
-				break;
-			}
-			if (strlen(info.itext_keys[i]) < 1)
-			{
-				state->error = 67; /*text chunk too small*/
-				break;
-			}
-			addChunk_iTXt(&outv, state->encoder.text_compression,
-				info.itext_keys[i], info.itext_langtags[i], info.itext_transkeys[i], info.itext_strings[i],
-				&state->encoder.zlibsettings);
-		}
-
-		/*unknown chunks between IDAT and IEND*/
-		if (info.unknown_chunks_data[2])
-		{
-			state->error = addUnknownChunks(&outv, info.unknown_chunks_data[2], info.unknown_chunks_size[2]);
-			if (state->error) break;
-		}
+        /*tIME*/
+        if (info.time_defined) addChunk_tIME(&outv, &info.time);
+        /*tEXt and/or zTXt*/
+        for (i = 0; i != info.text_num; ++i)
+        {
+            if (strlen(info.text_keys[i]) > 79)
+            {
+                state->error = 66; /*text chunk too large*/
+                break;
+            }
+            if (strlen(info.text_keys[i]) < 1)
+            {
+                state->error = 67; /*text chunk too small*/
+                break;
+            }
+            if (state->encoder.text_compression)
+            {
+                addChunk_zTXt(&outv, info.text_keys[i], info.text_strings[i], &state->encoder.zlibsettings);
+            }
+            else
+            {
+                addChunk_tEXt(&outv, info.text_keys[i], info.text_strings[i]);
+            }
+        }
+        /*LodePNG version id in text chunk*/
+        if (state->encoder.add_id)
+        {
+            unsigned alread_added_id_text = 0;
+            for (i = 0; i != info.text_num; ++i)
+            {
+                if (!strcmp(info.text_keys[i], "LodePNG"))
+                {
+                    alread_added_id_text = 1;
+                    break;
+                }
+            }
+            if (alread_added_id_text == 0)
+            {
+                addChunk_tEXt(&outv, "LodePNG", LODEPNG_VERSION_STRING); /*it's shorter as tEXt than as zTXt chunk*/
+            }
+        }
+        /*iTXt*/
+        for (i = 0; i != info.itext_num; ++i)
+        {
+            if (strlen(info.itext_keys[i]) > 79)
+            {
+                state->error = 66; /*text chunk too large*/
+                break;
+            }
+            if (strlen(info.itext_keys[i]) < 1)
+            {
+                state->error = 67; /*text chunk too small*/
+                break;
+            }
+            addChunk_iTXt(&outv, state->encoder.text_compression,
+                info.itext_keys[i], info.itext_langtags[i], info.itext_transkeys[i], info.itext_strings[i],
+                &state->encoder.zlibsettings);
+        }
+
+        /*unknown chunks between IDAT and IEND*/
+        if (info.unknown_chunks_data[2])
+        {
+            state->error = addUnknownChunks(&outv, info.unknown_chunks_data[2], info.unknown_chunks_size[2]);
+            if (state->error) break;
+        }
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-		addChunk_IEND(&outv);
-
-		break; /*this isn't really a while loop; no error happened so break out now!*/
-	}
-
-	lodepng_info_cleanup(&info);
-	lodepng_free(data);
-	/*instead of cleaning the vector up, give it to the output*/
-	*out = outv.data;
-	*outsize = outv.size;
+        addChunk_IEND(&outv);
+
+        break; /*this isn't really a while loop; no error happened so break out now!*/
+    }
+
+    lodepng_info_cleanup(&info);
+    lodepng_free(data);
+    /*instead of cleaning the vector up, give it to the output*/
+    *out = outv.data;
+    *outsize = outv.size;
+
+    return state->error;
+}
+
+struct LodePNGRowEncoder
+{
+    LodePNGState* state;
+    LodePNGWriteCallback callback;
+    void* user;
+    unsigned w, h, y;
+    size_t linebytes; /*the width of a scanline in bytes, not including the filter type*/
+    size_t bytewidth; /*1 when bpp < 8, number of bytes per pixel otherwise*/
+    LodePNGFilterStrategy strategy;
+    unsigned char* current; /*the row being encoded, in the color mode of the PNG*/
+    unsigned char* previous; /*the row before it, which the filters look at*/
+    unsigned char* filtered; /*filter type byte followed by the filtered row*/
+    unsigned char* attempt[5]; /*five filtering attempts, one for each filter type*/
+    ZlibStream zlib;
+    ucvector chunks; /*chunks that are ready to be written*/
+};
 
-	return state->error;
+/*hands the chunks that are ready to the callback*/
+static unsigned rowEncoderWrite(LodePNGRowEncoder* encoder)
+{
+    unsigned error = 0;
+    if (encoder->chunks.size) error = encoder->callback(encoder->user, encoder->chunks.data, encoder->chunks.size);
+    encoder->chunks.size = 0;
+    return error;
+}
+
+/*puts the compressed bytes that are complete in an IDAT chunk*/
+static unsigned rowEncoderAddIDAT(LodePNGRowEncoder* encoder)
+{
+    size_t size = zlib_stream_available(&encoder->zlib);
+    if (size == 0) return 0;
+    CERROR_TRY_RETURN(addChunk(&encoder->chunks, "IDAT", encoder->zlib.out.data, size));
+    zlib_stream_consume(&encoder->zlib);
+    return 0;
+}
+
+static void rowEncoderCleanup(LodePNGRowEncoder* encoder)
+{
+    unsigned type;
+    zlib_stream_cleanup(&encoder->zlib);
+    ucvector_cleanup(&encoder->chunks);
+    lodepng_free(encoder->current);
+    lodepng_free(encoder->previous);
+    lodepng_free(encoder->filtered);
+    for (type = 0; type != 5; ++type) lodepng_free(encoder->attempt[type]);
+    lodepng_free(encoder);
+}
+
+unsigned lodepng_row_encoder_begin(LodePNGRowEncoder** out, unsigned w, unsigned h, LodePNGState* state,
+    LodePNGWriteCallback callback, void* user)
+{
+    const LodePNGColorMode* color = &state->info_png.color;
+    LodePNGRowEncoder* encoder;
+    unsigned bpp, type;
+
+    *out = 0;
+    state->error = 0;
+
+    if ((color->colortype == LCT_PALETTE || state->encoder.force_palette)
+        && (color->palettesize == 0 || color->palettesize > 256))
+    {
+        CERROR_RETURN_ERROR(state->error, 68); /*invalid palette size, it is only allowed to be 1-256*/
+    }
+    if (state->info_png.interlace_method != 0)
+    {
+        CERROR_RETURN_ERROR(state->error, 95); /*error: the row encoder does not interlace*/
+    }
+    if (w == 0 || h == 0) CERROR_RETURN_ERROR(state->error, 93);
+    state->error = checkColorValidity(color->colortype, color->bitdepth);
+    if (state->error) return state->error; /*error: unexisting color type given*/
+    state->error = checkColorValidity(state->info_raw.colortype, state->info_raw.bitdepth);
+    if (state->error) return state->error; /*error: unexisting color type given*/
+
+    encoder = (LodePNGRowEncoder*)lodepng_malloc(sizeof(LodePNGRowEncoder));
+    if (!encoder) CERROR_RETURN_ERROR(state->error, 83); /*alloc fail*/
+
+    bpp = lodepng_get_bpp(color);
+    encoder->state = state;
+    encoder->callback = callback;
+    encoder->user = user;
+    encoder->w = w;
+    encoder->h = h;
+    encoder->y = 0;
+    encoder->linebytes = ((size_t)w * bpp + 7) / 8;
+    encoder->bytewidth = (bpp + 7) / 8;
+    encoder->strategy = getFilterStrategy(color, &state->encoder);
+    encoder->current = (unsigned char*)lodepng_malloc(encoder->linebytes);
+    encoder->previous = (unsigned char*)lodepng_malloc(encoder->linebytes);
+    encoder->filtered = (unsigned char*)lodepng_malloc(encoder->linebytes + 1);
+    for (type = 0; type != 5; ++type) encoder->attempt[type] = 0;
+    ucvector_init(&encoder->chunks);
+    state->error = zlib_stream_init(&encoder->zlib, (encoder->linebytes + 1) * h, &state->encoder.zlibsettings);
+
+    if (!state->error && (!encoder->current || !encoder->previous || !encoder->filtered)) state->error = 83;
+    if (!state->error && encoder->strategy != LFS_ZERO && encoder->strategy != LFS_PREDEFINED)
+    {
+        for (type = 0; type != 5 && !state->error; ++type)
+        {
+            encoder->attempt[type] = (unsigned char*)lodepng_malloc(encoder->linebytes);
+            if (!encoder->attempt[type]) state->error = 83; /*alloc fail*/
+        }
+    }
+
+    /*everything before the image data*/
+    if (!state->error)
+    {
+        writeSignature(&encoder->chunks);
+        state->error = addChunk_IHDR(&encoder->chunks, w, h, color->colortype, color->bitdepth, 0);
+    }
+    if (!state->error && (color->colortype == LCT_PALETTE
+        || (state->encoder.force_palette && (color->colortype == LCT_RGB || color->colortype == LCT_RGBA))))
+    {
+        state->error = addChunk_PLTE(&encoder->chunks, color);
+    }
+    if (!state->error && ((color->colortype == LCT_PALETTE && getPaletteTranslucency(color->palette, color->palettesize) != 0)
+        || ((color->colortype == LCT_GREY || color->colortype == LCT_RGB) && color->key_defined)))
+    {
+        state->error = addChunk_tRNS(&encoder->chunks, color);
+    }
+    if (!state->error) state->error = rowEncoderWrite(encoder);
+
+    if (state->error) rowEncoderCleanup(encoder);
+    else *out = encoder;
+    return state->error;
+}
+
+unsigned lodepng_row_encoder_add(LodePNGRowEncoder* encoder, const unsigned char* row)
+{
+    LodePNGState* state = encoder->state;
+    const unsigned char* prevline = encoder->y == 0 ? 0 : encoder->previous;
+    size_t remaining = encoder->zlib.remaining;
+    unsigned char* swap;
+
+    if (state->error) return state->error;
+    if (encoder->y == encoder->h) CERROR_RETURN_ERROR(state->error, 96); /*error: more rows than the image height*/
+
+    if (lodepng_color_mode_equal(&state->info_raw, &state->info_png.color))
+    {
+        memcpy(encoder->current, row, encoder->linebytes);
+    }
+    else
+    {
+        /*bits of pixels smaller than a byte are or-ed into the row*/
+        memset(encoder->current, 0, encoder->linebytes);
+        state->error = lodepng_convert(encoder->current, row, &state->info_png.color, &state->info_raw, encoder->w, 1);
+    }
+    if (!state->error)
+    {
+        state->error = filterRow(encoder->filtered, encoder->current, prevline, encoder->linebytes, encoder->bytewidth,
+            encoder->y, encoder->strategy, &state->encoder, encoder->attempt);
+    }
+    if (!state->error) state->error = zlib_stream_add(&encoder->zlib, encoder->filtered, encoder->linebytes + 1);
+    /*an IDAT chunk is written whenever a deflate block was completed*/
+    if (!state->error && encoder->zlib.remaining != remaining) state->error = rowEncoderAddIDAT(encoder);
+    if (!state->error) state->error = rowEncoderWrite(encoder);
+
+    swap = encoder->previous;
+    encoder->previous = encoder->current;
+    encoder->current = swap;
+    ++encoder->y;
+    return state->error;
+}
+
+unsigned lodepng_row_encoder_end(LodePNGRowEncoder* encoder)
+{
+    LodePNGState* state = encoder->state;
+    if (!state->error && encoder->y != encoder->h) state->error = 96; /*error: fewer rows than the image height*/
+    if (!state->error) state->error = addChunk_IEND(&encoder->chunks);
+    if (!state->error) state->error = rowEncoderWrite(encoder);
+    rowEncoderCleanup(encoder);
+    return state->error;
 }
 
 unsigned lodepng_encode_memory(unsigned char** out, size_t* outsize, const unsigned char* image,
-	unsigned w, unsigned h, LodePNGColorType colortype, unsigned bitdepth)
+    unsigned w, unsigned h, LodePNGColorType colortype, unsigned bitdepth)
 {
-	unsigned error;
-	LodePNGState state;
-	lodepng_state_init(&state);
-	state.info_raw.colortype = colortype;
-	state.info_raw.bitdepth = bitdepth;
-	state.info_png.color.colortype = colortype;
-	state.info_png.color.bitdepth = bitdepth;
-	lodepng_encode(out, outsize, image, w, h, &state);
-	error = state.error;
-	lodepng_state_cleanup(&state);
-	return error;
+    unsigned error;
+    LodePNGState state;
+    lodepng_state_init(&state);
+    state.info_raw.colortype = colortype;
+    state.info_raw.bitdepth = bitdepth;
+    state.info_png.color.colortype = colortype;
+    state.info_png.color.bitdepth = bitdepth;
+    lodepng_encode(out, outsize, image, w, h, &state);
+    error = state.error;
+    lodepng_state_cleanup(&state);
+    return error;
 }
 
 unsigned lodepng_encode32(unsigned char** out, size_t* outsize, const unsigned char* image, unsigned w, unsigned h)
 {
-	return lodepng_encode_memory(out, outsize, image, w, h, LCT_RGBA, 8);
+    return lodepng_encode_memory(out, outsize, image, w, h, LCT_RGBA, 8);
 }
 
 unsigned lodepng_encode24(unsigned char** out, size_t* outsize, const unsigned char* image, unsigned w, unsigned h)
 {
-	return lodepng_encode_memory(out, outsize, image, w, h, LCT_RGB, 8);
+    return lodepng_encode_memory(out, outsize, image, w, h, LCT_RGB, 8);
 }
 
 #ifdef LODEPNG_COMPILE_DISK
 unsigned lodepng_encode_file(const char* filename, const unsigned char* image, unsigned w, unsigned h,
-	LodePNGColorType colortype, unsigned bitdepth)
+    LodePNGColorType colortype, unsigned bitdepth)
 {
-	unsigned char* buffer;
-	size_t buffersize;
-	unsigned error = lodepng_encode_memory(&buffer, &buffersize, image, w, h, colortype, bitdepth);
-	if (!error) error = lodepng_save_file(buffer, buffersize, filename);
-	lodepng_free(buffer);
-	return error;
+    unsigned char* buffer;
+    size_t buffersize;
+    unsigned error = lodepng_encode_memory(&buffer, &buffersize, image, w, h, colortype, bitdepth);
+    if (!error) error = lodepng_save_file(buffer, buffersize, filename);
+    lodepng_free(buffer);
+    return error;
 }
 
 unsigned lodepng_encode32_file(const char* filename, const unsigned char* image, unsigned w, unsigned h)
 {
-	return lodepng_encode_file(filename, image, w, h, LCT_RGBA, 8);
+    return lodepng_encode_file(filename, image, w, h, LCT_RGBA, 8);
 }
 
 unsigned lodepng_encode24_file(const char* filename, const unsigned char* image, unsigned w, unsigned h)
 {
-	return lodepng_encode_file(filename, image, w, h, LCT_RGB, 8);
+    return lodepng_encode_file(filename, image, w, h, LCT_RGB, 8);
 }
 #endif /*LODEPNG_COMPILE_DISK*/
 
 void lodepng_encoder_settings_init(LodePNGEncoderSettings* settings)
 {
-	lodepng_compress_settings_init(&settings->zlibsettings);
-	settings->filter_palette_zero = 1;
-	settings->filter_strategy = LFS_MINSUM;
-	settings->auto_convert = 1;
-	settings->force_palette = 0;
-	settings->predefined_filters = 0;
+    lodepng_compress_settings_init(&settings->zlibsettings);
+    settings->filter_palette_zero = 1;
+    settings->filter_strategy = LFS_MINSUM;
+    settings->auto_convert = 1;
+    settings->force_palette = 0;
+    settings->predefined_filters = 0;
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-	settings->add_id = 0;
-	settings->text_compression = 1;
+    settings->add_id = 0;
+    settings->text_compression = 1;
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 }
 
@@ -5898,103 +7896,105 @@ the documentation of all the error codes.
 */
 const char* lodepng_error_text(unsigned code)
 {
-	switch (code)
-	{
-	case 0: return "no error, everything went ok";
-	case 1: return "nothing done yet"; /*the Encoder/Decoder has done nothing yet, error checking makes no sense yet*/
-	case 10: return "end of input memory reached without huffman end code"; /*while huffman decoding*/
-	case 11: return "error in code tree made it jump outside of huffman tree"; /*while huffman decoding*/
-	case 13: return "problem while processing dynamic deflate block";
-	case 14: return "problem while processing dynamic deflate block";
-	case 15: return "problem while processing dynamic deflate block";
-	case 16: return "unexisting code while processing dynamic deflate block";
-	case 17: return "end of out buffer memory reached while inflating";
-	case 18: return "invalid distance code while inflating";
-	case 19: return "end of out buffer memory reached while inflating";
-	case 20: return "invalid deflate block BTYPE encountered while decoding";
-	case 21: return "NLEN is not ones complement of LEN in a deflate block";
-		/*end of out buffer memory reached while inflating:
-		This can happen if the inflated deflate data is longer than the amount of bytes required to fill up
-		all the pixels of the image, given the color depth and image dimensions. Something that doesn't
-		happen in a normal, well encoded, PNG image.*/
-	case 22: return "end of out buffer memory reached while inflating";
-	case 23: return "end of in buffer memory reached while inflating";
-	case 24: return "invalid FCHECK in zlib header";
-	case 25: return "invalid compression method in zlib header";
-	case 26: return "FDICT encountered in zlib header while it's not used for PNG";
-	case 27: return "PNG file is smaller than a PNG header";
-		/*Checks the magic file header, the first 8 bytes of the PNG file*/
-	case 28: return "incorrect PNG signature, it's no PNG or corrupted";
-	case 29: return "first chunk is not the header chunk";
-	case 30: return "chunk length too large, chunk broken off at end of file";
-	case 31: return "illegal PNG color type or bpp";
-	case 32: return "illegal PNG compression method";
-	case 33: return "illegal PNG filter method";
-	case 34: return "illegal PNG interlace method";
-	case 35: return "chunk length of a chunk is too large or the chunk too small";
-	case 36: return "illegal PNG filter type encountered";
-	case 37: return "illegal bit depth for this color type given";
-	case 38: return "the palette is too big"; /*more than 256 colors*/
-	case 39: return "more palette alpha values given in tRNS chunk than there are colors in the palette";
-	case 40: return "tRNS chunk has wrong size for greyscale image";
-	case 41: return "tRNS chunk has wrong size for RGB image";
-	case 42: return "tRNS chunk appeared while it was not allowed for this color type";
-	case 43: return "bKGD chunk has wrong size for palette image";
-	case 44: return "bKGD chunk has wrong size for greyscale image";
-	case 45: return "bKGD chunk has wrong size for RGB image";
-	case 48: return "empty input buffer given to decoder. Maybe caused by non-existing file?";
-	case 49: return "jumped past memory while generating dynamic huffman tree";
-	case 50: return "jumped past memory while generating dynamic huffman tree";
-	case 51: return "jumped past memory while inflating huffman block";
-	case 52: return "jumped past memory while inflating";
-	case 53: return "size of zlib data too small";
-	case 54: return "repeat symbol in tree while there was no value symbol yet";
-		/*jumped past tree while generating huffman tree, this could be when the
-		tree will have more leaves than symbols after generating it out of the
-		given lenghts. They call this an oversubscribed dynamic bit lengths tree in zlib.*/
-	case 55: return "jumped past tree while generating huffman tree";
-	case 56: return "given output image colortype or bitdepth not supported for color conversion";
-	case 57: return "invalid CRC encountered (checking CRC can be disabled)";
-	case 58: return "invalid ADLER32 encountered (checking ADLER32 can be disabled)";
-	case 59: return "requested color conversion not supported";
-	case 60: return "invalid window size given in the settings of the encoder (must be 0-32768)";
-	case 61: return "invalid BTYPE given in the settings of the encoder (only 0, 1 and 2 are allowed)";
-		/*LodePNG leaves the choice of RGB to greyscale conversion formula to the user.*/
-	case 62: return "conversion from color to greyscale not supported";
-	case 63: return "length of a chunk too long, max allowed for PNG is 2147483647 bytes per chunk"; /*(2^31-1)*/
-		/*this would result in the inability of a deflated block to ever contain an end code. It must be at least 1.*/
-	case 64: return "the length of the END symbol 256 in the Huffman tree is 0";
-	case 66: return "the length of a text chunk keyword given to the encoder is longer than the maximum of 79 bytes";
-	case 67: return "the length of a text chunk keyword given to the encoder is smaller than the minimum of 1 byte";
-	case 68: return "tried to encode a PLTE chunk with a palette that has less than 1 or more than 256 colors";
-	case 69: return "unknown chunk type with 'critical' flag encountered by the decoder";
-	case 71: return "unexisting interlace mode given to encoder (must be 0 or 1)";
-	case 72: return "while decoding, unexisting compression method encountering in zTXt or iTXt chunk (it must be 0)";
-	case 73: return "invalid tIME chunk size";
-	case 74: return "invalid pHYs chunk size";
-		/*length could be wrong, or data chopped off*/
-	case 75: return "no null termination char found while decoding text chunk";
-	case 76: return "iTXt chunk too short to contain required bytes";
-	case 77: return "integer overflow in buffer size";
-	case 78: return "failed to open file for reading"; /*file doesn't exist or couldn't be opened for reading*/
-	case 79: return "failed to open file for writing";
-	case 80: return "tried creating a tree of 0 symbols";
-	case 81: return "lazy matching at pos 0 is impossible";
-	case 82: return "color conversion to palette requested while a color isn't in palette";
-	case 83: return "memory allocation failed";
-	case 84: return "given image too small to contain all pixels to be encoded";
-	case 86: return "impossible offset in lz77 encoding (internal bug)";
-	case 87: return "must provide custom zlib function pointer if LODEPNG_COMPILE_ZLIB is not defined";
-	case 88: return "invalid filter strategy given for LodePNGEncoderSettings.filter_strategy";
-	case 89: return "text chunk keyword too short or long: must have size 1-79";
-		/*the windowsize in the LodePNGCompressSettings. Requiring POT(==> & instead of %) makes encoding 12% faster.*/
-	case 90: return "windowsize must be a power of two";
-	case 91: return "invalid decompressed idat size";
-	case 92: return "too many pixels, not supported";
-	case 93: return "zero width or height is invalid";
-	case 94: return "header chunk must have a size of 13 bytes";
-	}
-	return "unknown error code";
+    switch (code)
+    {
+    case 0: return "no error, everything went ok";
+    case 1: return "nothing done yet"; /*the Encoder/Decoder has done nothing yet, error checking makes no sense yet*/
+    case 10: return "end of input memory reached without huffman end code"; /*while huffman decoding*/
+    case 11: return "error in code tree made it jump outside of huffman tree"; /*while huffman decoding*/
+    case 13: return "problem while processing dynamic deflate block";
+    case 14: return "problem while processing dynamic deflate block";
+    case 15: return "problem while processing dynamic deflate block";
+    case 16: return "unexisting code while processing dynamic deflate block";
+    case 17: return "end of out buffer memory reached while inflating";
+    case 18: return "invalid distance code while inflating";
+    case 19: return "end of out buffer memory reached while inflating";
+    case 20: return "invalid deflate block BTYPE encountered while decoding";
+    case 21: return "NLEN is not ones complement of LEN in a deflate block";
+        /*end of out buffer memory reached while inflating:
+        This can happen if the inflated deflate data is longer than the amount of bytes required to fill up
+        all the pixels of the image, given the color depth and image dimensions. Something that doesn't
+        happen in a normal, well encoded, PNG image.*/
+    case 22: return "end of out buffer memory reached while inflating";
+    case 23: return "end of in buffer memory reached while inflating";
+    case 24: return "invalid FCHECK in zlib header";
+    case 25: return "invalid compression method in zlib header";
+    case 26: return "FDICT encountered in zlib header while it's not used for PNG";
+    case 27: return "PNG file is smaller than a PNG header";
+        /*Checks the magic file header, the first 8 bytes of the PNG file*/
+    case 28: return "incorrect PNG signature, it's no PNG or corrupted";
+    case 29: return "first chunk is not the header chunk";
+    case 30: return "chunk length too large, chunk broken off at end of file";
+    case 31: return "illegal PNG color type or bpp";
+    case 32: return "illegal PNG compression method";
+    case 33: return "illegal PNG filter method";
+    case 34: return "illegal PNG interlace method";
+    case 35: return "chunk length of a chunk is too large or the chunk too small";
+    case 36: return "illegal PNG filter type encountered";
+    case 37: return "illegal bit depth for this color type given";
+    case 38: return "the palette is too big"; /*more than 256 colors*/
+    case 39: return "more palette alpha values given in tRNS chunk than there are colors in the palette";
+    case 40: return "tRNS chunk has wrong size for greyscale image";
+    case 41: return "tRNS chunk has wrong size for RGB image";
+    case 42: return "tRNS chunk appeared while it was not allowed for this color type";
+    case 43: return "bKGD chunk has wrong size for palette image";
+    case 44: return "bKGD chunk has wrong size for greyscale image";
+    case 45: return "bKGD chunk has wrong size for RGB image";
+    case 48: return "empty input buffer given to decoder. Maybe caused by non-existing file?";
+    case 49: return "jumped past memory while generating dynamic huffman tree";
+    case 50: return "jumped past memory while generating dynamic huffman tree";
+    case 51: return "jumped past memory while inflating huffman block";
+    case 52: return "jumped past memory while inflating";
+    case 53: return "size of zlib data too small";
+    case 54: return "repeat symbol in tree while there was no value symbol yet";
+        /*jumped past tree while generating huffman tree, this could be when the
+        tree will have more leaves than symbols after generating it out of the
+        given lenghts. They call this an oversubscribed dynamic bit lengths tree in zlib.*/
+    case 55: return "jumped past tree while generating huffman tree";
+    case 56: return "given output image colortype or bitdepth not supported for color conversion";
+    case 57: return "invalid CRC encountered (checking CRC can be disabled)";
+    case 58: return "invalid ADLER32 encountered (checking ADLER32 can be disabled)";
+    case 59: return "requested color conversion not supported";
+    case 60: return "invalid window size given in the settings of the encoder (must be 0-32768)";
+    case 61: return "invalid BTYPE given in the settings of the encoder (only 0, 1 and 2 are allowed)";
+        /*LodePNG leaves the choice of RGB to greyscale conversion formula to the user.*/
+    case 62: return "conversion from color to greyscale not supported";
+    case 63: return "length of a chunk too long, max allowed for PNG is 2147483647 bytes per chunk"; /*(2^31-1)*/
+        /*this would result in the inability of a deflated block to ever contain an end code. It must be at least 1.*/
+    case 64: return "the length of the END symbol 256 in the Huffman tree is 0";
+    case 66: return "the length of a text chunk keyword given to the encoder is longer than the maximum of 79 bytes";
+    case 67: return "the length of a text chunk keyword given to the encoder is smaller than the minimum of 1 byte";
+    case 68: return "tried to encode a PLTE chunk with a palette that has less than 1 or more than 256 colors";
+    case 69: return "unknown chunk type with 'critical' flag encountered by the decoder";
+    case 71: return "unexisting interlace mode given to encoder (must be 0 or 1)";
+    case 72: return "while decoding, unexisting compression method encountering in zTXt or iTXt chunk (it must be 0)";
+    case 73: return "invalid tIME chunk size";
+    case 74: return "invalid pHYs chunk size";
+        /*length could be wrong, or data chopped off*/
+    case 75: return "no null termination char found while decoding text chunk";
+    case 76: return "iTXt chunk too short to contain required bytes";
+    case 77: return "integer overflow in buffer size";
+    case 78: return "failed to open file for reading"; /*file doesn't exist or couldn't be opened for reading*/
+    case 79: return "failed to open file for writing";
+    case 80: return "tried creating a tree of 0 symbols";
+    case 81: return "lazy matching at pos 0 is impossible";
+    case 82: return "color conversion to palette requested while a color isn't in palette";
+    case 83: return "memory allocation failed";
+    case 84: return "given image too small to contain all pixels to be encoded";
+    case 86: return "impossible offset in lz77 encoding (internal bug)";
+    case 87: return "must provide custom zlib function pointer if LODEPNG_COMPILE_ZLIB is not defined";
+    case 88: return "invalid filter strategy given for LodePNGEncoderSettings.filter_strategy";
+    case 89: return "text chunk keyword too short or long: must have size 1-79";
+        /*the windowsize in the LodePNGCompressSettings. Requiring POT(==> & instead of %) makes encoding 12% faster.*/
+    case 90: return "windowsize must be a power of two";
+    case 91: return "invalid decompressed idat size";
+    case 92: return "too many pixels, not supported";
+    case 93: return "zero width or height is invalid";
+    case 94: return "header chunk must have a size of 13 bytes";
+    case 95: return "the row encoder can not write interlaced images";
+    case 96: return "the number of rows given to the row encoder does not match the image height";
+    }
+    return "unknown error code";
 }
 #endif /*LODEPNG_COMPILE_ERROR_TEXT*/
 
@@ -6009,215 +8009,223 @@ namespace lodepng
 {
 
 #ifdef LODEPNG_COMPILE_DISK
-	unsigned load_file(std::vector<unsigned char>& buffer, const std::string& filename)
-	{
-		long size = lodepng_filesize(filename.c_str());
-		if (size < 0) return 78;
-		buffer.resize((size_t)size);
-		return size == 0 ? 0 : lodepng_buffer_file(&buffer[0], (size_t)size, filename.c_str());
-	}
-
-	/*write given buffer to the file, overwriting the file, it doesn't append to it.*/
-	unsigned save_file(const std::vector<unsigned char>& buffer, const std::string& filename)
-	{
-		return lodepng_save_file(buffer.empty() ? 0 : &buffer[0], buffer.size(), filename.c_str());
-	}
+    unsigned load_file(std::vector<unsigned char>& buffer, const std::string& filename)
+    {
+        unsigned error = 0;
+        FILE* file = fopen(filename.c_str(), "rb");
+        if (!file) return 78;
+        long size = lodepng_filesize(file);
+        if (size < 0) error = 78;
+        else
+        {
+            buffer.resize((size_t)size);
+            if (size != 0) error = lodepng_buffer_file(&buffer[0], (size_t)size, file);
+        }
+        fclose(file);
+        return error;
+    }
+
+    /*write given buffer to the file, overwriting the file, it doesn't append to it.*/
+    unsigned save_file(const std::vector<unsigned char>& buffer, const std::string& filename)
+    {
+        return lodepng_save_file(buffer.empty() ? 0 : &buffer[0], buffer.size(), filename.c_str());
+    }
 #endif /* LODEPNG_COMPILE_DISK */
 
 #ifdef LODEPNG_COMPILE_ZLIB
 #ifdef LODEPNG_COMPILE_DECODER
-	unsigned decompress(std::vector<unsigned char>& out, const unsigned char* in, size_t insize,
-		const LodePNGDecompressSettings& settings)
-	{
-		unsigned char* buffer = 0;
-		size_t buffersize = 0;
-		unsigned error = zlib_decompress(&buffer, &buffersize, in, insize, &settings);
-		if (buffer)
-		{
-			out.insert(out.end(), &buffer[0], &buffer[buffersize]);
-			lodepng_free(buffer);
-		}
-		return error;
-	}
-
-	unsigned decompress(std::vector<unsigned char>& out, const std::vector<unsigned char>& in,
-		const LodePNGDecompressSettings& settings)
-	{
-		return decompress(out, in.empty() ? 0 : &in[0], in.size(), settings);
-	}
+    unsigned decompress(std::vector<unsigned char>& out, const unsigned char* in, size_t insize,
+        const LodePNGDecompressSettings& settings)
+    {
+        unsigned char* buffer = 0;
+        size_t buffersize = 0;
+        unsigned error = zlib_decompress(&buffer, &buffersize, in, insize, &settings);
+        if (buffer)
+        {
+            out.insert(out.end(), &buffer[0], &buffer[buffersize]);
+            lodepng_free(buffer);
+        }
+        return error;
+    }
+
+    unsigned decompress(std::vector<unsigned char>& out, const std::vector<unsigned char>& in,
+        const LodePNGDecompressSettings& settings)
+    {
+        return decompress(out, in.empty() ? 0 : &in[0], in.size(), settings);
+    }
 #endif /* LODEPNG_COMPILE_DECODER */
 
 #ifdef LODEPNG_COMPILE_ENCODER
-	unsigned compress(std::vector<unsigned char>& out, const unsigned char* in, size_t insize,
-		const LodePNGCompressSettings& settings)
-	{
-		unsigned char* buffer = 0;
-		size_t buffersize = 0;
-		unsigned error = zlib_compress(&buffer, &buffersize, in, insize, &settings);
-		if (buffer)
-		{
-			out.insert(out.end(), &buffer[0], &buffer[buffersize]);
-			lodepng_free(buffer);
-		}
-		return error;
-	}
-
-	unsigned compress(std::vector<unsigned char>& out, const std::vector<unsigned char>& in,
-		const LodePNGCompressSettings& settings)
-	{
-		return compress(out, in.empty() ? 0 : &in[0], in.size(), settings);
-	}
+    unsigned compress(std::vector<unsigned char>& out, const unsigned char* in, size_t insize,
+        const LodePNGCompressSettings& settings)
+    {
+        unsigned char* buffer = 0;
+        size_t buffersize = 0;
+        unsigned error = zlib_compress(&buffer, &buffersize, in, insize, &settings);
+        if (buffer)
+        {
+            out.insert(out.end(), &buffer[0], &buffer[buffersize]);
+            lodepng_free(buffer);
+        }
+        return error;
+    }
+
+    unsigned compress(std::vector<unsigned char>& out, const std::vector<unsigned char>& in,
+        const LodePNGCompressSettings& settings)
+    {
+        return compress(out, in.empty() ? 0 : &in[0], in.size(), settings);
+    }
 #endif /* LODEPNG_COMPILE_ENCODER */
 #endif /* LODEPNG_COMPILE_ZLIB */
 
 
 #ifdef LODEPNG_COMPILE_PNG
 
-	State::State()
-	{
-		lodepng_state_init(this);
-	}
+    State::State()
+    {
+        lodepng_state_init(this);
+    }
 
-	State::State(const State& other)
-	{
-		lodepng_state_init(this);
-		lodepng_state_copy(this, &other);
-	}
+    State::State(const State& other)
+    {
+        lodepng_state_init(this);
+        lodepng_state_copy(this, &other);
+    }
 
-	State::~State()
-	{
-		lodepng_state_cleanup(this);
-	}
+    State::~State()
+    {
+        lodepng_state_cleanup(this);
+    }
 
-	State& State::operator=(const State& other)
-	{
-		lodepng_state_copy(this, &other);
-		return *this;
-	}
+    State& State::operator=(const State& other)
+    {
+        lodepng_state_copy(this, &other);
+        return *this;
+    }
 
 #ifdef LODEPNG_COMPILE_DECODER
 
-	unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h, const unsigned char* in,
-		size_t insize, LodePNGColorType colortype, unsigned bitdepth)
-	{
-		unsigned char* buffer;
-		unsigned error = lodepng_decode_memory(&buffer, &w, &h, in, insize, colortype, bitdepth);
-		if (buffer && !error)
-		{
-			State state;
-			state.info_raw.colortype = colortype;
-			state.info_raw.bitdepth = bitdepth;
-			size_t buffersize = lodepng_get_raw_size(w, h, &state.info_raw);
-			out.insert(out.end(), &buffer[0], &buffer[buffersize]);
-			lodepng_free(buffer);
-		}
-		return error;
-	}
-
-	unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h,
-		const std::vector<unsigned char>& in, LodePNGColorType colortype, unsigned bitdepth)
-	{
-		return decode(out, w, h, in.empty() ? 0 : &in[0], (unsigned)in.size(), colortype, bitdepth);
-	}
-
-	unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h,
-		State& state,
-		const unsigned char* in, size_t insize)
-	{
-		unsigned char* buffer = NULL;
-		unsigned error = lodepng_decode(&buffer, &w, &h, &state, in, insize);
-		if (buffer && !error)
-		{
-			size_t buffersize = lodepng_get_raw_size(w, h, &state.info_raw);
-			out.insert(out.end(), &buffer[0], &buffer[buffersize]);
-		}
-		lodepng_free(buffer);
-		return error;
-	}
-
-	unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h,
-		State& state,
-		const std::vector<unsigned char>& in)
-	{
-		return decode(out, w, h, state, in.empty() ? 0 : &in[0], in.size());
-	}
+    unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h, const unsigned char* in,
+        size_t insize, LodePNGColorType colortype, unsigned bitdepth)
+    {
+        unsigned char* buffer;
+        unsigned error = lodepng_decode_memory(&buffer, &w, &h, in, insize, colortype, bitdepth);
+        if (buffer && !error)
+        {
+            State state;
+            state.info_raw.colortype = colortype;
+            state.info_raw.bitdepth = bitdepth;
+            size_t buffersize = lodepng_get_raw_size(w, h, &state.info_raw);
+            out.insert(out.end(), &buffer[0], &buffer[buffersize]);
+            lodepng_free(buffer);
+        }
+        return error;
+    }
+
+    unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h,
+        const std::vector<unsigned char>& in, LodePNGColorType colortype, unsigned bitdepth)
+    {
+        return decode(out, w, h, in.empty() ? 0 : &in[0], (unsigned)in.size(), colortype, bitdepth);
+    }
+
+    unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h,
+        State& state,
+        const unsigned char* in, size_t insize)
+    {
+        unsigned char* buffer = NULL;
+        unsigned error = lodepng_decode(&buffer, &w, &h, &state, in, insize);
+        if (buffer && !error)
+        {
+            size_t buffersize = lodepng_get_raw_size(w, h, &state.info_raw);
+            out.insert(out.end(), &buffer[0], &buffer[buffersize]);
+        }
+        lodepng_free(buffer);
+        return error;
+    }
+
+    unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h,
+        State& state,
+        const std::vector<unsigned char>& in)
+    {
+        return decode(out, w, h, state, in.empty() ? 0 : &in[0], in.size());
+    }
 
 #ifdef LODEPNG_COMPILE_DISK
-	unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h, const std::string& filename,
-		LodePNGColorType colortype, unsigned bitdepth)
-	{
-		std::vector<unsigned char> buffer;
-		unsigned error = load_file(buffer, filename);
-		if (error) return error;
-		return decode(out, w, h, buffer, colortype, bitdepth);
-	}
+    unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h, const std::string& filename,
+        LodePNGColorType colortype, unsigned bitdepth)
+    {
+        std::vector<unsigned char> buffer;
+        unsigned error = load_file(buffer, filename);
+        if (error) return error;
+        return decode(out, w, h, buffer, colortype, bitdepth);
+    }
 #endif /* LODEPNG_COMPILE_DECODER */
 #endif /* LODEPNG_COMPILE_DISK */
 
 #ifdef LODEPNG_COMPILE_ENCODER
-	unsigned encode(std::vector<unsigned char>& out, const unsigned char* in, unsigned w, unsigned h,
-		LodePNGColorType colortype, unsigned bitdepth)
-	{
-		unsigned char* buffer;
-		size_t buffersize;
-		unsigned error = lodepng_encode_memory(&buffer, &buffersize, in, w, h, colortype, bitdepth);
-		if (buffer)
-		{
-			out.insert(out.end(), &buffer[0], &buffer[buffersize]);
-			lodepng_free(buffer);
-		}
-		return error;
-	}
-
-	unsigned encode(std::vector<unsigned char>& out,
-		const std::vector<unsigned char>& in, unsigned w, unsigned h,
-		LodePNGColorType colortype, unsigned bitdepth)
-	{
-		if (lodepng_get_raw_size_lct(w, h, colortype, bitdepth) > in.size()) return 84;
-		return encode(out, in.empty() ? 0 : &in[0], w, h, colortype, bitdepth);
-	}
-
-	unsigned encode(std::vector<unsigned char>& out,
-		const unsigned char* in, unsigned w, unsigned h,
-		State& state)
-	{
-		unsigned char* buffer;
-		size_t buffersize;
-		unsigned error = lodepng_encode(&buffer, &buffersize, in, w, h, &state);
-		if (buffer)
-		{
-			out.insert(out.end(), &buffer[0], &buffer[buffersize]);
-			lodepng_free(buffer);
-		}
-		return error;
-	}
-
-	unsigned encode(std::vector<unsigned char>& out,
-		const std::vector<unsigned char>& in, unsigned w, unsigned h,
-		State& state)
-	{
-		if (lodepng_get_raw_size(w, h, &state.info_raw) > in.size()) return 84;
-		return encode(out, in.empty() ? 0 : &in[0], w, h, state);
-	}
+    unsigned encode(std::vector<unsigned char>& out, const unsigned char* in, unsigned w, unsigned h,
+        LodePNGColorType colortype, unsigned bitdepth)
+    {
+        unsigned char* buffer;
+        size_t buffersize;
+        unsigned error = lodepng_encode_memory(&buffer, &buffersize, in, w, h, colortype, bitdepth);
+        if (buffer)
+        {
+            out.insert(out.end(), &buffer[0], &buffer[buffersize]);
+            lodepng_free(buffer);
+        }
+        return error;
+    }
+
+    unsigned encode(std::vector<unsigned char>& out,
+        const std::vector<unsigned char>& in, unsigned w, unsigned h,
+        LodePNGColorType colortype, unsigned bitdepth)
+    {
+        if (lodepng_get_raw_size_lct(w, h, colortype, bitdepth) > in.size()) return 84;
+        return encode(out, in.empty() ? 0 : &in[0], w, h, colortype, bitdepth);
+    }
+
+    unsigned encode(std::vector<unsigned char>& out,
+        const unsigned char* in, unsigned w, unsigned h,
+        State& state)
+    {
+        unsigned char* buffer;
+        size_t buffersize;
+        unsigned error = lodepng_encode(&buffer, &buffersize, in, w, h, &state);
+        if (buffer)
+        {
+            out.insert(out.end(), &buffer[0], &buffer[buffersize]);
+            lodepng_free(buffer);
+        }
+        return error;
+    }
+
+    unsigned encode(std::vector<unsigned char>& out,
+        const std::vector<unsigned char>& in, unsigned w, unsigned h,
+        State& state)
+    {
+        if (lodepng_get_raw_size(w, h, &state.info_raw) > in.size()) return 84;
+        return encode(out, in.empty() ? 0 : &in[0], w, h, state);
+    }
 
 #ifdef LODEPNG_COMPILE_DISK
-	unsigned encode(const std::string& filename,
-		const unsigned char* in, unsigned w, unsigned h,
-		LodePNGColorType colortype, unsigned bitdepth)
-	{
-		std::vector<unsigned char> buffer;
-		unsigned error = encode(buffer, in, w, h, colortype, bitdepth);
-		if (!error) error = save_file(buffer, filename);
-		return error;
-	}
-
-	unsigned encode(const std::string& filename,
-		const std::vector<unsigned char>& in, unsigned w, unsigned h,
-		LodePNGColorType colortype, unsigned bitdepth)
-	{
-		if (lodepng_get_raw_size_lct(w, h, colortype, bitdepth) > in.size()) return 84;
-		return encode(filename, in.empty() ? 0 : &in[0], w, h, colortype, bitdepth);
-	}
+    unsigned encode(const std::string& filename,
+        const unsigned char* in, unsigned w, unsigned h,
+        LodePNGColorType colortype, unsigned bitdepth)
+    {
+        std::vector<unsigned char> buffer;
+        unsigned error = encode(buffer, in, w, h, colortype, bitdepth);
+        if (!error) error = save_file(buffer, filename);
+        return error;
+    }
+
+    unsigned encode(const std::string& filename,
+        const std::vector<unsigned char>& in, unsigned w, unsigned h,
+        LodePNGColorType colortype, unsigned bitdepth)
+    {
+        if (lodepng_get_raw_size_lct(w, h, colortype, bitdepth) > in.size()) return 84;
+        return encode(filename, in.empty() ? 0 : &in[0], w, h, colortype, bitdepth);
+    }
 #endif /* LODEPNG_COMPILE_DISK */
 #endif /* LODEPNG_COMPILE_ENCODER */
 #endif /* LODEPNG_COMPILE_PNG */
@@ -1,6 +1,7 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "resizer.h"
+#include <QThread>
 
 MainWindow::MainWindow(QWidget *parent): QMainWindow(parent), ui(new Ui::MainWindow)
 {
@@ -13,6 +14,9 @@ MainWindow::MainWindow(QWidget *parent): QMainWindow(parent), ui(new Ui::MainWin
     connect(ui->radioButtonPercentage, SIGNAL(clicked()), this, SLOT (loggSizeSetting()));
     connect(ui->GenerateButton, SIGNAL(released()), this, SLOT (generateImages()));
     connect(ui->interpolationSelectionBox, SIGNAL(currentIndexChanged(int)), SLOT (loggInterpolationSetting()));
+    connect(ui->effortSelectionBox, SIGNAL(currentIndexChanged(int)), SLOT (loggEffortSetting()));
+    connect(&batchProcessor, SIGNAL(imageFinished(QString, bool, int, int)), this, SLOT (handleImageFinished(QString, bool, int, int)));
+    connect(&batchProcessor, SIGNAL(finished()), this, SLOT (handleBatchFinished()));
     inputDirectory = QCoreApplication::applicationDirPath();
     outputDirectory = inputDirectory;
     prefix = "";
@@ -20,10 +24,21 @@ MainWindow::MainWindow(QWidget *parent): QMainWindow(parent), ui(new Ui::MainWin
     ui->input_box->setText(inputDirectory);
     ui->output_box->setText(outputDirectory);
     listImageFiles(inputDirectory);
-    ui->progressBar->setRange(1, 100);
+    ui->progressBar->setRange(0, 100);
+    ui->spinBoxWorkers->setValue(QThread::idealThreadCount());
     ui->interpolationSelectionBox->addItem("Nearest Neighbour");
     ui->interpolationSelectionBox->addItem("Bicubic");
     ui->interpolationSelectionBox->addItem("Bilinear");
+    ui->interpolationSelectionBox->addItem("Lanczos");
+    ui->interpolationSelectionBox->addItem("Area Average");
+    // in the order of Resizer::EncodeEffort
+    ui->effortSelectionBox->addItem("Store");
+    ui->effortSelectionBox->addItem("Fastest");
+    ui->effortSelectionBox->addItem("Fast");
+    ui->effortSelectionBox->addItem("Default");
+    ui->effortSelectionBox->addItem("Small");
+    ui->effortSelectionBox->addItem("Max");
+    ui->effortSelectionBox->setCurrentIndex(Resizer::DEFAULT_EFFORT);
 }
 
 MainWindow::~MainWindow()
@@ -59,58 +74,44 @@ void MainWindow::generateImages()
         logg("ERROR: change output directory or add a prefix/suffix to avoid overwriting original images...");
     }
 
-    // if everything is ok, generate the scaled images
-    if (readyToGenerateImages)
+    // if everything is ok, generate the scaled images on the worker threads
+    if (readyToGenerateImages && !batchProcessor.isRunning())
     {
+        ResizeSettings settings;
+        settings.usePixels = ui->radioButtonPixels->isChecked();
+        settings.width = ui->spinBoxWidthPixels->value();
+        settings.height = ui->spinBoxHeightPixels->value();
+        settings.widthScale = ui->spinBoxWidthPercentage->value() * 0.01f;
+        settings.heightScale = ui->spinBoxHeightPercentage->value() * 0.01f;
+        settings.interpolationIndex = ui->interpolationSelectionBox->currentIndex();
+        settings.effortIndex = ui->effortSelectionBox->currentIndex();
+        settings.outputDirectory = outputDirectory;
+        settings.prefix = prefix;
+        settings.suffix = suffix;
+
         ui->progressBar->setValue(0);
-        logg("Generating scaled images...");
-        QFileInfoList fileList = getInputFileList(inputDirectory);
-        Resizer::Image *original, *scaled;
-        int interpolationIndex = ui->interpolationSelectionBox->currentIndex();
-
-        for(int i = 0; i < fileList.count(); ++i)
-        {
-            original = Resizer::readImageFromFile(fileList.at(i).absoluteFilePath().toStdString().c_str());
-            if(original != nullptr)
-            {
-                QString newFilename = prefix + fileList.at(i).fileName().section(".",0,0) + suffix + ".png";
-                QString outFilePath = outputDirectory + "/" + newFilename;
-                logg("Generating " + newFilename);
-                if(ui->radioButtonPixels->isChecked())
-                {
-                    int width = ui->spinBoxWidthPixels->value();
-                    int height = ui->spinBoxHeightPixels->value();
-                    if(interpolationIndex == 0)
-                        scaled = Resizer::nearestNeighbourInterpolation(original, width, height);
-                    else if(interpolationIndex == 1)
-                        scaled = Resizer::bicubicInterpolation(original, width, height);
-                    else if(interpolationIndex == 2)
-                        scaled = Resizer::bilinearInterpolation(original, width, height);
-                }
-                else
-                {
-                    float width = ui->spinBoxWidthPercentage->value() * 0.01f;
-                    float height = ui->spinBoxHeightPercentage->value() * 0.01f;
-                    if(interpolationIndex == 0)
-                        scaled = Resizer::nearestNeighbourInterpolation(original, width, height);
-                    else if(interpolationIndex == 1)
-                        scaled = Resizer::bicubicInterpolation(original, width, height);
-                    else if(interpolationIndex == 2)
-                        scaled = Resizer::bilinearInterpolation(original, width, height);
-                }
-
-                if(scaled != nullptr)
-                    Resizer::saveImageToFile(outFilePath.toStdString().c_str(), scaled);
-                delete original;
-                delete scaled;
-            }
-            ui->progressBar->setValue(100 * ((i + 1) / fileList.count()));
-        }
-
-        logg("DONE...");
+        ui->GenerateButton->setEnabled(false);
+        logg("Generating scaled images using " + QString::number(ui->spinBoxWorkers->value()) + " threads and at most " + QString::number(ui->spinBoxMemory->value()) + " MB...");
+        batchProcessor.start(getInputFileList(inputDirectory), settings, ui->spinBoxWorkers->value(), (size_t)ui->spinBoxMemory->value() * 1024 * 1024);
     }
 }
 
+void MainWindow::handleImageFinished(QString filename, bool succeeded, int finishedCount, int totalCount)
+{
+    if(succeeded)
+        logg("Generated " + filename);
+    else
+        logg("ERROR: could not generate " + filename);
+    ui->progressBar->setValue(100 * finishedCount / totalCount);
+}
+
+void MainWindow::handleBatchFinished()
+{
+    ui->progressBar->setValue(100);
+    ui->GenerateButton->setEnabled(true);
+    logg("DONE...");
+}
+
 void MainWindow::loggSizeSetting()
 {
     if(ui->radioButtonPixels->isChecked())
@@ -124,6 +125,11 @@ void MainWindow::loggInterpolationSetting()
     logg("Interpolation method: " + ui->interpolationSelectionBox->currentText());
 }
 
+void MainWindow::loggEffortSetting()
+{
+    logg("Compression effort: " + ui->effortSelectionBox->currentText());
+}
+
 void MainWindow::handleInputBrowseButton()
 {
     inputDirectory = QFileDialog::getExistingDirectory(this, tr("Open Directory"), inputDirectory, QFileDialog::ShowDirsOnly | QFileDialog::DontResolveSymlinks);
@@ -3,6 +3,7 @@
 
 #include <QMainWindow>
 #include "QFileDialog"
+#include "batchprocessor.h"
 
 namespace Ui {
 class MainWindow;
@@ -18,12 +19,15 @@ public:
 
 private slots:
     void generateImages();
+    void handleImageFinished(QString filename, bool succeeded, int finishedCount, int totalCount);
+    void handleBatchFinished();
     void handleInputBrowseButton();
     void handleOutputBrowseButton();
     void handlePrefixText();
     void handleSuffixText();
     void loggSizeSetting();
     void loggInterpolationSetting();
+    void loggEffortSetting();
     void logg(QString text);
     QFileInfoList getInputFileList(QString filePath);
     void listImageFiles(QString filePath);
@@ -34,6 +38,7 @@ private:
     QString outputDirectory;
     QString prefix;
     QString suffix;
+    BatchProcessor batchProcessor;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,121 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include "resizer.h"
+
+namespace Resizer
+{
+    // number of fractional bits used by the fixed-point filter weights
+    const int WEIGHT_PRECISION_BITS = 14;
+
+    // A separable filter kernel, kernel(x, parameters) is evaluated for distances in source pixels
+    // and is assumed to be zero for |x| >= support. The meaning of the parameters depends on the kernel.
+    struct Filter
+    {
+        float (*kernel)(float x, const float *parameters);
+        float support;
+        float parameters[2];
+    };
+
+    // Precomputed contributions along one axis. For every destination pixel i the source
+    // pixels first[i] .. first[i] + taps - 1 are weighted by weights[i * taps .. i * taps + taps - 1].
+    // All entries have the same number of taps, unused taps have a weight of zero.
+    struct WeightTable
+    {
+        WeightTable() : taps(0){}
+
+        // number of source pixels read per destination pixel
+        int taps;
+
+        // index of the first source pixel used by each destination pixel
+        std::vector<int> first;
+
+        // fixed-point weights with WEIGHT_PRECISION_BITS fractional bits, every row sums to one
+        std::vector<short> weights;
+    };
+
+    // instruction sets that the resampling row kernels are available for
+    enum SimdLevel
+    {
+        SIMD_NONE,
+        SIMD_SSE41,
+        SIMD_AVX2
+    };
+
+    // Row kernels used by the horizontal and vertical passes. All implementations give bit-identical results.
+    struct RowKernels
+    {
+        void (*horizontal)(const unsigned char *sourceRow, unsigned char *destinationRow, const unsigned width, const WeightTable &table);
+        void (*vertical)(const unsigned char *source, const unsigned stride, const short *weights, const int taps, unsigned char *destinationRow, const unsigned rowSize);
+        void (*bilinear)(const unsigned char *top, const unsigned char *bottom, const unsigned fractionY, unsigned char *destinationRow, const unsigned width, const long long stepX, const unsigned sourceWidth);
+    };
+
+    // Splits a 32.32 fixed-point source position into the left pixel of the pair to blend and the weight of the
+    // right pixel in 1/256. The last pixel is blended as the right pixel of the pair before it, so both always exist.
+    inline void bilinearColumn(const long long position, const long long maxPosition, const unsigned sourceWidth, unsigned &column, unsigned &fraction)
+    {
+        const long long x = (position < 0) ? 0 : ((position > maxPosition) ? maxPosition : position);
+        column = (unsigned)(x >> 32);
+        fraction = (unsigned)(x >> 24) & 0xff;
+        if (column + 1 == sourceWidth)
+        {
+            column -= 1;
+            fraction = 256;
+        }
+    }
+
+    // Resamples a image that arrives one source row at a time from top to bottom. Every row is filtered horizontally
+    // as soon as it arrives and only the last vertical.taps filtered rows are kept, so the source image never has to
+    // be in memory as a whole. Destination rows are written as soon as all the source rows they need have arrived.
+    // Results match resample when it filters the rows first, it may filter the columns first which rounds differently.
+    // Instead of into a image the destination rows can be handed to a sink, then the result is never in memory either.
+    class RowResampler
+    {
+    public:
+        // receives destination row y, the row is only valid during the call
+        typedef std::function<void(unsigned y, const unsigned char *row)> RowSink;
+
+        RowResampler(Image *destination, const WeightTable &horizontal, const WeightTable &vertical);
+        RowResampler(const RowSink &sink, const WeightTable &horizontal, const WeightTable &vertical);
+        void addRow(const unsigned char *sourceRow);
+
+    private:
+        Image *destination;
+        RowSink sink;
+        WeightTable horizontal, vertical;
+        unsigned width, height;
+
+        // the row handed to the sink when there is no destination image
+        Image output;
+
+        // filtered rows, every row is stored twice vertical.taps rows apart so that any window of rows is contiguous
+        Image window;
+
+        unsigned rowsAdded;
+        unsigned nextRow;
+    };
+
+    SimdLevel detectSimdLevel();
+    SimdLevel getSimdLevel();
+    void setSimdLevel(const SimdLevel level);
+    const RowKernels &rowKernels();
+    void horizontalRowScalar(const unsigned char *sourceRow, unsigned char *destinationRow, const unsigned width, const WeightTable &table);
+    void verticalRowScalar(const unsigned char *source, const unsigned stride, const short *weights, const int taps, unsigned char *destinationRow, const unsigned rowSize);
+    void bilinearRowScalar(const unsigned char *top, const unsigned char *bottom, const unsigned fractionY, unsigned char *destinationRow, const unsigned width, const long long stepX, const unsigned sourceWidth);
+
+    float triangleKernel(float x, const float *parameters);
+    float cubicKernel(float x, const float *parameters);
+    float lanczosKernel(float x, const float *parameters);
+    float hannKernel(float x, const float *parameters);
+    float hammingKernel(float x, const float *parameters);
+    float blackmanKernel(float x, const float *parameters);
+
+    WeightTable computeWeightTable(const unsigned sourceSize, const unsigned destinationSize, const Filter &filter);
+    WeightTable computeAreaWeightTable(const unsigned sourceSize, const unsigned destinationSize);
+    void horizontalPass(const Image *source, Image *destination, const WeightTable &table);
+    void verticalPass(const Image *source, Image *destination, const WeightTable &table);
+    std::unique_ptr<Image> resample(const Image *image, const int width, const int height, const Filter &filter);
+    std::unique_ptr<Image> resample(const Image *image, const WeightTable &horizontal, const WeightTable &vertical);
+    std::unique_ptr<Image> bilinearUpscale(const Image *image, const int width, const int height);
+    std::unique_ptr<Image> areaDownscale(const Image *image, const unsigned factorX, const unsigned factorY);
+};
@@ -0,0 +1,294 @@
+#include "resample.h"
+#include <cstring>
+
+// Vectorized versions of the resampling row kernels. They are compiled for their instruction set with
+// function attributes instead of compiler flags so that a single binary can pick the best one at runtime.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define RESIZER_X86
+#include <immintrin.h>
+#if defined(__GNUC__)
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#include <intrin.h>
+#define TARGET_SSE41
+#define TARGET_AVX2
+#endif
+#endif
+
+namespace
+{
+#ifdef RESIZER_X86
+    // Packs two neighbouring fixed-point weights into one 32 bit lane as expected by madd.
+    inline int weightPair(const short first, const short second)
+    {
+        return (int)((unsigned short)first | ((unsigned)(unsigned short)second << 16));
+    }
+
+    // Loads two neighbouring RGBA pixels and spreads them to 16 bit lanes in the order r0 r1 g0 g1 b0 b1 a0 a1.
+    TARGET_SSE41 inline __m128i loadPixelPair(const unsigned char *pixel)
+    {
+        const __m128i shuffle = _mm_setr_epi8(0, -1, 4, -1, 1, -1, 5, -1, 2, -1, 6, -1, 3, -1, 7, -1);
+        return _mm_shuffle_epi8(_mm_loadl_epi64((const __m128i *)pixel), shuffle);
+    }
+
+    // Loads a single RGBA pixel into four 32 bit lanes.
+    TARGET_SSE41 inline __m128i loadPixel(const unsigned char *pixel)
+    {
+        int value;
+        std::memcpy(&value, pixel, sizeof(value));
+        return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(value));
+    }
+
+    // Converts four 32 bit fixed-point sums to bytes with rounding already applied and stores them.
+    TARGET_SSE41 inline void storePixel(unsigned char *destination, __m128i sum)
+    {
+        sum = _mm_srai_epi32(sum, Resizer::WEIGHT_PRECISION_BITS);
+        sum = _mm_packus_epi16(_mm_packs_epi32(sum, sum), sum);
+        int value = _mm_cvtsi128_si32(sum);
+        std::memcpy(destination, &value, sizeof(value));
+    }
+
+    // Filters a single destination pixel along the x axis, two taps per multiply-add.
+    TARGET_SSE41 inline __m128i horizontalPixelSse41(const unsigned char *pixel, const short *weight, const int taps)
+    {
+        __m128i sum = _mm_set1_epi32(1 << (Resizer::WEIGHT_PRECISION_BITS - 1));
+        int t = 0;
+        for (; t + 2 <= taps; t += 2)
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(loadPixelPair(pixel + t * Resizer::NUMBER_OF_CHANNELS), _mm_set1_epi32(weightPair(weight[t], weight[t + 1]))));
+        if (t < taps)
+            sum = _mm_add_epi32(sum, _mm_mullo_epi32(loadPixel(pixel + t * Resizer::NUMBER_OF_CHANNELS), _mm_set1_epi32(weight[t])));
+        return sum;
+    }
+
+    // Filters one row along the x axis, one destination pixel at a time.
+    TARGET_SSE41 void horizontalRowSse41(const unsigned char *sourceRow, unsigned char *destinationRow, const unsigned width, const Resizer::WeightTable &table)
+    {
+        const int taps = table.taps;
+        for (unsigned x = 0; x < width; ++x)
+        {
+            const unsigned char *pixel = sourceRow + table.first[x] * Resizer::NUMBER_OF_CHANNELS;
+            storePixel(destinationRow + x * Resizer::NUMBER_OF_CHANNELS, horizontalPixelSse41(pixel, &table.weights[x * taps], taps));
+        }
+    }
+
+    // Adds the weighted contribution of two source rows to the sums of 16 destination bytes.
+    TARGET_SSE41 inline void verticalStepSse41(const __m128i first, const __m128i second, const __m128i weights, __m128i *sum)
+    {
+        const __m128i firstLow = _mm_cvtepu8_epi16(first);
+        const __m128i firstHigh = _mm_cvtepu8_epi16(_mm_srli_si128(first, 8));
+        const __m128i secondLow = _mm_cvtepu8_epi16(second);
+        const __m128i secondHigh = _mm_cvtepu8_epi16(_mm_srli_si128(second, 8));
+        sum[0] = _mm_add_epi32(sum[0], _mm_madd_epi16(_mm_unpacklo_epi16(firstLow, secondLow), weights));
+        sum[1] = _mm_add_epi32(sum[1], _mm_madd_epi16(_mm_unpackhi_epi16(firstLow, secondLow), weights));
+        sum[2] = _mm_add_epi32(sum[2], _mm_madd_epi16(_mm_unpacklo_epi16(firstHigh, secondHigh), weights));
+        sum[3] = _mm_add_epi32(sum[3], _mm_madd_epi16(_mm_unpackhi_epi16(firstHigh, secondHigh), weights));
+    }
+
+    // Computes 16 bytes of a destination row along the y axis, two source rows per multiply-add.
+    TARGET_SSE41 inline void verticalBlockSse41(const unsigned char *source, const unsigned stride, const short *weights, const int taps, unsigned char *destination)
+    {
+        const __m128i half = _mm_set1_epi32(1 << (Resizer::WEIGHT_PRECISION_BITS - 1));
+        __m128i sum[4] = { half, half, half, half };
+        int t = 0;
+        for (; t + 2 <= taps; t += 2)
+        {
+            const __m128i first = _mm_loadu_si128((const __m128i *)(source + t * stride));
+            const __m128i second = _mm_loadu_si128((const __m128i *)(source + (t + 1) * stride));
+            verticalStepSse41(first, second, _mm_set1_epi32(weightPair(weights[t], weights[t + 1])), sum);
+        }
+        if (t < taps)
+            verticalStepSse41(_mm_loadu_si128((const __m128i *)(source + t * stride)), _mm_setzero_si128(), _mm_set1_epi32(weightPair(weights[t], 0)), sum);
+        for (int i = 0; i < 4; ++i)
+            sum[i] = _mm_srai_epi32(sum[i], Resizer::WEIGHT_PRECISION_BITS);
+        const __m128i low = _mm_packs_epi32(sum[0], sum[1]);
+        const __m128i high = _mm_packs_epi32(sum[2], sum[3]);
+        _mm_storeu_si128((__m128i *)destination, _mm_packus_epi16(low, high));
+    }
+
+    // Computes one destination row along the y axis, 16 bytes at a time.
+    TARGET_SSE41 void verticalRowSse41(const unsigned char *source, const unsigned stride, const short *weights, const int taps, unsigned char *destinationRow, const unsigned rowSize)
+    {
+        unsigned k = 0;
+        for (; k + 16 <= rowSize; k += 16)
+            verticalBlockSse41(source + k, stride, weights, taps, destinationRow + k);
+        if (k < rowSize)
+            Resizer::verticalRowScalar(source + k, stride, weights, taps, destinationRow + k, rowSize - k);
+    }
+
+    // Filters one row along the x axis, two destination pixels at a time in the two 128 bit lanes.
+    TARGET_AVX2 void horizontalRowAvx2(const unsigned char *sourceRow, unsigned char *destinationRow, const unsigned width, const Resizer::WeightTable &table)
+    {
+        const int taps = table.taps;
+        const __m256i shuffle = _mm256_setr_epi8(0, -1, 4, -1, 1, -1, 5, -1, 2, -1, 6, -1, 3, -1, 7, -1, 0, -1, 4, -1, 1, -1, 5, -1, 2, -1, 6, -1, 3, -1, 7, -1);
+        unsigned x = 0;
+        for (; x + 2 <= width; x += 2)
+        {
+            const unsigned char *pixel0 = sourceRow + table.first[x] * Resizer::NUMBER_OF_CHANNELS;
+            const unsigned char *pixel1 = sourceRow + table.first[x + 1] * Resizer::NUMBER_OF_CHANNELS;
+            const short *weight0 = &table.weights[x * taps];
+            const short *weight1 = weight0 + taps;
+            __m256i sum = _mm256_set1_epi32(1 << (Resizer::WEIGHT_PRECISION_BITS - 1));
+            int t = 0;
+            for (; t + 2 <= taps; t += 2)
+            {
+                const int offset = t * Resizer::NUMBER_OF_CHANNELS;
+                __m256i pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadl_epi64((const __m128i *)(pixel0 + offset))), _mm_loadl_epi64((const __m128i *)(pixel1 + offset)), 1);
+                __m256i weights = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_set1_epi32(weightPair(weight0[t], weight0[t + 1]))), _mm_set1_epi32(weightPair(weight1[t], weight1[t + 1])), 1);
+                sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_shuffle_epi8(pixels, shuffle), weights));
+            }
+            __m128i sum0 = _mm256_castsi256_si128(sum);
+            __m128i sum1 = _mm256_extracti128_si256(sum, 1);
+            if (t < taps)
+            {
+                const int offset = t * Resizer::NUMBER_OF_CHANNELS;
+                sum0 = _mm_add_epi32(sum0, _mm_mullo_epi32(loadPixel(pixel0 + offset), _mm_set1_epi32(weight0[t])));
+                sum1 = _mm_add_epi32(sum1, _mm_mullo_epi32(loadPixel(pixel1 + offset), _mm_set1_epi32(weight1[t])));
+            }
+            storePixel(destinationRow + x * Resizer::NUMBER_OF_CHANNELS, sum0);
+            storePixel(destinationRow + (x + 1) * Resizer::NUMBER_OF_CHANNELS, sum1);
+        }
+        if (x < width)
+        {
+            const unsigned char *pixel = sourceRow + table.first[x] * Resizer::NUMBER_OF_CHANNELS;
+            storePixel(destinationRow + x * Resizer::NUMBER_OF_CHANNELS, horizontalPixelSse41(pixel, &table.weights[x * taps], taps));
+        }
+    }
+
+    // Adds the weighted contribution of two source rows to the sums of 32 destination bytes.
+    // The unpacks work within 128 bit lanes, the order is restored when the sums are packed again.
+    TARGET_AVX2 inline void verticalStepAvx2(const __m256i first, const __m256i second, const __m256i weights, __m256i *sum)
+    {
+        const __m256i firstLow = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(first));
+        const __m256i firstHigh = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(first, 1));
+        const __m256i secondLow = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(second));
+        const __m256i secondHigh = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(second, 1));
+        sum[0] = _mm256_add_epi32(sum[0], _mm256_madd_epi16(_mm256_unpacklo_epi16(firstLow, secondLow), weights));
+        sum[1] = _mm256_add_epi32(sum[1], _mm256_madd_epi16(_mm256_unpackhi_epi16(firstLow, secondLow), weights));
+        sum[2] = _mm256_add_epi32(sum[2], _mm256_madd_epi16(_mm256_unpacklo_epi16(firstHigh, secondHigh), weights));
+        sum[3] = _mm256_add_epi32(sum[3], _mm256_madd_epi16(_mm256_unpackhi_epi16(firstHigh, secondHigh), weights));
+    }
+
+    // Computes one destination row along the y axis, 32 bytes at a time.
+    TARGET_AVX2 void verticalRowAvx2(const unsigned char *source, const unsigned stride, const short *weights, const int taps, unsigned char *destinationRow, const unsigned rowSize)
+    {
+        const __m256i half = _mm256_set1_epi32(1 << (Resizer::WEIGHT_PRECISION_BITS - 1));
+        unsigned k = 0;
+        for (; k + 32 <= rowSize; k += 32)
+        {
+            const unsigned char *column = source + k;
+            __m256i sum[4] = { half, half, half, half };
+            int t = 0;
+            for (; t + 2 <= taps; t += 2)
+            {
+                const __m256i first = _mm256_loadu_si256((const __m256i *)(column + t * stride));
+                const __m256i second = _mm256_loadu_si256((const __m256i *)(column + (t + 1) * stride));
+                verticalStepAvx2(first, second, _mm256_set1_epi32(weightPair(weights[t], weights[t + 1])), sum);
+            }
+            if (t < taps)
+                verticalStepAvx2(_mm256_loadu_si256((const __m256i *)(column + t * stride)), _mm256_setzero_si256(), _mm256_set1_epi32(weightPair(weights[t], 0)), sum);
+            for (int i = 0; i < 4; ++i)
+                sum[i] = _mm256_srai_epi32(sum[i], Resizer::WEIGHT_PRECISION_BITS);
+            const __m256i low = _mm256_packs_epi32(sum[0], sum[1]);
+            const __m256i high = _mm256_packs_epi32(sum[2], sum[3]);
+            const __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm256_storeu_si256((__m256i *)(destinationRow + k), bytes);
+        }
+        for (; k + 16 <= rowSize; k += 16)
+            verticalBlockSse41(source + k, stride, weights, taps, destinationRow + k);
+        if (k < rowSize)
+            Resizer::verticalRowScalar(source + k, stride, weights, taps, destinationRow + k, rowSize - k);
+    }
+
+    // Computes one destination row of a bilinear enlargement, blending the two pixels of each source row with one
+    // multiply-add and the two rows with 32 bit multiplies so that the result is rounded exactly like the scalar code.
+    TARGET_SSE41 void bilinearRowSse41(const unsigned char *top, const unsigned char *bottom, const unsigned fractionY, unsigned char *destinationRow, const unsigned width, const long long stepX, const unsigned sourceWidth)
+    {
+        const long long maxX = (long long)(sourceWidth - 1) << 32;
+        const __m128i weightTop = _mm_set1_epi32(256 - fractionY);
+        const __m128i weightBottom = _mm_set1_epi32(fractionY);
+        const __m128i half = _mm_set1_epi32(0x8000);
+        long long positionX = stepX / 2 - (1LL << 31);
+        for (unsigned j = 0; j < width; ++j, positionX += stepX)
+        {
+            unsigned column, fractionX;
+            Resizer::bilinearColumn(positionX, maxX, sourceWidth, column, fractionX);
+            const unsigned left = column * Resizer::NUMBER_OF_CHANNELS;
+            const __m128i weights = _mm_set1_epi32(weightPair((short)(256 - fractionX), (short)fractionX));
+            const __m128i upper = _mm_madd_epi16(loadPixelPair(top + left), weights);
+            const __m128i lower = _mm_madd_epi16(loadPixelPair(bottom + left), weights);
+            __m128i sum = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi32(upper, weightTop), _mm_mullo_epi32(lower, weightBottom)), half);
+            sum = _mm_srli_epi32(sum, 16);
+            sum = _mm_packus_epi16(_mm_packs_epi32(sum, sum), sum);
+            int value = _mm_cvtsi128_si32(sum);
+            std::memcpy(destinationRow + j * Resizer::NUMBER_OF_CHANNELS, &value, sizeof(value));
+        }
+    }
+#endif
+
+    const Resizer::RowKernels SCALAR_KERNELS = { Resizer::horizontalRowScalar, Resizer::verticalRowScalar, Resizer::bilinearRowScalar };
+#ifdef RESIZER_X86
+    const Resizer::RowKernels SSE41_KERNELS = { horizontalRowSse41, verticalRowSse41, bilinearRowSse41 };
+    const Resizer::RowKernels AVX2_KERNELS = { horizontalRowAvx2, verticalRowAvx2, bilinearRowSse41 };
+#endif
+
+    // Returns the kernels for a instruction set.
+    const Resizer::RowKernels *kernelsFor(const Resizer::SimdLevel level)
+    {
+#ifdef RESIZER_X86
+        if (level == Resizer::SIMD_AVX2) return &AVX2_KERNELS;
+        if (level == Resizer::SIMD_SSE41) return &SSE41_KERNELS;
+#endif
+        return &SCALAR_KERNELS;
+    }
+
+    Resizer::SimdLevel activeLevel = Resizer::detectSimdLevel();
+    const Resizer::RowKernels *activeKernels = kernelsFor(activeLevel);
+}
+
+// Checks which instruction sets the processor supports.
+// It returns the best instruction set that there are resampling kernels for.
+Resizer::SimdLevel Resizer::detectSimdLevel()
+{
+#if defined(RESIZER_X86) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return Resizer::SIMD_AVX2;
+    if (__builtin_cpu_supports("sse4.1")) return Resizer::SIMD_SSE41;
+#elif defined(RESIZER_X86)
+    int info[4];
+    __cpuid(info, 0);
+    const int highestFunction = info[0];
+    __cpuid(info, 1);
+    const bool sse41 = (info[2] & (1 << 19)) != 0;
+    const bool osSavesAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+    if (osSavesAvx && highestFunction >= 7)
+    {
+        __cpuidex(info, 7, 0);
+        if (info[1] & (1 << 5)) return Resizer::SIMD_AVX2;
+    }
+    if (sse41) return Resizer::SIMD_SSE41;
+#endif
+    return Resizer::SIMD_NONE;
+}
+
+// Returns the instruction set used by the resampling kernels.
+Resizer::SimdLevel Resizer::getSimdLevel()
+{
+    return activeLevel;
+}
+
+// Selects the instruction set used by the resampling kernels, for example SIMD_NONE to run the reference scalar code.
+// Levels that the processor does not support are lowered to the best supported one.
+// It should not be called while images are being resized.
+void Resizer::setSimdLevel(const Resizer::SimdLevel level)
+{
+    const Resizer::SimdLevel supported = Resizer::detectSimdLevel();
+    activeLevel = (level < supported) ? level : supported;
+    activeKernels = kernelsFor(activeLevel);
+}
+
+// Returns the resampling row kernels for the selected instruction set.
+const Resizer::RowKernels &Resizer::rowKernels()
+{
+    return *activeKernels;
+}
@@ -1,6 +1,10 @@
 #pragma once
+#include <cstddef>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace Resizer
 {
@@ -11,27 +15,149 @@ namespace Resizer
     const unsigned MIN_VALID_HEIGHT = 2;
     const unsigned MAX_VALID_WIDTH = 8192;
     const unsigned MAX_VALID_HEIGHT = 8192;
+    // alignment in bytes of the rows in a image
+    const unsigned ROW_ALIGNMENT = 64;
+    // memory in bytes that the images resized at the same time in a batch may take together
+    const size_t DEFAULT_BATCH_MEMORY = (size_t)2048 * 1024 * 1024;
 
+    // B and C parameters of a cubic filter from the Mitchell-Netravali family
+    struct CubicParameters
+    {
+        float b, c;
+    };
+    const CubicParameters CATMULL_ROM = { 0.0f, 0.5f };
+    const CubicParameters MITCHELL_NETRAVALI = { 1.0f / 3.0f, 1.0f / 3.0f };
+    const CubicParameters B_SPLINE = { 1.0f, 0.0f };
+
+    // window functions that can be applied to the sinc filter
+    enum WindowFunction
+    {
+        LANCZOS_WINDOW,
+        HANN_WINDOW,
+        HAMMING_WINDOW,
+        BLACKMAN_WINDOW
+    };
+
+    // filters that a image can be resized with while it is being loaded
+    enum ResizeFilter
+    {
+        BILINEAR_FILTER,
+        BICUBIC_FILTER,
+        MITCHELL_FILTER,
+        B_SPLINE_FILTER,
+        LANCZOS2_FILTER,
+        LANCZOS3_FILTER,
+        AREA_FILTER
+    };
+
+    // how much time the .png encoder spends on making files smaller, from storing the pixels uncompressed
+    // to the slowest and smallest setting
+    enum EncodeEffort
+    {
+        STORE_EFFORT,
+        FASTEST_EFFORT,
+        FAST_EFFORT,
+        DEFAULT_EFFORT,
+        SMALL_EFFORT,
+        MAX_EFFORT
+    };
+
+    // Settings for writing .png files.
+    struct EncodeOptions
+    {
+        EncodeOptions(const EncodeEffort inEffort = DEFAULT_EFFORT) : effort(inEffort){}
+
+        EncodeEffort effort;
+    };
+
+    // What the header of a .png file tells about the image, read without decoding any pixels.
+    // For files that can't be read or are no .png files valid is false and the other members are zero.
+    struct ImageHeader
+    {
+        ImageHeader() : width(0), height(0), bitDepth(0), colorType(0), interlaced(false), decodedSize(0), valid(false){}
+
+        unsigned width, height;
+
+        // bits per channel and the lodepng color type of the pixels in the file
+        unsigned bitDepth;
+        unsigned colorType;
+
+        bool interlaced;
+
+        // estimate of the memory in bytes that decoding the image takes when it is decoded as a whole
+        size_t decodedSize;
+
+        bool valid;
+    };
+
+    // A image of a batch, a batch resizes its files in the order of its jobs.
+    struct BatchJob
+    {
+        BatchJob() : index(0), cost(0), memory(0){}
+
+        // position of the file in the list of filenames that the batch was planned from
+        unsigned index;
+
+        ImageHeader header;
+
+        // estimate of the work of resizing the image, pixels read times the filter support plus pixels written
+        unsigned long long cost;
+
+        // estimate of the memory in bytes that resizing the image takes at most
+        size_t memory;
+    };
+
+    // A RGBA image that owns its pixels. Every row starts on a ROW_ALIGNMENT byte boundary and rows are
+    // stride bytes apart, the padding at the end of each row is zeroed so vector code can read whole blocks.
+    // Images can be moved but not copied.
     struct Image
     {
-        Image() : width(0), height(0), data(nullptr){}
-        Image(int inWidth, int inHeight) : width(inWidth), height(inHeight){ data = new unsigned char[width * height * NUMBER_OF_CHANNELS]; }
-        ~Image(){ delete[] data; }
+        Image();
+        Image(const unsigned inWidth, const unsigned inHeight);
+        Image(Image &&other);
+        Image &operator=(Image &&other);
+        Image(const Image &) = delete;
+        Image &operator=(const Image &) = delete;
+        ~Image();
+
+        unsigned char *row(const unsigned y) { return data + (size_t)y * stride; }
+        const unsigned char *row(const unsigned y) const { return data + (size_t)y * stride; }
 
         // image data stored per pixel in the order rgba
         unsigned char *data;
 
         // image size in number of pixels
         unsigned width, height;
+
+        // number of bytes from the start of one row to the start of the next
+        unsigned stride;
     };
 
-    Image *readImageFromFile(const char *filename);
-    void saveImageToFile(const char *filename, const Image *image);
+    std::unique_ptr<Image> createImage(const unsigned width, const unsigned height);
+    std::unique_ptr<Image> readImageFromFile(const char *filename);
+    std::unique_ptr<Image> readResizedImageFromFile(const char *filename, const float widthScale, const float heightScale, const ResizeFilter filter);
+    std::unique_ptr<Image> readResizedImageFromFile(const char *filename, const int width, const int height, const ResizeFilter filter);
+    bool resizeImageFile(const char *inputFilename, const char *outputFilename, const float widthScale, const float heightScale, const ResizeFilter filter, const EncodeOptions &options = EncodeOptions());
+    bool resizeImageFile(const char *inputFilename, const char *outputFilename, const int width, const int height, const ResizeFilter filter, const EncodeOptions &options = EncodeOptions());
+    bool saveImageToFile(const char *filename, const Image *image, const EncodeOptions &options = EncodeOptions());
     bool isValidSize(const int width, const int height);
-    Image *bicubicInterpolation(const Image *image, const float widthScale, const float heightScale);
-    Image *bicubicInterpolation(const Image *image, const int width, const int height);
-    Image *bilinearInterpolation(const Image *image, const float width, const float height);
-    Image *bilinearInterpolation(const Image *image, const int width, const int height);
-    Image *nearestNeighbourInterpolation(const Image *image, const float width, const float height);
-    Image *nearestNeighbourInterpolation(const Image *image, const int width, const int height);
-};
+    ImageHeader readImageHeader(const char *filename);
+    void estimateResize(BatchJob &job, const int width, const int height, const ResizeFilter filter);
+    void estimateNearestResize(BatchJob &job, const int width, const int height);
+    std::vector<BatchJob> planBatch(const std::vector<std::string> &filenames, const unsigned threadCount,
+        const std::function<void(BatchJob &job)> &estimate = nullptr);
+    void setThreadCount(const unsigned threadCount);
+    unsigned getThreadCount();
+    std::unique_ptr<Image> bicubicInterpolation(const Image *image, const float widthScale, const float heightScale, const CubicParameters &parameters = CATMULL_ROM);
+    std::unique_ptr<Image> bicubicInterpolation(const Image *image, const int width, const int height, const CubicParameters &parameters = CATMULL_ROM);
+    std::unique_ptr<Image> bilinearInterpolation(const Image *image, const float width, const float height);
+    std::unique_ptr<Image> bilinearInterpolation(const Image *image, const int width, const int height);
+    std::unique_ptr<Image> lanczosInterpolation(const Image *image, const float widthScale, const float heightScale, const int lobes = 3);
+    std::unique_ptr<Image> lanczosInterpolation(const Image *image, const int width, const int height, const int lobes = 3);
+    std::unique_ptr<Image> windowedSincInterpolation(const Image *image, const float widthScale, const float heightScale, const WindowFunction window, const int lobes);
+    std::unique_ptr<Image> windowedSincInterpolation(const Image *image, const int width, const int height, const WindowFunction window, const int lobes);
+    std::unique_ptr<Image> areaResize(const Image *image, const float widthScale, const float heightScale);
+    std::unique_ptr<Image> areaResize(const Image *image, const int width, const int height);
+    std::unique_ptr<Image> nearestNeighbourInterpolation(const Image *image, const float width, const float height);
+    std::unique_ptr<Image> nearestNeighbourInterpolation(const Image *image, const int width, const int height);
+};
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "thread_pool.h"
+#include <atomic>
+#include <memory>
+
+namespace
+{
+    // pool shared by all resize calls, it has one thread less than the thread count since the caller also does work
+    std::unique_ptr<Resizer::ThreadPool> sharedPool;
+    unsigned sharedThreadCount = 1;
+
+    // Bookkeeping for one parallelFor call, shared with the tasks since they can outlive the call.
+    struct ParallelJob
+    {
+        std::atomic<unsigned> nextBand;
+        std::atomic<unsigned> remainingBands;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+}
+
+// Starts the worker threads.
+Resizer::ThreadPool::ThreadPool(const unsigned threadCount) : stopping(false), busy(0)
+{
+    for (unsigned i = 0; i < threadCount; ++i)
+        workers.push_back(std::thread(&Resizer::ThreadPool::run, this));
+}
+
+// Lets the workers finish all submitted tasks and then joins them.
+Resizer::ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    for (size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+}
+
+// Queues a task to be run by the first available worker.
+void Resizer::ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    condition.notify_one();
+}
+
+// Returns how many workers are neither running a task nor about to start one of the queued tasks.
+// Other threads can submit tasks at any time, so it is only a hint.
+unsigned Resizer::ThreadPool::idleCount()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    const size_t taken = busy + tasks.size();
+    return (taken < workers.size()) ? (unsigned)(workers.size() - taken) : 0;
+}
+
+// Worker loop, runs tasks until the pool is destroyed and the queue is empty.
+void Resizer::ThreadPool::run()
+{
+    std::function<void()> task;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (task) --busy;
+            condition.wait(lock, [this]{ return stopping || !tasks.empty(); });
+            if (tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            ++busy;
+        }
+        task();
+    }
+}
+
+Resizer::MemoryBudget::MemoryBudget(const size_t limit) : limit(limit), used(0)
+{
+}
+
+// Waits until the budget has room for bytes and takes them.
+void Resizer::MemoryBudget::acquire(const size_t bytes)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this, bytes]{ return fits(bytes, 0); });
+    used += bytes;
+}
+
+// Takes bytes from the budget if it has room for them right now and still leaves reserved bytes free,
+// returns false otherwise.
+bool Resizer::MemoryBudget::tryAcquire(const size_t bytes, const size_t reserved)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!fits(bytes, reserved)) return false;
+    used += bytes;
+    return true;
+}
+
+// Gives back bytes that were taken by acquire or tryAcquire.
+void Resizer::MemoryBudget::release(const size_t bytes)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        used -= bytes;
+    }
+    condition.notify_all();
+}
+
+Resizer::BatchScheduler::BatchScheduler(const std::vector<Resizer::BatchJob> &plan, const size_t memoryLimit)
+    : jobs(plan.begin(), plan.end()), budget(memoryLimit)
+{
+}
+
+// Waits until a job fits in the memory budget and hands it out, returns false when all jobs have been handed out.
+bool Resizer::BatchScheduler::next(Resizer::BatchJob &job)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    bool taken = false;
+    condition.wait(lock, [this, &job, &taken]{ return jobs.empty() || (taken = take(job)); });
+    return taken;
+}
+
+// Hands out a job if one fits in the memory budget right now, returns false otherwise.
+bool Resizer::BatchScheduler::tryNext(Resizer::BatchJob &job)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return take(job);
+}
+
+// Gives back the memory of a job that was handed out by next or tryNext once it is done.
+void Resizer::BatchScheduler::finish(const Resizer::BatchJob &job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        budget.release(job.memory);
+    }
+    condition.notify_all();
+}
+
+// Takes the next job in the order of the plan if it fits in the memory budget, otherwise the first job after it
+// that fits beside the memory the next job needs. The mutex has to be locked.
+bool Resizer::BatchScheduler::take(Resizer::BatchJob &job)
+{
+    if (jobs.empty()) return false;
+    const size_t reserved = jobs.front().memory;
+    for (std::deque<Resizer::BatchJob>::iterator it = jobs.begin(); it != jobs.end(); ++it)
+    {
+        if (!budget.tryAcquire(it->memory, (it == jobs.begin()) ? 0 : reserved)) continue;
+        job = *it;
+        jobs.erase(it);
+        return true;
+    }
+    return false;
+}
+
+// Sets how many threads a single resize call may use, 0 uses one thread per hardware thread.
+// It should not be called while images are being resized. A batch that resizes several images at the same time
+// runs its images on these threads as well through parallelFor, so the thread count is the number of threads of the
+// whole batch and threads that have no image left help with the bands of the images that are still running.
+void Resizer::setThreadCount(const unsigned threadCount)
+{
+    unsigned count = (threadCount > 0) ? threadCount : std::thread::hardware_concurrency();
+    count = (count > 0) ? count : 1;
+    if (count == sharedThreadCount) return;
+    sharedPool.reset((count > 1) ? new Resizer::ThreadPool(count - 1) : nullptr);
+    sharedThreadCount = count;
+}
+
+// Returns how many threads a single resize call may use.
+unsigned Resizer::getThreadCount()
+{
+    return sharedThreadCount;
+}
+
+// Calls body for consecutive bands of the range 0 .. count - 1 and returns when all bands are done.
+// The bands are claimed by the shared pool and by the calling thread itself, so the call also completes
+// when every worker is busy, for example when several images are resized at the same time. Only idle workers
+// are asked to help, so calls made while the pool is busy don't leave tasks behind that have nothing left to do.
+// How the range is split does not depend on which thread runs a band, so results are deterministic
+// as long as the bands write to separate memory.
+void Resizer::parallelFor(const unsigned count, const std::function<void(unsigned begin, unsigned end)> &body)
+{
+    Resizer::ThreadPool *pool = sharedPool.get();
+    if (pool == nullptr || count < 2)
+    {
+        if (count > 0) body(0, count);
+        return;
+    }
+
+    // a few bands per thread evens out the work when some threads start late
+    const unsigned maxBands = sharedThreadCount * 4;
+    const unsigned bands = (count < maxBands) ? count : maxBands;
+    std::shared_ptr<ParallelJob> job = std::make_shared<ParallelJob>();
+    job->nextBand = 0;
+    job->remainingBands = bands;
+
+    auto work = [job, &body, count, bands]()
+    {
+        for (unsigned band = job->nextBand++; band < bands; band = job->nextBand++)
+        {
+            body((unsigned)((unsigned long long)count * band / bands), (unsigned)((unsigned long long)count * (band + 1) / bands));
+            if (--job->remainingBands == 0)
+            {
+                std::lock_guard<std::mutex> lock(job->mutex);
+                job->finished.notify_all();
+            }
+        }
+    };
+
+    const unsigned idle = pool->idleCount();
+    const unsigned helpers = (idle < bands - 1) ? idle : bands - 1;
+    for (unsigned i = 0; i < helpers; ++i)
+        pool->submit(work);
+    work();
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->finished.wait(lock, [&job]{ return job->remainingBands == 0; });
+}
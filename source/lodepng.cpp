@@ -39,6 +39,13 @@ Rename this file to lodepng.cpp to use it for C++, or to lodepng.c to use it for
 #pragma warning( disable : 4996 ) /*VS does not like fopen, but fopen_s is not standard C so unusable here*/
 #endif /*_MSC_VER */
 
+#if defined(LODEPNG_COMPILE_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+/*The vectorized code is compiled for its instruction set with function attributes instead of compiler flags, and
+only runs after checking at runtime that the processor supports it. Other compilers and processors use plain C.*/
+#define LODEPNG_X86_SIMD
+#include <immintrin.h>
+#endif
+
 const char* LODEPNG_VERSION_STRING = "20160418";
 
 /*
@@ -347,53 +354,50 @@ static void lodepng_add32bitInt(ucvector* buffer, unsigned value)
 
 #ifdef LODEPNG_COMPILE_DISK
 
-/* returns negative value on error. This should be pure C compatible, so no fstat. */
-static long lodepng_filesize(const char* filename)
+/* returns negative value on error, the file is at its start again afterwards. This should be pure C
+compatible, so no fstat. */
+static long lodepng_filesize(FILE* file)
 {
-	FILE* file;
 	long size;
-	file = fopen(filename, "rb");
-	if (!file) return -1;
-
-	if (fseek(file, 0, SEEK_END) != 0)
-	{
-		fclose(file);
-		return -1;
-	}
+	if (fseek(file, 0, SEEK_END) != 0) return -1;
 
 	size = ftell(file);
 	/* It may give LONG_MAX as directory size, this is invalid for us. */
 	if (size == LONG_MAX) size = -1;
 
-	fclose(file);
+	if (fseek(file, 0, SEEK_SET) != 0) return -1;
 	return size;
 }
 
 /* load file into buffer that already has the correct allocated size. Returns error code.*/
-static unsigned lodepng_buffer_file(unsigned char* out, size_t size, const char* filename)
+static unsigned lodepng_buffer_file(unsigned char* out, size_t size, FILE* file)
 {
-	FILE* file;
-	size_t readsize;
-	file = fopen(filename, "rb");
-	if (!file) return 78;
-
-	readsize = fread(out, 1, size, file);
-	fclose(file);
-
+	size_t readsize = fread(out, 1, size, file);
 	if (readsize != size) return 78;
 	return 0;
 }
 
 unsigned lodepng_load_file(unsigned char** out, size_t* outsize, const char* filename)
 {
-	long size = lodepng_filesize(filename);
-	if (size < 0) return 78;
-	*outsize = (size_t)size;
-
-	*out = (unsigned char*)lodepng_malloc((size_t)size);
-	if (!(*out) && size > 0) return 83; /*the above malloc failed*/
+	unsigned error;
+	long size;
+	/*the file is opened once for both its size and its contents*/
+	FILE* file = fopen(filename, "rb");
+	*out = 0;
+	*outsize = 0;
+	if (!file) return 78;
 
-	return lodepng_buffer_file(*out, (size_t)size, filename);
+	size = lodepng_filesize(file);
+	if (size < 0) error = 78;
+	else
+	{
+		*outsize = (size_t)size;
+		*out = (unsigned char*)lodepng_malloc((size_t)size);
+		if (!(*out) && size > 0) error = 83; /*the above malloc failed*/
+		else error = lodepng_buffer_file(*out, (size_t)size, file);
+	}
+	fclose(file);
+	return error;
 }
 
 /*write given buffer to the file, overwriting the file, it doesn't append to it.*/
@@ -440,29 +444,6 @@ static void addBitsToStreamReversed(size_t* bitpointer, ucvector* bitstream, uns
 }
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
-#ifdef LODEPNG_COMPILE_DECODER
-
-#define READBIT(bitpointer, bitstream) ((bitstream[bitpointer >> 3] >> (bitpointer & 0x7)) & (unsigned char)1)
-
-static unsigned char readBitFromStream(size_t* bitpointer, const unsigned char* bitstream)
-{
-	unsigned char result = (unsigned char)(READBIT(*bitpointer, bitstream));
-	++(*bitpointer);
-	return result;
-}
-
-static unsigned readBitsFromStream(size_t* bitpointer, const unsigned char* bitstream, size_t nbits)
-{
-	unsigned result = 0, i;
-	for (i = 0; i != nbits; ++i)
-	{
-		result += ((unsigned)READBIT(*bitpointer, bitstream)) << i;
-		++(*bitpointer);
-	}
-	return result;
-}
-#endif /*LODEPNG_COMPILE_DECODER*/
-
 /* ////////////////////////////////////////////////////////////////////////// */
 /* / Deflate - Huffman                                                      / */
 /* ////////////////////////////////////////////////////////////////////////// */
@@ -513,6 +494,8 @@ typedef struct HuffmanTree
 	unsigned* lengths; /*the lengths of the codes of the 1d-tree*/
 	unsigned maxbitlen; /*maximum number of bits a single code can get*/
 	unsigned numcodes; /*number of symbols in the alphabet = number of codes*/
+	unsigned char* table_len; /*decoding tables, the code length of every entry*/
+	unsigned short* table_value; /*decoding tables, the symbol of every entry or the start of a second level table*/
 } HuffmanTree;
 
 /*function used for debug purposes to draw the tree in ascii art with C++*/
@@ -533,6 +516,8 @@ static void HuffmanTree_init(HuffmanTree* tree)
 	tree->tree2d = 0;
 	tree->tree1d = 0;
 	tree->lengths = 0;
+	tree->table_len = 0;
+	tree->table_value = 0;
 }
 
 static void HuffmanTree_cleanup(HuffmanTree* tree)
@@ -540,9 +525,11 @@ static void HuffmanTree_cleanup(HuffmanTree* tree)
 	lodepng_free(tree->tree2d);
 	lodepng_free(tree->tree1d);
 	lodepng_free(tree->lengths);
+	lodepng_free(tree->table_len);
+	lodepng_free(tree->table_value);
 }
 
-/*the tree representation used by the decoder. return value is error*/
+/*the tree representation used by the decoder to read codes bit by bit. return value is error*/
 static unsigned HuffmanTree_make2DTree(HuffmanTree* tree)
 {
 	unsigned nodefilled = 0; /*up to which node it is filled*/
@@ -644,8 +631,7 @@ static unsigned HuffmanTree_makeFromLengths2(HuffmanTree* tree)
 	uivector_cleanup(&blcount);
 	uivector_cleanup(&nextcode);
 
-	if (!error) return HuffmanTree_make2DTree(tree);
-	else return error;
+	return error;
 }
 
 /*
@@ -940,23 +926,289 @@ static unsigned generateFixedDistanceTree(HuffmanTree* tree)
 
 #ifdef LODEPNG_COMPILE_DECODER
 
+/*
+Lookup tables decode a Huffman code with one or two reads instead of walking the tree bit by bit. The
+first HUFFMAN_TABLE_BITS bits of the input index the first table. Its entries either hold a symbol and the
+length of its code, or, for longer codes, the index of a second table and HUFFMAN_TABLE_BITS plus the number
+of bits that index it. Deflate stores codes starting with their first bit in the least significant bit,
+so the tables are indexed with the bit reversed codes.
+*/
+#define HUFFMAN_TABLE_BITS 9
+#define HUFFMAN_TABLE_SIZE (1u << HUFFMAN_TABLE_BITS)
+#define HUFFMAN_TABLE_MASK (HUFFMAN_TABLE_SIZE - 1u)
+#define INVALID_SYMBOL 65535u /*table value of codes that are not in the tree*/
+
+static unsigned reverseBits(unsigned bits, unsigned num)
+{
+	unsigned i, result = 0;
+	for (i = 0; i != num; ++i) result |= ((bits >> i) & 1u) << (num - i - 1);
+	return result;
+}
+
+/*makes the lookup tables from the codes in tree1d. return value is error*/
+static unsigned HuffmanTree_makeTable(HuffmanTree* tree)
+{
+	unsigned char maxlens[HUFFMAN_TABLE_SIZE]; /*longest code length starting with each first table index*/
+	unsigned long kraft = 0;
+	size_t size, pointer;
+	unsigned i, n;
+
+	/*codes that use more than all bit combinations would overlap in the tables, see comment in lodepng_error_text*/
+	for (n = 0; n != tree->numcodes; ++n)
+	{
+		if (tree->lengths[n] > 15) return 55;
+		if (tree->lengths[n]) kraft += 1ul << (15 - tree->lengths[n]);
+	}
+	if (kraft > 32768ul) return 55;
+
+	memset(maxlens, 0, sizeof(maxlens));
+	for (n = 0; n != tree->numcodes; ++n)
+	{
+		unsigned l = tree->lengths[n];
+		if (l <= HUFFMAN_TABLE_BITS) continue;
+		i = reverseBits(tree->tree1d[n] >> (l - HUFFMAN_TABLE_BITS), HUFFMAN_TABLE_BITS);
+		if (l > maxlens[i]) maxlens[i] = (unsigned char)l;
+	}
+	size = HUFFMAN_TABLE_SIZE;
+	for (i = 0; i != HUFFMAN_TABLE_SIZE; ++i)
+	{
+		if (maxlens[i] > HUFFMAN_TABLE_BITS) size += (size_t)1u << (maxlens[i] - HUFFMAN_TABLE_BITS);
+	}
+
+	tree->table_len = (unsigned char*)lodepng_malloc(size * sizeof(*tree->table_len));
+	tree->table_value = (unsigned short*)lodepng_malloc(size * sizeof(*tree->table_value));
+	if (!tree->table_len || !tree->table_value) return 83; /*alloc fail*/
+	/*entries of codes that are not in the tree, an incomplete tree has some*/
+	for (i = 0; i != size; ++i)
+	{
+		tree->table_len[i] = 1;
+		tree->table_value[i] = INVALID_SYMBOL;
+	}
+
+	/*point the first table to the second tables, whose entries are marked as invalid by their length too*/
+	pointer = HUFFMAN_TABLE_SIZE;
+	for (i = 0; i != HUFFMAN_TABLE_SIZE; ++i)
+	{
+		size_t j, subsize;
+		if (maxlens[i] <= HUFFMAN_TABLE_BITS) continue;
+		subsize = (size_t)1u << (maxlens[i] - HUFFMAN_TABLE_BITS);
+		tree->table_len[i] = maxlens[i];
+		tree->table_value[i] = (unsigned short)pointer;
+		for (j = 0; j != subsize; ++j) tree->table_len[pointer + j] = maxlens[i];
+		pointer += subsize;
+	}
+
+	/*fill in the codes, a code shorter than a table's index bits fills every entry that starts with it*/
+	for (n = 0; n != tree->numcodes; ++n)
+	{
+		unsigned l = tree->lengths[n];
+		unsigned reverse;
+		if (l == 0) continue;
+		reverse = reverseBits(tree->tree1d[n], l);
+		if (l <= HUFFMAN_TABLE_BITS)
+		{
+			for (i = reverse; i < HUFFMAN_TABLE_SIZE; i += 1u << l)
+			{
+				tree->table_len[i] = (unsigned char)l;
+				tree->table_value[i] = (unsigned short)n;
+			}
+		}
+		else
+		{
+			unsigned first = reverse & HUFFMAN_TABLE_MASK;
+			unsigned subbits = tree->table_len[first] - HUFFMAN_TABLE_BITS;
+			size_t start = tree->table_value[first];
+			for (i = reverse >> HUFFMAN_TABLE_BITS; i < (1u << subbits); i += 1u << (l - HUFFMAN_TABLE_BITS))
+			{
+				tree->table_len[start + i] = (unsigned char)l;
+				tree->table_value[start + i] = (unsigned short)n;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*makes the representation the inflator reads codes with, the 2D tree or the lookup tables*/
+static unsigned HuffmanTree_makeDecoder(HuffmanTree* tree, unsigned bitwise)
+{
+	return bitwise ? HuffmanTree_make2DTree(tree) : HuffmanTree_makeTable(tree);
+}
+
+/*
+Reads the input bits from a 64-bit buffer that is refilled with several bytes at once. After a refill at least 56
+bits are available, enough for a length code, a distance code and their extra bits. Past the end of the input the
+buffer is filled with zeros, the position then goes past the input size, which the inflator checks for.
+The input can be split in segments, like the data of the IDAT chunks of a PNG, that are read as if they were one
+buffer. next_segment returns the segment that follows the given one and its size, or 0 after the last one.
+*/
+typedef const unsigned char* (*NextSegment)(const unsigned char* segment, size_t* size, const void* context);
+
+typedef struct BitReader
+{
+	const unsigned char* data; /*the current segment*/
+	size_t size; /*size of the current segment*/
+	size_t offset; /*position in the input of the first byte of the current segment*/
+	size_t next; /*the next byte of the current segment to load into the buffer*/
+	unsigned long long buffer; /*the next bits of the input, starting at the least significant bit*/
+	unsigned count; /*number of valid bits in the buffer*/
+	NextSegment next_segment; /*0 if there are no more segments*/
+	const void* context; /*given to next_segment*/
+} BitReader;
+
+/*moves on to the next segment that is not empty, returns 0 if there is none*/
+static unsigned BitReader_nextSegment(BitReader* reader)
+{
+	while (reader->next_segment)
+	{
+		size_t size = 0;
+		const unsigned char* data = reader->next_segment(reader->data, &size, reader->context);
+		if (!data)
+		{
+			reader->next_segment = 0;
+			break;
+		}
+		reader->offset += reader->size;
+		reader->next -= reader->size;
+		reader->data = data;
+		reader->size = size;
+		if (reader->next < size) return 1;
+	}
+	return 0;
+}
+
+static void BitReader_refill(BitReader* reader)
+{
+	if (reader->next + 8 <= reader->size)
+	{
+		/*load 8 bytes, the bytes that don't fit completely are loaded again by the next refill*/
+		const unsigned char* p = &reader->data[reader->next];
+		unsigned long long word = (unsigned long long)p[0] | ((unsigned long long)p[1] << 8)
+			| ((unsigned long long)p[2] << 16) | ((unsigned long long)p[3] << 24)
+			| ((unsigned long long)p[4] << 32) | ((unsigned long long)p[5] << 40)
+			| ((unsigned long long)p[6] << 48) | ((unsigned long long)p[7] << 56);
+		reader->buffer |= word << reader->count;
+		reader->next += (63 - reader->count) >> 3;
+		reader->count |= 56;
+	}
+	else
+	{
+		/*near the end of a segment, the bytes are loaded one by one*/
+		while (reader->count <= 56)
+		{
+			unsigned long long byte;
+			if (reader->next >= reader->size) BitReader_nextSegment(reader);
+			byte = reader->next < reader->size ? reader->data[reader->next] : 0;
+			reader->buffer |= byte << reader->count;
+			++reader->next;
+			reader->count += 8;
+		}
+	}
+}
+
+/*starts reading at the first segment, next_segment can be 0 if the input is a single buffer*/
+static void BitReader_init(BitReader* reader, const unsigned char* data, size_t size,
+	NextSegment next_segment, const void* context)
+{
+	reader->data = data;
+	reader->size = size;
+	reader->offset = 0;
+	reader->next = 0;
+	reader->buffer = 0;
+	reader->count = 0;
+	reader->next_segment = next_segment;
+	reader->context = context;
+	BitReader_refill(reader);
+}
+
+/*the bit pointer in the input of the next bit to read*/
+static size_t BitReader_position(const BitReader* reader)
+{
+	return (reader->offset + reader->next) * 8 - reader->count;
+}
+
+/*reads nbits bits, at most the number of bits in the buffer*/
+static unsigned BitReader_read(BitReader* reader, unsigned nbits)
+{
+	unsigned result = (unsigned)(reader->buffer & ((1ull << nbits) - 1u));
+	reader->buffer >>= nbits;
+	reader->count -= nbits;
+	return result;
+}
+
+/*reads nbits bits, refilling the buffer first if it holds less than that*/
+static unsigned BitReader_readBits(BitReader* reader, unsigned nbits)
+{
+	if (reader->count < nbits) BitReader_refill(reader);
+	return BitReader_read(reader, nbits);
+}
+
+/*copies size bytes to out, or skips them if out is 0. The reader must be at a byte boundary*/
+static void BitReader_copy(BitReader* reader, unsigned char* out, size_t size)
+{
+	/*first the bytes that are already in the buffer*/
+	for (; size != 0 && reader->count >= 8; --size)
+	{
+		if (out) *out++ = (unsigned char)reader->buffer;
+		reader->buffer >>= 8;
+		reader->count -= 8;
+	}
+	if (size == 0) return;
+
+	/*then the rest straight from the segments, the buffer is empty and has to be refilled from the new position*/
+	reader->buffer = 0;
+	while (size != 0)
+	{
+		size_t n = 0;
+		if (reader->next < reader->size || BitReader_nextSegment(reader)) n = reader->size - reader->next;
+		if (n == 0)
+		{
+			/*past the end of the input*/
+			if (out) memset(out, 0, size);
+			reader->next += size;
+			break;
+		}
+		if (n > size) n = size;
+		if (out)
+		{
+			memcpy(out, reader->data + reader->next, n);
+			out += n;
+		}
+		reader->next += n;
+		size -= n;
+	}
+}
+
+/*returns the symbol, or INVALID_SYMBOL if the code is not in the tree. The buffer must hold at least 15 bits*/
+static unsigned huffmanDecodeTable(BitReader* reader, const HuffmanTree* codetree)
+{
+	unsigned index = (unsigned)(reader->buffer & HUFFMAN_TABLE_MASK);
+	unsigned l = codetree->table_len[index];
+	unsigned value = codetree->table_value[index];
+	if (l > HUFFMAN_TABLE_BITS)
+	{
+		/*the code continues in a second table*/
+		index = value + (unsigned)((reader->buffer >> HUFFMAN_TABLE_BITS) & ((1u << (l - HUFFMAN_TABLE_BITS)) - 1u));
+		l = codetree->table_len[index];
+		value = codetree->table_value[index];
+	}
+	reader->buffer >>= l;
+	reader->count -= l;
+	return value;
+}
+
 /*
 returns the code, or (unsigned)(-1) if error happened
 inbitlength is the length of the complete buffer, in bits (so its byte length times 8)
 */
-static unsigned huffmanDecodeSymbol(const unsigned char* in, size_t* bp,
-	const HuffmanTree* codetree, size_t inbitlength)
+static unsigned huffmanDecodeSymbol(BitReader* reader, const HuffmanTree* codetree, size_t inbitlength)
 {
 	unsigned treepos = 0, ct;
 	for (;;)
 	{
-		if (*bp >= inbitlength) return (unsigned)(-1); /*error: end of input memory reached without endcode*/
-		/*
-		decode the symbol from the tree. The "readBitFromStream" code is inlined in
-		the expression below because this is the biggest bottleneck while decoding
-		*/
-		ct = codetree->tree2d[(treepos << 1) + READBIT(*bp, in)];
-		++(*bp);
+		if (BitReader_position(reader) >= inbitlength) return (unsigned)(-1); /*error: end of input memory reached without endcode*/
+		/*decode the symbol from the tree*/
+		ct = codetree->tree2d[(treepos << 1) + BitReader_readBits(reader, 1)];
 		if (ct < codetree->numcodes) return ct; /*the symbol is decoded, return it*/
 		else treepos = ct - codetree->numcodes; /*symbol not yet decoded, instead move tree position*/
 
@@ -971,17 +1223,58 @@ static unsigned huffmanDecodeSymbol(const unsigned char* in, size_t* bp,
 /* / Inflator (Decompressor)                                                / */
 /* ////////////////////////////////////////////////////////////////////////// */
 
+/*
+Optional streaming output of inflate. Without it the out vector grows to the full decompressed size. With it,
+every time more than INFLATE_STREAM_FLUSH new bytes were produced they are handed to the callback, and only the
+last INFLATE_WINDOW bytes, the longest distance a deflate length code can reach back, are kept in the out vector.
+*/
+#define INFLATE_WINDOW 32768
+#define INFLATE_STREAM_FLUSH 65536
+/*a callback can return this to stop inflating early without an error, the checksum is then not checked*/
+#define INFLATE_STREAM_STOP ((unsigned)(-1))
+
+typedef struct InflateStream
+{
+	unsigned (*callback)(void* user, const unsigned char* data, size_t size); /*returns nonzero error code to stop*/
+	void* user;
+	size_t delivered; /*bytes at the start of the out vector that were already given to the callback*/
+	unsigned adler; /*running adler32 of all bytes given to the callback*/
+} InflateStream;
+
+static unsigned update_adler32(unsigned adler, const unsigned char* data, unsigned len);
+
+/*gives the new bytes to the stream callback and, unless this is the final flush, drops all but the window*/
+static unsigned inflateStreamFlush(ucvector* out, size_t* pos, InflateStream* stream, unsigned final)
+{
+	if (*pos > stream->delivered)
+	{
+		unsigned error = stream->callback(stream->user, out->data + stream->delivered, *pos - stream->delivered);
+		if (error) return error;
+		stream->adler = update_adler32(stream->adler, out->data + stream->delivered, (unsigned)(*pos - stream->delivered));
+	}
+	if (!final && *pos > INFLATE_WINDOW)
+	{
+		memmove(out->data, out->data + *pos - INFLATE_WINDOW, INFLATE_WINDOW);
+		*pos = INFLATE_WINDOW;
+		out->size = INFLATE_WINDOW;
+	}
+	stream->delivered = *pos;
+	return 0;
+}
+
 /*get the tree of a deflated block with fixed tree, as specified in the deflate specification*/
-static void getTreeInflateFixed(HuffmanTree* tree_ll, HuffmanTree* tree_d)
+static unsigned getTreeInflateFixed(HuffmanTree* tree_ll, HuffmanTree* tree_d, unsigned bitwise)
 {
-	/*TODO: check for out of memory errors*/
-	generateFixedLitLenTree(tree_ll);
-	generateFixedDistanceTree(tree_d);
+	unsigned error = generateFixedLitLenTree(tree_ll);
+	if (!error) error = generateFixedDistanceTree(tree_d);
+	if (!error) error = HuffmanTree_makeDecoder(tree_ll, bitwise);
+	if (!error) error = HuffmanTree_makeDecoder(tree_d, bitwise);
+	return error;
 }
 
 /*get the tree of a deflated block with dynamic tree, the tree itself is also Huffman compressed with a known tree*/
 static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
-	const unsigned char* in, size_t* bp, size_t inlength)
+	BitReader* reader, size_t inlength, unsigned bitwise)
 {
 	/*make sure that length values that aren't filled in will be 0, or a wrong tree will be generated*/
 	unsigned error = 0;
@@ -995,16 +1288,16 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
 	unsigned* bitlen_cl = 0;
 	HuffmanTree tree_cl; /*the code tree for code length codes (the huffman tree for compressed huffman trees)*/
 
-	if ((*bp) + 14 > (inlength << 3)) return 49; /*error: the bit pointer is or will go past the memory*/
+	if (BitReader_position(reader) + 14 > (inlength << 3)) return 49; /*error: the bit pointer is or will go past the memory*/
 
 	/*number of literal/length codes + 257. Unlike the spec, the value 257 is added to it here already*/
-	HLIT = readBitsFromStream(bp, in, 5) + 257;
+	HLIT = BitReader_readBits(reader, 5) + 257;
 	/*number of distance codes. Unlike the spec, the value 1 is added to it here already*/
-	HDIST = readBitsFromStream(bp, in, 5) + 1;
+	HDIST = BitReader_readBits(reader, 5) + 1;
 	/*number of code length codes. Unlike the spec, the value 4 is added to it here already*/
-	HCLEN = readBitsFromStream(bp, in, 4) + 4;
+	HCLEN = BitReader_readBits(reader, 4) + 4;
 
-	if ((*bp) + HCLEN * 3 > (inlength << 3)) return 50; /*error: the bit pointer is or will go past the memory*/
+	if (BitReader_position(reader) + HCLEN * 3 > (inlength << 3)) return 50; /*error: the bit pointer is or will go past the memory*/
 
 	HuffmanTree_init(&tree_cl);
 
@@ -1017,11 +1310,12 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
 
 		for (i = 0; i != NUM_CODE_LENGTH_CODES; ++i)
 		{
-			if (i < HCLEN) bitlen_cl[CLCL_ORDER[i]] = readBitsFromStream(bp, in, 3);
+			if (i < HCLEN) bitlen_cl[CLCL_ORDER[i]] = BitReader_readBits(reader, 3);
 			else bitlen_cl[CLCL_ORDER[i]] = 0; /*if not, it must stay 0*/
 		}
 
 		error = HuffmanTree_makeFromLengths(&tree_cl, bitlen_cl, NUM_CODE_LENGTH_CODES, 7);
+		if (!error) error = HuffmanTree_make2DTree(&tree_cl); /*few codes are read with it, so bit by bit is fine*/
 		if (error) break;
 
 		/*now we can use this tree to read the lengths for the tree that this function will return*/
@@ -1035,7 +1329,7 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
 		i = 0;
 		while (i < HLIT + HDIST)
 		{
-			unsigned code = huffmanDecodeSymbol(in, bp, &tree_cl, inbitlength);
+			unsigned code = huffmanDecodeSymbol(reader, &tree_cl, inbitlength);
 			if (code <= 15) /*a length code*/
 			{
 				if (i < HLIT) bitlen_ll[i] = code;
@@ -1049,8 +1343,8 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
 
 				if (i == 0) ERROR_BREAK(54); /*can't repeat previous if i is 0*/
 
-				if ((*bp + 2) > inbitlength) ERROR_BREAK(50); /*error, bit pointer jumps past memory*/
-				replength += readBitsFromStream(bp, in, 2);
+				if ((BitReader_position(reader) + 2) > inbitlength) ERROR_BREAK(50); /*error, bit pointer jumps past memory*/
+				replength += BitReader_readBits(reader, 2);
 
 				if (i < HLIT + 1) value = bitlen_ll[i - 1];
 				else value = bitlen_d[i - HLIT - 1];
@@ -1066,8 +1360,8 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
 			else if (code == 17) /*repeat "0" 3-10 times*/
 			{
 				unsigned replength = 3; /*read in the bits that indicate repeat length*/
-				if ((*bp + 3) > inbitlength) ERROR_BREAK(50); /*error, bit pointer jumps past memory*/
-				replength += readBitsFromStream(bp, in, 3);
+				if ((BitReader_position(reader) + 3) > inbitlength) ERROR_BREAK(50); /*error, bit pointer jumps past memory*/
+				replength += BitReader_readBits(reader, 3);
 
 				/*repeat this value in the next lengths*/
 				for (n = 0; n < replength; ++n)
@@ -1082,8 +1376,8 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
 			else if (code == 18) /*repeat "0" 11-138 times*/
 			{
 				unsigned replength = 11; /*read in the bits that indicate repeat length*/
-				if ((*bp + 7) > inbitlength) ERROR_BREAK(50); /*error, bit pointer jumps past memory*/
-				replength += readBitsFromStream(bp, in, 7);
+				if ((BitReader_position(reader) + 7) > inbitlength) ERROR_BREAK(50); /*error, bit pointer jumps past memory*/
+				replength += BitReader_readBits(reader, 7);
 
 				/*repeat this value in the next lengths*/
 				for (n = 0; n < replength; ++n)
@@ -1101,7 +1395,7 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
 				{
 					/*return error code 10 or 11 depending on the situation that happened in huffmanDecodeSymbol
 					(10=no endcode, 11=wrong jump outside of tree)*/
-					error = (*bp) > inbitlength ? 10 : 11;
+					error = BitReader_position(reader) > inbitlength ? 10 : 11;
 				}
 				else error = 16; /*unexisting code, this can never happen*/
 				break;
@@ -1113,8 +1407,9 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
 
 		/*now we've finally got HLIT and HDIST, so generate the code trees, and the function is done*/
 		error = HuffmanTree_makeFromLengths(tree_ll, bitlen_ll, NUM_DEFLATE_CODE_SYMBOLS, 15);
-		if (error) break;
-		error = HuffmanTree_makeFromLengths(tree_d, bitlen_d, NUM_DISTANCE_SYMBOLS, 15);
+		if (!error) error = HuffmanTree_makeFromLengths(tree_d, bitlen_d, NUM_DISTANCE_SYMBOLS, 15);
+		if (!error) error = HuffmanTree_makeDecoder(tree_ll, bitwise);
+		if (!error) error = HuffmanTree_makeDecoder(tree_d, bitwise);
 
 		break; /*end of error-while*/
 	}
@@ -1127,9 +1422,9 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
 	return error;
 }
 
-/*inflate a block with dynamic of fixed Huffman tree*/
-static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size_t* bp,
-	size_t* pos, size_t inlength, unsigned btype)
+/*inflate a block with dynamic of fixed Huffman tree, reading the codes bit by bit by walking the trees*/
+static unsigned inflateHuffmanBlock(ucvector* out, BitReader* reader,
+	size_t* pos, size_t inlength, unsigned btype, InflateStream* stream)
 {
 	unsigned error = 0;
 	HuffmanTree tree_ll; /*the huffman tree for literal and length codes*/
@@ -1139,13 +1434,19 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
 	HuffmanTree_init(&tree_ll);
 	HuffmanTree_init(&tree_d);
 
-	if (btype == 1) getTreeInflateFixed(&tree_ll, &tree_d);
-	else if (btype == 2) error = getTreeInflateDynamic(&tree_ll, &tree_d, in, bp, inlength);
+	if (btype == 1) error = getTreeInflateFixed(&tree_ll, &tree_d, 1);
+	else if (btype == 2) error = getTreeInflateDynamic(&tree_ll, &tree_d, reader, inlength, 1);
 
 	while (!error) /*decode all symbols until end reached, breaks at end code*/
 	{
 		/*code_ll is literal, length or end code*/
-		unsigned code_ll = huffmanDecodeSymbol(in, bp, &tree_ll, inbitlength);
+		unsigned code_ll;
+		if (stream && *pos >= INFLATE_WINDOW + INFLATE_STREAM_FLUSH)
+		{
+			error = inflateStreamFlush(out, pos, stream, 0);
+			if (error) break;
+		}
+		code_ll = huffmanDecodeSymbol(reader, &tree_ll, inbitlength);
 		if (code_ll <= 255) /*literal symbol*/
 		{
 			/*ucvector_push_back would do the same, but for some reason the two lines below run 10% faster*/
@@ -1164,18 +1465,18 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
 
 			/*part 2: get extra bits and add the value of that to length*/
 			numextrabits_l = LENGTHEXTRA[code_ll - FIRST_LENGTH_CODE_INDEX];
-			if ((*bp + numextrabits_l) > inbitlength) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
-			length += readBitsFromStream(bp, in, numextrabits_l);
+			if ((BitReader_position(reader) + numextrabits_l) > inbitlength) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
+			length += BitReader_readBits(reader, numextrabits_l);
 
 			/*part 3: get distance code*/
-			code_d = huffmanDecodeSymbol(in, bp, &tree_d, inbitlength);
+			code_d = huffmanDecodeSymbol(reader, &tree_d, inbitlength);
 			if (code_d > 29)
 			{
 				if (code_ll == (unsigned)(-1)) /*huffmanDecodeSymbol returns (unsigned)(-1) in case of error*/
 				{
 					/*return error code 10 or 11 depending on the situation that happened in huffmanDecodeSymbol
 					(10=no endcode, 11=wrong jump outside of tree)*/
-					error = (*bp) > inlength * 8 ? 10 : 11;
+					error = BitReader_position(reader) > inlength * 8 ? 10 : 11;
 				}
 				else error = 18; /*error: invalid distance code (30-31 are never used)*/
 				break;
@@ -1184,8 +1485,8 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
 
 			/*part 4: get extra bits from distance*/
 			numextrabits_d = DISTANCEEXTRA[code_d];
-			if ((*bp + numextrabits_d) > inbitlength) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
-			distance += readBitsFromStream(bp, in, numextrabits_d);
+			if ((BitReader_position(reader) + numextrabits_d) > inbitlength) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
+			distance += BitReader_readBits(reader, numextrabits_d);
 
 			/*part 5: fill in all the out[n] values based on the length and dist*/
 			start = (*pos);
@@ -1212,7 +1513,7 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
 		{
 			/*return error code 10 or 11 depending on the situation that happened in huffmanDecodeSymbol
 			(10=no endcode, 11=wrong jump outside of tree)*/
-			error = ((*bp) > inlength * 8) ? 10 : 11;
+			error = (BitReader_position(reader) > inlength * 8) ? 10 : 11;
 			break;
 		}
 	}
@@ -1223,19 +1524,100 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
 	return error;
 }
 
-static unsigned inflateNoCompression(ucvector* out, const unsigned char* in, size_t* bp, size_t* pos, size_t inlength)
+/*inflate a block with dynamic of fixed Huffman tree, reading the codes with lookup tables*/
+static unsigned inflateHuffmanBlockTable(ucvector* out, BitReader* reader,
+	size_t* pos, size_t inlength, unsigned btype, InflateStream* stream)
+{
+	unsigned error = 0;
+	HuffmanTree tree_ll; /*the huffman tree for literal and length codes*/
+	HuffmanTree tree_d; /*the huffman tree for distance codes*/
+	size_t inbitlength = inlength * 8;
+
+	HuffmanTree_init(&tree_ll);
+	HuffmanTree_init(&tree_d);
+
+	if (btype == 1) error = getTreeInflateFixed(&tree_ll, &tree_d, 0);
+	else if (btype == 2) error = getTreeInflateDynamic(&tree_ll, &tree_d, reader, inlength, 0);
+
+	while (!error) /*decode all symbols until end reached, breaks at end code*/
+	{
+		/*code_ll is literal, length or end code*/
+		unsigned code_ll;
+		if (stream && *pos >= INFLATE_WINDOW + INFLATE_STREAM_FLUSH)
+		{
+			error = inflateStreamFlush(out, pos, stream, 0);
+			if (error) break;
+		}
+		BitReader_refill(reader); /*enough bits for all the codes of one symbol*/
+		code_ll = huffmanDecodeTable(reader, &tree_ll);
+		if (BitReader_position(reader) > inbitlength) ERROR_BREAK(10); /*error: end of input memory reached without endcode*/
+		if (code_ll <= 255) /*literal symbol*/
+		{
+			if (!ucvector_resize(out, (*pos) + 1)) ERROR_BREAK(83 /*alloc fail*/);
+			out->data[*pos] = (unsigned char)code_ll;
+			++(*pos);
+		}
+		else if (code_ll >= FIRST_LENGTH_CODE_INDEX && code_ll <= LAST_LENGTH_CODE_INDEX) /*length code*/
+		{
+			unsigned code_d, distance;
+			size_t start, forward, backward, length;
+
+			/*get length base and the extra bits added to it*/
+			length = LENGTHBASE[code_ll - FIRST_LENGTH_CODE_INDEX];
+			length += BitReader_read(reader, LENGTHEXTRA[code_ll - FIRST_LENGTH_CODE_INDEX]);
+			if (BitReader_position(reader) > inbitlength) ERROR_BREAK(51); /*error, bit pointer jumped past memory*/
+
+			/*get distance code, its base and the extra bits added to it*/
+			code_d = huffmanDecodeTable(reader, &tree_d);
+			if (BitReader_position(reader) > inbitlength) ERROR_BREAK(10); /*error: end of input memory reached*/
+			if (code_d > 29) ERROR_BREAK(18); /*error: invalid distance code (30-31 are never used)*/
+			distance = DISTANCEBASE[code_d];
+			distance += BitReader_read(reader, DISTANCEEXTRA[code_d]);
+			if (BitReader_position(reader) > inbitlength) ERROR_BREAK(51); /*error, bit pointer jumped past memory*/
+
+			/*fill in all the out[n] values based on the length and dist*/
+			start = (*pos);
+			if (distance > start) ERROR_BREAK(52); /*too long backward distance*/
+			backward = start - distance;
+
+			if (!ucvector_resize(out, (*pos) + length)) ERROR_BREAK(83 /*alloc fail*/);
+			if (distance < length) {
+				for (forward = 0; forward < length; ++forward)
+				{
+					out->data[(*pos)++] = out->data[backward++];
+				}
+			}
+			else {
+				memcpy(out->data + *pos, out->data + backward, length);
+				*pos += length;
+			}
+		}
+		else if (code_ll == 256)
+		{
+			break; /*end code, break the loop*/
+		}
+		else ERROR_BREAK(11); /*error: a code that is not in the tree*/
+	}
+	HuffmanTree_cleanup(&tree_ll);
+	HuffmanTree_cleanup(&tree_d);
+
+	return error;
+}
+
+static unsigned inflateNoCompression(ucvector* out, BitReader* reader, size_t* pos, size_t inlength)
 {
 	size_t p;
-	unsigned LEN, NLEN, n, error = 0;
+	unsigned LEN, NLEN;
 
 	/*go to first boundary of byte*/
-	while (((*bp) & 0x7) != 0) ++(*bp);
-	p = (*bp) / 8; /*byte position*/
+	BitReader_read(reader, reader->count & 7);
+	p = BitReader_position(reader) / 8; /*byte position*/
 
 	/*read LEN (2 bytes) and NLEN (2 bytes)*/
 	if (p + 4 >= inlength) return 52; /*error, bit pointer will jump past memory*/
-	LEN = in[p] + 256u * in[p + 1]; p += 2;
-	NLEN = in[p] + 256u * in[p + 1]; p += 2;
+	LEN = BitReader_readBits(reader, 16);
+	NLEN = BitReader_readBits(reader, 16);
+	p += 4;
 
 	/*check if 16-bit NLEN is really the one's complement of LEN*/
 	if (LEN + NLEN != 65535) return 21; /*error: NLEN is not one's complement of LEN*/
@@ -1244,40 +1626,38 @@ static unsigned inflateNoCompression(ucvector* out, const unsigned char* in, siz
 
 	/*read the literal data: LEN bytes are now stored in the out buffer*/
 	if (p + LEN > inlength) return 23; /*error: reading outside of in buffer*/
-	for (n = 0; n < LEN; ++n) out->data[(*pos)++] = in[p++];
-
-	(*bp) = p * 8;
+	BitReader_copy(reader, out->data + *pos, LEN);
+	*pos += LEN;
 
-	return error;
+	return 0;
 }
 
-static unsigned lodepng_inflatev(ucvector* out,
-	const unsigned char* in, size_t insize,
-	const LodePNGDecompressSettings* settings)
+/*inflates the deflate data that the reader is at, inlength is the size of its whole input*/
+static unsigned lodepng_inflatev(ucvector* out, BitReader* reader, size_t inlength,
+	const LodePNGDecompressSettings* settings, InflateStream* stream)
 {
-	/*bit pointer in the "in" data, current byte is bp >> 3, current bit is bp & 0x7 (from lsb to msb of the byte)*/
-	size_t bp = 0;
 	unsigned BFINAL = 0;
 	size_t pos = 0; /*byte position in the out buffer*/
 	unsigned error = 0;
 
-	(void)settings;
-
 	while (!BFINAL)
 	{
 		unsigned BTYPE;
-		if (bp + 2 >= insize * 8) return 52; /*error, bit pointer will jump past memory*/
-		BFINAL = readBitFromStream(&bp, in);
-		BTYPE = 1u * readBitFromStream(&bp, in);
-		BTYPE += 2u * readBitFromStream(&bp, in);
+		if (BitReader_position(reader) + 2 >= inlength * 8) return 52; /*error, bit pointer will jump past memory*/
+		BFINAL = BitReader_readBits(reader, 1);
+		BTYPE = BitReader_readBits(reader, 2);
 
 		if (BTYPE == 3) return 20; /*error: invalid BTYPE*/
-		else if (BTYPE == 0) error = inflateNoCompression(out, in, &bp, &pos, insize); /*no compression*/
-		else error = inflateHuffmanBlock(out, in, &bp, &pos, insize, BTYPE); /*compression, BTYPE 01 or 10*/
+		else if (BTYPE == 0) error = inflateNoCompression(out, reader, &pos, inlength); /*no compression*/
+		else if (settings->bitwise_huffman) error = inflateHuffmanBlock(out, reader, &pos, inlength, BTYPE, stream);
+		else error = inflateHuffmanBlockTable(out, reader, &pos, inlength, BTYPE, stream); /*compression, BTYPE 01 or 10*/
 
+		/*stored blocks can add up to 64K at once, so the stream is also flushed between blocks*/
+		if (!error && stream && pos >= INFLATE_WINDOW + INFLATE_STREAM_FLUSH) error = inflateStreamFlush(out, &pos, stream, 0);
 		if (error) return error;
 	}
 
+	if (stream) error = inflateStreamFlush(out, &pos, stream, 1);
 	return error;
 }
 
@@ -1287,8 +1667,10 @@ unsigned lodepng_inflate(unsigned char** out, size_t* outsize,
 {
 	unsigned error;
 	ucvector v;
+	BitReader reader;
 	ucvector_init_buffer(&v, *out, *outsize);
-	error = lodepng_inflatev(&v, in, insize, settings);
+	BitReader_init(&reader, in, insize, 0, 0);
+	error = lodepng_inflatev(&v, &reader, insize, settings, 0);
 	*out = v.data;
 	*outsize = v.size;
 	return error;
@@ -1650,36 +2032,172 @@ static unsigned encodeLZ77(uivector* out, Hash* hash,
 	return error;
 }
 
-/* /////////////////////////////////////////////////////////////////////////// */
+/*
+The fast match finder hashes 4 bytes instead of 3, so only the positions that can give a match of at least 4 bytes
+share a chain, and it follows only a few links of that chain. It uses head, chain and val of the same Hash, but not
+the chains of zeros, long runs of zeros are found through the chain of their own hash value.
+*/
+static unsigned getHash4(const unsigned char* data, size_t pos)
+{
+	unsigned word = data[pos] | ((unsigned)data[pos + 1] << 8u) | ((unsigned)data[pos + 2] << 16u) | ((unsigned)data[pos + 3] << 24u);
+	return (word * 2654435761u) >> (32u - 16u); /*Fibonacci hashing to HASH_NUM_VALUES*/
+}
 
-static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, size_t datasize)
+/*
+Adds pos to the hash chains and returns the length of the longest match found for it within maxchainlength links,
+or 0. Positions that can't start a match of 4 bytes are not added.
+*/
+static unsigned findMatchFast(Hash* hash, const unsigned char* in, size_t pos, size_t insize,
+	unsigned windowsize, unsigned maxchainlength, unsigned nicematch, unsigned* offset)
 {
-	/*non compressed deflate block data: 1 bit BFINAL,2 bits BTYPE,(5 bits): it jumps to start of next byte,
-	2 bytes LEN, 2 bytes NLEN, LEN bytes literal DATA*/
+	size_t wpos = pos & (windowsize - 1); /*position for in 'circular' hash buffers*/
+	size_t maxlength = insize - pos < MAX_SUPPORTED_DEFLATE_LENGTH ? insize - pos : MAX_SUPPORTED_DEFLATE_LENGTH;
+	unsigned length = 0, prev_offset = 0, chainlength;
+	unsigned hashval;
+	int hashpos;
 
-	size_t i, j, numdeflateblocks = (datasize + 65534) / 65535;
-	unsigned datapos = 0;
-	for (i = 0; i != numdeflateblocks; ++i)
+	if (pos + 4 > insize) return 0;
+	hashval = getHash4(in, pos);
+	hashpos = hash->head[hashval];
+
+	for (chainlength = 0; chainlength != maxchainlength && hashpos != -1; ++chainlength)
 	{
-		unsigned BFINAL, BTYPE, LEN, NLEN;
-		unsigned char firstbyte;
+		unsigned current_offset = (unsigned)(wpos - hashpos) & (windowsize - 1);
+		const unsigned char* foreptr = &in[pos];
+		const unsigned char* backptr;
+		unsigned current_length;
 
-		BFINAL = (i == numdeflateblocks - 1);
-		BTYPE = 0;
+		/*outdated hash value, or went completely around the circular buffer*/
+		if (hash->val[hashpos] != (int)hashval || current_offset <= prev_offset) break;
+		prev_offset = current_offset;
+		backptr = foreptr - current_offset;
 
-		firstbyte = (unsigned char)(BFINAL + ((BTYPE & 1) << 1) + ((BTYPE & 2) << 1));
-		ucvector_push_back(out, firstbyte);
+		/*only a match that is longer than the one found so far can matter, so its last byte is checked first*/
+		if (backptr[length] == foreptr[length])
+		{
+			current_length = 0;
+			while (current_length != maxlength && backptr[current_length] == foreptr[current_length]) ++current_length;
+			if (current_length > length)
+			{
+				length = current_length;
+				*offset = current_offset;
+				if (length >= nicematch || length == maxlength) break;
+			}
+		}
 
-		LEN = 65535;
-		if (datasize - datapos < 65535) LEN = (unsigned)datasize - datapos;
-		NLEN = 65535 - LEN;
+		if (hash->chain[hashpos] == hashpos) break; /*end of the chain*/
+		hashpos = hash->chain[hashpos];
+	}
 
-		ucvector_push_back(out, (unsigned char)(LEN & 255));
-		ucvector_push_back(out, (unsigned char)(LEN >> 8));
-		ucvector_push_back(out, (unsigned char)(NLEN & 255));
-		ucvector_push_back(out, (unsigned char)(NLEN >> 8));
+	hash->val[wpos] = (int)hashval;
+	hash->chain[wpos] = hash->head[hashval] != -1 ? (unsigned short)hash->head[hashval] : (unsigned short)wpos;
+	hash->head[hashval] = (int)wpos;
+	return length;
+}
 
-		/*Decompressed data*/
+/*
+LZ77-encode the data with the fast match finder, same output format as encodeLZ77. Chains are followed for at most
+windowsize / 256 links, between 2 and 128. With lazymatching, a match is replaced by a longer one that starts at the
+next byte.
+*/
+static unsigned encodeLZ77Fast(uivector* out, Hash* hash,
+	const unsigned char* in, size_t inpos, size_t insize, unsigned windowsize,
+	unsigned minmatch, unsigned nicematch, unsigned lazymatching)
+{
+	size_t pos, i;
+	unsigned maxchainlength = windowsize / 256;
+	unsigned length, offset = 0;
+
+	if (windowsize == 0 || windowsize > 32768) return 60; /*error: windowsize smaller/larger than allowed*/
+	if ((windowsize & (windowsize - 1)) != 0) return 90; /*error: must be power of two*/
+
+	if (maxchainlength < 2) maxchainlength = 2;
+	if (maxchainlength > 128) maxchainlength = 128;
+	if (nicematch > MAX_SUPPORTED_DEFLATE_LENGTH) nicematch = MAX_SUPPORTED_DEFLATE_LENGTH;
+	if (minmatch < 4) minmatch = 4; /*the hash of 4 bytes only finds matches of 4 bytes or more*/
+
+	for (pos = inpos; pos < insize; ++pos)
+	{
+		size_t next = pos + 1; /*the first position that is not in the hash chains yet*/
+		length = findMatchFast(hash, in, pos, insize, windowsize, maxchainlength, nicematch, &offset);
+		if (lazymatching)
+		{
+			while (length >= minmatch && length < nicematch && pos + 1 < insize)
+			{
+				unsigned nextoffset = 0;
+				unsigned nextlength = findMatchFast(hash, in, pos + 1, insize, windowsize, maxchainlength, nicematch, &nextoffset);
+				next = pos + 2;
+				if (nextlength <= length) break;
+				/*push the current character as literal and take the longer match*/
+				if (!uivector_push_back(out, in[pos])) return 83; /*alloc fail*/
+				++pos;
+				length = nextlength;
+				offset = nextoffset;
+			}
+		}
+
+		if (length < minmatch)
+		{
+			if (!uivector_push_back(out, in[pos])) return 83; /*alloc fail*/
+			continue;
+		}
+		if (offset > windowsize) return 86; /*too big (or overflown negative) offset*/
+		addLengthDistance(out, length, offset);
+		/*the positions inside the match can be matched later too*/
+		for (i = next; i < pos + length; ++i)
+		{
+			unsigned dummy;
+			findMatchFast(hash, in, i, insize, windowsize, 0, nicematch, &dummy);
+		}
+		pos += length - 1;
+	}
+
+	return 0;
+}
+
+/*LZ77-encode a block with the match finder chosen in the settings*/
+static unsigned encodeLZ77Settings(uivector* out, Hash* hash,
+	const unsigned char* in, size_t inpos, size_t insize, const LodePNGCompressSettings* settings)
+{
+	if (settings->matchfinder == LMF_FAST)
+	{
+		return encodeLZ77Fast(out, hash, in, inpos, insize, settings->windowsize,
+			settings->minmatch, settings->nicematch, settings->lazymatching);
+	}
+	return encodeLZ77(out, hash, in, inpos, insize, settings->windowsize,
+		settings->minmatch, settings->nicematch, settings->lazymatching);
+}
+
+/* /////////////////////////////////////////////////////////////////////////// */
+
+static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, size_t datasize, unsigned final)
+{
+	/*non compressed deflate block data: 1 bit BFINAL,2 bits BTYPE,(5 bits): it jumps to start of next byte,
+	2 bytes LEN, 2 bytes NLEN, LEN bytes literal DATA*/
+
+	size_t i, j, numdeflateblocks = (datasize + 65534) / 65535;
+	unsigned datapos = 0;
+	for (i = 0; i != numdeflateblocks; ++i)
+	{
+		unsigned BFINAL, BTYPE, LEN, NLEN;
+		unsigned char firstbyte;
+
+		BFINAL = final && (i == numdeflateblocks - 1);
+		BTYPE = 0;
+
+		firstbyte = (unsigned char)(BFINAL + ((BTYPE & 1) << 1) + ((BTYPE & 2) << 1));
+		ucvector_push_back(out, firstbyte);
+
+		LEN = 65535;
+		if (datasize - datapos < 65535) LEN = (unsigned)datasize - datapos;
+		NLEN = 65535 - LEN;
+
+		ucvector_push_back(out, (unsigned char)(LEN & 255));
+		ucvector_push_back(out, (unsigned char)(LEN >> 8));
+		ucvector_push_back(out, (unsigned char)(NLEN & 255));
+		ucvector_push_back(out, (unsigned char)(NLEN >> 8));
+
+		/*Decompressed data*/
 		for (j = 0; j < 65535 && datapos < datasize; ++j)
 		{
 			ucvector_push_back(out, data[datapos++]);
@@ -1784,8 +2302,7 @@ static unsigned deflateDynamic(ucvector* out, size_t* bp, Hash* hash,
 	{
 		if (settings->use_lz77)
 		{
-			error = encodeLZ77(&lz77_encoded, hash, data, datapos, dataend, settings->windowsize,
-				settings->minmatch, settings->nicematch, settings->lazymatching);
+			error = encodeLZ77Settings(&lz77_encoded, hash, data, datapos, dataend, settings);
 			if (error) break;
 		}
 		else
@@ -1994,8 +2511,7 @@ static unsigned deflateFixed(ucvector* out, size_t* bp, Hash* hash,
 	{
 		uivector lz77_encoded;
 		uivector_init(&lz77_encoded);
-		error = encodeLZ77(&lz77_encoded, hash, data, datapos, dataend, settings->windowsize,
-			settings->minmatch, settings->nicematch, settings->lazymatching);
+		error = encodeLZ77Settings(&lz77_encoded, hash, data, datapos, dataend, settings);
 		if (!error) writeLZ77data(bp, out, &lz77_encoded, &tree_ll, &tree_d);
 		uivector_cleanup(&lz77_encoded);
 	}
@@ -2016,8 +2532,154 @@ static unsigned deflateFixed(ucvector* out, size_t* bp, Hash* hash,
 	return error;
 }
 
-static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t insize,
+static unsigned adler32(const unsigned char* data, unsigned len);
+static unsigned adler32_combine(unsigned adler1, unsigned adler2, size_t len2);
+
+/*
+Adds the positions start .. end - 1 to the hash chains without encoding them, so that the block after them
+can refer back to them. Used to give a block that is compressed on its own the window before it.
+*/
+static void hash_prime(Hash* hash, const unsigned char* in, size_t start, size_t end, size_t insize,
 	const LodePNGCompressSettings* settings)
+{
+	size_t pos;
+	unsigned numzeros = 0, dummy;
+	for (pos = start; pos < end; ++pos)
+	{
+		unsigned hashval;
+		if (settings->matchfinder == LMF_FAST)
+		{
+			findMatchFast(hash, in, pos, insize, settings->windowsize, 0, settings->nicematch, &dummy);
+			continue;
+		}
+		/*the same updates as encodeLZ77 does for every position*/
+		hashval = getHash(in, insize, pos);
+		if (hashval == 0)
+		{
+			if (numzeros == 0) numzeros = countZeros(in, insize, pos);
+			else if (pos + numzeros > insize || in[pos + numzeros - 1] != 0) --numzeros;
+		}
+		else
+		{
+			numzeros = 0;
+		}
+		updateHashChain(hash, pos & (settings->windowsize - 1), hashval, numzeros);
+	}
+}
+
+/*the result of one block that was compressed on its own*/
+typedef struct DeflateBlock
+{
+	ucvector out;
+	unsigned adler;
+	unsigned error;
+} DeflateBlock;
+
+/*the blocks of a parallel_for call, block i covers in[start + i * blocksize ..] up to end at most*/
+typedef struct DeflateBlocks
+{
+	const LodePNGCompressSettings* settings;
+	const unsigned char* in;
+	size_t first; /*index of the first byte in the input that can be used as dictionary*/
+	size_t start, end, blocksize;
+	unsigned final; /*whether the last block ends the deflate stream*/
+	DeflateBlock* blocks;
+} DeflateBlocks;
+
+/*
+Compresses one block with a hash of its own, which is filled with the window before the block first. A block
+that is not the last one of the stream is followed by an empty stored block, like a zlib sync flush, so that it
+ends on a byte boundary and the blocks can be concatenated.
+*/
+static void deflateBlockTask(void* context, size_t i)
+{
+	const DeflateBlocks* task = (const DeflateBlocks*)context;
+	const LodePNGCompressSettings* settings = task->settings;
+	DeflateBlock* block = &task->blocks[i];
+	size_t start = task->start + i * task->blocksize;
+	size_t end = task->end - start > task->blocksize ? start + task->blocksize : task->end;
+	size_t dictionary = start - task->first > settings->windowsize ? start - settings->windowsize : task->first;
+	unsigned final = task->final && end == task->end;
+	size_t bp = 0;
+	Hash hash;
+
+	block->adler = adler32(&task->in[start], (unsigned)(end - start));
+	block->error = hash_init(&hash, settings->windowsize);
+	if (!block->error)
+	{
+		if (settings->use_lz77) hash_prime(&hash, task->in, dictionary, start, end, settings);
+		if (settings->btype == 1) block->error = deflateFixed(&block->out, &bp, &hash, task->in, start, end, settings, final);
+		else block->error = deflateDynamic(&block->out, &bp, &hash, task->in, start, end, settings, final);
+	}
+	hash_cleanup(&hash);
+
+	if (!block->error && !final)
+	{
+		addBitsToStream(&bp, &block->out, 0, 3); /*BFINAL 0, BTYPE 00, then the rest of the byte is skipped*/
+		if (!ucvector_push_back(&block->out, 0) || !ucvector_push_back(&block->out, 0)
+			|| !ucvector_push_back(&block->out, 255) || !ucvector_push_back(&block->out, 255))
+		{
+			block->error = 83; /*alloc fail*/
+		}
+	}
+}
+
+/*
+Compresses in[start .. end - 1] in blocks of blocksize with settings->parallel_for and appends them to out, which
+must end on a byte boundary. in[first .. start - 1] is the data before it. If adler isn't null the adler32 of the
+compressed bytes is added to it.
+*/
+static unsigned deflateParallel(ucvector* out, const unsigned char* in, size_t first, size_t start, size_t end,
+	size_t blocksize, unsigned final, unsigned* adler, const LodePNGCompressSettings* settings)
+{
+	DeflateBlocks task;
+	size_t i, count = (end - start + blocksize - 1) / blocksize;
+	unsigned error = 0;
+
+	if (count == 0) count = 1;
+	task.settings = settings;
+	task.in = in;
+	task.first = first;
+	task.start = start;
+	task.end = end;
+	task.blocksize = blocksize;
+	task.final = final;
+	task.blocks = (DeflateBlock*)lodepng_malloc(sizeof(DeflateBlock) * count);
+	if (!task.blocks) return 83; /*alloc fail*/
+	for (i = 0; i != count; ++i) ucvector_init(&task.blocks[i].out);
+
+	settings->parallel_for(deflateBlockTask, &task, count, settings);
+
+	for (i = 0; i != count; ++i)
+	{
+		DeflateBlock* block = &task.blocks[i];
+		size_t size = end - start - i * blocksize > blocksize ? blocksize : end - start - i * blocksize;
+		if (!error) error = block->error;
+		if (!error)
+		{
+			size_t oldsize = out->size;
+			if (!ucvector_resize(out, oldsize + block->out.size)) error = 83; /*alloc fail*/
+			else if (block->out.size) memcpy(out->data + oldsize, block->out.data, block->out.size);
+			if (adler) *adler = adler32_combine(*adler, block->adler, size);
+		}
+		ucvector_cleanup(&block->out);
+	}
+	lodepng_free(task.blocks);
+	return error;
+}
+
+/*deflate blocks of 65-262k seem to give the most dense encoding on PNGs*/
+static size_t deflateBlockSize(size_t insize)
+{
+	size_t blocksize = insize / 8 + 8;
+	if (blocksize < 65536) blocksize = 65536;
+	if (blocksize > 262144) blocksize = 262144;
+	return blocksize;
+}
+
+/*if adler isn't null, it is set to the adler32 of the input*/
+static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t insize,
+	const LodePNGCompressSettings* settings, unsigned* adler)
 {
 	unsigned error = 0;
 	size_t i, blocksize, numdeflateblocks;
@@ -2025,16 +2687,18 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
 	Hash hash;
 
 	if (settings->btype > 2) return 61;
-	else if (settings->btype == 0) return deflateNoCompression(out, in, insize);
-	else if (settings->btype == 1) blocksize = insize;
-	else /*if(settings->btype == 2)*/
+	else if (settings->btype != 0 && settings->parallel_for && insize > deflateBlockSize(insize))
 	{
-		/*on PNGs, deflate blocks of 65-262k seem to give most dense encoding*/
-		blocksize = insize / 8 + 8;
-		if (blocksize < 65536) blocksize = 65536;
-		if (blocksize > 262144) blocksize = 262144;
+		/*with blocks that are compressed on their own, fixed blocks are split the same way*/
+		if (adler) *adler = 1;
+		return deflateParallel(out, in, 0, 0, insize, deflateBlockSize(insize), 1, adler, settings);
 	}
 
+	if (adler) *adler = adler32(in, (unsigned)insize);
+	if (settings->btype == 0) return deflateNoCompression(out, in, insize, 1);
+	else if (settings->btype == 1) blocksize = insize;
+	else /*if(settings->btype == 2)*/ blocksize = deflateBlockSize(insize);
+
 	numdeflateblocks = (insize + blocksize - 1) / blocksize;
 	if (numdeflateblocks == 0) numdeflateblocks = 1;
 
@@ -2064,36 +2728,81 @@ unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
 	unsigned error;
 	ucvector v;
 	ucvector_init_buffer(&v, *out, *outsize);
-	error = lodepng_deflatev(&v, in, insize, settings);
+	error = lodepng_deflatev(&v, in, insize, settings, 0);
 	*out = v.data;
 	*outsize = v.size;
 	return error;
 }
 
-static unsigned deflate(unsigned char** out, size_t* outsize,
-	const unsigned char* in, size_t insize,
-	const LodePNGCompressSettings* settings)
-{
-	if (settings->custom_deflate)
-	{
-		return settings->custom_deflate(out, outsize, in, insize, settings);
-	}
-	else
-	{
-		return lodepng_deflate(out, outsize, in, insize, settings);
-	}
-}
-
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 /* ////////////////////////////////////////////////////////////////////////// */
 /* / Adler32                                                                  */
 /* ////////////////////////////////////////////////////////////////////////// */
 
-static unsigned update_adler32(unsigned adler, const unsigned char* data, unsigned len)
+#ifdef LODEPNG_X86_SIMD
+/*
+Adds 32 bytes per step: s1 gets the sum of the bytes, s2 gets 32 times the previous s1 plus the bytes weighted
+32 down to 1, the multiply-adds of SSSE3 compute the weighted sums. Returns the sums of the whole 32 byte blocks,
+the remaining bytes are left to the scalar code.
+*/
+__attribute__((target("ssse3")))
+static unsigned update_adler32_ssse3(unsigned adler, const unsigned char** data, unsigned* len)
 {
+	const __m128i weights1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+	const __m128i weights2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi16(1);
 	unsigned s1 = adler & 0xffff;
 	unsigned s2 = (adler >> 16) & 0xffff;
+	unsigned blocks = *len / 32;
+	const unsigned char* p = *data;
+
+	*len -= blocks * 32;
+	while (blocks > 0)
+	{
+		/*5536 bytes, like the scalar loop the sums don't overflow before the modulo*/
+		unsigned amount = blocks > 173 ? 173 : blocks;
+		__m128i previous = _mm_setr_epi32(0, 0, 0, (int)(s1 * amount)); /*sum of s1 before every block*/
+		__m128i sum1 = zero;
+		__m128i sum2 = _mm_setr_epi32(0, 0, 0, (int)s2);
+		blocks -= amount;
+		while (amount > 0)
+		{
+			const __m128i bytes1 = _mm_loadu_si128((const __m128i*)p);
+			const __m128i bytes2 = _mm_loadu_si128((const __m128i*)(p + 16));
+			previous = _mm_add_epi32(previous, sum1);
+			sum1 = _mm_add_epi32(sum1, _mm_add_epi32(_mm_sad_epu8(bytes1, zero), _mm_sad_epu8(bytes2, zero)));
+			sum2 = _mm_add_epi32(sum2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, weights1), ones));
+			sum2 = _mm_add_epi32(sum2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, weights2), ones));
+			p += 32;
+			--amount;
+		}
+		sum2 = _mm_add_epi32(sum2, _mm_slli_epi32(previous, 5));
+
+		/*add the four lanes*/
+		sum1 = _mm_add_epi32(sum1, _mm_shuffle_epi32(sum1, _MM_SHUFFLE(2, 3, 0, 1)));
+		sum1 = _mm_add_epi32(sum1, _mm_shuffle_epi32(sum1, _MM_SHUFFLE(1, 0, 3, 2)));
+		sum2 = _mm_add_epi32(sum2, _mm_shuffle_epi32(sum2, _MM_SHUFFLE(2, 3, 0, 1)));
+		sum2 = _mm_add_epi32(sum2, _mm_shuffle_epi32(sum2, _MM_SHUFFLE(1, 0, 3, 2)));
+		s1 = (s1 + (unsigned)_mm_cvtsi128_si32(sum1)) % 65521;
+		s2 = (unsigned)_mm_cvtsi128_si32(sum2) % 65521;
+	}
+
+	*data = p;
+	return (s2 << 16) | s1;
+}
+#endif /*LODEPNG_X86_SIMD*/
+
+static unsigned update_adler32(unsigned adler, const unsigned char* data, unsigned len)
+{
+	unsigned s1, s2;
+
+#ifdef LODEPNG_X86_SIMD
+	if (len >= 64 && __builtin_cpu_supports("ssse3")) adler = update_adler32_ssse3(adler, &data, &len);
+#endif /*LODEPNG_X86_SIMD*/
+	s1 = adler & 0xffff;
+	s2 = (adler >> 16) & 0xffff;
 
 	while (len > 0)
 	{
@@ -2119,16 +2828,35 @@ static unsigned adler32(const unsigned char* data, unsigned len)
 	return update_adler32(1L, data, len);
 }
 
+#ifdef LODEPNG_COMPILE_ENCODER
+/*
+Return the adler32 of two pieces of data from the adler32 of each and the length of the second. Appending len2
+bytes adds len2 times s1 of the first piece to s2, and both sums of the second piece without their start value.
+*/
+static unsigned adler32_combine(unsigned adler1, unsigned adler2, size_t len2)
+{
+	unsigned rem = (unsigned)(len2 % 65521);
+	unsigned s1 = adler1 & 0xffff;
+	unsigned s2 = (unsigned)(((unsigned long)rem * s1) % 65521);
+	s1 += (adler2 & 0xffff) + 65521 - 1;
+	s2 += ((adler1 >> 16) & 0xffff) + ((adler2 >> 16) & 0xffff) + 65521 - rem;
+	if (s1 >= 65521) s1 -= 65521;
+	if (s1 >= 65521) s1 -= 65521;
+	if (s2 >= 65521 * 2) s2 -= 65521 * 2;
+	if (s2 >= 65521) s2 -= 65521;
+	return (s2 << 16) | s1;
+}
+#endif /*LODEPNG_COMPILE_ENCODER*/
+
 /* ////////////////////////////////////////////////////////////////////////// */
 /* / Zlib                                                                   / */
 /* ////////////////////////////////////////////////////////////////////////// */
 
 #ifdef LODEPNG_COMPILE_DECODER
 
-unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in,
-	size_t insize, const LodePNGDecompressSettings* settings)
+/*checks the 2 byte zlib header in front of the deflate data, return value is error*/
+static unsigned zlib_check_header(const unsigned char* in, size_t insize)
 {
-	unsigned error = 0;
 	unsigned CM, CINFO, FDICT;
 
 	if (insize < 2) return 53; /*error, size of zlib data too small*/
@@ -2156,6 +2884,14 @@ unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const uns
 		"The additional flags shall not specify a preset dictionary."*/
 		return 26;
 	}
+	return 0;
+}
+
+unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in,
+	size_t insize, const LodePNGDecompressSettings* settings)
+{
+	unsigned error = zlib_check_header(in, insize);
+	if (error) return error;
 
 	error = inflate(out, outsize, in + 2, insize - 2, settings);
 	if (error) return error;
@@ -2183,6 +2919,70 @@ static unsigned zlib_decompress(unsigned char** out, size_t* outsize, const unsi
 	}
 }
 
+#ifdef LODEPNG_COMPILE_PNG
+/*
+Decompresses zlib data that is split in segments with the built in inflate, the segments are read in place.
+custom_zlib and custom_inflate are not used since they need the data in one buffer. insize is the total size
+of the segments. Without a stream all output goes to out, with a stream it is handed to the stream callback
+in pieces and out only holds the window.
+*/
+static unsigned zlib_decompress_segments(ucvector* out, const unsigned char* in, size_t size, NextSegment next_segment,
+	const void* context, size_t insize, const LodePNGDecompressSettings* settings, InflateStream* stream)
+{
+	BitReader reader, tail;
+	unsigned char header[2] = { 0, 0 };
+	unsigned error;
+
+	BitReader_init(&reader, in, size, next_segment, context);
+	tail = reader;
+	if (insize >= 2)
+	{
+		header[0] = (unsigned char)BitReader_read(&reader, 8);
+		header[1] = (unsigned char)BitReader_read(&reader, 8);
+	}
+	error = zlib_check_header(header, insize);
+	if (error) return error;
+
+	error = lodepng_inflatev(out, &reader, insize, settings, stream);
+	if (error == INFLATE_STREAM_STOP) return 0;
+	if (error) return error;
+
+	if (!settings->ignore_adler32)
+	{
+		/*the checksum is in the last 4 bytes, which can be in another segment than where the deflate data ended*/
+		unsigned char checksum[4];
+		unsigned ADLER32;
+		BitReader_copy(&tail, 0, insize - 4);
+		BitReader_copy(&tail, checksum, 4);
+		ADLER32 = lodepng_read32bitInt(checksum);
+		if (stream ? stream->adler != ADLER32 : adler32(out->data, (unsigned)out->size) != ADLER32)
+		{
+			return 58; /*error, adler checksum not correct, data must be corrupted*/
+		}
+	}
+	return 0;
+}
+
+/*like zlib_decompress_segments, handing the output to the callback in pieces instead of returning it in one buffer*/
+static unsigned zlib_decompress_stream(const unsigned char* in, size_t size, NextSegment next_segment,
+	const void* context, size_t insize, const LodePNGDecompressSettings* settings,
+	unsigned (*callback)(void* user, const unsigned char* data, size_t size), void* user)
+{
+	ucvector window;
+	InflateStream stream;
+	unsigned error;
+
+	stream.callback = callback;
+	stream.user = user;
+	stream.delivered = 0;
+	stream.adler = 1;
+	ucvector_init(&window);
+	error = zlib_decompress_segments(&window, in, size, next_segment, context, insize, settings, &stream);
+	ucvector_cleanup(&window);
+	return error;
+}
+#endif /*LODEPNG_COMPILE_PNG*/
+
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 #ifdef LODEPNG_COMPILE_ENCODER
@@ -2197,6 +2997,7 @@ unsigned lodepng_zlib_compress(unsigned char** out, size_t* outsize, const unsig
 	unsigned error;
 	unsigned char* deflatedata = 0;
 	size_t deflatesize = 0;
+	unsigned ADLER32 = 1;
 
 	/*zlib data: 1 byte CMF (CM+CINFO), 1 byte FLG, deflate data, 4 byte ADLER32 checksum of the Decompressed data*/
 	unsigned CMF = 120; /*0b01111000: CM 8, CINFO 7. With CINFO 7, any window size up to 32768 can be used.*/
@@ -2212,15 +3013,23 @@ unsigned lodepng_zlib_compress(unsigned char** out, size_t* outsize, const unsig
 	ucvector_push_back(&outv, (unsigned char)(CMFFLG >> 8));
 	ucvector_push_back(&outv, (unsigned char)(CMFFLG & 255));
 
-	error = deflate(&deflatedata, &deflatesize, in, insize, settings);
-
-	if (!error)
+	if (settings->custom_deflate)
 	{
-		unsigned ADLER32 = adler32(in, (unsigned)insize);
-		for (i = 0; i != deflatesize; ++i) ucvector_push_back(&outv, deflatedata[i]);
-		lodepng_free(deflatedata);
-		lodepng_add32bitInt(&outv, ADLER32);
+		error = settings->custom_deflate(&deflatedata, &deflatesize, in, insize, settings);
+		if (!error)
+		{
+			ADLER32 = adler32(in, (unsigned)insize);
+			for (i = 0; i != deflatesize; ++i) ucvector_push_back(&outv, deflatedata[i]);
+			lodepng_free(deflatedata);
+		}
 	}
+	else
+	{
+		/*the built in deflate computes the checksum itself, with parallel_for each block does its part*/
+		error = lodepng_deflatev(&outv, in, insize, settings, &ADLER32);
+	}
+
+	if (!error) lodepng_add32bitInt(&outv, ADLER32);
 
 	*out = outv.data;
 	*outsize = outv.size;
@@ -2242,6 +3051,142 @@ static unsigned zlib_compress(unsigned char** out, size_t* outsize, const unsign
 	}
 }
 
+#ifdef LODEPNG_COMPILE_PNG
+/*
+Zlib compression of data that arrives in pieces, the total size must be known in advance. Every deflate
+block is compressed as soon as all of its input has arrived, so only the block and the window before it are
+buffered. Dynamic blocks have the same sizes as in lodepng_deflatev, which gives the same output as
+lodepng_zlib_compress. Fixed blocks use those sizes too instead of a single block. custom_zlib and
+custom_deflate are not used since they need all input at once. With parallel_for, the input is buffered until
+ZLIB_STREAM_PARALLEL_BLOCKS blocks are complete, these are compressed together like in lodepng_deflatev.
+*/
+#define ZLIB_STREAM_PARALLEL_BLOCKS 16
+
+typedef struct ZlibStream
+{
+	const LodePNGCompressSettings* settings;
+	Hash hash;
+	ucvector in; /*the window before the next block, followed by the input that is not compressed yet*/
+	size_t inpos; /*position in the in vector of the first byte that is not compressed yet*/
+	size_t remaining; /*number of input bytes that are not compressed yet, including those still to come*/
+	size_t blocksize;
+	unsigned parallel; /*whether the blocks are compressed with parallel_for, then the hash is not used*/
+	unsigned adler;
+	ucvector out; /*compressed data that was not taken yet, the last byte may be partially filled*/
+	size_t bp; /*bit pointer, only its lowest 3 bits are used*/
+} ZlibStream;
+
+static unsigned zlib_stream_init(ZlibStream* stream, size_t insize, const LodePNGCompressSettings* settings)
+{
+	/*same header as lodepng_zlib_compress*/
+	unsigned CMFFLG = 256 * 120;
+	CMFFLG += 31 - CMFFLG % 31;
+
+	stream->settings = settings;
+	stream->inpos = 0;
+	stream->remaining = insize;
+	stream->adler = 1;
+	stream->bp = 0;
+	ucvector_init(&stream->in);
+	ucvector_init(&stream->out);
+
+	if (settings->btype > 2) return 61;
+	else if (settings->btype == 0) stream->blocksize = 65535; /*the largest stored block*/
+	else stream->blocksize = deflateBlockSize(insize);
+	/*like lodepng_deflatev, a single block is compressed as usual*/
+	stream->parallel = settings->btype != 0 && settings->parallel_for && insize > stream->blocksize;
+
+	if (settings->btype != 0 && !stream->parallel)
+	{
+		unsigned error = hash_init(&stream->hash, settings->windowsize);
+		if (error) return error;
+	}
+	if (!ucvector_push_back(&stream->out, (unsigned char)(CMFFLG >> 8))) return 83; /*alloc fail*/
+	if (!ucvector_push_back(&stream->out, (unsigned char)(CMFFLG & 255))) return 83; /*alloc fail*/
+	return 0;
+}
+
+static void zlib_stream_cleanup(ZlibStream* stream)
+{
+	if ((stream->settings->btype == 1 || stream->settings->btype == 2) && !stream->parallel) hash_cleanup(&stream->hash);
+	ucvector_cleanup(&stream->in);
+	ucvector_cleanup(&stream->out);
+}
+
+/*appends input and compresses every block that is complete, after the last block the adler checksum follows*/
+static unsigned zlib_stream_add(ZlibStream* stream, const unsigned char* in, size_t insize)
+{
+	const LodePNGCompressSettings* settings = stream->settings;
+	size_t oldsize = stream->in.size;
+	unsigned error = 0;
+
+	if (!ucvector_resize(&stream->in, oldsize + insize)) return 83; /*alloc fail*/
+	memcpy(stream->in.data + oldsize, in, insize);
+
+	while (!error)
+	{
+		size_t start = stream->inpos;
+		size_t size = stream->remaining < stream->blocksize ? stream->remaining : stream->blocksize;
+		size_t end = start + size, shift;
+		unsigned final = (size == stream->remaining);
+		if (stream->parallel && !final)
+		{
+			/*a batch of whole blocks, or everything that is left*/
+			size = stream->remaining < stream->blocksize * ZLIB_STREAM_PARALLEL_BLOCKS ? stream->remaining : stream->blocksize * ZLIB_STREAM_PARALLEL_BLOCKS;
+			end = start + size;
+			final = (size == stream->remaining);
+		}
+		if (size == 0 || end > stream->in.size) break;
+
+		if (stream->parallel)
+		{
+			error = deflateParallel(&stream->out, stream->in.data, 0, start, end, stream->blocksize, final, &stream->adler, settings);
+		}
+		else
+		{
+			if (settings->btype == 0) error = deflateNoCompression(&stream->out, &stream->in.data[start], size, final);
+			else if (settings->btype == 1) error = deflateFixed(&stream->out, &stream->bp, &stream->hash, stream->in.data, start, end, settings, final);
+			else error = deflateDynamic(&stream->out, &stream->bp, &stream->hash, stream->in.data, start, end, settings, final);
+			if (!error) stream->adler = update_adler32(stream->adler, &stream->in.data[start], (unsigned)size);
+		}
+		if (error) break;
+
+		stream->inpos = end;
+		stream->remaining -= size;
+		if (final)
+		{
+			lodepng_add32bitInt(&stream->out, stream->adler);
+			stream->bp = 0; /*the last byte is complete now*/
+		}
+
+		/*keep one window, dropping a multiple of the window size so the circular positions in the hash stay valid*/
+		if (settings->btype == 0) shift = end;
+		else shift = end > settings->windowsize ? (end - settings->windowsize) & ~(size_t)(settings->windowsize - 1) : 0;
+		if (shift)
+		{
+			memmove(stream->in.data, stream->in.data + shift, stream->in.size - shift);
+			stream->in.size -= shift;
+			stream->inpos -= shift;
+		}
+	}
+	return error;
+}
+
+/*number of bytes at the start of the compressed output that are complete*/
+static size_t zlib_stream_available(const ZlibStream* stream)
+{
+	return (stream->bp & 7) ? stream->out.size - 1 : stream->out.size;
+}
+
+/*removes the complete bytes from the compressed output once they are written*/
+static void zlib_stream_consume(ZlibStream* stream)
+{
+	size_t available = zlib_stream_available(stream);
+	if (available != stream->out.size) stream->out.data[0] = stream->out.data[available];
+	stream->out.size -= available;
+}
+#endif /*LODEPNG_COMPILE_PNG*/
+
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
 #else /*no LODEPNG_COMPILE_ZLIB*/
@@ -2281,13 +3226,15 @@ void lodepng_compress_settings_init(LodePNGCompressSettings* settings)
 	settings->minmatch = 3;
 	settings->nicematch = 128;
 	settings->lazymatching = 1;
+	settings->matchfinder = LMF_HASH_CHAIN;
 
 	settings->custom_zlib = 0;
 	settings->custom_deflate = 0;
+	settings->parallel_for = 0;
 	settings->custom_context = 0;
 }
 
-const LodePNGCompressSettings lodepng_default_compress_settings = { 2, 1, DEFAULT_WINDOWSIZE, 3, 128, 1, 0, 0, 0 };
+const LodePNGCompressSettings lodepng_default_compress_settings = { 2, 1, DEFAULT_WINDOWSIZE, 3, 128, 1, LMF_HASH_CHAIN, 0, 0, 0, 0 };
 
 
 #endif /*LODEPNG_COMPILE_ENCODER*/
@@ -2297,13 +3244,14 @@ const LodePNGCompressSettings lodepng_default_compress_settings = { 2, 1, DEFAUL
 void lodepng_decompress_settings_init(LodePNGDecompressSettings* settings)
 {
 	settings->ignore_adler32 = 0;
+	settings->bitwise_huffman = 0;
 
 	settings->custom_zlib = 0;
 	settings->custom_inflate = 0;
 	settings->custom_context = 0;
 }
 
-const LodePNGDecompressSettings lodepng_default_decompress_settings = { 0, 0, 0, 0 };
+const LodePNGDecompressSettings lodepng_default_decompress_settings = { 0, 0, 0, 0, 0 };
 
 #endif /*LODEPNG_COMPILE_DECODER*/
 
@@ -2321,50 +3269,381 @@ const LodePNGDecompressSettings lodepng_default_decompress_settings = { 0, 0, 0,
 
 
 #ifndef LODEPNG_NO_COMPILE_CRC
-/* CRC polynomial: 0xedb88320 */
-static unsigned lodepng_crc32_table[256] = {
-	0u, 1996959894u, 3993919788u, 2567524794u, 124634137u, 1886057615u, 3915621685u, 2657392035u,
-	249268274u, 2044508324u, 3772115230u, 2547177864u, 162941995u, 2125561021u, 3887607047u, 2428444049u,
-	498536548u, 1789927666u, 4089016648u, 2227061214u, 450548861u, 1843258603u, 4107580753u, 2211677639u,
-	325883990u, 1684777152u, 4251122042u, 2321926636u, 335633487u, 1661365465u, 4195302755u, 2366115317u,
-	997073096u, 1281953886u, 3579855332u, 2724688242u, 1006888145u, 1258607687u, 3524101629u, 2768942443u,
-	901097722u, 1119000684u, 3686517206u, 2898065728u, 853044451u, 1172266101u, 3705015759u, 2882616665u,
-	651767980u, 1373503546u, 3369554304u, 3218104598u, 565507253u, 1454621731u, 3485111705u, 3099436303u,
-	671266974u, 1594198024u, 3322730930u, 2970347812u, 795835527u, 1483230225u, 3244367275u, 3060149565u,
-	1994146192u, 31158534u, 2563907772u, 4023717930u, 1907459465u, 112637215u, 2680153253u, 3904427059u,
-	2013776290u, 251722036u, 2517215374u, 3775830040u, 2137656763u, 141376813u, 2439277719u, 3865271297u,
-	1802195444u, 476864866u, 2238001368u, 4066508878u, 1812370925u, 453092731u, 2181625025u, 4111451223u,
-	1706088902u, 314042704u, 2344532202u, 4240017532u, 1658658271u, 366619977u, 2362670323u, 4224994405u,
-	1303535960u, 984961486u, 2747007092u, 3569037538u, 1256170817u, 1037604311u, 2765210733u, 3554079995u,
-	1131014506u, 879679996u, 2909243462u, 3663771856u, 1141124467u, 855842277u, 2852801631u, 3708648649u,
-	1342533948u, 654459306u, 3188396048u, 3373015174u, 1466479909u, 544179635u, 3110523913u, 3462522015u,
-	1591671054u, 702138776u, 2966460450u, 3352799412u, 1504918807u, 783551873u, 3082640443u, 3233442989u,
-	3988292384u, 2596254646u, 62317068u, 1957810842u, 3939845945u, 2647816111u, 81470997u, 1943803523u,
-	3814918930u, 2489596804u, 225274430u, 2053790376u, 3826175755u, 2466906013u, 167816743u, 2097651377u,
-	4027552580u, 2265490386u, 503444072u, 1762050814u, 4150417245u, 2154129355u, 426522225u, 1852507879u,
-	4275313526u, 2312317920u, 282753626u, 1742555852u, 4189708143u, 2394877945u, 397917763u, 1622183637u,
-	3604390888u, 2714866558u, 953729732u, 1340076626u, 3518719985u, 2797360999u, 1068828381u, 1219638859u,
-	3624741850u, 2936675148u, 906185462u, 1090812512u, 3747672003u, 2825379669u, 829329135u, 1181335161u,
-	3412177804u, 3160834842u, 628085408u, 1382605366u, 3423369109u, 3138078467u, 570562233u, 1426400815u,
-	3317316542u, 2998733608u, 733239954u, 1555261956u, 3268935591u, 3050360625u, 752459403u, 1541320221u,
-	2607071920u, 3965973030u, 1969922972u, 40735498u, 2617837225u, 3943577151u, 1913087877u, 83908371u,
-	2512341634u, 3803740692u, 2075208622u, 213261112u, 2463272603u, 3855990285u, 2094854071u, 198958881u,
-	2262029012u, 4057260610u, 1759359992u, 534414190u, 2176718541u, 4139329115u, 1873836001u, 414664567u,
-	2282248934u, 4279200368u, 1711684554u, 285281116u, 2405801727u, 4167216745u, 1634467795u, 376229701u,
-	2685067896u, 3608007406u, 1308918612u, 956543938u, 2808555105u, 3495958263u, 1231636301u, 1047427035u,
-	2932959818u, 3654703836u, 1088359270u, 936918000u, 2847714899u, 3736837829u, 1202900863u, 817233897u,
-	3183342108u, 3401237130u, 1404277552u, 615818150u, 3134207493u, 3453421203u, 1423857449u, 601450431u,
-	3009837614u, 3294710456u, 1567103746u, 711928724u, 3020668471u, 3272380065u, 1510334235u, 755167117u
+/*
+CRC polynomial: 0xedb88320. lodepng_crc32_table[0] is the table for a single byte, lodepng_crc32_table[k] gives
+the CRC of a byte followed by k zero bytes, which lets the CRC of 8 bytes be computed with 8 independent lookups.
+*/
+static const unsigned lodepng_crc32_table[8][256] = {
+	{
+		0u, 1996959894u, 3993919788u, 2567524794u, 124634137u, 1886057615u, 3915621685u, 2657392035u,
+		249268274u, 2044508324u, 3772115230u, 2547177864u, 162941995u, 2125561021u, 3887607047u, 2428444049u,
+		498536548u, 1789927666u, 4089016648u, 2227061214u, 450548861u, 1843258603u, 4107580753u, 2211677639u,
+		325883990u, 1684777152u, 4251122042u, 2321926636u, 335633487u, 1661365465u, 4195302755u, 2366115317u,
+		997073096u, 1281953886u, 3579855332u, 2724688242u, 1006888145u, 1258607687u, 3524101629u, 2768942443u,
+		901097722u, 1119000684u, 3686517206u, 2898065728u, 853044451u, 1172266101u, 3705015759u, 2882616665u,
+		651767980u, 1373503546u, 3369554304u, 3218104598u, 565507253u, 1454621731u, 3485111705u, 3099436303u,
+		671266974u, 1594198024u, 3322730930u, 2970347812u, 795835527u, 1483230225u, 3244367275u, 3060149565u,
+		1994146192u, 31158534u, 2563907772u, 4023717930u, 1907459465u, 112637215u, 2680153253u, 3904427059u,
+		2013776290u, 251722036u, 2517215374u, 3775830040u, 2137656763u, 141376813u, 2439277719u, 3865271297u,
+		1802195444u, 476864866u, 2238001368u, 4066508878u, 1812370925u, 453092731u, 2181625025u, 4111451223u,
+		1706088902u, 314042704u, 2344532202u, 4240017532u, 1658658271u, 366619977u, 2362670323u, 4224994405u,
+		1303535960u, 984961486u, 2747007092u, 3569037538u, 1256170817u, 1037604311u, 2765210733u, 3554079995u,
+		1131014506u, 879679996u, 2909243462u, 3663771856u, 1141124467u, 855842277u, 2852801631u, 3708648649u,
+		1342533948u, 654459306u, 3188396048u, 3373015174u, 1466479909u, 544179635u, 3110523913u, 3462522015u,
+		1591671054u, 702138776u, 2966460450u, 3352799412u, 1504918807u, 783551873u, 3082640443u, 3233442989u,
+		3988292384u, 2596254646u, 62317068u, 1957810842u, 3939845945u, 2647816111u, 81470997u, 1943803523u,
+		3814918930u, 2489596804u, 225274430u, 2053790376u, 3826175755u, 2466906013u, 167816743u, 2097651377u,
+		4027552580u, 2265490386u, 503444072u, 1762050814u, 4150417245u, 2154129355u, 426522225u, 1852507879u,
+		4275313526u, 2312317920u, 282753626u, 1742555852u, 4189708143u, 2394877945u, 397917763u, 1622183637u,
+		3604390888u, 2714866558u, 953729732u, 1340076626u, 3518719985u, 2797360999u, 1068828381u, 1219638859u,
+		3624741850u, 2936675148u, 906185462u, 1090812512u, 3747672003u, 2825379669u, 829329135u, 1181335161u,
+		3412177804u, 3160834842u, 628085408u, 1382605366u, 3423369109u, 3138078467u, 570562233u, 1426400815u,
+		3317316542u, 2998733608u, 733239954u, 1555261956u, 3268935591u, 3050360625u, 752459403u, 1541320221u,
+		2607071920u, 3965973030u, 1969922972u, 40735498u, 2617837225u, 3943577151u, 1913087877u, 83908371u,
+		2512341634u, 3803740692u, 2075208622u, 213261112u, 2463272603u, 3855990285u, 2094854071u, 198958881u,
+		2262029012u, 4057260610u, 1759359992u, 534414190u, 2176718541u, 4139329115u, 1873836001u, 414664567u,
+		2282248934u, 4279200368u, 1711684554u, 285281116u, 2405801727u, 4167216745u, 1634467795u, 376229701u,
+		2685067896u, 3608007406u, 1308918612u, 956543938u, 2808555105u, 3495958263u, 1231636301u, 1047427035u,
+		2932959818u, 3654703836u, 1088359270u, 936918000u, 2847714899u, 3736837829u, 1202900863u, 817233897u,
+		3183342108u, 3401237130u, 1404277552u, 615818150u, 3134207493u, 3453421203u, 1423857449u, 601450431u,
+		3009837614u, 3294710456u, 1567103746u, 711928724u, 3020668471u, 3272380065u, 1510334235u, 755167117u
+	},
+	{
+		0u, 421212481u, 842424962u, 724390851u, 1684849924u, 2105013317u, 1448781702u, 1329698503u,
+		3369699848u, 3519200073u, 4210026634u, 3824474571u, 2897563404u, 3048111693u, 2659397006u, 2274893007u,
+		1254232657u, 1406739216u, 2029285587u, 1643069842u, 783210325u, 934667796u, 479770071u, 92505238u,
+		2182846553u, 2600511768u, 2955803355u, 2838940570u, 3866582365u, 4285295644u, 3561045983u, 3445231262u,
+		2508465314u, 2359236067u, 2813478432u, 3198777185u, 4058571174u, 3908292839u, 3286139684u, 3670389349u,
+		1566420650u, 1145479147u, 1869335592u, 1987116393u, 959540142u, 539646703u, 185010476u, 303839341u,
+		3745920755u, 3327985586u, 3983561841u, 4100678960u, 3140154359u, 2721170102u, 2300350837u, 2416418868u,
+		396344571u, 243568058u, 631889529u, 1018359608u, 1945336319u, 1793607870u, 1103436669u, 1490954812u,
+		4034481925u, 3915546180u, 3259968903u, 3679722694u, 2484439553u, 2366552896u, 2787371139u, 3208174018u,
+		950060301u, 565965900u, 177645455u, 328046286u, 1556873225u, 1171730760u, 1861902987u, 2011255754u,
+		3132841300u, 2745199637u, 2290958294u, 2442530455u, 3738671184u, 3352078609u, 3974232786u, 4126854035u,
+		1919080284u, 1803150877u, 1079293406u, 1498383519u, 370020952u, 253043481u, 607678682u, 1025720731u,
+		1711106983u, 2095471334u, 1472923941u, 1322268772u, 26324643u, 411738082u, 866634785u, 717028704u,
+		2904875439u, 3024081134u, 2668790573u, 2248782444u, 3376948395u, 3495106026u, 4219356713u, 3798300520u,
+		792689142u, 908347575u, 487136116u, 68299317u, 1263779058u, 1380486579u, 2036719216u, 1618931505u,
+		3890672638u, 4278043327u, 3587215740u, 3435896893u, 2206873338u, 2593195963u, 2981909624u, 2829542713u,
+		998479947u, 580430090u, 162921161u, 279890824u, 1609522511u, 1190423566u, 1842954189u, 1958874764u,
+		4082766403u, 3930137346u, 3245109441u, 3631694208u, 2536953671u, 2385372678u, 2768287173u, 3155920004u,
+		1900120602u, 1750776667u, 1131931800u, 1517083097u, 355290910u, 204897887u, 656092572u, 1040194781u,
+		3113746450u, 2692952403u, 2343461520u, 2461357009u, 3723805974u, 3304059991u, 4022511508u, 4141455061u,
+		2919742697u, 3072101800u, 2620513899u, 2234183466u, 3396041197u, 3547351212u, 4166851439u, 3779471918u,
+		1725839073u, 2143618976u, 1424512099u, 1307796770u, 45282277u, 464110244u, 813994343u, 698327078u,
+		3838160568u, 4259225593u, 3606301754u, 3488152955u, 2158586812u, 2578602749u, 2996767038u, 2877569151u,
+		740041904u, 889656817u, 506086962u, 120682355u, 1215357364u, 1366020341u, 2051441462u, 1667084919u,
+		3422213966u, 3538019855u, 4190942668u, 3772220557u, 2945847882u, 3062702859u, 2644537544u, 2226864521u,
+		52649286u, 439905287u, 823476164u, 672009861u, 1733269570u, 2119477507u, 1434057408u, 1281543041u,
+		2167981343u, 2552493150u, 3004082077u, 2853541596u, 3847487515u, 4233048410u, 3613549209u, 3464057816u,
+		1239502615u, 1358593622u, 2077699477u, 1657543892u, 764250643u, 882293586u, 532408465u, 111204816u,
+		1585378284u, 1197851309u, 1816695150u, 1968414767u, 974272232u, 587794345u, 136598634u, 289367339u,
+		2527558116u, 2411481253u, 2760973158u, 3179948583u, 4073438432u, 3956313505u, 3237863010u, 3655790371u,
+		347922877u, 229101820u, 646611775u, 1066513022u, 1892689081u, 1774917112u, 1122387515u, 1543337850u,
+		3697634229u, 3313392372u, 3998419255u, 4148705398u, 3087642289u, 2702352368u, 2319436851u, 2468674930u
+	},
+	{
+		0u, 29518391u, 59036782u, 38190681u, 118073564u, 114017003u, 76381362u, 89069189u,
+		236147128u, 265370511u, 228034006u, 206958561u, 152762724u, 148411219u, 178138378u, 190596925u,
+		472294256u, 501532999u, 530741022u, 509615401u, 456068012u, 451764635u, 413917122u, 426358261u,
+		305525448u, 334993663u, 296822438u, 275991697u, 356276756u, 352202787u, 381193850u, 393929805u,
+		944588512u, 965684439u, 1003065998u, 973863097u, 1061482044u, 1049003019u, 1019230802u, 1023561829u,
+		912136024u, 933002607u, 903529270u, 874031361u, 827834244u, 815125939u, 852716522u, 856752605u,
+		611050896u, 631869351u, 669987326u, 640506825u, 593644876u, 580921211u, 551983394u, 556069653u,
+		712553512u, 733666847u, 704405574u, 675154545u, 762387700u, 749958851u, 787859610u, 792175277u,
+		1889177024u, 1901651959u, 1931368878u, 1927033753u, 2006131996u, 1985040171u, 1947726194u, 1976933189u,
+		2122964088u, 2135668303u, 2098006038u, 2093965857u, 2038461604u, 2017599123u, 2047123658u, 2076625661u,
+		1824272048u, 1836991623u, 1866005214u, 1861914857u, 1807058540u, 1786244187u, 1748062722u, 1777547317u,
+		1655668488u, 1668093247u, 1630251878u, 1625932113u, 1705433044u, 1684323811u, 1713505210u, 1742760333u,
+		1222101792u, 1226154263u, 1263738702u, 1251046777u, 1339974652u, 1310460363u, 1281013650u, 1301863845u,
+		1187289752u, 1191637167u, 1161842422u, 1149379777u, 1103966788u, 1074747507u, 1112139306u, 1133218845u,
+		1425107024u, 1429406311u, 1467333694u, 1454888457u, 1408811148u, 1379576507u, 1350309090u, 1371438805u,
+		1524775400u, 1528845279u, 1499917702u, 1487177649u, 1575719220u, 1546255107u, 1584350554u, 1605185389u,
+		3778354048u, 3774312887u, 3803303918u, 3816007129u, 3862737756u, 3892238699u, 3854067506u, 3833203973u,
+		4012263992u, 4007927823u, 3970080342u, 3982554209u, 3895452388u, 3924658387u, 3953866378u, 3932773565u,
+		4245928176u, 4241609415u, 4271336606u, 4283762345u, 4196012076u, 4225268251u, 4187931714u, 4166823541u,
+		4076923208u, 4072833919u, 4035198246u, 4047918865u, 4094247316u, 4123732899u, 4153251322u, 4132437965u,
+		3648544096u, 3636082519u, 3673983246u, 3678331705u, 3732010428u, 3753090955u, 3723829714u, 3694611429u,
+		3614117080u, 3601426159u, 3572488374u, 3576541825u, 3496125444u, 3516976691u, 3555094634u, 3525581405u,
+		3311336976u, 3298595879u, 3336186494u, 3340255305u, 3260503756u, 3281337595u, 3251864226u, 3222399125u,
+		3410866088u, 3398419871u, 3368647622u, 3372945905u, 3427010420u, 3448139075u, 3485520666u, 3456284973u,
+		2444203584u, 2423127159u, 2452308526u, 2481530905u, 2527477404u, 2539934891u, 2502093554u, 2497740997u,
+		2679949304u, 2659102159u, 2620920726u, 2650438049u, 2562027300u, 2574714131u, 2603727690u, 2599670141u,
+		2374579504u, 2353749767u, 2383274334u, 2412743529u, 2323684844u, 2336421851u, 2298759554u, 2294686645u,
+		2207933576u, 2186809023u, 2149495014u, 2178734801u, 2224278612u, 2236720739u, 2266437690u, 2262135309u,
+		2850214048u, 2820717207u, 2858812622u, 2879680249u, 2934667388u, 2938704459u, 2909776914u, 2897069605u,
+		2817622296u, 2788420399u, 2759153014u, 2780249921u, 2700618180u, 2704950259u, 2742877610u, 2730399645u,
+		3049550800u, 3020298727u, 3057690558u, 3078802825u, 2999835404u, 3004150075u, 2974355298u, 2961925461u,
+		3151438440u, 3121956959u, 3092510214u, 3113327665u, 3168701108u, 3172786307u, 3210370778u, 3197646061u
+	},
+	{
+		0u, 3099354981u, 2852767883u, 313896942u, 2405603159u, 937357362u, 627793884u, 2648127673u,
+		3316918511u, 2097696650u, 1874714724u, 3607201537u, 1255587768u, 4067088605u, 3772741427u, 1482887254u,
+		1343838111u, 3903140090u, 4195393300u, 1118632049u, 3749429448u, 1741137837u, 1970407491u, 3452858150u,
+		2511175536u, 756094997u, 1067759611u, 2266550430u, 449832999u, 2725482306u, 2965774508u, 142231497u,
+		2687676222u, 412010587u, 171665333u, 2995192016u, 793786473u, 2548850444u, 2237264098u, 1038456711u,
+		1703315409u, 3711623348u, 3482275674u, 1999841343u, 3940814982u, 1381529571u, 1089329165u, 4166106984u,
+		4029413537u, 1217896388u, 1512189994u, 3802027855u, 2135519222u, 3354724499u, 3577784189u, 1845280792u,
+		899665998u, 2367928107u, 2677414085u, 657096608u, 3137160985u, 37822588u, 284462994u, 2823350519u,
+		2601801789u, 598228824u, 824021174u, 2309093331u, 343330666u, 2898962447u, 3195996129u, 113467524u,
+		1587572946u, 3860600759u, 4104763481u, 1276501820u, 3519211397u, 1769898208u, 2076913422u, 3279374443u,
+		3406630818u, 1941006535u, 1627703081u, 3652755532u, 1148164341u, 4241751952u, 3999682686u, 1457141531u,
+		247015245u, 3053797416u, 2763059142u, 470583459u, 2178658330u, 963106687u, 735213713u, 2473467892u,
+		992409347u, 2207944806u, 2435792776u, 697522413u, 3024379988u, 217581361u, 508405983u, 2800865210u,
+		4271038444u, 1177467017u, 1419450215u, 3962007554u, 1911572667u, 3377213406u, 3690561584u, 1665525589u,
+		1799331996u, 3548628985u, 3241568279u, 2039091058u, 3831314379u, 1558270126u, 1314193216u, 4142438437u,
+		2928380019u, 372764438u, 75645176u, 3158189981u, 568925988u, 2572515393u, 2346768303u, 861712586u,
+		3982079547u, 1441124702u, 1196457648u, 4293663189u, 1648042348u, 3666298377u, 3358779879u, 1888390786u,
+		686661332u, 2421291441u, 2196002399u, 978858298u, 2811169155u, 523464422u, 226935048u, 3040519789u,
+		3175145892u, 100435649u, 390670639u, 2952089162u, 841119475u, 2325614998u, 2553003640u, 546822429u,
+		2029308235u, 3225988654u, 3539796416u, 1782671013u, 4153826844u, 1328167289u, 1570739863u, 3844338162u,
+		1298864389u, 4124540512u, 3882013070u, 1608431339u, 3255406162u, 2058742071u, 1744848601u, 3501990332u,
+		2296328682u, 811816591u, 584513889u, 2590678532u, 129869501u, 3204563416u, 2914283062u, 352848211u,
+		494030490u, 2781751807u, 3078325777u, 264757620u, 2450577869u, 715964072u, 941166918u, 2158327331u,
+		3636881013u, 1618608400u, 1926213374u, 3396585883u, 1470427426u, 4011365959u, 4255988137u, 1158766284u,
+		1984818694u, 3471935843u, 3695453837u, 1693991400u, 4180638033u, 1100160564u, 1395044826u, 3952793279u,
+		3019491049u, 189112716u, 435162722u, 2706139399u, 1016811966u, 2217162459u, 2526189877u, 774831696u,
+		643086745u, 2666061564u, 2354934034u, 887166583u, 2838900430u, 294275499u, 54519365u, 3145957664u,
+		3823145334u, 1532818963u, 1240029693u, 4048895640u, 1820460577u, 3560857924u, 3331051178u, 2117577167u,
+		3598663992u, 1858283101u, 2088143283u, 3301633750u, 1495127663u, 3785470218u, 4078182116u, 1269332353u,
+		332098007u, 2876706482u, 3116540252u, 25085497u, 2628386432u, 605395429u, 916469259u, 2384220526u,
+		2254837415u, 1054503362u, 745528876u, 2496903497u, 151290352u, 2981684885u, 2735556987u, 464596510u,
+		1137851976u, 4218313005u, 3923506883u, 1365741990u, 3434129695u, 1946996346u, 1723425172u, 3724871409u
+	},
+	{
+		0u, 1029712304u, 2059424608u, 1201699536u, 4118849216u, 3370159984u, 2403399072u, 2988497936u,
+		812665793u, 219177585u, 1253054625u, 2010132753u, 3320900865u, 4170237105u, 3207642721u, 2186319825u,
+		1625331586u, 1568718386u, 438355170u, 658566482u, 2506109250u, 2818578674u, 4020265506u, 3535817618u,
+		1351670851u, 1844508147u, 709922595u, 389064339u, 2769320579u, 2557498163u, 3754961379u, 3803185235u,
+		3250663172u, 4238411444u, 3137436772u, 2254525908u, 876710340u, 153198708u, 1317132964u, 1944187668u,
+		4054934725u, 3436268917u, 2339452837u, 3054575125u, 70369797u, 961670069u, 2129760613u, 1133623509u,
+		2703341702u, 2621542710u, 3689016294u, 3867263574u, 1419845190u, 1774270454u, 778128678u, 318858390u,
+		2438067015u, 2888948471u, 3952189479u, 3606153623u, 1691440519u, 1504803895u, 504432359u, 594620247u,
+		1492342857u, 1704161785u, 573770537u, 525542041u, 2910060169u, 2417219385u, 3618876905u, 3939730521u,
+		1753420680u, 1440954936u, 306397416u, 790849880u, 2634265928u, 2690882808u, 3888375336u, 3668168600u,
+		940822475u, 91481723u, 1121164459u, 2142483739u, 3448989963u, 4042473659u, 3075684971u, 2318603227u,
+		140739594u, 889433530u, 1923340138u, 1338244826u, 4259521226u, 3229813626u, 2267247018u, 3124975642u,
+		2570221389u, 2756861693u, 3824297005u, 3734113693u, 1823658381u, 1372780605u, 376603373u, 722643805u,
+		2839690380u, 2485261628u, 3548540908u, 4007806556u, 1556257356u, 1638052860u, 637716780u, 459464860u,
+		4191346895u, 3300051327u, 2199040943u, 3195181599u, 206718479u, 825388991u, 1989285231u, 1274166495u,
+		3382881038u, 4106388158u, 3009607790u, 2382549470u, 1008864718u, 21111934u, 1189240494u, 2072147742u,
+		2984685714u, 2357631266u, 3408323570u, 4131834434u, 1147541074u, 2030452706u, 1051084082u, 63335554u,
+		2174155603u, 3170292451u, 4216760371u, 3325460867u, 1947622803u, 1232499747u, 248909555u, 867575619u,
+		3506841360u, 3966111392u, 2881909872u, 2527485376u, 612794832u, 434546784u, 1581699760u, 1663499008u,
+		3782634705u, 3692447073u, 2612412337u, 2799048193u, 351717905u, 697754529u, 1849071985u, 1398190273u,
+		1881644950u, 1296545318u, 182963446u, 931652934u, 2242328918u, 3100053734u, 4284967478u, 3255255942u,
+		1079497815u, 2100821479u, 983009079u, 133672583u, 3050795671u, 2293717799u, 3474399735u, 4067887175u,
+		281479188u, 765927844u, 1778867060u, 1466397380u, 3846680276u, 3626469220u, 2676489652u, 2733102084u,
+		548881365u, 500656741u, 1517752501u, 1729575173u, 3577210133u, 3898068133u, 2952246901u, 2459410373u,
+		3910527195u, 3564487019u, 2480257979u, 2931134987u, 479546907u, 569730987u, 1716854139u, 1530213579u,
+		3647316762u, 3825568426u, 2745561210u, 2663766474u, 753206746u, 293940330u, 1445287610u, 1799716618u,
+		2314567513u, 3029685993u, 4080348217u, 3461678473u, 2088098201u, 1091956777u, 112560889u, 1003856713u,
+		3112514712u, 2229607720u, 3276105720u, 4263857736u, 1275433560u, 1902492648u, 918929720u, 195422344u,
+		685033439u, 364179055u, 1377080511u, 1869921551u, 3713294623u, 3761522863u, 2811507327u, 2599689167u,
+		413436958u, 633644462u, 1650777982u, 1594160846u, 3978570462u, 3494118254u, 2548332990u, 2860797966u,
+		1211387997u, 1968470509u, 854852413u, 261368461u, 3182753437u, 2161434413u, 3346310653u, 4195650637u,
+		2017729436u, 1160000044u, 42223868u, 1071931724u, 2378480988u, 2963576044u, 4144295484u, 3395602316u
+	},
+	{
+		0u, 3411858341u, 1304994059u, 2257875630u, 2609988118u, 1355649459u, 3596215069u, 486879416u,
+		3964895853u, 655315400u, 2711298918u, 1791488195u, 2009251963u, 3164476382u, 973758832u, 4048990933u,
+		64357019u, 3364540734u, 1310630800u, 2235723829u, 2554806413u, 1394316072u, 3582976390u, 517157411u,
+		4018503926u, 618222419u, 2722963965u, 1762783832u, 1947517664u, 3209171269u, 970744811u, 4068520014u,
+		128714038u, 3438335635u, 1248109629u, 2167961496u, 2621261600u, 1466012805u, 3522553387u, 447296910u,
+		3959392091u, 547575038u, 2788632144u, 1835791861u, 1886307661u, 3140622056u, 1034314822u, 4143626211u,
+		75106221u, 3475428360u, 1236444838u, 2196665603u, 2682996155u, 1421317662u, 3525567664u, 427767573u,
+		3895035328u, 594892389u, 2782995659u, 1857943406u, 1941489622u, 3101955187u, 1047553757u, 4113347960u,
+		257428076u, 3288652233u, 1116777319u, 2311878850u, 2496219258u, 1603640287u, 3640781169u, 308099796u,
+		3809183745u, 676813732u, 2932025610u, 1704983215u, 2023410199u, 3016104370u, 894593820u, 4262377657u,
+		210634999u, 3352484690u, 1095150076u, 2316991065u, 2535410401u, 1547934020u, 3671583722u, 294336591u,
+		3772615322u, 729897279u, 2903845777u, 1716123700u, 2068629644u, 2953845545u, 914647431u, 4258839074u,
+		150212442u, 3282623743u, 1161604689u, 2388688372u, 2472889676u, 1480171241u, 3735940167u, 368132066u,
+		3836185911u, 805002898u, 2842635324u, 1647574937u, 2134298401u, 3026852996u, 855535146u, 4188192143u,
+		186781121u, 3229539940u, 1189784778u, 2377547631u, 2427670487u, 1542429810u, 3715886812u, 371670393u,
+		3882979244u, 741170185u, 2864262823u, 1642462466u, 2095107514u, 3082559007u, 824732849u, 4201955092u,
+		514856152u, 3589064573u, 1400419795u, 2552522358u, 2233554638u, 1316849003u, 3370776517u, 62202976u,
+		4075001525u, 968836368u, 3207280574u, 1954014235u, 1769133219u, 2720925446u, 616199592u, 4024870413u,
+		493229635u, 3594175974u, 1353627464u, 2616354029u, 2264355925u, 1303087088u, 3409966430u, 6498043u,
+		4046820398u, 979978123u, 3170710821u, 2007099008u, 1789187640u, 2717386141u, 661419827u, 3962610838u,
+		421269998u, 3527459403u, 1423225061u, 2676515648u, 2190300152u, 1238466653u, 3477467891u, 68755798u,
+		4115633027u, 1041448998u, 3095868040u, 1943789869u, 1860096405u, 2776760880u, 588673182u, 3897205563u,
+		449450869u, 3516317904u, 1459794558u, 2623431131u, 2170245475u, 1242006214u, 3432247400u, 131015629u,
+		4137259288u, 1036337853u, 3142660115u, 1879958454u, 1829294862u, 2790523051u, 549483013u, 3952910752u,
+		300424884u, 3669282065u, 1545650111u, 2541513754u, 2323209378u, 1092980487u, 3350330793u, 216870412u,
+		4256931033u, 921128828u, 2960342482u, 2066738807u, 1714085583u, 2910195050u, 736264132u, 3770592353u,
+		306060335u, 3647131530u, 1610005796u, 2494197377u, 2309971513u, 1123257756u, 3295149874u, 255536279u,
+		4268596802u, 892423655u, 3013951305u, 2029645036u, 1711070292u, 2929725425u, 674528607u, 3815288570u,
+		373562242u, 3709388839u, 1535949449u, 2429577516u, 2379569556u, 1183418929u, 3223189663u, 188820282u,
+		4195850735u, 827017802u, 3084859620u, 2089020225u, 1636228089u, 2866415708u, 743340786u, 3876759895u,
+		361896217u, 3738094268u, 1482340370u, 2466671543u, 2382584591u, 1163888810u, 3284924932u, 144124321u,
+		4190215028u, 849168593u, 3020503679u, 2136336858u, 1649465698u, 2836138695u, 798521449u, 3838094284u
+	},
+	{
+		0u, 2792819636u, 2543784233u, 837294749u, 4098827283u, 1379413927u, 1674589498u, 3316072078u,
+		871321191u, 2509784531u, 2758827854u, 34034938u, 3349178996u, 1641505216u, 1346337629u, 4131942633u,
+		1742642382u, 3249117050u, 4030828007u, 1446413907u, 2475800797u, 904311657u, 68069876u, 2725880384u,
+		1412551337u, 4064729373u, 3283010432u, 1708771380u, 2692675258u, 101317902u, 937551763u, 2442587175u,
+		3485284764u, 1774858792u, 1478633653u, 4266992385u, 1005723023u, 2642744891u, 2892827814u, 169477906u,
+		4233263099u, 1512406095u, 1808623314u, 3451546982u, 136139752u, 2926205020u, 2676114113u, 972376437u,
+		2825102674u, 236236518u, 1073525883u, 2576072655u, 1546420545u, 4200303349u, 3417542760u, 1841601500u,
+		2609703733u, 1039917185u, 202635804u, 2858742184u, 1875103526u, 3384067218u, 4166835727u, 1579931067u,
+		1141601657u, 3799809741u, 3549717584u, 1977839588u, 2957267306u, 372464350u, 668680259u, 2175552503u,
+		2011446046u, 3516084394u, 3766168119u, 1175200131u, 2209029901u, 635180217u, 338955812u, 2990736784u,
+		601221559u, 2242044419u, 3024812190u, 306049834u, 3617246628u, 1911408144u, 1074125965u, 3866285881u,
+		272279504u, 3058543716u, 2275784441u, 567459149u, 3832906691u, 1107462263u, 1944752874u, 3583875422u,
+		2343980261u, 767641425u, 472473036u, 3126744696u, 2147051766u, 3649987394u, 3899029983u, 1309766251u,
+		3092841090u, 506333494u, 801510315u, 2310084639u, 1276520081u, 3932237093u, 3683203000u, 2113813516u,
+		3966292011u, 1243601823u, 2079834370u, 3716205238u, 405271608u, 3192979340u, 2411259153u, 701492901u,
+		3750207052u, 2045810168u, 1209569125u, 4000285905u, 734575199u, 2378150379u, 3159862134u, 438345922u,
+		2283203314u, 778166598u, 529136603u, 3120492655u, 2086260449u, 3660498261u, 3955679176u, 1303499900u,
+		3153699989u, 495890209u, 744928700u, 2316418568u, 1337360518u, 3921775410u, 3626602927u, 2120129051u,
+		4022892092u, 1237286280u, 2018993941u, 3726666913u, 461853231u, 3186645403u, 2350400262u, 711936178u,
+		3693557851u, 2052076527u, 1270360434u, 3989775046u, 677911624u, 2384402428u, 3220639073u, 427820757u,
+		1202443118u, 3789347034u, 3493118535u, 1984154099u, 3018127229u, 362020041u, 612099668u, 2181885408u,
+		1950653705u, 3526596285u, 3822816288u, 1168934804u, 2148251930u, 645706414u, 395618355u, 2984485767u,
+		544559008u, 2248295444u, 3085590153u, 295523645u, 3560598451u, 1917673479u, 1134918298u, 3855773998u,
+		328860103u, 3052210803u, 2214924526u, 577903450u, 3889505748u, 1101147744u, 1883911421u, 3594338121u,
+		3424493451u, 1785369663u, 1535282850u, 4260726038u, 944946072u, 2653270060u, 2949491377u, 163225861u,
+		4294103532u, 1501944408u, 1752023237u, 3457862513u, 196998655u, 2915761739u, 2619532502u, 978710370u,
+		2881684293u, 229902577u, 1012666988u, 2586515928u, 1603020630u, 4193987810u, 3356702335u, 1852063179u,
+		2553040162u, 1046169238u, 263412747u, 2848217023u, 1818454321u, 3390333573u, 4227627032u, 1569420204u,
+		60859927u, 2782375331u, 2487203646u, 843627658u, 4159668740u, 1368951216u, 1617990445u, 3322386585u,
+		810543216u, 2520310724u, 2815490393u, 27783917u, 3288386659u, 1652017111u, 1402985802u, 4125677310u,
+		1685994201u, 3255382381u, 4091620336u, 1435902020u, 2419138250u, 910562686u, 128847843u, 2715354199u,
+		1469150398u, 4058414858u, 3222168983u, 1719234083u, 2749255853u, 94984985u, 876691844u, 2453031472u
+	},
+	{
+		0u, 3433693342u, 1109723005u, 2391738339u, 2219446010u, 1222643300u, 3329165703u, 180685081u,
+		3555007413u, 525277995u, 2445286600u, 1567235158u, 1471092047u, 2600801745u, 361370162u, 3642757804u,
+		2092642603u, 2953916853u, 1050555990u, 4063508168u, 4176560081u, 878395215u, 3134470316u, 1987983410u,
+		2942184094u, 1676945920u, 3984272867u, 567356797u, 722740324u, 3887998202u, 1764827929u, 2778407815u,
+		4185285206u, 903635656u, 3142804779u, 2012833205u, 2101111980u, 2979425330u, 1058630609u, 4088621903u,
+		714308067u, 3862526333u, 1756790430u, 2753330688u, 2933487385u, 1651734407u, 3975966820u, 542535930u,
+		2244825981u, 1231508451u, 3353891840u, 188896414u, 25648519u, 3442302233u, 1134713594u, 2399689316u,
+		1445480648u, 2592229462u, 336416693u, 3634843435u, 3529655858u, 516441772u, 2420588879u, 1559052753u,
+		698204909u, 3845636723u, 1807271312u, 2803025166u, 2916600855u, 1635634313u, 4025666410u, 593021940u,
+		4202223960u, 919787974u, 3093159461u, 1962401467u, 2117261218u, 2996361020u, 1008193759u, 4038971457u,
+		1428616134u, 2576151384u, 386135227u, 3685348389u, 3513580860u, 499580322u, 2471098945u, 1608776415u,
+		2260985971u, 1248454893u, 3303468814u, 139259792u, 42591881u, 3458459159u, 1085071860u, 2349261162u,
+		3505103035u, 474062885u, 2463016902u, 1583654744u, 1419882049u, 2550902495u, 377792828u, 3660491170u,
+		51297038u, 3483679632u, 1093385331u, 2374089965u, 2269427188u, 1273935210u, 3311514249u, 164344343u,
+		2890961296u, 1627033870u, 4000683757u, 585078387u, 672833386u, 3836780532u, 1782552599u, 2794821769u,
+		2142603813u, 3005188795u, 1032883544u, 4047146438u, 4227826911u, 928351297u, 3118105506u, 1970307900u,
+		1396409818u, 2677114180u, 287212199u, 3719594553u, 3614542624u, 467372990u, 2505346141u, 1509854403u,
+		2162073199u, 1282711281u, 3271268626u, 240228748u, 76845205u, 3359543307u, 1186043880u, 2317064054u,
+		796964081u, 3811226735u, 1839575948u, 2702160658u, 2882189835u, 1734392469u, 3924802934u, 625327592u,
+		4234522436u, 818917338u, 3191908409u, 1927981223u, 2016387518u, 3028656416u, 973776579u, 4137723485u,
+		2857232268u, 1726474002u, 3899187441u, 616751215u, 772270454u, 3803048424u, 1814228491u, 2693328533u,
+		2041117753u, 3036871847u, 999160644u, 4146592730u, 4259508931u, 826864221u, 3217552830u, 1936586016u,
+		3606501031u, 442291769u, 2496909786u, 1484378436u, 1388107869u, 2652297411u, 278519584u, 3694387134u,
+		85183762u, 3384397196u, 1194773103u, 2342308593u, 2170143720u, 1307820918u, 3279733909u, 265733131u,
+		2057717559u, 3054258089u, 948125770u, 4096344276u, 4276898253u, 843467091u, 3167309488u, 1885556270u,
+		2839764098u, 1709792284u, 3949353983u, 667704161u, 755585656u, 3785577190u, 1865176325u, 2743489947u,
+		102594076u, 3401021058u, 1144549729u, 2291298815u, 2186770662u, 1325234296u, 3228729243u, 215514885u,
+		3589828009u, 424832311u, 2547870420u, 1534552650u, 1370645331u, 2635621325u, 328688686u, 3745342640u,
+		2211456353u, 1333405183u, 3254067740u, 224338562u, 127544219u, 3408931589u, 1170156774u, 2299866232u,
+		1345666772u, 2627681866u, 303053225u, 3736746295u, 3565105198u, 416624816u, 2522494803u, 1525692365u,
+		4285207626u, 868291796u, 3176010551u, 1910772649u, 2065767088u, 3079346734u, 956571085u, 4121828691u,
+		747507711u, 3760459617u, 1856702594u, 2717976604u, 2831417605u, 1684930971u, 3940615800u, 642451174u
+	}
 };
 
+#ifdef LODEPNG_X86_SIMD
+/*
+Folds 64 bytes at a time into four 128-bit remainders with carry-less multiplication, then reduces them to the
+32-bit CRC, see "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction" by Intel. The constants
+are powers of x modulo the polynomial, bit reflected like the CRC. r is the CRC register before and after, length
+must be at least 64 and a multiple of 16.
+*/
+__attribute__((target("pclmul,sse4.1")))
+static unsigned crc32_pclmul(unsigned r, const unsigned char* data, size_t length)
+{
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596ll, 0x0154442bd4ll);
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009ell, 0x01751997d0ll);
+	const __m128i k5 = _mm_set_epi64x(0, 0x0163cd6124ll);
+	const __m128i poly = _mm_set_epi64x(0x01f7011641ll, 0x01db710641ll);
+	const __m128i low32 = _mm_setr_epi32(~0, 0, ~0, 0);
+	__m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+	x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)data), _mm_cvtsi32_si128((int)r));
+	x2 = _mm_loadu_si128((const __m128i*)(data + 16));
+	x3 = _mm_loadu_si128((const __m128i*)(data + 32));
+	x4 = _mm_loadu_si128((const __m128i*)(data + 48));
+	data += 64;
+	length -= 64;
+
+	/*fold the four remainders over the next 64 bytes*/
+	for (; length >= 64; data += 64, length -= 64)
+	{
+		x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)data));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(data + 16)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(data + 32)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(data + 48)));
+	}
+
+	/*fold the four remainders into one, then the remaining 16 byte blocks into that*/
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x4), x5);
+	for (; length >= 16; data += 16, length -= 16)
+	{
+		x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i*)data)), x5);
+	}
+
+	/*fold 128 bits to 64 bits*/
+	x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, low32);
+	x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, k5, 0x00), x2);
+
+	/*Barrett reduction to 32 bits*/
+	x2 = _mm_and_si128(x1, low32);
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+	x2 = _mm_and_si128(x2, low32);
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+	return (unsigned)_mm_extract_epi32(x1, 1);
+}
+#endif /*LODEPNG_X86_SIMD*/
+
 /*Return the CRC of the bytes buf[0..len-1].*/
 unsigned lodepng_crc32(const unsigned char* data, size_t length)
 {
 	unsigned r = 0xffffffffu;
-	size_t i;
-	for (i = 0; i < length; ++i)
+#ifdef LODEPNG_X86_SIMD
+	if (length >= 64 && __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+	{
+		r = crc32_pclmul(r, data, length & ~(size_t)15);
+		data += length & ~(size_t)15;
+		length &= 15;
+	}
+#endif /*LODEPNG_X86_SIMD*/
+	/*slicing by 8: the CRC register is combined with 8 bytes at once*/
+	for (; length >= 8; data += 8, length -= 8)
+	{
+		r ^= data[0] | ((unsigned)data[1] << 8) | ((unsigned)data[2] << 16) | ((unsigned)data[3] << 24);
+		r = lodepng_crc32_table[7][r & 0xff] ^ lodepng_crc32_table[6][(r >> 8) & 0xff]
+			^ lodepng_crc32_table[5][(r >> 16) & 0xff] ^ lodepng_crc32_table[4][r >> 24]
+			^ lodepng_crc32_table[3][data[4]] ^ lodepng_crc32_table[2][data[5]]
+			^ lodepng_crc32_table[1][data[6]] ^ lodepng_crc32_table[0][data[7]];
+	}
+	for (; length > 0; ++data, --length)
 	{
-		r = lodepng_crc32_table[(r ^ data[i]) & 0xff] ^ (r >> 8);
+		r = lodepng_crc32_table[0][(r ^ *data) & 0xff] ^ (r >> 8);
 	}
 	return r ^ 0xffffffffu;
 }
@@ -3563,16 +4842,17 @@ static unsigned getValueRequiredBits(unsigned char value)
 	return 8;
 }
 
-/*profile must already have been inited with mode.
+/*Gets the profile of h rows of w pixels that start stride bytes apart, the pixels of a row are read by their
+index from the start of the row. profile must already have been inited with mode.
 It's ok to set some parameters of profile to done already.*/
-unsigned lodepng_get_color_profile(LodePNGColorProfile* profile,
-	const unsigned char* in, unsigned w, unsigned h,
+static unsigned getColorProfile(LodePNGColorProfile* profile,
+	const unsigned char* in, size_t w, size_t h, size_t stride,
 	const LodePNGColorMode* mode)
 {
 	unsigned error = 0;
-	size_t i;
+	size_t x, y;
 	ColorTree tree;
-	size_t numpixels = w * h;
+	const unsigned char* row;
 
 	unsigned colored_done = lodepng_is_greyscale_type(mode) ? 1 : 0;
 	unsigned alpha_done = lodepng_can_have_alpha(mode) ? 0 : 1;
@@ -3581,6 +4861,7 @@ unsigned lodepng_get_color_profile(LodePNGColorProfile* profile,
 	unsigned bits_done = bpp == 1 ? 1 : 0;
 	unsigned maxnumcolors = 257;
 	unsigned sixteen = 0;
+	unsigned done = 0;
 	if (bpp <= 8) maxnumcolors = bpp == 1 ? 2 : (bpp == 2 ? 4 : (bpp == 4 ? 16 : 256));
 
 	color_tree_init(&tree);
@@ -3589,14 +4870,18 @@ unsigned lodepng_get_color_profile(LodePNGColorProfile* profile,
 	if (mode->bitdepth == 16)
 	{
 		unsigned short r, g, b, a;
-		for (i = 0; i != numpixels; ++i)
+		for (y = 0; y != h && !sixteen; ++y)
 		{
-			getPixelColorRGBA16(&r, &g, &b, &a, in, i, mode);
-			if ((r & 255) != ((r >> 8) & 255) || (g & 255) != ((g >> 8) & 255) ||
-				(b & 255) != ((b >> 8) & 255) || (a & 255) != ((a >> 8) & 255)) /*first and second byte differ*/
+			row = in + y * stride;
+			for (x = 0; x != w; ++x)
 			{
-				sixteen = 1;
-				break;
+				getPixelColorRGBA16(&r, &g, &b, &a, row, x, mode);
+				if ((r & 255) != ((r >> 8) & 255) || (g & 255) != ((g >> 8) & 255) ||
+					(b & 255) != ((b >> 8) & 255) || (a & 255) != ((a >> 8) & 255)) /*first and second byte differ*/
+				{
+					sixteen = 1;
+					break;
+				}
 			}
 		}
 	}
@@ -3607,52 +4892,64 @@ unsigned lodepng_get_color_profile(LodePNGColorProfile* profile,
 		profile->bits = 16;
 		bits_done = numcolors_done = 1; /*counting colors no longer useful, palette doesn't support 16-bit*/
 
-		for (i = 0; i != numpixels; ++i)
+		for (y = 0; y != h && !done; ++y)
 		{
-			getPixelColorRGBA16(&r, &g, &b, &a, in, i, mode);
-
-			if (!colored_done && (r != g || r != b))
+			row = in + y * stride;
+			for (x = 0; x != w; ++x)
 			{
-				profile->colored = 1;
-				colored_done = 1;
-			}
+				getPixelColorRGBA16(&r, &g, &b, &a, row, x, mode);
 
-			if (!alpha_done)
-			{
-				unsigned matchkey = (r == profile->key_r && g == profile->key_g && b == profile->key_b);
-				if (a != 65535 && (a != 0 || (profile->key && !matchkey)))
+				if (!colored_done && (r != g || r != b))
 				{
-					profile->alpha = 1;
-					alpha_done = 1;
-					if (profile->bits < 8) profile->bits = 8; /*PNG has no alphachannel modes with less than 8-bit per channel*/
+					profile->colored = 1;
+					colored_done = 1;
 				}
-				else if (a == 0 && !profile->alpha && !profile->key)
+
+				if (!alpha_done)
 				{
-					profile->key = 1;
-					profile->key_r = r;
-					profile->key_g = g;
-					profile->key_b = b;
+					unsigned matchkey = (r == profile->key_r && g == profile->key_g && b == profile->key_b);
+					if (a != 65535 && (a != 0 || (profile->key && !matchkey)))
+					{
+						profile->alpha = 1;
+						alpha_done = 1;
+						if (profile->bits < 8) profile->bits = 8; /*PNG has no alphachannel modes with less than 8-bit per channel*/
+					}
+					else if (a == 0 && !profile->alpha && !profile->key)
+					{
+						profile->key = 1;
+						profile->key_r = r;
+						profile->key_g = g;
+						profile->key_b = b;
+					}
+					else if (a == 65535 && profile->key && matchkey)
+					{
+						/* Color key cannot be used if an opaque pixel also has that RGB color. */
+						profile->alpha = 1;
+						alpha_done = 1;
+					}
 				}
-				else if (a == 65535 && profile->key && matchkey)
+				if (alpha_done && numcolors_done && colored_done && bits_done)
 				{
-					/* Color key cannot be used if an opaque pixel also has that RGB color. */
-					profile->alpha = 1;
-					alpha_done = 1;
+					done = 1;
+					break;
 				}
 			}
-			if (alpha_done && numcolors_done && colored_done && bits_done) break;
 		}
 
 		if (profile->key && !profile->alpha)
 		{
-			for (i = 0; i != numpixels; ++i)
+			for (y = 0; y != h; ++y)
 			{
-				getPixelColorRGBA16(&r, &g, &b, &a, in, i, mode);
-				if (a != 0 && r == profile->key_r && g == profile->key_g && b == profile->key_b)
+				row = in + y * stride;
+				for (x = 0; x != w; ++x)
 				{
-					/* Color key cannot be used if an opaque pixel also has that RGB color. */
-					profile->alpha = 1;
-					alpha_done = 1;
+					getPixelColorRGBA16(&r, &g, &b, &a, row, x, mode);
+					if (a != 0 && r == profile->key_r && g == profile->key_g && b == profile->key_b)
+					{
+						/* Color key cannot be used if an opaque pixel also has that RGB color. */
+						profile->alpha = 1;
+						alpha_done = 1;
+					}
 				}
 			}
 		}
@@ -3660,82 +4957,114 @@ unsigned lodepng_get_color_profile(LodePNGColorProfile* profile,
 	else /* < 16-bit */
 	{
 		unsigned char r = 0, g = 0, b = 0, a = 0;
-		for (i = 0; i != numpixels; ++i)
+		unsigned char last_r = 0, last_g = 0, last_b = 0, last_a = 0;
+		/*the most common input is read directly instead of through the conversion of every color type*/
+		unsigned rgba8 = mode->colortype == LCT_RGBA && mode->bitdepth == 8;
+		for (y = 0; y != h && !done; ++y)
 		{
-			getPixelColorRGBA8(&r, &g, &b, &a, in, i, mode);
-
-			if (!bits_done && profile->bits < 8)
-			{
-				/*only r is checked, < 8 bits is only relevant for greyscale*/
-				unsigned bits = getValueRequiredBits(r);
-				if (bits > profile->bits) profile->bits = bits;
-			}
-			bits_done = (profile->bits >= bpp);
-
-			if (!colored_done && (r != g || r != b))
+			row = in + y * stride;
+			for (x = 0; x != w; ++x)
 			{
-				profile->colored = 1;
-				colored_done = 1;
-				if (profile->bits < 8) profile->bits = 8; /*PNG has no colored modes with less than 8-bit per channel*/
-			}
+				if (rgba8)
+				{
+					r = row[x * 4 + 0];
+					g = row[x * 4 + 1];
+					b = row[x * 4 + 2];
+					a = row[x * 4 + 3];
+				}
+				else getPixelColorRGBA8(&r, &g, &b, &a, row, x, mode);
 
-			if (!alpha_done)
-			{
-				unsigned matchkey = (r == profile->key_r && g == profile->key_g && b == profile->key_b);
-				if (a != 255 && (a != 0 || (profile->key && !matchkey)))
+				if (!bits_done && profile->bits < 8)
 				{
-					profile->alpha = 1;
-					alpha_done = 1;
-					if (profile->bits < 8) profile->bits = 8; /*PNG has no alphachannel modes with less than 8-bit per channel*/
+					/*only r is checked, < 8 bits is only relevant for greyscale*/
+					unsigned bits = getValueRequiredBits(r);
+					if (bits > profile->bits) profile->bits = bits;
 				}
-				else if (a == 0 && !profile->alpha && !profile->key)
+				bits_done = (profile->bits >= bpp || profile->bits >= 8); /*no more than 8 bits are needed here*/
+
+				if (!colored_done && (r != g || r != b))
 				{
-					profile->key = 1;
-					profile->key_r = r;
-					profile->key_g = g;
-					profile->key_b = b;
+					profile->colored = 1;
+					colored_done = 1;
+					if (profile->bits < 8) profile->bits = 8; /*PNG has no colored modes with less than 8-bit per channel*/
 				}
-				else if (a == 255 && profile->key && matchkey)
+
+				if (!alpha_done)
 				{
-					/* Color key cannot be used if an opaque pixel also has that RGB color. */
-					profile->alpha = 1;
-					alpha_done = 1;
-					if (profile->bits < 8) profile->bits = 8; /*PNG has no alphachannel modes with less than 8-bit per channel*/
+					unsigned matchkey = (r == profile->key_r && g == profile->key_g && b == profile->key_b);
+					if (a != 255 && (a != 0 || (profile->key && !matchkey)))
+					{
+						profile->alpha = 1;
+						alpha_done = 1;
+						if (profile->bits < 8) profile->bits = 8; /*PNG has no alphachannel modes with less than 8-bit per channel*/
+					}
+					else if (a == 0 && !profile->alpha && !profile->key)
+					{
+						profile->key = 1;
+						profile->key_r = r;
+						profile->key_g = g;
+						profile->key_b = b;
+					}
+					else if (a == 255 && profile->key && matchkey)
+					{
+						/* Color key cannot be used if an opaque pixel also has that RGB color. */
+						profile->alpha = 1;
+						alpha_done = 1;
+						if (profile->bits < 8) profile->bits = 8; /*PNG has no alphachannel modes with less than 8-bit per channel*/
+					}
 				}
-			}
 
-			if (!numcolors_done)
-			{
-				if (!color_tree_has(&tree, r, g, b, a))
+				/*runs of the same color are common, only the first pixel of a run is looked up*/
+				if (!numcolors_done && ((x == 0 && y == 0) || r != last_r || g != last_g || b != last_b || a != last_a))
 				{
-					color_tree_add(&tree, r, g, b, a, profile->numcolors);
-					if (profile->numcolors < 256)
+					last_r = r;
+					last_g = g;
+					last_b = b;
+					last_a = a;
+					if (!color_tree_has(&tree, r, g, b, a))
 					{
-						unsigned char* p = profile->palette;
-						unsigned n = profile->numcolors;
-						p[n * 4 + 0] = r;
-						p[n * 4 + 1] = g;
-						p[n * 4 + 2] = b;
-						p[n * 4 + 3] = a;
+						color_tree_add(&tree, r, g, b, a, profile->numcolors);
+						if (profile->numcolors < 256)
+						{
+							unsigned char* p = profile->palette;
+							unsigned n = profile->numcolors;
+							p[n * 4 + 0] = r;
+							p[n * 4 + 1] = g;
+							p[n * 4 + 2] = b;
+							p[n * 4 + 3] = a;
+						}
+						++profile->numcolors;
+						numcolors_done = profile->numcolors >= maxnumcolors;
 					}
-					++profile->numcolors;
-					numcolors_done = profile->numcolors >= maxnumcolors;
 				}
-			}
 
-			if (alpha_done && numcolors_done && colored_done && bits_done) break;
+				if (alpha_done && numcolors_done && colored_done && bits_done)
+				{
+					done = 1;
+					break;
+				}
+				if (rgba8 && numcolors_done && colored_done && bits_done && !profile->key)
+				{
+					/*only a pixel that isn't opaque can still change the profile, opaque images end up here*/
+					while (x + 1 != w && row[(x + 1) * 4 + 3] == 255) ++x;
+				}
+			}
 		}
 
 		if (profile->key && !profile->alpha)
 		{
-			for (i = 0; i != numpixels; ++i)
+			for (y = 0; y != h; ++y)
 			{
-				getPixelColorRGBA8(&r, &g, &b, &a, in, i, mode);
-				if (a != 0 && r == profile->key_r && g == profile->key_g && b == profile->key_b)
+				row = in + y * stride;
+				for (x = 0; x != w; ++x)
 				{
-					/* Color key cannot be used if an opaque pixel also has that RGB color. */
-					profile->alpha = 1;
-					alpha_done = 1;
+					getPixelColorRGBA8(&r, &g, &b, &a, row, x, mode);
+					if (a != 0 && r == profile->key_r && g == profile->key_g && b == profile->key_b)
+					{
+						/* Color key cannot be used if an opaque pixel also has that RGB color. */
+						profile->alpha = 1;
+						alpha_done = 1;
+					}
 				}
 			}
 		}
@@ -3750,41 +5079,50 @@ unsigned lodepng_get_color_profile(LodePNGColorProfile* profile,
 	return error;
 }
 
-/*Automatically chooses color type that gives smallest amount of bits in the
-output image, e.g. grey if there are only greyscale pixels, palette if there
-are less than 256 colors, ...
-Updates values of mode with a potentially smaller color model. mode_out should
-contain the user chosen color model, but will be overwritten with the new chosen one.*/
-unsigned lodepng_auto_choose_color(LodePNGColorMode* mode_out,
-	const unsigned char* image, unsigned w, unsigned h,
+/*profile must already have been inited with mode.
+It's ok to set some parameters of profile to done already.*/
+unsigned lodepng_get_color_profile(LodePNGColorProfile* profile,
+	const unsigned char* in, unsigned w, unsigned h,
+	const LodePNGColorMode* mode)
+{
+	/*raw images have no padding between rows, pixels smaller than a byte continue in the byte the last row ended in,
+	so the image is read as one long row*/
+	return getColorProfile(profile, in, (size_t)w * h, 1, 0, mode);
+}
+
+unsigned lodepng_get_color_profile_rows(LodePNGColorProfile* profile,
+	const unsigned char* in, unsigned w, unsigned h, size_t stride,
+	const LodePNGColorMode* mode)
+{
+	return getColorProfile(profile, in, w, h, stride, mode);
+}
+
+/*Chooses the color mode from the profile of the image, the profile may be changed.*/
+static unsigned chooseColor(LodePNGColorMode* mode_out, LodePNGColorProfile* prof, unsigned w, unsigned h,
 	const LodePNGColorMode* mode_in)
 {
-	LodePNGColorProfile prof;
 	unsigned error = 0;
 	unsigned i, n, palettebits, grey_ok, palette_ok;
 
-	lodepng_color_profile_init(&prof);
-	error = lodepng_get_color_profile(&prof, image, w, h, mode_in);
-	if (error) return error;
 	mode_out->key_defined = 0;
 
-	if (prof.key && w * h <= 16)
+	if (prof->key && w * h <= 16)
 	{
-		prof.alpha = 1; /*too few pixels to justify tRNS chunk overhead*/
-		if (prof.bits < 8) prof.bits = 8; /*PNG has no alphachannel modes with less than 8-bit per channel*/
+		prof->alpha = 1; /*too few pixels to justify tRNS chunk overhead*/
+		if (prof->bits < 8) prof->bits = 8; /*PNG has no alphachannel modes with less than 8-bit per channel*/
 	}
-	grey_ok = !prof.colored && !prof.alpha; /*grey without alpha, with potentially low bits*/
-	n = prof.numcolors;
+	grey_ok = !prof->colored && !prof->alpha; /*grey without alpha, with potentially low bits*/
+	n = prof->numcolors;
 	palettebits = n <= 2 ? 1 : (n <= 4 ? 2 : (n <= 16 ? 4 : 8));
-	palette_ok = n <= 256 && (n * 2 < w * h) && prof.bits <= 8;
+	palette_ok = n <= 256 && (n * 2 < w * h) && prof->bits <= 8;
 	if (w * h < n * 2) palette_ok = 0; /*don't add palette overhead if image has only a few pixels*/
-	if (grey_ok && prof.bits <= palettebits) palette_ok = 0; /*grey is less overhead*/
+	if (grey_ok && prof->bits <= palettebits) palette_ok = 0; /*grey is less overhead*/
 
 	if (palette_ok)
 	{
-		unsigned char* p = prof.palette;
+		unsigned char* p = prof->palette;
 		lodepng_palette_clear(mode_out); /*remove potential earlier palette*/
-		for (i = 0; i != prof.numcolors; ++i)
+		for (i = 0; i != prof->numcolors; ++i)
 		{
 			error = lodepng_palette_add(mode_out, p[i * 4 + 0], p[i * 4 + 1], p[i * 4 + 2], p[i * 4 + 3]);
 			if (error) break;
@@ -3803,16 +5141,16 @@ unsigned lodepng_auto_choose_color(LodePNGColorMode* mode_out,
 	}
 	else /*8-bit or 16-bit per channel*/
 	{
-		mode_out->bitdepth = prof.bits;
-		mode_out->colortype = prof.alpha ? (prof.colored ? LCT_RGBA : LCT_GREY_ALPHA)
-			: (prof.colored ? LCT_RGB : LCT_GREY);
+		mode_out->bitdepth = prof->bits;
+		mode_out->colortype = prof->alpha ? (prof->colored ? LCT_RGBA : LCT_GREY_ALPHA)
+			: (prof->colored ? LCT_RGB : LCT_GREY);
 
-		if (prof.key && !prof.alpha)
+		if (prof->key && !prof->alpha)
 		{
 			unsigned mask = (1u << mode_out->bitdepth) - 1u; /*profile always uses 16-bit, mask converts it*/
-			mode_out->key_r = prof.key_r & mask;
-			mode_out->key_g = prof.key_g & mask;
-			mode_out->key_b = prof.key_b & mask;
+			mode_out->key_r = prof->key_r & mask;
+			mode_out->key_g = prof->key_g & mask;
+			mode_out->key_b = prof->key_b & mask;
 			mode_out->key_defined = 1;
 		}
 	}
@@ -3820,6 +5158,35 @@ unsigned lodepng_auto_choose_color(LodePNGColorMode* mode_out,
 	return error;
 }
 
+/*Automatically chooses color type that gives smallest amount of bits in the
+output image, e.g. grey if there are only greyscale pixels, palette if there
+are less than 256 colors, ...
+Updates values of mode with a potentially smaller color model. mode_out should
+contain the user chosen color model, but will be overwritten with the new chosen one.*/
+unsigned lodepng_auto_choose_color(LodePNGColorMode* mode_out,
+	const unsigned char* image, unsigned w, unsigned h,
+	const LodePNGColorMode* mode_in)
+{
+	LodePNGColorProfile prof;
+	unsigned error;
+	lodepng_color_profile_init(&prof);
+	error = lodepng_get_color_profile(&prof, image, w, h, mode_in);
+	if (error) return error;
+	return chooseColor(mode_out, &prof, w, h, mode_in);
+}
+
+unsigned lodepng_auto_choose_color_rows(LodePNGColorMode* mode_out,
+	const unsigned char* image, unsigned w, unsigned h, size_t stride,
+	const LodePNGColorMode* mode_in)
+{
+	LodePNGColorProfile prof;
+	unsigned error;
+	lodepng_color_profile_init(&prof);
+	error = lodepng_get_color_profile_rows(&prof, image, w, h, stride, mode_in);
+	if (error) return error;
+	return chooseColor(mode_out, &prof, w, h, mode_in);
+}
+
 #endif /* #ifdef LODEPNG_COMPILE_ENCODER */
 
 /*
@@ -3838,6 +5205,26 @@ static unsigned char paethPredictor(short a, short b, short c)
 	else return (unsigned char)a;
 }
 
+#ifdef LODEPNG_X86_SIMD
+/*paethPredictor of 8 values of 16 bits at once*/
+__attribute__((target("sse2")))
+static __m128i paethPredictorSSE2(__m128i a, __m128i b, __m128i c)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i pa = _mm_sub_epi16(b, c);
+	__m128i pb = _mm_sub_epi16(a, c);
+	__m128i pc = _mm_add_epi16(pa, pb); /*a + b - c - c*/
+	__m128i useb, usec;
+	pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+	pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+	pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+	useb = _mm_cmplt_epi16(pb, pa);
+	usec = _mm_and_si128(_mm_cmplt_epi16(pc, pa), _mm_cmplt_epi16(pc, pb));
+	a = _mm_or_si128(_mm_and_si128(useb, b), _mm_andnot_si128(useb, a));
+	return _mm_or_si128(_mm_and_si128(usec, c), _mm_andnot_si128(usec, a));
+}
+#endif /*LODEPNG_X86_SIMD*/
+
 /*shared values used by multiple Adam7 related functions*/
 
 static const unsigned ADAM7_IX[7] = { 0, 4, 0, 2, 0, 1, 0 }; /*x start values*/
@@ -3961,6 +5348,79 @@ unsigned lodepng_inspect(unsigned* w, unsigned* h, LodePNGState* state,
 	return state->error;
 }
 
+#ifdef LODEPNG_X86_SIMD
+/*loads the bytes of one pixel of 3, 4, 6 or 8 bytes into the low bytes of a vector*/
+__attribute__((target("sse2")))
+static __m128i loadPixelSSE2(const unsigned char* pixel, size_t bytewidth)
+{
+	unsigned low, high = 0;
+	if (bytewidth == 3) low = pixel[0] | ((unsigned)pixel[1] << 8u) | ((unsigned)pixel[2] << 16u);
+	else
+	{
+		memcpy(&low, pixel, 4);
+		if (bytewidth == 6) high = pixel[4] | ((unsigned)pixel[5] << 8u);
+		else if (bytewidth == 8) memcpy(&high, pixel + 4, 4);
+	}
+	return _mm_unpacklo_epi32(_mm_cvtsi32_si128((int)low), _mm_cvtsi32_si128((int)high));
+}
+
+/*stores the low bytewidth bytes of a vector as one pixel of 3, 4, 6 or 8 bytes*/
+__attribute__((target("sse2")))
+static void storePixelSSE2(unsigned char* pixel, __m128i value, size_t bytewidth)
+{
+	unsigned low = (unsigned)_mm_cvtsi128_si32(value);
+	unsigned high = (unsigned)_mm_cvtsi128_si32(_mm_srli_si128(value, 4));
+	if (bytewidth == 3)
+	{
+		pixel[0] = (unsigned char)low;
+		pixel[1] = (unsigned char)(low >> 8u);
+		pixel[2] = (unsigned char)(low >> 16u);
+	}
+	else
+	{
+		memcpy(pixel, &low, 4);
+		if (bytewidth == 6)
+		{
+			pixel[4] = (unsigned char)high;
+			pixel[5] = (unsigned char)(high >> 8u);
+		}
+		else if (bytewidth == 8) memcpy(pixel + 4, &high, 4);
+	}
+}
+
+/*
+Unfilters an Average or Paeth scanline with 3, 4, 6 or 8 bytes per pixel. Every byte depends on the byte
+one pixel to the left, so a whole pixel is reconstructed at once instead of one byte at a time.
+*/
+__attribute__((target("sse2")))
+static void unfilterScanlineSSE2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+	size_t bytewidth, unsigned char filterType, size_t length)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi8(1);
+	__m128i left = zero, upleft = zero; /*the pixel to the left is 0 for the first pixel, like the one above it*/
+	size_t i;
+	for (i = 0; i + bytewidth <= length; i += bytewidth)
+	{
+		__m128i current = loadPixelSSE2(&scanline[i], bytewidth);
+		__m128i up = precon ? loadPixelSSE2(&precon[i], bytewidth) : zero;
+		if (filterType == 3)
+		{
+			/*_mm_avg_epu8 rounds up, the filter rounds down*/
+			current = _mm_add_epi8(current, _mm_sub_epi8(_mm_avg_epu8(left, up), _mm_and_si128(_mm_xor_si128(left, up), one)));
+		}
+		else
+		{
+			__m128i paeth = paethPredictorSSE2(_mm_unpacklo_epi8(left, zero), _mm_unpacklo_epi8(up, zero), _mm_unpacklo_epi8(upleft, zero));
+			current = _mm_add_epi8(current, _mm_packus_epi16(paeth, zero));
+		}
+		storePixelSSE2(&recon[i], current, bytewidth);
+		left = current;
+		upleft = up;
+	}
+}
+#endif /*LODEPNG_X86_SIMD*/
+
 static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
 	size_t bytewidth, unsigned char filterType, size_t length)
 {
@@ -3974,6 +5434,14 @@ static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scan
 	*/
 
 	size_t i;
+#ifdef LODEPNG_X86_SIMD
+	if ((filterType == 3 || filterType == 4) && (bytewidth == 3 || bytewidth == 4 || bytewidth == 6 || bytewidth == 8)
+		&& __builtin_cpu_supports("sse2"))
+	{
+		unfilterScanlineSSE2(recon, scanline, precon, bytewidth, filterType, length);
+		return 0;
+	}
+#endif /*LODEPNG_X86_SIMD*/
 	switch (filterType)
 	{
 	case 0:
@@ -4066,36 +5534,53 @@ static unsigned unfilter(unsigned char* out, const unsigned char* in, unsigned w
 	return 0;
 }
 
+/*x and y distance between the pixels that the first 1 to 7 passes together have*/
+static const unsigned ADAM7_REDUCED_DX[7] = { 8, 4, 4, 2, 2, 1, 1 };
+static const unsigned ADAM7_REDUCED_DY[7] = { 8, 8, 4, 4, 2, 2, 1 };
+
+void lodepng_adam7_reduced_size(unsigned* rw, unsigned* rh, unsigned w, unsigned h, unsigned passes)
+{
+	if (passes < 1 || passes > 7) passes = 7;
+	*rw = (w + ADAM7_REDUCED_DX[passes - 1] - 1) / ADAM7_REDUCED_DX[passes - 1];
+	*rh = (h + ADAM7_REDUCED_DY[passes - 1] - 1) / ADAM7_REDUCED_DY[passes - 1];
+}
+
 /*
 in: Adam7 interlaced image, with no padding bits between scanlines, but between
 reduced images so that each reduced image starts at a byte.
 out: the same pixels, but re-ordered so that they're now a non-interlaced image with size w*h
 bpp: bits per pixel
-out has the following size in bits: w * h * bpp.
+passes: only the first passes are used, out then is the smaller image of lodepng_adam7_reduced_size
+out has the following size in bits: w * h * bpp, or the reduced size times bpp.
 in is possibly bigger due to padding bits between reduced images.
 out must be big enough AND must be 0 everywhere if bpp < 8 in the current implementation
 (because that's likely a little bit faster)
 NOTE: comments about padding bits are only relevant if bpp < 8
 */
-static void Adam7_deinterlace(unsigned char* out, const unsigned char* in, unsigned w, unsigned h, unsigned bpp)
+static void Adam7_deinterlace(unsigned char* out, const unsigned char* in, unsigned w, unsigned h, unsigned bpp,
+	unsigned passes)
 {
 	unsigned passw[7], passh[7];
 	size_t filter_passstart[8], padded_passstart[8], passstart[8];
 	unsigned i;
+	/*the pixels of the first passes are every rdx-th pixel of every rdy-th row, out only has those*/
+	unsigned rdx = ADAM7_REDUCED_DX[passes - 1], rdy = ADAM7_REDUCED_DY[passes - 1];
+	unsigned ow = (w + rdx - 1) / rdx;
 
 	Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
 
 	if (bpp >= 8)
 	{
-		for (i = 0; i != 7; ++i)
+		for (i = 0; i != passes; ++i)
 		{
 			unsigned x, y, b;
 			size_t bytewidth = bpp / 8;
+			unsigned ix = ADAM7_IX[i] / rdx, iy = ADAM7_IY[i] / rdy, dx = ADAM7_DX[i] / rdx, dy = ADAM7_DY[i] / rdy;
 			for (y = 0; y < passh[i]; ++y)
 				for (x = 0; x < passw[i]; ++x)
 				{
 				size_t pixelinstart = passstart[i] + (y * passw[i] + x) * bytewidth;
-				size_t pixeloutstart = ((ADAM7_IY[i] + y * ADAM7_DY[i]) * w + ADAM7_IX[i] + x * ADAM7_DX[i]) * bytewidth;
+				size_t pixeloutstart = ((iy + y * dy) * ow + ix + x * dx) * bytewidth;
 				for (b = 0; b < bytewidth; ++b)
 				{
 					out[pixeloutstart + b] = in[pixelinstart + b];
@@ -4105,17 +5590,18 @@ static void Adam7_deinterlace(unsigned char* out, const unsigned char* in, unsig
 	}
 	else /*bpp < 8: Adam7 with pixels < 8 bit is a bit trickier: with bit pointers*/
 	{
-		for (i = 0; i != 7; ++i)
+		for (i = 0; i != passes; ++i)
 		{
 			unsigned x, y, b;
 			unsigned ilinebits = bpp * passw[i];
-			unsigned olinebits = bpp * w;
+			unsigned olinebits = bpp * ow;
+			unsigned ix = ADAM7_IX[i] / rdx, iy = ADAM7_IY[i] / rdy, dx = ADAM7_DX[i] / rdx, dy = ADAM7_DY[i] / rdy;
 			size_t obp, ibp; /*bit pointers (for out and in buffer)*/
 			for (y = 0; y < passh[i]; ++y)
 				for (x = 0; x < passw[i]; ++x)
 				{
 				ibp = (8 * passstart[i]) + (y * ilinebits + x * bpp);
-				obp = (ADAM7_IY[i] + y * ADAM7_DY[i]) * olinebits + (ADAM7_IX[i] + x * ADAM7_DX[i]) * bpp;
+				obp = (iy + y * dy) * olinebits + (ix + x * dx) * bpp;
 				for (b = 0; b < bpp; ++b)
 				{
 					unsigned char bit = readBitFromReversedStream(&ibp, in);
@@ -4155,10 +5641,11 @@ static void removePaddingBits(unsigned char* out, const unsigned char* in,
 }
 
 /*out must be buffer big enough to contain full image, and in must contain the full decompressed data from
-the IDAT chunks (with filter index bytes and possible padding bits)
+the IDAT chunks (with filter index bytes and possible padding bits). For Adam7 interlaced images only the
+first passes are used, in then only needs their data and out only gets the reduced image
 return value is error*/
 static unsigned postProcessScanlines(unsigned char* out, unsigned char* in,
-	unsigned w, unsigned h, const LodePNGInfo* info_png)
+	unsigned w, unsigned h, const LodePNGInfo* info_png, unsigned passes)
 {
 	/*
 	This function converts the filtered-padded-interlaced data into pure 2D image buffer with the PNG's colortype.
@@ -4187,7 +5674,7 @@ static unsigned postProcessScanlines(unsigned char* out, unsigned char* in,
 
 		Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
 
-		for (i = 0; i != 7; ++i)
+		for (i = 0; i != passes; ++i)
 		{
 			CERROR_TRY_RETURN(unfilter(&in[padded_passstart[i]], &in[filter_passstart[i]], passw[i], passh[i], bpp));
 			/*TODO: possible efficiency improvement: if in this reduced image the bits fit nicely in 1 scanline,
@@ -4201,7 +5688,7 @@ static unsigned postProcessScanlines(unsigned char* out, unsigned char* in,
 			}
 		}
 
-		Adam7_deinterlace(out, in, w, h, bpp);
+		Adam7_deinterlace(out, in, w, h, bpp, passes);
 	}
 
 	return 0;
@@ -4514,18 +6001,31 @@ static unsigned readChunk_pHYs(LodePNGInfo* info, const unsigned char* data, siz
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
 /*read a PNG, the result will be in the same color type as the PNG (hence "generic")*/
-static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
-	LodePNGState* state,
-	const unsigned char* in, size_t insize)
+/*gives the data of the next IDAT chunk after the IDAT chunk with the given data, context is the end of the PNG.
+The chunks up to IEND were checked by readChunks, the IDAT chunks don't have to follow each other directly*/
+static const unsigned char* nextIdatSegment(const unsigned char* segment, size_t* size, const void* context)
+{
+	const unsigned char* end = (const unsigned char*)context;
+	const unsigned char* chunk = segment - 8;
+	for (;;)
+	{
+		chunk = lodepng_chunk_next_const(chunk);
+		if (end - chunk < 12 || lodepng_chunk_type_equals(chunk, "IEND")) return 0;
+		if (lodepng_chunk_type_equals(chunk, "IDAT")) break;
+	}
+	*size = lodepng_chunk_length(chunk);
+	return lodepng_chunk_data_const(chunk);
+}
+
+/*reads the header and all chunks into the state. idatdata gets the data of the first IDAT chunk and idatsize
+the total size of the data of all IDAT chunks, which nextIdatSegment goes through without copying it.
+return value is error*/
+static unsigned readChunks(unsigned* w, unsigned* h, const unsigned char** idatdata, size_t* idatsize,
+	LodePNGState* state, const unsigned char* in, size_t insize)
 {
 	unsigned char IEND = 0;
 	const unsigned char* chunk;
-	size_t i;
-	ucvector idat; /*the data from idat chunks*/
-	ucvector scanlines;
-	size_t predict;
 	size_t numpixels;
-	size_t outsize;
 
 	/*for unknown chunk order*/
 	unsigned unknown = 0;
@@ -4533,21 +6033,19 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
 	unsigned critical_pos = 1; /*1 = after IHDR, 2 = after PLTE, 3 = after IDAT*/
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
-	/*provide some proper output values if error will happen*/
-	*out = 0;
-
+	*idatdata = 0;
+	*idatsize = 0;
 	state->error = lodepng_inspect(w, h, state, in, insize); /*reads header and resets other parameters in state->info_png*/
-	if (state->error) return;
+	if (state->error) return state->error;
 
 	numpixels = *w * *h;
 
 	/*multiplication overflow*/
-	if (*h != 0 && numpixels / *h != *w) CERROR_RETURN(state->error, 92);
+	if (*h != 0 && numpixels / *h != *w) CERROR_RETURN_ERROR(state->error, 92);
 	/*multiplication overflow possible further below. Allows up to 2^31-1 pixel
 	bytes with 16-bit RGBA, the rest is room for filter bytes.*/
-	if (numpixels > 268435455) CERROR_RETURN(state->error, 92);
+	if (numpixels > 268435455) CERROR_RETURN_ERROR(state->error, 92);
 
-	ucvector_init(&idat);
 	chunk = &in[33]; /*first byte of the first chunk after the header*/
 
 	/*loop through the chunks, ignoring unknown chunks and stopping at IEND chunk.
@@ -4575,9 +6073,8 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
 		/*IDAT chunk, containing compressed image data*/
 		if (lodepng_chunk_type_equals(chunk, "IDAT"))
 		{
-			size_t oldsize = idat.size;
-			if (!ucvector_resize(&idat, oldsize + chunkLength)) CERROR_BREAK(state->error, 83 /*alloc fail*/);
-			for (i = 0; i != chunkLength; ++i) idat.data[oldsize + i] = data[i];
+			if (!*idatdata) *idatdata = data;
+			*idatsize += chunkLength;
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
 			critical_pos = 3;
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
@@ -4670,6 +6167,88 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
 
 		if (!IEND) chunk = lodepng_chunk_next_const(chunk);
 	}
+	return state->error;
+}
+
+/*the output of inflate until it has the size that is needed, then inflate is stopped*/
+typedef struct PrefixStream
+{
+	ucvector* out;
+	size_t size;
+} PrefixStream;
+
+static unsigned prefixStreamAdd(void* user, const unsigned char* data, size_t size)
+{
+	PrefixStream* stream = (PrefixStream*)user;
+	size_t oldsize = stream->out->size;
+	if (size > stream->size - oldsize) size = stream->size - oldsize;
+	if (!ucvector_resize(stream->out, oldsize + size)) return 83; /*alloc fail*/
+	if (size) memcpy(stream->out->data + oldsize, data, size);
+	return stream->out->size == stream->size ? INFLATE_STREAM_STOP : 0;
+}
+
+/*decompresses the zlib data of the IDAT chunks into out, where the IDAT data is read in place unless custom_zlib or
+custom_inflate are set, those get the data of all IDAT chunks copied together. If prefix is not 0 only the first
+prefix bytes are needed and the built in inflate stops when it has them*/
+static unsigned decompressIdat(ucvector* out, size_t prefix, const unsigned char* idatdata, size_t idatsize,
+	const unsigned char* end, const LodePNGDecompressSettings* settings)
+{
+	size_t size = idatdata ? lodepng_chunk_length(idatdata - 8) : 0;
+	if (settings->custom_zlib || settings->custom_inflate)
+	{
+		unsigned error;
+		ucvector idat;
+		const unsigned char* data;
+		size_t pos = 0;
+		/*the data of a single IDAT chunk already is in one buffer*/
+		if (size == idatsize) error = zlib_decompress(&out->data, &out->size, idatdata, idatsize, settings);
+		else
+		{
+			ucvector_init(&idat);
+			if (!ucvector_resize(&idat, idatsize)) return 83; /*alloc fail*/
+			for (data = idatdata; data; data = nextIdatSegment(data, &size, end))
+			{
+				if (size) memcpy(idat.data + pos, data, size);
+				pos += size;
+			}
+			error = zlib_decompress(&out->data, &out->size, idat.data, idat.size, settings);
+			ucvector_cleanup(&idat);
+		}
+		if (!error && prefix && out->size > prefix) out->size = prefix;
+		return error;
+	}
+	if (prefix)
+	{
+		PrefixStream stream;
+		stream.out = out;
+		stream.size = prefix;
+		return zlib_decompress_stream(idatdata, size, nextIdatSegment, end, idatsize, settings, prefixStreamAdd, &stream);
+	}
+	return zlib_decompress_segments(out, idatdata, size, nextIdatSegment, end, idatsize, settings, 0);
+}
+
+static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
+	LodePNGState* state,
+	const unsigned char* in, size_t insize)
+{
+	size_t i;
+	const unsigned char* idatdata;
+	size_t idatsize;
+	ucvector scanlines;
+	size_t predict;
+	size_t outsize;
+	unsigned passes = 7; /*the number of Adam7 passes that are decoded*/
+	unsigned rw, rh; /*size of the decoded image, smaller than w * h if not all passes are decoded*/
+
+	/*provide some proper output values if error will happen*/
+	*out = 0;
+
+	if (readChunks(w, h, &idatdata, &idatsize, state, in, insize)) return;
+	if (state->info_png.interlace_method == 1 && state->decoder.adam7_passes >= 1 && state->decoder.adam7_passes < 7)
+	{
+		passes = state->decoder.adam7_passes;
+	}
+	lodepng_adam7_reduced_size(&rw, &rh, *w, *h, passes);
 
 	ucvector_init(&scanlines);
 	/*predict output size, to allocate exact size for output buffer to avoid more dynamic allocation.
@@ -4679,6 +6258,15 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
 		/*The extra *h is added because this are the filter bytes every scanline starts with*/
 		predict = lodepng_get_raw_size_idat(*w, *h, &state->info_png.color) + *h;
 	}
+	else if (passes < 7)
+	{
+		/*the passes are stored one after the other, so inflate can stop after the bytes of the first passes*/
+		unsigned passw[7], passh[7];
+		size_t filter_passstart[8], padded_passstart[8], passstart[8];
+		Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart,
+			*w, *h, lodepng_get_bpp(&state->info_png.color));
+		predict = filter_passstart[passes];
+	}
 	else
 	{
 		/*Adam-7 interlaced: predicted size is the sum of the 7 sub-images sizes*/
@@ -4695,22 +6283,26 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
 	if (!state->error && !ucvector_reserve(&scanlines, predict)) state->error = 83; /*alloc fail*/
 	if (!state->error)
 	{
-		state->error = zlib_decompress(&scanlines.data, &scanlines.size, idat.data,
-			idat.size, &state->decoder.zlibsettings);
+		state->error = decompressIdat(&scanlines, passes < 7 ? predict : 0, idatdata, idatsize, in + insize,
+			&state->decoder.zlibsettings);
 		if (!state->error && scanlines.size != predict) state->error = 91; /*decompressed size doesn't match prediction*/
 	}
-	ucvector_cleanup(&idat);
 
 	if (!state->error)
 	{
-		outsize = lodepng_get_raw_size(*w, *h, &state->info_png.color);
+		outsize = lodepng_get_raw_size(rw, rh, &state->info_png.color);
 		*out = (unsigned char*)lodepng_malloc(outsize);
 		if (!*out) state->error = 83; /*alloc fail*/
 	}
 	if (!state->error)
 	{
 		for (i = 0; i < outsize; i++) (*out)[i] = 0;
-		state->error = postProcessScanlines(*out, scanlines.data, *w, *h, &state->info_png);
+		state->error = postProcessScanlines(*out, scanlines.data, *w, *h, &state->info_png, passes);
+	}
+	if (!state->error)
+	{
+		*w = rw;
+		*h = rh;
 	}
 	ucvector_cleanup(&scanlines);
 }
@@ -4724,39 +6316,190 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
 	if (state->error) return state->error;
 	if (!state->decoder.color_convert || lodepng_color_mode_equal(&state->info_raw, &state->info_png.color))
 	{
-		/*same color type, no copying or converting of data needed*/
-		/*store the info_png color settings on the info_raw so that the info_raw still reflects what colortype
-		the raw image has to the end user*/
-		if (!state->decoder.color_convert)
+		/*same color type, no copying or converting of data needed*/
+		/*store the info_png color settings on the info_raw so that the info_raw still reflects what colortype
+		the raw image has to the end user*/
+		if (!state->decoder.color_convert)
+		{
+			state->error = lodepng_color_mode_copy(&state->info_raw, &state->info_png.color);
+			if (state->error) return state->error;
+		}
+	}
+	else
+	{
+		/*color conversion needed; sort of copy of the data*/
+		unsigned char* data = *out;
+		size_t outsize;
+
+		/*TODO: check if this works according to the statement in the documentation: "The converter can convert
+		from greyscale input color type, to 8-bit greyscale or greyscale with alpha"*/
+		if (!(state->info_raw.colortype == LCT_RGB || state->info_raw.colortype == LCT_RGBA)
+			&& !(state->info_raw.bitdepth == 8))
+		{
+			return 56; /*unsupported color mode conversion*/
+		}
+
+		outsize = lodepng_get_raw_size(*w, *h, &state->info_raw);
+		*out = (unsigned char*)lodepng_malloc(outsize);
+		if (!(*out))
+		{
+			state->error = 83; /*alloc fail*/
+		}
+		else state->error = lodepng_convert(*out, data, &state->info_raw,
+			&state->info_png.color, *w, *h);
+		lodepng_free(data);
+	}
+	return state->error;
+}
+
+/*collects the inflated scanlines of a non-interlaced image and hands them to the user one by one*/
+typedef struct RowStream
+{
+	LodePNGState* state;
+	unsigned w, h;
+	unsigned y; /*next row to complete*/
+	size_t linebytes; /*bytes per scanline without the filter type byte*/
+	size_t filled; /*bytes of the current scanline received so far, including the filter type byte*/
+	unsigned char* current; /*filter type byte followed by the scanline being received*/
+	unsigned char* previous; /*previous unfiltered scanline, behind a filter type byte so it can be swapped*/
+	unsigned char* converted; /*the row in the color mode of info_raw, unused if no conversion is needed*/
+	LodePNGRowCallback callback;
+	void* user;
+} RowStream;
+
+static unsigned rowStreamAdd(void* user, const unsigned char* data, size_t size)
+{
+	RowStream* stream = (RowStream*)user;
+	while (size > 0)
+	{
+		size_t amount = 1 + stream->linebytes - stream->filled;
+		if (amount > size) amount = size;
+		if (stream->y >= stream->h) return 91; /*decompressed size doesn't match prediction*/
+		memcpy(stream->current + stream->filled, data, amount);
+		stream->filled += amount;
+		data += amount;
+		size -= amount;
+
+		if (stream->filled == 1 + stream->linebytes)
+		{
+			unsigned char* swap;
+			const unsigned char* row = stream->current + 1;
+			unsigned bpp = lodepng_get_bpp(&stream->state->info_png.color);
+			CERROR_TRY_RETURN(unfilterScanline(stream->current + 1, stream->current + 1,
+				stream->y == 0 ? 0 : stream->previous + 1, (bpp + 7) / 8, stream->current[0], stream->linebytes));
+			/*the padding bits at the end of a single scanline are harmless for the conversion*/
+			if (stream->converted)
+			{
+				CERROR_TRY_RETURN(lodepng_convert(stream->converted, row, &stream->state->info_raw,
+					&stream->state->info_png.color, stream->w, 1));
+				row = stream->converted;
+			}
+			CERROR_TRY_RETURN(stream->callback(stream->user, stream->y, row));
+
+			swap = stream->previous;
+			stream->previous = stream->current;
+			stream->current = swap;
+			stream->filled = 0;
+			++stream->y;
+		}
+	}
+	return 0;
+}
+
+/*decodes the whole image and then hands out its rows, used for Adam7 interlaced images*/
+static unsigned decodeRowsFromImage(unsigned* w, unsigned* h, LodePNGState* state,
+	const unsigned char* in, size_t insize, LodePNGRowCallback callback, void* user)
+{
+	unsigned char* image = 0;
+	unsigned char* line = 0;
+	unsigned y;
+	size_t linebits, linebytes;
+	unsigned error = lodepng_decode(&image, w, h, state, in, insize);
+
+	/*rows of the decoded image are not byte aligned when they have a fractional number of bytes*/
+	linebits = (size_t)(*w) * lodepng_get_bpp(&state->info_raw);
+	linebytes = (linebits + 7) / 8;
+	if (!error && (linebits & 7) != 0)
+	{
+		line = (unsigned char*)lodepng_malloc(linebytes);
+		if (!line) error = 83; /*alloc fail*/
+	}
+	for (y = 0; !error && y < *h; ++y)
+	{
+		if (line)
 		{
-			state->error = lodepng_color_mode_copy(&state->info_raw, &state->info_png.color);
-			if (state->error) return state->error;
+			size_t ibp = y * linebits, obp = 0, x;
+			for (x = 0; x < linebits; ++x) setBitOfReversedStream(&obp, line, readBitFromReversedStream(&ibp, image));
+			error = callback(user, y, line);
 		}
+		else error = callback(user, y, image + y * linebytes);
 	}
-	else
+	lodepng_free(line);
+	lodepng_free(image);
+	return error;
+}
+
+unsigned lodepng_decode_rows(unsigned* w, unsigned* h, LodePNGState* state,
+	const unsigned char* in, size_t insize, LodePNGRowCallback callback, void* user)
+{
+	const unsigned char* idatdata;
+	size_t idatsize;
+	RowStream stream;
+	size_t i;
+
+	if (readChunks(w, h, &idatdata, &idatsize, state, in, insize)) return state->error;
+	if (state->info_png.interlace_method != 0)
 	{
-		/*color conversion needed; sort of copy of the data*/
-		unsigned char* data = *out;
-		size_t outsize;
+		state->error = decodeRowsFromImage(w, h, state, in, insize, callback, user);
+		return state->error;
+	}
 
-		/*TODO: check if this works according to the statement in the documentation: "The converter can convert
-		from greyscale input color type, to 8-bit greyscale or greyscale with alpha"*/
+	stream.state = state;
+	stream.w = *w;
+	stream.h = *h;
+	stream.y = 0;
+	stream.linebytes = lodepng_get_raw_size_idat(*w, 1, &state->info_png.color);
+	stream.filled = 0;
+	stream.current = (unsigned char*)lodepng_malloc(1 + stream.linebytes);
+	stream.previous = (unsigned char*)lodepng_malloc(1 + stream.linebytes);
+	stream.converted = 0;
+	stream.callback = callback;
+	stream.user = user;
+	if (!stream.current || !stream.previous) state->error = 83; /*alloc fail*/
+
+	/*same color mode handling as lodepng_decode, but for a single row*/
+	if (!state->error && !state->decoder.color_convert)
+	{
+		state->error = lodepng_color_mode_copy(&state->info_raw, &state->info_png.color);
+	}
+	else if (!state->error && !lodepng_color_mode_equal(&state->info_raw, &state->info_png.color))
+	{
 		if (!(state->info_raw.colortype == LCT_RGB || state->info_raw.colortype == LCT_RGBA)
 			&& !(state->info_raw.bitdepth == 8))
 		{
-			return 56; /*unsupported color mode conversion*/
+			state->error = 56; /*unsupported color mode conversion*/
 		}
-
-		outsize = lodepng_get_raw_size(*w, *h, &state->info_raw);
-		*out = (unsigned char*)lodepng_malloc(outsize);
-		if (!(*out))
+		else
 		{
-			state->error = 83; /*alloc fail*/
+			size_t size = lodepng_get_raw_size(*w, 1, &state->info_raw);
+			stream.converted = (unsigned char*)lodepng_malloc(size);
+			if (!stream.converted) state->error = 83; /*alloc fail*/
+			/*lodepng_convert only sets the bits of sub-byte pixels, so the row has to start out zeroed*/
+			else for (i = 0; i < size; ++i) stream.converted[i] = 0;
 		}
-		else state->error = lodepng_convert(*out, data, &state->info_raw,
-			&state->info_png.color, *w, *h);
-		lodepng_free(data);
 	}
+
+	if (!state->error)
+	{
+		size_t size = idatdata ? lodepng_chunk_length(idatdata - 8) : 0;
+		state->error = zlib_decompress_stream(idatdata, size, nextIdatSegment, in + insize, idatsize,
+			&state->decoder.zlibsettings, rowStreamAdd, &stream);
+		if (!state->error && (stream.y != stream.h || stream.filled != 0)) state->error = 91; /*size doesn't match prediction*/
+	}
+
+	lodepng_free(stream.current);
+	lodepng_free(stream.previous);
+	lodepng_free(stream.converted);
 	return state->error;
 }
 
@@ -4815,6 +6558,7 @@ void lodepng_decoder_settings_init(LodePNGDecoderSettings* settings)
 	settings->remember_unknown_chunks = 0;
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 	settings->ignore_crc = 0;
+	settings->adam7_passes = 0;
 	lodepng_decompress_settings_init(&settings->zlibsettings);
 }
 
@@ -5192,6 +6936,135 @@ static void filterScanline(unsigned char* out, const unsigned char* scanline, co
 	}
 }
 
+/*the score of LFS_MINSUM for the filtered bytes start .. end - 1*/
+static size_t filterSum(const unsigned char* filtered, size_t start, size_t end, unsigned type)
+{
+	size_t x, sum = 0;
+	if (type == 0)
+	{
+		for (x = start; x < end; ++x) sum += filtered[x];
+	}
+	else
+	{
+		for (x = start; x < end; ++x)
+		{
+			/*For differences, each byte should be treated as signed, values above 127 are negative
+			(converted to signed char). Filtertype 0 isn't a difference though, so use unsigned there.
+			This means filtertype 0 is almost never chosen, but that is justified.*/
+			unsigned char s = filtered[x];
+			sum += s < 128 ? s : (255U - s);
+		}
+	}
+	return sum;
+}
+
+#ifdef LODEPNG_X86_SIMD
+/*byte i of scanline filtered with a filter type, for the bytes that filterAttempts does one at a time*/
+static unsigned char filterByte(const unsigned char* scanline, const unsigned char* prevline,
+	size_t i, size_t bytewidth, unsigned type)
+{
+	unsigned char left = i >= bytewidth ? scanline[i - bytewidth] : 0;
+	unsigned char up = prevline ? prevline[i] : 0;
+	unsigned char upleft = (prevline && i >= bytewidth) ? prevline[i - bytewidth] : 0;
+	switch (type)
+	{
+	case 1: return (unsigned char)(scanline[i] - left);
+	case 2: return (unsigned char)(scanline[i] - up);
+	case 3: return (unsigned char)(scanline[i] - ((left + up) >> 1));
+	case 4: return (unsigned char)(scanline[i] - paethPredictor(left, up, upleft));
+	default: return scanline[i];
+	}
+}
+
+/*adds the two 64-bit lanes of sums of _mm_sad_epu8*/
+__attribute__((target("sse2")))
+static size_t sumLanesSSE2(__m128i sums)
+{
+	sums = _mm_add_epi64(sums, _mm_unpackhi_epi64(sums, sums));
+	return (size_t)(unsigned)_mm_cvtsi128_si32(sums)
+		+ (((size_t)(unsigned)_mm_cvtsi128_si32(_mm_srli_si128(sums, 4)) << 16) << 16);
+}
+
+/*
+Filters a scanline with all five filter types in one pass and gives the sums of LFS_MINSUM, 16 bytes at a
+time. The encoder knows the unfiltered bytes to the left, so unlike unfiltering there is no dependency
+between the bytes. The first pixel and the bytes at the end that don't fill 16 bytes are done one at a time.
+*/
+__attribute__((target("sse2")))
+static void filterAttemptsSSE2(unsigned char** attempt, size_t* sum, const unsigned char* scanline,
+	const unsigned char* prevline, size_t length, size_t bytewidth)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi8(1);
+	__m128i sums[5];
+	size_t i, head = bytewidth < length ? bytewidth : length, tail;
+	unsigned type;
+
+	for (type = 0; type != 5; ++type) sums[type] = zero;
+	for (i = 0; i != head; ++i)
+	{
+		for (type = 0; type != 5; ++type) attempt[type][i] = filterByte(scanline, prevline, i, bytewidth, type);
+	}
+	for (; i + 16 <= length; i += 16)
+	{
+		__m128i current = _mm_loadu_si128((const __m128i*)&scanline[i]);
+		__m128i left = _mm_loadu_si128((const __m128i*)&scanline[i - bytewidth]);
+		__m128i up = prevline ? _mm_loadu_si128((const __m128i*)&prevline[i]) : zero;
+		__m128i upleft = prevline ? _mm_loadu_si128((const __m128i*)&prevline[i - bytewidth]) : zero;
+		/*_mm_avg_epu8 rounds up, the filter rounds down*/
+		__m128i average = _mm_sub_epi8(_mm_avg_epu8(left, up), _mm_and_si128(_mm_xor_si128(left, up), one));
+		__m128i paeth = _mm_packus_epi16(
+			paethPredictorSSE2(_mm_unpacklo_epi8(left, zero), _mm_unpacklo_epi8(up, zero), _mm_unpacklo_epi8(upleft, zero)),
+			paethPredictorSSE2(_mm_unpackhi_epi8(left, zero), _mm_unpackhi_epi8(up, zero), _mm_unpackhi_epi8(upleft, zero)));
+		__m128i filtered[5];
+		filtered[0] = current;
+		filtered[1] = _mm_sub_epi8(current, left);
+		filtered[2] = _mm_sub_epi8(current, up);
+		filtered[3] = _mm_sub_epi8(current, average);
+		filtered[4] = _mm_sub_epi8(current, paeth);
+
+		_mm_storeu_si128((__m128i*)&attempt[0][i], current);
+		sums[0] = _mm_add_epi64(sums[0], _mm_sad_epu8(current, zero));
+		for (type = 1; type != 5; ++type)
+		{
+			/*the differences count as signed bytes: s < 128 ? s : 255 - s, which is s with its bits flipped*/
+			__m128i magnitude = _mm_xor_si128(filtered[type], _mm_cmpgt_epi8(zero, filtered[type]));
+			_mm_storeu_si128((__m128i*)&attempt[type][i], filtered[type]);
+			sums[type] = _mm_add_epi64(sums[type], _mm_sad_epu8(magnitude, zero));
+		}
+	}
+	for (tail = i; i < length; ++i)
+	{
+		for (type = 0; type != 5; ++type) attempt[type][i] = filterByte(scanline, prevline, i, bytewidth, type);
+	}
+
+	for (type = 0; type != 5; ++type)
+	{
+		sum[type] = sumLanesSSE2(sums[type]) + filterSum(attempt[type], 0, head, type)
+			+ filterSum(attempt[type], tail, length, type);
+	}
+}
+#endif /*LODEPNG_X86_SIMD*/
+
+/*filters a scanline into attempt[0] to attempt[4] with each filter type, sum gets the LFS_MINSUM scores*/
+static void filterAttempts(unsigned char** attempt, size_t* sum, const unsigned char* scanline,
+	const unsigned char* prevline, size_t length, size_t bytewidth)
+{
+	unsigned type;
+#ifdef LODEPNG_X86_SIMD
+	if (__builtin_cpu_supports("sse2"))
+	{
+		filterAttemptsSSE2(attempt, sum, scanline, prevline, length, bytewidth);
+		return;
+	}
+#endif /*LODEPNG_X86_SIMD*/
+	for (type = 0; type != 5; ++type)
+	{
+		filterScanline(attempt[type], scanline, prevline, length, bytewidth, (unsigned char)type);
+		sum[type] = filterSum(attempt[type], 0, length, type);
+	}
+}
+
 /* log2 approximation. A slight bit faster than std::log. */
 static float flog2(float f)
 {
@@ -5201,25 +7074,9 @@ static float flog2(float f)
 	return result + 1.442695f * (f * f * f / 3 - 3 * f * f / 2 + 3 * f - 1.83333f);
 }
 
-static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w, unsigned h,
-	const LodePNGColorMode* info, const LodePNGEncoderSettings* settings)
+/*the filter strategy used for images with the given color mode*/
+static LodePNGFilterStrategy getFilterStrategy(const LodePNGColorMode* info, const LodePNGEncoderSettings* settings)
 {
-	/*
-	For PNG filter method 0
-	out must be a buffer with as size: h + (w * h * bpp + 7) / 8, because there are
-	the scanlines with 1 extra byte per scanline
-	*/
-
-	unsigned bpp = lodepng_get_bpp(info);
-	/*the width of a scanline in bytes, not including the filter type*/
-	size_t linebytes = (w * bpp + 7) / 8;
-	/*bytewidth is used for filtering, is 1 when bpp < 8, number of bytes per pixel otherwise*/
-	size_t bytewidth = (bpp + 7) / 8;
-	const unsigned char* prevline = 0;
-	unsigned x, y;
-	unsigned error = 0;
-	LodePNGFilterStrategy strategy = settings->filter_strategy;
-
 	/*
 	There is a heuristic called the minimum sum of absolute differences heuristic, suggested by the PNG standard:
 	*  If the image type is Palette, or the bit depth is smaller than 8, then do not filter the image (i.e.
@@ -5234,136 +7091,72 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
 	heuristic is used.
 	*/
 	if (settings->filter_palette_zero &&
-		(info->colortype == LCT_PALETTE || info->bitdepth < 8)) strategy = LFS_ZERO;
+		(info->colortype == LCT_PALETTE || info->bitdepth < 8)) return LFS_ZERO;
+	return settings->filter_strategy;
+}
 
-	if (bpp == 0) return 31; /*error: invalid color type*/
+/*
+Filters scanline y into out, which gets the filter type byte followed by the linebytes filtered bytes.
+prevline is the previous unfiltered scanline, or 0 for the first one. For the strategies that try every
+filter type, attempt must point to five buffers of linebytes bytes.
+*/
+static unsigned filterRow(unsigned char* out, const unsigned char* scanline, const unsigned char* prevline,
+	size_t linebytes, size_t bytewidth, unsigned y, LodePNGFilterStrategy strategy,
+	const LodePNGEncoderSettings* settings, unsigned char** attempt)
+{
+	size_t x;
+	unsigned type, bestType = 0;
 
-	if (strategy == LFS_ZERO)
+	if (strategy == LFS_ZERO || strategy == LFS_PREDEFINED)
 	{
-		for (y = 0; y != h; ++y)
-		{
-			size_t outindex = (1 + linebytes) * y; /*the extra filterbyte added to each row*/
-			size_t inindex = linebytes * y;
-			out[outindex] = 0; /*filter type byte*/
-			filterScanline(&out[outindex + 1], &in[inindex], prevline, linebytes, bytewidth, 0);
-			prevline = &in[inindex];
-		}
+		out[0] = strategy == LFS_ZERO ? 0 : settings->predefined_filters[y]; /*filter type byte*/
+		filterScanline(&out[1], scanline, prevline, linebytes, bytewidth, out[0]);
+		return 0;
 	}
 	else if (strategy == LFS_MINSUM)
 	{
 		/*adaptive filtering*/
 		size_t sum[5];
-		unsigned char* attempt[5]; /*five filtering attempts, one for each filter type*/
 		size_t smallest = 0;
-		unsigned char type, bestType = 0;
 
+		/*try the 5 filter types*/
+		filterAttempts(attempt, sum, scanline, prevline, linebytes, bytewidth);
 		for (type = 0; type != 5; ++type)
 		{
-			attempt[type] = (unsigned char*)lodepng_malloc(linebytes);
-			if (!attempt[type]) return 83; /*alloc fail*/
-		}
-
-		if (!error)
-		{
-			for (y = 0; y != h; ++y)
+			/*check if this is smallest sum (or if type == 0 it's the first case so always store the values)*/
+			if (type == 0 || sum[type] < smallest)
 			{
-				/*try the 5 filter types*/
-				for (type = 0; type != 5; ++type)
-				{
-					filterScanline(attempt[type], &in[y * linebytes], prevline, linebytes, bytewidth, type);
-
-					/*calculate the sum of the result*/
-					sum[type] = 0;
-					if (type == 0)
-					{
-						for (x = 0; x != linebytes; ++x) sum[type] += (unsigned char)(attempt[type][x]);
-					}
-					else
-					{
-						for (x = 0; x != linebytes; ++x)
-						{
-							/*For differences, each byte should be treated as signed, values above 127 are negative
-							(converted to signed char). Filtertype 0 isn't a difference though, so use unsigned there.
-							This means filtertype 0 is almost never chosen, but that is justified.*/
-							unsigned char s = attempt[type][x];
-							sum[type] += s < 128 ? s : (255U - s);
-						}
-					}
-
-					/*check if this is smallest sum (or if type == 0 it's the first case so always store the values)*/
-					if (type == 0 || sum[type] < smallest)
-					{
-						bestType = type;
-						smallest = sum[type];
-					}
-				}
-
-				prevline = &in[y * linebytes];
-
-				/*now fill the out values*/
-				out[y * (linebytes + 1)] = bestType; /*the first byte of a scanline will be the filter type*/
-				for (x = 0; x != linebytes; ++x) out[y * (linebytes + 1) + 1 + x] = attempt[bestType][x];
+				bestType = type;
+				smallest = sum[type];
 			}
 		}
-
-		for (type = 0; type != 5; ++type) lodepng_free(attempt[type]);
 	}
 	else if (strategy == LFS_ENTROPY)
 	{
 		float sum[5];
-		unsigned char* attempt[5]; /*five filtering attempts, one for each filter type*/
 		float smallest = 0;
-		unsigned type, bestType = 0;
 		unsigned count[256];
+		size_t sum_unused[5];
 
+		/*try the 5 filter types*/
+		filterAttempts(attempt, sum_unused, scanline, prevline, linebytes, bytewidth);
 		for (type = 0; type != 5; ++type)
 		{
-			attempt[type] = (unsigned char*)lodepng_malloc(linebytes);
-			if (!attempt[type]) return 83; /*alloc fail*/
-		}
-
-		for (y = 0; y != h; ++y)
-		{
-			/*try the 5 filter types*/
-			for (type = 0; type != 5; ++type)
+			for (x = 0; x != 256; ++x) count[x] = 0;
+			for (x = 0; x != linebytes; ++x) ++count[attempt[type][x]];
+			++count[type]; /*the filter type itself is part of the scanline*/
+			sum[type] = 0;
+			for (x = 0; x != 256; ++x)
 			{
-				filterScanline(attempt[type], &in[y * linebytes], prevline, linebytes, bytewidth, type);
-				for (x = 0; x != 256; ++x) count[x] = 0;
-				for (x = 0; x != linebytes; ++x) ++count[attempt[type][x]];
-				++count[type]; /*the filter type itself is part of the scanline*/
-				sum[type] = 0;
-				for (x = 0; x != 256; ++x)
-				{
-					float p = count[x] / (float)(linebytes + 1);
-					sum[type] += count[x] == 0 ? 0 : flog2(1 / p) * p;
-				}
-				/*check if this is smallest sum (or if type == 0 it's the first case so always store the values)*/
-				if (type == 0 || sum[type] < smallest)
-				{
-					bestType = type;
-					smallest = sum[type];
-				}
+				float p = count[x] / (float)(linebytes + 1);
+				sum[type] += count[x] == 0 ? 0 : flog2(1 / p) * p;
+			}
+			/*check if this is smallest sum (or if type == 0 it's the first case so always store the values)*/
+			if (type == 0 || sum[type] < smallest)
+			{
+				bestType = type;
+				smallest = sum[type];
 			}
-
-			prevline = &in[y * linebytes];
-
-			/*now fill the out values*/
-			out[y * (linebytes + 1)] = bestType; /*the first byte of a scanline will be the filter type*/
-			for (x = 0; x != linebytes; ++x) out[y * (linebytes + 1) + 1 + x] = attempt[bestType][x];
-		}
-
-		for (type = 0; type != 5; ++type) lodepng_free(attempt[type]);
-	}
-	else if (strategy == LFS_PREDEFINED)
-	{
-		for (y = 0; y != h; ++y)
-		{
-			size_t outindex = (1 + linebytes) * y; /*the extra filterbyte added to each row*/
-			size_t inindex = linebytes * y;
-			unsigned char type = settings->predefined_filters[y];
-			out[outindex] = type; /*filter type byte*/
-			filterScanline(&out[outindex + 1], &in[inindex], prevline, linebytes, bytewidth, type);
-			prevline = &in[inindex];
 		}
 	}
 	else if (strategy == LFS_BRUTE_FORCE)
@@ -5372,9 +7165,7 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
 		deflate the scanline after every filter attempt to see which one deflates best.
 		This is very slow and gives only slightly smaller, sometimes even larger, result*/
 		size_t size[5];
-		unsigned char* attempt[5]; /*five filtering attempts, one for each filter type*/
 		size_t smallest = 0;
-		unsigned type = 0, bestType = 0;
 		unsigned char* dummy;
 		LodePNGCompressSettings zlibsettings = settings->zlibsettings;
 		/*use fixed tree on the attempts so that the tree is not adapted to the filtertype on purpose,
@@ -5386,38 +7177,72 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
 		images only, so disable it*/
 		zlibsettings.custom_zlib = 0;
 		zlibsettings.custom_deflate = 0;
-		for (type = 0; type != 5; ++type)
-		{
-			attempt[type] = (unsigned char*)lodepng_malloc(linebytes);
-			if (!attempt[type]) return 83; /*alloc fail*/
-		}
-		for (y = 0; y != h; ++y) /*try the 5 filter types*/
-		{
-			for (type = 0; type != 5; ++type)
+		for (type = 0; type != 5; ++type) /*try the 5 filter types*/
+		{
+			size_t testsize = linebytes;
+			/*if(testsize > 8) testsize /= 8;*/ /*it already works good enough by testing a part of the row*/
+
+			filterScanline(attempt[type], scanline, prevline, linebytes, bytewidth, (unsigned char)type);
+			size[type] = 0;
+			dummy = 0;
+			zlib_compress(&dummy, &size[type], attempt[type], testsize, &zlibsettings);
+			lodepng_free(dummy);
+			/*check if this is smallest size (or if type == 0 it's the first case so always store the values)*/
+			if (type == 0 || size[type] < smallest)
 			{
-				unsigned testsize = linebytes;
-				/*if(testsize > 8) testsize /= 8;*/ /*it already works good enough by testing a part of the row*/
-
-				filterScanline(attempt[type], &in[y * linebytes], prevline, linebytes, bytewidth, type);
-				size[type] = 0;
-				dummy = 0;
-				zlib_compress(&dummy, &size[type], attempt[type], testsize, &zlibsettings);
-				lodepng_free(dummy);
-				/*check if this is smallest size (or if type == 0 it's the first case so always store the values)*/
-				if (type == 0 || size[type] < smallest)
-				{
-					bestType = type;
-					smallest = size[type];
-				}
+				bestType = type;
+				smallest = size[type];
 			}
-			prevline = &in[y * linebytes];
-			out[y * (linebytes + 1)] = bestType; /*the first byte of a scanline will be the filter type*/
-			for (x = 0; x != linebytes; ++x) out[y * (linebytes + 1) + 1 + x] = attempt[bestType][x];
 		}
-		for (type = 0; type != 5; ++type) lodepng_free(attempt[type]);
 	}
 	else return 88; /* unknown filter strategy */
 
+	/*now fill the out values*/
+	out[0] = (unsigned char)bestType; /*the first byte of a scanline will be the filter type*/
+	for (x = 0; x != linebytes; ++x) out[1 + x] = attempt[bestType][x];
+	return 0;
+}
+
+static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w, unsigned h,
+	const LodePNGColorMode* info, const LodePNGEncoderSettings* settings)
+{
+	/*
+	For PNG filter method 0
+	out must be a buffer with as size: h + (w * h * bpp + 7) / 8, because there are
+	the scanlines with 1 extra byte per scanline
+	*/
+
+	unsigned bpp = lodepng_get_bpp(info);
+	/*the width of a scanline in bytes, not including the filter type*/
+	size_t linebytes = (w * bpp + 7) / 8;
+	/*bytewidth is used for filtering, is 1 when bpp < 8, number of bytes per pixel otherwise*/
+	size_t bytewidth = (bpp + 7) / 8;
+	const unsigned char* prevline = 0;
+	unsigned char* attempt[5] = {0, 0, 0, 0, 0}; /*five filtering attempts, one for each filter type*/
+	unsigned type, y;
+	unsigned error = 0;
+	LodePNGFilterStrategy strategy = getFilterStrategy(info, settings);
+
+	if (bpp == 0) return 31; /*error: invalid color type*/
+
+	if (strategy != LFS_ZERO && strategy != LFS_PREDEFINED)
+	{
+		for (type = 0; type != 5 && !error; ++type)
+		{
+			attempt[type] = (unsigned char*)lodepng_malloc(linebytes);
+			if (!attempt[type]) error = 83; /*alloc fail*/
+		}
+	}
+
+	for (y = 0; y != h && !error; ++y)
+	{
+		size_t outindex = (1 + linebytes) * y; /*the extra filterbyte added to each row*/
+		size_t inindex = linebytes * y;
+		error = filterRow(&out[outindex], &in[inindex], prevline, linebytes, bytewidth, y, strategy, settings, attempt);
+		prevline = &in[inindex];
+	}
+
+	for (type = 0; type != 5; ++type) lodepng_free(attempt[type]);
 	return error;
 }
 
@@ -5825,6 +7650,179 @@ unsigned lodepng_encode(unsigned char** out, size_t* outsize,
 	return state->error;
 }
 
+struct LodePNGRowEncoder
+{
+	LodePNGState* state;
+	LodePNGWriteCallback callback;
+	void* user;
+	unsigned w, h, y;
+	size_t linebytes; /*the width of a scanline in bytes, not including the filter type*/
+	size_t bytewidth; /*1 when bpp < 8, number of bytes per pixel otherwise*/
+	LodePNGFilterStrategy strategy;
+	unsigned char* current; /*the row being encoded, in the color mode of the PNG*/
+	unsigned char* previous; /*the row before it, which the filters look at*/
+	unsigned char* filtered; /*filter type byte followed by the filtered row*/
+	unsigned char* attempt[5]; /*five filtering attempts, one for each filter type*/
+	ZlibStream zlib;
+	ucvector chunks; /*chunks that are ready to be written*/
+};
+
+/*hands the chunks that are ready to the callback*/
+static unsigned rowEncoderWrite(LodePNGRowEncoder* encoder)
+{
+	unsigned error = 0;
+	if (encoder->chunks.size) error = encoder->callback(encoder->user, encoder->chunks.data, encoder->chunks.size);
+	encoder->chunks.size = 0;
+	return error;
+}
+
+/*puts the compressed bytes that are complete in an IDAT chunk*/
+static unsigned rowEncoderAddIDAT(LodePNGRowEncoder* encoder)
+{
+	size_t size = zlib_stream_available(&encoder->zlib);
+	if (size == 0) return 0;
+	CERROR_TRY_RETURN(addChunk(&encoder->chunks, "IDAT", encoder->zlib.out.data, size));
+	zlib_stream_consume(&encoder->zlib);
+	return 0;
+}
+
+static void rowEncoderCleanup(LodePNGRowEncoder* encoder)
+{
+	unsigned type;
+	zlib_stream_cleanup(&encoder->zlib);
+	ucvector_cleanup(&encoder->chunks);
+	lodepng_free(encoder->current);
+	lodepng_free(encoder->previous);
+	lodepng_free(encoder->filtered);
+	for (type = 0; type != 5; ++type) lodepng_free(encoder->attempt[type]);
+	lodepng_free(encoder);
+}
+
+unsigned lodepng_row_encoder_begin(LodePNGRowEncoder** out, unsigned w, unsigned h, LodePNGState* state,
+	LodePNGWriteCallback callback, void* user)
+{
+	const LodePNGColorMode* color = &state->info_png.color;
+	LodePNGRowEncoder* encoder;
+	unsigned bpp, type;
+
+	*out = 0;
+	state->error = 0;
+
+	if ((color->colortype == LCT_PALETTE || state->encoder.force_palette)
+		&& (color->palettesize == 0 || color->palettesize > 256))
+	{
+		CERROR_RETURN_ERROR(state->error, 68); /*invalid palette size, it is only allowed to be 1-256*/
+	}
+	if (state->info_png.interlace_method != 0)
+	{
+		CERROR_RETURN_ERROR(state->error, 95); /*error: the row encoder does not interlace*/
+	}
+	if (w == 0 || h == 0) CERROR_RETURN_ERROR(state->error, 93);
+	state->error = checkColorValidity(color->colortype, color->bitdepth);
+	if (state->error) return state->error; /*error: unexisting color type given*/
+	state->error = checkColorValidity(state->info_raw.colortype, state->info_raw.bitdepth);
+	if (state->error) return state->error; /*error: unexisting color type given*/
+
+	encoder = (LodePNGRowEncoder*)lodepng_malloc(sizeof(LodePNGRowEncoder));
+	if (!encoder) CERROR_RETURN_ERROR(state->error, 83); /*alloc fail*/
+
+	bpp = lodepng_get_bpp(color);
+	encoder->state = state;
+	encoder->callback = callback;
+	encoder->user = user;
+	encoder->w = w;
+	encoder->h = h;
+	encoder->y = 0;
+	encoder->linebytes = ((size_t)w * bpp + 7) / 8;
+	encoder->bytewidth = (bpp + 7) / 8;
+	encoder->strategy = getFilterStrategy(color, &state->encoder);
+	encoder->current = (unsigned char*)lodepng_malloc(encoder->linebytes);
+	encoder->previous = (unsigned char*)lodepng_malloc(encoder->linebytes);
+	encoder->filtered = (unsigned char*)lodepng_malloc(encoder->linebytes + 1);
+	for (type = 0; type != 5; ++type) encoder->attempt[type] = 0;
+	ucvector_init(&encoder->chunks);
+	state->error = zlib_stream_init(&encoder->zlib, (encoder->linebytes + 1) * h, &state->encoder.zlibsettings);
+
+	if (!state->error && (!encoder->current || !encoder->previous || !encoder->filtered)) state->error = 83;
+	if (!state->error && encoder->strategy != LFS_ZERO && encoder->strategy != LFS_PREDEFINED)
+	{
+		for (type = 0; type != 5 && !state->error; ++type)
+		{
+			encoder->attempt[type] = (unsigned char*)lodepng_malloc(encoder->linebytes);
+			if (!encoder->attempt[type]) state->error = 83; /*alloc fail*/
+		}
+	}
+
+	/*everything before the image data*/
+	if (!state->error)
+	{
+		writeSignature(&encoder->chunks);
+		state->error = addChunk_IHDR(&encoder->chunks, w, h, color->colortype, color->bitdepth, 0);
+	}
+	if (!state->error && (color->colortype == LCT_PALETTE
+		|| (state->encoder.force_palette && (color->colortype == LCT_RGB || color->colortype == LCT_RGBA))))
+	{
+		state->error = addChunk_PLTE(&encoder->chunks, color);
+	}
+	if (!state->error && ((color->colortype == LCT_PALETTE && getPaletteTranslucency(color->palette, color->palettesize) != 0)
+		|| ((color->colortype == LCT_GREY || color->colortype == LCT_RGB) && color->key_defined)))
+	{
+		state->error = addChunk_tRNS(&encoder->chunks, color);
+	}
+	if (!state->error) state->error = rowEncoderWrite(encoder);
+
+	if (state->error) rowEncoderCleanup(encoder);
+	else *out = encoder;
+	return state->error;
+}
+
+unsigned lodepng_row_encoder_add(LodePNGRowEncoder* encoder, const unsigned char* row)
+{
+	LodePNGState* state = encoder->state;
+	const unsigned char* prevline = encoder->y == 0 ? 0 : encoder->previous;
+	size_t remaining = encoder->zlib.remaining;
+	unsigned char* swap;
+
+	if (state->error) return state->error;
+	if (encoder->y == encoder->h) CERROR_RETURN_ERROR(state->error, 96); /*error: more rows than the image height*/
+
+	if (lodepng_color_mode_equal(&state->info_raw, &state->info_png.color))
+	{
+		memcpy(encoder->current, row, encoder->linebytes);
+	}
+	else
+	{
+		/*bits of pixels smaller than a byte are or-ed into the row*/
+		memset(encoder->current, 0, encoder->linebytes);
+		state->error = lodepng_convert(encoder->current, row, &state->info_png.color, &state->info_raw, encoder->w, 1);
+	}
+	if (!state->error)
+	{
+		state->error = filterRow(encoder->filtered, encoder->current, prevline, encoder->linebytes, encoder->bytewidth,
+			encoder->y, encoder->strategy, &state->encoder, encoder->attempt);
+	}
+	if (!state->error) state->error = zlib_stream_add(&encoder->zlib, encoder->filtered, encoder->linebytes + 1);
+	/*an IDAT chunk is written whenever a deflate block was completed*/
+	if (!state->error && encoder->zlib.remaining != remaining) state->error = rowEncoderAddIDAT(encoder);
+	if (!state->error) state->error = rowEncoderWrite(encoder);
+
+	swap = encoder->previous;
+	encoder->previous = encoder->current;
+	encoder->current = swap;
+	++encoder->y;
+	return state->error;
+}
+
+unsigned lodepng_row_encoder_end(LodePNGRowEncoder* encoder)
+{
+	LodePNGState* state = encoder->state;
+	if (!state->error && encoder->y != encoder->h) state->error = 96; /*error: fewer rows than the image height*/
+	if (!state->error) state->error = addChunk_IEND(&encoder->chunks);
+	if (!state->error) state->error = rowEncoderWrite(encoder);
+	rowEncoderCleanup(encoder);
+	return state->error;
+}
+
 unsigned lodepng_encode_memory(unsigned char** out, size_t* outsize, const unsigned char* image,
 	unsigned w, unsigned h, LodePNGColorType colortype, unsigned bitdepth)
 {
@@ -5993,6 +7991,8 @@ const char* lodepng_error_text(unsigned code)
 	case 92: return "too many pixels, not supported";
 	case 93: return "zero width or height is invalid";
 	case 94: return "header chunk must have a size of 13 bytes";
+	case 95: return "the row encoder can not write interlaced images";
+	case 96: return "the number of rows given to the row encoder does not match the image height";
 	}
 	return "unknown error code";
 }
@@ -6011,10 +8011,18 @@ namespace lodepng
 #ifdef LODEPNG_COMPILE_DISK
 	unsigned load_file(std::vector<unsigned char>& buffer, const std::string& filename)
 	{
-		long size = lodepng_filesize(filename.c_str());
-		if (size < 0) return 78;
-		buffer.resize((size_t)size);
-		return size == 0 ? 0 : lodepng_buffer_file(&buffer[0], (size_t)size, filename.c_str());
+		unsigned error = 0;
+		FILE* file = fopen(filename.c_str(), "rb");
+		if (!file) return 78;
+		long size = lodepng_filesize(file);
+		if (size < 0) error = 78;
+		else
+		{
+			buffer.resize((size_t)size);
+			if (size != 0) error = lodepng_buffer_file(&buffer[0], (size_t)size, file);
+		}
+		fclose(file);
+		return error;
 	}
 
 	/*write given buffer to the file, overwriting the file, it doesn't append to it.*/
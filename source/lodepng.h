@@ -74,6 +74,10 @@ source files with custom allocators.*/
 #ifndef LODEPNG_NO_COMPILE_ALLOCATORS
 #define LODEPNG_COMPILE_ALLOCATORS
 #endif
+/*vectorized checksums for processors that support them, chosen at runtime. Disable to always use plain C*/
+#ifndef LODEPNG_NO_COMPILE_SIMD
+#define LODEPNG_COMPILE_SIMD
+#endif
 /*compile the C++ version (you can disable the C++ wrapper here even when compiling for C++)*/
 #ifdef __cplusplus
 #ifndef LODEPNG_NO_COMPILE_CPP
@@ -256,6 +260,9 @@ typedef struct LodePNGDecompressSettings LodePNGDecompressSettings;
 struct LodePNGDecompressSettings
 {
 	unsigned ignore_adler32; /*if 1, continue and don't give an error message if the Adler32 checksum is corrupted*/
+	/*if 1, read Huffman codes bit by bit by walking the code tree instead of with lookup tables. Much slower,
+	the same output, kept to verify the lookup tables against*/
+	unsigned bitwise_huffman;
 
 	/*use custom zlib decoder instead of built in one (default: null)*/
 	unsigned(*custom_zlib)(unsigned char**, size_t*,
@@ -276,6 +283,16 @@ void lodepng_decompress_settings_init(LodePNGDecompressSettings* settings);
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 #ifdef LODEPNG_COMPILE_ENCODER
+/*The ways LZ77 can search for earlier occurrences of the data. Default: LMF_HASH_CHAIN*/
+typedef enum LodePNGMatchFinder
+{
+	/*hash chains of 3 bytes that are followed far, and chains of zero runs. Compresses best*/
+	LMF_HASH_CHAIN,
+	/*hash chains of 4 bytes that are followed for at most windowsize / 256 links (2 to 128).
+	Several times faster, files are a little larger and minmatch is at least 4*/
+	LMF_FAST
+} LodePNGMatchFinder;
+
 /*
 Settings for zlib compression. Tweaking these settings tweaks the balance
 between speed and compression ratio.
@@ -290,6 +307,7 @@ struct LodePNGCompressSettings /*deflate = compress*/
 	unsigned minmatch; /*mininum lz77 length. 3 is normally best, 6 can be better for some PNGs. Default: 0*/
 	unsigned nicematch; /*stop searching if >= this length found. Set to 258 for best compression. Default: 128*/
 	unsigned lazymatching; /*use lazy matching: better compression but a bit slower. Default: true*/
+	LodePNGMatchFinder matchfinder; /*how LZ77 searches for matches. Default: LMF_HASH_CHAIN*/
 
 	/*use custom zlib encoder instead of built in one (default: null)*/
 	unsigned(*custom_zlib)(unsigned char**, size_t*,
@@ -301,6 +319,13 @@ struct LodePNGCompressSettings /*deflate = compress*/
 	unsigned(*custom_deflate)(unsigned char**, size_t*,
 		const unsigned char*, size_t,
 		const LodePNGCompressSettings*);
+	/*lets the built in deflate compress the blocks of large inputs at the same time (default: null)
+	It must call task(task_context, i) once for every i from 0 to count - 1, in any order and on any
+	threads, and return when all calls are done. Every block is then compressed on its own with the
+	window before it as dictionary and ends on a byte boundary, which makes the output slightly larger.
+	The output does not depend on how the calls are spread over threads.*/
+	void(*parallel_for)(void(*task)(void* task_context, size_t i), void* task_context, size_t count,
+		const LodePNGCompressSettings*);
 
 	const void* custom_context; /*optional custom settings for custom functions*/
 };
@@ -524,6 +549,10 @@ typedef struct LodePNGDecoderSettings
 
 	unsigned color_convert; /*whether to convert the PNG to the color type you want. Default: yes*/
 
+	/*decode only the first 1 to 6 of the 7 passes of Adam7 interlaced images, which give a smaller image of
+	the size of lodepng_adam7_reduced_size. 0 or 7 decodes all (default). Not used for other images*/
+	unsigned adam7_passes;
+
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
 	unsigned read_text_chunks; /*if false but remember_unknown_chunks is true, they're stored in the unknown chunks*/
 	/*store all bytes from unknown chunks in the LodePNGInfo (off by default, useful for a png editor)*/
@@ -571,7 +600,9 @@ typedef struct LodePNGColorProfile
 
 void lodepng_color_profile_init(LodePNGColorProfile* profile);
 
-/*Get a LodePNGColorProfile of the image.*/
+/*Get a LodePNGColorProfile of the image. The scan stops as soon as the image is known to need all channels
+with 8 bits and more than 256 colors, of an opaque RGBA image with 8 bits only the alpha channel is read then.
+When the color type of the output is known already, set auto_convert to false to skip the scan.*/
 unsigned lodepng_get_color_profile(LodePNGColorProfile* profile,
 	const unsigned char* image, unsigned w, unsigned h,
 	const LodePNGColorMode* mode_in);
@@ -580,6 +611,14 @@ Chooses an optimal color model, e.g. grey if only grey pixels, palette if < 256
 unsigned lodepng_auto_choose_color(LodePNGColorMode* mode_out,
 	const unsigned char* image, unsigned w, unsigned h,
 	const LodePNGColorMode* mode_in);
+/*Same as lodepng_get_color_profile and lodepng_auto_choose_color for an image whose rows start stride bytes
+apart, e.g. rows padded for alignment. The pixels of mode have to be a whole number of bytes.*/
+unsigned lodepng_get_color_profile_rows(LodePNGColorProfile* profile,
+	const unsigned char* image, unsigned w, unsigned h, size_t stride,
+	const LodePNGColorMode* mode);
+unsigned lodepng_auto_choose_color_rows(LodePNGColorMode* mode_out,
+	const unsigned char* image, unsigned w, unsigned h, size_t stride,
+	const LodePNGColorMode* mode_in);
 
 /*Settings for the encoder.*/
 typedef struct LodePNGEncoderSettings
@@ -651,6 +690,34 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
 	LodePNGState* state,
 	const unsigned char* in, size_t insize);
 
+/*
+Called by lodepng_decode_rows for every row of the image from top to bottom. The row is in the color
+mode of state->info_raw and only valid during the call. Return 0 to continue or an error code to stop.
+*/
+typedef unsigned (*LodePNGRowCallback)(void* user, unsigned y, const unsigned char* row);
+
+/*
+Same as lodepng_decode, but hands the decoded image to the callback row by row instead of returning it in
+one buffer. For images that are not interlaced the rows are decompressed, unfiltered and converted as the
+data is inflated, so only a few rows are held in memory besides the compressed data, which is read where
+it is in the IDAT chunks of the in buffer, also if there are several of them. Adam7 interlaced
+images are decoded completely first. Use lodepng_inspect to get the size before decoding. Rows with a
+fractional number of bytes are padded to a whole byte. Uses the built in zlib even if custom_zlib or
+custom_inflate is set.
+*/
+unsigned lodepng_decode_rows(unsigned* w, unsigned* h,
+	LodePNGState* state,
+	const unsigned char* in, size_t insize,
+	LodePNGRowCallback callback, void* user);
+
+/*
+Gives the size of the image that lodepng_decode returns for an Adam7 interlaced image of w * h pixels when
+state->decoder.adam7_passes is set to passes. The first passes together have every 8th, 4th or 2nd pixel of
+every 8th, 4th or 2nd row, starting at the top left pixel, the reduced image has those pixels. Inflating stops
+once the passes are complete, so with 1 or 2 passes only about 1/64 or 1/32 of the image is decompressed.
+*/
+void lodepng_adam7_reduced_size(unsigned* rw, unsigned* rh, unsigned w, unsigned h, unsigned passes);
+
 /*
 Read the PNG header, but not the actual data. This returns only the information
 that is in the header chunk of the PNG, such as width, height and color type. The
@@ -667,6 +734,33 @@ unsigned lodepng_inspect(unsigned* w, unsigned* h,
 unsigned lodepng_encode(unsigned char** out, size_t* outsize,
 	const unsigned char* image, unsigned w, unsigned h,
 	LodePNGState* state);
+
+/*
+Called by the row encoder with the next piece of the PNG file. Return 0 to continue or an error code to stop.
+*/
+typedef unsigned (*LodePNGWriteCallback)(void* user, const unsigned char* data, size_t size);
+
+typedef struct LodePNGRowEncoder LodePNGRowEncoder;
+
+/*
+Encodes a PNG one row at a time, handing the file to the callback in pieces as soon as they are compressed,
+so neither the image nor the PNG file have to be in memory as a whole. Rows are given from top to bottom in
+the color mode of state->info_raw and are stored in the color mode of state->info_png.color, auto_convert is
+not used. Interlacing, ancillary chunks and custom zlib or deflate functions are not supported. The state
+must stay valid until lodepng_row_encoder_end. On error nothing is allocated and *encoder is set to 0.
+With zlibsettings.parallel_for, rows are buffered until several deflate blocks can be compressed at once.
+*/
+unsigned lodepng_row_encoder_begin(LodePNGRowEncoder** encoder, unsigned w, unsigned h,
+	LodePNGState* state, LodePNGWriteCallback callback, void* user);
+
+/*Filters, compresses and writes the next row.*/
+unsigned lodepng_row_encoder_add(LodePNGRowEncoder* encoder, const unsigned char* row);
+
+/*
+Writes the end of the file if all h rows were given and no error happened. Always frees the encoder, so
+call it also to abort after an error.
+*/
+unsigned lodepng_row_encoder_end(LodePNGRowEncoder* encoder);
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
 /*
@@ -1564,6 +1658,7 @@ A quick reference of some settings to set on the LodePNGState
 For decoding:
 
 state.decoder.zlibsettings.ignore_adler32: ignore ADLER32 checksums
+state.decoder.zlibsettings.bitwise_huffman: decode Huffman codes with the slow tree walk, for verification
 state.decoder.zlibsettings.custom_...: use custom inflate function
 state.decoder.ignore_crc: ignore CRC checksums
 state.decoder.color_convert: convert internal PNG color to chosen one
@@ -1582,6 +1677,8 @@ state.encoder.zlibsettings.windowsize: tweak LZ77 windowsize
 state.encoder.zlibsettings.minmatch: tweak min LZ77 length to match
 state.encoder.zlibsettings.nicematch: tweak LZ77 match where to stop searching
 state.encoder.zlibsettings.lazymatching: try one more LZ77 matching
+state.encoder.zlibsettings.matchfinder: trade LZ77 compression for speed with LMF_FAST
+state.encoder.zlibsettings.parallel_for: compress the deflate blocks of large images on several threads
 state.encoder.zlibsettings.custom_...: use custom deflate function
 state.encoder.auto_convert: choose optimal PNG color type, if 0 uses info_png
 state.encoder.filter_palette_zero: PNG filter strategy for palette
@@ -0,0 +1,246 @@
+// Command line batch resizer, resizes every .png image in a directory without the Qt application.
+// Usage: resizer-cli input_directory output_directory [options], run without arguments for the list of options.
+// Needs C++17 for std::filesystem.
+#include "resizer.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// the most threads --jobs accepts
+	const long MAX_JOBS = 1024;
+
+	// settings given on the command line
+	struct Options
+	{
+		std::string inputDirectory;
+		std::string outputDirectory;
+		std::string prefix;
+		std::string suffix;
+		std::string filter = "bilinear";
+		std::string effort = "default";
+		bool usePixels = false;
+		int width = 0;
+		int height = 0;
+		float widthScale = 1.0f;
+		float heightScale = 1.0f;
+		unsigned jobs = 0;
+		size_t memory = Resizer::DEFAULT_BATCH_MEMORY;
+	};
+
+	void printUsage()
+	{
+		std::cout << "Usage: resizer-cli input_directory output_directory [options]" << std::endl;
+		std::cout << "  --size WIDTHxHEIGHT   size of the resized images in pixels" << std::endl;
+		std::cout << "  --scale PERCENT       size of the resized images in percent of the original, default 100" << std::endl;
+		std::cout << "  --filter NAME         nearest, bilinear, bicubic, mitchell, bspline, lanczos2, lanczos3 or area, default bilinear" << std::endl;
+		std::cout << "  --effort NAME         compression effort: store, fastest, fast, default, small or max, default default" << std::endl;
+		std::cout << "  --jobs N              number of threads, one image is resized per thread and threads without an image" << std::endl;
+		std::cout << "                        help the images that are left, 1 to 1024, default one per hardware thread" << std::endl;
+		std::cout << "  --memory MB           memory the images resized at the same time may take together, default 2048" << std::endl;
+		std::cout << "  --prefix TEXT         text added in front of the resized filenames" << std::endl;
+		std::cout << "  --suffix TEXT         text added after the resized filenames" << std::endl;
+	}
+
+	// Reads the command line into options, returns false if it is not valid.
+	bool parseArguments(int argc, char *argv[], Options &options)
+	{
+		std::vector<std::string> positional;
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string argument = argv[i];
+			bool hasValue = i + 1 < argc;
+			if (argument == "--size" && hasValue)
+			{
+				if (std::sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2) return false;
+				options.usePixels = true;
+			}
+			else if (argument == "--scale" && hasValue)
+			{
+				options.widthScale = options.heightScale = (float)std::atof(argv[++i]) * 0.01f;
+				options.usePixels = false;
+			}
+			else if (argument == "--filter" && hasValue)
+				options.filter = argv[++i];
+			else if (argument == "--effort" && hasValue)
+				options.effort = argv[++i];
+			else if (argument == "--jobs" && hasValue)
+			{
+				// every job is a thread, so more than MAX_JOBS is a typo rather than a machine
+				char *end = nullptr;
+				const long jobs = std::strtol(argv[++i], &end, 10);
+				if (end == argv[i] || *end != '\0' || jobs <= 0 || jobs > MAX_JOBS) return false;
+				options.jobs = (unsigned)jobs;
+			}
+			else if (argument == "--memory" && hasValue)
+			{
+				const long long megabytes = std::atoll(argv[++i]);
+				if (megabytes <= 0) return false;
+				options.memory = (size_t)megabytes * 1024 * 1024;
+			}
+			else if (argument == "--prefix" && hasValue)
+				options.prefix = argv[++i];
+			else if (argument == "--suffix" && hasValue)
+				options.suffix = argv[++i];
+			else if (argument.compare(0, 2, "--") == 0)
+				return false;
+			else
+				positional.push_back(argument);
+		}
+		if (positional.size() != 2) return false;
+		options.inputDirectory = positional[0];
+		options.outputDirectory = positional[1];
+		return true;
+	}
+
+	struct NamedFilter
+	{
+		const char *name;
+		Resizer::ResizeFilter filter;
+	};
+	const NamedFilter FILTERS[] = {
+		{ "bilinear", Resizer::BILINEAR_FILTER }, { "bicubic", Resizer::BICUBIC_FILTER }, { "mitchell", Resizer::MITCHELL_FILTER },
+		{ "bspline", Resizer::B_SPLINE_FILTER }, { "lanczos2", Resizer::LANCZOS2_FILTER }, { "lanczos3", Resizer::LANCZOS3_FILTER },
+		{ "area", Resizer::AREA_FILTER }
+	};
+
+	struct NamedEffort
+	{
+		const char *name;
+		Resizer::EncodeEffort effort;
+	};
+	const NamedEffort EFFORTS[] = {
+		{ "store", Resizer::STORE_EFFORT }, { "fastest", Resizer::FASTEST_EFFORT }, { "fast", Resizer::FAST_EFFORT },
+		{ "default", Resizer::DEFAULT_EFFORT }, { "small", Resizer::SMALL_EFFORT }, { "max", Resizer::MAX_EFFORT }
+	};
+
+	// Finds the encode options named in the options, returns false if there is no effort level with that name.
+	bool encodeOptions(const Options &options, Resizer::EncodeOptions &encodeOptions)
+	{
+		for (const NamedEffort &named : EFFORTS)
+		{
+			if (options.effort != named.name) continue;
+			encodeOptions.effort = named.effort;
+			return true;
+		}
+		return false;
+	}
+
+	// Resizes a image with the filter and size choosen in the options and saves it. Every filter except nearest
+	// resizes the image while it is decoded, so the whole original is never in memory.
+	// It returns true if the resized image was saved.
+	bool resizeFile(const std::string &filename, const std::string &outFilename, const Options &options)
+	{
+		Resizer::EncodeOptions encode;
+		encodeOptions(options, encode);
+		for (const NamedFilter &named : FILTERS)
+		{
+			if (options.filter != named.name) continue;
+			if (options.usePixels) return Resizer::resizeImageFile(filename.c_str(), outFilename.c_str(), options.width, options.height, named.filter, encode);
+			return Resizer::resizeImageFile(filename.c_str(), outFilename.c_str(), options.widthScale, options.heightScale, named.filter, encode);
+		}
+		std::unique_ptr<Resizer::Image> original = Resizer::readImageFromFile(filename.c_str());
+		if (!original) return false;
+		int width = options.usePixels ? options.width : (int)(original->width * options.widthScale);
+		int height = options.usePixels ? options.height : (int)(original->height * options.heightScale);
+		std::unique_ptr<Resizer::Image> scaled = Resizer::nearestNeighbourInterpolation(original.get(), width, height);
+		return scaled && Resizer::saveImageToFile(outFilename.c_str(), scaled.get(), encode);
+	}
+
+	// Estimates the work and the memory of resizing the image of a job with the filter and size choosen in the options.
+	void estimateJob(Resizer::BatchJob &job, const Options &options)
+	{
+		int width = options.usePixels ? options.width : (int)(job.header.width * options.widthScale);
+		int height = options.usePixels ? options.height : (int)(job.header.height * options.heightScale);
+		for (const NamedFilter &named : FILTERS)
+		{
+			if (options.filter != named.name) continue;
+			Resizer::estimateResize(job, width, height, named.filter);
+			return;
+		}
+		Resizer::estimateNearestResize(job, width, height);
+	}
+
+	bool isValidFilter(const std::string &filter)
+	{
+		if (filter == "nearest") return true;
+		for (const NamedFilter &named : FILTERS)
+			if (filter == named.name) return true;
+		return false;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	Options options;
+	Resizer::EncodeOptions encode;
+	if (!parseArguments(argc, argv, options) || !isValidFilter(options.filter) || !encodeOptions(options, encode))
+	{
+		printUsage();
+		return 2;
+	}
+
+	std::error_code error;
+	if (!std::filesystem::is_directory(options.inputDirectory, error) || !std::filesystem::is_directory(options.outputDirectory, error))
+	{
+		std::cout << "Error: input and output directories have to exist" << std::endl;
+		return 2;
+	}
+
+	// make sure the original images will not be overwritten
+	if (std::filesystem::equivalent(options.inputDirectory, options.outputDirectory, error) && options.prefix.empty() && options.suffix.empty())
+	{
+		std::cout << "Error: change output directory or add a prefix/suffix to avoid overwriting original images" << std::endl;
+		return 2;
+	}
+
+	std::vector<std::filesystem::path> files;
+	for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(options.inputDirectory, error))
+		if (entry.is_regular_file() && entry.path().extension() == ".png")
+			files.push_back(entry.path());
+
+	unsigned jobs = (options.jobs > 0) ? options.jobs : std::thread::hardware_concurrency();
+	jobs = (jobs > 0) ? jobs : 1;
+
+	// the estimates of the memory depend on the thread count, so it is set before the batch is planned
+	Resizer::setThreadCount(jobs);
+
+	// the headers tell how much work and memory every image takes, the images with the most work are started first
+	std::vector<std::string> filenames;
+	for (const std::filesystem::path &file : files)
+		filenames.push_back(file.string());
+	const std::vector<Resizer::BatchJob> plan = Resizer::planBatch(filenames, jobs, [&options](Resizer::BatchJob &job) { estimateJob(job, options); });
+
+	std::atomic<unsigned> failed(0);
+	Resizer::BatchScheduler scheduler(plan, options.memory);
+	// every worker takes the next image that fits in the memory budget as soon as it is done with the last one,
+	// the workers run on the shared threads so the threads that run out of images help with the last ones
+	Resizer::parallelFor(jobs, [&options, &failed, &scheduler, &files](unsigned begin, unsigned end)
+	{
+		for (unsigned worker = begin; worker < end; ++worker)
+		{
+			Resizer::BatchJob job;
+			while (scheduler.next(job))
+			{
+				const std::filesystem::path &file = files[job.index];
+				std::filesystem::path outFilePath = std::filesystem::path(options.outputDirectory) / (options.prefix + file.stem().string() + options.suffix + ".png");
+				if (!resizeFile(file.string(), outFilePath.string(), options))
+				{
+					std::cout << "Error: could not resize " << file.string() << std::endl;
+					++failed;
+				}
+				scheduler.finish(job);
+			}
+		}
+	});
+
+	std::cout << files.size() - failed << " of " << files.size() << " images resized" << std::endl;
+	return (failed > 0) ? 1 : 0;
+}
@@ -0,0 +1,508 @@
+#include "resample.h"
+#include "thread_pool.h"
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	const float PI = 3.14159265358979f;
+
+	// Normalized sinc function, sin(pi x) / (pi x).
+	inline float sinc(const float x)
+	{
+		if (x == 0.0f) return 1.0f;
+		return std::sin(PI * x) / (PI * x);
+	}
+
+	// Clamps a fixed-point accumulator back to the 0-255 range of a color channel.
+	inline unsigned char toByte(const int value)
+	{
+		int v = value >> Resizer::WEIGHT_PRECISION_BITS;
+		return (unsigned char)((v < 0) ? 0 : ((v > 255) ? 255 : v));
+	}
+
+	// Stores the weights of one destination pixel in a table as fixed-point values normalized by total.
+	// All entries have the same number of taps, so windows at the end of the axis are shifted back
+	// to stay inside the image and padded with zero weights in front.
+	void storeWeights(Resizer::WeightTable &table, const unsigned index, const int windowStart, const int windowSize, const float *weights, const float total, const unsigned sourceSize)
+	{
+		const int one = 1 << Resizer::WEIGHT_PRECISION_BITS;
+		const int taps = table.taps;
+		int first = windowStart;
+		int offset = 0;
+		if (first + taps > (int)sourceSize)
+		{
+			offset = first + taps - (int)sourceSize;
+			first = (int)sourceSize - taps;
+		}
+		table.first[index] = first;
+
+		// give any rounding error to the largest weight so that every row sums to exactly one
+		short *row = &table.weights[index * taps + offset];
+		int sum = 0, largest = 0;
+		for (int t = 0; t < windowSize; ++t)
+		{
+			row[t] = (short)std::lround(weights[t] / total * one);
+			sum += row[t];
+			largest = (row[t] > row[largest]) ? t : largest;
+		}
+		row[largest] += (short)(one - sum);
+	}
+
+	// Filters one row along the x axis, TAPS is the number of taps known at compile time or 0 to use table.taps.
+	template <int TAPS>
+	void horizontalRow(const unsigned char *sourceRow, unsigned char *destinationRow, const unsigned width, const Resizer::WeightTable &table)
+	{
+		const int taps = (TAPS > 0) ? TAPS : table.taps;
+		const int half = 1 << (Resizer::WEIGHT_PRECISION_BITS - 1);
+		for (unsigned x = 0; x < width; ++x)
+		{
+			const unsigned char *pixel = sourceRow + table.first[x] * Resizer::NUMBER_OF_CHANNELS;
+			const short *weight = &table.weights[x * taps];
+			int r = half, g = half, b = half, a = half;
+			for (int t = 0; t < taps; ++t)
+			{
+				r += weight[t] * pixel[0];
+				g += weight[t] * pixel[1];
+				b += weight[t] * pixel[2];
+				a += weight[t] * pixel[3];
+				pixel += Resizer::NUMBER_OF_CHANNELS;
+			}
+			destinationRow[0] = toByte(r);
+			destinationRow[1] = toByte(g);
+			destinationRow[2] = toByte(b);
+			destinationRow[3] = toByte(a);
+			destinationRow += Resizer::NUMBER_OF_CHANNELS;
+		}
+	}
+
+	// Sums blocks of source pixels into one destination row at a time and stores the rounded averages.
+	// Only the destination rows begin .. end - 1 are computed. FACTOR_X is the horizontal block size known at compile time or 0 to use factorX.
+	template <typename Accumulator, int FACTOR_X>
+	void areaDownscaleRows(const Resizer::Image *source, Resizer::Image *destination, const unsigned factorX, const unsigned factorY, const unsigned begin, const unsigned end)
+	{
+		const unsigned blockWidth = (FACTOR_X > 0) ? FACTOR_X : factorX;
+		const unsigned count = blockWidth * factorY;
+		const unsigned long long reciprocal = ((1ULL << 32) + count - 1) / count;
+		const unsigned rowSize = destination->width * Resizer::NUMBER_OF_CHANNELS;
+		std::vector<Accumulator> sum(rowSize);
+		const unsigned char *sourceRow = source->row(begin * factorY);
+		for (unsigned y = begin; y < end; ++y)
+		{
+			unsigned char *destinationRow = destination->row(y);
+			sum.assign(rowSize, 0);
+			for (unsigned r = 0; r < factorY; ++r)
+			{
+				const unsigned char *pixel = sourceRow;
+				for (unsigned k = 0; k < rowSize; k += Resizer::NUMBER_OF_CHANNELS)
+				{
+					for (unsigned b = 0; b < blockWidth; ++b)
+					{
+						sum[k + 0] += pixel[0];
+						sum[k + 1] += pixel[1];
+						sum[k + 2] += pixel[2];
+						sum[k + 3] += pixel[3];
+						pixel += Resizer::NUMBER_OF_CHANNELS;
+					}
+				}
+				sourceRow += source->stride;
+			}
+			// 16 bit sums are small enough to divide exactly by multiplying with a 32 bit reciprocal
+			if (sizeof(Accumulator) == 2)
+			{
+				for (unsigned k = 0; k < rowSize; ++k)
+					destinationRow[k] = (unsigned char)(((sum[k] + count / 2) * reciprocal) >> 32);
+			}
+			else
+			{
+				for (unsigned k = 0; k < rowSize; ++k)
+					destinationRow[k] = (unsigned char)((sum[k] + count / 2) / count);
+			}
+		}
+	}
+}
+
+// Tent shaped kernel used for bilinear interpolation, it takes no parameters.
+float Resizer::triangleKernel(float x, const float *)
+{
+	x = std::fabs(x);
+	return (x < 1.0f) ? 1.0f - x : 0.0f;
+}
+
+// Mitchell-Netravali family of cubic kernels with a support of two pixels.
+// The parameters are B and C, for example (0, 0.5) gives Catmull-Rom and (1, 0) a cubic B-spline.
+float Resizer::cubicKernel(float x, const float *parameters)
+{
+	const float b = parameters[0];
+	const float c = parameters[1];
+	x = std::fabs(x);
+	if (x < 1.0f)
+		return ((12.0f - 9.0f * b - 6.0f * c) * x * x * x + (-18.0f + 12.0f * b + 6.0f * c) * x * x + (6.0f - 2.0f * b)) / 6.0f;
+	if (x < 2.0f)
+		return ((-b - 6.0f * c) * x * x * x + (6.0f * b + 30.0f * c) * x * x + (-12.0f * b - 48.0f * c) * x + (8.0f * b + 24.0f * c)) / 6.0f;
+	return 0.0f;
+}
+
+// Lanczos kernel, a sinc windowed by a wider sinc. The parameter is the radius in lobes.
+float Resizer::lanczosKernel(float x, const float *parameters)
+{
+	const float radius = parameters[0];
+	return (std::fabs(x) < radius) ? sinc(x) * sinc(x / radius) : 0.0f;
+}
+
+// Sinc windowed by a Hann window. The parameter is the radius in lobes.
+float Resizer::hannKernel(float x, const float *parameters)
+{
+	const float radius = parameters[0];
+	return (std::fabs(x) < radius) ? sinc(x) * (0.5f + 0.5f * std::cos(PI * x / radius)) : 0.0f;
+}
+
+// Sinc windowed by a Hamming window. The parameter is the radius in lobes.
+float Resizer::hammingKernel(float x, const float *parameters)
+{
+	const float radius = parameters[0];
+	return (std::fabs(x) < radius) ? sinc(x) * (0.54f + 0.46f * std::cos(PI * x / radius)) : 0.0f;
+}
+
+// Sinc windowed by a Blackman window. The parameter is the radius in lobes.
+float Resizer::blackmanKernel(float x, const float *parameters)
+{
+	const float radius = parameters[0];
+	return (std::fabs(x) < radius) ? sinc(x) * (0.42f + 0.5f * std::cos(PI * x / radius) + 0.08f * std::cos(2.0f * PI * x / radius)) : 0.0f;
+}
+
+// Computes the source pixels and weights that contribute to every destination pixel along one axis.
+// Pixel centers are aligned so that the first and last pixels of both images cover the same area.
+// When downscaling the kernel is stretched by the scale factor so that it also acts as a low-pass filter,
+// every source pixel is then still only read by a bounded number of destination pixels.
+// Takes the number of source and destination pixels along the axis and the filter to use.
+Resizer::WeightTable Resizer::computeWeightTable(const unsigned sourceSize, const unsigned destinationSize, const Resizer::Filter &filter)
+{
+	const double scale = sourceSize / (double)destinationSize;
+	const double filterScale = (scale > 1.0) ? scale : 1.0;
+	const double support = filter.support * filterScale;
+	// find the window of source pixels covered by every destination pixel
+	std::vector<int> windowStart(destinationSize), windowSize(destinationSize);
+	int taps = 1;
+	for (unsigned i = 0; i < destinationSize; ++i)
+	{
+		double center = (i + 0.5) * scale;
+		int start = (int)std::floor(center - support + 0.5);
+		int end = (int)std::floor(center + support + 0.5);
+		start = (start > 0) ? start : 0;
+		end = (end < (int)sourceSize) ? end : (int)sourceSize;
+		if (end <= start)
+		{
+			// the kernel does not reach any pixel center, fall back to the nearest pixel
+			start = (int)center;
+			start = (start < (int)sourceSize) ? start : (int)sourceSize - 1;
+			end = start + 1;
+		}
+		windowStart[i] = start;
+		windowSize[i] = end - start;
+		taps = (windowSize[i] > taps) ? windowSize[i] : taps;
+	}
+
+	Resizer::WeightTable table;
+	table.taps = taps;
+	table.first.resize(destinationSize);
+	table.weights.assign(destinationSize * taps, 0);
+
+	std::vector<float> weights(taps);
+	for (unsigned i = 0; i < destinationSize; ++i)
+	{
+		double center = (i + 0.5) * scale;
+
+		// evaluate and normalize the kernel over the window
+		float total = 0.0f;
+		for (int t = 0; t < windowSize[i]; ++t)
+		{
+			weights[t] = filter.kernel((float)((windowStart[i] + t + 0.5 - center) / filterScale), filter.parameters);
+			total += weights[t];
+		}
+		if (total == 0.0f)
+		{
+			weights.assign(taps, 0.0f);
+			weights[windowSize[i] / 2] = total = 1.0f;
+		}
+
+		storeWeights(table, i, windowStart[i], windowSize[i], &weights[0], total, sourceSize);
+	}
+	return table;
+}
+
+// Computes the weight table of a box filter that averages exactly the area of the source covered by every
+// destination pixel. Source pixels that are only partially covered are weighted by the covered fraction.
+// Takes the number of source and destination pixels along the axis.
+Resizer::WeightTable Resizer::computeAreaWeightTable(const unsigned sourceSize, const unsigned destinationSize)
+{
+	const double scale = sourceSize / (double)destinationSize;
+
+	std::vector<int> windowStart(destinationSize), windowSize(destinationSize);
+	int taps = 1;
+	for (unsigned i = 0; i < destinationSize; ++i)
+	{
+		int start = (int)std::floor(i * scale);
+		int end = (int)std::ceil((i + 1) * scale - 1e-9);
+		end = (end < (int)sourceSize) ? end : (int)sourceSize;
+		start = (start < end) ? start : end - 1;
+		windowStart[i] = start;
+		windowSize[i] = end - start;
+		taps = (windowSize[i] > taps) ? windowSize[i] : taps;
+	}
+
+	Resizer::WeightTable table;
+	table.taps = taps;
+	table.first.resize(destinationSize);
+	table.weights.assign(destinationSize * taps, 0);
+
+	std::vector<float> weights(taps);
+	for (unsigned i = 0; i < destinationSize; ++i)
+	{
+		const double left = i * scale;
+		const double right = (i + 1) * scale;
+		float total = 0.0f;
+		for (int t = 0; t < windowSize[i]; ++t)
+		{
+			const double pixelLeft = windowStart[i] + t;
+			const double pixelRight = pixelLeft + 1.0;
+			weights[t] = (float)(((right < pixelRight) ? right : pixelRight) - ((left > pixelLeft) ? left : pixelLeft));
+			weights[t] = (weights[t] > 0.0f) ? weights[t] : 0.0f;
+			total += weights[t];
+		}
+		storeWeights(table, i, windowStart[i], windowSize[i], &weights[0], total, sourceSize);
+	}
+	return table;
+}
+
+// Filters one row along the x axis with the reference scalar code.
+// Takes the source row, the destination row, the number of destination pixels and the horizontal weight table.
+void Resizer::horizontalRowScalar(const unsigned char *sourceRow, unsigned char *destinationRow, const unsigned width, const Resizer::WeightTable &table)
+{
+	// the common tap counts get their own instantiation so that the inner loop is fully unrolled
+	switch (table.taps)
+	{
+	case 2: horizontalRow<2>(sourceRow, destinationRow, width, table); break;
+	case 4: horizontalRow<4>(sourceRow, destinationRow, width, table); break;
+	case 6: horizontalRow<6>(sourceRow, destinationRow, width, table); break;
+	default: horizontalRow<0>(sourceRow, destinationRow, width, table); break;
+	}
+}
+
+// Computes one destination row as the weighted sum of taps source rows with the reference scalar code.
+// Takes the first source row, the distance in bytes between source rows, the weights of the destination row,
+// the number of taps, the destination row and the number of bytes in a row.
+void Resizer::verticalRowScalar(const unsigned char *source, const unsigned stride, const short *weights, const int taps, unsigned char *destinationRow, const unsigned rowSize)
+{
+	const int half = 1 << (Resizer::WEIGHT_PRECISION_BITS - 1);
+
+	// the row is processed in chunks so that the accumulators stay in the cache while all taps are added
+	const unsigned CHUNK_SIZE = 256;
+	int accumulator[CHUNK_SIZE];
+	for (unsigned k = 0; k < rowSize; k += CHUNK_SIZE)
+	{
+		const unsigned count = (rowSize - k < CHUNK_SIZE) ? rowSize - k : CHUNK_SIZE;
+		for (unsigned i = 0; i < count; ++i)
+			accumulator[i] = half;
+		for (int t = 0; t < taps; ++t)
+		{
+			const int weight = weights[t];
+			if (weight == 0) continue;
+			const unsigned char *sourceRow = source + t * stride + k;
+			for (unsigned i = 0; i < count; ++i)
+				accumulator[i] += weight * sourceRow[i];
+		}
+		for (unsigned i = 0; i < count; ++i)
+			destinationRow[k + i] = toByte(accumulator[i]);
+	}
+}
+
+// Computes one destination row of a bilinear enlargement from two neighbouring source rows with the reference scalar code.
+// Takes the upper and lower source row, the weight of the lower row in 1/256, the destination row,
+// the number of destination pixels, the 32.32 fixed-point distance between samples and the number of source pixels.
+void Resizer::bilinearRowScalar(const unsigned char *top, const unsigned char *bottom, const unsigned fractionY, unsigned char *destinationRow, const unsigned width, const long long stepX, const unsigned sourceWidth)
+{
+	const long long maxX = (long long)(sourceWidth - 1) << 32;
+	long long positionX = stepX / 2 - (1LL << 31);
+	for (unsigned j = 0; j < width; ++j, positionX += stepX)
+	{
+		unsigned column, fractionX;
+		bilinearColumn(positionX, maxX, sourceWidth, column, fractionX);
+		const unsigned left = column * Resizer::NUMBER_OF_CHANNELS;
+		const unsigned right = left + Resizer::NUMBER_OF_CHANNELS;
+		for (unsigned k = 0; k < Resizer::NUMBER_OF_CHANNELS; ++k)
+		{
+			const unsigned upper = top[left + k] * (256 - fractionX) + top[right + k] * fractionX;
+			const unsigned lower = bottom[left + k] * (256 - fractionX) + bottom[right + k] * fractionX;
+			destinationRow[k] = (unsigned char)((upper * (256 - fractionY) + lower * fractionY + 0x8000) >> 16);
+		}
+		destinationRow += Resizer::NUMBER_OF_CHANNELS;
+	}
+}
+
+// Resamples every row of a image along the x axis.
+// The destination must have the same height as the source and as many columns as the table has entries.
+// Rows are split into bands that are processed by the shared thread pool.
+void Resizer::horizontalPass(const Resizer::Image *source, Resizer::Image *destination, const Resizer::WeightTable &table)
+{
+	const Resizer::RowKernels &kernels = Resizer::rowKernels();
+	Resizer::parallelFor(destination->height, [&](unsigned begin, unsigned end)
+	{
+		for (unsigned y = begin; y < end; ++y)
+		{
+			kernels.horizontal(source->row(y), destination->row(y), destination->width, table);
+		}
+	});
+}
+
+// Resamples every column of a image along the y axis.
+// The destination must have the same width as the source and as many rows as the table has entries.
+// Whole source rows are accumulated at a time so that memory is read sequentially.
+// Rows are split into bands that are processed by the shared thread pool.
+void Resizer::verticalPass(const Resizer::Image *source, Resizer::Image *destination, const Resizer::WeightTable &table)
+{
+	const Resizer::RowKernels &kernels = Resizer::rowKernels();
+	const int taps = table.taps;
+	// both images have the same width and so the same stride, whole strides are filtered since the row padding
+	// is zero and filters to zero, which lets the kernels work on full vectors without a scalar tail
+	const unsigned stride = source->stride;
+	Resizer::parallelFor(destination->height, [&](unsigned begin, unsigned end)
+	{
+		for (unsigned y = begin; y < end; ++y)
+		{
+			kernels.vertical(source->row(table.first[y]), stride, &table.weights[y * taps], taps, destination->row(y), stride);
+		}
+	});
+}
+
+// Sets up a resampler that writes into destination, which must have the size given by the weight tables.
+Resizer::RowResampler::RowResampler(Resizer::Image *destination, const Resizer::WeightTable &horizontal, const Resizer::WeightTable &vertical)
+	: destination(destination), horizontal(horizontal), vertical(vertical), width(destination->width), height(destination->height),
+	window(width, 2 * vertical.taps), rowsAdded(0), nextRow(0)
+{
+}
+
+// Sets up a resampler that hands every destination row to the sink, the size of the result is given by the weight tables.
+Resizer::RowResampler::RowResampler(const RowSink &sink, const Resizer::WeightTable &horizontal, const Resizer::WeightTable &vertical)
+	: destination(nullptr), sink(sink), horizontal(horizontal), vertical(vertical), width((unsigned)horizontal.first.size()),
+	height((unsigned)vertical.first.size()), output(width, 1), window(width, 2 * vertical.taps), rowsAdded(0), nextRow(0)
+{
+}
+
+// Takes the next source row, which has to be as wide as the horizontal weight table expects.
+// It then writes every destination row that no longer needs any later source rows.
+void Resizer::RowResampler::addRow(const unsigned char *sourceRow)
+{
+	const Resizer::RowKernels &kernels = Resizer::rowKernels();
+	const unsigned taps = vertical.taps;
+	unsigned char *filtered = window.row(rowsAdded % taps);
+	kernels.horizontal(sourceRow, filtered, width, horizontal);
+	std::memcpy(window.row(rowsAdded % taps + taps), filtered, window.stride);
+	++rowsAdded;
+
+	// the window of a destination row is complete when its last row arrived, it then starts at the slot of its first row
+	while (nextRow < height && vertical.first[nextRow] + taps <= rowsAdded)
+	{
+		unsigned char *row = destination ? destination->row(nextRow) : output.data;
+		kernels.vertical(window.row(vertical.first[nextRow] % taps), window.stride, &vertical.weights[nextRow * taps], taps, row, window.stride);
+		if (!destination) sink(nextRow, row);
+		++nextRow;
+	}
+}
+
+// Creates a resized copy of a image by filtering first along one axis and then along the other.
+// Takes a original image, the wanted pixel size of the resized image and the filter to use.
+// It then returns a pointer to the resized image or nullptr if something went wrong.
+std::unique_ptr<Resizer::Image> Resizer::resample(const Resizer::Image *image, const int width, const int height, const Resizer::Filter &filter)
+{
+	if (image == nullptr || !Resizer::isValidSize(width, height)) return nullptr;
+	Resizer::WeightTable horizontal = Resizer::computeWeightTable(image->width, width, filter);
+	Resizer::WeightTable vertical = Resizer::computeWeightTable(image->height, height, filter);
+	return Resizer::resample(image, horizontal, vertical);
+}
+
+// Creates a resized copy of a image from precomputed weight tables, the size of the resized image is given by the tables.
+// The order of the two passes is chosen so that the least number of taps has to be evaluated.
+// It then returns a pointer to the resized image.
+std::unique_ptr<Resizer::Image> Resizer::resample(const Resizer::Image *image, const Resizer::WeightTable &horizontal, const Resizer::WeightTable &vertical)
+{
+	const unsigned width = (unsigned)horizontal.first.size();
+	const unsigned height = (unsigned)vertical.first.size();
+	double horizontalFirstCost = (double)image->height * width * horizontal.taps + (double)height * width * vertical.taps;
+	double verticalFirstCost = (double)height * image->width * vertical.taps + (double)height * width * horizontal.taps;
+
+	std::unique_ptr<Resizer::Image> scaledImage = Resizer::createImage(width, height);
+	if (horizontalFirstCost <= verticalFirstCost)
+	{
+		std::unique_ptr<Resizer::Image> intermediate = Resizer::createImage(width, image->height);
+		Resizer::horizontalPass(image, intermediate.get(), horizontal);
+		Resizer::verticalPass(intermediate.get(), scaledImage.get(), vertical);
+	}
+	else
+	{
+		std::unique_ptr<Resizer::Image> intermediate = Resizer::createImage(image->width, height);
+		Resizer::verticalPass(image, intermediate.get(), vertical);
+		Resizer::horizontalPass(intermediate.get(), scaledImage.get(), horizontal);
+	}
+	return scaledImage;
+}
+
+// Creates a downscaled copy of a image where every destination pixel is the average of a block of
+// factorX by factorY source pixels. Every source row is read exactly once and summed into a row of
+// accumulators that are 16 bits wide whenever the block is small enough for the sum to fit.
+// The image size must be divisible by the factors.
+// It then returns a pointer to the downscaled image.
+std::unique_ptr<Resizer::Image> Resizer::areaDownscale(const Resizer::Image *image, const unsigned factorX, const unsigned factorY)
+{
+	const unsigned width = image->width / factorX;
+	const unsigned height = image->height / factorY;
+	std::unique_ptr<Resizer::Image> scaledImage = Resizer::createImage(width, height);
+	Resizer::parallelFor(height, [&](unsigned begin, unsigned end)
+	{
+		if (factorX * factorY * 255 <= 0xffff)
+		{
+			if (factorX == 2) areaDownscaleRows<unsigned short, 2>(image, scaledImage.get(), factorX, factorY, begin, end);
+			else if (factorX == 4) areaDownscaleRows<unsigned short, 4>(image, scaledImage.get(), factorX, factorY, begin, end);
+			else areaDownscaleRows<unsigned short, 0>(image, scaledImage.get(), factorX, factorY, begin, end);
+		}
+		else
+			areaDownscaleRows<unsigned, 0>(image, scaledImage.get(), factorX, factorY, begin, end);
+	});
+	return scaledImage;
+}
+
+// Creates a enlarged copy of a image using bilinear interpolation in a single pass with integer arithmetic.
+// Source positions are stepped in 32.32 fixed-point along each row and column, so no division is done per pixel,
+// and the four neighbours are blended with fractions of 1/256 and rounded once at the end.
+// Only meant for enlarging images that are at least 2x2 pixels, when shrinking the filtered path in resample is
+// needed to avoid aliasing.
+// It then returns a pointer to the resized image.
+std::unique_ptr<Resizer::Image> Resizer::bilinearUpscale(const Resizer::Image *image, const int width, const int height)
+{
+	const Resizer::RowKernels &kernels = Resizer::rowKernels();
+	const long long stepX = ((long long)image->width << 32) / width;
+	const long long stepY = ((long long)image->height << 32) / height;
+	const long long maxY = (long long)(image->height - 1) << 32;
+
+	std::unique_ptr<Resizer::Image> scaledImage = Resizer::createImage(width, height);
+	Resizer::parallelFor(height, [&](unsigned begin, unsigned end)
+	{
+		// pixel centers are aligned, so the first sample is half a step minus half a pixel into the image
+		long long positionY = stepY / 2 - (1LL << 31) + begin * stepY;
+		for (unsigned i = begin; i < end; ++i, positionY += stepY)
+		{
+			const long long y = (positionY < 0) ? 0 : ((positionY > maxY) ? maxY : positionY);
+			unsigned row = (unsigned)(y >> 32);
+			unsigned fractionY = (unsigned)(y >> 24) & 0xff;
+
+			// the last row is blended as the second row of the pair above it, so both rows always exist
+			if (row + 1 == image->height)
+			{
+				row -= 1;
+				fractionY = 256;
+			}
+			kernels.bilinear(image->row(row), image->row(row + 1), fractionY, scaledImage->row(i), width, stepX, image->width);
+		}
+	});
+	return scaledImage;
+}
@@ -1,33 +1,676 @@
 #include "resizer.h"
 #include "lodepng.h"
+#include "resample.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <vector>
+#if !defined(_MSC_VER)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// Allocates memory that starts on a ROW_ALIGNMENT byte boundary.
+	unsigned char *allocateAligned(const size_t size)
+	{
+#if defined(_MSC_VER)
+		return (unsigned char *)_aligned_malloc(size, Resizer::ROW_ALIGNMENT);
+#else
+		void *memory = nullptr;
+		return (posix_memalign(&memory, Resizer::ROW_ALIGNMENT, size) == 0) ? (unsigned char *)memory : nullptr;
+#endif
+	}
+
+	void freeAligned(unsigned char *memory)
+	{
+#if defined(_MSC_VER)
+		_aligned_free(memory);
+#else
+		std::free(memory);
+#endif
+	}
+
+	// Copies the packed rows decoded by lodepng into a image with aligned rows.
+	std::unique_ptr<Resizer::Image> copyPixels(const unsigned char *pixels, const unsigned width, const unsigned height)
+	{
+		std::unique_ptr<Resizer::Image> image = Resizer::createImage(width, height);
+		const unsigned rowSize = width * Resizer::NUMBER_OF_CHANNELS;
+		for (unsigned y = 0; y < height; ++y)
+			std::memcpy(image->row(y), pixels + (size_t)y * rowSize, rowSize);
+		return image;
+	}
+
+	// Builds the filter that the resize function matching a ResizeFilter uses.
+	Resizer::Filter resizeFilter(const Resizer::ResizeFilter filter)
+	{
+		switch (filter)
+		{
+		case Resizer::BICUBIC_FILTER: return { Resizer::cubicKernel, 2.0f, { Resizer::CATMULL_ROM.b, Resizer::CATMULL_ROM.c } };
+		case Resizer::MITCHELL_FILTER: return { Resizer::cubicKernel, 2.0f, { Resizer::MITCHELL_NETRAVALI.b, Resizer::MITCHELL_NETRAVALI.c } };
+		case Resizer::B_SPLINE_FILTER: return { Resizer::cubicKernel, 2.0f, { Resizer::B_SPLINE.b, Resizer::B_SPLINE.c } };
+		case Resizer::LANCZOS2_FILTER: return { Resizer::lanczosKernel, 2.0f, { 2.0f, 0.0f } };
+		case Resizer::LANCZOS3_FILTER: return { Resizer::lanczosKernel, 3.0f, { 3.0f, 0.0f } };
+		default: return { Resizer::triangleKernel, 1.0f, { 0.0f, 0.0f } };
+		}
+	}
+
+	// Resizes a image that is already in memory with the resize function matching a ResizeFilter.
+	std::unique_ptr<Resizer::Image> resizeWithFilter(const Resizer::Image *image, const int width, const int height, const Resizer::ResizeFilter filter)
+	{
+		switch (filter)
+		{
+		case Resizer::BICUBIC_FILTER: return Resizer::bicubicInterpolation(image, width, height, Resizer::CATMULL_ROM);
+		case Resizer::MITCHELL_FILTER: return Resizer::bicubicInterpolation(image, width, height, Resizer::MITCHELL_NETRAVALI);
+		case Resizer::B_SPLINE_FILTER: return Resizer::bicubicInterpolation(image, width, height, Resizer::B_SPLINE);
+		case Resizer::LANCZOS2_FILTER: return Resizer::lanczosInterpolation(image, width, height, 2);
+		case Resizer::LANCZOS3_FILTER: return Resizer::lanczosInterpolation(image, width, height, 3);
+		case Resizer::AREA_FILTER: return Resizer::areaResize(image, width, height);
+		default: return Resizer::bilinearInterpolation(image, width, height);
+		}
+	}
+
+	// A .png file that was read into memory and whose header was inspected, the decoder is set up to give RGBA rows.
+	// Where possible the file is mapped instead of read, so it is decoded straight from the page cache.
+	struct PngFile
+	{
+		PngFile(const char *filename) : buffer(nullptr), size(0), mapped(false), width(0), height(0)
+		{
+			lodepng_state_init(&state);
+			state.info_raw.colortype = LCT_RGBA;
+			state.info_raw.bitdepth = 8;
+			error = map(filename) ? 0 : lodepng_load_file(&buffer, &size, filename);
+			if (!error) error = lodepng_inspect(&width, &height, &state, buffer, size);
+		}
+		~PngFile()
+		{
+			lodepng_state_cleanup(&state);
+#if !defined(_MSC_VER)
+			if (mapped)
+			{
+				munmap(buffer, size);
+				return;
+			}
+#endif
+			free(buffer);
+		}
+		PngFile(const PngFile &) = delete;
+		PngFile &operator=(const PngFile &) = delete;
+
+		// Maps a whole regular file for reading from start to end. It returns false if the file can't be mapped,
+		// then it is read into memory instead, which also reports why it can't be opened.
+		bool map(const char *filename)
+		{
+#if !defined(_MSC_VER)
+			int descriptor = open(filename, O_RDONLY);
+			if (descriptor < 0) return false;
+			struct stat status;
+			void *mapping = MAP_FAILED;
+			if (fstat(descriptor, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0)
+				mapping = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+			close(descriptor);
+			if (mapping == MAP_FAILED) return false;
+			madvise(mapping, (size_t)status.st_size, MADV_SEQUENTIAL);
+			buffer = static_cast<unsigned char *>(mapping);
+			size = (size_t)status.st_size;
+			mapped = true;
+			return true;
+#else
+			(void)filename;
+			return false;
+#endif
+		}
+
+		unsigned char *buffer;
+		size_t size;
+		bool mapped;
+		LodePNGState state;
+		unsigned width, height;
+		unsigned error;
+	};
+
+	// Checks if the decoded pixels of a file can be transparent. Only the header has been read, so the chunks
+	// before the image data are searched for a tRNS chunk.
+	bool canHaveAlpha(const PngFile &file)
+	{
+		if (lodepng_is_alpha_type(&file.state.info_png.color)) return true;
+		const unsigned char *end = file.buffer + file.size;
+		for (const unsigned char *chunk = file.buffer + 8; end - chunk >= 12 && lodepng_chunk_length(chunk) <= (size_t)(end - chunk) - 12; chunk = lodepng_chunk_next_const(chunk))
+		{
+			if (lodepng_chunk_type_equals(chunk, "IDAT")) return false;
+			if (lodepng_chunk_type_equals(chunk, "tRNS")) return true;
+		}
+		return true;
+	}
+
+	unsigned writeToFile(void *user, const unsigned char *data, size_t size)
+	{
+		return (std::fwrite(data, 1, size, static_cast<std::FILE *>(user)) == size) ? 0 : 79;
+	}
+
+	// Lets lodepng compress the deflate blocks of large images on the shared threads. The blocks are compressed
+	// the same way however many threads there are, so saved files only depend on whether there is more than one.
+	void deflateInParallel(void (*task)(void *, size_t), void *taskContext, size_t count, const LodePNGCompressSettings *)
+	{
+		Resizer::parallelFor((unsigned)count, [task, taskContext](unsigned begin, unsigned end)
+		{
+			for (unsigned i = begin; i < end; ++i) task(taskContext, i);
+		});
+	}
+
+	// Sets up the compression and filtering of the encoder for a effort level. Higher levels search further back
+	// for longer matches, only the highest one uses the slow but thorough hash chains of lodepng.
+	void setEncoderEffort(LodePNGEncoderSettings &settings, const Resizer::EncodeEffort effort)
+	{
+		// btype, match finder, windowsize, nicematch, lazymatching and filter strategy of every level. The single
+		// lookup of LMF_FAST finds fewer matches than hash chains in the same window, so the windows are larger than
+		// lodepng's defaults to keep the files about as small, see the table in the readme for sizes and times.
+		struct EffortSettings
+		{
+			unsigned btype;
+			LodePNGMatchFinder matchFinder;
+			unsigned windowsize, nicematch, lazymatching;
+			LodePNGFilterStrategy filterStrategy;
+		};
+		const EffortSettings levels[] = {
+			{ 0, LMF_FAST, 2048, 128, 0, LFS_ZERO },
+			{ 2, LMF_FAST, 2048, 32, 0, LFS_MINSUM },
+			{ 2, LMF_FAST, 8192, 64, 0, LFS_MINSUM },
+			{ 2, LMF_FAST, 8192, 128, 1, LFS_MINSUM },
+			{ 2, LMF_FAST, 32768, 258, 1, LFS_MINSUM },
+			{ 2, LMF_HASH_CHAIN, 32768, 258, 1, LFS_ENTROPY }
+		};
+		const EffortSettings &level = levels[effort];
+		settings.zlibsettings.btype = level.btype;
+		settings.zlibsettings.matchfinder = level.matchFinder;
+		settings.zlibsettings.windowsize = level.windowsize;
+		settings.zlibsettings.nicematch = level.nicematch;
+		settings.zlibsettings.lazymatching = level.lazymatching;
+		settings.filter_strategy = level.filterStrategy;
+		// splitting the data into blocks costs some compression and makes the row encoder buffer rows, which only
+		// pays off when there are threads to compress the blocks on
+		settings.zlibsettings.parallel_for = (Resizer::getThreadCount() > 1) ? deflateInParallel : nullptr;
+	}
+
+	// Writes a .png file row by row, so neither the image nor the compressed file have to be in memory as a whole.
+	// The rows are RGBA and are stored in the given color mode, which may have a palette or a color key.
+	// A file that could not be written completely is removed again.
+	class PngWriter
+	{
+	public:
+		PngWriter(const char *filename, const unsigned width, const unsigned height, const LodePNGColorMode &color, const Resizer::EncodeOptions &options)
+			: error(0), filename(filename), file(std::fopen(filename, "wb")), encoder(nullptr)
+		{
+			lodepng_state_init(&state);
+			error = lodepng_color_mode_copy(&state.info_png.color, &color);
+			setEncoderEffort(state.encoder, options.effort);
+			if (error) return;
+			if (file == nullptr) error = 79;
+			else error = lodepng_row_encoder_begin(&encoder, width, height, &state, writeToFile, file);
+		}
+		~PngWriter()
+		{
+			finish();
+			lodepng_state_cleanup(&state);
+		}
+		PngWriter(const PngWriter &) = delete;
+		PngWriter &operator=(const PngWriter &) = delete;
+
+		void addRow(const unsigned char *row)
+		{
+			if (!error) error = lodepng_row_encoder_add(encoder, row);
+		}
+
+		// Ends and closes the file, it returns the first error that happened while writing it.
+		unsigned finish()
+		{
+			if (encoder != nullptr)
+			{
+				unsigned endError = lodepng_row_encoder_end(encoder);
+				if (!error) error = endError;
+				encoder = nullptr;
+			}
+			if (file != nullptr)
+			{
+				if (std::fclose(file) != 0 && !error) error = 79;
+				file = nullptr;
+				if (error) std::remove(filename);
+			}
+			return error;
+		}
+
+		unsigned error;
+
+	private:
+		const char *filename;
+		std::FILE *file;
+		LodePNGRowEncoder *encoder;
+		LodePNGState state;
+	};
+
+	// A lodepng color mode that is cleaned up when it goes out of scope, RGBA with 8 bits per channel to start with.
+	struct ColorMode
+	{
+		ColorMode()
+		{
+			lodepng_color_mode_init(&mode);
+		}
+		ColorMode(const LodePNGColorType colorType) : ColorMode()
+		{
+			mode.colortype = colorType;
+		}
+		~ColorMode()
+		{
+			lodepng_color_mode_cleanup(&mode);
+		}
+		ColorMode(const ColorMode &) = delete;
+		ColorMode &operator=(const ColorMode &) = delete;
+
+		LodePNGColorMode mode;
+	};
+
+	// Builds the weight tables that resize a image from the original size to width by height with a ResizeFilter.
+	// Area shrinks that are streamed use the coverage weights of computeAreaWeightTable even for whole ratios, the
+	// block sums of areaDownscale need every row of a block at once and run slower than the vector row kernels when
+	// they are fed a row at a time. The result can differ by one from areaResize, which rounds only once.
+	void resizeTables(const Resizer::ResizeFilter filter, const unsigned originalWidth, const unsigned originalHeight, const int width, const int height,
+		Resizer::WeightTable &horizontal, Resizer::WeightTable &vertical)
+	{
+		if (filter == Resizer::AREA_FILTER)
+		{
+			horizontal = Resizer::computeAreaWeightTable(originalWidth, width);
+			vertical = Resizer::computeAreaWeightTable(originalHeight, height);
+		}
+		else
+		{
+			horizontal = Resizer::computeWeightTable(originalWidth, width, resizeFilter(filter));
+			vertical = Resizer::computeWeightTable(originalHeight, height, resizeFilter(filter));
+		}
+	}
+
+	// Shrinks of Adam7 interlaced files only need the first passes if those have enough pixels for width by height.
+	// The decoder is set up to stop after the fewest such passes, the size of the file becomes the size of the
+	// reduced image that these passes make up, which is what the resize tables have to be built for.
+	void skipAdam7Passes(PngFile &file, const int width, const int height)
+	{
+		if (file.state.info_png.interlace_method != 1) return;
+		for (unsigned passes = 1; passes < 7; ++passes)
+		{
+			unsigned reducedWidth, reducedHeight;
+			lodepng_adam7_reduced_size(&reducedWidth, &reducedHeight, file.width, file.height, passes);
+			if ((int)reducedWidth >= width && (int)reducedHeight >= height)
+			{
+				file.state.decoder.adam7_passes = passes;
+				file.width = reducedWidth;
+				file.height = reducedHeight;
+				return;
+			}
+		}
+	}
+
+	unsigned addDecodedRow(void *user, unsigned, const unsigned char *row)
+	{
+		static_cast<Resizer::RowResampler *>(user)->addRow(row);
+		return 0;
+	}
+
+	// the resampler that decoded rows go through and the file that the resized rows are written to
+	struct ResizeToFile
+	{
+		Resizer::RowResampler *resampler;
+		PngWriter *writer;
+	};
+
+	unsigned addDecodedRowToFile(void *user, unsigned, const unsigned char *row)
+	{
+		ResizeToFile *target = static_cast<ResizeToFile *>(user);
+		target->resampler->addRow(row);
+		return target->writer->error;
+	}
+
+	// Decodes a file and resizes it to a valid size while it is decoded. Enlargements are resized after decoding.
+	// It returns a pointer to the resized image, or nullptr with the error stored in the file if something went wrong.
+	std::unique_ptr<Resizer::Image> decodeResized(PngFile &file, const int width, const int height, const Resizer::ResizeFilter filter)
+	{
+		std::unique_ptr<Resizer::Image> scaledImage;
+		if (width >= (int)file.width && height >= (int)file.height)
+		{
+			// enlargements need more memory for the result than for the original, so there is nothing to gain from streaming
+			unsigned char *pixels = nullptr;
+			file.error = lodepng_decode(&pixels, &file.width, &file.height, &file.state, file.buffer, file.size);
+			if (!file.error)
+			{
+				std::unique_ptr<Resizer::Image> image = copyPixels(pixels, file.width, file.height);
+				scaledImage = resizeWithFilter(image.get(), width, height, filter);
+			}
+			free(pixels);
+		}
+		else
+		{
+			// only the rows that the vertical filter still needs are kept while the original is decoded
+			skipAdam7Passes(file, width, height);
+			Resizer::WeightTable horizontal, vertical;
+			resizeTables(filter, file.width, file.height, width, height, horizontal, vertical);
+			scaledImage = Resizer::createImage(width, height);
+			Resizer::RowResampler resampler(scaledImage.get(), horizontal, vertical);
+			file.error = lodepng_decode_rows(&file.width, &file.height, &file.state, file.buffer, file.size, addDecodedRow, &resampler);
+			if (file.error) scaledImage = nullptr;
+		}
+		return scaledImage;
+	}
+
+	// Loads a .png file and resizes it while it is decoded. The size of the resized image is asked from
+	// targetSize(originalWidth, originalHeight, width, height) once the header has been read.
+	template <typename TargetSize>
+	std::unique_ptr<Resizer::Image> readResized(const char *filename, const Resizer::ResizeFilter filter, const TargetSize &targetSize)
+	{
+		PngFile file(filename);
+		int width = 0, height = 0;
+		if (!file.error) targetSize(file.width, file.height, width, height);
+
+		if (!file.error && !Resizer::isValidSize(width, height))
+		{
+			std::cout << "Error: invalid target size " << width << "x" << height << " for " << filename << std::endl;
+			return nullptr;
+		}
+
+		std::unique_ptr<Resizer::Image> scaledImage;
+		if (!file.error) scaledImage = decodeResized(file, width, height, filter);
+		if (file.error)
+		{
+			std::cout << "Error " << file.error << ": " << lodepng_error_text(file.error) << std::endl;
+			return nullptr;
+		}
+		if (scaledImage) std::cout << "Image loaded: " << filename << std::endl;
+		return scaledImage;
+	}
+
+	// Loads a .png file, resizes it while it is decoded and saves the result. Opaque shrinks are encoded as the
+	// resized rows come out of the resampler, so neither the original nor the result are ever in memory as a whole.
+	// Other images are resized into memory first because their color type is only known once every pixel is.
+	// The size of the resized image is asked from targetSize(originalWidth, originalHeight, width, height).
+	template <typename TargetSize>
+	bool resizeToFile(const char *inputFilename, const char *outputFilename, const Resizer::ResizeFilter filter, const Resizer::EncodeOptions &options, const TargetSize &targetSize)
+	{
+		PngFile file(inputFilename);
+		int width = 0, height = 0;
+		if (!file.error) targetSize(file.width, file.height, width, height);
+		if (!file.error && !Resizer::isValidSize(width, height))
+		{
+			std::cout << "Error: invalid target size " << width << "x" << height << " for " << inputFilename << std::endl;
+			return false;
+		}
+
+		if (!file.error && ((width >= (int)file.width && height >= (int)file.height) || canHaveAlpha(file)))
+		{
+			std::unique_ptr<Resizer::Image> scaledImage = decodeResized(file, width, height, filter);
+			if (scaledImage)
+			{
+				std::cout << "Image loaded: " << inputFilename << std::endl;
+				return Resizer::saveImageToFile(outputFilename, scaledImage.get(), options);
+			}
+		}
+		else if (!file.error)
+		{
+			// resizing gives the same value in every channel of a grey image and keeps opaque images opaque, the palette
+			// and bit depth that would fit the resized pixels are only known once all of them are, so 8 bits are used
+			const ColorMode color(lodepng_is_greyscale_type(&file.state.info_png.color) ? LCT_GREY : LCT_RGB);
+			PngWriter writer(outputFilename, width, height, color.mode, options);
+			skipAdam7Passes(file, width, height);
+			Resizer::WeightTable horizontal, vertical;
+			resizeTables(filter, file.width, file.height, width, height, horizontal, vertical);
+			Resizer::RowResampler resampler([&writer](unsigned, const unsigned char *row) { writer.addRow(row); }, horizontal, vertical);
+			ResizeToFile target = { &resampler, &writer };
+			file.error = lodepng_decode_rows(&file.width, &file.height, &file.state, file.buffer, file.size, addDecodedRowToFile, &target);
+			unsigned writeError = writer.finish();
+			if (!file.error) file.error = writeError;
+			if (!file.error)
+			{
+				std::cout << "Image loaded: " << inputFilename << std::endl;
+				std::cout << "Image saved: " << outputFilename << std::endl;
+				return true;
+			}
+		}
+		if (file.error) std::cout << "Error " << file.error << ": " << lodepng_error_text(file.error) << std::endl;
+		return false;
+	}
+
+	// memory that a streaming inflate holds at most: the window, the bytes inflated since the last flush and room
+	// for the buffer to grow
+	const size_t INFLATE_STREAM_MEMORY = 512 * 1024;
+
+	// Bytes that a Resizer::Image of width by height pixels allocates.
+	size_t imageMemory(const unsigned long long width, const unsigned long long height)
+	{
+		const unsigned long long stride = (width * Resizer::NUMBER_OF_CHANNELS + Resizer::ROW_ALIGNMENT - 1) / Resizer::ROW_ALIGNMENT * Resizer::ROW_ALIGNMENT;
+		return (size_t)(stride * height);
+	}
+
+	// Number of taps a weight table has at most when it resizes from sourceSize to destinationSize pixels.
+	size_t filterTaps(const unsigned sourceSize, const unsigned destinationSize, const float support)
+	{
+		const double scale = (sourceSize > destinationSize) ? (double)sourceSize / destinationSize : 1.0;
+		return (size_t)(2.0 * support * scale) + 2;
+	}
+
+	// Bytes of the weight table of one axis, the first source pixel and the weights of every destination pixel.
+	size_t weightTableMemory(const unsigned sourceSize, const unsigned destinationSize, const float support)
+	{
+		return (size_t)destinationSize * (sizeof(int) + sizeof(short) * filterTaps(sourceSize, destinationSize, support));
+	}
+
+	// Bytes that the pixels of a image take in the color type and bit depth of its file.
+	size_t rawMemory(const Resizer::ImageHeader &header)
+	{
+		LodePNGColorMode color;
+		lodepng_color_mode_init(&color);
+		color.colortype = (LodePNGColorType)header.colorType;
+		color.bitdepth = header.bitDepth;
+		const unsigned long long bits = (unsigned long long)header.width * header.height * lodepng_get_bpp(&color);
+		lodepng_color_mode_cleanup(&color);
+		return (size_t)((bits + 7) / 8);
+	}
+
+	// Memory that lodepng takes at most to decode a whole image: the inflated scanlines, the unfiltered pixels in the
+	// color type of the file and the RGBA pixels they are converted to. Every scanline adds a filter byte and up to a
+	// byte of padding, Adam7 passes have at most 2 * height + 7 scanlines together.
+	size_t decodeMemory(const Resizer::ImageHeader &header)
+	{
+		const size_t raw = rawMemory(header);
+		const size_t scanlines = raw + 2 * (2 * (size_t)header.height + 7);
+		return scanlines + raw + (size_t)header.width * header.height * Resizer::NUMBER_OF_CHANNELS;
+	}
+
+	// Memory that lodepng takes at most to decode a image that is not interlaced row by row: the current and the
+	// previous scanline, the current row converted to RGBA and the inflate window.
+	size_t decodeRowsMemory(const Resizer::ImageHeader &header)
+	{
+		const size_t scanline = rawMemory(header) / header.height + 2;
+		return 2 * scanline + (size_t)header.width * Resizer::NUMBER_OF_CHANNELS + INFLATE_STREAM_MEMORY;
+	}
+
+	// Memory that the row encoder takes at most to write a image of width by height pixels: scanlines to choose the
+	// filters with, the deflate input that is not compressed yet, the output that is not written yet, and the hash
+	// tables and LZ77 symbols of every block that is compressed at the same time. With more than one thread lodepng
+	// buffers up to 16 blocks and compresses them in parallel, the block size is the one lodepng picks. Choosing the
+	// color mode and converting rows to a palette take a color tree of up to 257 colors with 8 levels each.
+	size_t encodeMemory(const unsigned width, const unsigned height)
+	{
+		const size_t scanline = (size_t)width * Resizer::NUMBER_OF_CHANNELS + 1;
+		const size_t blocksize = std::min<size_t>(std::max<size_t>(scanline * height / 8 + 8, 65536), 262144);
+		const unsigned threads = Resizer::getThreadCount();
+		const size_t bufferedBlocks = (threads > 1) ? 16 : 1;
+		const size_t parallelBlocks = std::min<size_t>(threads, 16);
+		// the largest window any effort level uses
+		const size_t window = 32768;
+		const size_t hash = 65536 * sizeof(int) + window * (sizeof(int) + 3 * sizeof(unsigned short)) + 259 * sizeof(int);
+		// vectors grow by doubling, so input, output and LZ77 symbols can take twice what they hold
+		const size_t input = 2 * (window + bufferedBlocks * blocksize);
+		const size_t block = hash + 2 * (4 * sizeof(unsigned) * blocksize / 3 + sizeof(unsigned)) + 2 * (blocksize + blocksize / 8 + 64);
+		const size_t output = 2 * bufferedBlocks * (blocksize + blocksize / 8 + 64);
+		const size_t colorTree = 257 * 8 * (16 * sizeof(void *) + 4 * sizeof(int));
+		return 8 * scanline + input + parallelBlocks * block + output + colorTree;
+	}
+}
+
+Resizer::Image::Image() : data(nullptr), width(0), height(0), stride(0)
+{
+}
+
+// Allocates a image with rows padded to a multiple of ROW_ALIGNMENT bytes, the pixels are left uninitialized.
+Resizer::Image::Image(const unsigned inWidth, const unsigned inHeight) : data(nullptr), width(inWidth), height(inHeight)
+{
+	const unsigned rowSize = width * Resizer::NUMBER_OF_CHANNELS;
+	stride = (rowSize + Resizer::ROW_ALIGNMENT - 1) / Resizer::ROW_ALIGNMENT * Resizer::ROW_ALIGNMENT;
+	data = allocateAligned((size_t)stride * height);
+	if (data == nullptr) throw std::bad_alloc();
+	if (stride != rowSize)
+	{
+		for (unsigned y = 0; y < height; ++y)
+			std::memset(row(y) + rowSize, 0, stride - rowSize);
+	}
+}
+
+Resizer::Image::Image(Resizer::Image &&other) : data(other.data), width(other.width), height(other.height), stride(other.stride)
+{
+	other.data = nullptr;
+	other.width = other.height = other.stride = 0;
+}
+
+Resizer::Image &Resizer::Image::operator=(Resizer::Image &&other)
+{
+	if (this != &other)
+	{
+		freeAligned(data);
+		data = other.data;
+		width = other.width;
+		height = other.height;
+		stride = other.stride;
+		other.data = nullptr;
+		other.width = other.height = other.stride = 0;
+	}
+	return *this;
+}
+
+Resizer::Image::~Image()
+{
+	freeAligned(data);
+}
+
+// Creates a image with uninitialized pixels.
+// Takes the image width and height in pixels as arguments.
+std::unique_ptr<Resizer::Image> Resizer::createImage(const unsigned width, const unsigned height)
+{
+	return std::unique_ptr<Resizer::Image>(new Resizer::Image(width, height));
+}
 
 // Load .png image from file.
 // Takes path to file including filename as argument.
 // A pointer to the loaded image is then returned, or a nullptr if the image could not be loaded.
-Resizer::Image *Resizer::readImageFromFile(const char *filename)
+std::unique_ptr<Resizer::Image> Resizer::readImageFromFile(const char *filename)
 {
-	Resizer::Image *image = new Resizer::Image();
-	unsigned error = lodepng_decode32_file(&image->data, &image->width, &image->height, filename);
+	unsigned char *pixels = nullptr;
+	unsigned width = 0, height = 0;
+	unsigned error = lodepng_decode32_file(&pixels, &width, &height, filename);
 	if (error)
 	{
 		std::cout << "Error " << error << ": " << lodepng_error_text(error) << std::endl;
 		return nullptr;
 	}
+
+	// lodepng stores the rows without padding, so they are copied into the aligned rows of the image
+	std::unique_ptr<Resizer::Image> image = copyPixels(pixels, width, height);
+	free(pixels);
 	std::cout << "Image loaded: " << filename << std::endl;
 	return image;
 }
 
+// Load .png image from file and resize it while it is decoded, so that only the rows that the filter needs at a time
+// are in memory instead of the whole original. Enlargements are resized after loading the original.
+// Takes path to file including filename, how much to scale the width and height in percentage and the filter to use.
+// A pointer to the resized image is then returned, or a nullptr if the image could not be loaded or resized.
+std::unique_ptr<Resizer::Image> Resizer::readResizedImageFromFile(const char *filename, const float widthScale, const float heightScale, const Resizer::ResizeFilter filter)
+{
+	return readResized(filename, filter, [&](unsigned originalWidth, unsigned originalHeight, int &width, int &height)
+	{
+		width = (int)(originalWidth * widthScale);
+		height = (int)(originalHeight * heightScale);
+	});
+}
+
+// Load .png image from file and resize it while it is decoded, so that only the rows that the filter needs at a time
+// are in memory instead of the whole original. Enlargements are resized after loading the original.
+// Takes path to file including filename, the wanted pixel size of the resized image and the filter to use.
+// A pointer to the resized image is then returned, or a nullptr if the image could not be loaded or resized.
+std::unique_ptr<Resizer::Image> Resizer::readResizedImageFromFile(const char *filename, const int width, const int height, const Resizer::ResizeFilter filter)
+{
+	return readResized(filename, filter, [&](unsigned, unsigned, int &targetWidth, int &targetHeight)
+	{
+		targetWidth = width;
+		targetHeight = height;
+	});
+}
+
+// Load .png image from file, resize it while it is decoded and save the result to another file. Opaque images that
+// are made smaller are encoded while they are resized, so neither the original nor the result are in memory as a whole.
+// Takes paths to both files including filenames, how much to scale the width and height in percentage, the filter to use
+// and how much effort to spend on compressing the result. It then returns true if the resized image was saved.
+bool Resizer::resizeImageFile(const char *inputFilename, const char *outputFilename, const float widthScale, const float heightScale, const Resizer::ResizeFilter filter, const Resizer::EncodeOptions &options)
+{
+	return resizeToFile(inputFilename, outputFilename, filter, options, [&](unsigned originalWidth, unsigned originalHeight, int &width, int &height)
+	{
+		width = (int)(originalWidth * widthScale);
+		height = (int)(originalHeight * heightScale);
+	});
+}
+
+// Load .png image from file, resize it while it is decoded and save the result to another file. Opaque images that
+// are made smaller are encoded while they are resized, so neither the original nor the result are in memory as a whole.
+// Takes paths to both files including filenames, the wanted pixel size of the resized image, the filter to use
+// and how much effort to spend on compressing the result. It then returns true if the resized image was saved.
+bool Resizer::resizeImageFile(const char *inputFilename, const char *outputFilename, const int width, const int height, const Resizer::ResizeFilter filter, const Resizer::EncodeOptions &options)
+{
+	return resizeToFile(inputFilename, outputFilename, filter, options, [&](unsigned, unsigned, int &targetWidth, int &targetHeight)
+	{
+		targetWidth = width;
+		targetHeight = height;
+	});
+}
+
 // Save .png image to file.
-// Takes path to file including filename and a pointer to a image as arguments.
-void Resizer::saveImageToFile(const char *filename, const Resizer::Image *image)
+// The rows are compressed and written one at a time in the smallest color mode that keeps every pixel, which
+// lodepng chooses from the colors of the image like it does for auto_convert, with a palette or fewer bits if they fit.
+// Takes path to file including filename, a pointer to a image and how much effort to spend on compressing it.
+// It then returns true if the image was saved.
+bool Resizer::saveImageToFile(const char *filename, const Resizer::Image *image, const Resizer::EncodeOptions &options)
 {
-	unsigned error = lodepng_encode32_file(filename, image->data, image->width, image->height);
+	const ColorMode rgba;
+	ColorMode color;
+	unsigned error = lodepng_auto_choose_color_rows(&color.mode, image->data, image->width, image->height, image->stride, &rgba.mode);
 	if (error)
 	{
 		std::cout << "Error " << error << ": " << lodepng_error_text(error) << std::endl;
-		return;
+		return false;
+	}
+	PngWriter writer(filename, image->width, image->height, color.mode, options);
+	for (unsigned y = 0; y < image->height; ++y)
+		writer.addRow(image->row(y));
+	error = writer.finish();
+	if (error)
+	{
+		std::cout << "Error " << error << ": " << lodepng_error_text(error) << std::endl;
+		return false;
 	}
 	std::cout << "Image saved: " << filename << std::endl;
+	return true;
 }
 
 // Checks to see if a choosen image size is valid to resize to.
@@ -38,98 +681,216 @@ bool Resizer::isValidSize(const int width, const int height)
 	return (width >= Resizer::MIN_VALID_WIDTH && height >= Resizer::MIN_VALID_HEIGHT && width <= Resizer::MAX_VALID_WIDTH && height <= Resizer::MAX_VALID_HEIGHT) ? true : false;
 }
 
-// Not implemented yet.
-Resizer::Image *Resizer::bicubicInterpolation(const Resizer::Image *image, const float widthScale, const float heightScale)
+// Reads the header of a .png file without decoding the image, only the signature and the IHDR chunk are read.
+// Takes path to file including filename as argument.
+// It returns what the header tells about the image, its valid member is false if the header could not be read.
+Resizer::ImageHeader Resizer::readImageHeader(const char *filename)
 {
-	return Resizer::bicubicInterpolation(image, (int)(image->width * widthScale), (int)(image->height * heightScale));
+	Resizer::ImageHeader header;
+	// the signature and the IHDR chunk are always the first 33 bytes of a .png file
+	unsigned char start[33];
+	std::FILE *file = std::fopen(filename, "rb");
+	if (file == nullptr) return header;
+	const size_t size = std::fread(start, 1, sizeof(start), file);
+	std::fclose(file);
+
+	LodePNGState state;
+	lodepng_state_init(&state);
+	unsigned width = 0, height = 0;
+	if (size == sizeof(start) && lodepng_inspect(&width, &height, &state, start, size) == 0)
+	{
+		header.width = width;
+		header.height = height;
+		header.bitDepth = state.info_png.color.bitdepth;
+		header.colorType = state.info_png.color.colortype;
+		header.interlaced = state.info_png.interlace_method != 0;
+		// the pixels in the color type of the file and the RGBA pixels they are converted to
+		header.decodedSize = lodepng_get_raw_size(width, height, &state.info_png.color) + (size_t)width * height * Resizer::NUMBER_OF_CHANNELS;
+		header.valid = true;
+	}
+	lodepng_state_cleanup(&state);
+	return header;
+}
+
+// Estimates the work and the memory of resizing the image of a job to width by height with a ResizeFilter,
+// the way resizeImageFile does it, and stores them in the job. Nothing is changed if the header could not be read.
+// The memory is an upper bound of what the decoder, the resampler and the encoder allocate together, the mapped
+// input file is not included. It depends on the thread count, so setThreadCount should be called first.
+void Resizer::estimateResize(Resizer::BatchJob &job, const int width, const int height, const Resizer::ResizeFilter filter)
+{
+	const Resizer::ImageHeader &header = job.header;
+	if (!header.valid || !Resizer::isValidSize(width, height)) return;
+	const unsigned long long pixelsIn = (unsigned long long)header.width * header.height;
+	const unsigned long long pixelsOut = (unsigned long long)width * height;
+	const float support = resizeFilter(filter).support;
+	job.cost = (unsigned long long)(pixelsIn * (double)support) + pixelsOut;
+
+	// the resized image is in memory unless it is streamed to the file, which depends on the tRNS chunk
+	const size_t common = imageMemory(width, height) + weightTableMemory(header.width, width, support)
+		+ weightTableMemory(header.height, height, support) + encodeMemory(width, height);
+	if (width >= (int)header.width && height >= (int)header.height)
+	{
+		// enlargements are decoded as a whole, copied into a image with aligned rows and resized in two passes
+		const size_t intermediate = std::max(imageMemory(width, header.height), imageMemory(header.width, height));
+		job.memory = decodeMemory(header) + imageMemory(header.width, header.height) + intermediate + common;
+		return;
+	}
+	// shrinks keep a window of filtered rows and a few decoded rows, interlaced files are still decoded as a whole
+	const size_t window = imageMemory(width, 2 * filterTaps(header.height, height, support) + 1);
+	const size_t decoder = header.interlaced ? decodeMemory(header) : decodeRowsMemory(header);
+	job.memory = decoder + window + common;
 }
 
-// Not implemented yet.
-Resizer::Image *Resizer::bicubicInterpolation(const Resizer::Image *image, const int width, const int height)
+// Estimates the work and the memory of resizing the image of a job to width by height with nearest neighbour
+// interpolation and stores them in the job. The image is decoded as a whole and every pixel is looked at once.
+// Like estimateResize, the memory is an upper bound that depends on the thread count.
+void Resizer::estimateNearestResize(Resizer::BatchJob &job, const int width, const int height)
 {
-	if (!Resizer::isValidSize(width, height)) return nullptr;
-	return nullptr;
+	const Resizer::ImageHeader &header = job.header;
+	if (!header.valid || !Resizer::isValidSize(width, height)) return;
+	const unsigned long long pixelsOut = (unsigned long long)width * height;
+	job.cost = (unsigned long long)header.width * header.height + pixelsOut;
+	job.memory = decodeMemory(header) + imageMemory(header.width, header.height) + imageMemory(width, height) + encodeMemory(width, height);
+}
+
+// Reads the headers of all files of a batch on threadCount threads and orders them so that the images that take
+// the most work are resized first. Large images then don't end up running alone at the end of a batch and the
+// memory they need is known before they are started. Files whose header can't be read come last.
+// Without an estimate the work is the number of pixels and the memory is what decoding the image as a whole takes,
+// an estimate can replace both for jobs with a valid header, for example with estimateResize.
+// Takes the paths to the files including filenames, the number of threads to use and the estimate as arguments.
+std::vector<Resizer::BatchJob> Resizer::planBatch(const std::vector<std::string> &filenames, const unsigned threadCount,
+	const std::function<void(Resizer::BatchJob &job)> &estimate)
+{
+	const unsigned count = (unsigned)filenames.size();
+	std::vector<Resizer::BatchJob> jobs(count);
+	std::atomic<unsigned> nextFile(0);
+	auto readHeaders = [&]()
+	{
+		for (unsigned i = nextFile++; i < count; i = nextFile++)
+		{
+			jobs[i].index = i;
+			jobs[i].header = Resizer::readImageHeader(filenames[i].c_str());
+			jobs[i].cost = (unsigned long long)jobs[i].header.width * jobs[i].header.height;
+			jobs[i].memory = jobs[i].header.decodedSize;
+			if (estimate && jobs[i].header.valid) estimate(jobs[i]);
+		}
+	};
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < threadCount && i < count; ++i)
+		threads.push_back(std::thread(readHeaders));
+	readHeaders();
+	for (size_t i = 0; i < threads.size(); ++i)
+		threads[i].join();
+
+	std::stable_sort(jobs.begin(), jobs.end(), [](const Resizer::BatchJob &a, const Resizer::BatchJob &b)
+	{
+		return a.cost > b.cost;
+	});
+	return jobs;
+}
+
+// Creates a resized copy of a image using bicubic interpolation.
+// Takes a original image, how much to scale the width and height in percentage and the B and C parameters of the cubic filter.
+// It then returns a pointer to the resized image or nullptr if something went wrong.
+std::unique_ptr<Resizer::Image> Resizer::bicubicInterpolation(const Resizer::Image *image, const float widthScale, const float heightScale, const Resizer::CubicParameters &parameters)
+{
+	return Resizer::bicubicInterpolation(image, (int)(image->width * widthScale), (int)(image->height * heightScale), parameters);
+}
+
+// Creates a resized copy of a image using bicubic interpolation.
+// Takes a original image, the wanted pixel size of the resized image and the B and C parameters of the cubic filter.
+// It then returns a pointer to the resized image or nullptr if something went wrong.
+std::unique_ptr<Resizer::Image> Resizer::bicubicInterpolation(const Resizer::Image *image, const int width, const int height, const Resizer::CubicParameters &parameters)
+{
+	const Resizer::Filter filter = { Resizer::cubicKernel, 2.0f, { parameters.b, parameters.c } };
+	return Resizer::resample(image, width, height, filter);
 }
 
 // Creates a resized copy of a image using bilinear interpolation.
 // Takes a original image and how much to scale the width and height in percentage.
 // It then returns a pointer to the resized image or nullptr if something went wrong.
-Resizer::Image *Resizer::bilinearInterpolation(const Resizer::Image *image, const float widthScale, const float heightScale)
+std::unique_ptr<Resizer::Image> Resizer::bilinearInterpolation(const Resizer::Image *image, const float widthScale, const float heightScale)
 {
 	return Resizer::bilinearInterpolation(image, (int)(image->width * widthScale), (int)(image->height * heightScale));
 }
 
 // Creates a resized copy of a image using bilinear interpolation.
+// Enlargements use a single pass integer kernel, when shrinking the filter is widened to cover every source pixel.
 // Takes a original image and the wanted pixel size of the resized image.
 // It then returns a pointer to the resized image or nullptr if something went wrong.
-Resizer::Image *Resizer::bilinearInterpolation(const Resizer::Image *image, const int width, const int height)
+std::unique_ptr<Resizer::Image> Resizer::bilinearInterpolation(const Resizer::Image *image, const int width, const int height)
 {
-	if (!Resizer::isValidSize(width, height)) return nullptr;
+	if (image == nullptr || !Resizer::isValidSize(width, height)) return nullptr;
+	if (width >= (int)image->width && height >= (int)image->height && image->width >= 2 && image->height >= 2)
+		return Resizer::bilinearUpscale(image, width, height);
+	const Resizer::Filter filter = { Resizer::triangleKernel, 1.0f, { 0.0f, 0.0f } };
+	return Resizer::resample(image, width, height, filter);
+}
 
-	Resizer::Image *scaledImage = new Resizer::Image(width, height);
-	for (int i = 0; i < height; ++i)
-	{
-		for (int j = 0; j < width; ++j)
-		{
-			// scaled image pixel id
-			int id1 = (i * width + j) * Resizer::NUMBER_OF_CHANNELS;
-
-			// sample position in original image
-			float y = (i / (float)height) * image->height;
-			float x = (j / (float)width) * image->width;
-
-			// y sample pixels in the original image
-			int pixel1 = ((int)(y + 0) * image->width + (int)x + 0) * Resizer::NUMBER_OF_CHANNELS;
-			int pixel2 = ((int)(y + 0) * image->width + (int)x + 1) * Resizer::NUMBER_OF_CHANNELS;
-			int pixel3 = ((int)(y + 1) * image->width + (int)x + 0) * Resizer::NUMBER_OF_CHANNELS;
-			int pixel4 = ((int)(y + 1) * image->width + (int)x + 1) * Resizer::NUMBER_OF_CHANNELS;
-
-			// make sure no pixel id is bigger than number of pixels in image
-			int max = image->width * image->height * Resizer::NUMBER_OF_CHANNELS;
-			pixel1 = (pixel1 < max) ? pixel1 : max;
-			pixel2 = (pixel2 < max) ? pixel2 : max;
-			pixel3 = (pixel3 < max) ? pixel3 : max;
-			pixel4 = (pixel4 < max) ? pixel4 : max;
-
-			// interpolate step 1
-			float s1, s2, x1, x2, y1, y2;
-			x1 = (int)x;
-			x2 = (int)(x + 1);
-			s1 = ((x2 - x) / (x2 - x1));
-			s2 = ((x - x1) / (x2 - x1));
-			unsigned char r1_r = s1 * image->data[pixel1 + 0] + s2 * image->data[pixel2 + 0];
-			unsigned char r1_g = s1 * image->data[pixel1 + 1] + s2 * image->data[pixel2 + 1];
-			unsigned char r1_b = s1 * image->data[pixel1 + 2] + s2 * image->data[pixel2 + 2];
-			unsigned char r1_a = s1 * image->data[pixel1 + 3] + s2 * image->data[pixel2 + 3];
-			unsigned char r2_r = s1 * image->data[pixel3 + 0] + s2 * image->data[pixel4 + 0];
-			unsigned char r2_g = s1 * image->data[pixel3 + 1] + s2 * image->data[pixel4 + 1];
-			unsigned char r2_b = s1 * image->data[pixel3 + 2] + s2 * image->data[pixel4 + 2];
-			unsigned char r2_a = s1 * image->data[pixel3 + 3] + s2 * image->data[pixel4 + 3];
-			
-			// interpolate step 2
-			y1 = (int)y;
-			y2 = (int)(y + 1);
-			s1 = ((y2 - y) / (y2 - y1));
-			s2 = ((y - y1) / (y2 - y1));
-			unsigned char p_r = s1 * r1_r + s2 * r2_r;
-			unsigned char p_g = s1 * r1_g + s2 * r2_g;
-			unsigned char p_b = s1 * r1_b + s2 * r2_b;
-			unsigned char p_a = s1 * r1_a + s2 * r2_a;
-
-			// store result
-			scaledImage->data[id1 + 0] = p_r;
-			scaledImage->data[id1 + 1] = p_g;
-			scaledImage->data[id1 + 2] = p_b;
-			scaledImage->data[id1 + 3] = p_a;
-		}
-	}
-	return scaledImage;
+// Creates a resized copy of a image using a Lanczos filter.
+// Takes a original image, how much to scale the width and height in percentage and the radius of the filter in lobes, usually 2 or 3.
+// It then returns a pointer to the resized image or nullptr if something went wrong.
+std::unique_ptr<Resizer::Image> Resizer::lanczosInterpolation(const Resizer::Image *image, const float widthScale, const float heightScale, const int lobes)
+{
+	return Resizer::lanczosInterpolation(image, (int)(image->width * widthScale), (int)(image->height * heightScale), lobes);
+}
+
+// Creates a resized copy of a image using a Lanczos filter.
+// Takes a original image, the wanted pixel size of the resized image and the radius of the filter in lobes, usually 2 or 3.
+// It then returns a pointer to the resized image or nullptr if something went wrong.
+std::unique_ptr<Resizer::Image> Resizer::lanczosInterpolation(const Resizer::Image *image, const int width, const int height, const int lobes)
+{
+	return Resizer::windowedSincInterpolation(image, width, height, Resizer::LANCZOS_WINDOW, lobes);
+}
+
+// Creates a resized copy of a image using a windowed sinc filter.
+// Takes a original image, how much to scale the width and height in percentage, the window function and the radius of the filter in lobes.
+// It then returns a pointer to the resized image or nullptr if something went wrong.
+std::unique_ptr<Resizer::Image> Resizer::windowedSincInterpolation(const Resizer::Image *image, const float widthScale, const float heightScale, const Resizer::WindowFunction window, const int lobes)
+{
+	return Resizer::windowedSincInterpolation(image, (int)(image->width * widthScale), (int)(image->height * heightScale), window, lobes);
+}
+
+// Creates a resized copy of a image using a windowed sinc filter.
+// Takes a original image, the wanted pixel size of the resized image, the window function and the radius of the filter in lobes.
+// It then returns a pointer to the resized image or nullptr if something went wrong.
+std::unique_ptr<Resizer::Image> Resizer::windowedSincInterpolation(const Resizer::Image *image, const int width, const int height, const Resizer::WindowFunction window, const int lobes)
+{
+	if (lobes < 1) return nullptr;
+	Resizer::Filter filter = { Resizer::lanczosKernel, (float)lobes, { (float)lobes, 0.0f } };
+	if (window == Resizer::HANN_WINDOW) filter.kernel = Resizer::hannKernel;
+	else if (window == Resizer::HAMMING_WINDOW) filter.kernel = Resizer::hammingKernel;
+	else if (window == Resizer::BLACKMAN_WINDOW) filter.kernel = Resizer::blackmanKernel;
+	return Resizer::resample(image, width, height, filter);
+}
+
+// Creates a resized copy of a image where every pixel is the average of the area it covers in the original image.
+// Takes a original image and how much to scale the width and height in percentage.
+// It then returns a pointer to the resized image or nullptr if something went wrong.
+std::unique_ptr<Resizer::Image> Resizer::areaResize(const Resizer::Image *image, const float widthScale, const float heightScale)
+{
+	return Resizer::areaResize(image, (int)(image->width * widthScale), (int)(image->height * heightScale));
+}
+
+// Creates a resized copy of a image where every pixel is the average of the area it covers in the original image.
+// Integer reductions such as 2x2 or 4x4 use a dedicated integer path, other ratios weight partially covered pixels by their coverage.
+// Takes a original image and the wanted pixel size of the resized image.
+// It then returns a pointer to the resized image or nullptr if something went wrong.
+std::unique_ptr<Resizer::Image> Resizer::areaResize(const Resizer::Image *image, const int width, const int height)
+{
+	if (image == nullptr || !Resizer::isValidSize(width, height)) return nullptr;
+	if (image->width % width == 0 && image->height % height == 0)
+		return Resizer::areaDownscale(image, image->width / width, image->height / height);
+	Resizer::WeightTable horizontal = Resizer::computeAreaWeightTable(image->width, width);
+	Resizer::WeightTable vertical = Resizer::computeAreaWeightTable(image->height, height);
+	return Resizer::resample(image, horizontal, vertical);
 }
 
 // Creates a resized copy of a image using nearest neighbour interpolation.
 // Takes a original image and how much to scale the width and height in percentage.
 // It then returns a pointer to the resized image or nullptr if something went wrong.
-Resizer::Image *Resizer::nearestNeighbourInterpolation(const Resizer::Image *image, const float widthScale, const float heightScale)
+std::unique_ptr<Resizer::Image> Resizer::nearestNeighbourInterpolation(const Resizer::Image *image, const float widthScale, const float heightScale)
 {
 	return Resizer::nearestNeighbourInterpolation(image, (int)(image->width * widthScale), (int)(image->height * heightScale));
 }
@@ -137,24 +898,36 @@ Resizer::Image *Resizer::nearestNeighbourInterpolation(const Resizer::Image *ima
 // Creates a resized copy of a image using nearest neighbour interpolation.
 // Takes a original image and the wanted pixel size of the resized image.
 // It then returns a pointer to the resized image or nullptr if something went wrong.
-Resizer::Image *Resizer::nearestNeighbourInterpolation(const Resizer::Image *image, const int width, const int height)
+std::unique_ptr<Resizer::Image> Resizer::nearestNeighbourInterpolation(const Resizer::Image *image, const int width, const int height)
 {
-	if (!Resizer::isValidSize(width, height)) return nullptr;
-	int id1, id2, x, y;
-	Resizer::Image *scaledImage = new Resizer::Image(width, height);
+	if (image == nullptr || !Resizer::isValidSize(width, height)) return nullptr;
+
+	// source pixel offsets for every column and row are computed once instead of per pixel
+	std::vector<unsigned> columnOffset(width), sourceRows(height);
+	for (int j = 0; j < width; ++j)
+	{
+		unsigned x = (unsigned)((j + 0.5) * image->width / width);
+		columnOffset[j] = ((x < image->width) ? x : image->width - 1) * Resizer::NUMBER_OF_CHANNELS;
+	}
 	for (int i = 0; i < height; ++i)
 	{
-		for (int j = 0; j < width; ++j)
+		unsigned y = (unsigned)((i + 0.5) * image->height / height);
+		sourceRows[i] = (y < image->height) ? y : image->height - 1;
+	}
+
+	std::unique_ptr<Resizer::Image> scaledImage = Resizer::createImage(width, height);
+	Resizer::parallelFor(height, [&](unsigned begin, unsigned end)
+	{
+		for (unsigned i = begin; i < end; ++i)
 		{
-			y = (i / (float)height) * image->height;
-			x = (j / (float)width) * image->width;
-			id1 = (i * width + j) * Resizer::NUMBER_OF_CHANNELS;
-			id2 = (y * image->width + x) * Resizer::NUMBER_OF_CHANNELS;
-			scaledImage->data[id1 + 0] = image->data[id2 + 0];
-			scaledImage->data[id1 + 1] = image->data[id2 + 1];
-			scaledImage->data[id1 + 2] = image->data[id2 + 2];
-			scaledImage->data[id1 + 3] = image->data[id2 + 3];
+			const unsigned char *sourceRow = image->row(sourceRows[i]);
+			unsigned char *pixel = scaledImage->row(i);
+			for (int j = 0; j < width; ++j)
+			{
+				std::memcpy(pixel, sourceRow + columnOffset[j], Resizer::NUMBER_OF_CHANNELS);
+				pixel += Resizer::NUMBER_OF_CHANNELS;
+			}
 		}
-	}
+	});
 	return scaledImage;
 }
@@ -0,0 +1,93 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "resizer.h"
+
+namespace Resizer
+{
+	// A fixed number of worker threads that run submitted tasks in the order they were submitted.
+	class ThreadPool
+	{
+	public:
+		explicit ThreadPool(const unsigned threadCount);
+		~ThreadPool();
+		ThreadPool(const ThreadPool &) = delete;
+		ThreadPool &operator=(const ThreadPool &) = delete;
+
+		void submit(std::function<void()> task);
+		unsigned size() const { return (unsigned)workers.size(); }
+		unsigned idleCount();
+
+	private:
+		void run();
+
+		std::vector<std::thread> workers;
+		std::deque<std::function<void()>> tasks;
+		std::mutex mutex;
+		std::condition_variable condition;
+		bool stopping;
+
+		// number of workers that are running a task
+		unsigned busy;
+	};
+
+	// Limits the memory that tasks running at the same time use together. A task takes its estimated memory from
+	// the budget before it starts and gives it back when it is done. A task that needs more than the whole budget
+	// is let through once no memory is taken, so every task gets to run.
+	class MemoryBudget
+	{
+	public:
+		explicit MemoryBudget(const size_t limit);
+		MemoryBudget(const MemoryBudget &) = delete;
+		MemoryBudget &operator=(const MemoryBudget &) = delete;
+
+		void acquire(const size_t bytes);
+		bool tryAcquire(const size_t bytes, const size_t reserved = 0);
+		void release(const size_t bytes);
+
+	private:
+		// reserved bytes are kept free for someone else, nothing fits around a reservation larger than the limit
+		bool fits(const size_t bytes, const size_t reserved) const
+		{
+			if (used == 0 && reserved == 0) return true;
+			return used <= limit && reserved <= limit - used && bytes <= limit - used - reserved;
+		}
+
+		size_t limit;
+		size_t used;
+		std::mutex mutex;
+		std::condition_variable condition;
+	};
+
+	// Hands out the jobs of a batch to the threads that resize them. Jobs are handed out in the order of the plan, which
+	// puts the most work first, but only when the jobs that are running leave room in the memory budget for them.
+	// When the next job doesn't fit, its memory is reserved and only jobs further down the plan that fit in what is
+	// left beside the reservation are handed out. Workers keep busy with smaller images that way, while the memory
+	// that running jobs give back goes to the waiting job, so it starts as soon as possible instead of last.
+	class BatchScheduler
+	{
+	public:
+		BatchScheduler(const std::vector<BatchJob> &plan, const size_t memoryLimit);
+		BatchScheduler(const BatchScheduler &) = delete;
+		BatchScheduler &operator=(const BatchScheduler &) = delete;
+
+		bool next(BatchJob &job);
+		bool tryNext(BatchJob &job);
+		void finish(const BatchJob &job);
+
+	private:
+		bool take(BatchJob &job);
+
+		// jobs that have not been handed out yet, in the order of the plan
+		std::deque<BatchJob> jobs;
+		MemoryBudget budget;
+		std::mutex mutex;
+		std::condition_variable condition;
+	};
+
+	void parallelFor(const unsigned count, const std::function<void(unsigned begin, unsigned end)> &body);
+};
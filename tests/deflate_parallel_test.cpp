@@ -0,0 +1,191 @@
+// Checks that deflating with parallel_for gives valid zlib data and the same bytes whatever order and threads the
+// blocks are compressed in, as lodepng.h promises. The blocks are run in order, in reverse order and spread over
+// threads, for zlib_compress, lodepng_encode and the row encoder.
+// g++ -std=c++17 -O2 -pthread -Isource tests/deflate_parallel_test.cpp source/lodepng.cpp -o deflate_parallel_test
+// It returns a non-zero exit code if any check fails.
+#include "lodepng.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	unsigned failed = 0;
+
+	void check(const bool passed, const std::string &name)
+	{
+		std::cout << (passed ? "ok     " : "FAILED ") << name << std::endl;
+		if (!passed) ++failed;
+	}
+
+	// most blocks that a parallel_for call was given since it was last reset
+	size_t maxCount = 0;
+
+	void countBlocks(const size_t count)
+	{
+		if (count > maxCount) maxCount = count;
+	}
+
+	void inOrder(void (*task)(void *, size_t), void *taskContext, size_t count, const LodePNGCompressSettings *)
+	{
+		countBlocks(count);
+		for (size_t i = 0; i < count; ++i) task(taskContext, i);
+	}
+
+	void inReverse(void (*task)(void *, size_t), void *taskContext, size_t count, const LodePNGCompressSettings *)
+	{
+		countBlocks(count);
+		for (size_t i = count; i > 0; --i) task(taskContext, i - 1);
+	}
+
+	// Runs every block on a thread of its own, so they finish in whatever order the threads are scheduled.
+	void onThreads(void (*task)(void *, size_t), void *taskContext, size_t count, const LodePNGCompressSettings *)
+	{
+		countBlocks(count);
+		std::vector<std::thread> threads;
+		for (size_t i = 0; i < count; ++i) threads.emplace_back(task, taskContext, i);
+		for (std::thread &thread : threads) thread.join();
+	}
+
+	typedef void (*ParallelFor)(void (*)(void *, size_t), void *, size_t, const LodePNGCompressSettings *);
+	const ParallelFor PARALLEL_FORS[] = { inOrder, inReverse, onThreads };
+	const char *PARALLEL_FOR_NAMES[] = { "in order", "in reverse", "on threads" };
+
+	// An input of several megabytes with long matches, noise and runs, so it is split into many blocks.
+	std::vector<unsigned char> testInput()
+	{
+		std::vector<unsigned char> input(3 << 20);
+		unsigned seed = 1;
+		for (size_t i = 0; i < input.size(); ++i)
+		{
+			seed = seed * 1103515245u + 12345u;
+			const size_t part = (i / 50000) % 4;
+			if (part == 0) input[i] = (unsigned char)(seed >> 16);
+			else if (part == 1) input[i] = (unsigned char)("parallel deflate "[i % 17]);
+			else if (part == 2) input[i] = 0;
+			else input[i] = (unsigned char)((i * 3) ^ (i >> 8));
+		}
+		return input;
+	}
+
+	// Inflates a zlib stream, which also checks its Adler-32, and compares it with the input.
+	bool inflatesTo(const std::vector<unsigned char> &stream, const std::vector<unsigned char> &input)
+	{
+		LodePNGDecompressSettings settings;
+		lodepng_decompress_settings_init(&settings);
+		unsigned char *out = nullptr;
+		size_t size = 0;
+		const unsigned error = lodepng_zlib_decompress(&out, &size, stream.data(), stream.size(), &settings);
+		const bool same = !error && std::vector<unsigned char>(out, out + size) == input;
+		free(out);
+		return same;
+	}
+
+	void checkZlib()
+	{
+		const std::vector<unsigned char> input = testInput();
+		const LodePNGMatchFinder matchFinders[] = { LMF_FAST, LMF_HASH_CHAIN };
+		for (unsigned btype = 1; btype < 3; ++btype)
+		{
+			for (const LodePNGMatchFinder matchFinder : matchFinders)
+			{
+				const std::string name = "zlib_compress, block type " + std::to_string(btype) + (matchFinder == LMF_FAST ? ", fast match finder" : ", hash chains");
+				std::vector<unsigned char> streams[3];
+				for (unsigned p = 0; p < 3; ++p)
+				{
+					LodePNGCompressSettings settings;
+					lodepng_compress_settings_init(&settings);
+					settings.btype = btype;
+					settings.matchfinder = matchFinder;
+					settings.parallel_for = PARALLEL_FORS[p];
+					maxCount = 0;
+					unsigned char *out = nullptr;
+					size_t size = 0;
+					const unsigned error = lodepng_zlib_compress(&out, &size, input.data(), input.size(), &settings);
+					streams[p].assign(out, out + size);
+					free(out);
+					check(!error && maxCount > 1 && inflatesTo(streams[p], input),
+						name + ", " + "up to " + std::to_string(maxCount) + " blocks " + PARALLEL_FOR_NAMES[p] + " inflate to the input");
+				}
+				check(streams[0] == streams[1] && streams[0] == streams[2], name + ", same bytes in every order");
+			}
+		}
+	}
+
+	unsigned appendToVector(void *user, const unsigned char *data, size_t size)
+	{
+		std::vector<unsigned char> *file = static_cast<std::vector<unsigned char> *>(user);
+		file->insert(file->end(), data, data + size);
+		return 0;
+	}
+
+	// Encodes a RGBA image with lodepng_encode or with the row encoder, with a parallel_for.
+	std::vector<unsigned char> encode(const std::vector<unsigned char> &pixels, const unsigned width, const unsigned height, const bool rows,
+		const ParallelFor parallelFor, unsigned &error)
+	{
+		LodePNGState state;
+		lodepng_state_init(&state);
+		state.encoder.auto_convert = 0;
+		state.encoder.zlibsettings.matchfinder = LMF_FAST;
+		state.encoder.zlibsettings.parallel_for = parallelFor;
+		std::vector<unsigned char> png;
+		if (rows)
+		{
+			LodePNGRowEncoder *encoder = nullptr;
+			error = lodepng_row_encoder_begin(&encoder, width, height, &state, appendToVector, &png);
+			for (unsigned y = 0; y < height && !error; ++y)
+				error = lodepng_row_encoder_add(encoder, pixels.data() + (size_t)y * width * 4);
+			if (encoder != nullptr)
+			{
+				const unsigned endError = lodepng_row_encoder_end(encoder);
+				if (!error) error = endError;
+			}
+		}
+		else
+		{
+			unsigned char *out = nullptr;
+			size_t size = 0;
+			error = lodepng_encode(&out, &size, pixels.data(), width, height, &state);
+			png.assign(out, out + size);
+			free(out);
+		}
+		lodepng_state_cleanup(&state);
+		return png;
+	}
+
+	void checkPng()
+	{
+		const unsigned width = 1200, height = 900;
+		std::vector<unsigned char> pixels((size_t)width * height * 4);
+		for (size_t i = 0; i < pixels.size(); ++i)
+			pixels[i] = (unsigned char)(((i / (4 * width)) % 200 < 100) ? (i * 7) ^ (i >> 11) : (i / 4) % width);
+		for (unsigned rows = 0; rows < 2; ++rows)
+		{
+			const std::string name = rows ? "row encoder" : "lodepng_encode";
+			std::vector<unsigned char> files[3];
+			for (unsigned p = 0; p < 3; ++p)
+			{
+				unsigned error = 0;
+				maxCount = 0;
+				files[p] = encode(pixels, width, height, rows != 0, PARALLEL_FORS[p], error);
+				unsigned char *decoded = nullptr;
+				unsigned decodedWidth = 0, decodedHeight = 0;
+				if (!error) error = lodepng_decode32(&decoded, &decodedWidth, &decodedHeight, files[p].data(), files[p].size());
+				const bool same = !error && decodedWidth == width && decodedHeight == height && std::vector<unsigned char>(decoded, decoded + pixels.size()) == pixels;
+				free(decoded);
+				check(same && maxCount > 1, name + ", " + "up to " + std::to_string(maxCount) + " blocks " + PARALLEL_FOR_NAMES[p] + " decode to the image");
+			}
+			check(files[0] == files[1] && files[0] == files[2], name + ", same bytes in every order");
+		}
+	}
+}
+
+int main()
+{
+	checkZlib();
+	checkPng();
+	std::cout << failed << " failed" << std::endl;
+	return (failed > 0) ? 1 : 0;
+}
@@ -0,0 +1,194 @@
+// Checks that the memory estimates of batch jobs are upper bounds of what resizing the images really allocates.
+// Every allocation is counted through the GNU linker's --wrap, so it only builds with GCC or Clang on Linux:
+// g++ -std=c++17 -O2 -pthread -Isource tests/estimate_test.cpp source/resizer.cpp source/resample.cpp source/resample_simd.cpp
+//     source/thread_pool.cpp source/lodepng.cpp -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free,--wrap=posix_memalign -o estimate_test
+// It returns a non-zero exit code if an estimate is below the peak allocation.
+#include "resizer.h"
+#include "lodepng.h"
+#include "thread_pool.h"
+#include <cstdio>
+#include <cstdlib>
+#include <malloc.h>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// bytes allocated right now and the most that were allocated at once since the peak was reset
+	size_t allocated = 0;
+	size_t peak = 0;
+	std::mutex allocationMutex;
+
+	void track(void *memory)
+	{
+		if (memory == nullptr) return;
+		std::lock_guard<std::mutex> lock(allocationMutex);
+		allocated += malloc_usable_size(memory);
+		if (allocated > peak) peak = allocated;
+	}
+
+	void untrack(void *memory)
+	{
+		if (memory == nullptr) return;
+		std::lock_guard<std::mutex> lock(allocationMutex);
+		allocated -= malloc_usable_size(memory);
+	}
+}
+
+extern "C"
+{
+	void *__real_malloc(size_t size);
+	void *__real_calloc(size_t count, size_t size);
+	void *__real_realloc(void *memory, size_t size);
+	void __real_free(void *memory);
+	int __real_posix_memalign(void **memory, size_t alignment, size_t size);
+
+	void *__wrap_malloc(size_t size)
+	{
+		void *memory = __real_malloc(size);
+		track(memory);
+		return memory;
+	}
+
+	void *__wrap_calloc(size_t count, size_t size)
+	{
+		void *memory = __real_calloc(count, size);
+		track(memory);
+		return memory;
+	}
+
+	void *__wrap_realloc(void *memory, size_t size)
+	{
+		untrack(memory);
+		void *result = __real_realloc(memory, size);
+		// a failed realloc leaves the old memory allocated
+		track((result != nullptr || size == 0) ? result : memory);
+		return result;
+	}
+
+	void __wrap_free(void *memory)
+	{
+		untrack(memory);
+		__real_free(memory);
+	}
+
+	int __wrap_posix_memalign(void **memory, size_t alignment, size_t size)
+	{
+		int error = __real_posix_memalign(memory, alignment, size);
+		if (error == 0) track(*memory);
+		return error;
+	}
+}
+
+// new and delete of the standard library call the unwrapped malloc, so they are replaced as well
+void *operator new(size_t size)
+{
+	void *memory = __wrap_malloc(size > 0 ? size : 1);
+	if (memory == nullptr) throw std::bad_alloc();
+	return memory;
+}
+
+void operator delete(void *memory) noexcept
+{
+	__wrap_free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+	__wrap_free(memory);
+}
+
+namespace
+{
+	// a image to write, resize and check the estimate of
+	struct TestCase
+	{
+		const char *name;
+		unsigned width, height;
+		LodePNGColorType colorType;
+		unsigned bitDepth;
+		bool interlaced;
+		int resizedWidth, resizedHeight;
+		Resizer::ResizeFilter filter;
+	};
+
+	// Writes a image with noisy pixels in the color type, bit depth and interlacing of a test case.
+	bool writeTestImage(const TestCase &test, const std::string &filename)
+	{
+		std::vector<unsigned char> pixels((size_t)test.width * test.height * Resizer::NUMBER_OF_CHANNELS);
+		for (size_t i = 0; i < pixels.size(); ++i)
+			pixels[i] = (unsigned char)((i * 7) ^ (i >> 9));
+		LodePNGState state;
+		lodepng_state_init(&state);
+		state.info_png.color.colortype = test.colorType;
+		state.info_png.color.bitdepth = test.bitDepth;
+		state.info_png.interlace_method = test.interlaced ? 1 : 0;
+		state.encoder.auto_convert = 0;
+		if (test.colorType != LCT_RGBA)
+		{
+			for (size_t i = 3; i < pixels.size(); i += Resizer::NUMBER_OF_CHANNELS)
+				pixels[i] = 255;
+		}
+		unsigned char *png = nullptr;
+		size_t size = 0;
+		unsigned error = lodepng_encode(&png, &size, pixels.data(), test.width, test.height, &state);
+		lodepng_state_cleanup(&state);
+		if (!error) error = lodepng_save_file(png, size, filename.c_str());
+		free(png);
+		return error == 0;
+	}
+}
+
+int main()
+{
+	const TestCase tests[] = {
+		{ "enlarge_rgba", 900, 600, LCT_RGBA, 8, false, 1600, 1100, Resizer::LANCZOS3_FILTER },
+		{ "enlarge_grey16_interlaced", 700, 500, LCT_GREY, 16, true, 1400, 1000, Resizer::BICUBIC_FILTER },
+		{ "shrink_rgb16_interlaced", 2000, 1500, LCT_RGB, 16, true, 1900, 1400, Resizer::LANCZOS3_FILTER },
+		{ "shrink_rgba_interlaced", 2000, 1500, LCT_RGBA, 8, true, 700, 500, Resizer::BILINEAR_FILTER },
+		{ "shrink_rgb", 2000, 1500, LCT_RGB, 8, false, 700, 500, Resizer::AREA_FILTER },
+		{ "shrink_rgba", 2000, 1500, LCT_RGBA, 8, false, 1500, 1000, Resizer::LANCZOS3_FILTER }
+	};
+	const Resizer::EncodeEffort efforts[] = { Resizer::STORE_EFFORT, Resizer::DEFAULT_EFFORT, Resizer::MAX_EFFORT };
+	const unsigned threadCounts[] = { 1, 4 };
+
+	unsigned failed = 0;
+	for (const TestCase &test : tests)
+	{
+		const std::string inputFilename = std::string("estimate_test_") + test.name + ".png";
+		const std::string outputFilename = std::string("estimate_test_") + test.name + "_resized.png";
+		if (!writeTestImage(test, inputFilename))
+		{
+			std::cout << "Error: could not write " << inputFilename << std::endl;
+			return 2;
+		}
+		for (const unsigned threadCount : threadCounts)
+		{
+			// the estimate depends on the thread count, like in a batch it is set first
+			Resizer::setThreadCount(threadCount);
+			Resizer::BatchJob job;
+			job.header = Resizer::readImageHeader(inputFilename.c_str());
+			Resizer::estimateResize(job, test.resizedWidth, test.resizedHeight, test.filter);
+			for (const Resizer::EncodeEffort effort : efforts)
+			{
+				size_t before;
+				{
+					std::lock_guard<std::mutex> lock(allocationMutex);
+					before = peak = allocated;
+				}
+				bool resized = Resizer::resizeImageFile(inputFilename.c_str(), outputFilename.c_str(), test.resizedWidth, test.resizedHeight, test.filter, Resizer::EncodeOptions(effort));
+				const size_t used = peak - before;
+				const bool bounded = resized && used <= job.memory;
+				std::cout << (bounded ? "ok     " : "FAILED ") << test.name << ", " << threadCount << " threads, effort " << effort
+					<< ": peak " << used << " bytes, estimate " << job.memory << " bytes" << std::endl;
+				if (!bounded) ++failed;
+			}
+		}
+		std::remove(inputFilename.c_str());
+		std::remove(outputFilename.c_str());
+	}
+	std::cout << failed << " failed" << std::endl;
+	return (failed > 0) ? 1 : 0;
+}
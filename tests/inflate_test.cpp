@@ -0,0 +1,331 @@
+// Checks that inflating with the Huffman lookup tables gives the same output as the bitwise tree walk that is kept to
+// verify them against, on stored, fixed and dynamic deflate blocks and on PNG files whose IDAT data is split into
+// several chunks. Corrupt streams have to give an error instead of crashing.
+// g++ -std=c++17 -O2 -Isource tests/inflate_test.cpp source/lodepng.cpp -o inflate_test
+// It returns a non-zero exit code if any check fails.
+#include "lodepng.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	unsigned failed = 0;
+
+	void check(const bool passed, const std::string &name)
+	{
+		std::cout << (passed ? "ok     " : "FAILED ") << name << std::endl;
+		if (!passed) ++failed;
+	}
+
+	// Inflates a zlib stream, or a raw deflate stream if zlib is false, with the lookup tables or bit by bit.
+	// It returns the lodepng error code.
+	unsigned inflate(std::vector<unsigned char> &out, const std::vector<unsigned char> &in, const bool zlib, const bool bitwise)
+	{
+		LodePNGDecompressSettings settings;
+		lodepng_decompress_settings_init(&settings);
+		settings.bitwise_huffman = bitwise ? 1 : 0;
+		unsigned char *buffer = nullptr;
+		size_t size = 0;
+		unsigned error = zlib ? lodepng_zlib_decompress(&buffer, &size, in.data(), in.size(), &settings)
+			: lodepng_inflate(&buffer, &size, in.data(), in.size(), &settings);
+		out.assign(buffer, buffer + size);
+		free(buffer);
+		return error;
+	}
+
+	// Inputs that give long matches, no matches at all, runs and text-like symbol statistics, some of them long
+	// enough for several deflate blocks.
+	std::vector<std::vector<unsigned char>> testInputs()
+	{
+		std::vector<std::vector<unsigned char>> inputs;
+		inputs.push_back(std::vector<unsigned char>(1, 'a'));
+		std::vector<unsigned char> text;
+		const std::string words[] = { "resize ", "the ", "image ", "while ", "it ", "is ", "decoded, ", "row ", "by ", "row. " };
+		unsigned seed = 1;
+		while (text.size() < 300000)
+		{
+			seed = seed * 1103515245u + 12345u;
+			const std::string &word = words[(seed >> 16) % 10];
+			text.insert(text.end(), word.begin(), word.end());
+		}
+		inputs.push_back(text);
+		std::vector<unsigned char> noise(200000);
+		for (size_t i = 0; i < noise.size(); ++i)
+		{
+			seed = seed * 1103515245u + 12345u;
+			noise[i] = (unsigned char)(seed >> 16);
+		}
+		inputs.push_back(noise);
+		std::vector<unsigned char> mixed(150000, 0);
+		for (size_t i = 0; i < mixed.size(); ++i)
+			if ((i / 4096) % 3 == 1) mixed[i] = (unsigned char)((i * 7) ^ (i >> 5));
+		inputs.push_back(mixed);
+		return inputs;
+	}
+
+	// Compresses every input with stored, fixed and dynamic blocks and inflates it in both modes.
+	void checkBlockTypes()
+	{
+		const char *blockNames[] = { "stored", "fixed", "dynamic" };
+		const std::vector<std::vector<unsigned char>> inputs = testInputs();
+		for (size_t i = 0; i < inputs.size(); ++i)
+		{
+			for (unsigned btype = 0; btype < 3; ++btype)
+			{
+				LodePNGCompressSettings settings;
+				lodepng_compress_settings_init(&settings);
+				settings.btype = btype;
+				unsigned char *compressed = nullptr;
+				size_t compressedSize = 0;
+				const unsigned compressError = lodepng_zlib_compress(&compressed, &compressedSize, inputs[i].data(), inputs[i].size(), &settings);
+				const std::vector<unsigned char> stream(compressed, compressed + compressedSize);
+				free(compressed);
+
+				std::vector<unsigned char> tableOut, bitwiseOut;
+				const unsigned tableError = inflate(tableOut, stream, true, false);
+				const unsigned bitwiseError = inflate(bitwiseOut, stream, true, true);
+				check(!compressError && !tableError && !bitwiseError && tableOut == bitwiseOut && tableOut == inputs[i],
+					std::string(blockNames[btype]) + " blocks, input " + std::to_string(i) + " of " + std::to_string(inputs[i].size()) + " bytes");
+			}
+		}
+	}
+
+	// Writes deflate streams bit by bit, the bits of Huffman codes are given from the most significant one.
+	struct BitWriter
+	{
+		BitWriter() : bit(0) {}
+
+		void add(const unsigned value, const unsigned count)
+		{
+			for (unsigned i = 0; i < count; ++i) addBit((value >> i) & 1);
+		}
+
+		void addCode(const unsigned code, const unsigned length)
+		{
+			for (unsigned i = length; i > 0; --i) addBit((code >> (i - 1)) & 1);
+		}
+
+		void addBit(const unsigned value)
+		{
+			if (bit == 0) data.push_back(0);
+			data.back() |= (unsigned char)(value << bit);
+			bit = (bit + 1) & 7;
+		}
+
+		std::vector<unsigned char> data;
+		unsigned bit;
+	};
+
+	// Inflates a corrupt stream in both modes, both have to return an error.
+	void checkCorrupt(const std::vector<unsigned char> &stream, const bool zlib, const std::string &name)
+	{
+		std::vector<unsigned char> out;
+		const unsigned tableError = inflate(out, stream, zlib, false);
+		const unsigned bitwiseError = inflate(out, stream, zlib, true);
+		check(tableError != 0 && bitwiseError != 0, "corrupt stream: " + name + ", errors " + std::to_string(tableError) + " and " + std::to_string(bitwiseError));
+	}
+
+	void checkCorruptStreams()
+	{
+		// block type 3 is reserved
+		BitWriter reserved;
+		reserved.add(1, 1);
+		reserved.add(3, 2);
+		reserved.add(0, 16);
+		checkCorrupt(reserved.data, false, "reserved block type");
+
+		// the length of a stored block has to match its one's complement
+		BitWriter stored;
+		stored.add(1, 1);
+		stored.add(0, 2);
+		stored.add(0, 5);
+		stored.add(5, 16);
+		stored.add(5, 16);
+		stored.add(0x6f6c6c65, 32);
+		stored.add('h', 8);
+		checkCorrupt(stored.data, false, "stored length and its complement differ");
+
+		// a fixed block that starts with a match of distance 1, before there is anything to copy
+		BitWriter distance;
+		distance.add(1, 1);
+		distance.add(1, 2);
+		distance.addCode(1, 7);
+		distance.addCode(0, 5);
+		distance.addCode(0, 7);
+		checkCorrupt(distance.data, false, "match before the start of the output");
+
+		// a fixed block with the length symbol 286, which does not exist
+		BitWriter symbol;
+		symbol.add(1, 1);
+		symbol.add(1, 2);
+		symbol.addCode(0xc6, 8);
+		symbol.addCode(0, 7);
+		checkCorrupt(symbol.data, false, "literal/length symbol 286");
+
+		// streams that end in the middle of a block, or whose checksum is wrong
+		const std::vector<std::vector<unsigned char>> inputs = testInputs();
+		for (unsigned btype = 0; btype < 3; ++btype)
+		{
+			LodePNGCompressSettings settings;
+			lodepng_compress_settings_init(&settings);
+			settings.btype = btype;
+			unsigned char *compressed = nullptr;
+			size_t compressedSize = 0;
+			lodepng_zlib_compress(&compressed, &compressedSize, inputs[1].data(), inputs[1].size(), &settings);
+			std::vector<unsigned char> stream(compressed, compressed + compressedSize);
+			free(compressed);
+			checkCorrupt(std::vector<unsigned char>(stream.begin(), stream.begin() + stream.size() / 2), true, "truncated, block type " + std::to_string(btype));
+			stream[stream.size() - 1] ^= 1;
+			checkCorrupt(stream, true, "wrong Adler-32, block type " + std::to_string(btype));
+		}
+
+		// flipped bits may or may not give valid streams, but they must never make the inflator crash
+		LodePNGCompressSettings settings;
+		lodepng_compress_settings_init(&settings);
+		unsigned char *compressed = nullptr;
+		size_t compressedSize = 0;
+		lodepng_zlib_compress(&compressed, &compressedSize, inputs[3].data(), inputs[3].size(), &settings);
+		const std::vector<unsigned char> stream(compressed, compressed + compressedSize);
+		free(compressed);
+		unsigned seed = 7;
+		for (unsigned i = 0; i < 200; ++i)
+		{
+			std::vector<unsigned char> flipped = stream;
+			for (unsigned j = 0; j < 4; ++j)
+			{
+				seed = seed * 1103515245u + 12345u;
+				// the first bytes hold the block headers and code lengths, where flips do the most damage
+				const size_t position = (i % 2 == 0) ? 2 + (seed >> 8) % 64 : (seed >> 8) % flipped.size();
+				flipped[position] ^= (unsigned char)(1 << ((seed >> 4) & 7));
+			}
+			std::vector<unsigned char> out;
+			inflate(out, flipped, true, false);
+			inflate(out, flipped, true, true);
+		}
+		check(true, "200 streams with flipped bits inflated without crashing");
+	}
+
+	// Copies a PNG file with all of its IDAT data put into new chunks of at most pieceSize bytes.
+	std::vector<unsigned char> splitIdat(const std::vector<unsigned char> &png, const size_t pieceSize)
+	{
+		std::vector<unsigned char> data;
+		for (const unsigned char *chunk = png.data() + 8; chunk < png.data() + png.size(); chunk = lodepng_chunk_next_const(chunk))
+		{
+			if (lodepng_chunk_type_equals(chunk, "IDAT"))
+				data.insert(data.end(), lodepng_chunk_data_const(chunk), lodepng_chunk_data_const(chunk) + lodepng_chunk_length(chunk));
+			if (lodepng_chunk_type_equals(chunk, "IEND")) break;
+		}
+
+		unsigned char *out = (unsigned char *)malloc(8);
+		size_t outSize = 8;
+		for (size_t i = 0; i < 8; ++i) out[i] = png[i];
+		bool idatWritten = false;
+		for (const unsigned char *chunk = png.data() + 8; chunk < png.data() + png.size(); chunk = lodepng_chunk_next_const(chunk))
+		{
+			const bool end = lodepng_chunk_type_equals(chunk, "IEND") != 0;
+			if (!lodepng_chunk_type_equals(chunk, "IDAT"))
+				lodepng_chunk_append(&out, &outSize, chunk);
+			else if (!idatWritten)
+			{
+				for (size_t start = 0; start < data.size(); start += pieceSize)
+				{
+					const size_t length = (data.size() - start < pieceSize) ? data.size() - start : pieceSize;
+					lodepng_chunk_create(&out, &outSize, (unsigned)length, "IDAT", data.data() + start);
+				}
+				idatWritten = true;
+			}
+			if (end) break;
+		}
+		std::vector<unsigned char> result(out, out + outSize);
+		free(out);
+		return result;
+	}
+
+	// the pixels that lodepng_decode_rows gave so far and the size of a RGBA row
+	struct DecodedRows
+	{
+		std::vector<unsigned char> &pixels;
+		size_t rowSize;
+	};
+
+	unsigned collectRow(void *user, unsigned, const unsigned char *row)
+	{
+		DecodedRows *rows = static_cast<DecodedRows *>(user);
+		rows->pixels.insert(rows->pixels.end(), row, row + rows->rowSize);
+		return 0;
+	}
+
+	// Decodes a PNG file of the given width to RGBA with lodepng_decode, or with lodepng_decode_rows if rows is true.
+	unsigned decode(std::vector<unsigned char> &pixels, const std::vector<unsigned char> &png, const unsigned expectedWidth, const bool bitwise, const bool rows)
+	{
+		LodePNGState state;
+		lodepng_state_init(&state);
+		state.decoder.zlibsettings.bitwise_huffman = bitwise ? 1 : 0;
+		unsigned width = 0, height = 0;
+		unsigned error;
+		pixels.clear();
+		if (rows)
+		{
+			DecodedRows decoded = { pixels, (size_t)expectedWidth * 4 };
+			error = lodepng_decode_rows(&width, &height, &state, png.data(), png.size(), collectRow, &decoded);
+		}
+		else
+		{
+			unsigned char *out = nullptr;
+			error = lodepng_decode(&out, &width, &height, &state, png.data(), png.size());
+			if (!error) pixels.assign(out, out + (size_t)width * height * 4);
+			free(out);
+		}
+		lodepng_state_cleanup(&state);
+		return error;
+	}
+
+	// Encodes images with every block type, splits their IDAT data into chunks of several sizes and decodes them
+	// whole and row by row in both modes.
+	void checkSplitIdat()
+	{
+		const unsigned width = 211, height = 157;
+		std::vector<unsigned char> pixels((size_t)width * height * 4);
+		for (size_t i = 0; i < pixels.size(); ++i)
+			pixels[i] = (unsigned char)(((i / 4) % width < 100) ? (i * 13) ^ (i >> 7) : (i / (4 * width)) * 3);
+		const size_t pieceSizes[] = { 1, 5, 1000, 1 << 20 };
+		for (unsigned interlace = 0; interlace < 2; ++interlace)
+		{
+			for (unsigned btype = 0; btype < 3; ++btype)
+			{
+				LodePNGState state;
+				lodepng_state_init(&state);
+				state.encoder.zlibsettings.btype = btype;
+				state.encoder.auto_convert = 0;
+				state.info_png.interlace_method = interlace;
+				unsigned char *encoded = nullptr;
+				size_t encodedSize = 0;
+				const unsigned encodeError = lodepng_encode(&encoded, &encodedSize, pixels.data(), width, height, &state);
+				const std::vector<unsigned char> png(encoded, encoded + encodedSize);
+				free(encoded);
+				lodepng_state_cleanup(&state);
+				for (const size_t pieceSize : pieceSizes)
+				{
+					const std::vector<unsigned char> split = splitIdat(png, pieceSize);
+					std::vector<unsigned char> table, bitwise, tableRows, bitwiseRows;
+					const unsigned error = decode(table, split, width, false, false) | decode(bitwise, split, width, true, false)
+						| decode(tableRows, split, width, false, true) | decode(bitwiseRows, split, width, true, true);
+					check(!encodeError && !error && table == pixels && bitwise == pixels && tableRows == pixels && bitwiseRows == pixels,
+						std::string(interlace ? "interlaced" : "progressive") + " PNG, block type " + std::to_string(btype)
+						+ ", IDAT chunks of " + std::to_string(pieceSize) + " bytes");
+				}
+			}
+		}
+	}
+}
+
+int main()
+{
+	checkBlockTypes();
+	checkCorruptStreams();
+	checkSplitIdat();
+	std::cout << failed << " failed" << std::endl;
+	return (failed > 0) ? 1 : 0;
+}